@@ -0,0 +1,678 @@
+#include "components/activity/ActivityHistory.h"
+#include "components/fs/FS.h"
+#include <algorithm>
+#include <cstdio>
+#include <libraries/log/nrf_log.h>
+#include "nrf_assert.h"
+#include "utility/Crc16.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr const char* directory = "/.system/activity";
+  constexpr const char* daysFileName = "/.system/activity/days.dat";
+
+  uint16_t ReadU16(const uint8_t* data) {
+    return data[0] | (data[1] << 8);
+  }
+
+  uint32_t ReadU32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+  }
+
+  void WriteU16(uint8_t* data, uint16_t value) {
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+  }
+
+  void WriteU32(uint8_t* data, uint32_t value) {
+    WriteU16(data, static_cast<uint16_t>(value));
+    WriteU16(data + 2, static_cast<uint16_t>(value >> 16));
+  }
+
+  uint8_t* WriteVarint(uint8_t* data, uint32_t value) {
+    while (value >= 0x80) {
+      *data++ = static_cast<uint8_t>(value) | 0x80;
+      value >>= 7;
+    }
+    *data++ = static_cast<uint8_t>(value);
+    return data;
+  }
+
+  // Returns nullptr if the varint does not end before 'end'
+  const uint8_t* ReadVarint(const uint8_t* data, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (uint8_t shift = 0; data < end && shift < 32; shift += 7) {
+      uint8_t byte = *data++;
+      value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return data;
+      }
+    }
+    return nullptr;
+  }
+
+  uint32_t ZigZag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+  }
+
+  int32_t UnZigZag(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+  }
+
+  void WriteSummary(uint8_t* data, const ActivityHistory::Summary& summary) {
+    WriteU32(data, summary.steps);
+    WriteU32(data + 4, summary.heartRateSum);
+    WriteU16(data + 8, summary.heartRateMinutes);
+    data[10] = summary.minHeartRate;
+    data[11] = summary.maxHeartRate;
+  }
+
+  ActivityHistory::Summary ReadSummary(const uint8_t* data) {
+    return {ReadU32(data), ReadU32(data + 4), ReadU16(data + 8), data[10], data[11]};
+  }
+
+  void CreateDirectory(Pinetime::Controllers::FS& fs, const char* path) {
+    lfs_dir dir;
+    if (fs.DirOpen(path, &dir) != LFS_ERR_OK) {
+      fs.DirCreate(path);
+    }
+    fs.DirClose(&dir);
+  }
+}
+
+void ActivityHistory::Summary::Add(uint16_t minuteSteps, uint8_t heartRate) {
+  steps += minuteSteps;
+  if (heartRate == 0) {
+    return;
+  }
+  minHeartRate = (heartRateMinutes == 0) ? heartRate : std::min(minHeartRate, heartRate);
+  maxHeartRate = std::max(maxHeartRate, heartRate);
+  heartRateSum += heartRate;
+  heartRateMinutes++;
+}
+
+void ActivityHistory::Summary::Add(const Summary& other) {
+  steps += other.steps;
+  if (other.heartRateMinutes == 0) {
+    return;
+  }
+  minHeartRate = (heartRateMinutes == 0) ? other.minHeartRate : std::min(minHeartRate, other.minHeartRate);
+  maxHeartRate = std::max(maxHeartRate, other.maxHeartRate);
+  heartRateSum += other.heartRateSum;
+  heartRateMinutes += other.heartRateMinutes;
+}
+
+ActivityHistory::ActivityHistory(Controllers::FS& fs) : fs {fs} {
+  static_assert(sizeof(Header) == 12, "The header is written as is");
+  mutex = xSemaphoreCreateMutex();
+  ASSERT(mutex != nullptr);
+}
+
+void ActivityHistory::FileName(uint32_t day, char* name, size_t size) {
+  snprintf(name, size, "%s/day%02lu.dat", directory, static_cast<unsigned long>(day % nbDetailedDays));
+}
+
+bool ActivityHistory::ReadHeader(uint32_t day, Header& header) {
+  char name[32];
+  FileName(day, name, sizeof(name));
+  lfs_file_t file;
+  if (fs.FileOpen(&file, name, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return false;
+  }
+  int result = fs.FileRead(&file, reinterpret_cast<uint8_t*>(&header), sizeof(header));
+  fs.FileClose(&file);
+  return result == sizeof(header) && header.magic == magic && header.version == formatVersion &&
+         header.day % nbDetailedDays == day % nbDetailedDays;
+}
+
+void ActivityHistory::Init() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint32_t days[nbDetailedDays] = {};
+  uint32_t latest = 0;
+  for (uint32_t slot = 0; slot < nbDetailedDays; slot++) {
+    Header header;
+    if (ReadHeader(slot, header)) {
+      days[slot] = header.day;
+      latest = std::max(latest, header.day);
+    }
+  }
+
+  if (latest == 0) {
+    NRF_LOG_INFO("[ActivityHistory] No history found");
+  } else {
+    for (uint32_t day : days) {
+      if (day != 0) {
+        Recover(day, day == latest);
+      }
+    }
+    NRF_LOG_INFO("[ActivityHistory] Last day %lu, %lu steps", latest, daySummary.steps);
+  }
+  xSemaphoreGive(mutex);
+}
+
+void ActivityHistory::Recover(uint32_t day, bool isLatest) {
+  Summary summary;
+  if (!isLatest && ReadDaySlot(day, summary)) {
+    // The day was completed
+    return;
+  }
+
+  Scan scan;
+  bool valid = ReadDay(
+    day,
+    [&scan](uint16_t minute, Minute value) {
+      auto hour = static_cast<uint8_t>(minute / 60);
+      if (!scan.hasMinutes || hour != scan.lastHourIndex) {
+        scan.lastHour = {};
+        scan.lastHourIndex = hour;
+      }
+      scan.day.Add(value.steps, value.heartRate);
+      scan.lastHour.Add(value.steps, value.heartRate);
+      scan.hoursWithMinutes |= 1U << hour;
+      scan.lastMinute = minute;
+      scan.hasMinutes = true;
+    },
+    [&scan](uint8_t hour, const Summary& /*summary*/) {
+      scan.hoursWithRecord |= 1U << hour;
+    }) >= 0;
+  if (!valid || !scan.hasMinutes) {
+    return;
+  }
+
+  // The last hour of the latest day may still be in progress
+  uint32_t missingHours = scan.hoursWithMinutes & ~scan.hoursWithRecord;
+  if (isLatest) {
+    missingHours &= ~(1U << scan.lastHourIndex);
+  }
+  for (uint8_t hour = 0; hour < 24 && missingHours != 0; hour++) {
+    if ((missingHours & (1U << hour)) == 0) {
+      continue;
+    }
+    missingHours &= ~(1U << hour);
+    Summary hourSummary;
+    ReadDay(
+      day,
+      [hour, &hourSummary](uint16_t minute, Minute value) {
+        if (minute / 60 == hour) {
+          hourSummary.Add(value.steps, value.heartRate);
+        }
+      },
+      [](uint8_t, const Summary&) {
+      });
+    lfs_file_t file;
+    if (OpenDay(day, file)) {
+      WriteHour(file, hour, hourSummary);
+      CloseDay(file);
+    }
+    NRF_LOG_INFO("[ActivityHistory] Rebuilt hour %d of day %lu", hour, day);
+  }
+
+  if (!isLatest) {
+    WriteDaySlot(day, scan.day);
+    NRF_LOG_INFO("[ActivityHistory] Rebuilt day %lu", day);
+    return;
+  }
+
+  currentDay = day;
+  dayInProgress = true;
+  daySummary = scan.day;
+  currentHour = scan.lastHourIndex;
+  hourInProgress = (scan.hoursWithRecord & (1U << scan.lastHourIndex)) == 0;
+  hourSummary = hourInProgress ? scan.lastHour : Summary {};
+  lastRecordedMinute = day * minutesPerDay + scan.lastMinute;
+}
+
+void ActivityHistory::Update(std::chrono::minutes localTime, uint32_t nbSteps, uint8_t heartRate, uint32_t nbHeartRateReadings) {
+  auto minute = static_cast<uint32_t>(localTime.count());
+  if (minute == currentMinute) {
+    return;
+  }
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (currentMinute != 0) {
+    // The step counter is reset at midnight
+    uint32_t steps = (nbSteps >= minuteStartSteps) ? nbSteps - minuteStartSteps : nbSteps;
+    CloseMinute(currentMinute,
+                static_cast<uint16_t>(std::min<uint32_t>(steps, UINT16_MAX)),
+                nbHeartRateReadings != minuteStartReadings ? heartRate : 0);
+  }
+  currentMinute = minute;
+  minuteStartSteps = nbSteps;
+  minuteStartReadings = nbHeartRateReadings;
+
+  // Write the summaries as soon as they are complete, so that the minutes of the next hour are not mixed with them
+  if (hourInProgress && minute > lastRecordedMinute) {
+    if (Day(localTime) != currentDay) {
+      EndHour();
+      EndDay();
+    } else if ((minute % minutesPerDay) / 60 != currentHour) {
+      EndHour();
+    }
+  }
+  xSemaphoreGive(mutex);
+}
+
+void ActivityHistory::CloseMinute(uint32_t minute, uint16_t steps, uint8_t heartRate) {
+  if (minute <= lastRecordedMinute) {
+    return;
+  }
+  uint32_t day = minute / minutesPerDay;
+  auto minuteOfDay = static_cast<uint16_t>(minute % minutesPerDay);
+  auto hour = static_cast<uint8_t>(minuteOfDay / 60);
+
+  if (dayInProgress && day != currentDay) {
+    EndHour();
+    EndDay();
+  } else if (hourInProgress && hour != currentHour) {
+    EndHour();
+  }
+
+  // The oldest minutes are only dropped when they could not be written for a while (or the time jumped forward)
+  if (nbPendingMinutes > 0 && minute - pendingFirstMinute >= maxPendingMinutes) {
+    auto dropped = static_cast<size_t>(std::min<uint32_t>(minute - pendingFirstMinute - maxPendingMinutes + 1, nbPendingMinutes));
+    NRF_LOG_WARNING("[ActivityHistory] %d minutes were not written", dropped);
+    DropPendingMinutes(dropped);
+  }
+  if (nbPendingMinutes == 0) {
+    pendingFirstMinute = minute;
+  }
+  // The missing minutes are recorded without activity
+  while (pendingFirstMinute + nbPendingMinutes < minute) {
+    pendingMinutes[nbPendingMinutes++] = {};
+  }
+  pendingMinutes[nbPendingMinutes++] = {steps, heartRate};
+  if (nbPendingMinutes >= maxRecordMinutes) {
+    flushNeeded = true;
+  }
+
+  if (!dayInProgress) {
+    currentDay = day;
+    daySummary = {};
+    dayInProgress = true;
+  }
+  if (!hourInProgress) {
+    currentHour = hour;
+    hourSummary = {};
+    hourInProgress = true;
+  }
+  daySummary.Add(steps, heartRate);
+  hourSummary.Add(steps, heartRate);
+  lastRecordedMinute = minute;
+}
+
+void ActivityHistory::DropPendingMinutes(size_t count) {
+  std::copy(pendingMinutes.begin() + count, pendingMinutes.begin() + nbPendingMinutes, pendingMinutes.begin());
+  nbPendingMinutes -= count;
+  pendingFirstMinute += count;
+}
+
+void ActivityHistory::EndHour() {
+  if (!hourInProgress) {
+    return;
+  }
+  if (hourPending) {
+    NRF_LOG_WARNING("[ActivityHistory] The summary of hour %d was not written", pendingHourIndex);
+  }
+  pendingHour = hourSummary;
+  pendingHourDay = currentDay;
+  pendingHourIndex = currentHour;
+  hourPending = true;
+  hourInProgress = false;
+  flushNeeded = true;
+}
+
+void ActivityHistory::EndDay() {
+  if (!dayInProgress) {
+    return;
+  }
+  if (dayPending) {
+    NRF_LOG_WARNING("[ActivityHistory] The summary of day %lu was not written", pendingDayIndex);
+  }
+  pendingDay = daySummary;
+  pendingDayIndex = currentDay;
+  dayPending = true;
+  dayInProgress = false;
+  flushNeeded = true;
+}
+
+void ActivityHistory::Flush() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  lfs_file_t file;
+  // One record per hour, the minutes that are not written are kept for the next flush
+  while (nbPendingMinutes > 0) {
+    uint32_t day = pendingFirstMinute / minutesPerDay;
+    auto hour = static_cast<uint8_t>((pendingFirstMinute % minutesPerDay) / 60);
+    auto count = static_cast<size_t>(std::min<uint32_t>(nbPendingMinutes, 60 - pendingFirstMinute % 60));
+    if (!OpenDay(day, file)) {
+      break;
+    }
+    // The hour is written in the same transaction as its last minutes
+    bool written = WriteRecord(file, recordMinutes, EncodeMinutes(count));
+    bool hourWritten = written && hourPending && pendingHourDay == day && pendingHourIndex == hour &&
+                       WriteHour(file, pendingHourIndex, pendingHour);
+    if (!CloseDay(file) || !written) {
+      break;
+    }
+    hourPending = hourPending && !hourWritten;
+    DropPendingMinutes(count);
+  }
+  if (hourPending && OpenDay(pendingHourDay, file)) {
+    bool written = WriteHour(file, pendingHourIndex, pendingHour);
+    hourPending = !CloseDay(file) || !written;
+  }
+  if (dayPending) {
+    dayPending = !WriteDaySlot(pendingDayIndex, pendingDay);
+  }
+
+  if (nbPendingMinutes > 0 || hourPending || dayPending) {
+    NRF_LOG_WARNING("[ActivityHistory] Failed to write the history");
+  }
+  // Retried at the next flush : the minutes that cannot be kept in RAM are dropped
+  flushNeeded = false;
+  xSemaphoreGive(mutex);
+}
+
+bool ActivityHistory::OpenDay(uint32_t day, lfs_file_t& file) {
+  char name[32];
+  FileName(day, name, sizeof(name));
+
+  if (day != fileDay) {
+    Header header;
+    if (!ReadHeader(day, header) || header.day != day) {
+      // Overwrite the file of the day nbDetailedDays days ago
+      CreateDirectory(fs, "/.system");
+      CreateDirectory(fs, directory);
+      if (fs.FileOpen(&file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+        NRF_LOG_WARNING("[ActivityHistory] Failed to create the file of day %lu", day);
+        return false;
+      }
+      header = {magic, formatVersion, {}, day};
+      int result = fs.FileWrite(&file, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+      if (result != sizeof(header)) {
+        fs.FileClose(&file);
+        return false;
+      }
+      fileDay = day;
+      appendOffset = sizeof(header);
+      return true;
+    }
+    // After a reset, the last record may not be complete
+    int32_t size = ReadDay(
+      day,
+      [](uint16_t, Minute) {
+      },
+      [](uint8_t, const Summary&) {
+      });
+    if (size < 0) {
+      return false;
+    }
+    fileDay = day;
+    appendOffset = static_cast<uint32_t>(size);
+  }
+
+  if (fs.FileOpen(&file, name, LFS_O_WRONLY) != LFS_ERR_OK) {
+    return false;
+  }
+  fs.FileSeek(&file, appendOffset);
+  return true;
+}
+
+bool ActivityHistory::CloseDay(lfs_file_t& file) {
+  if (fs.FileClose(&file) != LFS_ERR_OK) {
+    fileDay = 0;
+    return false;
+  }
+  return true;
+}
+
+size_t ActivityHistory::EncodeMinutes(size_t count) {
+  uint8_t* payload = buffer.data() + 3;
+  WriteU16(payload, static_cast<uint16_t>(pendingFirstMinute % minutesPerDay));
+  payload[2] = static_cast<uint8_t>(count);
+  uint8_t* data = payload + 3;
+  uint8_t previousHeartRate = 0;
+  for (size_t i = 0; i < count; i++) {
+    const Minute& minute = pendingMinutes[i];
+    data = WriteVarint(data, (static_cast<uint32_t>(minute.steps) << 1) | (minute.heartRate != 0 ? 1 : 0));
+    if (minute.heartRate != 0) {
+      data = WriteVarint(data, ZigZag(minute.heartRate - previousHeartRate));
+      previousHeartRate = minute.heartRate;
+    }
+  }
+  return data - payload;
+}
+
+bool ActivityHistory::WriteHour(lfs_file_t& file, uint8_t hour, const Summary& summary) {
+  uint8_t* payload = buffer.data() + 3;
+  payload[0] = hour;
+  WriteSummary(payload + 1, summary);
+  return WriteRecord(file, recordHour, 1 + summarySize);
+}
+
+bool ActivityHistory::WriteRecord(lfs_file_t& file, uint8_t type, size_t payloadSize) {
+  buffer[0] = type;
+  WriteU16(buffer.data() + 1, payloadSize);
+  WriteU16(buffer.data() + 3 + payloadSize, Utility::Crc16(buffer.data(), 3 + payloadSize));
+  int size = payloadSize + recordOverhead;
+  if (fs.FileWrite(&file, buffer.data(), size) != size) {
+    return false;
+  }
+  appendOffset += size;
+  return true;
+}
+
+int ActivityHistory::ReadRecord(lfs_file_t& file, uint8_t& type) {
+  if (fs.FileRead(&file, buffer.data(), 3) != 3) {
+    return -1;
+  }
+  type = buffer[0];
+  uint16_t payloadSize = ReadU16(buffer.data() + 1);
+  if (payloadSize > maxPayloadSize) {
+    return -1;
+  }
+  int size = payloadSize + 2;
+  if (fs.FileRead(&file, buffer.data() + 3, size) != size ||
+      ReadU16(buffer.data() + 3 + payloadSize) != Utility::Crc16(buffer.data(), 3 + payloadSize)) {
+    return -1;
+  }
+  return payloadSize;
+}
+
+template <typename MinuteCallback, typename HourCallback>
+int32_t ActivityHistory::ReadDay(uint32_t day, MinuteCallback onMinute, HourCallback onHour) {
+  char name[32];
+  FileName(day, name, sizeof(name));
+  lfs_file_t file;
+  if (fs.FileOpen(&file, name, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return -1;
+  }
+  Header header;
+  if (fs.FileRead(&file, reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header) || header.magic != magic ||
+      header.version != formatVersion || header.day != day) {
+    fs.FileClose(&file);
+    return -1;
+  }
+
+  // A record that was not completely written marks the end of the file
+  int32_t size = sizeof(header);
+  uint8_t type;
+  int payloadSize;
+  while ((payloadSize = ReadRecord(file, type)) >= 0) {
+    size += payloadSize + recordOverhead;
+    const uint8_t* payload = buffer.data() + 3;
+    if (type == recordHour && payloadSize == 1 + summarySize && payload[0] < 24) {
+      onHour(payload[0], ReadSummary(payload + 1));
+    } else if (type == recordMinutes && payloadSize >= 3) {
+      uint16_t minute = ReadU16(payload);
+      uint8_t nbMinutes = payload[2];
+      const uint8_t* data = payload + 3;
+      const uint8_t* end = payload + payloadSize;
+      uint8_t heartRate = 0;
+      for (uint8_t i = 0; i < nbMinutes && minute < minutesPerDay; i++, minute++) {
+        uint32_t value;
+        data = ReadVarint(data, end, value);
+        if (data == nullptr) {
+          break;
+        }
+        Minute decoded {static_cast<uint16_t>(value >> 1), 0};
+        if ((value & 1) != 0) {
+          data = ReadVarint(data, end, value);
+          if (data == nullptr) {
+            break;
+          }
+          heartRate += UnZigZag(value);
+          decoded.heartRate = heartRate;
+        }
+        onMinute(minute, decoded);
+      }
+    }
+  }
+  fs.FileClose(&file);
+  return size;
+}
+
+bool ActivityHistory::ReadDaySlot(uint32_t day, Summary& summary) {
+  lfs_file_t file;
+  if (fs.FileOpen(&file, daysFileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return false;
+  }
+  uint8_t slot[daySlotSize];
+  fs.FileSeek(&file, (day % nbDays) * daySlotSize);
+  int result = fs.FileRead(&file, slot, sizeof(slot));
+  fs.FileClose(&file);
+  if (result != sizeof(slot) || ReadU16(slot) != static_cast<uint16_t>(day) ||
+      ReadU16(slot + daySlotSize - 2) != Utility::Crc16(slot, daySlotSize - 2)) {
+    return false;
+  }
+  summary = ReadSummary(slot + 2);
+  return true;
+}
+
+bool ActivityHistory::WriteDaySlot(uint32_t day, const Summary& summary) {
+  CreateDirectory(fs, "/.system");
+  CreateDirectory(fs, directory);
+  lfs_file_t file;
+  if (fs.FileOpen(&file, daysFileName, LFS_O_WRONLY | LFS_O_CREAT) != LFS_ERR_OK) {
+    return false;
+  }
+  uint8_t slot[daySlotSize];
+  WriteU16(slot, static_cast<uint16_t>(day));
+  WriteSummary(slot + 2, summary);
+  WriteU16(slot + daySlotSize - 2, Utility::Crc16(slot, daySlotSize - 2));
+  // The file is extended with zeros (invalid slots) if needed
+  fs.FileSeek(&file, (day % nbDays) * daySlotSize);
+  bool ok = fs.FileWrite(&file, slot, sizeof(slot)) == sizeof(slot);
+  return fs.FileClose(&file) == LFS_ERR_OK && ok;
+}
+
+size_t ActivityHistory::Days(uint32_t firstDay, Summary* summaries, size_t nb) {
+  nb = std::min(nb, nbDays);
+  std::fill(summaries, summaries + nb, Summary {});
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  lfs_file_t file;
+  if (fs.FileOpen(&file, daysFileName, LFS_O_RDONLY) == LFS_ERR_OK) {
+    // Read the slots in batches, the ring wraps at most once
+    constexpr size_t slotsPerRead = sizeof(buffer) / daySlotSize;
+    size_t i = 0;
+    while (i < nb) {
+      uint32_t slot = (firstDay + i) % nbDays;
+      size_t count = std::min({nb - i, slotsPerRead, nbDays - slot});
+      fs.FileSeek(&file, slot * daySlotSize);
+      int result = fs.FileRead(&file, buffer.data(), count * daySlotSize);
+      if (result <= 0) {
+        break;
+      }
+      count = std::min<size_t>(count, result / daySlotSize);
+      for (size_t j = 0; j < count; j++) {
+        const uint8_t* data = buffer.data() + j * daySlotSize;
+        uint32_t day = firstDay + i + j;
+        if (ReadU16(data) == static_cast<uint16_t>(day) && ReadU16(data + daySlotSize - 2) == Utility::Crc16(data, daySlotSize - 2)) {
+          summaries[i + j] = ReadSummary(data + 2);
+        }
+      }
+      if (count == 0) {
+        break;
+      }
+      i += count;
+    }
+    fs.FileClose(&file);
+  }
+
+  // The summaries that are not written yet
+  if (dayPending && pendingDayIndex - firstDay < nb) {
+    summaries[pendingDayIndex - firstDay] = pendingDay;
+  }
+  if (dayInProgress && currentDay - firstDay < nb) {
+    summaries[currentDay - firstDay] = daySummary;
+  }
+  xSemaphoreGive(mutex);
+
+  return std::count_if(summaries, summaries + nb, [](const Summary& summary) {
+    return !summary.IsEmpty();
+  });
+}
+
+size_t ActivityHistory::Hours(uint32_t day, std::array<Summary, 24>& summaries) {
+  summaries.fill({});
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  // An hour can have several records if the time was set back
+  ReadDay(
+    day,
+    [](uint16_t, Minute) {
+    },
+    [&summaries](uint8_t hour, const Summary& summary) {
+      summaries[hour].Add(summary);
+    });
+  if (hourPending && pendingHourDay == day) {
+    summaries[pendingHourIndex].Add(pendingHour);
+  }
+  if (hourInProgress && currentDay == day) {
+    summaries[currentHour].Add(hourSummary);
+  }
+  xSemaphoreGive(mutex);
+
+  return std::count_if(summaries.begin(), summaries.end(), [](const Summary& summary) {
+    return !summary.IsEmpty();
+  });
+}
+
+size_t ActivityHistory::Minutes(uint32_t day, uint16_t firstMinute, Minute* minutes, size_t nb) {
+  std::fill(minutes, minutes + nb, Minute {});
+  size_t count = 0;
+  auto onMinute = [firstMinute, minutes, nb, &count](uint16_t minute, Minute value) {
+    if (minute >= firstMinute && static_cast<size_t>(minute - firstMinute) < nb) {
+      minutes[minute - firstMinute] = value;
+      count++;
+    }
+  };
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  ReadDay(day, onMinute, [](uint8_t, const Summary&) {
+  });
+  for (uint8_t i = 0; i < nbPendingMinutes; i++) {
+    uint32_t minute = pendingFirstMinute + i;
+    if (minute / minutesPerDay == day) {
+      onMinute(static_cast<uint16_t>(minute % minutesPerDay), pendingMinutes[i]);
+    }
+  }
+  xSemaphoreGive(mutex);
+  return count;
+}
+
+void ActivityHistory::RecordedRange(uint32_t& begin, uint32_t& end) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint32_t lastMinute = lastRecordedMinute;
+  xSemaphoreGive(mutex);
+
+  if (lastMinute == 0) {
+    begin = 0;
+    end = 0;
+    return;
+  }
+  uint32_t lastDay = lastMinute / minutesPerDay;
+  begin = (lastDay < nbDetailedDays - 1) ? 0 : (lastDay - (nbDetailedDays - 1)) * minutesPerDay;
+  end = lastMinute + 1;
+}
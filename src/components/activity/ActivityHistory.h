@@ -0,0 +1,201 @@
+#pragma once
+
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include <littlefs/lfs.h>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Controllers {
+    class FS;
+
+    /* Long-term history of the steps and of the heart rate, stored in the filesystem.
+     *
+     * The steps and the last heart rate reading are recorded every minute. The minutes are kept in RAM, and appended to
+     * the file of the current day at the end of each hour (and before the SPI flash goes to sleep). The files of the
+     * last nbDetailedDays days are used as a ring, indexed by the day.
+     *
+     * Day file : header, then records : type (u8), size of the payload (u16), payload, CRC16 (u16)
+     *  - minutes : first minute of the day (u16), number of minutes (u8), then for each minute :
+     *              varint(steps << 1 | has heart rate), zigzag varint(heart rate - previous heart rate of the record)
+     *  - hour : hour of the day (u8), summary of the hour
+     *
+     * The summary of each day is written to a ring of nbDays fixed-size slots (days.dat), so that the history of the
+     * last year can be read with a single read. A record or a slot that was not completely written fails the CRC check.
+     * The summaries are derived from the minutes : the missing ones (reset before they were written) are rebuilt by
+     * Init().
+     *
+     * All the times are local, in minutes/days since the epoch. Minutes older than the last recorded one (the time was
+     * set back) are ignored.
+     */
+    class ActivityHistory {
+    public:
+      struct Summary {
+        uint32_t steps = 0;
+        uint32_t heartRateSum = 0;
+        uint16_t heartRateMinutes = 0;
+        uint8_t minHeartRate = 0;
+        uint8_t maxHeartRate = 0;
+
+        void Add(uint16_t minuteSteps, uint8_t heartRate);
+        void Add(const Summary& other);
+
+        // 0 if there was no heart rate reading
+        uint8_t AverageHeartRate() const {
+          return heartRateMinutes == 0 ? 0 : static_cast<uint8_t>(heartRateSum / heartRateMinutes);
+        }
+
+        bool IsEmpty() const {
+          return steps == 0 && heartRateMinutes == 0;
+        }
+      };
+
+      struct Minute {
+        uint16_t steps = 0;
+        uint8_t heartRate = 0; // 0 : no reading during this minute
+      };
+
+      static constexpr size_t minutesPerDay = 24 * 60;
+      static constexpr size_t nbDetailedDays = 32;
+      static constexpr size_t nbDays = 366;
+
+      explicit ActivityHistory(Controllers::FS& fs);
+
+      // The filesystem must be initialized
+      void Init();
+
+      /* Must be called at least once per minute.
+       * nbSteps : steps counted today. heartRate : last reading of the heart rate, recorded if nbHeartRateReadings
+       * changed during the minute.
+       */
+      void Update(std::chrono::minutes localTime, uint32_t nbSteps, uint8_t heartRate, uint32_t nbHeartRateReadings);
+
+      // True when the minutes and summaries kept in RAM must be written
+      bool IsFlushNeeded() const {
+        return flushNeeded;
+      }
+
+      // Writes the minutes and summaries kept in RAM, the SPI flash must be awake
+      void Flush();
+
+      // Summaries of the days [firstDay, firstDay + nb), which must be within the last nbDays days. Returns the number of
+      // days with some activity.
+      size_t Days(uint32_t firstDay, Summary* summaries, size_t nb);
+      // Summaries of the hours of the specified day, which must be within the last nbDetailedDays days
+      size_t Hours(uint32_t day, std::array<Summary, 24>& summaries);
+      // Minutes [firstMinute, firstMinute + nb) of the specified day, which must be within the last nbDetailedDays days
+      size_t Minutes(uint32_t day, uint16_t firstMinute, Minute* minutes, size_t nb);
+      // Range [begin, end) of the minutes that can be read with Minutes() : from the start of the oldest detailed day to
+      // the last recorded minute. Empty if nothing was recorded yet.
+      void RecordedRange(uint32_t& begin, uint32_t& end);
+
+      static uint32_t Day(std::chrono::minutes localTime) {
+        return static_cast<uint32_t>(localTime.count() / minutesPerDay);
+      }
+
+    private:
+      static constexpr uint32_t magic = 0x48414954; // "TIAH"
+      static constexpr uint8_t formatVersion = 1;
+      static constexpr uint8_t recordMinutes = 1;
+      static constexpr uint8_t recordHour = 2;
+      // The minutes are written by records of one hour at most
+      static constexpr size_t maxRecordMinutes = 60;
+      // The minutes are kept when a flush fails, until they are written by the next one
+      static constexpr size_t maxPendingMinutes = 2 * maxRecordMinutes;
+      static constexpr size_t summarySize = 12;
+      // varint of the steps (3 bytes) and zigzag varint of the heart rate (2 bytes)
+      static constexpr size_t maxMinuteSize = 5;
+      static constexpr size_t recordOverhead = 1 + 2 + 2;
+      static constexpr size_t maxPayloadSize = 3 + maxRecordMinutes * maxMinuteSize;
+      static constexpr size_t daySlotSize = 2 + summarySize + 2;
+
+      struct Header {
+        uint32_t magic;
+        uint8_t version;
+        uint8_t reserved[3];
+        uint32_t day;
+      };
+
+      // Summaries and minutes found in a day file
+      struct Scan {
+        Summary day;
+        Summary lastHour;
+        uint8_t lastHourIndex = 0;
+        uint16_t lastMinute = 0;
+        bool hasMinutes = false;
+        uint32_t hoursWithMinutes = 0;
+        uint32_t hoursWithRecord = 0;
+      };
+
+      Controllers::FS& fs;
+      SemaphoreHandle_t mutex = nullptr;
+
+      // Minute in progress
+      uint32_t currentMinute = 0; // 0 : none
+      uint32_t minuteStartSteps = 0;
+      uint32_t minuteStartReadings = 0;
+      // Last minute recorded, minutes up to this one are ignored
+      uint32_t lastRecordedMinute = 0;
+
+      // Summaries in progress
+      bool dayInProgress = false;
+      bool hourInProgress = false;
+      uint32_t currentDay = 0;
+      uint8_t currentHour = 0;
+      Summary daySummary;
+      Summary hourSummary;
+
+      // Consecutive minutes not written yet
+      std::array<Minute, maxPendingMinutes> pendingMinutes;
+      uint32_t pendingFirstMinute = 0; // since the epoch
+      uint8_t nbPendingMinutes = 0;
+
+      // Completed summaries not written yet
+      bool hourPending = false;
+      uint32_t pendingHourDay = 0;
+      uint8_t pendingHourIndex = 0;
+      Summary pendingHour;
+      bool dayPending = false;
+      uint32_t pendingDayIndex = 0;
+      Summary pendingDay;
+
+      bool flushNeeded = false;
+      // Day stored in the file that is currently appended, 0 if it must be created or scanned
+      uint32_t fileDay = 0;
+      // End of the valid records of this file : a record that was not completely written is overwritten by the next one
+      uint32_t appendOffset = 0;
+
+      std::array<uint8_t, maxPayloadSize + recordOverhead> buffer;
+
+      static void FileName(uint32_t day, char* name, size_t size);
+      void CloseMinute(uint32_t minute, uint16_t steps, uint8_t heartRate);
+      void DropPendingMinutes(size_t count);
+      void EndHour();
+      void EndDay();
+
+      bool ReadHeader(uint32_t day, Header& header);
+      // Opens the file of the specified day for appending, it is created if it does not contain this day
+      bool OpenDay(uint32_t day, lfs_file_t& file);
+      // The file is scanned again by the next OpenDay() if the records could not be committed
+      bool CloseDay(lfs_file_t& file);
+      // Encodes the first count pending minutes, which must be in the same day
+      size_t EncodeMinutes(size_t count);
+      bool WriteRecord(lfs_file_t& file, uint8_t type, size_t payloadSize);
+      bool WriteHour(lfs_file_t& file, uint8_t hour, const Summary& summary);
+      // Reads the next record of the file into buffer, returns the size of its payload, or -1 at the end of the valid
+      // records
+      int ReadRecord(lfs_file_t& file, uint8_t& type);
+
+      // Calls onMinute(minuteOfDay, minute) for each recorded minute, and onHour(hour, summary) for each hour record.
+      // Returns the size of the header and of the valid records, -1 if the file does not contain this day.
+      template <typename MinuteCallback, typename HourCallback>
+      int32_t ReadDay(uint32_t day, MinuteCallback onMinute, HourCallback onHour);
+      void Recover(uint32_t day, bool isLatest);
+      bool ReadDaySlot(uint32_t day, Summary& summary);
+      bool WriteDaySlot(uint32_t day, const Summary& summary);
+    };
+  }
+}
@@ -0,0 +1,97 @@
+#include "components/ble/ActivityRecordBatch.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  size_t WriteVarint(uint8_t* data, uint32_t value) {
+    size_t size = 0;
+    while (value >= 0x80) {
+      data[size++] = static_cast<uint8_t>(value) | 0x80;
+      value >>= 7;
+    }
+    data[size++] = static_cast<uint8_t>(value);
+    return size;
+  }
+
+  size_t VarintSize(uint32_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+      value >>= 7;
+      size++;
+    }
+    return size;
+  }
+
+  uint32_t ZigZag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+  }
+}
+
+void ActivityRecordBatch::Start(uint32_t firstMinute) {
+  this->firstMinute = firstMinute;
+  count = 0;
+  runLength = 0;
+  previousHeartRate = 0;
+  size = headerSize;
+}
+
+size_t ActivityRecordBatch::RunSize(uint16_t length) const {
+  return (length == 0) ? 0 : 1 + VarintSize(length - 1);
+}
+
+bool ActivityRecordBatch::Append(const ActivityHistory::Minute& minute, size_t sizeLimit) {
+  sizeLimit = std::min(sizeLimit, maxSize);
+  if (size < headerSize || count == UINT16_MAX) {
+    return false;
+  }
+
+  if (minute.steps == 0 && minute.heartRate == 0) {
+    if (size + RunSize(runLength + 1) > sizeLimit) {
+      return false;
+    }
+    runLength++;
+    count++;
+    return true;
+  }
+
+  // varint of the steps (3 bytes) and zigzag varint of the heart rate (2 bytes)
+  uint8_t entry[5];
+  size_t entrySize = WriteVarint(entry, (static_cast<uint32_t>(minute.steps) << 1) | (minute.heartRate != 0 ? 1 : 0));
+  if (minute.heartRate != 0) {
+    entrySize += WriteVarint(entry + entrySize, ZigZag(minute.heartRate - previousHeartRate));
+  }
+  if (size + RunSize(runLength) + entrySize > sizeLimit) {
+    return false;
+  }
+
+  if (runLength > 0) {
+    buffer[size++] = 0;
+    size += WriteVarint(buffer + size, runLength - 1);
+    runLength = 0;
+  }
+  std::memcpy(buffer + size, entry, entrySize);
+  size += entrySize;
+  if (minute.heartRate != 0) {
+    previousHeartRate = minute.heartRate;
+  }
+  count++;
+  return true;
+}
+
+void ActivityRecordBatch::Finish(bool isEnd) {
+  if (runLength > 0) {
+    buffer[size++] = 0;
+    size += WriteVarint(buffer + size, runLength - 1);
+    runLength = 0;
+  }
+
+  buffer[0] = isEnd ? flagEnd : 0;
+  buffer[1] = static_cast<uint8_t>(count);
+  buffer[2] = static_cast<uint8_t>(count >> 8);
+  buffer[3] = static_cast<uint8_t>(firstMinute);
+  buffer[4] = static_cast<uint8_t>(firstMinute >> 8);
+  buffer[5] = static_cast<uint8_t>(firstMinute >> 16);
+  buffer[6] = static_cast<uint8_t>(firstMinute >> 24);
+}
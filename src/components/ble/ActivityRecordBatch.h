@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "components/activity/ActivityHistory.h"
+
+namespace Pinetime {
+  namespace Controllers {
+    /* Packs consecutive minutes of the activity history into the payload of a single notification
+     * (see doc/ActivitySyncService.md, "Records").
+     *
+     * Header (7 bytes) : flags (u8), number of minutes (u16), first minute since the epoch, local time (u32)
+     * Then for each minute with some activity : varint(steps << 1 | has heart rate), followed by
+     * zigzag varint(heart rate - previous heart rate of the batch) if it has a heart rate.
+     * A run of n minutes without activity is stored as 0x00 followed by varint(n - 1).
+     */
+    class ActivityRecordBatch {
+    public:
+      static constexpr size_t headerSize = 7;
+      static constexpr size_t maxSize = 253; // ATT payload for the preferred MTU (256)
+      // No more minutes were recorded after this batch
+      static constexpr uint8_t flagEnd = 0x01;
+
+      void Start(uint32_t firstMinute);
+
+      // Returns false if the minute does not fit in sizeLimit bytes, in which case the batch must be sent and a new one
+      // started.
+      bool Append(const ActivityHistory::Minute& minute, size_t sizeLimit);
+
+      // Writes the header and the pending run of empty minutes, the batch can be sent after this call
+      void Finish(bool isEnd);
+
+      uint32_t FirstMinute() const {
+        return firstMinute;
+      }
+
+      // Minute following the last one of the batch, which is the cursor to acknowledge once the batch is stored
+      uint32_t NextMinute() const {
+        return firstMinute + count;
+      }
+
+      const uint8_t* Data() const {
+        return buffer;
+      }
+
+      size_t Size() const {
+        return size;
+      }
+
+    private:
+      size_t RunSize(uint16_t length) const;
+
+      uint8_t buffer[maxSize];
+      size_t size = 0;
+      uint16_t count = 0;
+      uint32_t firstMinute = 0;
+      uint8_t previousHeartRate = 0;
+      // Empty minutes at the end of the batch that are not written yet
+      uint16_t runLength = 0;
+    };
+  }
+}
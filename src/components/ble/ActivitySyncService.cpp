@@ -0,0 +1,324 @@
+#include "components/ble/ActivitySyncService.h"
+#include <algorithm>
+#include <nrf_log.h>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_hs.h>
+#include <nimble/nimble_port.h>
+#undef max
+#undef min
+#include "components/ble/MbufReader.h"
+#include "components/ble/NimbleController.h"
+#include "components/fs/FS.h"
+#include "systemtask/SystemTask.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr const char* fileName = "/.system/activitysync.dat";
+
+  // Client Characteristic Configuration Descriptor Improperly Configured (Core Specification Supplement, part B)
+  constexpr int errorNotSubscribed = 0xFD;
+  // Delay before sending again when the buffers are used, about one connection interval
+  constexpr uint32_t retryDelay = 30; // ms
+
+  // 0008yyxx-78fc-48fe-8e23-433b3a1942d0
+  constexpr ble_uuid128_t CharUuid(uint8_t x, uint8_t y) {
+    return ble_uuid128_t {.u = {.type = BLE_UUID_TYPE_128},
+                          .value = {0xd0, 0x42, 0x19, 0x3a, 0x3b, 0x43, 0x23, 0x8e, 0xfe, 0x48, 0xfc, 0x78, x, y, 0x08, 0x00}};
+  }
+
+  // 00080000-78fc-48fe-8e23-433b3a1942d0
+  constexpr ble_uuid128_t BaseUuid() {
+    return CharUuid(0x00, 0x00);
+  }
+
+  constexpr ble_uuid128_t activitySyncServiceUuid {BaseUuid()};
+  constexpr ble_uuid128_t recordsCharUuid {CharUuid(0x01, 0x00)};
+  constexpr ble_uuid128_t controlPointCharUuid {CharUuid(0x02, 0x00)};
+  constexpr ble_uuid128_t statusCharUuid {CharUuid(0x03, 0x00)};
+
+  int ActivitySyncServiceCallback(uint16_t /*conn_handle*/, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    auto* activitySyncService = static_cast<ActivitySyncService*>(arg);
+    return activitySyncService->OnCommand(attr_handle, ctxt);
+  }
+
+  void FlashAvailableCallback(struct ble_npl_event* event) {
+    auto* activitySyncService = static_cast<ActivitySyncService*>(ble_npl_event_get_arg(event));
+    activitySyncService->OnFlashAvailableEvent();
+  }
+
+  void RetryCallback(struct ble_npl_event* event) {
+    auto* activitySyncService = static_cast<ActivitySyncService*>(ble_npl_event_get_arg(event));
+    activitySyncService->Process();
+  }
+
+  uint8_t* Put32(uint8_t* data, uint32_t value) {
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+    data[2] = static_cast<uint8_t>(value >> 16);
+    data[3] = static_cast<uint8_t>(value >> 24);
+    return data + 4;
+  }
+}
+
+ActivitySyncService::ActivitySyncService(NimbleController& nimble, System::SystemTask& systemTask, ActivityHistory& history, FS& fs)
+  : nimble {nimble},
+    systemTask {systemTask},
+    history {history},
+    fs {fs},
+    characteristicDefinition {{.uuid = &recordsCharUuid.u,
+                               .access_cb = ActivitySyncServiceCallback,
+                               .arg = this,
+                               .flags = BLE_GATT_CHR_F_NOTIFY,
+                               .val_handle = &recordsHandle},
+                              {.uuid = &controlPointCharUuid.u,
+                               .access_cb = ActivitySyncServiceCallback,
+                               .arg = this,
+                               .flags = BLE_GATT_CHR_F_WRITE,
+                               .val_handle = &controlPointHandle},
+                              {.uuid = &statusCharUuid.u,
+                               .access_cb = ActivitySyncServiceCallback,
+                               .arg = this,
+                               .flags = BLE_GATT_CHR_F_READ,
+                               .val_handle = &statusHandle},
+                              {0}},
+    serviceDefinition {
+      {.type = BLE_GATT_SVC_TYPE_PRIMARY, .uuid = &activitySyncServiceUuid.u, .characteristics = characteristicDefinition},
+      {0},
+    } {
+}
+
+void ActivitySyncService::Init() {
+  int res = 0;
+  res = ble_gatts_count_cfg(serviceDefinition);
+  ASSERT(res == 0);
+
+  res = ble_gatts_add_svcs(serviceDefinition);
+  ASSERT(res == 0);
+
+  ble_npl_event_init(&flashAvailableEvent, FlashAvailableCallback, this);
+  ble_npl_callout_init(&retryCallout, nimble_port_get_dflt_eventq(), RetryCallback, this);
+
+  // The filesystem is initialized and the SPI flash is awake at boot
+  LoadCursor();
+}
+
+void ActivitySyncService::LoadCursor() {
+  lfs_file_t file;
+  if (fs.FileOpen(&file, fileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return;
+  }
+  StoredCursor stored;
+  int bytesRead = fs.FileRead(&file, reinterpret_cast<uint8_t*>(&stored), sizeof(stored));
+  fs.FileClose(&file);
+  if (bytesRead != static_cast<int>(sizeof(stored)) || stored.version != fileFormatVersion) {
+    NRF_LOG_WARNING("[ActivitySync] Invalid cursor file, discarding");
+    return;
+  }
+  ackCursor = stored.cursor;
+  NRF_LOG_INFO("[ActivitySync] Acknowledged cursor : %lu", ackCursor);
+}
+
+void ActivitySyncService::PersistCursor() {
+  // Not retried on failure, the client will acknowledge again
+  ackDirty = false;
+
+  lfs_dir systemDir;
+  if (fs.DirOpen("/.system", &systemDir) != LFS_ERR_OK) {
+    fs.DirCreate("/.system");
+  }
+  fs.DirClose(&systemDir);
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, fileName, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+    NRF_LOG_WARNING("[ActivitySync] Failed to open cursor file for saving");
+    return;
+  }
+  StoredCursor stored {fileFormatVersion, ackCursor};
+  fs.FileWrite(&file, reinterpret_cast<const uint8_t*>(&stored), sizeof(stored));
+  fs.FileClose(&file);
+}
+
+int ActivitySyncService::OnCommand(uint16_t attributeHandle, ble_gatt_access_ctxt* context) {
+  if (attributeHandle == statusHandle) {
+    uint32_t begin;
+    uint32_t end;
+    history.RecordedRange(begin, end);
+    uint8_t status[14];
+    uint8_t* data = status;
+    *data++ = protocolVersion;
+    *data++ = streaming ? 1 : 0;
+    data = Put32(data, ackCursor);
+    data = Put32(data, begin);
+    Put32(data, end);
+    int res = os_mbuf_append(context->om, status, sizeof(status));
+    return (res == 0) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+  }
+  if (attributeHandle != controlPointHandle || context->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+    return 0;
+  }
+
+  MbufReader reader {context->om};
+  auto command = static_cast<Commands>(reader.ReadU8());
+  switch (command) {
+    case Commands::Start: {
+      uint32_t from = reader.ReadU32();
+      if (!reader.IsValid() || reader.Remaining() != 0) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+      }
+      if (!recordsNotificationEnabled) {
+        return errorNotSubscribed;
+      }
+      cursor = (from == acknowledgedCursor) ? ackCursor : from;
+      streaming = true;
+      cacheCount = 0;
+      NRF_LOG_INFO("[ActivitySync] Start from %lu", cursor);
+      break;
+    }
+    case Commands::Acknowledge: {
+      uint32_t acknowledged = reader.ReadU32();
+      if (!reader.IsValid() || reader.Remaining() != 0) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+      }
+      uint32_t begin;
+      uint32_t end;
+      history.RecordedRange(begin, end);
+      acknowledged = std::min(acknowledged, end);
+      if (acknowledged != ackCursor) {
+        ackCursor = acknowledged;
+        ackDirty = true;
+      }
+      break;
+    }
+    case Commands::Stop:
+      if (!reader.IsValid() || reader.Remaining() != 0) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+      }
+      streaming = false;
+      break;
+    default:
+      return BLE_ATT_ERR_REQ_NOT_SUPPORTED;
+  }
+
+  Process();
+  return 0;
+}
+
+void ActivitySyncService::RequestFlash() {
+  if (!flashRequested) {
+    flashRequested = true;
+    systemTask.PushMessage(Pinetime::System::Messages::StartActivitySync);
+  }
+}
+
+void ActivitySyncService::OnFlashAvailable() {
+  // The history can only be streamed safely from the BLE host task
+  ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &flashAvailableEvent);
+}
+
+void ActivitySyncService::OnFlashAvailableEvent() {
+  if (flashRequested) {
+    flashAvailable = true;
+    Process();
+  }
+}
+
+void ActivitySyncService::Process() {
+  if (!streaming && !ackDirty) {
+    // Release the SPI flash once it was confirmed awake, so that the requests are paired with the releases
+    if (flashAvailable) {
+      flashRequested = false;
+      flashAvailable = false;
+      systemTask.PushMessage(Pinetime::System::Messages::StopActivitySync);
+    }
+    return;
+  }
+
+  RequestFlash();
+  if (!flashAvailable) {
+    return;
+  }
+  if (ackDirty) {
+    PersistCursor();
+  }
+  if (streaming) {
+    SendBatches();
+  }
+  if (!streaming && !ackDirty) {
+    Process();
+  }
+}
+
+const ActivityHistory::Minute& ActivitySyncService::ReadMinute(uint32_t minute, uint32_t end) {
+  if (minute < cacheFirstMinute || minute - cacheFirstMinute >= cacheCount) {
+    // The minutes of a day are stored in the same file, they are read up to the end of the day
+    uint32_t day = minute / ActivityHistory::minutesPerDay;
+    auto minuteOfDay = static_cast<uint16_t>(minute % ActivityHistory::minutesPerDay);
+    cacheCount = std::min<size_t>({cache.size(), ActivityHistory::minutesPerDay - minuteOfDay, end - minute});
+    cacheFirstMinute = minute;
+    history.Minutes(day, minuteOfDay, cache.data(), cacheCount);
+  }
+  return cache[minute - cacheFirstMinute];
+}
+
+void ActivitySyncService::SendBatches() {
+  uint16_t connectionHandle = nimble.connHandle();
+  if (connectionHandle == BLE_HS_CONN_HANDLE_NONE || !recordsNotificationEnabled) {
+    streaming = false;
+    return;
+  }
+  size_t sizeLimit = ble_att_mtu(connectionHandle) - 3;
+
+  while (streaming) {
+    if (os_msys_num_free() < minFreeBuffers) {
+      ble_npl_callout_reset(&retryCallout, ble_npl_time_ms_to_ticks32(retryDelay));
+      return;
+    }
+
+    // Only the closed minutes are sent, they do not change anymore
+    uint32_t begin;
+    uint32_t end;
+    history.RecordedRange(begin, end);
+    // The minutes older than the detailed days are lost, the client sees the gap in the first minute of the batch
+    cursor = std::clamp(cursor, begin, end);
+
+    batch.Start(cursor);
+    while (batch.NextMinute() < end && batch.Append(ReadMinute(batch.NextMinute(), end), sizeLimit)) {
+    }
+    bool isEnd = batch.NextMinute() >= end;
+    batch.Finish(isEnd);
+
+    auto* om = ble_hs_mbuf_from_flat(batch.Data(), batch.Size());
+    if (om == nullptr || ble_gattc_notify_custom(connectionHandle, recordsHandle, om) != 0) {
+      // Out of buffers (the mbuf is freed on failure), the same batch is built again later
+      ble_npl_callout_reset(&retryCallout, ble_npl_time_ms_to_ticks32(retryDelay));
+      return;
+    }
+    cursor = batch.NextMinute();
+    if (isEnd) {
+      NRF_LOG_INFO("[ActivitySync] Caught up at %lu", cursor);
+      streaming = false;
+    }
+  }
+}
+
+void ActivitySyncService::OnDisconnected() {
+  streaming = false;
+  ble_npl_callout_stop(&retryCallout);
+  Process();
+}
+
+void ActivitySyncService::SubscribeNotification(uint16_t attributeHandle) {
+  if (attributeHandle == recordsHandle) {
+    recordsNotificationEnabled = true;
+  }
+}
+
+void ActivitySyncService::UnsubscribeNotification(uint16_t attributeHandle) {
+  if (attributeHandle == recordsHandle) {
+    recordsNotificationEnabled = false;
+    streaming = false;
+    Process();
+  }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_gap.h>
+#include <nimble/nimble_npl.h>
+#undef max
+#undef min
+#include "components/activity/ActivityHistory.h"
+#include "components/ble/ActivityRecordBatch.h"
+
+namespace Pinetime {
+  namespace System {
+    class SystemTask;
+  }
+
+  namespace Controllers {
+    class NimbleController;
+    class FS;
+
+    /* Streams the minutes of the activity history (steps and heart rate) from a cursor chosen by the client, in batches
+     * as large as the MTU. The client acknowledges the minutes it has stored, and the acknowledged cursor is persisted
+     * so that an interrupted sync can be resumed without sending the data again. The protocol is described in
+     * doc/ActivitySyncService.md.
+     *
+     * The SPI flash is kept awake by the system task while the history is read, without waking the rest of the watch.
+     * All the methods must be called from the BLE host task, except OnFlashAvailable().
+     */
+    class ActivitySyncService {
+    public:
+      ActivitySyncService(NimbleController& nimble, System::SystemTask& systemTask, ActivityHistory& history, FS& fs);
+      void Init();
+
+      int OnCommand(uint16_t attributeHandle, ble_gatt_access_ctxt* context);
+      void OnDisconnected();
+
+      void SubscribeNotification(uint16_t attributeHandle);
+      void UnsubscribeNotification(uint16_t attributeHandle);
+
+      // Called by the system task once the SPI flash can be used, from any task
+      void OnFlashAvailable();
+      void OnFlashAvailableEvent();
+      void Process();
+
+      static constexpr uint8_t protocolVersion = 1;
+      // Start streaming from the acknowledged cursor
+      static constexpr uint32_t acknowledgedCursor = UINT32_MAX;
+
+    private:
+      enum class Commands : uint8_t { Start = 0x01, Acknowledge = 0x02, Stop = 0x03 };
+
+      // The batches are queued in the host as long as this number of mbufs is left for the other services
+      static constexpr int minFreeBuffers = 4;
+      static constexpr size_t cacheSize = 60;
+      static constexpr uint8_t fileFormatVersion = 1;
+
+      struct StoredCursor {
+        uint8_t version;
+        uint32_t cursor;
+      };
+
+      void LoadCursor();
+      void PersistCursor();
+      void RequestFlash();
+      void SendBatches();
+      const ActivityHistory::Minute& ReadMinute(uint32_t minute, uint32_t end);
+
+      NimbleController& nimble;
+      System::SystemTask& systemTask;
+      ActivityHistory& history;
+      FS& fs;
+
+      struct ble_gatt_chr_def characteristicDefinition[4];
+      struct ble_gatt_svc_def serviceDefinition[2];
+
+      uint16_t recordsHandle;
+      uint16_t controlPointHandle;
+      uint16_t statusHandle;
+      bool recordsNotificationEnabled = false;
+
+      bool streaming = false;
+      uint32_t cursor = 0;
+
+      uint32_t ackCursor = 0;
+      bool ackDirty = false;
+
+      // The system task was asked to keep the SPI flash awake, and confirmed it
+      bool flashRequested = false;
+      bool flashAvailable = false;
+
+      ActivityRecordBatch batch;
+      // Minutes read from the history, they are read one hour at most at a time
+      std::array<ActivityHistory::Minute, cacheSize> cache;
+      uint32_t cacheFirstMinute = 0;
+      size_t cacheCount = 0;
+
+      ble_npl_event flashAvailableEvent {};
+      ble_npl_callout retryCallout {};
+    };
+  }
+}
@@ -0,0 +1,40 @@
+#include "components/ble/AdvertisingScheduler.h"
+
+using namespace Pinetime::Controllers;
+
+int32_t AdvertisingScheduler::BurstDuration(Events event) {
+  switch (event) {
+    case Events::WakeUp:
+      // The user is looking at the watch, the phone is probably nearby
+      return 10 * 1000;
+    case Events::Disconnected:
+      // Give the phone time to come back in range
+      return 30 * 1000;
+    case Events::Start:
+    default:
+      return 30 * 1000;
+  }
+}
+
+void AdvertisingScheduler::OnEvent(Events event) {
+  step = 0;
+  burstDurationMs = BurstDuration(event);
+}
+
+AdvertisingScheduler::Parameters AdvertisingScheduler::Next(bool hasBonds) {
+  Parameters parameters;
+  if (step == 0) {
+    parameters = {fastInterval, fastInterval + intervalRange, burstDurationMs, true};
+  } else {
+    const auto& backOffStep = backOff[step - 1];
+    parameters = {backOffStep.interval,
+                  static_cast<uint16_t>(backOffStep.interval + intervalRange),
+                  backOffStep.durationMs,
+                  !hasBonds};
+  }
+
+  if (step < backOff.size()) {
+    step++;
+  }
+  return parameters;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Controllers {
+    /* Chooses the advertising interval and duration.
+     *
+     * Advertising starts with a short burst at a fast interval, so that a phone nearby connects quickly. If nobody
+     * connects, the interval is doubled at each step of the back-off, each step lasting twice as long as the previous
+     * one, until the slow interval is reached. A new burst is started when the watch wakes up, when a connection is
+     * lost and when the radio is enabled.
+     *
+     * Only the bursts advertise the services (full payload) so that new companion apps can find the watch. Bonded
+     * phones reconnect using the address of the watch, so the reduced payload (flags only) is enough for them.
+     */
+    class AdvertisingScheduler {
+    public:
+      enum class Events : uint8_t { Start, WakeUp, Disconnected };
+
+      struct Parameters {
+        uint16_t intervalMin; // in units of 0.625ms
+        uint16_t intervalMax;
+        int32_t durationMs; // forever if 0
+        bool fullPayload;
+      };
+
+      // Starts a new burst of fast advertising
+      void OnEvent(Events event);
+
+      // Parameters of the next advertising period, moves to the next step of the back-off. The payload is only
+      // reduced outside of the bursts, when a phone is bonded.
+      Parameters Next(bool hasBonds);
+
+    private:
+      struct Step {
+        uint16_t interval;
+        int32_t durationMs;
+      };
+
+      static constexpr uint16_t fastInterval = 32; // 20ms
+      static constexpr uint16_t intervalRange = 15;
+      // 70s faster than the slow interval in total : each back-off costs about 1mC more than advertising slowly
+      // (see tests/AdvertisingSchedulerTest.cpp)
+      static constexpr std::array<Step, 4> backOff {{
+        {244, 10 * 1000}, // 152.5ms
+        {488, 20 * 1000}, // 305ms
+        {976, 40 * 1000}, // 610ms
+        {1636, 0},        // 1022.5ms, until the next burst
+      }};
+
+      static int32_t BurstDuration(Events event);
+
+      uint8_t step = 0; // 0 : burst, then the steps of the back-off
+      int32_t burstDurationMs = BurstDuration(Events::Start);
+    };
+  }
+}
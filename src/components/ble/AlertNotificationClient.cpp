@@ -1,5 +1,6 @@
 #include "components/ble/AlertNotificationClient.h"
 #include <algorithm>
+#include "components/ble/MbufReader.h"
 #include "components/ble/NotificationManager.h"
 #include "systemtask/SystemTask.h"
 #include <nrf_log.h>
@@ -39,6 +40,11 @@ namespace {
     auto client = static_cast<AlertNotificationClient*>(arg);
     return client->OnNewAlertSubcribe(conn_handle, error);
   }
+
+  int CachedNewAlertSubcribeCallback(uint16_t conn_handle, const struct ble_gatt_error* error, struct ble_gatt_attr* /*attr*/, void* arg) {
+    auto client = static_cast<AlertNotificationClient*>(arg);
+    return client->OnCachedNewAlertSubcribe(conn_handle, error);
+  }
 }
 
 AlertNotificationClient::AlertNotificationClient(Pinetime::System::SystemTask& systemTask,
@@ -54,6 +60,7 @@ bool AlertNotificationClient::OnDiscoveryEvent(uint16_t connectionHandle, const
       ble_gattc_disc_all_chrs(connectionHandle, ansStartHandle, ansEndHandle, OnAlertNotificationCharacteristicDiscoveredCallback, this);
     } else {
       NRF_LOG_INFO("ANS not found");
+      isComplete = true;
       onServiceDiscovered(connectionHandle);
     }
     return true;
@@ -110,6 +117,7 @@ int AlertNotificationClient::OnCharacteristicsDiscoveryEvent(uint16_t connection
 int AlertNotificationClient::OnNewAlertSubcribe(uint16_t connectionHandle, const ble_gatt_error* error) {
   if (error->status == 0) {
     NRF_LOG_INFO("ANS New alert subscribe OK");
+    isComplete = true;
   } else {
     NRF_LOG_INFO("ANS New alert subscribe ERROR");
   }
@@ -118,6 +126,24 @@ int AlertNotificationClient::OnNewAlertSubcribe(uint16_t connectionHandle, const
   return 0;
 }
 
+int AlertNotificationClient::OnCachedNewAlertSubcribe(uint16_t connectionHandle, const ble_gatt_error* error) {
+  if (error->status == 0) {
+    NRF_LOG_INFO("ANS New alert subscribe OK (cached handles)");
+    isComplete = true;
+    onServiceDiscovered(connectionHandle);
+  } else {
+    NRF_LOG_INFO("[ANS] Cached handles are not valid (%d), starting discovery", error->status);
+    FallBackToDiscovery(connectionHandle);
+  }
+
+  return 0;
+}
+
+void AlertNotificationClient::FallBackToDiscovery(uint16_t connectionHandle) {
+  Reset();
+  Discover(connectionHandle, onServiceDiscovered);
+}
+
 int AlertNotificationClient::OnDescriptorDiscoveryEventCallback(uint16_t connectionHandle,
                                                                 const ble_gatt_error* error,
                                                                 uint16_t characteristicValueHandle,
@@ -143,25 +169,22 @@ int AlertNotificationClient::OnDescriptorDiscoveryEventCallback(uint16_t connect
 
 void AlertNotificationClient::OnNotification(ble_gap_event* event) {
   if (event->notify_rx.attr_handle == newAlertHandle) {
-    constexpr size_t stringTerminatorSize = 1; // end of string '\0'
     constexpr size_t headerSize = 3;
     const auto maxMessageSize {NotificationManager::MaximumMessageSize()};
-    const auto maxBufferSize {maxMessageSize + headerSize};
 
     // Ignore notifications with empty message
-    const auto packetLen = OS_MBUF_PKTLEN(event->notify_rx.om);
-    if (packetLen <= headerSize)
+    MbufReader reader {event->notify_rx.om};
+    if (reader.Remaining() <= headerSize)
       return;
 
-    size_t bufferSize = std::min(packetLen + stringTerminatorSize, maxBufferSize);
-    auto messageSize = std::min(maxMessageSize, (bufferSize - headerSize));
+    reader.Skip(headerSize);
+    auto messageSize = std::min(maxMessageSize, reader.Remaining() + 1);
 
-    NotificationManager::Notification notif;
-    os_mbuf_copydata(event->notify_rx.om, headerSize, messageSize - 1, notif.message.data());
-    notif.message[messageSize - 1] = '\0';
-    notif.size = messageSize;
-    notif.category = Pinetime::Controllers::NotificationManager::Categories::SimpleAlert;
-    notificationManager.Push(std::move(notif));
+    notificationManager.Push(Pinetime::Controllers::NotificationManager::Categories::SimpleAlert,
+                             messageSize,
+                             [&reader](char* dest, size_t size) {
+                               reader.Read(dest, size);
+                             });
 
     systemTask.PushMessage(Pinetime::System::Messages::OnNewNotification);
   }
@@ -180,6 +203,7 @@ void AlertNotificationClient::Reset() {
   isDiscovered = false;
   isCharacteristicDiscovered = false;
   isDescriptorFound = false;
+  isComplete = false;
 }
 
 void AlertNotificationClient::Discover(uint16_t connectionHandle, std::function<void(uint16_t)> onServiceDiscovered) {
@@ -187,3 +211,40 @@ void AlertNotificationClient::Discover(uint16_t connectionHandle, std::function<
   this->onServiceDiscovered = onServiceDiscovered;
   ble_gattc_disc_svc_by_uuid(connectionHandle, &ansServiceUuid.u, OnDiscoveryEventCallback, this);
 }
+
+void AlertNotificationClient::Restore(uint16_t connectionHandle,
+                                      const GattCache::Handles& handles,
+                                      std::function<void(uint16_t)> onServiceDiscovered) {
+  this->onServiceDiscovered = onServiceDiscovered;
+  if (handles.newAlert == 0) {
+    NRF_LOG_INFO("[ANS] Not provided by the peer (cached)");
+    isComplete = true;
+    onServiceDiscovered(connectionHandle);
+    return;
+  }
+
+  NRF_LOG_INFO("[ANS] Subscribing with cached handles");
+  newAlertHandle = handles.newAlert;
+  newAlertDescriptorHandle = handles.newAlertDescriptor;
+  isDiscovered = true;
+  isCharacteristicDiscovered = true;
+  isDescriptorFound = true;
+  uint8_t value[2];
+  value[0] = 1;
+  value[1] = 0;
+  int result = ble_gattc_write_flat(connectionHandle, newAlertDescriptorHandle, value, sizeof(value), CachedNewAlertSubcribeCallback, this);
+  if (result != 0) {
+    // BLE_HS_ENOMEM... : the callback is not called, the write is never retried
+    NRF_LOG_INFO("[ANS] Subscribe with cached handles failed (%d), starting discovery", result);
+    FallBackToDiscovery(connectionHandle);
+  }
+}
+
+bool AlertNotificationClient::Save(GattCache::Handles& handles) const {
+  if (!isComplete) {
+    return false;
+  }
+  handles.newAlert = newAlertHandle;
+  handles.newAlertDescriptor = newAlertDescriptorHandle;
+  return true;
+}
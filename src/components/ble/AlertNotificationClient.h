@@ -26,15 +26,21 @@ namespace Pinetime {
       bool OnDiscoveryEvent(uint16_t connectionHandle, const ble_gatt_error* error, const ble_gatt_svc* service);
       int OnCharacteristicsDiscoveryEvent(uint16_t connectionHandle, const ble_gatt_error* error, const ble_gatt_chr* characteristic);
       int OnNewAlertSubcribe(uint16_t connectionHandle, const ble_gatt_error* error);
+      int OnCachedNewAlertSubcribe(uint16_t connectionHandle, const ble_gatt_error* error);
       int OnDescriptorDiscoveryEventCallback(uint16_t connectionHandle,
                                              const ble_gatt_error* error,
                                              uint16_t characteristicValueHandle,
                                              const ble_gatt_dsc* descriptor);
       void OnNotification(ble_gap_event* event);
-      void Reset();
+      void Reset() override;
       void Discover(uint16_t connectionHandle, std::function<void(uint16_t)> lambda) override;
+      void Restore(uint16_t connectionHandle, const GattCache::Handles& handles, std::function<void(uint16_t)> lambda) override;
+      bool Save(GattCache::Handles& handles) const override;
 
     private:
+      // The cached handles are not valid anymore : the service is discovered
+      void FallBackToDiscovery(uint16_t connectionHandle);
+
       static constexpr uint16_t ansServiceId {0x1811};
       static constexpr uint16_t supportedNewAlertCategoryId = 0x2a47;
       static constexpr uint16_t supportedUnreadAlertCategoryId = 0x2a48;
@@ -65,6 +71,7 @@ namespace Pinetime {
       std::function<void(uint16_t)> onServiceDiscovered;
       bool isCharacteristicDiscovered = false;
       bool isDescriptorFound = false;
+      bool isComplete = false; // subscribed to new alerts, or the service is not provided by the peer
     };
   }
 }
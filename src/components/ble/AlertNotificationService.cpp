@@ -2,6 +2,7 @@
 #include <hal/nrf_rtc.h>
 #include <cstring>
 #include <algorithm>
+#include "components/ble/MbufReader.h"
 #include "components/ble/NotificationManager.h"
 #include "systemtask/SystemTask.h"
 
@@ -46,39 +47,36 @@ AlertNotificationService::AlertNotificationService(System::SystemTask& systemTas
 
 int AlertNotificationService::OnAlert(struct ble_gatt_access_ctxt* ctxt) {
   if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
-    constexpr size_t stringTerminatorSize = 1; // end of string '\0'
     constexpr size_t headerSize = 3;
     const auto maxMessageSize {NotificationManager::MaximumMessageSize()};
-    const auto maxBufferSize {maxMessageSize + headerSize};
 
     // Ignore notifications with empty message
-    const auto packetLen = OS_MBUF_PKTLEN(ctxt->om);
-    if (packetLen <= headerSize) {
+    MbufReader reader {ctxt->om};
+    if (reader.Remaining() <= headerSize) {
       return 0;
     }
 
-    size_t bufferSize = std::min(packetLen + stringTerminatorSize, maxBufferSize);
-    auto messageSize = std::min(maxMessageSize, (bufferSize - headerSize));
-    Categories category;
-
-    NotificationManager::Notification notif;
-    os_mbuf_copydata(ctxt->om, headerSize, messageSize - 1, notif.message.data());
-    os_mbuf_copydata(ctxt->om, 0, 1, &category);
-    notif.message[messageSize - 1] = '\0';
-    notif.size = messageSize;
+    auto category = static_cast<Categories>(reader.ReadU8());
+    reader.Skip(headerSize - 1);
 
     // TODO convert all ANS categories to NotificationController categories
+    NotificationManager::Categories notificationCategory;
     switch (category) {
       case Categories::Call:
-        notif.category = Pinetime::Controllers::NotificationManager::Categories::IncomingCall;
+        notificationCategory = Pinetime::Controllers::NotificationManager::Categories::IncomingCall;
         break;
       default:
-        notif.category = Pinetime::Controllers::NotificationManager::Categories::SimpleAlert;
+        notificationCategory = Pinetime::Controllers::NotificationManager::Categories::SimpleAlert;
         break;
     }
 
+    // The message may contain several null-terminated strings (title and body), it is copied as is
+    auto messageSize = std::min(maxMessageSize, reader.Remaining() + 1);
+    notificationManager.Push(notificationCategory, messageSize, [&reader](char* dest, size_t size) {
+      reader.Read(dest, size);
+    });
+
     auto event = Pinetime::System::Messages::OnNewNotification;
-    notificationManager.Push(std::move(notif));
     systemTask.PushMessage(event);
   }
   return 0;
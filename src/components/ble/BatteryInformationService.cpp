@@ -48,7 +48,6 @@ int BatteryInformationService::OnBatteryServiceRequested(uint16_t attributeHandl
   return 0;
 }
 
-void BatteryInformationService::NotifyBatteryLevel(uint16_t connectionHandle, uint8_t level) {
-  auto* om = ble_hs_mbuf_from_flat(&level, 1);
-  ble_gattc_notify_custom(connectionHandle, batteryLevelHandle, om);
+void BatteryInformationService::NotifyBatteryLevel(NotificationScheduler& notifications, uint8_t level) {
+  notifications.Notify(NotificationScheduler::Characteristics::BatteryLevel, batteryLevelHandle, &level, sizeof(level));
 }
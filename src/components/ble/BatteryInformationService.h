@@ -4,6 +4,7 @@
 #include <host/ble_gap.h>
 #undef max
 #undef min
+#include "components/ble/NotificationScheduler.h"
 
 namespace Pinetime {
   namespace System {
@@ -19,7 +20,7 @@ namespace Pinetime {
       void Init();
 
       int OnBatteryServiceRequested(uint16_t attributeHandle, ble_gatt_access_ctxt* context);
-      void NotifyBatteryLevel(uint16_t connectionHandle, uint8_t level);
+      void NotifyBatteryLevel(NotificationScheduler& notifications, uint8_t level);
 
     private:
       Controllers::Battery& batteryController;
@@ -1,12 +1,21 @@
 #pragma once
 
 #include <functional>
+#include "components/ble/GattCache.h"
 
 namespace Pinetime {
   namespace Controllers {
     class BleClient {
     public:
+      virtual ~BleClient() = default;
+
       virtual void Discover(uint16_t connectionHandle, std::function<void(uint16_t)> lambda) = 0;
+      // Uses the handles found during a previous connection instead of discovering the service. The client falls back
+      // to Discover() if they are not valid anymore.
+      virtual void Restore(uint16_t connectionHandle, const GattCache::Handles& handles, std::function<void(uint16_t)> lambda) = 0;
+      // Copies the handles found by the discovery, returns false if the discovery did not complete
+      virtual bool Save(GattCache::Handles& handles) const = 0;
+      virtual void Reset() = 0;
     };
   }
-}
\ No newline at end of file
+}
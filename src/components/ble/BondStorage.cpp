@@ -0,0 +1,206 @@
+#include "components/ble/BondStorage.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <nrf_log.h>
+#include "components/fs/FS.h"
+#include "utility/Crc16.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr const char* fileName = "/.system/bonds.dat";
+  // Written by the previous versions, which only kept one bond
+  constexpr const char* legacyFileName = "/bond.dat";
+}
+
+BondStorage::BondStorage(Controllers::FS& fs) : fs {fs} {
+}
+
+uint16_t BondStorage::ComputeCrc(const Record& record) {
+  return Utility::Crc16(reinterpret_cast<const uint8_t*>(&record) + crcSize, sizeof(Record) - crcSize);
+}
+
+bool BondStorage::ReadFromStore(const ble_addr_t& peer, Record& record) {
+  // Clear the padding too, it is covered by the CRC
+  std::memset(&record, 0, sizeof(record));
+  record.version = bondFormatVersion;
+
+  ble_store_key_sec secKey;
+  std::memset(&secKey, 0, sizeof(secKey));
+  secKey.peer_addr = peer;
+  if (ble_store_read_our_sec(&secKey, &record.ourSec) != 0 || ble_store_read_peer_sec(&secKey, &record.peerSec) != 0) {
+    return false;
+  }
+
+  ble_store_key_cccd cccdKey;
+  std::memset(&cccdKey, 0, sizeof(cccdKey));
+  cccdKey.peer_addr = peer;
+  while (record.nbCccds < MaxCccds) {
+    cccdKey.idx = record.nbCccds;
+    if (ble_store_read_cccd(&cccdKey, &record.cccds[record.nbCccds]) != 0) {
+      break;
+    }
+    record.nbCccds++;
+  }
+  return true;
+}
+
+void BondStorage::WriteToStore(const Record& record) {
+  ble_store_write_our_sec(&record.ourSec);
+  ble_store_write_peer_sec(&record.peerSec);
+  for (uint8_t i = 0; i < record.nbCccds; i++) {
+    ble_store_write_cccd(&record.cccds[i]);
+  }
+}
+
+uint8_t BondStorage::SlotOf(const ble_addr_t& peer) const {
+  for (uint8_t i = 0; i < MaxBonds; i++) {
+    if (slots[i].valid && ble_addr_cmp(&slots[i].peer, &peer) == 0) {
+      return i;
+    }
+  }
+  return MaxBonds;
+}
+
+void BondStorage::Restore() {
+  lfs_file_t file;
+  if (fs.FileOpen(&file, fileName, LFS_O_RDONLY) == LFS_ERR_OK) {
+    Record record;
+    for (uint8_t i = 0; i < MaxBonds; i++) {
+      if (fs.FileRead(&file, reinterpret_cast<uint8_t*>(&record), sizeof(record)) != static_cast<int>(sizeof(record))) {
+        break;
+      }
+      if (record.version != bondFormatVersion || record.nbCccds > MaxCccds || record.crc != ComputeCrc(record)) {
+        continue;
+      }
+
+      WriteToStore(record);
+      slots[i] = {true, record.crc, record.sequence, record.peerSec.peer_addr};
+      lastSequence = std::max(lastSequence, record.sequence);
+    }
+    fs.FileClose(&file);
+  }
+
+  RestoreLegacyBond();
+}
+
+void BondStorage::RestoreLegacyBond() {
+  lfs_file_t file;
+  if (fs.FileOpen(&file, legacyFileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return;
+  }
+
+  union ble_store_value ourSec, peerSec, cccd;
+  uint8_t peerCount = 0;
+
+  std::memset(&ourSec, 0, sizeof ourSec);
+  std::memset(&peerSec, 0, sizeof peerSec);
+  // A truncated file would give a bond with a null key : it is dropped
+  bool valid = fs.FileRead(&file, reinterpret_cast<uint8_t*>(&ourSec.sec), sizeof ourSec) == static_cast<int>(sizeof ourSec) &&
+               fs.FileRead(&file, reinterpret_cast<uint8_t*>(&peerSec.sec), sizeof peerSec) == static_cast<int>(sizeof peerSec) &&
+               fs.FileRead(&file, &peerCount, 1) == 1;
+  if (valid) {
+    ble_store_write_our_sec(&ourSec.sec);
+    ble_store_write_peer_sec(&peerSec.sec);
+    for (int i = 0; i < peerCount; i++) {
+      if (fs.FileRead(&file, reinterpret_cast<uint8_t*>(&cccd.cccd), sizeof(struct ble_store_value_cccd)) !=
+          static_cast<int>(sizeof(struct ble_store_value_cccd))) {
+        break;
+      }
+      ble_store_write_cccd(&cccd.cccd);
+    }
+  }
+
+  fs.FileClose(&file);
+
+  // Move the bond to the table
+  if (!valid) {
+    NRF_LOG_WARNING("[BondStorage] Invalid legacy bond file, discarding");
+  } else if (!IsUpToDate(peerSec.sec.peer_addr)) {
+    Store(peerSec.sec.peer_addr);
+  }
+  fs.FileDelete(legacyFileName);
+  NRF_LOG_INFO("[BondStorage] Legacy bond file removed");
+}
+
+bool BondStorage::IsUpToDate(const ble_addr_t& peer) {
+  uint8_t slot = SlotOf(peer);
+  if (slot == MaxBonds) {
+    return false;
+  }
+
+  Record record;
+  if (!ReadFromStore(peer, record)) {
+    return false;
+  }
+  record.sequence = slots[slot].sequence;
+  return ComputeCrc(record) == slots[slot].crc;
+}
+
+void BondStorage::Store(const ble_addr_t& peer) {
+  Record record;
+  if (!ReadFromStore(peer, record)) {
+    NRF_LOG_WARNING("[BondStorage] No bond to store");
+    return;
+  }
+
+  uint8_t slot = SlotOf(peer);
+  if (slot == MaxBonds) {
+    // Use a free slot, or replace the oldest bond
+    slot = 0;
+    for (uint8_t i = 0; i < MaxBonds; i++) {
+      if (!slots[i].valid) {
+        slot = i;
+        break;
+      }
+      if (slots[i].sequence < slots[slot].sequence) {
+        slot = i;
+      }
+    }
+  }
+
+  record.sequence = ++lastSequence;
+  record.crc = ComputeCrc(record);
+  if (WriteSlot(slot, record)) {
+    slots[slot] = {true, record.crc, record.sequence, peer};
+    NRF_LOG_INFO("[BondStorage] Bond stored in slot %d", slot);
+  }
+}
+
+void BondStorage::Remove(const ble_addr_t& peer) {
+  uint8_t slot = SlotOf(peer);
+  if (slot == MaxBonds) {
+    return;
+  }
+
+  // Clearing the version is enough to free the slot
+  lfs_file_t file;
+  if (fs.FileOpen(&file, fileName, LFS_O_WRONLY) != LFS_ERR_OK) {
+    return;
+  }
+  const uint8_t version = 0;
+  fs.FileSeek(&file, slot * sizeof(Record) + offsetof(Record, version));
+  fs.FileWrite(&file, &version, sizeof(version));
+  fs.FileClose(&file);
+  slots[slot].valid = false;
+}
+
+bool BondStorage::WriteSlot(uint8_t slot, const Record& record) {
+  lfs_dir systemDir;
+  if (fs.DirOpen("/.system", &systemDir) != LFS_ERR_OK) {
+    fs.DirCreate("/.system");
+  }
+  fs.DirClose(&systemDir);
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, fileName, LFS_O_WRONLY | LFS_O_CREAT) != LFS_ERR_OK) {
+    NRF_LOG_WARNING("[BondStorage] Failed to open the bond file");
+    return false;
+  }
+  // Seeking after the end of the file fills the free slots before this one with zeros
+  fs.FileSeek(&file, slot * sizeof(Record));
+  bool ok = fs.FileWrite(&file, reinterpret_cast<const uint8_t*>(&record), sizeof(record)) == static_cast<int>(sizeof(record));
+  ok = fs.FileClose(&file) == LFS_ERR_OK && ok;
+  return ok;
+}
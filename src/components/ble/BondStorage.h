@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_gap.h>
+#include <host/ble_store.h>
+#undef max
+#undef min
+
+namespace Pinetime {
+  namespace Controllers {
+    class FS;
+
+    /* Table of the bonds (security keys and CCCDs of each bonded peer), stored in a single file with one fixed-size
+     * slot per peer. Adding or updating a bond only writes its slot, and a bond is only written when it changed.
+     *
+     * Slot : CRC16 (u16), version (u8), number of CCCDs (u8), sequence number (u32), our keys, peer keys, CCCDs
+     *
+     * A slot with an invalid version or CRC is considered free, so that a corrupted bond is dropped without affecting
+     * the other ones. When the table is full, the bond with the lowest sequence number (the one written first) is
+     * replaced.
+     */
+    class BondStorage {
+    public:
+      static constexpr uint8_t MaxBonds = MYNEWT_VAL(BLE_STORE_MAX_BONDS);
+      static constexpr uint8_t MaxCccds = MYNEWT_VAL(BLE_STORE_MAX_CCCDS);
+
+      explicit BondStorage(Controllers::FS& fs);
+
+      // Loads the bonds in the NimBLE store
+      void Restore();
+
+      // Returns true if the bond of the peer in the NimBLE store is already in the table
+      bool IsUpToDate(const ble_addr_t& peer);
+      // Writes the bond of the peer from the NimBLE store in the table
+      void Store(const ble_addr_t& peer);
+      void Remove(const ble_addr_t& peer);
+
+    private:
+      static constexpr uint8_t bondFormatVersion = 1;
+
+      struct Record {
+        uint16_t crc;
+        uint8_t version;
+        uint8_t nbCccds;
+        uint32_t sequence;
+        ble_store_value_sec ourSec;
+        ble_store_value_sec peerSec;
+        std::array<ble_store_value_cccd, MaxCccds> cccds;
+      };
+
+      // Kept in RAM for each slot, so that the file is only read at boot
+      struct Slot {
+        bool valid;
+        uint16_t crc;
+        uint32_t sequence;
+        ble_addr_t peer;
+      };
+
+      static constexpr size_t crcSize = sizeof(Record::crc);
+
+      static uint16_t ComputeCrc(const Record& record);
+      // Reads the bond of the peer from the NimBLE store, returns false if there is no bond
+      static bool ReadFromStore(const ble_addr_t& peer, Record& record);
+      static void WriteToStore(const Record& record);
+
+      // Slot of the peer, MaxBonds if not found
+      uint8_t SlotOf(const ble_addr_t& peer) const;
+      bool WriteSlot(uint8_t slot, const Record& record);
+      void RestoreLegacyBond();
+
+      Controllers::FS& fs;
+      std::array<Slot, MaxBonds> slots {};
+      uint32_t lastSequence = 0;
+    };
+  }
+}
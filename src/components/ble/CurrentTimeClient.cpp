@@ -1,4 +1,5 @@
 #include "components/ble/CurrentTimeClient.h"
+#include "components/ble/MbufReader.h"
 #include <nrf_log.h>
 #include "components/datetime/DateTimeController.h"
 
@@ -25,6 +26,11 @@ namespace {
     auto client = static_cast<CurrentTimeClient*>(arg);
     return client->OnCurrentTimeReadResult(conn_handle, error, attr);
   }
+
+  int CachedCurrentTimeReadCallback(uint16_t conn_handle, const struct ble_gatt_error* error, struct ble_gatt_attr* attr, void* arg) {
+    auto client = static_cast<CurrentTimeClient*>(arg);
+    return client->OnCachedCurrentTimeReadResult(conn_handle, error, attr);
+  }
 }
 
 CurrentTimeClient::CurrentTimeClient(DateTime& dateTimeController) : dateTimeController {dateTimeController} {
@@ -41,6 +47,7 @@ bool CurrentTimeClient::OnDiscoveryEvent(uint16_t connectionHandle, const ble_ga
       ble_gattc_disc_all_chrs(connectionHandle, ctsStartHandle, ctsEndHandle, OnCurrentTimeCharacteristicDiscoveredCallback, this);
     } else {
       NRF_LOG_INFO("CTS not found");
+      isComplete = true;
       onServiceDiscovered(connectionHandle);
     }
     return true;
@@ -82,12 +89,8 @@ int CurrentTimeClient::OnCharacteristicDiscoveryEvent(uint16_t conn_handle,
 int CurrentTimeClient::OnCurrentTimeReadResult(uint16_t conn_handle, const ble_gatt_error* error, const ble_gatt_attr* attribute) {
   if (error->status == 0) {
     // TODO check that attribute->handle equals the handle discovered in OnCharacteristicDiscoveryEvent
-    CtsData result;
-    os_mbuf_copydata(attribute->om, 0, sizeof(CtsData), &result);
-    uint16_t year = ((uint16_t) result.year_MSO << 8) + result.year_LSO;
-
-    NRF_LOG_INFO("Received data: %d-%d-%d %d:%d:%d", year, result.month, result.dayofmonth, result.hour, result.minute, result.second);
-    dateTimeController.SetTime(year, result.month, result.dayofmonth, result.hour, result.minute, result.second);
+    SetTime(attribute);
+    isComplete = true;
   } else {
     NRF_LOG_INFO("Error retrieving current time: %d", error->status);
   }
@@ -96,9 +99,64 @@ int CurrentTimeClient::OnCurrentTimeReadResult(uint16_t conn_handle, const ble_g
   return 0;
 }
 
+int CurrentTimeClient::OnCachedCurrentTimeReadResult(uint16_t conn_handle, const ble_gatt_error* error, const ble_gatt_attr* attribute) {
+  // Called for each characteristic with the CTS UUID found in the cached range, and then once without attribute when the
+  // procedure is over (BLE_HS_EDONE, or the error that ended it). An error with an attribute (BLE_HS_ENOMEM) is followed
+  // by this last call, the fallback is only started by the last call so that the discovery does not run twice.
+  if (attribute != nullptr) {
+    if (error->status == 0 && !timeReceived) {
+      SetTime(attribute);
+      timeReceived = true;
+    } else if (error->status != 0) {
+      NRF_LOG_INFO("[CTS] Error reading current time with cached handles (%d)", error->status);
+    }
+    return 0;
+  }
+
+  if (error->status == BLE_HS_EDONE && timeReceived) {
+    isComplete = true;
+    onServiceDiscovered(conn_handle);
+  } else {
+    NRF_LOG_INFO("[CTS] Cached handles are not valid (%d), starting discovery", error->status);
+    FallBackToDiscovery(conn_handle);
+  }
+  return 0;
+}
+
+void CurrentTimeClient::FallBackToDiscovery(uint16_t connectionHandle) {
+  Reset();
+  Discover(connectionHandle, onServiceDiscovered);
+}
+
+void CurrentTimeClient::SetTime(const ble_gatt_attr* attribute) {
+  // The adjust reason is not used
+  MbufReader reader {attribute->om};
+  uint16_t year = reader.ReadU16();
+  uint8_t month = reader.ReadU8();
+  uint8_t dayOfMonth = reader.ReadU8();
+  uint8_t hour = reader.ReadU8();
+  uint8_t minute = reader.ReadU8();
+  uint8_t second = reader.ReadU8();
+  uint8_t fractions256 = 0;
+  if (reader.Remaining() >= 2) {
+    reader.Skip(1); // day of week
+    fractions256 = reader.ReadU8();
+  }
+  if (reader.IsValid()) {
+    NRF_LOG_INFO("Received data: %d-%d-%d %d:%d:%d", year, month, dayOfMonth, hour, minute, second);
+    dateTimeController.SynchroniseTime(year, month, dayOfMonth, hour, minute, second, fractions256);
+  } else {
+    NRF_LOG_INFO("Current time : invalid data");
+  }
+}
+
 void CurrentTimeClient::Reset() {
   isDiscovered = false;
   isCharacteristicDiscovered = false;
+  isComplete = false;
+  timeReceived = false;
+  ctsStartHandle = 0;
+  ctsEndHandle = 0;
 }
 
 void CurrentTimeClient::Discover(uint16_t connectionHandle, std::function<void(uint16_t)> onServiceDiscovered) {
@@ -106,3 +164,41 @@ void CurrentTimeClient::Discover(uint16_t connectionHandle, std::function<void(u
   this->onServiceDiscovered = onServiceDiscovered;
   ble_gattc_disc_svc_by_uuid(connectionHandle, &ctsServiceUuid.u, OnDiscoveryEventCallback, this);
 }
+
+void CurrentTimeClient::Restore(uint16_t connectionHandle,
+                                const GattCache::Handles& handles,
+                                std::function<void(uint16_t)> onServiceDiscovered) {
+  this->onServiceDiscovered = onServiceDiscovered;
+  if (handles.currentTimeStart == 0) {
+    NRF_LOG_INFO("[CTS] Not provided by the peer (cached)");
+    isComplete = true;
+    onServiceDiscovered(connectionHandle);
+    return;
+  }
+
+  // The characteristic is read by UUID, so that a stale range cannot be mistaken for the current time
+  NRF_LOG_INFO("[CTS] Reading current time with cached handles");
+  isDiscovered = true;
+  ctsStartHandle = handles.currentTimeStart;
+  ctsEndHandle = handles.currentTimeEnd;
+  int result = ble_gattc_read_by_uuid(connectionHandle,
+                                      ctsStartHandle,
+                                      ctsEndHandle,
+                                      &currentTimeCharacteristicUuid.u,
+                                      CachedCurrentTimeReadCallback,
+                                      this);
+  if (result != 0) {
+    // The callback is not called if the procedure did not start
+    NRF_LOG_INFO("[CTS] Read with cached handles failed (%d), starting discovery", result);
+    FallBackToDiscovery(connectionHandle);
+  }
+}
+
+bool CurrentTimeClient::Save(GattCache::Handles& handles) const {
+  if (!isComplete) {
+    return false;
+  }
+  handles.currentTimeStart = ctsStartHandle;
+  handles.currentTimeEnd = ctsEndHandle;
+  return true;
+}
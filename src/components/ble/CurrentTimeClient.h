@@ -15,10 +15,11 @@ namespace Pinetime {
     public:
       explicit CurrentTimeClient(DateTime& dateTimeController);
       void Init();
-      void Reset();
+      void Reset() override;
       bool OnDiscoveryEvent(uint16_t connectionHandle, const ble_gatt_error* error, const ble_gatt_svc* service);
       int OnCharacteristicDiscoveryEvent(uint16_t conn_handle, const ble_gatt_error* error, const ble_gatt_chr* characteristic);
       int OnCurrentTimeReadResult(uint16_t conn_handle, const ble_gatt_error* error, const ble_gatt_attr* attribute);
+      int OnCachedCurrentTimeReadResult(uint16_t conn_handle, const ble_gatt_error* error, const ble_gatt_attr* attribute);
 
       static constexpr const ble_uuid16_t* Uuid() {
         return &CurrentTimeClient::ctsServiceUuid;
@@ -29,31 +30,26 @@ namespace Pinetime {
       }
 
       void Discover(uint16_t connectionHandle, std::function<void(uint16_t)> lambda) override;
+      void Restore(uint16_t connectionHandle, const GattCache::Handles& handles, std::function<void(uint16_t)> lambda) override;
+      bool Save(GattCache::Handles& handles) const override;
 
     private:
-      typedef struct __attribute__((packed)) {
-        uint8_t year_LSO; // explicit byte ordering to be independent of machine order
-        uint8_t year_MSO; // BLE GATT is little endian
-        uint8_t month;
-        uint8_t dayofmonth;
-        uint8_t hour;
-        uint8_t minute;
-        uint8_t second;
-        uint8_t dayofweek;
-        uint8_t fractions256; // currently ignored
-        uint8_t reason;       // currently ignored, not that any host would set it anyway
-      } CtsData;
-
       static constexpr uint16_t ctsServiceId {0x1805};
       static constexpr uint16_t currentTimeCharacteristicId {0x2a2b};
 
       static constexpr ble_uuid16_t ctsServiceUuid {.u {.type = BLE_UUID_TYPE_16}, .value = ctsServiceId};
       static constexpr ble_uuid16_t currentTimeCharacteristicUuid {.u {.type = BLE_UUID_TYPE_16}, .value = currentTimeCharacteristicId};
 
+      void SetTime(const ble_gatt_attr* attribute);
+      // The cached handles are not valid anymore : the service is discovered
+      void FallBackToDiscovery(uint16_t connectionHandle);
+
       DateTime& dateTimeController;
       bool isDiscovered = false;
-      uint16_t ctsStartHandle;
-      uint16_t ctsEndHandle;
+      bool isComplete = false; // the service was found (and read) or is not provided by the peer
+      uint16_t ctsStartHandle = 0;
+      uint16_t ctsEndHandle = 0;
+      bool timeReceived = false;
 
       bool isCharacteristicDiscovered = false;
       uint16_t currentTimeHandle;
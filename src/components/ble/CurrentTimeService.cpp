@@ -49,7 +49,7 @@ int CurrentTimeService::OnCurrentTimeAccessed(struct ble_gatt_access_ctxt* ctxt)
 
     NRF_LOG_INFO("Received data: %d-%d-%d %d:%d:%d", year, result.month, result.dayofmonth, result.hour, result.minute, result.second);
 
-    m_dateTimeController.SetTime(year, result.month, result.dayofmonth, result.hour, result.minute, result.second);
+    m_dateTimeController.SynchroniseTime(year, result.month, result.dayofmonth, result.hour, result.minute, result.second, result.fractions256);
 
   } else if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
     CtsCurrentTimeData currentDateTime;
@@ -42,7 +42,7 @@ namespace Pinetime {
         uint8_t minute;
         uint8_t second;
         uint8_t dayofweek;
-        uint8_t fractions256; // currently ignored
+        uint8_t fractions256;
         uint8_t reason;       // currently ignored, not that any host would set it anyway
       } CtsCurrentTimeData;
 
@@ -1,5 +1,6 @@
 #include "components/ble/DfuService.h"
 #include <cstring>
+#include <algorithm>
 #include "components/ble/BleController.h"
 #include "components/ble/NotificationManager.h"
 #include "components/settings/Settings.h"
@@ -35,6 +36,8 @@ DfuService::DfuService(Pinetime::System::SystemTask& systemTask,
   : systemTask {systemTask},
     bleController {bleController},
     dfuImage {spiNorFlash},
+    deltaImage {dfuImage},
+    deltaDecoder {deltaImage},
     characteristicDefinition {{
                                 .uuid = &packetCharacteristicUuid.u,
                                 .access_cb = DfuServiceCallback,
@@ -82,11 +85,9 @@ void DfuService::Init() {
 int DfuService::OnServiceData(uint16_t connectionHandle, uint16_t attributeHandle, ble_gatt_access_ctxt* context) {
 #ifndef PINETIME_IS_RECOVERY
   if (systemTask.GetSettings().GetDfuAndFsMode() == Pinetime::Controllers::Settings::DfuAndFsMode::Disabled) {
-    Pinetime::Controllers::NotificationManager::Notification notif;
-    memcpy(notif.message.data(), denyAlert, denyAlertLength);
-    notif.size = denyAlertLength;
-    notif.category = Pinetime::Controllers::NotificationManager::Categories::SimpleAlert;
-    systemTask.GetNotificationManager().Push(std::move(notif));
+    systemTask.GetNotificationManager().Push(Pinetime::Controllers::NotificationManager::Categories::SimpleAlert,
+                                             denyAlert,
+                                             denyAlertLength);
     systemTask.PushMessage(Pinetime::System::Messages::OnNewNotification);
     return BLE_ATT_ERR_INSUFFICIENT_AUTHOR;
   }
@@ -177,7 +178,20 @@ int DfuService::WritePacketHandler(uint16_t connectionHandle, os_mbuf* om) {
 
     case States::Data: {
       nbPacketReceived++;
-      dfuImage.Append(om->om_data, om->om_len);
+      if (isDelta) {
+        if (deltaDecoder.Feed(om->om_data, om->om_len) == Pinetime::Tools::DeltaDecoder::Status::Error) {
+          uint8_t data[3] {static_cast<uint8_t>(Opcodes::Response),
+                           static_cast<uint8_t>(Opcodes::ReceiveFirmwareImage),
+                           static_cast<uint8_t>(ErrorCodes::OperationFailed)};
+          NRF_LOG_INFO("[DFU] -> Invalid delta patch");
+          notificationManager.Send(connectionHandle, controlPointCharacteristicHandle, data, 3);
+          bleController.State(Pinetime::Controllers::Ble::FirmwareUpdateStates::Error);
+          Reset();
+          return 0;
+        }
+      } else {
+        dfuImage.Append(om->om_data, om->om_len);
+      }
       bytesReceived += om->om_len;
       bleController.FirmwareUpdateCurrentBytes(bytesReceived);
 
@@ -222,8 +236,9 @@ int DfuService::ControlPointHandler(uint16_t connectionHandle, os_mbuf* om) {
         return 0;
       }
       auto imageType = static_cast<ImageTypes>(om->om_data[1]);
-      if (imageType == ImageTypes::Application) {
-        NRF_LOG_INFO("[DFU] -> Start DFU, mode = Application");
+      if (imageType == ImageTypes::Application || imageType == ImageTypes::ApplicationDelta) {
+        isDelta = (imageType == ImageTypes::ApplicationDelta);
+        NRF_LOG_INFO("[DFU] -> Start DFU, mode = %s", isDelta ? "Application (delta)" : "Application");
         state = States::Start;
         bleController.StartFirmwareUpdate();
         bleController.State(Pinetime::Controllers::Ble::FirmwareUpdateStates::Running);
@@ -262,8 +277,14 @@ int DfuService::ControlPointHandler(uint16_t connectionHandle, os_mbuf* om) {
         NRF_LOG_INFO("[DFU] -> Receive firmware image requested, but we are not in Start Init");
         return 0;
       }
-      // TODO the chunk size is dependent of the implementation of the host application...
-      dfuImage.Init(20, applicationSize, expectedCrc);
+      if (isDelta) {
+        // The size of the new image is only known once the header of the patch is received
+        deltaImage.Init(expectedCrc);
+        deltaDecoder.Reset();
+      } else {
+        // TODO the chunk size is dependent of the implementation of the host application...
+        dfuImage.Init(20, applicationSize, expectedCrc);
+      }
       NRF_LOG_INFO("[DFU] -> Starting receive firmware");
       state = States::Data;
       return 0;
@@ -325,6 +346,8 @@ void DfuService::Reset() {
   bootloaderSize = 0;
   applicationSize = 0;
   expectedCrc = 0;
+  isDelta = false;
+  deltaDecoder.Reset();
   notificationManager.Reset();
   bleController.StopFirmwareUpdate();
   systemTask.PushMessage(Pinetime::System::Messages::BleFirmwareUpdateFinished);
@@ -377,18 +400,22 @@ void DfuService::DfuImage::Init(size_t chunkSize, size_t totalSize, uint16_t exp
   bufferWriteIndex = 0;
 }
 
-void DfuService::DfuImage::Append(uint8_t* data, size_t size) {
+void DfuService::DfuImage::Append(const uint8_t* data, size_t size) {
   if (!ready)
     return;
-  ASSERT(size <= 20);
-
-  std::memcpy(tempBuffer + bufferWriteIndex, data, size);
-  bufferWriteIndex += size;
 
-  if (bufferWriteIndex == bufferSize) {
-    spiNorFlash.Write(writeOffset + totalWriteIndex, tempBuffer, bufferWriteIndex);
-    totalWriteIndex += bufferWriteIndex;
-    bufferWriteIndex = 0;
+  while (size > 0) {
+    size_t chunk = std::min(size, bufferSize - bufferWriteIndex);
+    std::memcpy(tempBuffer + bufferWriteIndex, data, chunk);
+    bufferWriteIndex += chunk;
+    data += chunk;
+    size -= chunk;
+
+    if (bufferWriteIndex == bufferSize) {
+      spiNorFlash.Write(writeOffset + totalWriteIndex, tempBuffer, bufferWriteIndex);
+      totalWriteIndex += bufferWriteIndex;
+      bufferWriteIndex = 0;
+    }
   }
 
   if (bufferWriteIndex > 0 && totalWriteIndex + bufferWriteIndex == totalSize) {
@@ -458,3 +485,33 @@ bool DfuService::DfuImage::IsComplete() {
     return false;
   return totalWriteIndex == totalSize;
 }
+
+void DfuService::DeltaImage::Init(uint16_t expectedCrc) {
+  this->expectedCrc = expectedCrc;
+}
+
+bool DfuService::DeltaImage::OnHeader(const Pinetime::Tools::DeltaDecoder::Header& header) {
+  if (header.sourceSize > DfuImage::maxSize || header.targetSize > DfuImage::maxSize) {
+    NRF_LOG_INFO("[DFU] -> Delta patch too big : source = %d, target = %d", header.sourceSize, header.targetSize);
+    return false;
+  }
+
+  // The patch can only be applied on the image it was generated from
+  auto crc = DfuImage::ComputeCrc(reinterpret_cast<const uint8_t*>(sourceAddress), header.sourceSize, nullptr);
+  if (crc != header.sourceCrc) {
+    NRF_LOG_INFO("[DFU] -> Delta patch does not match the current image (CRC %u, expected %u)", crc, header.sourceCrc);
+    return false;
+  }
+
+  NRF_LOG_INFO("[DFU] -> Delta patch : source size = %d, target size = %d", header.sourceSize, header.targetSize);
+  dfuImage.Init(20, header.targetSize, expectedCrc);
+  return true;
+}
+
+void DfuService::DeltaImage::ReadSource(uint32_t offset, uint8_t* buffer, size_t size) {
+  std::memcpy(buffer, reinterpret_cast<const uint8_t*>(sourceAddress + offset), size);
+}
+
+void DfuService::DeltaImage::WriteTarget(const uint8_t* data, size_t size) {
+  dfuImage.Append(data, size);
+}
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <array>
+#include "components/delta/DeltaDecoder.h"
 
 #define min // workaround: nimble's min/max macros conflict with libstdc++
 #define max
@@ -58,17 +59,19 @@ namespace Pinetime {
 
         void Init(size_t chunkSize, size_t totalSize, uint16_t expectedCrc);
         void Erase();
-        void Append(uint8_t* data, size_t size);
+        void Append(const uint8_t* data, size_t size);
         bool Validate();
         bool IsComplete();
 
+        static uint16_t ComputeCrc(uint8_t const* p_data, uint32_t size, uint16_t const* p_crc);
+        static constexpr size_t maxSize = 475136;
+
       private:
         Pinetime::Drivers::SpiNorFlash& spiNorFlash;
         static constexpr size_t bufferSize = 200;
         bool ready = false;
         size_t chunkSize = 0;
         size_t totalSize = 0;
-        size_t maxSize = 475136;
         size_t bufferWriteIndex = 0;
         size_t totalWriteIndex = 0;
         static constexpr size_t writeOffset = 0x40000;
@@ -76,7 +79,23 @@ namespace Pinetime {
         uint16_t expectedCrc = 0;
 
         void WriteMagicNumber();
-        uint16_t ComputeCrc(uint8_t const* p_data, uint32_t size, uint16_t const* p_crc);
+      };
+
+      // Rebuilds the new image in the DFU slot from a delta patch and the image currently running from the internal flash
+      class DeltaImage : public Pinetime::Tools::DeltaDecoder::Delegate {
+      public:
+        explicit DeltaImage(DfuImage& dfuImage) : dfuImage {dfuImage} {
+        }
+
+        void Init(uint16_t expectedCrc);
+        bool OnHeader(const Pinetime::Tools::DeltaDecoder::Header& header) override;
+        void ReadSource(uint32_t offset, uint8_t* buffer, size_t size) override;
+        void WriteTarget(const uint8_t* data, size_t size) override;
+
+      private:
+        DfuImage& dfuImage;
+        uint16_t expectedCrc = 0;
+        static constexpr uint32_t sourceAddress = 0x8000;
       };
 
       static constexpr ble_uuid128_t serviceUuid {
@@ -87,6 +106,8 @@ namespace Pinetime {
       Pinetime::System::SystemTask& systemTask;
       Pinetime::Controllers::Ble& bleController;
       DfuImage dfuImage;
+      DeltaImage deltaImage;
+      Pinetime::Tools::DeltaDecoder deltaDecoder;
       NotificationManager notificationManager;
 
       static constexpr const char denyAlert[] = "InfiniTime\0Firmware update attempted, but disabled in settings.";
@@ -125,7 +146,8 @@ namespace Pinetime {
         SoftDevice = 0x01,
         Bootloader = 0x02,
         SoftDeviceAndBootloader = 0x03,
-        Application = 0x04
+        Application = 0x04,
+        ApplicationDelta = 0x08
       };
 
       enum class Opcodes : uint8_t {
@@ -156,6 +178,7 @@ namespace Pinetime {
       uint32_t bootloaderSize = 0;
       uint32_t applicationSize = 0;
       uint16_t expectedCrc = 0;
+      bool isDelta = false;
 
       int SendDfuRevision(os_mbuf* om) const;
       int WritePacketHandler(uint16_t connectionHandle, os_mbuf* om);
@@ -0,0 +1,112 @@
+#include "components/ble/GattCache.h"
+#include <algorithm>
+#include <cstring>
+#include <nrf_log.h>
+#include "components/fs/FS.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr const char* fileName = "/.system/gattcache.dat";
+}
+
+GattCache::GattCache(Controllers::FS& fs) : fs {fs} {
+}
+
+void GattCache::Init() {
+  lfs_file_t file;
+  StoredCache buffer;
+
+  if (fs.FileOpen(&file, fileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    NRF_LOG_INFO("[GattCache] No cache file");
+    return;
+  }
+
+  int bytesRead = fs.FileRead(&file, reinterpret_cast<uint8_t*>(&buffer), sizeof(buffer));
+  fs.FileClose(&file);
+  if (bytesRead != static_cast<int>(sizeof(buffer)) || buffer.version != gattCacheFormatVersion || buffer.nbEntries > maxEntries) {
+    NRF_LOG_WARNING("[GattCache] Invalid cache file, discarding");
+    return;
+  }
+
+  cache = buffer;
+  NRF_LOG_INFO("[GattCache] Loaded %d entries", cache.nbEntries);
+}
+
+uint8_t GattCache::IndexOf(const ble_addr_t& peer) const {
+  for (uint8_t i = 0; i < cache.nbEntries; i++) {
+    if (ble_addr_cmp(&cache.entries[i].peer, &peer) == 0) {
+      return i;
+    }
+  }
+  return cache.nbEntries;
+}
+
+void GattCache::MoveToFront(uint8_t index) {
+  std::rotate(cache.entries.begin(), cache.entries.begin() + index, cache.entries.begin() + index + 1);
+}
+
+const GattCache::Handles* GattCache::Find(const ble_addr_t& peer) {
+  uint8_t index = IndexOf(peer);
+  if (index == cache.nbEntries) {
+    return nullptr;
+  }
+  // The order of the entries is not persisted immediately, it is only used to choose the entry to evict
+  MoveToFront(index);
+  return &cache.entries[0].handles;
+}
+
+void GattCache::Store(const ble_addr_t& peer, const Handles& handles) {
+  uint8_t index = IndexOf(peer);
+  if (index == cache.nbEntries) {
+    if (cache.nbEntries < maxEntries) {
+      cache.nbEntries++;
+    } else {
+      // Evict the least recently used entry
+      index = maxEntries - 1;
+    }
+    cache.entries[index].peer = peer;
+  } else if (cache.entries[index].handles == handles) {
+    MoveToFront(index);
+    return;
+  }
+
+  cache.entries[index].handles = handles;
+  MoveToFront(index);
+  dirty = true;
+}
+
+void GattCache::Remove(const ble_addr_t& peer) {
+  uint8_t index = IndexOf(peer);
+  if (index == cache.nbEntries) {
+    return;
+  }
+
+  std::move(cache.entries.begin() + index + 1, cache.entries.begin() + cache.nbEntries, cache.entries.begin() + index);
+  cache.nbEntries--;
+  cache.entries[cache.nbEntries] = {};
+  dirty = true;
+}
+
+void GattCache::Persist() {
+  if (!dirty) {
+    return;
+  }
+
+  lfs_dir systemDir;
+  if (fs.DirOpen("/.system", &systemDir) != LFS_ERR_OK) {
+    fs.DirCreate("/.system");
+  }
+  fs.DirClose(&systemDir);
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, fileName, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+    NRF_LOG_WARNING("[GattCache] Failed to open cache file for saving");
+    return;
+  }
+
+  fs.FileWrite(&file, reinterpret_cast<const uint8_t*>(&cache), sizeof(cache));
+  fs.FileClose(&file);
+  dirty = false;
+  NRF_LOG_INFO("[GattCache] Saved %d entries", cache.nbEntries);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_gap.h>
+#undef max
+#undef min
+
+namespace Pinetime {
+  namespace Controllers {
+    class FS;
+
+    /* Handles of the services of the phone used by the clients (CTS, ANS...), found by the service discovery.
+     *
+     * They are kept for the last bonded peers, keyed by their identity address, so that the discovery can be skipped
+     * when they reconnect. An entry is removed when the peer indicates that its services changed, or when its bond is
+     * deleted.
+     */
+    class GattCache {
+    public:
+      // A handle set to 0 means that the service (or characteristic) is not provided by the peer
+      struct Handles {
+        uint16_t currentTimeStart = 0;
+        uint16_t currentTimeEnd = 0;
+        uint16_t newAlert = 0;
+        uint16_t newAlertDescriptor = 0;
+        uint16_t serviceChanged = 0;
+
+        bool operator==(const Handles& other) const = default;
+      };
+
+      explicit GattCache(Controllers::FS& fs);
+
+      void Init();
+
+      // Returns the handles of the peer, nullptr if they are not in the cache
+      const Handles* Find(const ble_addr_t& peer);
+      void Store(const ble_addr_t& peer, const Handles& handles);
+      void Remove(const ble_addr_t& peer);
+
+      // Writes the cache to the filesystem if it changed since the last call
+      void Persist();
+
+      bool IsDirty() const {
+        return dirty;
+      }
+
+    private:
+      static constexpr uint8_t maxEntries = 4;
+      static constexpr uint8_t gattCacheFormatVersion = 1;
+
+      struct Entry {
+        ble_addr_t peer;
+        Handles handles;
+      };
+
+      // Content of the cache file
+      struct StoredCache {
+        uint8_t version = gattCacheFormatVersion;
+        uint8_t nbEntries = 0;
+        std::array<Entry, maxEntries> entries {};
+      };
+
+      // Position of the entry of the peer, nbEntries if not found
+      uint8_t IndexOf(const ble_addr_t& peer) const;
+      // Moves the entry at the specified position to the front, so that the least recently used one is evicted first
+      void MoveToFront(uint8_t index);
+
+      Controllers::FS& fs;
+      StoredCache cache;
+      bool dirty = false;
+    };
+  }
+}
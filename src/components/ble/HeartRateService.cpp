@@ -2,6 +2,11 @@
 #include "components/heartrate/HeartRateController.h"
 #include "components/ble/NimbleController.h"
 #include <nrf_log.h>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_att.h>
+#undef max
+#undef min
 
 using namespace Pinetime::Controllers;
 
@@ -9,6 +14,11 @@ constexpr ble_uuid16_t HeartRateService::heartRateServiceUuid;
 constexpr ble_uuid16_t HeartRateService::heartRateMeasurementUuid;
 
 namespace {
+  // 00060001-78fc-48fe-8e23-433b3a1942d0
+  constexpr ble_uuid128_t rawPpgCharUuid {
+    .u = {.type = BLE_UUID_TYPE_128},
+    .value = {0xd0, 0x42, 0x19, 0x3a, 0x3b, 0x43, 0x23, 0x8e, 0xfe, 0x48, 0xfc, 0x78, 0x01, 0x00, 0x06, 0x00}};
+
   int HeartRateServiceCallback(uint16_t /*conn_handle*/, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
     auto* heartRateService = static_cast<HeartRateService*>(arg);
     return heartRateService->OnHeartRateRequested(attr_handle, ctxt);
@@ -24,6 +34,11 @@ HeartRateService::HeartRateService(NimbleController& nimble, Controllers::HeartR
                                .arg = this,
                                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
                                .val_handle = &heartRateMeasurementHandle},
+                              {.uuid = &rawPpgCharUuid.u,
+                               .access_cb = HeartRateServiceCallback,
+                               .arg = this,
+                               .flags = BLE_GATT_CHR_F_NOTIFY,
+                               .val_handle = &rawPpgHandle},
                               {0}},
     serviceDefinition {
       {/* Device Information Service */
@@ -61,23 +76,54 @@ void HeartRateService::OnNewHeartRateValue(uint8_t heartRateValue) {
     return;
 
   uint8_t buffer[2] = {0, heartRateValue}; // [0] = flags, [1] = hr value
-  auto* om = ble_hs_mbuf_from_flat(buffer, 2);
+  nimble.notifications().Notify(NotificationScheduler::Characteristics::HeartRate, heartRateMeasurementHandle, buffer, sizeof(buffer));
+}
+
+void HeartRateService::OnNewPpgSample(const PpgSampleBatch::SensorConfig& config, uint16_t hrs, uint16_t als, bool newMeasurement) {
+  uint32_t sequence = ppgSequence++;
+  if (!rawPpgNotificationEnable) {
+    ppgSamples.Clear();
+    return;
+  }
 
   uint16_t connectionHandle = nimble.connHandle();
 
   if (connectionHandle == 0 || connectionHandle == BLE_HS_CONN_HANDLE_NONE) {
+    ppgSamples.Clear();
     return;
   }
 
-  ble_gattc_notify_custom(connectionHandle, heartRateMeasurementHandle, om);
+  // A batch only contains consecutive samples acquired with the same sensor configuration
+  size_t sizeLimit = ble_att_mtu(connectionHandle) - 3;
+  if (!ppgSamples.IsEmpty() && (newMeasurement || !(ppgSamples.Config() == config) || !ppgSamples.Append(hrs, als, sizeLimit))) {
+    SendPpgSamples(connectionHandle);
+  }
+  if (ppgSamples.IsEmpty()) {
+    ppgSamples.Start(config, sequence, newMeasurement);
+    ppgSamples.Append(hrs, als, sizeLimit);
+  }
+
+  if (static_cast<uint32_t>(ppgSamples.Count()) * config.samplePeriod >= ppgSamplesMaxLatency) {
+    SendPpgSamples(connectionHandle);
+  }
+}
+
+void HeartRateService::SendPpgSamples(uint16_t connectionHandle) {
+  auto* om = ble_hs_mbuf_from_flat(ppgSamples.Data(), ppgSamples.Size());
+  ppgSamples.Clear();
+  ble_gattc_notify_custom(connectionHandle, rawPpgHandle, om);
 }
 
 void HeartRateService::SubscribeNotification(uint16_t attributeHandle) {
   if (attributeHandle == heartRateMeasurementHandle)
     heartRateMeasurementNotificationEnable = true;
+  else if (attributeHandle == rawPpgHandle)
+    rawPpgNotificationEnable = true;
 }
 
 void HeartRateService::UnsubscribeNotification(uint16_t attributeHandle) {
   if (attributeHandle == heartRateMeasurementHandle)
     heartRateMeasurementNotificationEnable = false;
+  else if (attributeHandle == rawPpgHandle)
+    rawPpgNotificationEnable = false;
 }
@@ -5,6 +5,7 @@
 #undef max
 #undef min
 #include <atomic>
+#include "components/ble/PpgSampleBatch.h"
 
 namespace Pinetime {
   namespace Controllers {
@@ -17,6 +18,7 @@ namespace Pinetime {
       void Init();
       int OnHeartRateRequested(uint16_t attributeHandle, ble_gatt_access_ctxt* context);
       void OnNewHeartRateValue(uint8_t hearRateValue);
+      void OnNewPpgSample(const PpgSampleBatch::SensorConfig& config, uint16_t hrs, uint16_t als, bool newMeasurement);
 
       void SubscribeNotification(uint16_t attributeHandle);
       void UnsubscribeNotification(uint16_t attributeHandle);
@@ -31,11 +33,20 @@ namespace Pinetime {
 
       static constexpr ble_uuid16_t heartRateMeasurementUuid {.u {.type = BLE_UUID_TYPE_16}, .value = heartRateMeasurementId};
 
-      struct ble_gatt_chr_def characteristicDefinition[2];
+      void SendPpgSamples(uint16_t connectionHandle);
+
+      struct ble_gatt_chr_def characteristicDefinition[3];
       struct ble_gatt_svc_def serviceDefinition[2];
 
       uint16_t heartRateMeasurementHandle;
+      uint16_t rawPpgHandle;
       std::atomic_bool heartRateMeasurementNotificationEnable {false};
+      std::atomic_bool rawPpgNotificationEnable {false};
+
+      // Samples are sent at least once per second, even if the batch is not full
+      static constexpr uint32_t ppgSamplesMaxLatency = 1000;
+      PpgSampleBatch ppgSamples;
+      uint32_t ppgSequence = 0;
     };
   }
 }
@@ -62,11 +62,9 @@ int ImmediateAlertService::OnAlertLevelChanged(uint16_t attributeHandle, ble_gat
       auto alertLevel = static_cast<Levels>(context->om->om_data[0]);
       auto* alertString = ToString(alertLevel);
 
-      NotificationManager::Notification notif;
-      std::memcpy(notif.message.data(), alertString, strlen(alertString) + 1);
-      notif.size = strlen(alertString) + 1;
-      notif.category = Pinetime::Controllers::NotificationManager::Categories::SimpleAlert;
-      notificationManager.Push(std::move(notif));
+      notificationManager.Push(Pinetime::Controllers::NotificationManager::Categories::SimpleAlert,
+                               alertString,
+                               strlen(alertString) + 1);
 
       systemTask.PushMessage(Pinetime::System::Messages::OnNewNotification);
     }
@@ -0,0 +1,111 @@
+#include "components/ble/MbufReader.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace Pinetime::Controllers;
+
+MbufReader::MbufReader(const os_mbuf* om) : current {om} {
+  for (auto* segment = om; segment != nullptr; segment = SLIST_NEXT(segment, om_next)) {
+    remaining += segment->om_len;
+  }
+  NextSegment();
+}
+
+void MbufReader::NextSegment() {
+  // Skip the empty mbufs so that current always points to the next byte to read (or is null at the end)
+  while (current != nullptr && offset >= current->om_len) {
+    current = SLIST_NEXT(current, om_next);
+    offset = 0;
+  }
+}
+
+void MbufReader::Read(void* destination, size_t size) {
+  auto* out = static_cast<uint8_t*>(destination);
+  if (size > remaining) {
+    valid = false;
+    std::memset(out + remaining, 0, size - remaining);
+    size = remaining;
+  }
+
+  remaining -= size;
+  while (size > 0) {
+    size_t chunk = std::min(size, static_cast<size_t>(current->om_len - offset));
+    std::memcpy(out, current->om_data + offset, chunk);
+    out += chunk;
+    size -= chunk;
+    offset += chunk;
+    NextSegment();
+  }
+}
+
+const uint8_t* MbufReader::ReadInPlace(uint8_t* scratch, size_t size) {
+  if (size <= remaining && current != nullptr && current->om_len - offset >= size) {
+    const uint8_t* data = current->om_data + offset;
+    offset += size;
+    remaining -= size;
+    NextSegment();
+    return data;
+  }
+  Read(scratch, size);
+  return scratch;
+}
+
+void MbufReader::Skip(size_t size) {
+  if (size > remaining) {
+    valid = false;
+    size = remaining;
+  }
+
+  remaining -= size;
+  while (size > 0) {
+    size_t chunk = std::min(size, static_cast<size_t>(current->om_len - offset));
+    size -= chunk;
+    offset += chunk;
+    NextSegment();
+  }
+}
+
+uint8_t MbufReader::ReadU8() {
+  uint8_t value;
+  Read(&value, sizeof(value));
+  return value;
+}
+
+uint16_t MbufReader::ReadU16() {
+  uint8_t data[2];
+  Read(data, sizeof(data));
+  return data[0] | (data[1] << 8);
+}
+
+int16_t MbufReader::ReadI16() {
+  return static_cast<int16_t>(ReadU16());
+}
+
+uint32_t MbufReader::ReadU32() {
+  uint8_t data[4];
+  Read(data, sizeof(data));
+  return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+uint64_t MbufReader::ReadU64() {
+  uint64_t low = ReadU32();
+  uint64_t high = ReadU32();
+  return low | (high << 32);
+}
+
+void MbufReader::ReadString(char* destination, size_t capacity, size_t fieldSize) {
+  if (capacity == 0) {
+    Skip(fieldSize);
+    return;
+  }
+  size_t size = std::min(fieldSize, capacity - 1);
+  Read(destination, size);
+  destination[size] = '\0';
+  Skip(fieldSize - size);
+}
+
+uint8_t MbufReader::ReadLengthPrefixedString(char* destination, size_t capacity) {
+  uint8_t size = ReadU8();
+  ReadString(destination, capacity, size);
+  return size;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <os/os_mbuf.h>
+#undef max
+#undef min
+
+namespace Pinetime {
+  namespace Controllers {
+    /* Sequential, bounds-checked reader over a chain of os_mbuf (the data received in GATT writes and notifications).
+     *
+     * The data is decoded directly from the mbufs, without flattening the chain first. Integers are little-endian,
+     * like everything in BLE. Reading past the end of the data does not fail immediately: it returns zeros and makes
+     * IsValid() return false, so that a message can be decoded in one go and checked once at the end.
+     */
+    class MbufReader {
+    public:
+      explicit MbufReader(const os_mbuf* om);
+
+      size_t Remaining() const {
+        return remaining;
+      }
+
+      bool IsValid() const {
+        return valid;
+      }
+
+      uint8_t ReadU8();
+      uint16_t ReadU16();
+      int16_t ReadI16();
+      uint32_t ReadU32();
+      uint64_t ReadU64();
+
+      void Skip(size_t size);
+
+      // Copies size bytes to destination
+      void Read(void* destination, size_t size);
+
+      // Returns a pointer to the next size bytes and moves past them. If they are stored in a single mbuf, the pointer
+      // points directly into the mbuf, otherwise the bytes are copied to scratch (which must be at least size bytes long).
+      const uint8_t* ReadInPlace(uint8_t* scratch, size_t size);
+
+      // Reads a string field of fieldSize bytes into destination and null-terminates it.
+      // At most capacity - 1 bytes are copied, the rest of the field is skipped. Nothing is written if capacity is 0.
+      void ReadString(char* destination, size_t capacity, size_t fieldSize);
+
+      // Same as ReadString(), for a field prefixed by its size (u8). Returns the size of the field.
+      uint8_t ReadLengthPrefixedString(char* destination, size_t capacity);
+
+    private:
+      void NextSegment();
+
+      const os_mbuf* current;
+      size_t offset = 0;
+      size_t remaining = 0;
+      bool valid = true;
+    };
+  }
+}
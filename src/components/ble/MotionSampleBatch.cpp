@@ -0,0 +1,75 @@
+#include "components/ble/MotionSampleBatch.h"
+#include <cstring>
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  size_t WriteVarint(uint8_t* data, uint32_t value) {
+    size_t size = 0;
+    while (value >= 0x80) {
+      data[size++] = static_cast<uint8_t>(value) | 0x80;
+      value >>= 7;
+    }
+    data[size++] = static_cast<uint8_t>(value);
+    return size;
+  }
+
+  uint32_t ZigZag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+  }
+}
+
+void MotionSampleBatch::Start(bool deltaEncoded, uint32_t timestamp) {
+  this->deltaEncoded = deltaEncoded;
+  firstTimestamp = timestamp;
+  lastTimestamp = timestamp;
+  count = 0;
+  sequence++;
+
+  buffer[0] = deltaEncoded ? flagDeltaEncoded : 0;
+  buffer[1] = 0;
+  buffer[2] = static_cast<uint8_t>(sequence);
+  buffer[3] = static_cast<uint8_t>(sequence >> 8);
+  buffer[4] = static_cast<uint8_t>(timestamp);
+  buffer[5] = static_cast<uint8_t>(timestamp >> 8);
+  buffer[6] = static_cast<uint8_t>(timestamp >> 16);
+  buffer[7] = static_cast<uint8_t>(timestamp >> 24);
+  size = headerSize;
+}
+
+bool MotionSampleBatch::Append(uint32_t timestamp, int16_t x, int16_t y, int16_t z, size_t sizeLimit) {
+  uint32_t elapsed = timestamp - lastTimestamp;
+  if (size < headerSize || count == UINT8_MAX || elapsed > UINT8_MAX) {
+    return false;
+  }
+
+  // 1 byte for the time + 3 varints of at most 3 bytes (17 bits differences)
+  uint8_t sample[10];
+  size_t sampleSize = 0;
+  sample[sampleSize++] = static_cast<uint8_t>(elapsed);
+  const int16_t values[3] = {x, y, z};
+  if (deltaEncoded && count > 0) {
+    for (size_t i = 0; i < 3; i++) {
+      sampleSize += WriteVarint(sample + sampleSize, ZigZag(values[i] - lastValues[i]));
+    }
+  } else {
+    for (auto value : values) {
+      sample[sampleSize++] = static_cast<uint8_t>(value);
+      sample[sampleSize++] = static_cast<uint8_t>(static_cast<uint16_t>(value) >> 8);
+    }
+  }
+
+  if (sizeLimit > maxSize) {
+    sizeLimit = maxSize;
+  }
+  if (size + sampleSize > sizeLimit) {
+    return false;
+  }
+
+  std::memcpy(buffer + size, sample, sampleSize);
+  size += sampleSize;
+  buffer[1] = ++count;
+  lastTimestamp = timestamp;
+  std::memcpy(lastValues, values, sizeof(values));
+  return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Pinetime {
+  namespace Controllers {
+    /* Packs timestamped accelerometer samples into the payload of a single notification
+     * (see doc/MotionService.md, "Motion samples").
+     *
+     * Header (8 bytes) : flags (u8), number of samples (u8), batch sequence number (u16), timestamp of the first sample in ms (u32)
+     * Then for each sample : time since the previous sample in ms (u8), followed by
+     *   - x, y, z as int16, or
+     *   - when the batch is delta encoded, x, y, z differences to the previous sample as zigzag varints
+     *     (the first sample of the batch is always stored as int16)
+     */
+    class MotionSampleBatch {
+    public:
+      static constexpr size_t headerSize = 8;
+      static constexpr size_t maxSize = 253; // ATT payload for the preferred MTU (256)
+      static constexpr uint8_t flagDeltaEncoded = 0x01;
+
+      // Starts a new batch. The previous one must have been sent (or dropped) before.
+      void Start(bool deltaEncoded, uint32_t timestamp);
+
+      // Returns false if the sample does not fit in the batch (size limit or time gap too big), in which case the batch
+      // must be sent and a new one started.
+      bool Append(uint32_t timestamp, int16_t x, int16_t y, int16_t z, size_t sizeLimit);
+
+      void Clear() {
+        size = 0;
+        count = 0;
+      }
+
+      bool IsEmpty() const {
+        return count == 0;
+      }
+
+      uint32_t FirstTimestamp() const {
+        return firstTimestamp;
+      }
+
+      const uint8_t* Data() const {
+        return buffer;
+      }
+
+      size_t Size() const {
+        return size;
+      }
+
+    private:
+      uint8_t buffer[maxSize];
+      size_t size = 0;
+      uint8_t count = 0;
+      uint16_t sequence = 0;
+      bool deltaEncoded = false;
+      uint32_t firstTimestamp = 0;
+      uint32_t lastTimestamp = 0;
+      int16_t lastValues[3] = {};
+    };
+  }
+}
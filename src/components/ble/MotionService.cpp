@@ -2,6 +2,11 @@
 #include "components/motion/MotionController.h"
 #include "components/ble/NimbleController.h"
 #include <nrf_log.h>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_att.h>
+#undef max
+#undef min
 
 using namespace Pinetime::Controllers;
 
@@ -20,6 +25,7 @@ namespace {
   constexpr ble_uuid128_t motionServiceUuid {BaseUuid()};
   constexpr ble_uuid128_t stepCountCharUuid {CharUuid(0x01, 0x00)};
   constexpr ble_uuid128_t motionValuesCharUuid {CharUuid(0x02, 0x00)};
+  constexpr ble_uuid128_t motionSamplesCharUuid {CharUuid(0x03, 0x00)};
 
   int MotionServiceCallback(uint16_t /*conn_handle*/, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
     auto* motionService = static_cast<MotionService*>(arg);
@@ -41,6 +47,11 @@ MotionService::MotionService(NimbleController& nimble, Controllers::MotionContro
                                .arg = this,
                                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
                                .val_handle = &motionValuesHandle},
+                              {.uuid = &motionSamplesCharUuid.u,
+                               .access_cb = MotionServiceCallback,
+                               .arg = this,
+                               .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_NOTIFY,
+                               .val_handle = &motionSamplesHandle},
                               {0}},
     serviceDefinition {
       {.type = BLE_GATT_SVC_TYPE_PRIMARY, .uuid = &motionServiceUuid.u, .characteristics = characteristicDefinition},
@@ -73,6 +84,20 @@ int MotionService::OnStepCountRequested(uint16_t attributeHandle, ble_gatt_acces
     int res = os_mbuf_append(context->om, buffer, 3 * sizeof(int16_t));
     return (res == 0) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
   }
+  if (attributeHandle == motionSamplesHandle) {
+    if (context->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
+      if (OS_MBUF_PKTLEN(context->om) < 1) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+      }
+      uint8_t flags;
+      os_mbuf_copydata(context->om, 0, 1, &flags);
+      motionSamplesDeltaEncoded = (flags & MotionSampleBatch::flagDeltaEncoded) != 0;
+      return 0;
+    }
+    uint8_t flags = motionSamplesDeltaEncoded ? MotionSampleBatch::flagDeltaEncoded : 0;
+    int res = os_mbuf_append(context->om, &flags, sizeof(flags));
+    return (res == 0) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+  }
   return 0;
 }
 
@@ -82,15 +107,7 @@ void MotionService::OnNewStepCountValue(uint32_t stepCount) {
   }
 
   uint32_t buffer = stepCount;
-  auto* om = ble_hs_mbuf_from_flat(&buffer, sizeof(buffer));
-
-  uint16_t connectionHandle = nimble.connHandle();
-
-  if (connectionHandle == 0 || connectionHandle == BLE_HS_CONN_HANDLE_NONE) {
-    return;
-  }
-
-  ble_gattc_notify_custom(connectionHandle, stepCountHandle, om);
+  nimble.notifications().Notify(NotificationScheduler::Characteristics::StepCount, stepCountHandle, &buffer, sizeof(buffer));
 }
 
 void MotionService::OnNewMotionValues(int16_t x, int16_t y, int16_t z) {
@@ -99,15 +116,40 @@ void MotionService::OnNewMotionValues(int16_t x, int16_t y, int16_t z) {
   }
 
   int16_t buffer[3] = {x, y, z};
-  auto* om = ble_hs_mbuf_from_flat(buffer, 3 * sizeof(int16_t));
+  nimble.notifications().Notify(NotificationScheduler::Characteristics::MotionValues, motionValuesHandle, buffer, sizeof(buffer));
+}
+
+void MotionService::OnNewMotionSample(uint32_t timestamp, int16_t x, int16_t y, int16_t z) {
+  if (!motionSamplesNotificationEnabled) {
+    motionSamples.Clear();
+    return;
+  }
 
   uint16_t connectionHandle = nimble.connHandle();
 
   if (connectionHandle == 0 || connectionHandle == BLE_HS_CONN_HANDLE_NONE) {
+    motionSamples.Clear();
     return;
   }
 
-  ble_gattc_notify_custom(connectionHandle, motionValuesHandle, om);
+  size_t sizeLimit = ble_att_mtu(connectionHandle) - 3;
+  if (!motionSamples.IsEmpty() && !motionSamples.Append(timestamp, x, y, z, sizeLimit)) {
+    SendMotionSamples(connectionHandle);
+  }
+  if (motionSamples.IsEmpty()) {
+    motionSamples.Start(motionSamplesDeltaEncoded, timestamp);
+    motionSamples.Append(timestamp, x, y, z, sizeLimit);
+  }
+
+  if (timestamp - motionSamples.FirstTimestamp() >= motionSamplesMaxLatency) {
+    SendMotionSamples(connectionHandle);
+  }
+}
+
+void MotionService::SendMotionSamples(uint16_t connectionHandle) {
+  auto* om = ble_hs_mbuf_from_flat(motionSamples.Data(), motionSamples.Size());
+  motionSamples.Clear();
+  ble_gattc_notify_custom(connectionHandle, motionSamplesHandle, om);
 }
 
 void MotionService::SubscribeNotification(uint16_t attributeHandle) {
@@ -115,6 +157,8 @@ void MotionService::SubscribeNotification(uint16_t attributeHandle) {
     stepCountNotificationEnabled = true;
   } else if (attributeHandle == motionValuesHandle) {
     motionValuesNotificationEnabled = true;
+  } else if (attributeHandle == motionSamplesHandle) {
+    motionSamplesNotificationEnabled = true;
   }
 }
 
@@ -123,5 +167,7 @@ void MotionService::UnsubscribeNotification(uint16_t attributeHandle) {
     stepCountNotificationEnabled = false;
   } else if (attributeHandle == motionValuesHandle) {
     motionValuesNotificationEnabled = false;
+  } else if (attributeHandle == motionSamplesHandle) {
+    motionSamplesNotificationEnabled = false;
   }
 }
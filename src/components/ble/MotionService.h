@@ -5,6 +5,7 @@
 #include <atomic>
 #undef max
 #undef min
+#include "components/ble/MotionSampleBatch.h"
 
 namespace Pinetime {
   namespace Controllers {
@@ -18,6 +19,7 @@ namespace Pinetime {
       int OnStepCountRequested(uint16_t attributeHandle, ble_gatt_access_ctxt* context);
       void OnNewStepCountValue(uint32_t stepCount);
       void OnNewMotionValues(int16_t x, int16_t y, int16_t z);
+      void OnNewMotionSample(uint32_t timestamp, int16_t x, int16_t y, int16_t z);
 
       void SubscribeNotification(uint16_t attributeHandle);
       void UnsubscribeNotification(uint16_t attributeHandle);
@@ -26,13 +28,22 @@ namespace Pinetime {
       NimbleController& nimble;
       Controllers::MotionController& motionController;
 
-      struct ble_gatt_chr_def characteristicDefinition[3];
+      void SendMotionSamples(uint16_t connectionHandle);
+
+      struct ble_gatt_chr_def characteristicDefinition[4];
       struct ble_gatt_svc_def serviceDefinition[2];
 
       uint16_t stepCountHandle;
       uint16_t motionValuesHandle;
+      uint16_t motionSamplesHandle;
       std::atomic_bool stepCountNotificationEnabled {false};
       std::atomic_bool motionValuesNotificationEnabled {false};
+      std::atomic_bool motionSamplesNotificationEnabled {false};
+      std::atomic_bool motionSamplesDeltaEncoded {false};
+
+      // Samples are sent at least once per second, even if the batch is not full
+      static constexpr uint32_t motionSamplesMaxLatency = 1000;
+      MotionSampleBatch motionSamples;
     };
   }
 }
@@ -48,14 +48,14 @@ namespace {
   constexpr ble_uuid128_t msRepeatCharUuid {CharUuid(0x0b, 0x00)};
   constexpr ble_uuid128_t msShuffleCharUuid {CharUuid(0x0c, 0x00)};
 
-  constexpr uint8_t MaxStringSize {40};
-
   int MusicCallback(uint16_t /*conn_handle*/, uint16_t /*attr_handle*/, struct ble_gatt_access_ctxt* ctxt, void* arg) {
     return static_cast<Pinetime::Controllers::MusicService*>(arg)->OnCommand(ctxt);
   }
 }
 
 Pinetime::Controllers::MusicService::MusicService(Pinetime::Controllers::NimbleController& nimble) : nimble(nimble) {
+  artistName.Assign("Not Playing");
+
   characteristicDefinition[0] = {.uuid = &msEventCharUuid.u,
                                  .access_cb = MusicCallback,
                                  .arg = this,
@@ -126,29 +126,29 @@ void Pinetime::Controllers::MusicService::Init() {
 
 int Pinetime::Controllers::MusicService::OnCommand(struct ble_gatt_access_ctxt* ctxt) {
   if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
+    // Copy one byte more than the capacity of the strings so that they know when the text must be truncated
     size_t notifSize = OS_MBUF_PKTLEN(ctxt->om);
     size_t bufferSize = notifSize;
-    if (notifSize > MaxStringSize) {
-      bufferSize = MaxStringSize;
+    if (notifSize > MaxStringSize + 1) {
+      bufferSize = MaxStringSize + 1;
     }
 
-    char data[bufferSize + 1];
+    char data[MaxStringSize + 2] = {};
     os_mbuf_copydata(ctxt->om, 0, bufferSize, data);
 
-    if (notifSize > bufferSize) {
-      data[bufferSize - 1] = '.';
-      data[bufferSize - 2] = '.';
-      data[bufferSize - 3] = '.';
-    }
-    data[bufferSize] = '\0';
-
     char* s = &data[0];
     if (ble_uuid_cmp(ctxt->chr->uuid, &msArtistCharUuid.u) == 0) {
-      artistName = s;
+      if (artistName.Assign(s, bufferSize, true)) {
+        textSequence++;
+      }
     } else if (ble_uuid_cmp(ctxt->chr->uuid, &msTrackCharUuid.u) == 0) {
-      trackName = s;
+      if (trackName.Assign(s, bufferSize, true)) {
+        textSequence++;
+      }
     } else if (ble_uuid_cmp(ctxt->chr->uuid, &msAlbumCharUuid.u) == 0) {
-      albumName = s;
+      if (albumName.Assign(s, bufferSize, true)) {
+        textSequence++;
+      }
     } else if (ble_uuid_cmp(ctxt->chr->uuid, &msStatusCharUuid.u) == 0) {
       playing = s[0];
       // These variables need to be updated, because the progress may not be updated immediately,
@@ -179,16 +179,20 @@ int Pinetime::Controllers::MusicService::OnCommand(struct ble_gatt_access_ctxt*
   return 0;
 }
 
-std::string Pinetime::Controllers::MusicService::getAlbum() const {
-  return albumName;
+const char* Pinetime::Controllers::MusicService::getAlbum() const {
+  return albumName.Data();
+}
+
+const char* Pinetime::Controllers::MusicService::getArtist() const {
+  return artistName.Data();
 }
 
-std::string Pinetime::Controllers::MusicService::getArtist() const {
-  return artistName;
+const char* Pinetime::Controllers::MusicService::getTrack() const {
+  return trackName.Data();
 }
 
-std::string Pinetime::Controllers::MusicService::getTrack() const {
-  return trackName;
+uint32_t Pinetime::Controllers::MusicService::getTextSequence() const {
+  return textSequence;
 }
 
 bool Pinetime::Controllers::MusicService::isPlaying() const {
@@ -17,8 +17,8 @@
 */
 #pragma once
 
+#include <atomic>
 #include <cstdint>
-#include <string>
 #define min // workaround: nimble's min/max macros conflict with libstdc++
 #define max
 #include <host/ble_gap.h>
@@ -26,6 +26,7 @@
 #undef max
 #undef min
 #include <FreeRTOS.h>
+#include "utility/FixedString.h"
 
 namespace Pinetime {
   namespace Controllers {
@@ -41,11 +42,14 @@ namespace Pinetime {
 
       void event(char event);
 
-      std::string getArtist() const;
+      const char* getArtist() const;
 
-      std::string getTrack() const;
+      const char* getTrack() const;
 
-      std::string getAlbum() const;
+      const char* getAlbum() const;
+
+      // Incremented every time the artist, track or album changes
+      uint32_t getTextSequence() const;
 
       int getProgress() const;
 
@@ -65,15 +69,18 @@ namespace Pinetime {
 
       enum MusicStatus { NotPlaying = 0x00, Playing = 0x01 };
 
+      static constexpr size_t MaxStringSize {40};
+
     private:
       struct ble_gatt_chr_def characteristicDefinition[14];
       struct ble_gatt_svc_def serviceDefinition[2];
 
       uint16_t eventHandle {};
 
-      std::string trackName;
-      std::string albumName;
-      std::string artistName {"Not Playing"};
+      Utility::FixedString<MaxStringSize> trackName;
+      Utility::FixedString<MaxStringSize> albumName;
+      Utility::FixedString<MaxStringSize> artistName;
+      std::atomic<uint32_t> textSequence {0};
 
       bool playing {false};
 
@@ -17,6 +17,8 @@
 */
 
 #include "components/ble/NavigationService.h"
+#include <algorithm>
+#include "components/ble/MbufReader.h"
 
 namespace {
   // 0001yyxx-78fc-48fe-8e23-433b3a1942d0
@@ -82,36 +84,46 @@ void Pinetime::Controllers::NavigationService::Init() {
 int Pinetime::Controllers::NavigationService::OnCommand(struct ble_gatt_access_ctxt* ctxt) {
 
   if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
-    size_t notifSize = OS_MBUF_PKTLEN(ctxt->om);
-    uint8_t data[notifSize + 1];
-    data[notifSize] = '\0';
-    os_mbuf_copydata(ctxt->om, 0, notifSize, data);
-    char* s = (char*) &data[0];
+    // Read one byte more than the capacity of the strings so that they know when the text must be truncated.
+    // The data is only copied to scratch if it is split across several mbufs.
+    MbufReader reader {ctxt->om};
+    size_t notifSize = std::min(reader.Remaining(), MaxNarrativeSize + 1);
+    uint8_t scratch[MaxNarrativeSize + 1];
+    const auto* data = reader.ReadInPlace(scratch, notifSize);
+    const char* s = reinterpret_cast<const char*>(data);
+    bool changed = false;
     if (ble_uuid_cmp(ctxt->chr->uuid, &navFlagCharUuid.u) == 0) {
-      m_flag = s;
+      changed = m_flag.Assign(s, notifSize);
     } else if (ble_uuid_cmp(ctxt->chr->uuid, &navNarrativeCharUuid.u) == 0) {
-      m_narrative = s;
+      changed = m_narrative.Assign(s, notifSize, true);
     } else if (ble_uuid_cmp(ctxt->chr->uuid, &navManDistCharUuid.u) == 0) {
-      m_manDist = s;
+      changed = m_manDist.Assign(s, notifSize);
     } else if (ble_uuid_cmp(ctxt->chr->uuid, &navProgressCharUuid.u) == 0) {
-      m_progress = data[0];
+      m_progress = (notifSize > 0) ? data[0] : 0;
+    }
+    if (changed) {
+      m_textSequence++;
     }
   }
   return 0;
 }
 
-std::string Pinetime::Controllers::NavigationService::getFlag() {
-  return m_flag;
+const char* Pinetime::Controllers::NavigationService::getFlag() const {
+  return m_flag.Data();
 }
 
-std::string Pinetime::Controllers::NavigationService::getNarrative() {
-  return m_narrative;
+const char* Pinetime::Controllers::NavigationService::getNarrative() const {
+  return m_narrative.Data();
 }
 
-std::string Pinetime::Controllers::NavigationService::getManDist() {
-  return m_manDist;
+const char* Pinetime::Controllers::NavigationService::getManDist() const {
+  return m_manDist.Data();
 }
 
-int Pinetime::Controllers::NavigationService::getProgress() {
+int Pinetime::Controllers::NavigationService::getProgress() const {
   return m_progress;
 }
+
+uint32_t Pinetime::Controllers::NavigationService::getTextSequence() const {
+  return m_textSequence;
+}
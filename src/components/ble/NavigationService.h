@@ -17,14 +17,15 @@
 */
 #pragma once
 
+#include <atomic>
 #include <cstdint>
-#include <string>
 #define min // workaround: nimble's min/max macros conflict with libstdc++
 #define max
 #include <host/ble_gap.h>
 #include <host/ble_uuid.h>
 #undef max
 #undef min
+#include "utility/FixedString.h"
 
 namespace Pinetime {
   namespace Controllers {
@@ -37,22 +38,30 @@ namespace Pinetime {
 
       int OnCommand(struct ble_gatt_access_ctxt* ctxt);
 
-      std::string getFlag();
+      const char* getFlag() const;
 
-      std::string getNarrative();
+      const char* getNarrative() const;
 
-      std::string getManDist();
+      const char* getManDist() const;
 
-      int getProgress();
+      int getProgress() const;
+
+      // Incremented every time the flag, narrative or distance changes
+      uint32_t getTextSequence() const;
+
+      static constexpr size_t MaxFlagSize {32};
+      static constexpr size_t MaxNarrativeSize {120};
+      static constexpr size_t MaxManDistSize {16};
 
     private:
       struct ble_gatt_chr_def characteristicDefinition[5];
       struct ble_gatt_svc_def serviceDefinition[2];
 
-      std::string m_flag;
-      std::string m_narrative;
-      std::string m_manDist;
+      Utility::FixedString<MaxFlagSize> m_flag;
+      Utility::FixedString<MaxNarrativeSize> m_narrative;
+      Utility::FixedString<MaxManDistSize> m_manDist;
       int m_progress;
+      std::atomic<uint32_t> m_textSequence {0};
     };
   }
 }
@@ -12,6 +12,7 @@
 #include <controller/ble_hw.h>
 #include <services/gap/ble_svc_gap.h>
 #include <services/gatt/ble_svc_gatt.h>
+#include <nimble/nimble_port.h>
 #undef max
 #undef min
 #include "components/ble/BleController.h"
@@ -22,6 +23,11 @@
 
 using namespace Pinetime::Controllers;
 
+void RestartAdvertisingCallback(struct ble_npl_event* event) {
+  auto nimbleController = static_cast<NimbleController*>(ble_npl_event_get_arg(event));
+  nimbleController->OnRestartAdvertising();
+}
+
 NimbleController::NimbleController(Pinetime::System::SystemTask& systemTask,
                                    Ble& bleController,
                                    DateTime& dateTimeController,
@@ -30,6 +36,7 @@ NimbleController::NimbleController(Pinetime::System::SystemTask& systemTask,
                                    Pinetime::Drivers::SpiNorFlash& spiNorFlash,
                                    HeartRateController& heartRateController,
                                    MotionController& motionController,
+                                   ActivityHistory& activityHistory,
                                    FS& fs)
   : systemTask {systemTask},
     bleController {bleController},
@@ -43,13 +50,18 @@ NimbleController::NimbleController(Pinetime::System::SystemTask& systemTask,
     alertNotificationClient {systemTask, notificationManager},
     currentTimeService {dateTimeController},
     musicService {*this},
-    weatherService {dateTimeController},
+    weatherService {systemTask, dateTimeController, fs},
     batteryInformationService {batteryController},
     immediateAlertService {systemTask, notificationManager},
     heartRateService {*this, heartRateController},
     motionService {*this, motionController},
     fsService {systemTask, fs},
-    serviceDiscovery({&currentTimeClient, &alertNotificationClient}) {
+    telemetryService {*this, systemTask.Monitor()},
+    activitySyncService {*this, systemTask, activityHistory, fs},
+    bondStorage {fs},
+    gattCache {fs},
+    serviceDiscovery({&serviceChangedClient, &currentTimeClient, &alertNotificationClient}, gattCache) {
+  ble_npl_event_init(&restartAdvertisingEvent, RestartAdvertisingCallback, this);
 }
 
 void nimble_on_reset(int reason) {
@@ -98,6 +110,9 @@ void NimbleController::Init() {
   heartRateService.Init();
   motionService.Init();
   fsService.Init();
+  telemetryService.Init();
+  activitySyncService.Init();
+  notificationScheduler.Init();
 
   int rc;
   rc = ble_hs_util_ensure_addr(0);
@@ -131,7 +146,8 @@ void NimbleController::Init() {
   rc = ble_gatts_start();
   ASSERT(rc == 0);
 
-  RestoreBond();
+  bondStorage.Restore();
+  gattCache.Init();
 
   StartAdvertising();
 }
@@ -145,26 +161,25 @@ void NimbleController::StartAdvertising() {
   memset(&fields, 0, sizeof(fields));
   memset(&rsp_fields, 0, sizeof(rsp_fields));
 
+  // Bonded phones do not need the services to reconnect, a smaller payload shortens each advertising event
+  int nbBonds = 0;
+  ble_store_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC, &nbBonds);
+  auto parameters = advertisingScheduler.Next(nbBonds > 0);
   adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
   adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
-  /* fast advertise for 30 sec */
-  if (fastAdvCount < 15) {
-    adv_params.itvl_min = 32;
-    adv_params.itvl_max = 47;
-    fastAdvCount++;
-  } else {
-    adv_params.itvl_min = 1636;
-    adv_params.itvl_max = 1651;
-  }
+  adv_params.itvl_min = parameters.intervalMin;
+  adv_params.itvl_max = parameters.intervalMax;
 
   fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
-  fields.uuids16 = &HeartRateService::heartRateServiceUuid;
-  fields.num_uuids16 = 1;
-  fields.uuids16_is_complete = 1;
-  fields.uuids128 = &DfuService::serviceUuid;
-  fields.num_uuids128 = 1;
-  fields.uuids128_is_complete = 1;
-  fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
+  if (parameters.fullPayload) {
+    fields.uuids16 = &HeartRateService::heartRateServiceUuid;
+    fields.num_uuids16 = 1;
+    fields.uuids16_is_complete = 1;
+    fields.uuids128 = &DfuService::serviceUuid;
+    fields.num_uuids128 = 1;
+    fields.uuids128_is_complete = 1;
+    fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
+  }
 
   rsp_fields.name = reinterpret_cast<const uint8_t*>(deviceName);
   rsp_fields.name_len = strlen(deviceName);
@@ -177,10 +192,28 @@ void NimbleController::StartAdvertising() {
   rc = ble_gap_adv_rsp_set_fields(&rsp_fields);
   ASSERT(rc == 0);
 
-  rc = ble_gap_adv_start(addrType, NULL, 2000, &adv_params, GAPEventCallback, this);
+  int32_t duration = parameters.durationMs != 0 ? parameters.durationMs : BLE_HS_FOREVER;
+  rc = ble_gap_adv_start(addrType, NULL, duration, &adv_params, GAPEventCallback, this);
   ASSERT(rc == 0);
 }
 
+void NimbleController::RestartFastAdv() {
+  // The advertising can only be restarted safely from the BLE host task
+  ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &restartAdvertisingEvent);
+}
+
+void NimbleController::OnRestartAdvertising() {
+  if (!bleController.IsRadioEnabled() || bleController.IsConnected()) {
+    return;
+  }
+
+  advertisingScheduler.OnEvent(AdvertisingScheduler::Events::WakeUp);
+  if (ble_gap_adv_active()) {
+    ble_gap_adv_stop();
+  }
+  StartAdvertising();
+}
+
 int NimbleController::OnGAPEvent(ble_gap_event* event) {
   switch (event->type) {
     case BLE_GAP_EVENT_ADV_COMPLETE:
@@ -198,14 +231,14 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
 
       if (event->connect.status != 0) {
         /* Connection failed; resume advertising. */
-        currentTimeClient.Reset();
-        alertNotificationClient.Reset();
+        serviceDiscovery.Reset();
         connectionHandle = BLE_HS_CONN_HANDLE_NONE;
         bleController.Disconnect();
-        fastAdvCount = 0;
+        advertisingScheduler.OnEvent(AdvertisingScheduler::Events::Disconnected);
         StartAdvertising();
       } else {
         connectionHandle = event->connect.conn_handle;
+        notificationScheduler.OnConnected(connectionHandle);
         bleController.Connect();
         systemTask.PushMessage(Pinetime::System::Messages::BleConnected);
         // Service discovery is deferred via systemtask
@@ -220,13 +253,15 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
       if (event->disconnect.conn.sec_state.bonded) {
         PersistBond(event->disconnect.conn);
       }
+      PersistGattCache();
 
-      currentTimeClient.Reset();
-      alertNotificationClient.Reset();
+      serviceDiscovery.Reset();
+      notificationScheduler.OnDisconnected();
       connectionHandle = BLE_HS_CONN_HANDLE_NONE;
+      activitySyncService.OnDisconnected();
       if (bleController.IsConnected()) {
         bleController.Disconnect();
-        fastAdvCount = 0;
+        advertisingScheduler.OnEvent(AdvertisingScheduler::Events::Disconnected);
         StartAdvertising();
       }
       break;
@@ -235,6 +270,9 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
       /* The central has updated the connection parameters. */
       NRF_LOG_INFO("Update event : BLE_GAP_EVENT_CONN_UPDATE");
       NRF_LOG_INFO("update status=%0X ", event->conn_update.status);
+      if (event->conn_update.status == 0) {
+        notificationScheduler.OnConnectionUpdated(event->conn_update.conn_handle);
+      }
       break;
 
     case BLE_GAP_EVENT_CONN_UPDATE_REQ:
@@ -325,12 +363,18 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
       if (event->subscribe.reason == BLE_GAP_SUBSCRIBE_REASON_TERM) {
         heartRateService.UnsubscribeNotification(event->subscribe.attr_handle);
         motionService.UnsubscribeNotification(event->subscribe.attr_handle);
+        telemetryService.UnsubscribeNotification(event->subscribe.attr_handle);
+        activitySyncService.UnsubscribeNotification(event->subscribe.attr_handle);
       } else if (event->subscribe.prev_notify == 0 && event->subscribe.cur_notify == 1) {
         heartRateService.SubscribeNotification(event->subscribe.attr_handle);
         motionService.SubscribeNotification(event->subscribe.attr_handle);
+        telemetryService.SubscribeNotification(event->subscribe.attr_handle);
+        activitySyncService.SubscribeNotification(event->subscribe.attr_handle);
       } else if (event->subscribe.prev_notify == 1 && event->subscribe.cur_notify == 0) {
         heartRateService.UnsubscribeNotification(event->subscribe.attr_handle);
         motionService.UnsubscribeNotification(event->subscribe.attr_handle);
+        telemetryService.UnsubscribeNotification(event->subscribe.attr_handle);
+        activitySyncService.UnsubscribeNotification(event->subscribe.attr_handle);
       }
       break;
 
@@ -349,6 +393,10 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
       struct ble_gap_conn_desc desc;
       ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc);
       ble_store_util_delete_peer(&desc.peer_id_addr);
+      gattCache.Remove(desc.peer_id_addr);
+      DisableSleeping();
+      bondStorage.Remove(desc.peer_id_addr);
+      systemTask.PushMessage(Pinetime::System::Messages::EnableSleeping);
 
       /* Return BLE_GAP_REPEAT_PAIRING_RETRY to indicate that the host should
        * continue with the pairing operation.
@@ -369,7 +417,11 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
                    event->notify_rx.attr_handle,
                    notifSize);
 
-      alertNotificationClient.OnNotification(event);
+      if (IsServiceChangedIndication(event)) {
+        serviceDiscovery.OnServiceChanged(event->notify_rx.conn_handle);
+      } else {
+        alertNotificationClient.OnNotification(event);
+      }
     } break;
 
     case BLE_GAP_EVENT_NOTIFY_TX:
@@ -389,8 +441,31 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
 
 void NimbleController::StartDiscovery() {
   if (connectionHandle != BLE_HS_CONN_HANDLE_NONE) {
-    serviceDiscovery.StartDiscovery(connectionHandle);
+    // The handles are cached for bonded peers only, as their identity address does not change
+    struct ble_gap_conn_desc desc;
+    const ble_addr_t* peer = nullptr;
+    if (ble_gap_conn_find(connectionHandle, &desc) == 0 && desc.sec_state.bonded) {
+      peer = &desc.peer_id_addr;
+    }
+    serviceDiscovery.StartDiscovery(connectionHandle, peer);
+  }
+}
+
+bool NimbleController::IsServiceChangedIndication(const ble_gap_event* event) {
+  if (!event->notify_rx.indication) {
+    return false;
+  }
+  if (serviceChangedClient.IsServiceChangedHandle(event->notify_rx.attr_handle)) {
+    return true;
+  }
+
+  // The peer sends the indication right after reconnecting, before the discovery is started
+  struct ble_gap_conn_desc desc;
+  if (ble_gap_conn_find(event->notify_rx.conn_handle, &desc) != 0 || !desc.sec_state.bonded) {
+    return false;
   }
+  const auto* handles = gattCache.Find(desc.peer_id_addr);
+  return handles != nullptr && handles->serviceChanged != 0 && handles->serviceChanged == event->notify_rx.attr_handle;
 }
 
 uint16_t NimbleController::connHandle() {
@@ -399,14 +474,14 @@ uint16_t NimbleController::connHandle() {
 
 void NimbleController::NotifyBatteryLevel(uint8_t level) {
   if (connectionHandle != BLE_HS_CONN_HANDLE_NONE) {
-    batteryInformationService.NotifyBatteryLevel(connectionHandle, level);
+    batteryInformationService.NotifyBatteryLevel(notificationScheduler, level);
   }
 }
 
 void NimbleController::EnableRadio() {
   bleController.EnableRadio();
   bleController.Disconnect();
-  fastAdvCount = 0;
+  advertisingScheduler.OnEvent(AdvertisingScheduler::Events::Start);
   StartAdvertising();
 }
 
@@ -421,86 +496,37 @@ void NimbleController::DisableRadio() {
 }
 
 void NimbleController::PersistBond(struct ble_gap_conn_desc& desc) {
-  union ble_store_key key;
-  union ble_store_value our_sec, peer_sec, peer_cccd_set[MYNEWT_VAL(BLE_STORE_MAX_CCCDS)] = {0};
-  int rc;
-
-  memset(&key, 0, sizeof key);
-  memset(&our_sec, 0, sizeof our_sec);
-  key.sec.peer_addr = desc.peer_id_addr;
-  rc = ble_store_read_our_sec(&key.sec, &our_sec.sec);
-
-  if (memcmp(&our_sec.sec, &bondId, sizeof bondId) == 0) {
+  // Called on each encryption change and disconnection : only write the bond if it changed
+  if (bondStorage.IsUpToDate(desc.peer_id_addr)) {
     return;
   }
 
-  memcpy(&bondId, &our_sec.sec, sizeof bondId);
-
-  memset(&key, 0, sizeof key);
-  memset(&peer_sec, 0, sizeof peer_sec);
-  key.sec.peer_addr = desc.peer_id_addr;
-  rc += ble_store_read_peer_sec(&key.sec, &peer_sec.sec);
-
-  if (rc == 0) {
-    memset(&key, 0, sizeof key);
-    key.cccd.peer_addr = desc.peer_id_addr;
-    int peer_count = 0;
-    ble_store_util_count(BLE_STORE_OBJ_TYPE_CCCD, &peer_count);
-    for (int i = 0; i < peer_count; i++) {
-      key.cccd.idx = peer_count;
-      ble_store_read_cccd(&key.cccd, &peer_cccd_set[i].cccd);
-    }
-
-    /* Wakeup Spi and SpiNorFlash before accessing the file system
-     * This should be fixed in the FS driver
-     */
-    systemTask.PushMessage(Pinetime::System::Messages::DisableSleeping);
-
-    // This isn't quite correct
-    // SystemTask could receive EnableSleeping right after passing this check
-    // We need some guarantee that the SystemTask has processed the above message
-    // before we can continue
-    while (!systemTask.IsSleepDisabled()) {
-      vTaskDelay(pdMS_TO_TICKS(5));
-    }
-
-    lfs_file_t file_p;
+  DisableSleeping();
+  bondStorage.Store(desc.peer_id_addr);
+  systemTask.PushMessage(Pinetime::System::Messages::EnableSleeping);
+}
 
-    rc = fs.FileOpen(&file_p, "/bond.dat", LFS_O_WRONLY | LFS_O_CREAT);
-    if (rc == 0) {
-      fs.FileWrite(&file_p, reinterpret_cast<uint8_t*>(&our_sec.sec), sizeof our_sec);
-      fs.FileWrite(&file_p, reinterpret_cast<uint8_t*>(&peer_sec.sec), sizeof peer_sec);
-      fs.FileWrite(&file_p, reinterpret_cast<const uint8_t*>(&peer_count), 1);
-      for (int i = 0; i < peer_count; i++) {
-        fs.FileWrite(&file_p, reinterpret_cast<uint8_t*>(&peer_cccd_set[i].cccd), sizeof(struct ble_store_value_cccd));
-      }
-      fs.FileClose(&file_p);
-    }
-    systemTask.PushMessage(Pinetime::System::Messages::EnableSleeping);
+void NimbleController::DisableSleeping() {
+  /* Wakeup Spi and SpiNorFlash before accessing the file system
+   * This should be fixed in the FS driver
+   */
+  systemTask.PushMessage(Pinetime::System::Messages::DisableSleeping);
+
+  // This isn't quite correct
+  // SystemTask could receive EnableSleeping right after passing this check
+  // We need some guarantee that the SystemTask has processed the above message
+  // before we can continue
+  while (!systemTask.IsSleepDisabled()) {
+    vTaskDelay(pdMS_TO_TICKS(5));
   }
 }
 
-void NimbleController::RestoreBond() {
-  lfs_file_t file_p;
-  union ble_store_value sec, cccd;
-  uint8_t peer_count = 0;
-
-  if (fs.FileOpen(&file_p, "/bond.dat", LFS_O_RDONLY) == 0) {
-    memset(&sec, 0, sizeof sec);
-    fs.FileRead(&file_p, reinterpret_cast<uint8_t*>(&sec.sec), sizeof sec);
-    ble_store_write_our_sec(&sec.sec);
-
-    memset(&sec, 0, sizeof sec);
-    fs.FileRead(&file_p, reinterpret_cast<uint8_t*>(&sec.sec), sizeof sec);
-    ble_store_write_peer_sec(&sec.sec);
-
-    fs.FileRead(&file_p, &peer_count, 1);
-    for (int i = 0; i < peer_count; i++) {
-      fs.FileRead(&file_p, reinterpret_cast<uint8_t*>(&cccd.cccd), sizeof(struct ble_store_value_cccd));
-      ble_store_write_cccd(&cccd.cccd);
-    }
-
-    fs.FileClose(&file_p);
-    fs.FileDelete("/bond.dat");
+void NimbleController::PersistGattCache() {
+  if (!gattCache.IsDirty()) {
+    return;
   }
+
+  DisableSleeping();
+  gattCache.Persist();
+  systemTask.PushMessage(Pinetime::System::Messages::EnableSleeping);
 }
@@ -5,23 +5,31 @@
 #define min // workaround: nimble's min/max macros conflict with libstdc++
 #define max
 #include <host/ble_gap.h>
+#include <nimble/nimble_npl.h>
 #undef max
 #undef min
+#include "components/ble/ActivitySyncService.h"
+#include "components/ble/AdvertisingScheduler.h"
 #include "components/ble/AlertNotificationClient.h"
 #include "components/ble/AlertNotificationService.h"
 #include "components/ble/BatteryInformationService.h"
+#include "components/ble/BondStorage.h"
 #include "components/ble/CurrentTimeClient.h"
 #include "components/ble/CurrentTimeService.h"
 #include "components/ble/DeviceInformationService.h"
 #include "components/ble/DfuService.h"
 #include "components/ble/FSService.h"
+#include "components/ble/GattCache.h"
 #include "components/ble/HeartRateService.h"
 #include "components/ble/ImmediateAlertService.h"
 #include "components/ble/MusicService.h"
 #include "components/ble/NavigationService.h"
+#include "components/ble/NotificationScheduler.h"
+#include "components/ble/ServiceChangedClient.h"
 #include "components/ble/ServiceDiscovery.h"
 #include "components/ble/MotionService.h"
 #include "components/ble/SimpleWeatherService.h"
+#include "components/ble/TelemetryService.h"
 #include "components/fs/FS.h"
 
 namespace Pinetime {
@@ -49,6 +57,7 @@ namespace Pinetime {
                        Pinetime::Drivers::SpiNorFlash& spiNorFlash,
                        HeartRateController& heartRateController,
                        MotionController& motionController,
+                       ActivityHistory& activityHistory,
                        FS& fs);
       void Init();
       void StartAdvertising();
@@ -71,19 +80,29 @@ namespace Pinetime {
         return weatherService;
       };
 
+      Pinetime::Controllers::NotificationScheduler& notifications() {
+        return notificationScheduler;
+      };
+
+      Pinetime::Controllers::ActivitySyncService& activitySync() {
+        return activitySyncService;
+      };
+
       uint16_t connHandle();
       void NotifyBatteryLevel(uint8_t level);
 
-      void RestartFastAdv() {
-        fastAdvCount = 0;
-      };
+      // Starts a burst of fast advertising, can be called from another task
+      void RestartFastAdv();
+      void OnRestartAdvertising();
 
       void EnableRadio();
       void DisableRadio();
 
     private:
       void PersistBond(struct ble_gap_conn_desc& desc);
-      void RestoreBond();
+      void PersistGattCache();
+      void DisableSleeping();
+      bool IsServiceChangedIndication(const ble_gap_event* event);
 
       static constexpr const char* deviceName = "InfiniTime";
       Pinetime::System::SystemTask& systemTask;
@@ -106,12 +125,18 @@ namespace Pinetime {
       HeartRateService heartRateService;
       MotionService motionService;
       FSService fsService;
+      TelemetryService telemetryService;
+      ActivitySyncService activitySyncService;
+      BondStorage bondStorage;
+      GattCache gattCache;
+      ServiceChangedClient serviceChangedClient;
       ServiceDiscovery serviceDiscovery;
+      NotificationScheduler notificationScheduler;
 
       uint8_t addrType;
       uint16_t connectionHandle = BLE_HS_CONN_HANDLE_NONE;
-      uint8_t fastAdvCount = 0;
-      uint8_t bondId[16] = {0};
+      AdvertisingScheduler advertisingScheduler;
+      ble_npl_event restartAdvertisingEvent;
     };
 
     static NimbleController* nptr;
@@ -0,0 +1,362 @@
+#include "components/ble/NotificationJournal.h"
+#include "components/fs/FS.h"
+#include <algorithm>
+#include <libraries/log/nrf_log.h>
+#include "utility/Crc16.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  uint16_t ReadU16(const uint8_t* data) {
+    return data[0] | (data[1] << 8);
+  }
+
+  void WriteU16(uint8_t* data, uint16_t value) {
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+  }
+}
+
+NotificationJournal::NotificationJournal(Controllers::FS& fs) : fs {fs} {
+  static_assert(MaxMessageSize + recordOverhead <= std::tuple_size<decltype(cache)>::value, "A record must fit in the cache");
+  static_assert(maxFileSize <= UINT16_MAX, "Offsets are stored in 16 bits");
+}
+
+const char* NotificationJournal::FileName(uint32_t generation) {
+  return (generation % 2 == 0) ? "/.system/notifications0.dat" : "/.system/notifications1.dat";
+}
+
+bool NotificationJournal::IsCurrent(uint16_t generation) const {
+  return this->generation != 0 && static_cast<uint16_t>(this->generation) == generation;
+}
+
+bool NotificationJournal::IsPrevious(uint16_t generation) const {
+  return previousEnd != 0 && static_cast<uint16_t>(this->generation - 1) == generation;
+}
+
+uint16_t NotificationJournal::FileEnd(uint16_t generation) const {
+  if (IsCurrent(generation)) {
+    return appendOffset;
+  }
+  if (IsPrevious(generation)) {
+    return previousEnd;
+  }
+  return 0;
+}
+
+uint32_t NotificationJournal::FullGeneration(uint16_t generation) const {
+  return IsCurrent(generation) ? this->generation : this->generation - 1;
+}
+
+bool NotificationJournal::ReadHeader(uint32_t generation, Header& header) {
+  lfs_file_t file;
+  if (fs.FileOpen(&file, FileName(generation), LFS_O_RDONLY) != LFS_ERR_OK) {
+    return false;
+  }
+  int result = fs.FileRead(&file, reinterpret_cast<uint8_t*>(&header), sizeof(header));
+  fs.FileClose(&file);
+  return result == sizeof(header) && header.magic == magic && header.version == formatVersion;
+}
+
+void NotificationJournal::Init() {
+  Header headers[2];
+  bool valid[2];
+  for (uint32_t i = 0; i < 2; i++) {
+    valid[i] = ReadHeader(i, headers[i]) && headers[i].generation % 2 == i && headers[i].generation != 0;
+  }
+
+  generation = 0;
+  previousEnd = 0;
+  nbNotifications[0] = 0;
+  nbNotifications[1] = 0;
+  cacheSize = 0;
+  if (!valid[0] && !valid[1]) {
+    NRF_LOG_INFO("[NotificationJournal] No journal found");
+    return;
+  }
+
+  const Header& current = (valid[0] && (!valid[1] || headers[0].generation > headers[1].generation)) ? headers[0] : headers[1];
+  const Header& other = (&current == &headers[0]) ? headers[1] : headers[0];
+  generation = current.generation;
+  if (current.previousEnd != 0 && valid[(generation - 1) % 2] && other.generation == generation - 1) {
+    previousEnd = current.previousEnd;
+    previousEnd = Scan(generation - 1, previousEnd, nbNotifications[(generation - 1) % 2]);
+    if (previousEnd <= headerSize) {
+      previousEnd = 0;
+    }
+  }
+  appendOffset = Scan(generation, maxFileSize, nbNotifications[generation % 2]);
+  NRF_LOG_INFO("[NotificationJournal] Generation %lu, %u notifications", generation, NbNotifications());
+}
+
+uint16_t NotificationJournal::Scan(uint32_t generation, uint16_t end, size_t& count) {
+  // Temporarily allow reads up to the specified end
+  uint16_t savedAppendOffset = appendOffset;
+  uint16_t savedPreviousEnd = previousEnd;
+  uint32_t savedGeneration = this->generation;
+  this->generation = generation;
+  appendOffset = end;
+  previousEnd = 0;
+
+  count = 0;
+  Location location {static_cast<uint16_t>(generation), headerSize};
+  while (location.offset < end) {
+    bool dismissed;
+    uint16_t recordSize = CheckRecord(location, false, dismissed);
+    if (recordSize == 0) {
+      break;
+    }
+    if (!dismissed) {
+      count++;
+    }
+    location.offset += recordSize;
+  }
+
+  this->generation = savedGeneration;
+  appendOffset = savedAppendOffset;
+  previousEnd = savedPreviousEnd;
+  cacheSize = 0;
+  return location.offset;
+}
+
+bool NotificationJournal::StartFile(uint32_t newGeneration) {
+  lfs_dir systemDir;
+  if (fs.DirOpen("/.system", &systemDir) != LFS_ERR_OK) {
+    fs.DirCreate("/.system");
+  }
+  fs.DirClose(&systemDir);
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, FileName(newGeneration), LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+    NRF_LOG_WARNING("[NotificationJournal] Failed to create the journal file");
+    return false;
+  }
+  Header header {magic, formatVersion, 0, static_cast<uint16_t>(generation != 0 ? appendOffset : 0), newGeneration};
+  int result = fs.FileWrite(&file, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+  fs.FileClose(&file);
+  if (result != sizeof(header)) {
+    return false;
+  }
+
+  // The file of the generation before the previous one was overwritten
+  nbNotifications[newGeneration % 2] = 0;
+  previousEnd = header.previousEnd;
+  generation = newGeneration;
+  appendOffset = headerSize;
+  return true;
+}
+
+NotificationJournal::Location NotificationJournal::Append(uint8_t category, const char* message, size_t size) {
+  size = std::min(size, MaxMessageSize);
+  const uint16_t recordSize = size + recordOverhead;
+  if (generation == 0 || appendOffset + recordSize > maxFileSize) {
+    if (!StartFile(generation + 1)) {
+      return {};
+    }
+  }
+
+  uint8_t header[3] = {0, category, static_cast<uint8_t>(size)};
+  uint8_t trailer[4];
+  WriteU16(trailer, Utility::Crc16(reinterpret_cast<const uint8_t*>(message), size, Utility::Crc16(header + 1, 2)));
+  WriteU16(trailer + 2, recordSize);
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, FileName(generation), LFS_O_WRONLY) != LFS_ERR_OK) {
+    NRF_LOG_WARNING("[NotificationJournal] Failed to open the journal file");
+    return {};
+  }
+  fs.FileSeek(&file, appendOffset);
+  bool ok = fs.FileWrite(&file, header, sizeof(header)) == sizeof(header) &&
+            fs.FileWrite(&file, reinterpret_cast<const uint8_t*>(message), size) == static_cast<int>(size) &&
+            fs.FileWrite(&file, trailer, sizeof(trailer)) == sizeof(trailer);
+  // The record is committed when the file is closed
+  ok = fs.FileClose(&file) == LFS_ERR_OK && ok;
+  if (!ok) {
+    NRF_LOG_WARNING("[NotificationJournal] Failed to write a notification");
+    return {};
+  }
+
+  Location location {static_cast<uint16_t>(generation), appendOffset};
+  appendOffset += recordSize;
+  nbNotifications[generation % 2]++;
+  return location;
+}
+
+void NotificationJournal::Dismiss(Location location) {
+  bool dismissed;
+  if (CheckRecord(location, false, dismissed) == 0 || dismissed) {
+    return;
+  }
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, FileName(FullGeneration(location.generation)), LFS_O_WRONLY) != LFS_ERR_OK) {
+    return;
+  }
+  fs.FileSeek(&file, location.offset);
+  uint8_t flags = flagDismissed;
+  bool ok = fs.FileWrite(&file, &flags, 1) == 1;
+  // The flag is committed when the file is closed, the notification stays in the journal if it was not
+  ok = fs.FileClose(&file) == LFS_ERR_OK && ok;
+  if (!ok) {
+    NRF_LOG_WARNING("[NotificationJournal] Failed to dismiss a notification");
+    return;
+  }
+
+  if (cacheGeneration == location.generation && location.offset >= cacheOffset && location.offset < cacheOffset + cacheSize) {
+    cache[location.offset - cacheOffset] = flags;
+  }
+  size_t& count = nbNotifications[FullGeneration(location.generation) % 2];
+  if (count > 0) {
+    count--;
+  }
+}
+
+NotificationJournal::Location NotificationJournal::End() const {
+  if (generation == 0) {
+    return {};
+  }
+  return {static_cast<uint16_t>(generation), appendOffset};
+}
+
+NotificationJournal::Location NotificationJournal::Previous(Location location) {
+  while (location.IsValid()) {
+    if (location.offset <= headerSize) {
+      // Continue at the end of the previous file
+      if (IsCurrent(location.generation) && previousEnd != 0) {
+        location = {static_cast<uint16_t>(generation - 1), previousEnd};
+        continue;
+      }
+      return {};
+    }
+    if (location.offset > FileEnd(location.generation)) {
+      return {};
+    }
+
+    const uint8_t* trailer = Fetch(location.generation, location.offset - 2, 2, true);
+    if (trailer == nullptr) {
+      return {};
+    }
+    uint16_t recordSize = ReadU16(trailer);
+    if (recordSize <= recordOverhead || recordSize > location.offset - headerSize) {
+      return {};
+    }
+    location.offset -= recordSize;
+    // Window ending with the record : it also contains the records before it
+    if (Fetch(location.generation, location.offset, recordSize, true) == nullptr) {
+      return {};
+    }
+
+    bool dismissed;
+    if (CheckRecord(location, true, dismissed) != recordSize) {
+      return {};
+    }
+    if (!dismissed) {
+      return location;
+    }
+  }
+  return {};
+}
+
+NotificationJournal::Location NotificationJournal::Next(Location location) {
+  bool dismissed;
+  uint16_t recordSize = CheckRecord(location, false, dismissed);
+  if (recordSize == 0) {
+    return {};
+  }
+  location.offset += recordSize;
+
+  while (true) {
+    if (location.offset >= FileEnd(location.generation)) {
+      // Continue at the beginning of the current file
+      if (IsPrevious(location.generation)) {
+        location = {static_cast<uint16_t>(generation), headerSize};
+        continue;
+      }
+      return {};
+    }
+    recordSize = CheckRecord(location, false, dismissed);
+    if (recordSize == 0) {
+      return {};
+    }
+    if (!dismissed) {
+      return location;
+    }
+    location.offset += recordSize;
+  }
+}
+
+bool NotificationJournal::Read(Location location, uint8_t& category, const char*& message, size_t& size) {
+  bool dismissed;
+  uint16_t recordSize = CheckRecord(location, false, dismissed);
+  if (recordSize == 0) {
+    return false;
+  }
+  // The whole record is in the cache after CheckRecord()
+  const uint8_t* record = Fetch(location.generation, location.offset, recordSize, false);
+  category = record[1];
+  size = record[2];
+  message = reinterpret_cast<const char*>(record + 3);
+  return true;
+}
+
+uint16_t NotificationJournal::CheckRecord(Location location, bool backward, bool& dismissed) {
+  uint16_t end = FileEnd(location.generation);
+  if (!location.IsValid() || location.offset < headerSize || location.offset + recordOverhead > end) {
+    return 0;
+  }
+  const uint8_t* record = Fetch(location.generation, location.offset, 3, backward);
+  if (record == nullptr) {
+    return 0;
+  }
+  uint16_t recordSize = record[2] + recordOverhead;
+  if (location.offset + recordSize > end) {
+    return 0;
+  }
+  record = Fetch(location.generation, location.offset, recordSize, backward);
+  if (record == nullptr) {
+    return 0;
+  }
+  const uint8_t* trailer = record + recordSize - 4;
+  if (ReadU16(trailer + 2) != recordSize || ReadU16(trailer) != Utility::Crc16(record + 1, recordSize - 5)) {
+    return 0;
+  }
+  dismissed = (record[0] & flagDismissed) != 0;
+  return recordSize;
+}
+
+const uint8_t* NotificationJournal::Fetch(uint16_t generation, uint16_t offset, uint16_t size, bool backward) {
+  if (cacheSize != 0 && cacheGeneration == generation && offset >= cacheOffset && offset + size <= cacheOffset + cacheSize) {
+    return cache.data() + (offset - cacheOffset);
+  }
+
+  // Read a whole window of the file, before the requested data when walking backward
+  uint16_t end = FileEnd(generation);
+  uint16_t windowStart = offset;
+  if (backward && offset + size > cache.size()) {
+    windowStart = std::max<int>(headerSize, offset + size - cache.size());
+  }
+  if (windowStart >= end) {
+    return nullptr;
+  }
+  uint16_t windowSize = std::min<uint16_t>(cache.size(), end - windowStart);
+  if (windowStart + windowSize < offset + size) {
+    return nullptr;
+  }
+
+  cacheSize = 0;
+  lfs_file_t file;
+  if (fs.FileOpen(&file, FileName(FullGeneration(generation)), LFS_O_RDONLY) != LFS_ERR_OK) {
+    return nullptr;
+  }
+  fs.FileSeek(&file, windowStart);
+  int result = fs.FileRead(&file, cache.data(), windowSize);
+  fs.FileClose(&file);
+  if (result < offset + size - windowStart) {
+    return nullptr;
+  }
+
+  cacheGeneration = generation;
+  cacheOffset = windowStart;
+  cacheSize = result;
+  return cache.data() + (offset - cacheOffset);
+}
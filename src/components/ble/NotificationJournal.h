@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Controllers {
+    class FS;
+
+    /* Append-only journal of the notifications, stored in the filesystem.
+     *
+     * The journal is split in 2 files used alternately: when the current file is full, the other one is truncated and
+     * becomes the current file. Each file starts with a header containing its generation number, and the end of the
+     * previous file (so that the history can be walked across both files).
+     *
+     * Record : flags (u8, not covered by the CRC), category (u8), size of the message (u8), message,
+     *          CRC16 (u16), size of the record (u16, used to walk the journal backward)
+     *
+     * Notifications are never removed from a file, dismissing a notification sets a flag in its record. A record that
+     * was not completely written (reset during a write) fails the CRC check and marks the end of the file.
+     * Reads go through a small cache filled with one read per window, so that walking the history reads the flash
+     * in batches.
+     */
+    class NotificationJournal {
+    public:
+      struct Location {
+        uint16_t generation = 0; // 0 : invalid location
+        uint16_t offset = 0;
+
+        bool IsValid() const {
+          return generation != 0;
+        }
+
+        bool operator==(const Location& other) const = default;
+      };
+
+      static constexpr size_t MaxMessageSize = 240;
+
+      explicit NotificationJournal(Controllers::FS& fs);
+
+      void Init();
+
+      Location Append(uint8_t category, const char* message, size_t size);
+      void Dismiss(Location location);
+
+      // Location after the newest notification
+      Location End() const;
+      // Newest notification (not dismissed) stored before the specified location, invalid if there is none
+      Location Previous(Location location);
+      // Oldest notification (not dismissed) stored after the one at the specified location, invalid if there is none
+      Location Next(Location location);
+      // Reads the notification at the specified location. The message points to an internal buffer, it is valid until
+      // the next call to the journal.
+      bool Read(Location location, uint8_t& category, const char*& message, size_t& size);
+
+      // Number of notifications (not dismissed) in the journal
+      size_t NbNotifications() const {
+        return nbNotifications[0] + nbNotifications[1];
+      }
+
+    private:
+      static constexpr uint32_t magic = 0x4a4e5449; // "ITNJ"
+      static constexpr uint8_t formatVersion = 1;
+      static constexpr size_t maxFileSize = 4096;
+      static constexpr uint8_t flagDismissed = 0x01;
+      // flags, category, size + message + CRC + record size
+      static constexpr size_t recordOverhead = 3 + 2 + 2;
+
+      struct Header {
+        uint32_t magic;
+        uint8_t version;
+        uint8_t reserved;
+        uint16_t previousEnd;
+        uint32_t generation;
+      };
+
+      static constexpr size_t headerSize = sizeof(Header);
+
+      Controllers::FS& fs;
+      uint32_t generation = 0; // generation of the current file, 0 if there is no journal yet
+      uint16_t appendOffset = 0;
+      uint16_t previousEnd = 0; // end of the file of the previous generation, 0 if it does not exist
+      size_t nbNotifications[2] = {};
+
+      std::array<uint8_t, 256> cache;
+      uint16_t cacheGeneration = 0;
+      uint16_t cacheOffset = 0;
+      uint16_t cacheSize = 0;
+
+      static const char* FileName(uint32_t generation);
+
+      bool IsCurrent(uint16_t generation) const;
+      bool IsPrevious(uint16_t generation) const;
+      uint16_t FileEnd(uint16_t generation) const;
+      uint32_t FullGeneration(uint16_t generation) const;
+
+      bool ReadHeader(uint32_t generation, Header& header);
+      bool StartFile(uint32_t newGeneration);
+      uint16_t Scan(uint32_t generation, uint16_t end, size_t& count);
+
+      // Returns a pointer to 'size' bytes of the file at the specified offset, or nullptr if they cannot be read
+      const uint8_t* Fetch(uint16_t generation, uint16_t offset, uint16_t size, bool backward);
+      // Size of the valid record at the specified location, 0 if the record is invalid
+      uint16_t CheckRecord(Location location, bool backward, bool& dismissed);
+    };
+  }
+}
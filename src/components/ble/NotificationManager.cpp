@@ -1,123 +1,369 @@
 #include "components/ble/NotificationManager.h"
 #include <cstring>
 #include <algorithm>
-#include <cassert>
+#include <nrf_assert.h>
+#include <libraries/log/nrf_log.h>
 
 using namespace Pinetime::Controllers;
 
 constexpr uint8_t NotificationManager::MessageSize;
 
-void NotificationManager::Push(NotificationManager::Notification&& notif) {
-  notif.id = GetNextId();
-  notif.valid = true;
-  newNotification = true;
-  if (beginIdx > 0) {
-    --beginIdx;
-  } else {
-    beginIdx = notifications.size() - 1;
+NotificationManager::NotificationManager(Controllers::FS& fs) : journal {fs} {
+  mutex = xSemaphoreCreateMutex();
+  ASSERT(mutex != nullptr);
+  xSemaphoreGive(mutex);
+}
+
+void NotificationManager::Init() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  journal.Init();
+
+  // Find the newest notifications, and load them from the oldest to the newest one
+  std::array<NotificationJournal::Location, MaxSlots> locations;
+  size_t count = 0;
+  for (auto location = journal.Previous(journal.End()); location.IsValid() && count < locations.size();
+       location = journal.Previous(location)) {
+    locations[count++] = location;
   }
-  notifications[beginIdx] = std::move(notif);
-  if (size < notifications.size()) {
-    size++;
+  while (count-- > 0) {
+    uint8_t category;
+    const char* message;
+    size_t messageSize;
+    if (journal.Read(locations[count], category, message, messageSize)) {
+      Store(static_cast<Categories>(category), messageSize, [message](char* dest, size_t size) {
+        std::memcpy(dest, message, size);
+      });
+      SlotAt(nbSlots - 1).location = locations[count];
+    }
   }
+  newNotification = false;
+  xSemaphoreGive(mutex);
 }
 
-NotificationManager::Notification::Id NotificationManager::GetNextId() {
-  return nextId++;
+void NotificationManager::Persist() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  for (uint8_t i = 0; i < nbPendingDismissals; i++) {
+    journal.Dismiss(pendingDismissals[i]);
+  }
+  nbPendingDismissals = 0;
+
+  for (uint8_t position = 0; position < nbSlots; position++) {
+    Slot& slot = SlotAt(position);
+    if (slot.valid && !slot.location.IsValid()) {
+      slot.location = journal.Append(slot.category, arena.data() + slot.offset, slot.size);
+    }
+  }
+  xSemaphoreGive(mutex);
 }
 
-NotificationManager::Notification NotificationManager::GetLastNotification() const {
-  if (this->IsEmpty()) {
-    return {};
+void NotificationManager::Push(Categories category, const char* message, size_t size) {
+  Push(category, size, [message](char* dest, size_t size) {
+    std::memcpy(dest, message, size);
+  });
+}
+
+size_t NotificationManager::Clamp(size_t size) {
+  return std::clamp<size_t>(size, 1, MessageSize);
+}
+
+char* NotificationManager::Allocate(size_t size) {
+  while (this->size > 0) {
+    if (nbSlots < MaxSlots) {
+      size_t tail = SlotAt(0).offset;
+      if (head > tail) {
+        // The free space is at the end and at the beginning of the arena
+        if (ArenaSize - head >= size) {
+          pendingOffset = head;
+          return arena.data() + pendingOffset;
+        }
+        if (tail >= size) {
+          pendingOffset = 0;
+          return arena.data() + pendingOffset;
+        }
+      } else if (tail - head >= size) {
+        // The records wrap around the end of the arena, the free space is between the newest and the oldest one
+        pendingOffset = head;
+        return arena.data() + pendingOffset;
+      }
+    }
+    EvictOldest();
+  }
+
+  nbSlots = 0;
+  head = 0;
+  pendingOffset = 0;
+  return arena.data();
+}
+
+void NotificationManager::Commit(Categories category, size_t size) {
+  SlotAt(nbSlots) = {static_cast<uint16_t>(pendingOffset), static_cast<uint8_t>(size), static_cast<uint8_t>(category), nextId++, true, {}};
+  nbSlots++;
+  this->size++;
+  head = pendingOffset + size;
+  newNotification = true;
+}
+
+void NotificationManager::EvictOldest() {
+  // The oldest slot is always valid, dismissed ones are removed by TrimDismissed()
+  SlotAt(0).valid = false;
+  --size;
+  TrimDismissed();
+}
+
+void NotificationManager::TrimDismissed() {
+  while (nbSlots > 0 && !SlotAt(0).valid) {
+    firstSlot = (firstSlot + 1) % MaxSlots;
+    nbSlots--;
   }
-  return this->At(0);
 }
 
-const NotificationManager::Notification& NotificationManager::At(NotificationManager::Notification::Idx idx) const {
-  if (idx >= notifications.size()) {
-    assert(false);
-    return notifications.at(beginIdx); // this should not happen
+const NotificationManager::Slot& NotificationManager::SlotAt(uint8_t position) const {
+  return slots[(firstSlot + position) % MaxSlots];
+}
+
+NotificationManager::Slot& NotificationManager::SlotAt(uint8_t position) {
+  return slots[(firstSlot + position) % MaxSlots];
+}
+
+uint8_t NotificationManager::SlotOf(Notification::Id id) const {
+  if (nbSlots == 0) {
+    return MaxSlots;
+  }
+  // Ids are allocated consecutively, and so are the slots
+  uint8_t position = static_cast<Notification::Id>(id - SlotAt(0).id);
+  if (position >= nbSlots || !SlotAt(position).valid) {
+    return MaxSlots;
   }
-  size_t read_idx = (beginIdx + idx) % notifications.size();
-  return notifications.at(read_idx);
+  return position;
+}
+
+NotificationManager::Notification NotificationManager::ToNotification(const Slot& slot) const {
+  Notification notification;
+  notification.category = static_cast<Categories>(slot.category);
+  notification.id = slot.id;
+  notification.valid = true;
+  notification.location = slot.location;
+  return notification;
 }
 
-NotificationManager::Notification& NotificationManager::At(NotificationManager::Notification::Idx idx) {
-  if (idx >= notifications.size()) {
-    assert(false);
-    return notifications.at(beginIdx); // this should not happen
+NotificationManager::Notification NotificationManager::GetLastNotification() const {
+  Notification notification;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  for (uint8_t position = nbSlots; position-- > 0;) {
+    if (SlotAt(position).valid) {
+      notification = ToNotification(SlotAt(position));
+      break;
+    }
   }
-  size_t read_idx = (beginIdx + idx) % notifications.size();
-  return notifications.at(read_idx);
+  xSemaphoreGive(mutex);
+  return notification;
 }
 
-NotificationManager::Notification::Idx NotificationManager::IndexOf(NotificationManager::Notification::Id id) const {
-  for (NotificationManager::Notification::Idx idx = 0; idx < this->size; idx++) {
-    const NotificationManager::Notification& notification = this->At(idx);
-    if (notification.id == id) {
-      return idx;
+NotificationManager::Notification NotificationManager::GetOldestNotification() const {
+  Notification notification;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  for (uint8_t position = 0; position < nbSlots; position++) {
+    if (SlotAt(position).valid) {
+      notification = ToNotification(SlotAt(position));
+      break;
     }
   }
-  return size;
+  xSemaphoreGive(mutex);
+  return notification;
 }
 
 NotificationManager::Notification NotificationManager::Get(NotificationManager::Notification::Id id) const {
-  NotificationManager::Notification::Idx idx = this->IndexOf(id);
-  if (idx == this->size) {
-    return {};
+  Notification notification;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint8_t position = SlotOf(id);
+  if (position != MaxSlots) {
+    notification = ToNotification(SlotAt(position));
   }
-  return this->At(idx);
+  xSemaphoreGive(mutex);
+  return notification;
 }
 
 NotificationManager::Notification NotificationManager::GetNext(NotificationManager::Notification::Id id) const {
-  NotificationManager::Notification::Idx idx = this->IndexOf(id);
-  if (idx == this->size) {
-    return {};
-  }
-  if (idx == 0 || idx > notifications.size()) {
-    return {};
+  Notification notification;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint8_t position = SlotOf(id);
+  if (position != MaxSlots) {
+    for (position++; position < nbSlots; position++) {
+      if (SlotAt(position).valid) {
+        notification = ToNotification(SlotAt(position));
+        break;
+      }
+    }
   }
-  return this->At(idx - 1);
+  xSemaphoreGive(mutex);
+  return notification;
 }
 
 NotificationManager::Notification NotificationManager::GetPrevious(NotificationManager::Notification::Id id) const {
-  NotificationManager::Notification::Idx idx = this->IndexOf(id);
-  if (idx == this->size) {
-    return {};
+  Notification notification;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint8_t position = SlotOf(id);
+  if (position != MaxSlots) {
+    while (position-- > 0) {
+      if (SlotAt(position).valid) {
+        notification = ToNotification(SlotAt(position));
+        break;
+      }
+    }
   }
-  if (static_cast<size_t>(idx + 1) >= notifications.size()) {
-    return {};
+  xSemaphoreGive(mutex);
+  return notification;
+}
+
+NotificationManager::Notification::Idx NotificationManager::IndexOf(NotificationManager::Notification::Id id) const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint8_t position = SlotOf(id);
+  Notification::Idx idx = size;
+  if (position != MaxSlots) {
+    // Index 0 is the newest notification
+    idx = 0;
+    for (position++; position < nbSlots; position++) {
+      if (SlotAt(position).valid) {
+        idx++;
+      }
+    }
   }
-  return this->At(idx + 1);
+  xSemaphoreGive(mutex);
+  return idx;
 }
 
-void NotificationManager::DismissIdx(NotificationManager::Notification::Idx idx) {
-  if (this->IsEmpty()) {
+void NotificationManager::Dismiss(NotificationManager::Notification::Id id) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint8_t position = SlotOf(id);
+  if (position == MaxSlots) {
+    xSemaphoreGive(mutex);
     return;
   }
-  if (idx >= size) {
-    assert(false);
-    return; // this should not happen
-  }
-  if (idx == 0) { // just remove the first element, don't need to change the other elements
-    notifications.at(beginIdx).valid = false;
-    beginIdx = (beginIdx + 1) % notifications.size();
-  } else {
-    // overwrite the specified entry by moving all later messages one index to the front
-    for (size_t i = idx; i < size - 1; ++i) {
-      this->At(i) = this->At(i + 1);
-    }
-    this->At(size - 1).valid = false;
+  Slot& slot = SlotAt(position);
+  if (slot.location.IsValid()) {
+    QueueDismissal(slot.location);
   }
+  slot.valid = false;
   --size;
+  TrimDismissed();
+
+  // Reclaim the space of the dismissed notification if it was the newest one
+  head = 0;
+  for (position = nbSlots; position-- > 0;) {
+    const Slot& newest = SlotAt(position);
+    if (newest.valid) {
+      head = newest.offset + newest.size;
+      break;
+    }
+  }
+  if (head == 0) {
+    nbSlots = 0;
+  }
+  xSemaphoreGive(mutex);
 }
 
-void NotificationManager::Dismiss(NotificationManager::Notification::Id id) {
-  NotificationManager::Notification::Idx idx = this->IndexOf(id);
-  if (idx == this->size) {
+NotificationJournal::Location NotificationManager::FindOldestLocation() const {
+  for (uint8_t position = 0; position < nbSlots; position++) {
+    const Slot& slot = SlotAt(position);
+    if (slot.valid) {
+      // Notifications are persisted in order: if the oldest one is not in the journal, none of them are
+      return slot.location.IsValid() ? slot.location : journal.End();
+    }
+  }
+  return journal.End();
+}
+
+NotificationJournal::Location NotificationManager::OldestLocation() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  auto location = FindOldestLocation();
+  xSemaphoreGive(mutex);
+  return location;
+}
+
+NotificationManager::Notification NotificationManager::FindStored(NotificationJournal::Location location, MessageView* message) {
+  uint8_t category;
+  const char* data;
+  size_t size;
+  // The messages are stored with their null terminator
+  if (IsDismissalPending(location) || !journal.Read(location, category, data, size) || size == 0 || size > MessageSize ||
+      data[size - 1] != '\0') {
+    return {};
+  }
+  if (message != nullptr) {
+    // Points into the cache of the journal, which is reused by the next read
+    *message = {data, static_cast<uint8_t>(size)};
+  }
+  Notification notification;
+  notification.category = static_cast<Categories>(category);
+  notification.valid = true;
+  notification.location = location;
+  return notification;
+}
+
+NotificationManager::Notification NotificationManager::GetStored(NotificationJournal::Location location) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  auto notification = FindStored(location, nullptr);
+  xSemaphoreGive(mutex);
+  return notification;
+}
+
+NotificationManager::Notification NotificationManager::GetPreviousStored(NotificationJournal::Location location) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  auto previous = journal.Previous(location);
+  while (IsDismissalPending(previous)) {
+    previous = journal.Previous(previous);
+  }
+  auto notification = FindStored(previous, nullptr);
+  xSemaphoreGive(mutex);
+  return notification;
+}
+
+NotificationManager::Notification NotificationManager::GetNextStored(NotificationJournal::Location location) {
+  Notification notification;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  auto next = journal.Next(location);
+  while (IsDismissalPending(next)) {
+    next = journal.Next(next);
+  }
+  if (next != FindOldestLocation()) {
+    notification = FindStored(next, nullptr);
+  }
+  xSemaphoreGive(mutex);
+  return notification;
+}
+
+void NotificationManager::DismissStored(NotificationJournal::Location location) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  QueueDismissal(location);
+  xSemaphoreGive(mutex);
+}
+
+void NotificationManager::QueueDismissal(NotificationJournal::Location location) {
+  if (IsDismissalPending(location)) {
+    return;
+  }
+  if (nbPendingDismissals == pendingDismissals.size()) {
+    NRF_LOG_WARNING("[NotificationManager] Too many pending dismissals, the notification will stay in the journal");
     return;
   }
-  this->DismissIdx(idx);
+  pendingDismissals[nbPendingDismissals++] = location;
+}
+
+bool NotificationManager::IsDismissalPending(NotificationJournal::Location location) const {
+  if (!location.IsValid()) {
+    return false;
+  }
+  auto end = pendingDismissals.begin() + nbPendingDismissals;
+  return std::find(pendingDismissals.begin(), end, location) != end;
+}
+
+size_t NotificationManager::NbStoredNotifications() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  size_t stored = journal.NbNotifications();
+  stored -= std::min<size_t>(stored, nbPendingDismissals);
+  size_t count = std::max(stored, size);
+  xSemaphoreGive(mutex);
+  return count;
 }
 
 bool NotificationManager::AreNewNotificationsAvailable() const {
@@ -132,19 +378,26 @@ size_t NotificationManager::NbNotifications() const {
   return size;
 }
 
-const char* NotificationManager::Notification::Message() const {
-  const char* itField = std::find(message.begin(), message.begin() + size - 1, '\0');
-  if (itField != message.begin() + size - 1) {
-    const char* ptr = (itField) + 1;
-    return ptr;
+const char* NotificationManager::MessageView::Message() const {
+  if (size == 0) {
+    return "";
+  }
+  const char* end = data + size - 1;
+  const char* itField = std::find(data, end, '\0');
+  if (itField != end) {
+    return itField + 1;
   }
-  return const_cast<char*>(message.data());
+  return data;
 }
 
-const char* NotificationManager::Notification::Title() const {
-  const char* itField = std::find(message.begin(), message.begin() + size - 1, '\0');
-  if (itField != message.begin() + size - 1) {
-    return message.data();
+const char* NotificationManager::MessageView::Title() const {
+  if (size == 0) {
+    return {};
+  }
+  const char* end = data + size - 1;
+  const char* itField = std::find(data, end, '\0');
+  if (itField != end) {
+    return data;
   }
   return {};
 }
@@ -1,12 +1,33 @@
 #pragma once
 
+#include <FreeRTOS.h>
+#include <semphr.h>
 #include <array>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include "components/ble/NotificationJournal.h"
 
 namespace Pinetime {
   namespace Controllers {
+    class FS;
+
+    /* Notifications are stored as variable-length records in a byte arena used as a ring buffer: a record never wraps,
+     * it is written after the newest one or at the beginning of the arena. The oldest notifications are evicted when
+     * there is not enough space left for a new one.
+     *
+     * Each record is described by a slot. Slots are allocated in the order of the ids (which are consecutive), so the
+     * slot of a given notification is found in constant time from its id. A dismissed notification leaves an empty slot
+     * until all the older ones are gone; its bytes are reclaimed when it is the oldest or the newest one.
+     *
+     * Notifications are also written to a journal in the filesystem (see NotificationJournal) by Persist(). The
+     * newest ones are loaded back in RAM at boot, the older ones can be read from the journal.
+     *
+     * The notifications are pushed by the BLE host task and read by the display task: the arena and the journal are
+     * protected by a mutex. The getters only return the description of a notification, its message is read in place by
+     * a callback called under the lock (Read() and ReadStored()). Only the system task writes to the journal, the
+     * dismissals are queued until the next call to Persist().
+     */
     class NotificationManager {
     public:
       enum class Categories {
@@ -22,24 +43,50 @@ namespace Pinetime {
         HighProriotyAlert,
         InstantMessage
       };
-      static constexpr uint8_t MessageSize {100};
+      // Maximum size of a message (title and body, including the null terminators)
+      static constexpr uint8_t MessageSize {200};
 
+      // Description of a notification, without its message
       struct Notification {
         using Id = uint8_t;
         using Idx = uint8_t;
 
-        std::array<char, MessageSize + 1> message{};
-        uint8_t size;
         Categories category = Categories::Unknown;
         Id id = 0;
         bool valid = false;
+        NotificationJournal::Location location; // invalid if the notification is not in the journal (yet)
+      };
+
+      // Message of a notification, pointing into the arena or into the cache of the journal. It is only valid during the
+      // call to the callback of Read() or ReadStored().
+      struct MessageView {
+        const char* data = nullptr;
+        uint8_t size = 0; // including the null terminator
 
         const char* Message() const;
         const char* Title() const;
       };
 
-      void Push(Notification&& notif);
+      explicit NotificationManager(Controllers::FS& fs);
+
+      // Loads the newest notifications from the journal
+      void Init();
+      // Writes the dismissals and the new notifications to the journal. Called by the system task, with the SPI flash awake.
+      void Persist();
+
+      // The message contains the title and the body separated by a null character
+      void Push(Categories category, const char* message, size_t size);
+
+      // Same as above, but the message is written directly into the arena by write(char* dest, size_t size)
+      template <typename Writer>
+      void Push(Categories category, size_t size, Writer&& write) {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        Store(category, size, write);
+        xSemaphoreGive(mutex);
+      }
+
       Notification GetLastNotification() const;
+      Notification GetOldestNotification() const;
       Notification Get(Notification::Id id) const;
       Notification GetNext(Notification::Id id) const;
       Notification GetPrevious(Notification::Id id) const;
@@ -49,6 +96,20 @@ namespace Pinetime {
       bool AreNewNotificationsAvailable() const;
       void Dismiss(Notification::Id id);
 
+      // Calls read(const MessageView&) with the message of the notification, if it exists, and returns whether it was
+      // called. The lock is held during the call: the callback must not call the NotificationManager.
+      template <typename Reader>
+      bool Read(Notification::Id id, Reader&& read) const {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        uint8_t position = SlotOf(id);
+        if (position != MaxSlots) {
+          const Slot& slot = SlotAt(position);
+          read(MessageView {arena.data() + slot.offset, slot.size});
+        }
+        xSemaphoreGive(mutex);
+        return position != MaxSlots;
+      }
+
       static constexpr size_t MaximumMessageSize() {
         return MessageSize;
       };
@@ -59,19 +120,88 @@ namespace Pinetime {
 
       size_t NbNotifications() const;
 
+      // Notifications older than the ones in RAM are read from the journal, starting before this location
+      NotificationJournal::Location OldestLocation() const;
+      // Notifications read from the journal (their id is not used)
+      Notification GetStored(NotificationJournal::Location location);
+      Notification GetPreviousStored(NotificationJournal::Location location);
+      // Returns an invalid notification if the next one is in RAM
+      Notification GetNextStored(NotificationJournal::Location location);
+      void DismissStored(NotificationJournal::Location location);
+
+      // Same as Read(), for a notification read from the journal
+      template <typename Reader>
+      bool ReadStored(NotificationJournal::Location location, Reader&& read) {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        MessageView message;
+        bool found = FindStored(location, &message).valid;
+        if (found) {
+          read(message);
+        }
+        xSemaphoreGive(mutex);
+        return found;
+      }
+      // Number of notifications in RAM and in the journal
+      size_t NbStoredNotifications() const;
+
     private:
-      Notification::Id nextId {0};
-      Notification::Id GetNextId();
-      const Notification& At(Notification::Idx idx) const;
-      Notification& At(Notification::Idx idx);
-      void DismissIdx(Notification::Idx idx);
+      static constexpr size_t ArenaSize = 512;
+      static constexpr uint8_t MaxSlots = 16;
+      static constexpr uint8_t MaxPendingDismissals = 8;
+      static_assert(ArenaSize >= MessageSize, "The arena must be able to hold the biggest message");
+      static_assert(NotificationJournal::MaxMessageSize >= MessageSize, "The journal must be able to hold the biggest message");
+
+      struct Slot {
+        uint16_t offset;
+        uint8_t size;
+        uint8_t category;
+        Notification::Id id;
+        bool valid;
+        NotificationJournal::Location location;
+      };
 
-      static constexpr uint8_t TotalNbNotifications = 5;
-      std::array<Notification, TotalNbNotifications> notifications;
-      size_t beginIdx = TotalNbNotifications - 1; // index of the newest notification
-      size_t size = 0;                            // number of valid notifications in buffer
+      template <typename Writer>
+      void Store(Categories category, size_t size, Writer&& write) {
+        size = Clamp(size);
+        char* dest = Allocate(size);
+        write(dest, size - 1);
+        dest[size - 1] = '\0';
+        Commit(category, size);
+      }
+
+      static size_t Clamp(size_t size);
+      char* Allocate(size_t size);
+      void Commit(Categories category, size_t size);
+      void EvictOldest();
+      void TrimDismissed();
+
+      // Position in the slot ring of the notification with the specified id, MaxSlots if not found
+      uint8_t SlotOf(Notification::Id id) const;
+      // Position 0 is the oldest slot
+      const Slot& SlotAt(uint8_t position) const;
+      Slot& SlotAt(uint8_t position);
+      Notification ToNotification(const Slot& slot) const;
+      NotificationJournal::Location FindOldestLocation() const;
+      Notification FindStored(NotificationJournal::Location location, MessageView* message);
+      void QueueDismissal(NotificationJournal::Location location);
+      bool IsDismissalPending(NotificationJournal::Location location) const;
 
+      std::array<char, ArenaSize> arena;
+      std::array<Slot, MaxSlots> slots;
+      uint8_t firstSlot = 0; // index of the oldest slot
+      uint8_t nbSlots = 0;   // number of slots in use, including the dismissed ones
+      size_t head = 0;       // end of the newest record in the arena
+      size_t pendingOffset = 0;
+      size_t size = 0; // number of valid notifications
+
+      Notification::Id nextId {0};
       std::atomic<bool> newNotification {false};
+
+      NotificationJournal journal;
+      // Notifications dismissed from the display task, not yet marked in the journal
+      std::array<NotificationJournal::Location, MaxPendingDismissals> pendingDismissals;
+      uint8_t nbPendingDismissals = 0;
+      SemaphoreHandle_t mutex = nullptr;
     };
   }
 }
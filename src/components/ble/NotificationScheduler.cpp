@@ -0,0 +1,163 @@
+#include "components/ble/NotificationScheduler.h"
+#include <cstring>
+#include <nrf_log.h>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_hs.h>
+#include <nimble/nimble_port.h>
+#undef max
+#undef min
+
+using namespace Pinetime::Controllers;
+
+constexpr std::array<uint32_t, NotificationScheduler::nbCharacteristics> NotificationScheduler::minPeriods;
+
+namespace {
+  void FlushCallback(struct ble_npl_event* event) {
+    auto scheduler = static_cast<NotificationScheduler*>(ble_npl_event_get_arg(event));
+    scheduler->OnFlush();
+  }
+}
+
+void NotificationScheduler::Init() {
+  // The callout posts its event in the queue of the host task, so that the notifications are sent from this task
+  ble_npl_callout_init(&flushCallout, nimble_port_get_dflt_eventq(), FlushCallback, this);
+  for (size_t i = 0; i < nbCharacteristics; i++) {
+    minPeriodTicks[i] = ble_npl_time_ms_to_ticks32(minPeriods[i]);
+  }
+  window = ble_npl_time_ms_to_ticks32(defaultWindow);
+}
+
+void NotificationScheduler::UpdateWindow(uint16_t connectionHandle) {
+  ble_gap_conn_desc desc;
+  if (ble_gap_conn_find(connectionHandle, &desc) != 0) {
+    return;
+  }
+  // The connection interval is in units of 1.25ms
+  window = ble_npl_time_ms_to_ticks32((desc.conn_itvl * 5) / 4);
+  NRF_LOG_INFO("[NotificationScheduler] Connection interval : %d", desc.conn_itvl);
+}
+
+void NotificationScheduler::OnConnected(uint16_t connectionHandle) {
+  UpdateWindow(connectionHandle);
+  this->connectionHandle = connectionHandle;
+}
+
+void NotificationScheduler::OnConnectionUpdated(uint16_t connectionHandle) {
+  if (connectionHandle == this->connectionHandle) {
+    UpdateWindow(connectionHandle);
+  }
+}
+
+void NotificationScheduler::OnDisconnected() {
+  connectionHandle = BLE_HS_CONN_HANDLE_NONE;
+  ble_npl_callout_stop(&flushCallout);
+
+  uint32_t ctx = ble_npl_hw_enter_critical();
+  for (auto& entry : entries) {
+    entry.pending = false;
+    entry.sent = false;
+  }
+  flushPlanned = false;
+  ble_npl_hw_exit_critical(ctx);
+}
+
+ble_npl_time_t NotificationScheduler::DueTime(size_t index, ble_npl_time_t now) const {
+  const Entry& entry = entries[index];
+  if (!entry.sent) {
+    return now;
+  }
+  ble_npl_time_t due = entry.lastSent + minPeriodTicks[index];
+  return IsBefore(due, now) ? now : due;
+}
+
+void NotificationScheduler::Notify(Characteristics characteristic, uint16_t attributeHandle, const void* value, size_t size) {
+  if (size > MaxValueSize || connectionHandle == BLE_HS_CONN_HANDLE_NONE) {
+    return;
+  }
+
+  auto index = static_cast<size_t>(characteristic);
+  ble_npl_time_t now = ble_npl_time_get();
+  bool reset = false;
+
+  uint32_t ctx = ble_npl_hw_enter_critical();
+  Entry& entry = entries[index];
+  entry.attributeHandle = attributeHandle;
+  entry.size = static_cast<uint8_t>(size);
+  std::memcpy(entry.value.data(), value, size);
+  entry.pending = true;
+
+  // Values received during the same connection interval are sent together
+  ble_npl_time_t due = DueTime(index, now);
+  if (IsBefore(due, now + window)) {
+    due = now + window;
+  }
+  if (!flushPlanned || IsBefore(due, plannedFlush)) {
+    plannedFlush = due;
+    flushPlanned = true;
+    reset = true;
+  }
+  ble_npl_hw_exit_critical(ctx);
+
+  if (reset) {
+    ble_npl_callout_reset(&flushCallout, due - now);
+  }
+}
+
+void NotificationScheduler::OnFlush() {
+  ble_npl_time_t now = ble_npl_time_get();
+  ble_npl_time_t next = 0;
+  bool reschedule = false;
+
+  uint32_t ctx = ble_npl_hw_enter_critical();
+  // Values received from now on plan their own flush
+  flushPlanned = false;
+  ble_npl_hw_exit_critical(ctx);
+
+  for (size_t i = 0; i < nbCharacteristics; i++) {
+    Entry value;
+    bool send = false;
+
+    ctx = ble_npl_hw_enter_critical();
+    Entry& entry = entries[i];
+    if (entry.pending) {
+      ble_npl_time_t due = DueTime(i, now);
+      if (!IsBefore(now, due)) {
+        value = entry;
+        entry.pending = false;
+        entry.sent = true;
+        entry.lastSent = now;
+        send = true;
+      } else if (!reschedule || IsBefore(due, next)) {
+        next = due;
+        reschedule = true;
+      }
+    }
+    ble_npl_hw_exit_critical(ctx);
+
+    if (send && connectionHandle != BLE_HS_CONN_HANDLE_NONE) {
+      auto* om = ble_hs_mbuf_from_flat(value.value.data(), value.size);
+      if (om != nullptr) {
+        ble_gattc_notify_custom(connectionHandle, value.attributeHandle, om);
+      }
+    }
+  }
+
+  if (!reschedule) {
+    return;
+  }
+
+  // The values that are rate-limited are sent as soon as their period elapses
+  bool reset = false;
+  ctx = ble_npl_hw_enter_critical();
+  if (!flushPlanned || IsBefore(next, plannedFlush)) {
+    plannedFlush = next;
+    flushPlanned = true;
+    reset = true;
+  }
+  ble_npl_hw_exit_critical(ctx);
+
+  if (reset) {
+    ble_npl_callout_reset(&flushCallout, next - now);
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_gap.h>
+#include <nimble/nimble_npl.h>
+#undef max
+#undef min
+
+namespace Pinetime {
+  namespace Controllers {
+    /* Sends the notifications of the characteristics that only carry the latest value of a measurement (heart rate,
+     * step count, battery level,...).
+     *
+     * A new value replaces the pending one of the same characteristic instead of being sent immediately. The values
+     * are sent by the BLE host task at most one connection interval after they are received, so that all the values
+     * updated during an interval are sent together in the next connection event, with a single wake up of the host
+     * task. Each characteristic is also rate-limited: a value is not sent before the minimum period of the
+     * characteristic has elapsed since the previous notification.
+     *
+     * Notify() can be called from any task, the other methods must be called from the BLE host task.
+     */
+    class NotificationScheduler {
+    public:
+      enum class Characteristics : uint8_t { HeartRate, StepCount, MotionValues, BatteryLevel, Count };
+
+      static constexpr size_t MaxValueSize = 6;
+
+      void Init();
+
+      void OnConnected(uint16_t connectionHandle);
+      void OnConnectionUpdated(uint16_t connectionHandle);
+      void OnDisconnected();
+
+      void Notify(Characteristics characteristic, uint16_t attributeHandle, const void* value, size_t size);
+      void OnFlush();
+
+    private:
+      static constexpr size_t nbCharacteristics = static_cast<size_t>(Characteristics::Count);
+      // Minimum period between 2 notifications of each characteristic, in ms
+      static constexpr std::array<uint32_t, nbCharacteristics> minPeriods {1000, 1000, 100, 10000};
+      // Used until the connection interval is known
+      static constexpr uint32_t defaultWindow = 30;
+
+      struct Entry {
+        uint16_t attributeHandle;
+        uint8_t size;
+        bool pending;
+        bool sent; // lastSent is valid
+        ble_npl_time_t lastSent;
+        std::array<uint8_t, MaxValueSize> value;
+      };
+
+      static bool IsBefore(ble_npl_time_t a, ble_npl_time_t b) {
+        return static_cast<int32_t>(a - b) < 0;
+      }
+
+      void UpdateWindow(uint16_t connectionHandle);
+      // Time at which the entry can be sent
+      ble_npl_time_t DueTime(size_t index, ble_npl_time_t now) const;
+
+      std::array<Entry, nbCharacteristics> entries {};
+      std::array<ble_npl_time_t, nbCharacteristics> minPeriodTicks {};
+      uint16_t connectionHandle = BLE_HS_CONN_HANDLE_NONE;
+      ble_npl_time_t window = 0;
+      // Time of the next flush, valid when flushPlanned is set. Both are protected by the critical section
+      ble_npl_time_t plannedFlush = 0;
+      bool flushPlanned = false;
+      ble_npl_callout flushCallout {};
+    };
+  }
+}
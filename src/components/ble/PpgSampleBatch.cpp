@@ -0,0 +1,36 @@
+#include "components/ble/PpgSampleBatch.h"
+
+using namespace Pinetime::Controllers;
+
+void PpgSampleBatch::Start(const SensorConfig& config, uint32_t sequence, bool newMeasurement) {
+  this->config = config;
+  count = 0;
+
+  buffer[0] = newMeasurement ? flagNewMeasurement : 0;
+  buffer[1] = config.samplePeriod;
+  buffer[2] = config.ledDriveCurrent;
+  buffer[3] = config.resolution;
+  buffer[4] = config.gain;
+  buffer[5] = 0;
+  buffer[6] = static_cast<uint8_t>(sequence);
+  buffer[7] = static_cast<uint8_t>(sequence >> 8);
+  buffer[8] = static_cast<uint8_t>(sequence >> 16);
+  buffer[9] = static_cast<uint8_t>(sequence >> 24);
+  size = headerSize;
+}
+
+bool PpgSampleBatch::Append(uint16_t hrs, uint16_t als, size_t sizeLimit) {
+  if (sizeLimit > maxSize) {
+    sizeLimit = maxSize;
+  }
+  if (size < headerSize || count == UINT8_MAX || size + sampleSize > sizeLimit) {
+    return false;
+  }
+
+  buffer[size++] = static_cast<uint8_t>(hrs);
+  buffer[size++] = static_cast<uint8_t>(hrs >> 8);
+  buffer[size++] = static_cast<uint8_t>(als);
+  buffer[size++] = static_cast<uint8_t>(als >> 8);
+  buffer[5] = ++count;
+  return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Pinetime {
+  namespace Controllers {
+    /* Packs raw samples from the heart rate sensor into the payload of a single notification
+     * (see doc/ble.md, "Raw PPG samples").
+     *
+     * Header (10 bytes) : flags (u8), sample period in ms (u8), LED drive register (u8), resolution register (u8),
+     *                     gain register (u8), number of samples (u8), sequence number of the first sample (u32)
+     * Then for each sample : HRS (u16), ALS (u16)
+     */
+    class PpgSampleBatch {
+    public:
+      struct SensorConfig {
+        uint8_t samplePeriod;
+        uint8_t ledDriveCurrent;
+        uint8_t resolution;
+        uint8_t gain;
+
+        bool operator==(const SensorConfig& other) const = default;
+      };
+
+      static constexpr size_t headerSize = 10;
+      static constexpr size_t sampleSize = 4;
+      static constexpr size_t maxSize = 253; // ATT payload for the preferred MTU (256)
+      static constexpr uint8_t flagNewMeasurement = 0x01;
+
+      void Start(const SensorConfig& config, uint32_t sequence, bool newMeasurement);
+
+      // Returns false if the sample does not fit in the batch, in which case the batch must be sent and a new one started.
+      bool Append(uint16_t hrs, uint16_t als, size_t sizeLimit);
+
+      void Clear() {
+        size = 0;
+        count = 0;
+      }
+
+      bool IsEmpty() const {
+        return count == 0;
+      }
+
+      uint8_t Count() const {
+        return count;
+      }
+
+      const SensorConfig& Config() const {
+        return config;
+      }
+
+      const uint8_t* Data() const {
+        return buffer;
+      }
+
+      size_t Size() const {
+        return size;
+      }
+
+    private:
+      uint8_t buffer[maxSize];
+      size_t size = 0;
+      uint8_t count = 0;
+      SensorConfig config {};
+    };
+  }
+}
@@ -0,0 +1,146 @@
+#include "components/ble/ServiceChangedClient.h"
+#include <nrf_log.h>
+
+using namespace Pinetime::Controllers;
+
+constexpr ble_uuid16_t ServiceChangedClient::gattServiceUuid;
+constexpr ble_uuid16_t ServiceChangedClient::serviceChangedUuid;
+constexpr ble_uuid16_t ServiceChangedClient::clientConfigurationUuid;
+
+namespace {
+  int OnDiscoveryEventCallback(uint16_t conn_handle, const struct ble_gatt_error* error, const struct ble_gatt_svc* service, void* arg) {
+    auto client = static_cast<ServiceChangedClient*>(arg);
+    return client->OnDiscoveryEvent(conn_handle, error, service);
+  }
+
+  int OnCharacteristicDiscoveredCallback(uint16_t conn_handle, const struct ble_gatt_error* error, const struct ble_gatt_chr* chr, void* arg) {
+    auto client = static_cast<ServiceChangedClient*>(arg);
+    return client->OnCharacteristicDiscoveryEvent(conn_handle, error, chr);
+  }
+
+  int OnDescriptorDiscoveredCallback(uint16_t conn_handle,
+                                     const struct ble_gatt_error* error,
+                                     uint16_t chr_val_handle,
+                                     const struct ble_gatt_dsc* dsc,
+                                     void* arg) {
+    auto client = static_cast<ServiceChangedClient*>(arg);
+    return client->OnDescriptorDiscoveryEvent(conn_handle, error, chr_val_handle, dsc);
+  }
+
+  int SubscribeCallback(uint16_t conn_handle, const struct ble_gatt_error* error, struct ble_gatt_attr* /*attr*/, void* arg) {
+    auto client = static_cast<ServiceChangedClient*>(arg);
+    return client->OnSubscribe(conn_handle, error);
+  }
+}
+
+bool ServiceChangedClient::OnDiscoveryEvent(uint16_t connectionHandle, const ble_gatt_error* error, const ble_gatt_svc* service) {
+  if (service == nullptr) {
+    if (error->status == BLE_HS_EDONE && isDiscovered) {
+      ble_gattc_disc_all_chrs(connectionHandle, startHandle, endHandle, OnCharacteristicDiscoveredCallback, this);
+    } else {
+      NRF_LOG_INFO("[Service Changed] GATT service not found");
+      isComplete = error->status == BLE_HS_EDONE;
+      onServiceDiscovered(connectionHandle);
+    }
+    return true;
+  }
+
+  if (ble_uuid_cmp(&gattServiceUuid.u, &service->uuid.u) == 0) {
+    startHandle = service->start_handle;
+    endHandle = service->end_handle;
+    isDiscovered = true;
+  }
+  return false;
+}
+
+int ServiceChangedClient::OnCharacteristicDiscoveryEvent(uint16_t connectionHandle,
+                                                         const ble_gatt_error* error,
+                                                         const ble_gatt_chr* characteristic) {
+  if (characteristic == nullptr) {
+    if (error->status == BLE_HS_EDONE && serviceChangedHandle != 0) {
+      ble_gattc_disc_all_dscs(connectionHandle, serviceChangedHandle, descriptorsEndHandle, OnDescriptorDiscoveredCallback, this);
+    } else {
+      NRF_LOG_INFO("[Service Changed] Characteristic not found");
+      isComplete = error->status == BLE_HS_EDONE;
+      onServiceDiscovered(connectionHandle);
+    }
+    return 0;
+  }
+
+  if (ble_uuid_cmp(&serviceChangedUuid.u, &characteristic->uuid.u) == 0) {
+    serviceChangedHandle = characteristic->val_handle;
+    descriptorsEndHandle = endHandle;
+  } else if (serviceChangedHandle != 0 && descriptorsEndHandle == endHandle && characteristic->def_handle > serviceChangedHandle) {
+    // The descriptors of Service Changed end before the next characteristic
+    descriptorsEndHandle = characteristic->def_handle - 1;
+  }
+  return 0;
+}
+
+int ServiceChangedClient::OnDescriptorDiscoveryEvent(uint16_t connectionHandle,
+                                                     const ble_gatt_error* error,
+                                                     uint16_t /*characteristicValueHandle*/,
+                                                     const ble_gatt_dsc* descriptor) {
+  if (error->status == 0) {
+    if (descriptorHandle == 0 && ble_uuid_cmp(&clientConfigurationUuid.u, &descriptor->uuid.u) == 0) {
+      descriptorHandle = descriptor->handle;
+    }
+    return 0;
+  }
+
+  if (descriptorHandle != 0) {
+    // Enable indications
+    uint8_t value[2];
+    value[0] = 2;
+    value[1] = 0;
+    ble_gattc_write_flat(connectionHandle, descriptorHandle, value, sizeof(value), SubscribeCallback, this);
+  } else {
+    NRF_LOG_INFO("[Service Changed] Descriptor not found");
+    onServiceDiscovered(connectionHandle);
+  }
+  return 0;
+}
+
+int ServiceChangedClient::OnSubscribe(uint16_t connectionHandle, const ble_gatt_error* error) {
+  if (error->status == 0) {
+    NRF_LOG_INFO("[Service Changed] Subscribe OK");
+    isComplete = true;
+  } else {
+    NRF_LOG_INFO("[Service Changed] Subscribe ERROR");
+  }
+  onServiceDiscovered(connectionHandle);
+  return 0;
+}
+
+void ServiceChangedClient::Reset() {
+  startHandle = 0;
+  endHandle = 0;
+  serviceChangedHandle = 0;
+  descriptorsEndHandle = 0;
+  descriptorHandle = 0;
+  isDiscovered = false;
+  isComplete = false;
+}
+
+void ServiceChangedClient::Discover(uint16_t connectionHandle, std::function<void(uint16_t)> onServiceDiscovered) {
+  NRF_LOG_INFO("[Service Changed] Starting discovery");
+  this->onServiceDiscovered = onServiceDiscovered;
+  ble_gattc_disc_svc_by_uuid(connectionHandle, &gattServiceUuid.u, OnDiscoveryEventCallback, this);
+}
+
+void ServiceChangedClient::Restore(uint16_t connectionHandle,
+                                   const GattCache::Handles& handles,
+                                   std::function<void(uint16_t)> onServiceDiscovered) {
+  // The subscription of a bonded client is kept by the peer, there is nothing to write
+  serviceChangedHandle = handles.serviceChanged;
+  isComplete = true;
+  onServiceDiscovered(connectionHandle);
+}
+
+bool ServiceChangedClient::Save(GattCache::Handles& handles) const {
+  if (!isComplete) {
+    return false;
+  }
+  handles.serviceChanged = serviceChangedHandle;
+  return true;
+}
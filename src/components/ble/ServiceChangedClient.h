@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_gap.h>
+#undef max
+#undef min
+#include "components/ble/BleClient.h"
+
+namespace Pinetime {
+  namespace Controllers {
+
+    // Subscribes to the Service Changed characteristic of the peer, which indicates that the handles in the GATT cache
+    // are not valid anymore
+    class ServiceChangedClient : public BleClient {
+    public:
+      bool OnDiscoveryEvent(uint16_t connectionHandle, const ble_gatt_error* error, const ble_gatt_svc* service);
+      int OnCharacteristicDiscoveryEvent(uint16_t connectionHandle, const ble_gatt_error* error, const ble_gatt_chr* characteristic);
+      int OnDescriptorDiscoveryEvent(uint16_t connectionHandle,
+                                     const ble_gatt_error* error,
+                                     uint16_t characteristicValueHandle,
+                                     const ble_gatt_dsc* descriptor);
+      int OnSubscribe(uint16_t connectionHandle, const ble_gatt_error* error);
+
+      bool IsServiceChangedHandle(uint16_t attributeHandle) const {
+        return serviceChangedHandle != 0 && attributeHandle == serviceChangedHandle;
+      }
+
+      void Reset() override;
+      void Discover(uint16_t connectionHandle, std::function<void(uint16_t)> lambda) override;
+      void Restore(uint16_t connectionHandle, const GattCache::Handles& handles, std::function<void(uint16_t)> lambda) override;
+      bool Save(GattCache::Handles& handles) const override;
+
+    private:
+      static constexpr uint16_t gattServiceId {0x1801};
+      static constexpr uint16_t serviceChangedId {0x2a05};
+
+      static constexpr ble_uuid16_t gattServiceUuid {.u {.type = BLE_UUID_TYPE_16}, .value = gattServiceId};
+      static constexpr ble_uuid16_t serviceChangedUuid {.u {.type = BLE_UUID_TYPE_16}, .value = serviceChangedId};
+      static constexpr ble_uuid16_t clientConfigurationUuid {.u {.type = BLE_UUID_TYPE_16}, .value = BLE_GATT_DSC_CLT_CFG_UUID16};
+
+      uint16_t startHandle = 0;
+      uint16_t endHandle = 0;
+      uint16_t serviceChangedHandle = 0;
+      uint16_t descriptorsEndHandle = 0; // end of the descriptors of the Service Changed characteristic
+      uint16_t descriptorHandle = 0;
+      bool isDiscovered = false;
+      bool isComplete = false; // subscribed to Service Changed, or it is not provided by the peer
+      std::function<void(uint16_t)> onServiceDiscovered;
+    };
+  }
+}
@@ -4,21 +4,82 @@
 
 using namespace Pinetime::Controllers;
 
-ServiceDiscovery::ServiceDiscovery(std::array<BleClient*, 2>&& clients) : clients {clients} {
+ServiceDiscovery::ServiceDiscovery(std::array<BleClient*, 3>&& clients, GattCache& gattCache) : clients {clients}, gattCache {gattCache} {
 }
 
-void ServiceDiscovery::StartDiscovery(uint16_t connectionHandle) {
-  NRF_LOG_INFO("[Discovery] Starting discovery");
+void ServiceDiscovery::StartDiscovery(uint16_t connectionHandle, const ble_addr_t* peer) {
+  isBonded = peer != nullptr;
+  if (isBonded) {
+    this->peer = *peer;
+  }
+
+  useCachedHandles = false;
+  if (isBonded) {
+    if (auto* entry = gattCache.Find(this->peer)) {
+      cachedHandles = *entry;
+      useCachedHandles = true;
+    }
+  }
+
+  NRF_LOG_INFO("[Discovery] Starting discovery%s", useCachedHandles ? " (cached handles)" : "");
+  state = States::Running;
+  restartPending = false;
   clientIterator = clients.begin();
   DiscoverNextService(connectionHandle);
 }
 
+void ServiceDiscovery::StartFullDiscovery(uint16_t connectionHandle) {
+  for (auto* client : clients) {
+    client->Reset();
+  }
+  useCachedHandles = false;
+  state = States::Running;
+  restartPending = false;
+  clientIterator = clients.begin();
+  DiscoverNextService(connectionHandle);
+}
+
+void ServiceDiscovery::OnServiceChanged(uint16_t connectionHandle) {
+  NRF_LOG_INFO("[Discovery] Services changed");
+  if (isBonded) {
+    gattCache.Remove(peer);
+  }
+
+  switch (state) {
+    case States::Running:
+      // Restart once the current discovery is over, the GATT procedures cannot be interleaved
+      restartPending = true;
+      break;
+    case States::Done:
+      StartFullDiscovery(connectionHandle);
+      break;
+    case States::Idle:
+      // The discovery has not started yet, it will not find the handles in the cache anymore
+      break;
+  }
+}
+
+void ServiceDiscovery::Reset() {
+  for (auto* client : clients) {
+    client->Reset();
+  }
+  useCachedHandles = false;
+  isBonded = false;
+  state = States::Idle;
+  restartPending = false;
+}
+
 void ServiceDiscovery::OnServiceDiscovered(uint16_t connectionHandle) {
   clientIterator++;
   if (clientIterator != clients.end()) {
     DiscoverNextService(connectionHandle);
+  } else if (restartPending) {
+    NRF_LOG_INFO("[Discovery] Services changed during the discovery, restarting");
+    StartFullDiscovery(connectionHandle);
   } else {
     NRF_LOG_INFO("End of service discovery");
+    state = States::Done;
+    UpdateCache();
   }
 }
 
@@ -28,5 +89,24 @@ void ServiceDiscovery::DiscoverNextService(uint16_t connectionHandle) {
   auto discoverNextService = [this](uint16_t connectionHandle) {
     this->OnServiceDiscovered(connectionHandle);
   };
-  (*clientIterator)->Discover(connectionHandle, discoverNextService);
-}
\ No newline at end of file
+  if (useCachedHandles) {
+    (*clientIterator)->Restore(connectionHandle, cachedHandles, discoverNextService);
+  } else {
+    (*clientIterator)->Discover(connectionHandle, discoverNextService);
+  }
+}
+
+void ServiceDiscovery::UpdateCache() {
+  if (!isBonded) {
+    return;
+  }
+
+  GattCache::Handles handles;
+  for (auto* client : clients) {
+    if (!client->Save(handles)) {
+      // Do not cache a partial discovery, it would hide the services that were not found
+      return;
+    }
+  }
+  gattCache.Store(peer, handles);
+}
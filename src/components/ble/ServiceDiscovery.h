@@ -2,6 +2,7 @@
 
 #include <array>
 #include <cstdint>
+#include "components/ble/GattCache.h"
 
 namespace Pinetime {
   namespace Controllers {
@@ -9,15 +10,33 @@ namespace Pinetime {
 
     class ServiceDiscovery {
     public:
-      ServiceDiscovery(std::array<BleClient*, 2>&& bleClients);
+      ServiceDiscovery(std::array<BleClient*, 3>&& bleClients, GattCache& gattCache);
 
-      void StartDiscovery(uint16_t connectionHandle);
+      // peer is the identity address of the bonded peer, nullptr if the connection is not bonded. The handles of a
+      // bonded peer are restored from the GATT cache if possible, and stored in it after a discovery.
+      void StartDiscovery(uint16_t connectionHandle, const ble_addr_t* peer);
+      // The peer indicated that its services changed : the cached handles are removed and the services discovered again
+      void OnServiceChanged(uint16_t connectionHandle);
+      void Reset();
 
     private:
+      enum class States : uint8_t { Idle, Running, Done };
+
       BleClient** clientIterator;
-      std::array<BleClient*, 2> clients;
+      std::array<BleClient*, 3> clients;
+      GattCache& gattCache;
+      // Copy of the cache entry of the peer : the entry can be moved by the cache while the clients use it
+      GattCache::Handles cachedHandles {};
+      bool useCachedHandles = false;
+      ble_addr_t peer;
+      bool isBonded = false;
+      States state = States::Idle;
+      bool restartPending = false;
+
+      void StartFullDiscovery(uint16_t connectionHandle);
       void OnServiceDiscovered(uint16_t connectionHandle);
       void DiscoverNextService(uint16_t connectionHandle);
+      void UpdateCache();
     };
   }
 }
@@ -17,35 +17,35 @@
 */
 
 #include "components/ble/SimpleWeatherService.h"
+#include "components/ble/MbufReader.h"
+#include "systemtask/SystemTask.h"
 
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <climits>
 #include <cstring>
+#include <nrf_assert.h>
 #include <nrf_log.h>
 
 using namespace Pinetime::Controllers;
 
 namespace {
-  enum class MessageType : uint8_t { CurrentWeather, Forecast, Unknown };
+  enum class MessageType : uint8_t { CurrentWeather, Forecast, HourlyForecast, Unknown };
 
-  uint64_t ToUInt64(const uint8_t* data) {
-    return data[0] + (data[1] << 8) + (data[2] << 16) + (data[3] << 24) + (static_cast<uint64_t>(data[4]) << 32) +
-           (static_cast<uint64_t>(data[5]) << 40) + (static_cast<uint64_t>(data[6]) << 48) + (static_cast<uint64_t>(data[7]) << 56);
-  }
-
-  int16_t ToInt16(const uint8_t* data) {
-    return data[0] + (data[1] << 8);
-  }
-
-  SimpleWeatherService::CurrentWeather CreateCurrentWeather(const uint8_t* dataBuffer) {
+  SimpleWeatherService::CurrentWeather CreateCurrentWeather(MbufReader& reader, uint8_t version) {
+    auto timestamp = reader.ReadU64();
+    auto temperature = reader.ReadI16();
+    auto minTemperature = reader.ReadI16();
+    auto maxTemperature = reader.ReadI16();
     SimpleWeatherService::Location cityName;
-    std::memcpy(cityName.data(), &dataBuffer[16], 32);
-    cityName[32] = '\0';
+    reader.ReadString(cityName.data(), cityName.size(), 32);
+    auto iconId = reader.ReadU8();
     int16_t sunrise = -1;
     int16_t sunset = -1;
-    if (dataBuffer[1] > 0) {
-      int16_t bufferSunrise = ToInt16(&dataBuffer[49]);
-      int16_t bufferSunset = ToInt16(&dataBuffer[51]);
+    if (version > 0) {
+      int16_t bufferSunrise = reader.ReadI16();
+      int16_t bufferSunset = reader.ReadI16();
 
       // Sunrise/sunset format
 
@@ -75,86 +75,157 @@ namespace {
         sunset = bufferSunset;
       }
     }
-    return SimpleWeatherService::CurrentWeather(ToUInt64(&dataBuffer[2]),
-                                                SimpleWeatherService::Temperature(ToInt16(&dataBuffer[10])),
-                                                SimpleWeatherService::Temperature(ToInt16(&dataBuffer[12])),
-                                                SimpleWeatherService::Temperature(ToInt16(&dataBuffer[14])),
-                                                SimpleWeatherService::Icons {dataBuffer[16 + 32]},
+    return SimpleWeatherService::CurrentWeather(timestamp,
+                                                SimpleWeatherService::Temperature(temperature),
+                                                SimpleWeatherService::Temperature(minTemperature),
+                                                SimpleWeatherService::Temperature(maxTemperature),
+                                                SimpleWeatherService::Icons {iconId},
                                                 std::move(cityName),
                                                 sunrise,
                                                 sunset);
   }
 
-  SimpleWeatherService::Forecast CreateForecast(const uint8_t* dataBuffer) {
-    auto timestamp = static_cast<uint64_t>(ToUInt64(&dataBuffer[2]));
+  SimpleWeatherService::Forecast CreateForecast(MbufReader& reader) {
+    auto timestamp = reader.ReadU64();
 
     std::array<std::optional<SimpleWeatherService::Forecast::Day>, SimpleWeatherService::MaxNbForecastDays> days;
-    const uint8_t nbDaysInBuffer = dataBuffer[10];
+    const uint8_t nbDaysInBuffer = reader.ReadU8();
     const uint8_t nbDays = std::min(SimpleWeatherService::MaxNbForecastDays, nbDaysInBuffer);
     for (int i = 0; i < nbDays; i++) {
-      days[i] = SimpleWeatherService::Forecast::Day {SimpleWeatherService::Temperature(ToInt16(&dataBuffer[11 + (i * 5)])),
-                                                     SimpleWeatherService::Temperature(ToInt16(&dataBuffer[13 + (i * 5)])),
-                                                     SimpleWeatherService::Icons {dataBuffer[15 + (i * 5)]}};
+      auto minTemperature = reader.ReadI16();
+      auto maxTemperature = reader.ReadI16();
+      auto iconId = reader.ReadU8();
+      days[i] = SimpleWeatherService::Forecast::Day {SimpleWeatherService::Temperature(minTemperature),
+                                                     SimpleWeatherService::Temperature(maxTemperature),
+                                                     SimpleWeatherService::Icons {iconId}};
     }
     return SimpleWeatherService::Forecast {timestamp, nbDays, days};
   }
 
-  MessageType GetMessageType(const uint8_t* data) {
-    auto messageType = static_cast<MessageType>(*data);
+  // The first hour contains the temperature and the icon, the next ones the difference of temperature with the previous
+  // hour (in 0.1°C) and the icon. The forecast is only written if the message is complete.
+  bool ReadHourlyForecast(MbufReader& reader, SimpleWeatherService::HourlyForecast& hourly) {
+    constexpr size_t firstHourSize = 3;
+    constexpr size_t hourSize = 2;
+
+    auto timestamp = reader.ReadU64();
+    const uint8_t nbHoursInBuffer = reader.ReadU8();
+    if (!reader.IsValid() || nbHoursInBuffer == 0 || reader.Remaining() < firstHourSize + (nbHoursInBuffer - 1) * hourSize) {
+      return false;
+    }
+
+    hourly.timestamp = timestamp;
+    hourly.first = 0;
+    hourly.nbHours = std::min(SimpleWeatherService::MaxNbForecastHours, nbHoursInBuffer);
+    int32_t temperature = reader.ReadI16();
+    hourly.hours[0] = {static_cast<int16_t>(temperature), SimpleWeatherService::Icons {reader.ReadU8()}};
+    for (int i = 1; i < hourly.nbHours; i++) {
+      temperature = std::clamp<int32_t>(temperature + static_cast<int8_t>(reader.ReadU8()) * 10, INT16_MIN, INT16_MAX);
+      hourly.hours[i] = {static_cast<int16_t>(temperature), SimpleWeatherService::Icons {reader.ReadU8()}};
+    }
+    return true;
+  }
+
+  MessageType GetMessageType(uint8_t data) {
+    auto messageType = static_cast<MessageType>(data);
     if (messageType > MessageType::Unknown) {
       return MessageType::Unknown;
     }
     return messageType;
   }
-
-  uint8_t GetVersion(const uint8_t* dataBuffer) {
-    return dataBuffer[1];
-  }
 }
 
 int WeatherCallback(uint16_t /*connHandle*/, uint16_t /*attrHandle*/, struct ble_gatt_access_ctxt* ctxt, void* arg) {
   return static_cast<Pinetime::Controllers::SimpleWeatherService*>(arg)->OnCommand(ctxt);
 }
 
-SimpleWeatherService::SimpleWeatherService(DateTime& dateTimeController) : dateTimeController(dateTimeController) {
+SimpleWeatherService::SimpleWeatherService(System::SystemTask& systemTask, DateTime& dateTimeController, Controllers::FS& fs)
+  : systemTask {systemTask}, dateTimeController(dateTimeController), fs {fs} {
+  mutex = xSemaphoreCreateMutex();
+  ASSERT(mutex != nullptr);
+  xSemaphoreGive(mutex);
 }
 
 void SimpleWeatherService::Init() {
   ble_gatts_count_cfg(serviceDefinition);
   ble_gatts_add_svcs(serviceDefinition);
+  LoadFromFile();
 }
 
 int SimpleWeatherService::OnCommand(struct ble_gatt_access_ctxt* ctxt) {
-  const auto* buffer = ctxt->om;
-  const auto* dataBuffer = buffer->om_data;
+  MbufReader reader {ctxt->om};
+  auto messageType = GetMessageType(reader.ReadU8());
+  auto version = reader.ReadU8();
 
-  switch (GetMessageType(dataBuffer)) {
+  switch (messageType) {
     case MessageType::CurrentWeather:
-      if (GetVersion(dataBuffer) <= 1) {
-        currentWeather = CreateCurrentWeather(dataBuffer);
+      if (version <= 1) {
+        auto weather = CreateCurrentWeather(reader, version);
+        if (!reader.IsValid()) {
+          NRF_LOG_INFO("Current weather : message too short");
+          break;
+        }
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (currentWeather == weather) {
+          xSemaphoreGive(mutex);
+          break;
+        }
+        currentWeather = weather;
+        changeCounter++;
+        xSemaphoreGive(mutex);
+        systemTask.PushMessage(System::Messages::OnNewWeather);
         NRF_LOG_INFO("Current weather :\n\tTimestamp : %d\n\tTemperature:%d\n\tMin:%d\n\tMax:%d\n\tIcon:%d\n\tLocation:%s",
-                     currentWeather->timestamp,
-                     currentWeather->temperature.PreciseCelsius(),
-                     currentWeather->minTemperature.PreciseCelsius(),
-                     currentWeather->maxTemperature.PreciseCelsius(),
-                     currentWeather->iconId,
-                     currentWeather->location.data());
-        if (GetVersion(dataBuffer) == 1) {
-          NRF_LOG_INFO("Sunrise: %d\n\tSunset: %d", currentWeather->sunrise, currentWeather->sunset);
+                     weather.timestamp,
+                     weather.temperature.PreciseCelsius(),
+                     weather.minTemperature.PreciseCelsius(),
+                     weather.maxTemperature.PreciseCelsius(),
+                     weather.iconId,
+                     weather.location.data());
+        if (version == 1) {
+          NRF_LOG_INFO("Sunrise: %d\n\tSunset: %d", weather.sunrise, weather.sunset);
         }
       }
       break;
     case MessageType::Forecast:
-      if (GetVersion(dataBuffer) == 0) {
-        forecast = CreateForecast(dataBuffer);
-        NRF_LOG_INFO("Forecast : Timestamp : %d", forecast->timestamp);
-        for (int i = 0; i < 5; i++) {
+      if (version == 0) {
+        auto newForecast = CreateForecast(reader);
+        if (!reader.IsValid()) {
+          NRF_LOG_INFO("Forecast : message too short");
+          break;
+        }
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (forecast == newForecast) {
+          xSemaphoreGive(mutex);
+          break;
+        }
+        forecast = newForecast;
+        changeCounter++;
+        xSemaphoreGive(mutex);
+        systemTask.PushMessage(System::Messages::OnNewWeather);
+        NRF_LOG_INFO("Forecast : Timestamp : %d", newForecast.timestamp);
+        for (int i = 0; i < newForecast.nbDays; i++) {
           NRF_LOG_INFO("\t[%d] Min: %d - Max : %d - Icon : %d",
                        i,
-                       forecast->days[i]->minTemperature.PreciseCelsius(),
-                       forecast->days[i]->maxTemperature.PreciseCelsius(),
-                       forecast->days[i]->iconId);
+                       newForecast.days[i]->minTemperature.PreciseCelsius(),
+                       newForecast.days[i]->maxTemperature.PreciseCelsius(),
+                       newForecast.days[i]->iconId);
+        }
+      }
+      break;
+    case MessageType::HourlyForecast:
+      if (version == 0) {
+        // Parsed aside, the forecast being displayed is only replaced if the message is valid
+        HourlyForecast hourly;
+        if (!ReadHourlyForecast(reader, hourly)) {
+          NRF_LOG_INFO("Hourly forecast : invalid message");
+          break;
         }
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        hourlyForecast = hourly;
+        changeCounter++;
+        xSemaphoreGive(mutex);
+        systemTask.PushMessage(System::Messages::OnNewWeather);
+        NRF_LOG_INFO("Hourly forecast : Timestamp : %d, %d hours", hourly.timestamp, hourly.nbHours);
       }
       break;
     default:
@@ -164,36 +235,178 @@ int SimpleWeatherService::OnCommand(struct ble_gatt_access_ctxt* ctxt) {
   return 0;
 }
 
+uint32_t SimpleWeatherService::ChangeCounter() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  Expire();
+  xSemaphoreGive(mutex);
+  return changeCounter;
+}
+
 std::optional<SimpleWeatherService::CurrentWeather> SimpleWeatherService::Current() const {
-  if (currentWeather) {
-    auto currentTime = dateTimeController.CurrentDateTime().time_since_epoch();
-    auto weatherTpSecond = std::chrono::seconds {currentWeather->timestamp};
-    auto weatherTp = std::chrono::duration_cast<std::chrono::seconds>(weatherTpSecond);
-    auto delta = currentTime - weatherTp;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  auto weather = currentWeather;
+  xSemaphoreGive(mutex);
+  return weather;
+}
+
+std::optional<SimpleWeatherService::Forecast> SimpleWeatherService::GetForecast() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  auto copy = forecast;
+  xSemaphoreGive(mutex);
+  return copy;
+}
 
-    if (delta < std::chrono::hours {24}) {
-      return currentWeather;
+std::optional<SimpleWeatherService::HourlyForecast> SimpleWeatherService::GetHourlyForecast() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  auto copy = hourlyForecast;
+  xSemaphoreGive(mutex);
+  return copy;
+}
+
+void SimpleWeatherService::HourlyForecast::DropHours(uint8_t count) {
+  first = (first + count) % MaxNbForecastHours;
+  nbHours -= count;
+  timestamp += std::chrono::duration_cast<std::chrono::seconds>(std::chrono::hours {count}).count();
+}
+
+void SimpleWeatherService::Expire() {
+  auto currentTime = std::chrono::duration_cast<std::chrono::seconds>(dateTimeController.CurrentDateTime().time_since_epoch());
+
+  if (currentWeather && currentTime - std::chrono::seconds {currentWeather->timestamp} >= std::chrono::hours {24}) {
+    currentWeather.reset();
+    changeCounter++;
+  }
+
+  if (forecast) {
+    // Drop the days that are over, the forecast expires with its last day
+    auto forecastDay = std::chrono::floor<std::chrono::days>(std::chrono::seconds {forecast->timestamp});
+    auto elapsedDays = (std::chrono::floor<std::chrono::days>(currentTime) - forecastDay).count();
+    if (elapsedDays >= forecast->nbDays) {
+      forecast.reset();
+      changeCounter++;
+    } else if (elapsedDays > 0) {
+      std::move(forecast->days.begin() + elapsedDays, forecast->days.end(), forecast->days.begin());
+      std::fill(forecast->days.end() - elapsedDays, forecast->days.end(), std::nullopt);
+      forecast->nbDays -= elapsedDays;
+      forecast->timestamp += std::chrono::duration_cast<std::chrono::seconds>(std::chrono::days {elapsedDays}).count();
+      changeCounter++;
+    }
+  }
+
+  if (hourlyForecast) {
+    auto firstHour = std::chrono::floor<std::chrono::hours>(std::chrono::seconds {hourlyForecast->timestamp});
+    auto elapsedHours = (std::chrono::floor<std::chrono::hours>(currentTime) - firstHour).count();
+    if (elapsedHours >= hourlyForecast->nbHours) {
+      hourlyForecast.reset();
+      changeCounter++;
+    } else if (elapsedHours > 0) {
+      hourlyForecast->DropHours(elapsedHours);
+      changeCounter++;
     }
   }
-  return {};
 }
 
-std::optional<SimpleWeatherService::Forecast> SimpleWeatherService::GetForecast() const {
-  if (forecast) {
-    auto currentTime = dateTimeController.CurrentDateTime().time_since_epoch();
-    auto weatherTpSecond = std::chrono::seconds {forecast->timestamp};
-    auto weatherTp = std::chrono::duration_cast<std::chrono::seconds>(weatherTpSecond);
-    auto delta = currentTime - weatherTp;
+void SimpleWeatherService::LoadFromFile() {
+  lfs_file_t weatherFile;
+  StoredWeather& buffer = storedWeather;
+
+  if (fs.FileOpen(&weatherFile, "/.system/weather.dat", LFS_O_RDONLY) != LFS_ERR_OK) {
+    NRF_LOG_INFO("[SimpleWeatherService] No weather data file");
+    return;
+  }
+
+  int result = fs.FileRead(&weatherFile, reinterpret_cast<uint8_t*>(&buffer), sizeof(buffer));
+  fs.FileClose(&weatherFile);
+  if (result != sizeof(buffer) || buffer.version != weatherFormatVersion) {
+    NRF_LOG_WARNING("[SimpleWeatherService] Invalid weather data file (version %u instead of %u), discarding",
+                    buffer.version,
+                    weatherFormatVersion);
+    return;
+  }
 
-    if (delta < std::chrono::hours {24}) {
-      return this->forecast;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (buffer.hasCurrentWeather) {
+    buffer.location.back() = '\0';
+    currentWeather = CurrentWeather(buffer.timestamp,
+                                    Temperature(buffer.temperature),
+                                    Temperature(buffer.minTemperature),
+                                    Temperature(buffer.maxTemperature),
+                                    buffer.iconId,
+                                    std::move(buffer.location),
+                                    buffer.sunrise,
+                                    buffer.sunset);
+  }
+  if (buffer.hasForecast) {
+    Forecast restoredForecast {buffer.forecastTimestamp, std::min(buffer.nbDays, MaxNbForecastDays), {}};
+    for (int i = 0; i < restoredForecast.nbDays; i++) {
+      restoredForecast.days[i] = Forecast::Day {Temperature(buffer.days[i].minTemperature),
+                                                Temperature(buffer.days[i].maxTemperature),
+                                                buffer.days[i].iconId};
     }
+    forecast = restoredForecast;
+  }
+  if (buffer.hasHourlyForecast && buffer.hourlyForecast.nbHours <= MaxNbForecastHours &&
+      buffer.hourlyForecast.first < MaxNbForecastHours) {
+    hourlyForecast = buffer.hourlyForecast;
   }
-  return {};
+  changeCounter++;
+  xSemaphoreGive(mutex);
+  NRF_LOG_INFO("[SimpleWeatherService] Restored weather data from file");
+}
+
+void SimpleWeatherService::SaveToFile() {
+  StoredWeather& buffer = storedWeather;
+  buffer = {};
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (currentWeather) {
+    buffer.hasCurrentWeather = true;
+    buffer.iconId = currentWeather->iconId;
+    buffer.timestamp = currentWeather->timestamp;
+    buffer.temperature = currentWeather->temperature.PreciseCelsius();
+    buffer.minTemperature = currentWeather->minTemperature.PreciseCelsius();
+    buffer.maxTemperature = currentWeather->maxTemperature.PreciseCelsius();
+    buffer.sunrise = currentWeather->sunrise;
+    buffer.sunset = currentWeather->sunset;
+    buffer.location = currentWeather->location;
+  }
+  if (forecast) {
+    buffer.hasForecast = true;
+    buffer.forecastTimestamp = forecast->timestamp;
+    buffer.nbDays = forecast->nbDays;
+    for (int i = 0; i < forecast->nbDays; i++) {
+      buffer.days[i] = {forecast->days[i]->iconId,
+                        forecast->days[i]->minTemperature.PreciseCelsius(),
+                        forecast->days[i]->maxTemperature.PreciseCelsius()};
+    }
+  }
+
+  if (hourlyForecast) {
+    buffer.hasHourlyForecast = true;
+    buffer.hourlyForecast = *hourlyForecast;
+  }
+  xSemaphoreGive(mutex);
+
+  lfs_dir systemDir;
+  if (fs.DirOpen("/.system", &systemDir) != LFS_ERR_OK) {
+    fs.DirCreate("/.system");
+  }
+  fs.DirClose(&systemDir);
+  lfs_file_t weatherFile;
+  if (fs.FileOpen(&weatherFile, "/.system/weather.dat", LFS_O_WRONLY | LFS_O_CREAT) != LFS_ERR_OK) {
+    NRF_LOG_WARNING("[SimpleWeatherService] Failed to open weather data file for saving");
+    return;
+  }
+  fs.FileWrite(&weatherFile, reinterpret_cast<const uint8_t*>(&buffer), sizeof(buffer));
+  fs.FileClose(&weatherFile);
 }
 
 bool SimpleWeatherService::IsNight() const {
-  if (currentWeather && currentWeather->sunrise != -1 && currentWeather->sunset != -1) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  int16_t sunrise = currentWeather ? currentWeather->sunrise : -1;
+  int16_t sunset = currentWeather ? currentWeather->sunset : -1;
+  xSemaphoreGive(mutex);
+
+  if (sunrise != -1 && sunset != -1) {
     auto currentTime = dateTimeController.CurrentDateTime().time_since_epoch();
 
     // Get timestamp for last midnight
@@ -203,16 +416,16 @@ bool SimpleWeatherService::IsNight() const {
     auto currentMinutes = std::chrono::duration_cast<std::chrono::minutes>(currentTime - midnight).count();
 
     // Sun not rising today => night all hours
-    if (currentWeather->sunrise == -2) {
+    if (sunrise == -2) {
       return true;
     }
     // Sun not setting today => check before sunrise
-    if (currentWeather->sunset == -2) {
-      return currentMinutes < currentWeather->sunrise;
+    if (sunset == -2) {
+      return currentMinutes < sunrise;
     }
 
     // Before sunrise or after sunset
-    return currentMinutes < currentWeather->sunrise || currentMinutes >= currentWeather->sunset;
+    return currentMinutes < sunrise || currentMinutes >= sunset;
   }
 
   return false;
@@ -220,12 +433,12 @@ bool SimpleWeatherService::IsNight() const {
 
 bool SimpleWeatherService::CurrentWeather::operator==(const SimpleWeatherService::CurrentWeather& other) const {
   return this->iconId == other.iconId && this->temperature == other.temperature && this->timestamp == other.timestamp &&
-         this->maxTemperature == other.maxTemperature && this->minTemperature == other.maxTemperature &&
+         this->maxTemperature == other.maxTemperature && this->minTemperature == other.minTemperature &&
          std::strcmp(this->location.data(), other.location.data()) == 0 && this->sunrise == other.sunrise && this->sunset == other.sunset;
 }
 
 bool SimpleWeatherService::Forecast::Day::operator==(const SimpleWeatherService::Forecast::Day& other) const {
-  return this->iconId == other.iconId && this->maxTemperature == other.maxTemperature && this->minTemperature == other.maxTemperature;
+  return this->iconId == other.iconId && this->maxTemperature == other.maxTemperature && this->minTemperature == other.minTemperature;
 }
 
 bool SimpleWeatherService::Forecast::operator==(const SimpleWeatherService::Forecast& other) const {
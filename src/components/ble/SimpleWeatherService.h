@@ -17,9 +17,12 @@
 */
 #pragma once
 
+#include <FreeRTOS.h>
+#include <semphr.h>
 #include <cstdint>
 #include <string>
 #include <array>
+#include <atomic>
 #include <memory>
 
 #define min // workaround: nimble's min/max macros conflict with libstdc++
@@ -32,6 +35,7 @@
 #undef min
 
 #include "components/datetime/DateTimeController.h"
+#include "components/fs/FS.h"
 #include <lvgl/lvgl.h>
 #include "displayapp/InfiniTimeTheme.h"
 #include "utility/Math.h"
@@ -39,17 +43,26 @@
 int WeatherCallback(uint16_t connHandle, uint16_t attrHandle, struct ble_gatt_access_ctxt* ctxt, void* arg);
 
 namespace Pinetime {
+  namespace System {
+    class SystemTask;
+  }
+
   namespace Controllers {
 
     class SimpleWeatherService {
     public:
-      explicit SimpleWeatherService(DateTime& dateTimeController);
+      SimpleWeatherService(System::SystemTask& systemTask, DateTime& dateTimeController, Controllers::FS& fs);
 
+      // Registers the service and restores the last weather data received
       void Init();
 
       int OnCommand(struct ble_gatt_access_ctxt* ctxt);
 
+      // Writes the weather data to the filesystem. Called by the system task (on OnNewWeather), with the SPI flash awake.
+      void SaveToFile();
+
       static constexpr uint8_t MaxNbForecastDays = 5;
+      static constexpr uint8_t MaxNbForecastHours = 48;
 
       enum class Icons : uint8_t {
         Sun = 0,       // ClearSky
@@ -155,8 +168,37 @@ namespace Pinetime {
         bool operator==(const Forecast& other) const;
       };
 
+      // Ring of hourly forecasts: the hours that are over are dropped without moving the others
+      struct HourlyForecast {
+        struct Hour {
+          int16_t temperature;
+          Icons iconId;
+        };
+
+        uint64_t timestamp = 0; // first hour
+        uint8_t nbHours = 0;
+        uint8_t first = 0; // index of the first hour in the ring
+        std::array<Hour, MaxNbForecastHours> hours {};
+
+        [[nodiscard]] Temperature TemperatureAt(uint8_t hour) const {
+          return Temperature(hours[(first + hour) % MaxNbForecastHours].temperature);
+        }
+
+        [[nodiscard]] Icons IconAt(uint8_t hour) const {
+          return hours[(first + hour) % MaxNbForecastHours].iconId;
+        }
+
+        void DropHours(uint8_t count);
+      };
+
+      // Incremented each time the weather data changes : new data received, or data expired. It also removes the
+      // expired data, so it should be called before Current() and GetForecast().
+      uint32_t ChangeCounter();
+
+      // The data is written by the BLE host task and read by the display task : these return a copy taken under the lock
       std::optional<CurrentWeather> Current() const;
       std::optional<Forecast> GetForecast() const;
+      std::optional<HourlyForecast> GetHourlyForecast() const;
 
       [[nodiscard]] bool IsNight() const;
 
@@ -186,12 +228,54 @@ namespace Pinetime {
         {.type = BLE_GATT_SVC_TYPE_PRIMARY, .uuid = &weatherUuid.u, .characteristics = characteristicDefinition},
         {0}};
 
+      static constexpr uint8_t weatherFormatVersion = 2;
+
+      // Content of the weather data file
+      struct StoredWeather {
+        uint8_t version = weatherFormatVersion;
+        bool hasCurrentWeather = false;
+        bool hasForecast = false;
+        Icons iconId = Icons::Unknown;
+        uint64_t timestamp = 0;
+        int16_t temperature = 0;
+        int16_t minTemperature = 0;
+        int16_t maxTemperature = 0;
+        int16_t sunrise = -1;
+        int16_t sunset = -1;
+        Location location {};
+
+        uint64_t forecastTimestamp = 0;
+        uint8_t nbDays = 0;
+
+        struct Day {
+          Icons iconId;
+          int16_t minTemperature;
+          int16_t maxTemperature;
+        };
+
+        std::array<Day, MaxNbForecastDays> days {};
+
+        bool hasHourlyForecast = false;
+        HourlyForecast hourlyForecast {};
+      };
+
+      void Expire();
+      void LoadFromFile();
+
       uint16_t eventHandle {};
 
+      System::SystemTask& systemTask;
       Pinetime::Controllers::DateTime& dateTimeController;
+      Controllers::FS& fs;
 
       std::optional<CurrentWeather> currentWeather;
       std::optional<Forecast> forecast;
+      std::optional<HourlyForecast> hourlyForecast;
+      std::atomic<uint32_t> changeCounter {0};
+      SemaphoreHandle_t mutex = nullptr;
+
+      // Content of the file being loaded or saved, not on the stack of the system task
+      StoredWeather storedWeather;
     };
   }
 }
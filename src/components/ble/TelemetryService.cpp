@@ -0,0 +1,195 @@
+#include "components/ble/TelemetryService.h"
+#include <algorithm>
+#include <cstring>
+#include <nrf_assert.h>
+#include <nrf_log.h>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_hs.h>
+#include <nimble/nimble_port.h>
+#undef max
+#undef min
+#include "components/ble/NimbleController.h"
+#include "systemtask/SystemMonitor.h"
+
+extern int mallocFailedCount;
+extern int stackOverflowCount;
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  // 0007yyxx-78fc-48fe-8e23-433b3a1942d0
+  constexpr ble_uuid128_t CharUuid(uint8_t x, uint8_t y) {
+    return ble_uuid128_t {.u = {.type = BLE_UUID_TYPE_128},
+                          .value = {0xd0, 0x42, 0x19, 0x3a, 0x3b, 0x43, 0x23, 0x8e, 0xfe, 0x48, 0xfc, 0x78, x, y, 0x07, 0x00}};
+  }
+
+  // 00070000-78fc-48fe-8e23-433b3a1942d0
+  constexpr ble_uuid128_t BaseUuid() {
+    return CharUuid(0x00, 0x00);
+  }
+
+  constexpr ble_uuid128_t telemetryServiceUuid {BaseUuid()};
+  constexpr ble_uuid128_t snapshotCharUuid {CharUuid(0x01, 0x00)};
+  constexpr ble_uuid128_t periodCharUuid {CharUuid(0x02, 0x00)};
+
+  int TelemetryServiceCallback(uint16_t /*conn_handle*/, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    auto* telemetryService = static_cast<TelemetryService*>(arg);
+    return telemetryService->OnTelemetryRequested(attr_handle, ctxt);
+  }
+
+  void NotificationTimerCallback(struct ble_npl_event* event) {
+    auto* telemetryService = static_cast<TelemetryService*>(ble_npl_event_get_arg(event));
+    telemetryService->OnNotificationTimer();
+  }
+
+  // All the integers of the snapshot are little-endian
+  uint8_t* Put16(uint8_t* data, uint16_t value) {
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+    return data + 2;
+  }
+
+  uint8_t* Put32(uint8_t* data, uint32_t value) {
+    data = Put16(data, static_cast<uint16_t>(value));
+    return Put16(data, static_cast<uint16_t>(value >> 16));
+  }
+
+  uint16_t Saturate16(int value) {
+    return static_cast<uint16_t>(std::clamp(value, 0, static_cast<int>(UINT16_MAX)));
+  }
+}
+
+TelemetryService::TelemetryService(NimbleController& nimble, System::SystemMonitor& monitor)
+  : nimble {nimble},
+    monitor {monitor},
+    characteristicDefinition {{.uuid = &snapshotCharUuid.u,
+                               .access_cb = TelemetryServiceCallback,
+                               .arg = this,
+                               .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+                               .val_handle = &snapshotHandle},
+                              {.uuid = &periodCharUuid.u,
+                               .access_cb = TelemetryServiceCallback,
+                               .arg = this,
+                               .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+                               .val_handle = &periodHandle},
+                              {0}},
+    serviceDefinition {
+      {.type = BLE_GATT_SVC_TYPE_PRIMARY, .uuid = &telemetryServiceUuid.u, .characteristics = characteristicDefinition},
+      {0},
+    } {
+}
+
+void TelemetryService::Init() {
+  int res = 0;
+  res = ble_gatts_count_cfg(serviceDefinition);
+  ASSERT(res == 0);
+
+  res = ble_gatts_add_svcs(serviceDefinition);
+  ASSERT(res == 0);
+
+  ble_npl_callout_init(&notificationCallout, nimble_port_get_dflt_eventq(), NotificationTimerCallback, this);
+}
+
+size_t TelemetryService::BuildSnapshot() {
+  const auto stats = monitor.GetStats();
+
+  uint8_t* data = snapshotBuffer.data();
+  *data++ = snapshotVersion;
+  data = Put32(data, xTaskGetTickCount() / configTICK_RATE_HZ);
+  data = Put32(data, xPortGetFreeHeapSize());
+  data = Put32(data, xPortGetMinimumEverFreeHeapSize());
+  data = Put16(data, Saturate16(mallocFailedCount));
+  data = Put16(data, Saturate16(stackOverflowCount));
+  data = Put32(data, stats.lvglMemory.totalSize);
+  data = Put32(data, stats.lvglMemory.freeSize);
+  data = Put32(data, stats.lvglMemory.maxUsed);
+  *data++ = stats.lvglMemory.fragmentation;
+  *data++ = monitor.QueueDepth(System::SystemMonitor::Queues::System);
+  *data++ = monitor.QueueDepth(System::SystemMonitor::Queues::Display);
+  data = Put32(data, stats.nbFrames);
+  for (auto frameTime : stats.frameTimes) {
+    data = Put16(data, frameTime);
+  }
+
+  // uxTaskGetSystemState() does not fill the array at all if there are more tasks than it can hold
+  UBaseType_t nbTasks = 0;
+  bool incomplete = uxTaskGetNumberOfTasks() > tasksStatus.size();
+  if (!incomplete) {
+    nbTasks = uxTaskGetSystemState(tasksStatus.data(), tasksStatus.size(), nullptr);
+    // A task was created in the meantime
+    incomplete = (nbTasks == 0);
+  }
+  *data++ = static_cast<uint8_t>(nbTasks) | (incomplete ? incompleteTaskList : 0);
+  for (UBaseType_t i = 0; i < nbTasks; i++) {
+    std::memset(data, 0, taskNameSize);
+    std::memcpy(data, tasksStatus[i].pcTaskName, strnlen(tasksStatus[i].pcTaskName, taskNameSize));
+    data += taskNameSize;
+    // In words of 4 bytes
+    data = Put16(data, tasksStatus[i].usStackHighWaterMark);
+  }
+  return data - snapshotBuffer.data();
+}
+
+int TelemetryService::OnTelemetryRequested(uint16_t attributeHandle, ble_gatt_access_ctxt* context) {
+  if (attributeHandle == snapshotHandle) {
+    size_t size = BuildSnapshot();
+    int res = os_mbuf_append(context->om, snapshotBuffer.data(), size);
+    return (res == 0) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+  }
+  if (attributeHandle == periodHandle) {
+    if (context->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
+      if (OS_MBUF_PKTLEN(context->om) != sizeof(notificationPeriod)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+      }
+      uint8_t period[2];
+      os_mbuf_copydata(context->om, 0, sizeof(period), period);
+      notificationPeriod = period[0] | (period[1] << 8);
+      NRF_LOG_INFO("[Telemetry] Notification period : %d s", notificationPeriod);
+      UpdateTimer();
+      return 0;
+    }
+    uint8_t period[2];
+    Put16(period, notificationPeriod);
+    int res = os_mbuf_append(context->om, period, sizeof(period));
+    return (res == 0) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+  }
+  return 0;
+}
+
+void TelemetryService::UpdateTimer() {
+  if (snapshotNotificationEnabled && notificationPeriod != 0) {
+    ble_npl_callout_reset(&notificationCallout, ble_npl_time_ms_to_ticks32(notificationPeriod * 1000));
+  } else {
+    ble_npl_callout_stop(&notificationCallout);
+  }
+}
+
+void TelemetryService::OnNotificationTimer() {
+  uint16_t connectionHandle = nimble.connHandle();
+  if (connectionHandle == BLE_HS_CONN_HANDLE_NONE || !snapshotNotificationEnabled) {
+    return;
+  }
+
+  // The snapshot is truncated to the MTU, the tasks at the end are dropped first
+  size_t size = BuildSnapshot();
+  auto* om = ble_hs_mbuf_from_flat(snapshotBuffer.data(), size);
+  if (om != nullptr) {
+    ble_gattc_notify_custom(connectionHandle, snapshotHandle, om);
+  }
+  UpdateTimer();
+}
+
+void TelemetryService::SubscribeNotification(uint16_t attributeHandle) {
+  if (attributeHandle == snapshotHandle) {
+    snapshotNotificationEnabled = true;
+    UpdateTimer();
+  }
+}
+
+void TelemetryService::UnsubscribeNotification(uint16_t attributeHandle) {
+  if (attributeHandle == snapshotHandle) {
+    snapshotNotificationEnabled = false;
+    UpdateTimer();
+  }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <FreeRTOS.h>
+#include <task.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_gap.h>
+#include <nimble/nimble_npl.h>
+#undef max
+#undef min
+
+namespace Pinetime {
+  namespace System {
+    class SystemMonitor;
+  }
+
+  namespace Controllers {
+    class NimbleController;
+
+    // Exposes a snapshot of the resource usage of the firmware (heap, stacks, LVGL memory, queues, frame times), which
+    // can be read or notified periodically. The format is described in doc/TelemetryService.md
+    class TelemetryService {
+    public:
+      TelemetryService(NimbleController& nimble, System::SystemMonitor& monitor);
+      void Init();
+
+      int OnTelemetryRequested(uint16_t attributeHandle, ble_gatt_access_ctxt* context);
+      void OnNotificationTimer();
+
+      void SubscribeNotification(uint16_t attributeHandle);
+      void UnsubscribeNotification(uint16_t attributeHandle);
+
+      static constexpr uint8_t snapshotVersion = 2;
+      // About twice the number of tasks of the firmware. If there are more, the list of the tasks is left empty and flagged
+      // as incomplete
+      static constexpr uint8_t maxTasks = 16;
+      static constexpr uint8_t incompleteTaskList = 0x80;
+      static constexpr size_t taskNameSize = 4;
+      static constexpr size_t headerSize = 53;
+      static constexpr size_t maxSnapshotSize = headerSize + maxTasks * (taskNameSize + 2);
+
+    private:
+      // Builds the snapshot in snapshotBuffer
+      size_t BuildSnapshot();
+      void UpdateTimer();
+
+      NimbleController& nimble;
+      System::SystemMonitor& monitor;
+
+      struct ble_gatt_chr_def characteristicDefinition[3];
+      struct ble_gatt_svc_def serviceDefinition[2];
+
+      uint16_t snapshotHandle;
+      uint16_t periodHandle;
+      bool snapshotNotificationEnabled = false;
+      uint16_t notificationPeriod = 0; // in seconds, notifications are disabled if 0
+      ble_npl_callout notificationCallout {};
+
+      // Only used from the BLE host task, kept out of its stack
+      std::array<TaskStatus_t, maxTasks> tasksStatus;
+      std::array<uint8_t, maxSnapshotSize> snapshotBuffer;
+    };
+  }
+}
@@ -0,0 +1,125 @@
+#include "components/datetime/ClockDrift.h"
+#include <algorithm>
+#include <cstdlib>
+#include <libraries/log/nrf_log.h>
+#include "components/fs/FS.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr const char* fileName = "/.system/clockdrift.dat";
+}
+
+ClockDrift::ClockDrift(Controllers::FS& fs) : fs {fs} {
+}
+
+void ClockDrift::Load() {
+  lfs_file_t file;
+  StoredDrift buffer;
+
+  if (fs.FileOpen(&file, fileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    NRF_LOG_INFO("[ClockDrift] No drift file");
+    return;
+  }
+
+  int bytesRead = fs.FileRead(&file, reinterpret_cast<uint8_t*>(&buffer), sizeof(buffer));
+  fs.FileClose(&file);
+  if (bytesRead != static_cast<int>(sizeof(buffer)) || buffer.version != driftFormatVersion || std::abs(buffer.ppb) > maxPpb) {
+    NRF_LOG_WARNING("[ClockDrift] Invalid drift file, discarding");
+    return;
+  }
+
+  ppb = buffer.ppb;
+  priorPpb = buffer.ppb;
+  priorWeight = std::min(buffer.weight, maxWeight);
+  persistedPpb = ppb;
+  NRF_LOG_INFO("[ClockDrift] Loaded drift : %d ppb", ppb);
+}
+
+ClockDrift::Snapshot ClockDrift::TakeSnapshot() const {
+  return {ppb, priorWeight, changeCount};
+}
+
+bool ClockDrift::Write(const Snapshot& snapshot) {
+  lfs_dir systemDir;
+  if (fs.DirOpen("/.system", &systemDir) != LFS_ERR_OK) {
+    fs.DirCreate("/.system");
+  }
+  fs.DirClose(&systemDir);
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, fileName, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+    NRF_LOG_WARNING("[ClockDrift] Failed to open drift file for saving");
+    return false;
+  }
+
+  StoredDrift buffer {driftFormatVersion, snapshot.ppb, snapshot.weight};
+  int bytesWritten = fs.FileWrite(&file, reinterpret_cast<const uint8_t*>(&buffer), sizeof(buffer));
+  fs.FileClose(&file);
+  return bytesWritten == static_cast<int>(sizeof(buffer));
+}
+
+void ClockDrift::OnWritten(const Snapshot& snapshot) {
+  persistedPpb = snapshot.ppb;
+  if (changeCount == snapshot.changeCount) {
+    dirty = false;
+  }
+}
+
+void ClockDrift::Restart() {
+  hasAnchor = false;
+}
+
+void ClockDrift::OnSynchronised(std::chrono::nanoseconds rawTime, std::chrono::nanoseconds referenceTime) {
+  if (!hasAnchor) {
+    anchorRawTime = rawTime;
+    anchorReferenceTime = referenceTime;
+    hasAnchor = true;
+    return;
+  }
+
+  auto referenceSpan = referenceTime - anchorReferenceTime;
+  auto rawSpan = rawTime - anchorRawTime;
+  if (referenceSpan < minSpan) {
+    if (referenceSpan.count() < 0) {
+      // The reference went back in time
+      anchorRawTime = rawTime;
+      anchorReferenceTime = referenceTime;
+    }
+    return;
+  }
+
+  auto difference = rawSpan - referenceSpan;
+  // Checked before computing the ratio, which also prevents overflows
+  if (std::chrono::abs(difference) > referenceSpan / (1000000000 / maxPpb)) {
+    NRF_LOG_WARNING("[ClockDrift] The reference jumped, restarting the measurement");
+    anchorRawTime = rawTime;
+    anchorReferenceTime = referenceTime;
+    return;
+  }
+
+  // (raw - reference) / reference, in ppb
+  int64_t referenceSpanMs = std::chrono::duration_cast<std::chrono::milliseconds>(referenceSpan).count();
+  int64_t measured = difference.count() * 1000 / referenceSpanMs;
+  uint32_t span = static_cast<uint32_t>(referenceSpanMs / 1000);
+  // The error of the measurement is inversely proportional to the span, so short spans get a much smaller weight
+  constexpr int64_t maxSpanSeconds = std::chrono::seconds(maxSpan).count();
+  int64_t weight = std::min<int64_t>(span, maxSpanSeconds) * span / maxSpanSeconds;
+  if (priorWeight + weight == 0) {
+    weight = 1;
+  }
+  ppb = static_cast<int32_t>((static_cast<int64_t>(priorPpb) * priorWeight + measured * weight) / (priorWeight + weight));
+  changeCount++;
+  NRF_LOG_INFO("[ClockDrift] Measured %d ppb over %d s, estimate : %d ppb", static_cast<int32_t>(measured), span, ppb);
+
+  if (referenceSpan >= maxSpan) {
+    priorPpb = ppb;
+    priorWeight = static_cast<uint32_t>(std::min<int64_t>(priorWeight + weight, maxWeight));
+    anchorRawTime = rawTime;
+    anchorReferenceTime = referenceTime;
+    dirty = true;
+  }
+  if (std::abs(ppb - persistedPpb) >= persistThreshold) {
+    dirty = true;
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Controllers {
+    class FS;
+
+    /* Estimates the frequency error of the 32kHz crystal of the RTC from the time synchronisations, so that the time
+     * can be corrected continuously between them.
+     *
+     * The error is measured between an anchor (the first synchronisation) and each following synchronisation at least
+     * minSpan later: the longer the span, the more precise the measurement, since the reference time is only precise
+     * to a few ms. The measurement is averaged with the previous estimate, weighted by the span of each one. After
+     * maxSpan, the estimate becomes the new prior and the anchor is moved, so that the estimate follows slow changes
+     * (ageing, temperature).
+     *
+     * A measurement larger than maxPpb means that the reference jumped (time zone or DST change, wrong time set on
+     * the phone), it is dropped and the anchor is restarted.
+     *
+     * The estimate is not protected against concurrent accesses: the owner takes a snapshot under its lock, writes it
+     * without holding the lock, and then reports it as written under the lock.
+     */
+    class ClockDrift {
+    public:
+      struct Snapshot {
+        int32_t ppb;
+        uint32_t weight;
+        uint32_t changeCount;
+      };
+
+      explicit ClockDrift(Controllers::FS& fs);
+
+      void Load();
+
+      // The estimate changed significantly since it was last written
+      bool IsDirty() const {
+        return dirty;
+      }
+
+      Snapshot TakeSnapshot() const;
+      // Only accesses the filesystem, not the estimate
+      bool Write(const Snapshot& snapshot);
+      // The estimate stays dirty if it changed since the snapshot was taken
+      void OnWritten(const Snapshot& snapshot);
+
+      // Frequency error in parts per billion, positive if the RTC is fast
+      int32_t Ppb() const {
+        return ppb;
+      }
+
+      // rawTime is the time measured by the RTC since boot, without any correction
+      void OnSynchronised(std::chrono::nanoseconds rawTime, std::chrono::nanoseconds referenceTime);
+      // Starts a new measurement, the time was not set from a reference
+      void Restart();
+
+    private:
+      static constexpr uint8_t driftFormatVersion = 1;
+      static constexpr std::chrono::hours minSpan {6};
+      static constexpr std::chrono::hours maxSpan {7 * 24};
+      // Maximum weight of the prior, in seconds
+      static constexpr uint32_t maxWeight = 30 * 24 * 3600;
+      static constexpr int32_t maxPpb = 500000;
+      static constexpr int32_t persistThreshold = 100;
+
+      struct StoredDrift {
+        uint8_t version;
+        int32_t ppb;
+        uint32_t weight;
+      };
+
+      Controllers::FS& fs;
+
+      bool hasAnchor = false;
+      std::chrono::nanoseconds anchorRawTime {0};
+      std::chrono::nanoseconds anchorReferenceTime {0};
+
+      int32_t priorPpb = 0;
+      uint32_t priorWeight = 0;
+      int32_t ppb = 0;
+      int32_t persistedPpb = 0;
+      bool dirty = false;
+      // Incremented each time the estimate changes
+      uint32_t changeCount = 0;
+    };
+  }
+}
@@ -3,6 +3,7 @@
 #include <systemtask/SystemTask.h>
 #include <hal/nrf_rtc.h>
 #include "nrf_assert.h"
+#include <algorithm>
 
 using namespace Pinetime::Controllers;
 
@@ -25,7 +26,8 @@ namespace {
   }
 }
 
-DateTime::DateTime(Controllers::Settings& settingsController) : settingsController {settingsController} {
+DateTime::DateTime(Controllers::Settings& settingsController, Controllers::FS& fs)
+  : clockDrift {fs}, settingsController {settingsController} {
   mutex = xSemaphoreCreateMutex();
   ASSERT(mutex != nullptr);
   xSemaphoreGive(mutex);
@@ -37,6 +39,7 @@ DateTime::DateTime(Controllers::Settings& settingsController) : settingsControll
 void DateTime::SetCurrentTime(std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds> t) {
   xSemaphoreTake(mutex, portMAX_DELAY);
   this->currentDateTime = t;
+  pendingSlew = std::chrono::nanoseconds::zero();
   UpdateTime(previousSystickCounter, true); // Update internal state without updating the time
   xSemaphoreGive(mutex);
 }
@@ -58,6 +61,9 @@ void DateTime::SetTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour,
 
   xSemaphoreTake(mutex, portMAX_DELAY);
   currentDateTime = std::chrono::system_clock::from_time_t(std::mktime(&tm));
+  pendingSlew = std::chrono::nanoseconds::zero();
+  // The time set manually is not precise enough to measure the drift
+  clockDrift.Restart();
   UpdateTime(previousSystickCounter, true);
   xSemaphoreGive(mutex);
 
@@ -66,6 +72,73 @@ void DateTime::SetTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour,
   }
 }
 
+void DateTime::SynchroniseTime(uint16_t year,
+                               uint8_t month,
+                               uint8_t day,
+                               uint8_t hour,
+                               uint8_t minute,
+                               uint8_t second,
+                               uint8_t fractions256) {
+  std::tm tm = {
+    /* .tm_sec  = */ second,
+    /* .tm_min  = */ minute,
+    /* .tm_hour = */ hour,
+    /* .tm_mday = */ day,
+    /* .tm_mon  = */ month - 1,
+    /* .tm_year = */ year - 1900,
+  };
+  tm.tm_isdst = -1; // Use DST value from local time zone
+  auto reference = std::chrono::system_clock::from_time_t(std::mktime(&tm)) + std::chrono::nanoseconds((fractions256 * 1000000000LL) / 256);
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint32_t systickCounter = nrf_rtc_counter_get(portNRF_RTC_REG);
+  UpdateTime(systickCounter, false);
+  // currentDateTime is only updated every second
+  std::chrono::nanoseconds sinceUpdate {(TicksBetween(previousSystickCounter, systickCounter) * 1000000000LL) / configTICK_RATE_HZ};
+  auto error = reference - (currentDateTime + sinceUpdate);
+
+  clockDrift.OnSynchronised(rawTime + sinceUpdate, reference.time_since_epoch());
+
+  bool stepped = std::chrono::abs(error) > maxSlew;
+  if (stepped) {
+    currentDateTime = reference - sinceUpdate;
+    pendingSlew = std::chrono::nanoseconds::zero();
+    UpdateTime(previousSystickCounter, true);
+  } else {
+    pendingSlew = error;
+  }
+  xSemaphoreGive(mutex);
+
+  NRF_LOG_INFO("[DateTime] Synchronised, error : %d ms, drift : %d ppb",
+               static_cast<int32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(error).count()),
+               clockDrift.Ppb());
+
+  if (stepped && systemTask != nullptr) {
+    systemTask->PushMessage(System::Messages::OnNewTime);
+  }
+}
+
+void DateTime::LoadClockDrift() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  clockDrift.Load();
+  xSemaphoreGive(mutex);
+}
+
+void DateTime::PersistClockDrift() {
+  // The file is written without holding the mutex, the clock can be updated meanwhile
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool dirty = clockDrift.IsDirty();
+  auto snapshot = clockDrift.TakeSnapshot();
+  xSemaphoreGive(mutex);
+  if (!dirty || !clockDrift.Write(snapshot)) {
+    return;
+  }
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  clockDrift.OnWritten(snapshot);
+  xSemaphoreGive(mutex);
+}
+
 void DateTime::SetTimeZone(int8_t timezone, int8_t dst) {
   tzOffset = timezone;
   dstOffset = dst;
@@ -78,15 +151,16 @@ std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds> Dat
   return currentDateTime;
 }
 
-void DateTime::UpdateTime(uint32_t systickCounter, bool forceUpdate) {
+uint32_t DateTime::TicksBetween(uint32_t previousSystickCounter, uint32_t systickCounter) {
   // Handle systick counter overflow
-  uint32_t systickDelta = 0;
   if (systickCounter < previousSystickCounter) {
-    systickDelta = static_cast<uint32_t>(portNRF_RTC_MAXTICKS) - previousSystickCounter;
-    systickDelta += systickCounter + 1;
-  } else {
-    systickDelta = systickCounter - previousSystickCounter;
+    return static_cast<uint32_t>(portNRF_RTC_MAXTICKS) - previousSystickCounter + systickCounter + 1;
   }
+  return systickCounter - previousSystickCounter;
+}
+
+void DateTime::UpdateTime(uint32_t systickCounter, bool forceUpdate) {
+  uint32_t systickDelta = TicksBetween(previousSystickCounter, systickCounter);
 
   auto correctedDelta = systickDelta / configTICK_RATE_HZ;
   // If a second hasn't passed, there is nothing to do
@@ -101,8 +175,19 @@ void DateTime::UpdateTime(uint32_t systickCounter, bool forceUpdate) {
     previousSystickCounter = static_cast<uint32_t>(portNRF_RTC_MAXTICKS) - (rest - systickCounter - 1);
   }
 
-  currentDateTime += std::chrono::seconds(correctedDelta);
-  uptime += std::chrono::seconds(correctedDelta);
+  std::chrono::seconds elapsed {correctedDelta};
+  rawTime += elapsed;
+  uptime += elapsed;
+
+  // Compensate the drift of the RTC, and apply a part of the pending correction
+  std::chrono::nanoseconds correction {-static_cast<int64_t>(correctedDelta) * clockDrift.Ppb()};
+  if (pendingSlew != std::chrono::nanoseconds::zero()) {
+    auto maxStep = maxSlewPerSecond * correctedDelta;
+    auto step = std::clamp(pendingSlew, -maxStep, maxStep);
+    pendingSlew -= step;
+    correction += step;
+  }
+  currentDateTime += elapsed + correction;
 
   std::time_t currentTime = std::chrono::system_clock::to_time_t(currentDateTime);
   localTime = *std::localtime(&currentTime);
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <ctime>
 #include <string>
+#include "components/datetime/ClockDrift.h"
 #include "components/settings/Settings.h"
 #include <FreeRTOS.h>
 #include <semphr.h>
@@ -16,7 +17,7 @@ namespace Pinetime {
   namespace Controllers {
     class DateTime {
     public:
-      DateTime(Controllers::Settings& settingsController);
+      DateTime(Controllers::Settings& settingsController, Controllers::FS& fs);
       enum class Days : uint8_t { Unknown, Monday, Tuesday, Wednesday, Thursday, Friday, Saturday, Sunday };
       enum class Months : uint8_t {
         Unknown,
@@ -34,8 +35,23 @@ namespace Pinetime {
         December
       };
 
+      // Steps the clock to the given time, used when the time is set manually
       void SetTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second);
 
+      /*
+       * Synchronises the clock with a reference (the time of the phone received through CTS).
+       *
+       * The successive synchronisations are used to learn the drift of the RTC, which is then compensated
+       * continuously. Small differences (up to maxSlew) are corrected progressively (slewed) instead of stepping the
+       * clock, so that the time never jumps back and the listeners of OnNewTime are not notified.
+       */
+      void SynchroniseTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second, uint8_t fractions256);
+
+      // The filesystem must be initialized
+      void LoadClockDrift();
+      // Writes the drift of the RTC if it changed, the SPI flash must be awake
+      void PersistClockDrift();
+
       /*
        * setter corresponding to the BLE Set Local Time characteristic.
        *
@@ -142,6 +158,12 @@ namespace Pinetime {
 
     private:
       void UpdateTime(uint32_t systickCounter, bool forceUpdate);
+      static uint32_t TicksBetween(uint32_t previousSystickCounter, uint32_t systickCounter);
+
+      // Differences larger than this are corrected by stepping the clock
+      static constexpr std::chrono::seconds maxSlew {2};
+      // Slewing speed : 10ms per second
+      static constexpr std::chrono::nanoseconds maxSlewPerSecond {10000000};
 
       std::tm localTime;
       int8_t tzOffset = 0;
@@ -152,6 +174,11 @@ namespace Pinetime {
       uint32_t previousSystickCounter = 0;
       std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds> currentDateTime;
       std::chrono::seconds uptime {0};
+      // Time measured by the RTC since boot, without correction
+      std::chrono::nanoseconds rawTime {0};
+      // Correction still to be applied to currentDateTime
+      std::chrono::nanoseconds pendingSlew {0};
+      ClockDrift clockDrift;
 
       bool isMidnightAlreadyNotified = false;
       bool isHourAlreadyNotified = true;
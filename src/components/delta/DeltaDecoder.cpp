@@ -0,0 +1,237 @@
+#include "components/delta/DeltaDecoder.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace Pinetime::Tools;
+
+namespace {
+  constexpr uint8_t magic[4] {'I', 'T', 'D', '1'};
+
+  uint32_t ToUInt32(const uint8_t* data) {
+    return data[0] + (data[1] << 8) + (data[2] << 16) + (static_cast<uint32_t>(data[3]) << 24);
+  }
+
+  uint16_t ToUInt16(const uint8_t* data) {
+    return data[0] + (data[1] << 8);
+  }
+
+  int32_t ZigZagDecode(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+  }
+}
+
+DeltaDecoder::DeltaDecoder(Delegate& delegate) : delegate {delegate} {
+}
+
+void DeltaDecoder::Reset() {
+  state = States::Header;
+  header = {};
+  headerIndex = 0;
+  varint = 0;
+  varintShift = 0;
+  sourceOffset = 0;
+  targetOffset = 0;
+  remaining = 0;
+  nbFixes = 0;
+}
+
+DeltaDecoder::Status DeltaDecoder::Feed(const uint8_t* data, size_t size) {
+  size_t index = 0;
+  while (index < size && state != States::Done && state != States::Error) {
+    switch (state) {
+      case States::Header:
+        headerBuffer[headerIndex++] = data[index++];
+        if (headerIndex == headerSize) {
+          if (ParseHeader()) {
+            NextCommand();
+          } else {
+            Fail();
+          }
+        }
+        break;
+
+      case States::Opcode:
+        switch (static_cast<Opcodes>(data[index++])) {
+          case Opcodes::Copy:
+            state = States::CopyOffset;
+            break;
+          case Opcodes::Insert:
+            state = States::InsertLength;
+            break;
+          default:
+            Fail();
+            break;
+        }
+        break;
+
+      case States::CopyOffset:
+        if (ReadVarint(data[index++])) {
+          int64_t offset = static_cast<int64_t>(sourceOffset) + ZigZagDecode(varint);
+          if (offset < 0 || offset > header.sourceSize) {
+            Fail();
+            break;
+          }
+          sourceOffset = static_cast<uint32_t>(offset);
+          state = States::CopyLength;
+        }
+        break;
+
+      case States::CopyLength:
+        if (ReadVarint(data[index++])) {
+          remaining = varint;
+          if (remaining > header.sourceSize - sourceOffset || remaining > header.targetSize - targetOffset) {
+            Fail();
+            break;
+          }
+          state = States::CopyNbFixes;
+        }
+        break;
+
+      case States::CopyNbFixes:
+        if (ReadVarint(data[index++])) {
+          nbFixes = varint;
+          if (nbFixes > remaining) {
+            Fail();
+          } else if (nbFixes == 0) {
+            if (CopySource(remaining)) {
+              NextCommand();
+            }
+          } else {
+            state = States::CopyFixGap;
+          }
+        }
+        break;
+
+      case States::CopyFixGap:
+        if (ReadVarint(data[index++])) {
+          if (varint >= remaining) {
+            Fail();
+          } else if (CopySource(varint)) {
+            state = States::CopyFixDelta;
+          }
+        }
+        break;
+
+      case States::CopyFixDelta: {
+        uint8_t value;
+        delegate.ReadSource(sourceOffset, &value, 1);
+        value += data[index++];
+        if (!WriteTarget(&value, 1)) {
+          break;
+        }
+        sourceOffset++;
+        remaining--;
+        nbFixes--;
+        if (nbFixes > 0) {
+          state = States::CopyFixGap;
+        } else if (CopySource(remaining)) {
+          NextCommand();
+        }
+      } break;
+
+      case States::InsertLength:
+        if (ReadVarint(data[index++])) {
+          remaining = varint;
+          if (remaining > header.targetSize - targetOffset) {
+            Fail();
+          } else if (remaining == 0) {
+            NextCommand();
+          } else {
+            state = States::InsertData;
+          }
+        }
+        break;
+
+      case States::InsertData: {
+        auto chunkSize = std::min(static_cast<size_t>(remaining), size - index);
+        if (!WriteTarget(data + index, chunkSize)) {
+          break;
+        }
+        index += chunkSize;
+        remaining -= chunkSize;
+        if (remaining == 0) {
+          NextCommand();
+        }
+      } break;
+
+      default:
+        break;
+    }
+  }
+
+  // Trailing data after the end of the patch means that it is not the patch we expect
+  if (state == States::Done && index < size) {
+    Fail();
+  }
+
+  switch (state) {
+    case States::Done:
+      return Status::Done;
+    case States::Error:
+      return Status::Error;
+    default:
+      return Status::NeedMoreData;
+  }
+}
+
+bool DeltaDecoder::ParseHeader() {
+  if (std::memcmp(magic, headerBuffer, sizeof(magic)) != 0) {
+    return false;
+  }
+  header.sourceSize = ToUInt32(&headerBuffer[4]);
+  header.sourceCrc = ToUInt16(&headerBuffer[8]);
+  header.targetSize = ToUInt32(&headerBuffer[12]);
+  return delegate.OnHeader(header);
+}
+
+bool DeltaDecoder::ReadVarint(uint8_t byte) {
+  // 5 bytes are enough to encode any 32 bits value
+  if (varintShift > 28) {
+    Fail();
+    return false;
+  }
+  if (varintShift == 0) {
+    varint = 0;
+  }
+  varint |= static_cast<uint32_t>(byte & 0x7f) << varintShift;
+  varintShift += 7;
+  if ((byte & 0x80) != 0) {
+    return false;
+  }
+  varintShift = 0;
+  return true;
+}
+
+bool DeltaDecoder::CopySource(uint32_t size) {
+  while (size > 0) {
+    auto chunkSize = std::min(static_cast<size_t>(size), scratchSize);
+    delegate.ReadSource(sourceOffset, scratch, chunkSize);
+    if (!WriteTarget(scratch, chunkSize)) {
+      return false;
+    }
+    sourceOffset += chunkSize;
+    remaining -= chunkSize;
+    size -= chunkSize;
+  }
+  return true;
+}
+
+bool DeltaDecoder::WriteTarget(const uint8_t* data, size_t size) {
+  if (size > header.targetSize - targetOffset) {
+    Fail();
+    return false;
+  }
+  delegate.WriteTarget(data, size);
+  targetOffset += size;
+  return true;
+}
+
+void DeltaDecoder::NextCommand() {
+  varint = 0;
+  varintShift = 0;
+  state = (targetOffset == header.targetSize) ? States::Done : States::Opcode;
+}
+
+void DeltaDecoder::Fail() {
+  state = States::Error;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Pinetime {
+  namespace Tools {
+    /* Streaming decoder for binary delta patches (see doc/ble.md, "Delta firmware upgrades").
+     *
+     * The patch is fed in arbitrary chunks with Feed(). The decoder keeps only a few bytes of state between calls:
+     * the new image is rebuilt by copying ranges of the source (currently running) image, patching sparse bytes in
+     * those ranges and inserting literal data. Source reads and target writes are delegated to the Delegate.
+     *
+     * Patch layout (all integers little-endian):
+     *   - header : magic "ITD1" (4 bytes), source size (u32), source CRC16 (u16), reserved (u16), target size (u32)
+     *   - then a sequence of commands until target size bytes have been produced:
+     *     - 0x01 Copy   : offset (signed varint), length (varint), number of fixes (varint),
+     *                     then for each fix : gap (varint), delta (u8)
+     *     - 0x02 Insert : length (varint), then length bytes of literal data
+     *
+     * Copy reads from the source at the source cursor + offset and moves the cursor to the end of the copied range.
+     * A fix adds delta (modulo 256) to the source byte located gap bytes after the previous fix (or after the start
+     * of the copy for the first one). Varints are LEB128, signed varints are zigzag encoded.
+     */
+    class DeltaDecoder {
+    public:
+      enum class Status : uint8_t { NeedMoreData, Done, Error };
+
+      struct Header {
+        uint32_t sourceSize;
+        uint16_t sourceCrc;
+        uint32_t targetSize;
+      };
+
+      class Delegate {
+      public:
+        virtual ~Delegate() = default;
+
+        // Called once the header is received. Return false to reject the patch (wrong source image, too big,...)
+        virtual bool OnHeader(const Header& header) = 0;
+        virtual void ReadSource(uint32_t offset, uint8_t* buffer, size_t size) = 0;
+        virtual void WriteTarget(const uint8_t* data, size_t size) = 0;
+      };
+
+      explicit DeltaDecoder(Delegate& delegate);
+
+      void Reset();
+      Status Feed(const uint8_t* data, size_t size);
+
+      uint32_t TargetSize() const {
+        return header.targetSize;
+      }
+
+      uint32_t BytesWritten() const {
+        return targetOffset;
+      }
+
+      static constexpr size_t headerSize = 16;
+
+    private:
+      enum class States : uint8_t {
+        Header,
+        Opcode,
+        CopyOffset,
+        CopyLength,
+        CopyNbFixes,
+        CopyFixGap,
+        CopyFixDelta,
+        InsertLength,
+        InsertData,
+        Done,
+        Error
+      };
+
+      enum class Opcodes : uint8_t { Copy = 0x01, Insert = 0x02 };
+
+      bool ParseHeader();
+      bool ReadVarint(uint8_t byte);
+      bool CopySource(uint32_t size);
+      bool WriteTarget(const uint8_t* data, size_t size);
+      void Fail();
+      void NextCommand();
+
+      Delegate& delegate;
+      States state = States::Header;
+      Header header {};
+      uint8_t headerBuffer[headerSize];
+      size_t headerIndex = 0;
+
+      uint32_t varint = 0;
+      uint8_t varintShift = 0;
+
+      uint32_t sourceOffset = 0;
+      uint32_t targetOffset = 0;
+      uint32_t remaining = 0;
+      uint32_t nbFixes = 0;
+
+      static constexpr size_t scratchSize = 64;
+      uint8_t scratch[scratchSize];
+    };
+  }
+}
@@ -6,12 +6,21 @@ using namespace Pinetime::Controllers;
 
 void HeartRateController::Update(HeartRateController::States newState, uint8_t heartRate) {
   this->state = newState;
+  if (newState == States::Running && heartRate != 0) {
+    nbReadings++;
+  }
   if (this->heartRate != heartRate) {
     this->heartRate = heartRate;
     service->OnNewHeartRateValue(heartRate);
   }
 }
 
+void HeartRateController::UpdatePpgSample(const PpgSampleBatch::SensorConfig& config, uint16_t hrs, uint16_t als, bool newMeasurement) {
+  if (service != nullptr) {
+    service->OnNewPpgSample(config, hrs, als, newMeasurement);
+  }
+}
+
 void HeartRateController::Enable() {
   if (task != nullptr) {
     state = States::NotEnoughData;
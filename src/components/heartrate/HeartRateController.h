@@ -21,6 +21,7 @@ namespace Pinetime {
       void Enable();
       void Disable();
       void Update(States newState, uint8_t heartRate);
+      void UpdatePpgSample(const PpgSampleBatch::SensorConfig& config, uint16_t hrs, uint16_t als, bool newMeasurement);
 
       void SetHeartRateTask(Applications::HeartRateTask* task);
 
@@ -32,12 +33,18 @@ namespace Pinetime {
         return heartRate;
       }
 
+      // Number of heart rate values measured since boot
+      uint32_t NbReadings() const {
+        return nbReadings;
+      }
+
       void SetService(Pinetime::Controllers::HeartRateService* service);
 
     private:
       Applications::HeartRateTask* task = nullptr;
       States state = States::Stopped;
       uint8_t heartRate = 0;
+      uint32_t nbReadings = 0;
       Pinetime::Controllers::HeartRateService* service = nullptr;
     };
   }
@@ -0,0 +1,31 @@
+#include "components/heartrate/MotionArtifactFilter.h"
+#include <algorithm>
+
+using namespace Pinetime::Controllers;
+
+void MotionArtifactFilter::Reset() {
+  history.fill(0.0f);
+  weights.fill(0.0f);
+}
+
+int32_t MotionArtifactFilter::Filter(int32_t sample, const std::array<int32_t, nbAxes>& acceleration) {
+  for (size_t axis = 0; axis < nbAxes; axis++) {
+    float* axisHistory = &history[axis * nbTaps];
+    std::copy_backward(axisHistory, axisHistory + nbTaps - 1, axisHistory + nbTaps);
+    axisHistory[0] = static_cast<float>(acceleration[axis]);
+  }
+
+  float estimate = 0.0f;
+  float power = 0.0f;
+  for (size_t idx = 0; idx < history.size(); idx++) {
+    estimate += weights[idx] * history[idx];
+    power += history[idx] * history[idx];
+  }
+
+  float error = std::clamp(static_cast<float>(sample) - estimate, -maxValue, maxValue);
+  float gain = stepSize * error / (power + regularisation);
+  for (size_t idx = 0; idx < history.size(); idx++) {
+    weights[idx] += gain * history[idx];
+  }
+  return static_cast<int32_t>(error);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Controllers {
+    /* Removes the part of the PPG signal that is correlated with the movements of the arm.
+     *
+     * When the arm swings (walking, running), the pressure of the sensor on the skin changes at the cadence, which adds
+     * components to the PPG signal that can be stronger than the pulse. This normalised LMS adaptive filter estimates
+     * them from the last samples of the acceleration on the 3 axes, and subtracts the estimate. The pulse is not
+     * correlated with the acceleration, so it is kept.
+     *
+     * The PPG and acceleration samples must be filtered by the same band-pass filter, at the same rate. The adaptation is
+     * slowed down when the acceleration is below the noise level of the sensor, so that the weights do not drift while
+     * the arm is still.
+     */
+    class MotionArtifactFilter {
+    public:
+      static constexpr size_t nbAxes = 3;
+
+      void Reset();
+      // Returns the PPG sample without the motion artifacts
+      int32_t Filter(int32_t sample, const std::array<int32_t, nbAxes>& acceleration);
+
+    private:
+      // Number of acceleration samples per axis used for the estimation (400ms at 10Hz)
+      static constexpr size_t nbTaps = 4;
+      // Step size of the NLMS algorithm (between 0 and 2) : larger steps converge faster, but the estimate is noisier
+      static constexpr float stepSize = 0.2f;
+      // Noise level of the filtered acceleration (20mg, in the same fixed-point format as the samples)
+      static constexpr float accelerationNoise = 20.0f * 256.0f;
+      static constexpr float regularisation = nbAxes * nbTaps * accelerationNoise * accelerationNoise;
+      // Range of the band-pass filtered samples
+      static constexpr float maxValue = 1 << 28;
+
+      // Acceleration samples, the newest first for each axis
+      std::array<float, nbAxes * nbTaps> history {};
+      std::array<float, nbAxes * nbTaps> weights {};
+    };
+  }
+}
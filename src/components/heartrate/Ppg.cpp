@@ -1,110 +1,52 @@
 #include "components/heartrate/Ppg.h"
+#include "components/heartrate/PpgSpectrum.h"
 #include <nrf_log.h>
-#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
 
 using namespace Pinetime::Controllers;
 
 namespace {
-  float LinearInterpolation(const float* xValues, const float* yValues, int length, float pointX) {
-    if (pointX > xValues[length - 1]) {
-      return yValues[length - 1];
-    } else if (pointX <= xValues[0]) {
-      return yValues[0];
-    }
-    int index = 0;
-    while (pointX > xValues[index] && index < length - 1) {
-      index++;
-    }
-    float pointX0 = xValues[index - 1];
-    float pointX1 = xValues[index];
-    float pointY0 = yValues[index - 1];
-    float pointY1 = yValues[index];
-    float mu = (pointX - pointX0) / (pointX1 - pointX0);
-
-    return (pointY0 * (1 - mu) + pointY1 * mu);
-  }
-
-  float PeakSearch(float* xVals, float* yVals, float threshold, float& width, float start, float end, int length) {
-    int peaks = 0;
-    bool enabled = false;
-    float minBin = 0.0f;
-    float maxBin = 0.0f;
-    float peakCenter = 0.0f;
-    float prevValue = LinearInterpolation(xVals, yVals, length, start - 0.01f);
-    float currValue = LinearInterpolation(xVals, yVals, length, start);
-    float idx = start;
-    while (idx < end) {
-      float nextValue = LinearInterpolation(xVals, yVals, length, idx + 0.01f);
-      if (currValue < threshold) {
-        enabled = true;
-      }
-      if (currValue >= threshold and enabled) {
-        if (prevValue < threshold) {
-          minBin = idx;
-        } else if (nextValue <= threshold) {
-          maxBin = idx;
-          peaks++;
-          width = maxBin - minBin;
-          peakCenter = width / 2.0f + minBin;
-        }
-      }
-      prevValue = currValue;
-      currValue = nextValue;
-      idx += 0.01f;
-    }
-    if (peaks != 1) {
-      width = 0.0f;
-      peakCenter = 0.0f;
+  uint64_t SpectrumSum(const std::array<uint32_t, Ppg::spectrumLength>& signal, int start, int end) {
+    uint64_t sum = 0;
+    for (int idx = start; idx < end; idx++) {
+      sum += signal.at(idx);
     }
-    return peakCenter;
+    return sum;
   }
 
-  float SpectrumMean(const std::array<float, Ppg::spectrumLength>& signal, int start, int end) {
-    int total = 0;
-    float mean = 0.0f;
-    for (int idx = start; idx < end; idx++) {
-      mean += signal.at(idx);
-      total++;
-    }
-    if (total > 0) {
-      mean /= static_cast<float>(total);
-    }
-    return mean;
+  // max / mean > threshold, without division
+  bool SignalToNoiseAbove(const std::array<uint32_t, Ppg::spectrumLength>& signal, int start, int end, uint32_t max, uint32_t threshold) {
+    uint64_t sum = SpectrumSum(signal, start, end);
+    return static_cast<uint64_t>(max) * static_cast<uint64_t>(end - start) > sum * threshold;
   }
 
-  float SignalToNoise(const std::array<float, Ppg::spectrumLength>& signal, int start, int end, float max) {
-    float mean = SpectrumMean(signal, start, end);
-    return max / mean;
+  // Exponential moving average step : average + alpha * (value - average), alpha in Q15
+  int32_t ExpAverage(int32_t average, int32_t value, int32_t alpha) {
+    return average + static_cast<int32_t>((static_cast<int64_t>(value - average) * alpha + (1 << 14)) >> 15);
   }
 
-  // Simple bandpass filter using exponential moving average
-  void Filter30to240(std::array<float, Ppg::dataLength>& signal) {
+  // Simple bandpass filter using exponential moving average, applied to each new sample.
+  // averages holds the state of the low-pass stages, then of the high-pass stages.
+  int32_t Filter30to240(int32_t value, std::array<int32_t, 8>& averages, int32_t lowPassAlpha, int32_t highPassAlpha) {
     // From:
     // https://www.norwegiancreations.com/2016/03/arduino-tutorial-simple-high-pass-band-pass-and-band-stop-filtering/
 
-    int length = signal.size();
-    // 0.268 is ~0.5Hz and 0.816 is ~4Hz cutoff at 10Hz sampling
-    float expAlpha = 0.816f;
-    float expAvg = 0.0f;
-    for (int loop = 0; loop < 4; loop++) {
-      expAvg = signal.front();
-      for (int idx = 0; idx < length; idx++) {
-        expAvg = (expAlpha * signal.at(idx)) + ((1 - expAlpha) * expAvg);
-        signal[idx] = expAvg;
-      }
+    for (int stage = 0; stage < 4; stage++) {
+      averages[stage] = ExpAverage(averages[stage], value, lowPassAlpha);
+      value = averages[stage];
     }
-    expAlpha = 0.268f;
-    for (int loop = 0; loop < 4; loop++) {
-      expAvg = signal.front();
-      for (int idx = 0; idx < length; idx++) {
-        expAvg = (expAlpha * signal.at(idx)) + ((1 - expAlpha) * expAvg);
-        signal[idx] -= expAvg;
-      }
+    for (int stage = 4; stage < 8; stage++) {
+      averages[stage] = ExpAverage(averages[stage], value, highPassAlpha);
+      value -= averages[stage];
     }
+    return value;
   }
 
-  float SpectrumMax(const std::array<float, Ppg::spectrumLength>& data, int start, int end) {
-    float max = 0.0f;
+  uint32_t SpectrumMax(const std::array<uint32_t, Ppg::spectrumLength>& data, int start, int end) {
+    uint32_t max = 0;
     for (int idx = start; idx < end; idx++) {
       if (data.at(idx) > max) {
         max = data.at(idx);
@@ -113,38 +55,115 @@ namespace {
     return max;
   }
 
-  void Detrend(std::array<float, Ppg::dataLength>& signal) {
-    int size = signal.size();
-    float offset = signal.front();
-    float slope = (signal.at(size - 1) - offset) / static_cast<float>(size - 1);
+  struct FilterCoefficients {
+    uint8_t samplePeriod;
+    int32_t lowPassAlpha;
+    int32_t highPassAlpha;
+  };
 
-    for (int idx = 0; idx < size; idx++) {
-      signal[idx] -= (slope * static_cast<float>(idx) + offset);
-    }
-    for (int idx = 0; idx < size - 1; idx++) {
-      signal[idx] = signal[idx + 1] - signal[idx];
-    }
-  }
+  // alpha of each stage in Q15, solved numerically so that the 4 low-pass stages are 3dB down at 4Hz (the Nyquist
+  // frequency at 8Hz), and the 4 high-pass stages at 0.5Hz : the band of the heart rate region is kept whatever the period
+  constexpr FilterCoefficients filterCoefficients[] {
+    {Ppg::defaultSamplePeriod, 31213, 2861},
+    {Ppg::longSamplePeriod, 31349, 3244},
+  };
 
-  // Hanning Coefficients from numpy: python -c 'import numpy;print(numpy.hanning(64))'
+  // Hanning Coefficients (Q15) from numpy: python -c 'import numpy;print(numpy.round(numpy.hanning(64) * 32768))'
   // Note: Harcoded and must be updated if constexpr dataLength is changed. Prevents the need to
   // use cosf() which results in an extra ~5KB in storage.
-  // This data is symetrical so just using the first half (saves 128B when dataLength is 64).
-  static constexpr float hanning[Ppg::dataLength >> 1] {
-    0.0f,        0.00248461f, 0.00991376f, 0.0222136f,  0.03926189f, 0.06088921f, 0.08688061f, 0.11697778f,
-    0.15088159f, 0.1882551f,  0.22872687f, 0.27189467f, 0.31732949f, 0.36457977f, 0.41317591f, 0.46263495f,
-    0.51246535f, 0.56217185f, 0.61126047f, 0.65924333f, 0.70564355f, 0.75f,       0.79187184f, 0.83084292f,
-    0.86652594f, 0.89856625f, 0.92664544f, 0.95048443f, 0.96984631f, 0.98453864f, 0.99441541f, 0.99937846f};
+  // This data is symetrical so just using the first half (saves 64B when dataLength is 64).
+  constexpr int16_t hanning[Ppg::dataLength >> 1] {0,     81,    325,   728,   1287,  1995,  2847,  3833,  4944,  6169,  7495,
+                                                    8909,  10398, 11947, 13539, 15160, 16792, 18421, 20030, 21602, 23123, 24576,
+                                                    25948, 27225, 28394, 29444, 30364, 31145, 31780, 32261, 32585, 32748};
+  static_assert(Ppg::dataLength == 64, "The hanning table must be updated");
+
+  // Copies the samples of the ring buffer, from the oldest one at index first, and applies the window
+  void ApplyWindow(const std::array<int32_t, Ppg::dataLength>& samples, size_t first, std::array<int32_t, Ppg::dataLength>& signal) {
+    int half = Ppg::dataLength >> 1;
+    for (int idx = 0; idx < Ppg::dataLength; idx++) {
+      int32_t coefficient = hanning[idx < half ? idx : Ppg::dataLength - 1 - idx];
+      int32_t sample = samples[(first + idx) % Ppg::dataLength];
+      signal[idx] = static_cast<int32_t>((static_cast<int64_t>(sample) * coefficient + (1 << 14)) >> 15);
+    }
+  }
+
+  // Scales the samples down until they are below maxValue, so that the FFT cannot overflow.
+  // Returns the number of bits the samples were shifted by.
+  int NormaliseBlock(std::array<int32_t, Ppg::dataLength>& signal) {
+    // The 64 points FFT multiplies the amplitude by 64 at most : 2^23 * 64 * sqrt(2) fits in an int32_t
+    constexpr int32_t maxValue = 1 << 23;
+    int32_t peak = 0;
+    for (int32_t value : signal) {
+      peak = std::max(peak, std::abs(value));
+    }
+    int shift = 0;
+    while ((peak >> shift) >= maxValue) {
+      shift++;
+    }
+    if (shift > 0) {
+      for (int32_t& value : signal) {
+        value >>= shift;
+      }
+    }
+    return shift;
+  }
 }
 
 Ppg::Ppg() {
   dataAverage.fill(0.0f);
-  spectrum.fill(0.0f);
+  spectrum.fill(0);
+  SetSamplePeriod(defaultSamplePeriod);
 }
 
-int8_t Ppg::Preprocess(uint16_t hrs, uint16_t als) {
+void Ppg::SetSamplePeriod(uint8_t period) {
+  if (period == samplePeriod) {
+    return;
+  }
+  const auto* coefficients = std::find_if(std::begin(filterCoefficients), std::end(filterCoefficients), [period](const auto& entry) {
+    return entry.samplePeriod == period;
+  });
+  if (coefficients == std::end(filterCoefficients)) {
+    NRF_LOG_WARNING("[Ppg] Unsupported sample period : %d ms", period);
+    return;
+  }
+
+  samplePeriod = period;
+  lowPassAlpha = coefficients->lowPassAlpha;
+  highPassAlpha = coefficients->highPassAlpha;
+  float sampleFreq = 1000.0f / static_cast<float>(samplePeriod);
+  freqResolution = sampleFreq / dataLength;
+  hrROIbegin = static_cast<uint16_t>(hrROIbeginFreq / freqResolution + 0.5f);
+  // The peak search needs the bin after the ROI
+  hrROIend = std::min(static_cast<uint16_t>(hrROIendFreq / freqResolution + 0.5f), static_cast<uint16_t>(spectrumLength - 1));
+  Reset(true);
+}
+
+int8_t Ppg::Preprocess(uint16_t hrs, uint16_t als, const std::array<int16_t, MotionArtifactFilter::nbAxes>& acceleration) {
   if (dataIndex < dataLength) {
-    dataHRS[dataIndex++] = hrs;
+    if (dataIndex == 0) {
+      // New acquisition : restart the filters, from the level of the first sample
+      baselineHrs = hrs;
+      filterState.fill(0);
+      baselineAcceleration = acceleration;
+      for (auto& state : accelerationFilterState) {
+        state.fill(0);
+      }
+      motionArtifactFilter.Reset();
+    }
+    // The filters start from their steady state for the first sample, then the high-pass stages remove the drift
+    int32_t detrended = (static_cast<int32_t>(hrs) - static_cast<int32_t>(baselineHrs)) * (1 << fractionalBits);
+    int32_t sample = Filter30to240(detrended, filterState, lowPassAlpha, highPassAlpha);
+
+    // The acceleration goes through the same filter, so that it matches the artifacts in the PPG signal
+    std::array<int32_t, MotionArtifactFilter::nbAxes> filteredAcceleration;
+    for (size_t axis = 0; axis < MotionArtifactFilter::nbAxes; axis++) {
+      detrended = (acceleration[axis] - baselineAcceleration[axis]) * (1 << fractionalBits);
+      filteredAcceleration[axis] = Filter30to240(detrended, accelerationFilterState[axis], lowPassAlpha, highPassAlpha);
+    }
+
+    filtered[filteredHead] = motionArtifactFilter.Filter(sample, filteredAcceleration);
+    filteredHead = (filteredHead + 1) % dataLength;
+    dataIndex++;
   }
   alsValue = als;
   if (alsValue > alsThreshold) {
@@ -164,10 +183,7 @@ int Ppg::HeartRate() {
   int hr = 0;
   hr = ProcessHeartRate(resetSpectralAvg);
   resetSpectralAvg = false;
-  // Make room for overlapWindow number of new samples
-  for (int idx = 0; idx < dataLength - overlapWindow; idx++) {
-    dataHRS[idx] = dataHRS[idx + overlapWindow];
-  }
+  // Wait for overlapWindow number of new samples, which replace the oldest ones in the ring buffer
   dataIndex = dataLength - overlapWindow;
   return hr;
 }
@@ -178,58 +194,35 @@ void Ppg::Reset(bool resetDaqBuffer) {
     enoughData = false;
   }
   avgIndex = 0;
+  stableUpdates = 0;
   dataAverage.fill(0.0f);
   lastPeakLocation = 0.0f;
   alsThreshold = UINT16_MAX;
   alsValue = 0;
   resetSpectralAvg = true;
-  spectrum.fill(0.0f);
+  spectrum.fill(0);
 }
 
 // Pass init == true to reset spectral averaging.
 // Returns -1 (Reset Acquisition), 0 (Unable to obtain HR) or HR (BPM).
 int Ppg::ProcessHeartRate(bool init) {
-  std::copy(dataHRS.begin(), dataHRS.end(), vReal.begin());
-  Detrend(vReal);
-  Filter30to240(vReal);
-  vImag.fill(0.0f);
-  // Apply Hanning Window
-  int hannIdx = 0;
-  for (int idx = 0; idx < dataLength; idx++) {
-    if (idx >= dataLength >> 1) {
-      hannIdx--;
-    }
-    vReal[idx] *= hanning[hannIdx];
-    if (idx < dataLength >> 1) {
-      hannIdx++;
-    }
+  ApplyWindow(filtered, filteredHead, signal);
+  int shift = NormaliseBlock(signal) + spectrumFractionalBits - fractionalBits;
+  // Compute the magnitude spectrum, signal is overwritten
+  std::array<uint32_t, spectrumLength> magnitude;
+  PpgSpectrum::RealFftMagnitude(signal, magnitude.data());
+  for (uint32_t& value : magnitude) {
+    value = shift >= 0 ? value << shift : (value + (1U << (-shift - 1))) >> -shift;
   }
-  // Compute in place power spectrum
-  ArduinoFFT<float> FFT = ArduinoFFT<float>(vReal.data(), vImag.data(), dataLength, sampleFreq);
-  FFT.compute(FFTDirection::Forward);
-  FFT.complexToMagnitude();
-  FFT.~ArduinoFFT();
-  SpectrumAverage(vReal.data(), spectrum.data(), spectrum.size(), init);
+  SpectrumAverage(magnitude.data(), spectrum.data(), spectrum.size(), init);
   peakLocation = 0.0f;
-  float threshold = peakDetectionThreshold;
-  float peakWidth = 0.0f;
-  int specLen = spectrum.size();
-  float max = SpectrumMax(spectrum, hrROIbegin, hrROIend);
-  float signalToNoiseRatio = SignalToNoise(spectrum, hrROIbegin, hrROIend, max);
-  if (signalToNoiseRatio > signalToNoiseThreshold && spectrum.at(0) < dcThreshold) {
-    threshold *= max;
-    // Reuse VImag for interpolation x values passed to PeakSearch
-    for (int idx = 0; idx < dataLength; idx++) {
-      vImag[idx] = idx;
-    }
-    peakLocation = PeakSearch(vImag.data(),
-                              spectrum.data(),
-                              threshold,
-                              peakWidth,
-                              static_cast<float>(hrROIbegin),
-                              static_cast<float>(hrROIend),
-                              specLen);
-    peakLocation *= freqResolution;
+  int peakWidth = 0;
+  uint32_t max = SpectrumMax(spectrum, hrROIbegin, hrROIend);
+  if (SignalToNoiseAbove(spectrum, hrROIbegin, hrROIend, max, signalToNoiseThreshold) &&
+      static_cast<uint64_t>(spectrum.at(0)) * dcToPeakRatio < max) {
+    int64_t threshold = static_cast<int64_t>(max) * peakDetectionThreshold / 100;
+    int peak = PpgSpectrum::PeakSearch(spectrum.data(), threshold, peakWidth, hrROIbegin, hrROIend);
+    peakLocation = static_cast<float>(peak) / binSubdivisions * freqResolution;
   }
   // Peak too wide? (broad spectrum noise or large, rapid HR change)
   if (peakWidth > maxPeakWidth) {
@@ -246,7 +239,13 @@ int Ppg::ProcessHeartRate(bool init) {
   // Set the ambient light threshold and return HR in BPM
   alsThreshold = static_cast<uint16_t>(alsValue * alsFactor);
   // Get current average HR. If HR reduced to zero, return -1 (reset) else HR
+  float newPeakLocation = peakLocation;
   peakLocation = HeartRateAverage(peakLocation);
+  if (newPeakLocation > 0.0f && std::abs(newPeakLocation - peakLocation) <= stableTolerance) {
+    stableUpdates = std::min<uint8_t>(stableUpdates + 1, stableUpdatesForConfidence);
+  } else {
+    stableUpdates = 0;
+  }
   int rtn = -1;
   if (peakLocation == 0.0f && lastPeakLocation > 0.0f) {
     lastPeakLocation = 0.0f;
@@ -257,13 +256,13 @@ int Ppg::ProcessHeartRate(bool init) {
   return rtn;
 }
 
-void Ppg::SpectrumAverage(const float* data, float* spectrum, int length, bool reset) {
+void Ppg::SpectrumAverage(const uint32_t* data, uint32_t* spectrum, int length, bool reset) {
   if (reset) {
     spectralAvgCount = 0;
   }
-  float count = static_cast<float>(spectralAvgCount);
+  uint64_t count = spectralAvgCount;
   for (int idx = 0; idx < length; idx++) {
-    spectrum[idx] = (spectrum[idx] * count + data[idx]) / (count + 1);
+    spectrum[idx] = static_cast<uint32_t>((spectrum[idx] * count + data[idx] + count / 2) / (count + 1));
   }
   if (spectralAvgCount < spectralAvgMax) {
     spectralAvgCount++;
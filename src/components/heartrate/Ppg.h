@@ -3,30 +3,40 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
-// Note: Change internal define 'sqrt_internal sqrt' to
-// 'sqrt_internal sqrtf' to save ~3KB of flash.
-#define sqrt_internal sqrtf
-#define FFT_SPEED_OVER_PRECISION
-#include "libs/arduinoFFT/src/arduinoFFT.h"
+#include "components/heartrate/MotionArtifactFilter.h"
 
 namespace Pinetime {
   namespace Controllers {
     class Ppg {
     public:
       Ppg();
-      int8_t Preprocess(uint16_t hrs, uint16_t als);
+      // acceleration is the last value of the accelerometer on each axis (1024 = 1g)
+      int8_t Preprocess(uint16_t hrs, uint16_t als, const std::array<int16_t, MotionArtifactFilter::nbAxes>& acceleration);
       int HeartRate();
+      // Confidence in the heart rate (0-100), which reaches 100 when the last readings are stable
+      uint8_t Confidence() const {
+        return static_cast<uint8_t>(stableUpdates * 100 / stableUpdatesForConfidence);
+      }
       void Reset(bool resetDaqBuffer);
-      static constexpr int deltaTms = 100;
+      // Supported sample periods (ms) : 10Hz, and 8Hz to save power when the signal is strong
+      static constexpr uint8_t defaultSamplePeriod = 100;
+      static constexpr uint8_t longSamplePeriod = 125;
+      // Restarts the acquisition if the period changes
+      void SetSamplePeriod(uint8_t period);
+      uint8_t SamplePeriod() const {
+        return samplePeriod;
+      }
       // Daq dataLength: Must be power of 2
       static constexpr uint16_t dataLength = 64;
       static constexpr uint16_t spectrumLength = dataLength >> 1;
+      // Averaged magnitude spectrum of the last reading (Q4)
+      const std::array<uint32_t, spectrumLength>& Spectrum() const {
+        return spectrum;
+      }
+      // Resolution of the peak positions and widths (steps per bin)
+      static constexpr int binSubdivisions = 100;
 
     private:
-      // The sampling frequency (Hz) based on sampling time in milliseconds (DeltaTms)
-      static constexpr float sampleFreq = 1000.0f / static_cast<float>(deltaTms);
-      // The frequency resolution (Hz)
-      static constexpr float freqResolution = sampleFreq / dataLength;
       // Number of samples before each analysis
       // 0.5 second update rate at 10Hz
       static constexpr uint16_t overlapWindow = 5;
@@ -34,36 +44,63 @@ namespace Pinetime {
       // Note: actual number of spectra averaged = spectralAvgMax + 1
       static constexpr uint16_t spectralAvgMax = 2;
       // Multiple Peaks above this threshold (% of max) are rejected
-      static constexpr float peakDetectionThreshold = 0.6f;
-      // Maximum peak width (bins) at threshold for valid peak.
-      static constexpr float maxPeakWidth = 2.5f;
+      static constexpr uint32_t peakDetectionThreshold = 60;
+      // Maximum peak width (steps) at threshold for valid peak.
+      static constexpr int maxPeakWidth = 250;
       // Metric for spectrum noise level.
-      static constexpr float signalToNoiseThreshold = 3.0f;
-      // Heart rate Region Of Interest begin (bins)
-      static constexpr uint16_t hrROIbegin = static_cast<uint16_t>((30.0f / 60.0f) / freqResolution + 0.5f);
-      // Heart rate Region Of Interest end (bins)
-      static constexpr uint16_t hrROIend = static_cast<uint16_t>((240.0f / 60.0f) / freqResolution + 0.5f);
+      static constexpr uint32_t signalToNoiseThreshold = 3;
+      // Heart rate Region Of Interest (Hz)
+      static constexpr float hrROIbeginFreq = 30.0f / 60.0f;
+      static constexpr float hrROIendFreq = 240.0f / 60.0f;
       // Minimum HR (Hz)
       static constexpr float minHR = 40.0f / 60.0f;
       // Maximum HR (Hz)
       static constexpr float maxHR = 230.0f / 60.0f;
-      // Threshold for high DC level after filtering
-      static constexpr float dcThreshold = 0.5f;
+      // The samples are filtered in fixed-point with this number of fractional bits : the 16 bits samples relative to the
+      // first one reach 2^24, and the high-pass stages can double them, which still fits in an int32_t. The FFT input is
+      // scaled down when needed instead.
+      static constexpr int fractionalBits = 8;
+      // Number of fractional bits of the spectrum, which can reach 64 * 2^21
+      static constexpr int spectrumFractionalBits = 4;
+      // The DC level after filtering must be below the peak divided by this ratio : after a step of the level (the watch
+      // moved), the high-pass stages leave a large DC component until they settle
+      static constexpr uint32_t dcToPeakRatio = 4;
+      // A reading is stable if it's within this distance of the average (Hz)
+      static constexpr float stableTolerance = 5.0f / 60.0f;
+      // Number of consecutive stable readings to reach full confidence (3s at 0.5s update rate)
+      static constexpr uint8_t stableUpdatesForConfidence = 6;
       // ALS detection factor
       static constexpr float alsFactor = 2.0f;
 
-      // Raw ADC data
-      std::array<uint16_t, dataLength> dataHRS;
-      // Stores Real numbers from FFT
-      std::array<float, dataLength> vReal;
-      // Stores Imaginary numbers from FFT
-      std::array<float, dataLength> vImag;
-      // Stores power spectrum calculated from FFT real and imag values
-      std::array<float, (spectrumLength)> spectrum;
+      // Sample period in milliseconds, and the parameters that depend on it
+      uint8_t samplePeriod = 0;
+      // The frequency resolution (Hz)
+      float freqResolution;
+      // Heart rate Region Of Interest (bins)
+      uint16_t hrROIbegin;
+      uint16_t hrROIend;
+      // Coefficients of the band-pass filter (Q15)
+      int32_t lowPassAlpha;
+      int32_t highPassAlpha;
+
+      // Band-pass filtered samples, filteredHead is the index of the oldest one
+      std::array<int32_t, dataLength> filtered;
+      size_t filteredHead = 0;
+      // State of the band-pass filters of the PPG and acceleration samples
+      uint16_t baselineHrs = 0;
+      std::array<int32_t, 8> filterState;
+      std::array<int16_t, MotionArtifactFilter::nbAxes> baselineAcceleration;
+      std::array<std::array<int32_t, 8>, MotionArtifactFilter::nbAxes> accelerationFilterState;
+      MotionArtifactFilter motionArtifactFilter;
+      // Windowed samples, then 32 complex numbers (real, imaginary) during the FFT
+      std::array<int32_t, dataLength> signal;
+      // Running average of the magnitude spectrum, in fixed-point
+      std::array<uint32_t, spectrumLength> spectrum;
       // Stores each new HR value (Hz). Non zero values are averaged for HR output
       std::array<float, 20> dataAverage;
 
       uint16_t avgIndex = 0;
+      uint8_t stableUpdates = 0;
       uint16_t spectralAvgCount = 0;
       float lastPeakLocation = 0.0f;
       uint16_t alsThreshold = UINT16_MAX;
@@ -75,7 +112,7 @@ namespace Pinetime {
 
       int ProcessHeartRate(bool init);
       float HeartRateAverage(float hr);
-      void SpectrumAverage(const float* data, float* spectrum, int length, bool reset);
+      void SpectrumAverage(const uint32_t* data, uint32_t* spectrum, int length, bool reset);
     };
   }
 }
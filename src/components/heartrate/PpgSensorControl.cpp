@@ -0,0 +1,131 @@
+#include "components/heartrate/PpgSensorControl.h"
+#include <nrf_log.h>
+#include "components/heartrate/Ppg.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  struct Exposure {
+    uint8_t ledDriveCurrent;
+    uint8_t gain;
+  };
+
+  // From the lowest to the highest. The LED current is increased first since it improves the signal to noise ratio,
+  // while the gain amplifies the noise too.
+  constexpr Exposure exposures[] {{0, 0}, {1, 0}, {2, 0}, {3, 0}, {3, 1}, {3, 2}, {3, 3}};
+  constexpr size_t nbExposures = sizeof(exposures) / sizeof(exposures[0]);
+
+  // Resolution (bits) and wait time (HWT) that give a conversion at each sample period
+  constexpr uint8_t normalResolution = 15;
+  constexpr uint8_t normalWaitTime = 5; // 50ms + ~50ms of conversion
+  constexpr uint8_t lowRateResolution = 14;
+  constexpr uint8_t lowRateWaitTime = 3; // 100ms + ~25ms of conversion
+}
+
+void PpgSensorControl::Start() {
+  state = States::Settling;
+  exposure = 0;
+  lowRate = false;
+  lowRateAllowed = true;
+  config = {exposures[0].ledDriveCurrent, normalResolution, exposures[0].gain, normalWaitTime};
+  samplePeriod = Ppg::defaultSamplePeriod;
+  nbSamples = 0;
+  hrsSum = 0;
+  alsSum = 0;
+  outOfRangeCount = 0;
+  samplesWithoutHeartRate = 0;
+}
+
+uint32_t PpgSensorControl::Level(uint16_t value) const {
+  uint32_t fullScale = (1U << config.resolution) - 1;
+  return value * 100U / fullScale;
+}
+
+bool PpgSensorControl::SetExposure(size_t newExposure) {
+  if (newExposure == exposure) {
+    return false;
+  }
+  NRF_LOG_INFO("[PpgSensorControl] Exposure %d -> %d", exposure, newExposure);
+  exposure = newExposure;
+  config.ledDriveCurrent = exposures[exposure].ledDriveCurrent;
+  config.gain = exposures[exposure].gain;
+  return true;
+}
+
+bool PpgSensorControl::SetLowRate(bool enable) {
+  if (enable == lowRate) {
+    return false;
+  }
+  NRF_LOG_INFO("[PpgSensorControl] Low rate : %d", enable);
+  lowRate = enable;
+  config.resolution = lowRate ? lowRateResolution : normalResolution;
+  config.waitTime = lowRate ? lowRateWaitTime : normalWaitTime;
+  samplePeriod = lowRate ? Ppg::longSamplePeriod : Ppg::defaultSamplePeriod;
+  samplesWithoutHeartRate = 0;
+  return true;
+}
+
+bool PpgSensorControl::OnSample(uint16_t hrs, uint16_t als) {
+  uint32_t level = Level(hrs);
+
+  if (state == States::Measuring) {
+    if (level >= saturatedLevel || level < lostLevel) {
+      outOfRangeCount++;
+    } else {
+      outOfRangeCount = 0;
+    }
+    if (outOfRangeCount < outOfRangeSamples) {
+      return false;
+    }
+    state = States::Settling;
+    nbSamples = 0;
+  }
+
+  // Settling
+  nbSamples++;
+  if (nbSamples <= discardedSamples) {
+    hrsSum = 0;
+    alsSum = 0;
+    return false;
+  }
+  hrsSum += hrs;
+  alsSum += als;
+  if (nbSamples < discardedSamples + settlingSamples) {
+    return false;
+  }
+
+  uint32_t meanHrs = hrsSum / settlingSamples;
+  uint32_t meanAls = alsSum / settlingSamples;
+  uint32_t meanLevel = Level(meanHrs);
+  nbSamples = 0;
+  if (meanLevel > maxSettledLevel && exposure > 0) {
+    return SetExposure(exposure - 1);
+  }
+  if (meanLevel < minSettledLevel && exposure < nbExposures - 1) {
+    return SetExposure(exposure + 1);
+  }
+
+  state = States::Measuring;
+  outOfRangeCount = 0;
+  // The level relative to the full scale does not depend on the resolution
+  bool strong = exposure == 0 && meanLevel >= strongLevel && meanAls * 100 <= meanHrs * maxAmbientLevel;
+  return SetLowRate(strong && lowRateAllowed);
+}
+
+bool PpgSensorControl::OnHeartRate(int bpm) {
+  if (!lowRate || bpm == -2) {
+    return false;
+  }
+  if (bpm > 0) {
+    samplesWithoutHeartRate = 0;
+    return false;
+  }
+  // The heart rate is only updated every few samples, 0 is returned in between
+  samplesWithoutHeartRate++;
+  if (samplesWithoutHeartRate < maxSamplesWithoutHeartRate) {
+    return false;
+  }
+  // The signal is not good enough at the low rate, use the normal rate until the end of the measurement
+  lowRateAllowed = false;
+  return SetLowRate(false);
+}
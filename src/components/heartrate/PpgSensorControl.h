@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "drivers/Hrs3300.h"
+
+namespace Pinetime {
+  namespace Controllers {
+    /* Chooses the settings of the heart rate sensor from the levels it measures.
+     *
+     * At the start of each measurement, the exposure (LED drive current, then gain) is adjusted until the reflected
+     * light (HRS) is in the useful range of the ADC : weak signals get more light or gain, so that the pulse is well
+     * above the quantisation and noise, and saturated ones get less. The exposure goes back to settling if the level
+     * leaves this range during the measurement (the watch moved on the wrist).
+     *
+     * When even the lowest exposure gives a strong level with little ambient light, the sensor switches to a lower
+     * resolution and sample rate, which divides the LED on-time by 2.5. It goes back to the normal rate for the rest of
+     * the measurement if no heart rate is found.
+     *
+     * The sensor and the heart rate algorithm must be restarted each time the settings change.
+     */
+    class PpgSensorControl {
+    public:
+      // Back to the default settings, for a new measurement
+      void Start();
+      // Returns true if the settings changed
+      bool OnSample(uint16_t hrs, uint16_t als);
+      // bpm is the value returned by Ppg::HeartRate(). Returns true if the settings changed.
+      bool OnHeartRate(int bpm);
+
+      const Drivers::Hrs3300::Config& SensorConfig() const {
+        return config;
+      }
+
+      // Period between the samples, in ms
+      uint8_t SamplePeriod() const {
+        return samplePeriod;
+      }
+
+    private:
+      enum class States : uint8_t { Settling, Measuring };
+
+      // Levels relative to the full scale of the ADC (%)
+      static constexpr uint32_t maxSettledLevel = 80;
+      static constexpr uint32_t minSettledLevel = 20;
+      static constexpr uint32_t strongLevel = 50;
+      static constexpr uint32_t saturatedLevel = 95;
+      static constexpr uint32_t lostLevel = 5;
+      // Maximum ambient light for the low rate (% of HRS)
+      static constexpr uint32_t maxAmbientLevel = 10;
+      // The first samples after a change can still be measured with the previous settings
+      static constexpr uint8_t discardedSamples = 2;
+      static constexpr uint8_t settlingSamples = 4;
+      // Consecutive samples out of range before settling again
+      static constexpr uint8_t outOfRangeSamples = 5;
+      // Consecutive samples without a heart rate before leaving the low rate (6s)
+      static constexpr uint8_t maxSamplesWithoutHeartRate = 48;
+
+      bool SetExposure(size_t newExposure);
+      bool SetLowRate(bool enable);
+      uint32_t Level(uint16_t value) const;
+
+      Drivers::Hrs3300::Config config;
+      uint8_t samplePeriod;
+      States state = States::Settling;
+      size_t exposure = 0;
+      bool lowRate = false;
+      bool lowRateAllowed = true;
+      uint8_t nbSamples = 0;
+      uint32_t hrsSum = 0;
+      uint32_t alsSum = 0;
+      uint8_t outOfRangeCount = 0;
+      uint8_t samplesWithoutHeartRate = 0;
+    };
+  }
+}
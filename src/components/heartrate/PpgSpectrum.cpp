@@ -0,0 +1,161 @@
+#include "components/heartrate/PpgSpectrum.h"
+#include <cstdlib>
+#include <utility>
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  // Position (in steps of 1/Ppg::binSubdivisions bin) where the line between the bins index and index + 1 crosses threshold.
+  // One of the bins must be below the threshold and the other one above.
+  int Crossing(const uint32_t* values, int index, int64_t threshold) {
+    int64_t value0 = values[index];
+    int64_t value1 = values[index + 1];
+    return index * Ppg::binSubdivisions + static_cast<int>((threshold - value0) * Ppg::binSubdivisions / (value1 - value0));
+  }
+
+  // cos(2 * pi * k / 64) in Q30, for k in [0, 16]. The other twiddle factors of the FFT are derived by symmetry.
+  constexpr int32_t cosine[(Ppg::dataLength >> 2) + 1] {1073741824, 1068571464, 1053110176, 1027506862, 992008094, 946955747,
+                                                        892783698,  830013654,  759250125,  681174602,  596538995, 506158392,
+                                                        410903207,  311690799,  209476638,  105245103,  0};
+  static_assert(Ppg::dataLength == 64, "The cosine table must be updated");
+
+  // cos and sin of 2 * pi * k / 64, k in [0, 32]
+  int32_t Cos(int k) {
+    return k <= 16 ? cosine[k] : -cosine[32 - k];
+  }
+
+  int32_t Sin(int k) {
+    return k <= 16 ? cosine[16 - k] : cosine[k - 16];
+  }
+
+  int32_t MultiplyQ30(int32_t value, int32_t factor) {
+    return static_cast<int32_t>((static_cast<int64_t>(value) * factor + (1 << 29)) >> 30);
+  }
+
+  // Digit by digit, from the highest power of 4 below value (CLZ on the Cortex-M4, instead of a loop)
+  uint32_t SquareRoot(uint64_t value) {
+    if (value == 0) {
+      return 0;
+    }
+    uint64_t result = 0;
+    uint64_t bit = static_cast<uint64_t>(1) << ((63 - __builtin_clzll(value)) & ~1);
+    while (bit != 0) {
+      if (value >= result + bit) {
+        value -= result + bit;
+        result = (result >> 1) + bit;
+      } else {
+        result >>= 1;
+      }
+      bit >>= 2;
+    }
+    return static_cast<uint32_t>(result);
+  }
+
+  uint32_t Magnitude(int32_t real, int32_t imaginary) {
+    uint64_t realSquared = static_cast<uint64_t>(static_cast<int64_t>(real) * real);
+    uint64_t imaginarySquared = static_cast<uint64_t>(static_cast<int64_t>(imaginary) * imaginary);
+    return SquareRoot(realSquared + imaginarySquared);
+  }
+}
+
+void PpgSpectrum::RealFftMagnitude(std::array<int32_t, Ppg::dataLength>& data, uint32_t* magnitude) {
+  constexpr int size = Ppg::dataLength >> 1;
+  int32_t* z = data.data();
+
+  // Bit reversal permutation of the complex numbers
+  for (int i = 1, j = 0; i < size; i++) {
+    int bit = size >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(z[2 * i], z[2 * j]);
+      std::swap(z[2 * i + 1], z[2 * j + 1]);
+    }
+  }
+
+  // Radix-2 decimation in time butterflies, W32^k = W64^2k
+  for (int length = 2; length <= size; length <<= 1) {
+    int step = Ppg::dataLength / length;
+    for (int group = 0; group < size; group += length) {
+      for (int k = 0; k < length / 2; k++) {
+        int32_t c = Cos(k * step);
+        int32_t s = Sin(k * step);
+        int a = 2 * (group + k);
+        int b = 2 * (group + k + length / 2);
+        // (c - i s) * z[b]
+        int32_t real = MultiplyQ30(z[b], c) + MultiplyQ30(z[b + 1], s);
+        int32_t imaginary = MultiplyQ30(z[b + 1], c) - MultiplyQ30(z[b], s);
+        z[b] = z[a] - real;
+        z[b + 1] = z[a + 1] - imaginary;
+        z[a] += real;
+        z[a + 1] += imaginary;
+      }
+    }
+  }
+
+  // X[k] = E[k] + W64^k * O[k] and X[32 - k] = conj(E[k] - W64^k * O[k]), with
+  // E[k] = (Z[k] + conj(Z[32 - k])) / 2 and O[k] = (Z[k] - conj(Z[32 - k])) / 2i
+  magnitude[0] = static_cast<uint32_t>(std::abs(z[0] + z[1]));
+  for (int k = 1; k <= size / 2; k++) {
+    int a = 2 * k;
+    int b = 2 * (size - k);
+    int32_t evenReal = (z[a] + z[b]) / 2;
+    int32_t evenImaginary = (z[a + 1] - z[b + 1]) / 2;
+    int32_t oddReal = (z[a + 1] + z[b + 1]) / 2;
+    int32_t oddImaginary = (z[b] - z[a]) / 2;
+    int32_t c = Cos(k);
+    int32_t s = Sin(k);
+    // (c - i s) * O[k]
+    int32_t real = MultiplyQ30(oddReal, c) + MultiplyQ30(oddImaginary, s);
+    int32_t imaginary = MultiplyQ30(oddImaginary, c) - MultiplyQ30(oddReal, s);
+    magnitude[k] = Magnitude(evenReal + real, evenImaginary + imaginary);
+    if (k < size / 2) {
+      magnitude[size - k] = Magnitude(evenReal - real, evenImaginary - imaginary);
+    }
+  }
+}
+
+int PpgSpectrum::ParabolicPeak(const uint32_t* values, int index) {
+  int64_t previous = values[index - 1];
+  int64_t current = values[index];
+  int64_t next = values[index + 1];
+  int64_t curvature = 2 * (2 * current - previous - next);
+  if (curvature <= 0) {
+    return index * Ppg::binSubdivisions;
+  }
+  return index * Ppg::binSubdivisions + static_cast<int>((next - previous) * Ppg::binSubdivisions / curvature);
+}
+
+int PpgSpectrum::PeakSearch(const uint32_t* values, int64_t threshold, int& width, int start, int end) {
+  int peaks = 0;
+  bool enabled = false;
+  int risingCrossing = 0;
+  int highestBin = 0;
+  int peakBin = 0;
+  for (int idx = start; idx < end; idx++) {
+    // A bin equal to the threshold is below it : a bin that only touches the threshold is not a peak
+    bool above = values[idx] > threshold;
+    bool nextAbove = values[idx + 1] > threshold;
+    if (!above) {
+      enabled = true;
+    } else if (enabled && values[idx] > values[highestBin]) {
+      highestBin = idx;
+    }
+
+    if (!above && nextAbove) {
+      risingCrossing = Crossing(values, idx, threshold);
+      highestBin = idx + 1;
+    } else if (above && !nextAbove && enabled) {
+      peaks++;
+      width = Crossing(values, idx, threshold) - risingCrossing;
+      peakBin = highestBin;
+    }
+  }
+  if (peaks != 1) {
+    width = 0;
+    return 0;
+  }
+  return ParabolicPeak(values, peakBin);
+}
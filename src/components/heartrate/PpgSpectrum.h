@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "components/heartrate/Ppg.h"
+
+namespace Pinetime {
+  namespace Controllers {
+    // Fixed-point spectrum analysis of the PPG signal, used by Ppg
+    namespace PpgSpectrum {
+      // Magnitude spectrum (bins 0 to 31) of the 64 real samples in data, computed in place by a 32 points complex FFT
+      // of the samples packed in pairs (data[2n] + i * data[2n + 1]), followed by a split step that separates the spectra
+      // of the even and odd samples. The samples must be below 2^23 in absolute value, data is overwritten.
+      void RealFftMagnitude(std::array<int32_t, Ppg::dataLength>& data, uint32_t* magnitude);
+
+      // Position (in steps of 1/Ppg::binSubdivisions bin) of the vertex of the parabola through the bin index and its
+      // neighbours. The bin must be at least as high as its neighbours, so the vertex is less than half a bin away.
+      int ParabolicPeak(const uint32_t* values, int index);
+
+      // Looks for the peaks above threshold of the spectrum between the bins start and end, in a single pass. The spectrum
+      // is interpolated linearly between the bins to find where it crosses the threshold, and the peaks that are not
+      // entirely between start and end are ignored.
+      // If there is exactly one peak, returns its position and sets width to its width at threshold (both in steps of
+      // 1/Ppg::binSubdivisions bin). Otherwise, returns 0 and sets width to 0.
+      int PeakSearch(const uint32_t* values, int64_t threshold, int& width, int start, int end);
+    }
+  }
+}
@@ -1,7 +1,7 @@
 #include "components/motion/MotionController.h"
 
-#include <task.h>
-
+#include <algorithm>
+#include <nrf_assert.h>
 #include "utility/Math.h"
 
 using namespace Pinetime::Controllers;
@@ -35,6 +35,12 @@ namespace {
   }
 }
 
+MotionController::MotionController() {
+  recentSamplesMutex = xSemaphoreCreateMutex();
+  ASSERT(recentSamplesMutex != nullptr);
+  xSemaphoreGive(recentSamplesMutex);
+}
+
 void MotionController::AdvanceDay() {
   --nbSteps; // Higher index = further in the past
   SetSteps(Days::Today, 0);
@@ -43,19 +49,40 @@ void MotionController::AdvanceDay() {
   }
 }
 
-void MotionController::Update(int16_t x, int16_t y, int16_t z, uint32_t nbSteps) {
-  uint32_t oldSteps = NbSteps(Days::Today);
-  if (oldSteps != nbSteps && service != nullptr) {
-    service->OnNewStepCountValue(nbSteps);
+void MotionController::AddSamples(const Pinetime::Drivers::Bma421::Sample* samples, size_t nbSamples, uint32_t timestamp) {
+  xSemaphoreTake(recentSamplesMutex, portMAX_DELAY);
+  for (size_t i = 0; i < nbSamples; i++) {
+    recentSamples[recentSamplesHead] = samples[i];
+    recentSamplesHead = (recentSamplesHead + 1) % nbRecentSamples;
   }
+  recentSamplesCount = std::min(recentSamplesCount + nbSamples, nbRecentSamples);
+  newestSampleTime = timestamp;
+  xSemaphoreGive(recentSamplesMutex);
+
+  for (size_t i = 0; i < nbSamples; i++) {
+    const auto& sample = samples[i];
+    if (service != nullptr) {
+      service->OnNewMotionSample(timestamp - (nbSamples - 1 - i) * samplePeriod, sample.x, sample.y, sample.z);
+    }
+
+    xSum += sample.x;
+    ySum += sample.y;
+    zSum += sample.z;
+    if (++nbSummedSamples == samplesPerUpdate) {
+      Update(xSum / samplesPerUpdate, ySum / samplesPerUpdate, zSum / samplesPerUpdate);
+      xSum = 0;
+      ySum = 0;
+      zSum = 0;
+      nbSummedSamples = 0;
+    }
+  }
+}
 
+void MotionController::Update(int16_t x, int16_t y, int16_t z) {
   if (service != nullptr && (xHistory[0] != x || yHistory[0] != y || zHistory[0] != z)) {
     service->OnNewMotionValues(x, y, z);
   }
 
-  lastTime = time;
-  time = xTaskGetTickCount();
-
   xHistory++;
   xHistory[0] = x;
   yHistory++;
@@ -64,14 +91,50 @@ void MotionController::Update(int16_t x, int16_t y, int16_t z, uint32_t nbSteps)
   zHistory[0] = z;
 
   // Update accumulated speed
-  // Currently polling at 10Hz, if this ever goes faster scalar and EMA might need adjusting
+  // The history is decimated to 10Hz, if this ever goes faster scalar and EMA might need adjusting
+  constexpr TickType_t historyPeriod = pdMS_TO_TICKS(samplePeriod * samplesPerUpdate);
   int32_t speed = std::abs(zHistory[0] - zHistory[histSize - 1] + ((yHistory[0] - yHistory[histSize - 1]) / 2) +
                            ((xHistory[0] - xHistory[histSize - 1]) / 4)) *
-                  100 / (time - lastTime);
+                  100 / historyPeriod;
   // integer version of (.2 * speed) + ((1 - .2) * accumulatedSpeed);
   accumulatedSpeed = speed / 5 + accumulatedSpeed * 4 / 5;
 
   stats = GetAccelStats();
+}
+
+bool MotionController::AccelerationAt(uint32_t timestamp, uint32_t period, std::array<int16_t, 3>& acceleration) const {
+  bool available = false;
+  xSemaphoreTake(recentSamplesMutex, portMAX_DELAY);
+  auto age = static_cast<int32_t>(newestSampleTime - timestamp);
+  if (recentSamplesCount > 0 && age >= 0) {
+    // Position of the last sample measured at or before timestamp, 0 is the newest one
+    size_t last = (age + samplePeriod - 1) / samplePeriod;
+    size_t count = std::min<size_t>(std::max<uint32_t>(period / samplePeriod, 1), recentSamplesCount - std::min(last, recentSamplesCount));
+    if (count > 0) {
+      int32_t x = 0;
+      int32_t y = 0;
+      int32_t z = 0;
+      for (size_t i = last; i < last + count; i++) {
+        const auto& sample = recentSamples[(recentSamplesHead + nbRecentSamples - 1 - i) % nbRecentSamples];
+        x += sample.x;
+        y += sample.y;
+        z += sample.z;
+      }
+      acceleration = {static_cast<int16_t>(x / static_cast<int32_t>(count)),
+                      static_cast<int16_t>(y / static_cast<int32_t>(count)),
+                      static_cast<int16_t>(z / static_cast<int32_t>(count))};
+      available = true;
+    }
+  }
+  xSemaphoreGive(recentSamplesMutex);
+  return available;
+}
+
+void MotionController::UpdateSteps(uint32_t nbSteps) {
+  uint32_t oldSteps = NbSteps(Days::Today);
+  if (oldSteps != nbSteps && service != nullptr) {
+    service->OnNewStepCountValue(nbSteps);
+  }
 
   int32_t deltaSteps = nbSteps - oldSteps;
   if (deltaSteps > 0) {
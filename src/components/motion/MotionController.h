@@ -1,8 +1,10 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 
 #include <FreeRTOS.h>
+#include <semphr.h>
 
 #include "drivers/Bma421.h"
 #include "components/ble/MotionService.h"
@@ -24,10 +26,23 @@ namespace Pinetime {
       };
 
       static constexpr size_t stepHistorySize = 2; // Store this many day's step counter
+      // The wake and sleep gestures are tuned for 10 samples per second : they are updated with the mean of each block of
+      // samplesPerUpdate samples
+      static constexpr uint8_t samplesPerUpdate = Pinetime::Drivers::Bma421::samplingRate / 10;
+
+      MotionController();
 
       void AdvanceDay();
 
-      void Update(int16_t x, int16_t y, int16_t z, uint32_t nbSteps);
+      // Samples of the accelerometer at Drivers::Bma421::samplingRate, the oldest first. timestamp is the time when the
+      // last one was measured, in ms since boot.
+      void AddSamples(const Pinetime::Drivers::Bma421::Sample* samples, size_t nbSamples, uint32_t timestamp);
+      void UpdateSteps(uint32_t nbSteps);
+
+      // Mean of the samples measured during the period (in ms) ending at timestamp, to align them with the samples of
+      // another sensor. Returns false if these samples were not read from the FIFO yet, or are not kept anymore.
+      // Can be called from any task.
+      bool AccelerationAt(uint32_t timestamp, uint32_t period, std::array<int16_t, 3>& acceleration) const;
 
       int16_t X() const {
         return xHistory[0];
@@ -82,8 +97,20 @@ namespace Pinetime {
         nbSteps[static_cast<std::underlying_type_t<Days>>(day)] = steps;
       }
 
-      TickType_t lastTime = 0;
-      TickType_t time = 0;
+      static constexpr uint32_t samplePeriod = 1000 / Pinetime::Drivers::Bma421::samplingRate; // ms
+
+      // Ring of the last samples at samplingRate. The timestamp of each sample is deduced from the one of the newest.
+      static constexpr size_t nbRecentSamples = 64;
+      std::array<Pinetime::Drivers::Bma421::Sample, nbRecentSamples> recentSamples {};
+      size_t recentSamplesHead = 0; // index of the next sample
+      size_t recentSamplesCount = 0;
+      uint32_t newestSampleTime = 0;
+      SemaphoreHandle_t recentSamplesMutex = nullptr;
+      void Update(int16_t x, int16_t y, int16_t z);
+      int32_t xSum = 0;
+      int32_t ySum = 0;
+      int32_t zSum = 0;
+      uint8_t nbSummedSamples = 0;
 
       struct AccelStats {
         static constexpr uint8_t numHistory = 2;
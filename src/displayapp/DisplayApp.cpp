@@ -129,11 +129,13 @@ DisplayApp::DisplayApp(Drivers::St7789& lcd,
                  this,
                  lvgl,
                  nullptr,
+                 nullptr,
                  nullptr} {
 }
 
 void DisplayApp::Start(System::BootErrors error) {
   msgQueue = xQueueCreate(queueSize, itemSize);
+  systemTask->Monitor().RegisterQueue(System::SystemMonitor::Queues::Display, msgQueue);
 
   bootError = error;
 
@@ -257,6 +259,7 @@ void DisplayApp::Refresh() {
             queueTimeout = CalculateSleepTime();
           }
         }
+        UpdateMonitor();
       }
       break;
     case States::Running:
@@ -264,6 +267,7 @@ void DisplayApp::Refresh() {
         LoadPreviousScreen();
       }
       queueTimeout = lv_task_handler();
+      UpdateMonitor();
 
       if (!systemTask->IsSleepDisabled() && IsPastDimTime()) {
         if (!isDimmed) {
@@ -715,6 +719,25 @@ void DisplayApp::PushMessageToSystemTask(Pinetime::System::Messages message) {
   }
 }
 
+void DisplayApp::UpdateMonitor() {
+  uint32_t nbFrames = lvgl.NbFrames();
+  if (nbFrames == monitoredFrames) {
+    return;
+  }
+  monitoredFrames = nbFrames;
+
+  auto& monitor = systemTask->Monitor();
+  monitor.OnFrameRendered(static_cast<uint16_t>(std::min<uint32_t>(lvgl.LastFrameTime(), std::numeric_limits<uint16_t>::max())));
+
+  // lv_mem_monitor() walks the whole LVGL heap, it is not needed after each frame
+  if (xTaskGetTickCount() - lvglMemorySampleTime >= pdMS_TO_TICKS(1000)) {
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    monitor.SetLvglMemory({mon.total_size, mon.free_size, mon.max_used, mon.frag_pct});
+    lvglMemorySampleTime = xTaskGetTickCount();
+  }
+}
+
 void DisplayApp::Register(Pinetime::System::SystemTask* systemTask) {
   this->systemTask = systemTask;
   this->controllers.systemTask = systemTask;
@@ -732,6 +755,10 @@ void DisplayApp::Register(Pinetime::Controllers::NavigationService* NavigationSe
   this->controllers.navigationService = NavigationService;
 }
 
+void DisplayApp::Register(Pinetime::Controllers::ActivityHistory* activityHistory) {
+  this->controllers.activityHistory = activityHistory;
+}
+
 void DisplayApp::ApplyBrightness() {
   auto brightness = settingsController.GetBrightness();
   if (brightness != Controllers::BrightnessController::Levels::Low && brightness != Controllers::BrightnessController::Levels::Medium &&
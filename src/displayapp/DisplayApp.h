@@ -81,6 +81,7 @@ namespace Pinetime {
       void Register(Pinetime::Controllers::SimpleWeatherService* weatherService);
       void Register(Pinetime::Controllers::MusicService* musicService);
       void Register(Pinetime::Controllers::NavigationService* NavigationService);
+      void Register(Pinetime::Controllers::ActivityHistory* activityHistory);
 
     private:
       Pinetime::Drivers::St7789& lcd;
@@ -147,6 +148,11 @@ namespace Pinetime {
       // If this is to be changed, make sure the actual always on refresh rate is changed
       // by configuring the LCD refresh timings
       static constexpr uint32_t alwaysOnRefreshPeriod = 500;
+
+      // Reports the frame times and the LVGL memory usage to the system monitor
+      void UpdateMonitor();
+      uint32_t monitoredFrames = 0;
+      TickType_t lvglMemorySampleTime = 0;
     };
   }
 }
@@ -123,3 +123,6 @@ void DisplayApp::Register(Pinetime::Controllers::MusicService* /*musicService*/)
 
 void DisplayApp::Register(Pinetime::Controllers::NavigationService* /*NavigationService*/) {
 }
+
+void DisplayApp::Register(Pinetime::Controllers::ActivityHistory* /*activityHistory*/) {
+}
@@ -38,6 +38,7 @@ namespace Pinetime {
     class SimpleWeatherService;
     class MusicService;
     class NavigationService;
+    class ActivityHistory;
   }
 
   namespace System {
@@ -75,6 +76,7 @@ namespace Pinetime {
       void Register(Pinetime::Controllers::SimpleWeatherService* weatherService);
       void Register(Pinetime::Controllers::MusicService* musicService);
       void Register(Pinetime::Controllers::NavigationService* NavigationService);
+      void Register(Pinetime::Controllers::ActivityHistory* activityHistory);
 
     private:
       TaskHandle_t taskHandle;
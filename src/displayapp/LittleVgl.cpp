@@ -68,6 +68,11 @@ static void rounder(lv_disp_drv_t* disp_drv, lv_area_t* area) {
   }
 }
 
+static void monitor(lv_disp_drv_t* disp_drv, uint32_t time, uint32_t /*px*/) {
+  auto* lvgl = static_cast<LittleVgl*>(disp_drv->user_data);
+  lvgl->OnFrameRendered(time);
+}
+
 bool touchpad_read(lv_indev_drv_t* indev_drv, lv_indev_data_t* data) {
   auto* lvgl = static_cast<LittleVgl*>(indev_drv->user_data);
   return lvgl->GetTouchPadInfo(data);
@@ -100,6 +105,8 @@ void LittleVgl::InitDisplay() {
   disp_drv.buffer = &disp_buf_2;
   disp_drv.user_data = this;
   disp_drv.rounder_cb = rounder;
+  /*Called after each refresh with the rendering and flushing time*/
+  disp_drv.monitor_cb = monitor;
 
   /*Finally register the driver*/
   lv_disp_drv_register(&disp_drv);
@@ -234,6 +241,11 @@ void LittleVgl::FlushDisplay(const lv_area_t* area, lv_color_t* color_p) {
   lv_disp_flush_ready(&disp_drv);
 }
 
+void LittleVgl::OnFrameRendered(uint32_t time) {
+  lastFrameTime = time;
+  nbFrames++;
+}
+
 void LittleVgl::SetNewTouchPoint(int16_t x, int16_t y, bool contact) {
   if (contact) {
     if (!isCancelled) {
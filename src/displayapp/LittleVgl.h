@@ -28,6 +28,15 @@ namespace Pinetime {
       void CancelTap();
       void ClearTouchState();
       bool IsScrolling();
+      void OnFrameRendered(uint32_t time);
+
+      uint32_t NbFrames() const {
+        return nbFrames;
+      }
+
+      uint32_t LastFrameTime() const {
+        return lastFrameTime;
+      }
 
       bool GetFullRefresh() {
         bool returnValue = fullRefresh;
@@ -67,6 +76,9 @@ namespace Pinetime {
       lv_point_t touchPoint = {};
       bool tapped = false;
       bool isCancelled = false;
+
+      uint32_t nbFrames = 0;
+      uint32_t lastFrameTime = 0; // in ms
     };
   }
 }
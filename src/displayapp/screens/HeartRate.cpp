@@ -1,6 +1,8 @@
 #include "displayapp/screens/HeartRate.h"
 #include <lvgl/lvgl.h>
 #include <components/heartrate/HeartRateController.h>
+#include "components/activity/ActivityHistory.h"
+#include "components/datetime/DateTimeController.h"
 
 #include "displayapp/DisplayApp.h"
 #include "displayapp/InfiniTimeTheme.h"
@@ -28,8 +30,21 @@ namespace {
   }
 }
 
-HeartRate::HeartRate(Controllers::HeartRateController& heartRateController, System::SystemTask& systemTask)
+HeartRate::HeartRate(Controllers::HeartRateController& heartRateController,
+                     System::SystemTask& systemTask,
+                     Controllers::ActivityHistory* activityHistory,
+                     Controllers::DateTime& dateTimeController)
   : heartRateController {heartRateController}, wakeLock(systemTask) {
+  if (activityHistory != nullptr) {
+    auto today = Controllers::ActivityHistory::Day(
+      std::chrono::duration_cast<std::chrono::minutes>(dateTimeController.CurrentDateTime().time_since_epoch()));
+    Controllers::ActivityHistory::Summary summary;
+    activityHistory->Days(today, &summary, 1);
+    if (summary.heartRateMinutes > 0) {
+      snprintf(todayStatus, sizeof(todayStatus), "Stopped\nToday: %d-%d", summary.minHeartRate, summary.maxHeartRate);
+    }
+  }
+
   bool isHrRunning = heartRateController.State() != Controllers::HeartRateController::States::Stopped;
   label_hr = lv_label_create(lv_scr_act(), nullptr);
 
@@ -91,7 +106,11 @@ void HeartRate::Refresh() {
       }
   }
 
-  lv_label_set_text_static(label_status, ToString(state));
+  if (state == Controllers::HeartRateController::States::Stopped && todayStatus[0] != '\0') {
+    lv_label_set_text_static(label_status, todayStatus);
+  } else {
+    lv_label_set_text_static(label_status, ToString(state));
+  }
   lv_obj_align(label_status, label_hr, LV_ALIGN_OUT_BOTTOM_MID, 0, 10);
 }
 
@@ -12,6 +12,8 @@
 namespace Pinetime {
   namespace Controllers {
     class HeartRateController;
+    class ActivityHistory;
+    class DateTime;
   }
 
   namespace Applications {
@@ -19,7 +21,10 @@ namespace Pinetime {
 
       class HeartRate : public Screen {
       public:
-        HeartRate(Controllers::HeartRateController& HeartRateController, System::SystemTask& systemTask);
+        HeartRate(Controllers::HeartRateController& HeartRateController,
+                  System::SystemTask& systemTask,
+                  Controllers::ActivityHistory* activityHistory,
+                  Controllers::DateTime& dateTimeController);
         ~HeartRate() override;
 
         void Refresh() override;
@@ -35,6 +40,8 @@ namespace Pinetime {
         lv_obj_t* label_status;
         lv_obj_t* btn_startStop;
         lv_obj_t* label_startStop;
+        // Range of the heart rate today, shown when the measurement is stopped
+        char todayStatus[32] = {};
 
         lv_task_t* taskRefresh;
       };
@@ -46,7 +53,10 @@ namespace Pinetime {
       static constexpr const char* icon = Screens::Symbols::heartBeat;
 
       static Screens::Screen* Create(AppControllers& controllers) {
-        return new Screens::HeartRate(controllers.heartRateController, *controllers.systemTask);
+        return new Screens::HeartRate(controllers.heartRateController,
+                                      *controllers.systemTask,
+                                      controllers.activityHistory,
+                                      controllers.dateTimeController);
       };
 
       static bool IsAvailable(Pinetime::Controllers::FS& /*filesystem*/) {
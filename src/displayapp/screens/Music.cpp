@@ -117,7 +117,6 @@ Music::Music(Pinetime::Controllers::MusicService& music) : musicService(music) {
   lv_obj_align(txtArtist, nullptr, LV_ALIGN_IN_LEFT_MID, 12, MIDDLE_OFFSET + 2 * FONT_HEIGHT + LINE_PAD);
   lv_label_set_align(txtArtist, LV_ALIGN_IN_LEFT_MID);
   lv_obj_set_width(txtArtist, LV_HOR_RES - 12);
-  lv_label_set_text_static(txtArtist, "");
   lv_obj_set_style_local_text_color(txtArtist, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, Colors::lightGray);
 
   txtTrack = lv_label_create(lv_scr_act(), nullptr);
@@ -125,7 +124,10 @@ Music::Music(Pinetime::Controllers::MusicService& music) : musicService(music) {
   lv_obj_align(txtTrack, nullptr, LV_ALIGN_IN_LEFT_MID, 12, MIDDLE_OFFSET + 1 * FONT_HEIGHT);
   lv_label_set_align(txtTrack, LV_ALIGN_IN_LEFT_MID);
   lv_obj_set_width(txtTrack, LV_HOR_RES - 12);
-  lv_label_set_text_static(txtTrack, "");
+
+  textSequence = musicService.getTextSequence();
+  lv_label_set_text(txtArtist, musicService.getArtist());
+  lv_label_set_text(txtTrack, musicService.getTrack());
 
   pageIndicator.Create();
 
@@ -152,18 +154,10 @@ Music::~Music() {
 }
 
 void Music::Refresh() {
-  if (artist != musicService.getArtist()) {
-    artist = musicService.getArtist();
-    lv_label_set_text(txtArtist, artist.data());
-  }
-
-  if (track != musicService.getTrack()) {
-    track = musicService.getTrack();
-    lv_label_set_text(txtTrack, track.data());
-  }
-
-  if (album != musicService.getAlbum()) {
-    album = musicService.getAlbum();
+  if (textSequence != musicService.getTextSequence()) {
+    textSequence = musicService.getTextSequence();
+    lv_label_set_text(txtArtist, musicService.getArtist());
+    lv_label_set_text(txtTrack, musicService.getTrack());
   }
 
   if (playing != musicService.isPlaying()) {
@@ -19,7 +19,6 @@
 
 #include <FreeRTOS.h>
 #include <lvgl/src/lv_core/lv_obj.h>
-#include <string>
 #include "displayapp/screens/Screen.h"
 #include "displayapp/widgets/PageIndicator.h"
 #include "displayapp/apps/Apps.h"
@@ -68,9 +67,8 @@ namespace Pinetime {
 
         Pinetime::Controllers::MusicService& musicService;
 
-        std::string artist;
-        std::string album;
-        std::string track;
+        /** Sequence number of the artist/track/album currently displayed */
+        uint32_t textSequence = 0;
 
         /** Total length in seconds */
         int totalLength = 0;
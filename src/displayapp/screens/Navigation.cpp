@@ -238,23 +238,15 @@ Navigation::~Navigation() {
 }
 
 void Navigation::Refresh() {
-  if (flag != navService.getFlag()) {
-    flag = navService.getFlag();
-    const auto& image = GetIcon(flag);
+  if (textSequence != navService.getTextSequence()) {
+    textSequence = navService.getTextSequence();
+    const auto& image = GetIcon(navService.getFlag());
     lv_img_set_src(imgFlag, image.fileName);
     lv_obj_set_style_local_image_recolor_opa(imgFlag, LV_IMG_PART_MAIN, LV_STATE_DEFAULT, LV_OPA_COVER);
     lv_obj_set_style_local_image_recolor(imgFlag, LV_IMG_PART_MAIN, LV_STATE_DEFAULT, LV_COLOR_CYAN);
     lv_img_set_offset_y(imgFlag, image.offset);
-  }
-
-  if (narrative != navService.getNarrative()) {
-    narrative = navService.getNarrative();
-    lv_label_set_text(txtNarrative, narrative.data());
-  }
-
-  if (manDist != navService.getManDist()) {
-    manDist = navService.getManDist();
-    lv_label_set_text(txtManDist, manDist.data());
+    lv_label_set_text(txtNarrative, navService.getNarrative());
+    lv_label_set_text(txtManDist, navService.getManDist());
   }
 
   if (progress != navService.getProgress()) {
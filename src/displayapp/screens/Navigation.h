@@ -50,9 +50,7 @@ namespace Pinetime {
 
         Pinetime::Controllers::NavigationService& navService;
 
-        std::string flag;
-        std::string narrative;
-        std::string manDist;
+        uint32_t textSequence = 0;
         int progress = 0;
 
         lv_task_t* taskRefresh;
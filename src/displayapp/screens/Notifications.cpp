@@ -20,6 +20,7 @@ Notifications::Notifications(DisplayApp* app,
     notificationManager {notificationManager},
     alertNotificationService {alertNotificationService},
     motorController {motorController},
+    systemTask {systemTask},
     wakeLock(systemTask),
     mode {mode} {
 
@@ -27,13 +28,7 @@ Notifications::Notifications(DisplayApp* app,
   auto notification = notificationManager.GetLastNotification();
   if (notification.valid) {
     currentId = notification.id;
-    currentItem = std::make_unique<NotificationItem>(notification.Title(),
-                                                     notification.Message(),
-                                                     1,
-                                                     notification.category,
-                                                     notificationManager.NbNotifications(),
-                                                     alertNotificationService,
-                                                     motorController);
+    ShowNotification(notification);
     validDisplay = true;
   } else {
     currentItem = std::make_unique<NotificationItem>(alertNotificationService, motorController);
@@ -84,11 +79,18 @@ void Notifications::Refresh() {
 
   } else if (dismissingNotification) {
     dismissingNotification = false;
-    auto notification = notificationManager.Get(currentId);
-    if (!notification.valid) {
-      notification = notificationManager.GetLastNotification();
+    Controllers::NotificationManager::Notification notification;
+    if (inHistory) {
+      notification = notificationManager.GetStored(historyLocation);
+      inHistory = notification.valid;
+    }
+    if (!inHistory) {
+      notification = notificationManager.Get(currentId);
+      if (!notification.valid) {
+        notification = notificationManager.GetLastNotification();
+      }
+      currentId = notification.id;
     }
-    currentId = notification.id;
 
     if (!notification.valid) {
       validDisplay = false;
@@ -102,14 +104,7 @@ void Notifications::Refresh() {
     }
 
     if (validDisplay) {
-      Controllers::NotificationManager::Notification::Idx currentIdx = notificationManager.IndexOf(currentId);
-      currentItem = std::make_unique<NotificationItem>(notification.Title(),
-                                                       notification.Message(),
-                                                       currentIdx + 1,
-                                                       notification.category,
-                                                       notificationManager.NbNotifications(),
-                                                       alertNotificationService,
-                                                       motorController);
+      ShowNotification(notification);
     } else {
       running = false;
     }
@@ -118,6 +113,33 @@ void Notifications::Refresh() {
   running = running && currentItem->IsRunning();
 }
 
+void Notifications::ShowNotification(const Controllers::NotificationManager::Notification& notification) {
+  uint8_t number = CurrentNumber();
+  uint8_t count = notificationManager.NbStoredNotifications();
+  // The labels copy the message, which is only valid while it is read
+  auto show = [this, &notification, number, count](const Controllers::NotificationManager::MessageView& message) {
+    currentItem = std::make_unique<NotificationItem>(message.Title(),
+                                                     message.Message(),
+                                                     number,
+                                                     notification.category,
+                                                     count,
+                                                     alertNotificationService,
+                                                     motorController);
+  };
+  bool found = inHistory ? notificationManager.ReadStored(notification.location, show) : notificationManager.Read(notification.id, show);
+  if (!found) {
+    // Evicted since it was fetched
+    currentItem = std::make_unique<NotificationItem>(alertNotificationService, motorController);
+  }
+}
+
+uint8_t Notifications::CurrentNumber() const {
+  if (inHistory) {
+    return notificationManager.NbNotifications() + historyIndex + 1;
+  }
+  return notificationManager.IndexOf(currentId) + 1;
+}
+
 void Notifications::OnPreviewInteraction() {
   wakeLock.Release();
   motorController.StopRinging();
@@ -139,6 +161,7 @@ void Notifications::DismissToBlack() {
 
 void Notifications::OnPreviewDismiss() {
   notificationManager.Dismiss(currentId);
+  systemTask.PushMessage(System::Messages::OnNotificationDismissed);
   if (timeoutLine != nullptr) {
     lv_obj_del(timeoutLine);
     timeoutLine = nullptr;
@@ -161,11 +184,31 @@ bool Notifications::OnTouchEvent(Pinetime::Applications::TouchEvents event) {
 
   switch (event) {
     case Pinetime::Applications::TouchEvents::SwipeRight:
+      if (validDisplay && inHistory) {
+        auto previousLocation = notificationManager.GetPreviousStored(historyLocation).location;
+        auto nextLocation = notificationManager.GetNextStored(historyLocation).location;
+        afterDismissNextMessageFromAbove = previousLocation.IsValid();
+        notificationManager.DismissStored(historyLocation);
+        systemTask.PushMessage(System::Messages::OnNotificationDismissed);
+        if (previousLocation.IsValid()) {
+          historyLocation = previousLocation;
+        } else if (nextLocation.IsValid()) {
+          historyLocation = nextLocation;
+          historyIndex--;
+        } else {
+          // back to the oldest notification in RAM, if any
+          inHistory = false;
+          currentId = notificationManager.GetOldestNotification().id;
+        }
+        DismissToBlack();
+        return true;
+      }
       if (validDisplay) {
         auto previousMessage = notificationManager.GetPrevious(currentId);
         auto nextMessage = notificationManager.GetNext(currentId);
         afterDismissNextMessageFromAbove = previousMessage.valid;
         notificationManager.Dismiss(currentId);
+        systemTask.PushMessage(System::Messages::OnNotificationDismissed);
         if (previousMessage.valid) {
           currentId = previousMessage.id;
         } else if (nextMessage.valid) {
@@ -181,33 +224,52 @@ bool Notifications::OnTouchEvent(Pinetime::Applications::TouchEvents event) {
       return false;
     case Pinetime::Applications::TouchEvents::SwipeDown: {
       Controllers::NotificationManager::Notification previousNotification;
-      if (validDisplay) {
-        previousNotification = notificationManager.GetPrevious(currentId);
+      bool fromHistory = inHistory;
+      if (inHistory) {
+        previousNotification = notificationManager.GetPreviousStored(historyLocation);
       } else {
-        previousNotification = notificationManager.GetLastNotification();
+        if (validDisplay) {
+          previousNotification = notificationManager.GetPrevious(currentId);
+        } else {
+          previousNotification = notificationManager.GetLastNotification();
+        }
+        if (!previousNotification.valid) {
+          // Continue with the notifications that are only in the journal
+          previousNotification = notificationManager.GetPreviousStored(notificationManager.OldestLocation());
+          fromHistory = true;
+        }
       }
 
       if (!previousNotification.valid) {
         return true;
       }
 
-      currentId = previousNotification.id;
-      Controllers::NotificationManager::Notification::Idx currentIdx = notificationManager.IndexOf(currentId);
+      if (fromHistory) {
+        historyIndex = inHistory ? historyIndex + 1 : 0;
+        historyLocation = previousNotification.location;
+        inHistory = true;
+      } else {
+        currentId = previousNotification.id;
+      }
       validDisplay = true;
       currentItem.reset(nullptr);
       app->SetFullRefresh(DisplayApp::FullRefreshDirections::Down);
-      currentItem = std::make_unique<NotificationItem>(previousNotification.Title(),
-                                                       previousNotification.Message(),
-                                                       currentIdx + 1,
-                                                       previousNotification.category,
-                                                       notificationManager.NbNotifications(),
-                                                       alertNotificationService,
-                                                       motorController);
+      ShowNotification(previousNotification);
     }
       return true;
     case Pinetime::Applications::TouchEvents::SwipeUp: {
       Controllers::NotificationManager::Notification nextNotification;
-      if (validDisplay) {
+      if (inHistory) {
+        nextNotification = notificationManager.GetNextStored(historyLocation);
+        if (nextNotification.valid) {
+          historyLocation = nextNotification.location;
+          historyIndex--;
+        } else {
+          // Back to the notifications in RAM
+          inHistory = false;
+          nextNotification = notificationManager.GetOldestNotification();
+        }
+      } else if (validDisplay) {
         nextNotification = notificationManager.GetNext(currentId);
       } else {
         nextNotification = notificationManager.GetLastNotification();
@@ -218,18 +280,13 @@ bool Notifications::OnTouchEvent(Pinetime::Applications::TouchEvents event) {
         return false;
       }
 
-      currentId = nextNotification.id;
-      Controllers::NotificationManager::Notification::Idx currentIdx = notificationManager.IndexOf(currentId);
+      if (!inHistory) {
+        currentId = nextNotification.id;
+      }
       validDisplay = true;
       currentItem.reset(nullptr);
       app->SetFullRefresh(DisplayApp::FullRefreshDirections::Up);
-      currentItem = std::make_unique<NotificationItem>(nextNotification.Title(),
-                                                       nextNotification.Message(),
-                                                       currentIdx + 1,
-                                                       nextNotification.category,
-                                                       notificationManager.NbNotifications(),
-                                                       alertNotificationService,
-                                                       motorController);
+      ShowNotification(nextNotification);
     }
       return true;
     default:
@@ -34,6 +34,8 @@ namespace Pinetime {
         void DismissToBlack();
         void OnPreviewInteraction();
         void OnPreviewDismiss();
+        // Position of the displayed notification, counted from the newest one
+        uint8_t CurrentNumber() const;
 
         class NotificationItem {
         public:
@@ -70,15 +72,23 @@ namespace Pinetime {
         };
 
       private:
+        // Creates the item of the notification, currentItem must be empty
+        void ShowNotification(const Controllers::NotificationManager::Notification& notification);
+
         DisplayApp* app;
         Pinetime::Controllers::NotificationManager& notificationManager;
         Pinetime::Controllers::AlertNotificationService& alertNotificationService;
         Pinetime::Controllers::MotorController& motorController;
+        System::SystemTask& systemTask;
         System::WakeLock wakeLock;
         Modes mode = Modes::Normal;
         std::unique_ptr<NotificationItem> currentItem;
         Pinetime::Controllers::NotificationManager::Notification::Id currentId;
         bool validDisplay = false;
+        // The displayed notification is an older one, read from the journal
+        bool inHistory = false;
+        Pinetime::Controllers::NotificationJournal::Location historyLocation;
+        uint8_t historyIndex = 0;
         bool afterDismissNextMessageFromAbove = false;
 
         lv_point_t timeoutLinePoints[2] {{0, 1}, {239, 1}};
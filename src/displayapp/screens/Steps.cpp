@@ -1,5 +1,7 @@
 #include "displayapp/screens/Steps.h"
 #include <lvgl/lvgl.h>
+#include "components/activity/ActivityHistory.h"
+#include "components/datetime/DateTimeController.h"
 #include "displayapp/DisplayApp.h"
 #include "displayapp/InfiniTimeTheme.h"
 
@@ -9,6 +11,7 @@ using Days = Pinetime::Controllers::MotionController::Days;
 
 namespace {
   constexpr const char* yesterdayStr = "Yest: %5lu";
+  constexpr const char* weekStr = "7 days: %lu";
 }
 
 static void lap_event_handler(lv_obj_t* obj, lv_event_t event) {
@@ -16,7 +19,10 @@ static void lap_event_handler(lv_obj_t* obj, lv_event_t event) {
   steps->lapBtnEventHandler(event);
 }
 
-Steps::Steps(Controllers::MotionController& motionController, Controllers::Settings& settingsController)
+Steps::Steps(Controllers::MotionController& motionController,
+             Controllers::Settings& settingsController,
+             Controllers::ActivityHistory* activityHistory,
+             Controllers::DateTime& dateTimeController)
   : motionController {motionController}, settingsController {settingsController} {
 
   stepsArc = lv_arc_create(lv_scr_act(), nullptr);
@@ -42,6 +48,22 @@ Steps::Steps(Controllers::MotionController& motionController, Controllers::Setti
   lv_label_set_text_fmt(lSteps, "%lu", stepsCount);
   lv_obj_align(lSteps, nullptr, LV_ALIGN_CENTER, 0, -40);
 
+  if (activityHistory != nullptr) {
+    // Today is counted by the motion controller, which is more up to date than the history
+    auto today = Controllers::ActivityHistory::Day(
+      std::chrono::duration_cast<std::chrono::minutes>(dateTimeController.CurrentDateTime().time_since_epoch()));
+    std::array<Controllers::ActivityHistory::Summary, 6> days;
+    activityHistory->Days(today - days.size(), days.data(), days.size());
+    for (const auto& day : days) {
+      previousDaysSteps += day.steps;
+    }
+
+    lStepsWeek = lv_label_create(lv_scr_act(), nullptr);
+    lv_obj_set_style_local_text_color(lStepsWeek, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, Colors::lightGray);
+    lv_label_set_text_fmt(lStepsWeek, weekStr, previousDaysSteps + stepsCount);
+    lv_obj_align(lStepsWeek, lSteps, LV_ALIGN_OUT_TOP_MID, 0, -10);
+  }
+
   lv_obj_t* lstepsL = lv_label_create(lv_scr_act(), nullptr);
   lv_obj_set_style_local_text_color(lstepsL, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, Colors::lightGray);
   lv_label_set_text_static(lstepsL, "Steps");
@@ -94,6 +116,11 @@ void Steps::Refresh() {
   lv_label_set_text_fmt(lStepsYesterday, yesterdayStr, motionController.NbSteps(Days::Yesterday));
   lv_obj_align(lSteps, nullptr, LV_ALIGN_CENTER, 0, -40);
 
+  if (lStepsWeek != nullptr) {
+    lv_label_set_text_fmt(lStepsWeek, weekStr, previousDaysSteps + stepsCount);
+    lv_obj_align(lStepsWeek, lSteps, LV_ALIGN_OUT_TOP_MID, 0, -10);
+  }
+
   if (currentTripSteps < 100000) {
     lv_label_set_text_fmt(tripLabel, "Trip: %5li", currentTripSteps);
   } else {
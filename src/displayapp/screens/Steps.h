@@ -12,6 +12,8 @@ namespace Pinetime {
 
   namespace Controllers {
     class Settings;
+    class ActivityHistory;
+    class DateTime;
   }
 
   namespace Applications {
@@ -19,7 +21,10 @@ namespace Pinetime {
 
       class Steps : public Screen {
       public:
-        Steps(Controllers::MotionController& motionController, Controllers::Settings& settingsController);
+        Steps(Controllers::MotionController& motionController,
+              Controllers::Settings& settingsController,
+              Controllers::ActivityHistory* activityHistory,
+              Controllers::DateTime& dateTimeController);
         ~Steps() override;
 
         void Refresh() override;
@@ -30,9 +35,12 @@ namespace Pinetime {
         Controllers::Settings& settingsController;
 
         uint32_t currentTripSteps = 0;
+        // Steps of the 6 days before today
+        uint32_t previousDaysSteps = 0;
 
         lv_obj_t* lSteps;
         lv_obj_t* lStepsYesterday;
+        lv_obj_t* lStepsWeek = nullptr;
         lv_obj_t* stepsArc;
         lv_obj_t* resetBtn;
         lv_obj_t* resetButtonLabel;
@@ -50,7 +58,10 @@ namespace Pinetime {
       static constexpr const char* icon = Screens::Symbols::shoe;
 
       static Screens::Screen* Create(AppControllers& controllers) {
-        return new Screens::Steps(controllers.motionController, controllers.settingsController);
+        return new Screens::Steps(controllers.motionController,
+                                  controllers.settingsController,
+                                  controllers.activityHistory,
+                                  controllers.dateTimeController);
       };
 
       static bool IsAvailable(Pinetime::Controllers::FS& /*filesystem*/) {
@@ -172,9 +172,9 @@ void WatchFaceDigital::Refresh() {
     lv_obj_realign(stepIcon);
   }
 
-  currentWeather = weatherService.Current();
-  if (currentWeather.IsUpdated()) {
-    auto optCurrentWeather = currentWeather.Get();
+  weatherChangeCounter = weatherService.ChangeCounter();
+  if (weatherChangeCounter.IsUpdated()) {
+    const auto& optCurrentWeather = weatherService.Current();
     if (optCurrentWeather) {
       int16_t temp = optCurrentWeather->temperature.Celsius();
       char tempUnit = 'C';
@@ -539,9 +539,9 @@ void WatchFacePineTimeStyle::Refresh() {
     }
   }
 
-  currentWeather = weatherService.Current();
-  if (currentWeather.IsUpdated()) {
-    auto optCurrentWeather = currentWeather.Get();
+  weatherChangeCounter = weatherService.ChangeCounter();
+  if (weatherChangeCounter.IsUpdated()) {
+    const auto& optCurrentWeather = weatherService.Current();
     if (optCurrentWeather) {
       int16_t temp = optCurrentWeather->temperature.Celsius();
       if (settingsController.GetWeatherFormat() == Controllers::Settings::WeatherFormat::Imperial) {
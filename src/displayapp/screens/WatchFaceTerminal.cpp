@@ -150,9 +150,9 @@ void WatchFaceTerminal::Refresh() {
     }
   }
 
-  currentWeather = weatherService.Current();
-  if (currentWeather.IsUpdated()) {
-    auto optCurrentWeather = currentWeather.Get();
+  weatherChangeCounter = weatherService.ChangeCounter();
+  if (weatherChangeCounter.IsUpdated()) {
+    const auto& optCurrentWeather = weatherService.Current();
     if (optCurrentWeather) {
       int16_t temp = optCurrentWeather->temperature.Celsius();
       char tempUnit = 'C';
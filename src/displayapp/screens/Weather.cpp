@@ -1,5 +1,6 @@
 #include "displayapp/screens/Weather.h"
 
+#include <algorithm>
 #include <lvgl/lvgl.h>
 
 #include "components/ble/SimpleWeatherService.h"
@@ -93,6 +94,29 @@ Weather::Weather(Controllers::Settings& settingsController, Controllers::SimpleW
     lv_table_set_cell_align(forecast, 3, i, LV_LABEL_ALIGN_CENTER);
   }
 
+  hourlyTitle = lv_label_create(lv_scr_act(), nullptr);
+  lv_obj_set_style_local_text_color(hourlyTitle, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, Colors::lightGray);
+  lv_label_set_text_static(hourlyTitle, "No hourly forecast");
+  lv_obj_align(hourlyTitle, nullptr, LV_ALIGN_IN_TOP_MID, 0, 10);
+  lv_obj_set_auto_realign(hourlyTitle, true);
+
+  hourlyChart = lv_chart_create(lv_scr_act(), nullptr);
+  lv_obj_set_size(hourlyChart, 220, 160);
+  lv_obj_align(hourlyChart, nullptr, LV_ALIGN_CENTER, 0, 0);
+  lv_chart_set_type(hourlyChart, LV_CHART_TYPE_LINE);
+  lv_chart_set_div_line_count(hourlyChart, 0, 0);
+  lv_obj_set_style_local_size(hourlyChart, LV_CHART_PART_SERIES, LV_STATE_DEFAULT, 0);
+  hourlySeries = lv_chart_add_series(hourlyChart, Colors::orange);
+
+  hourlyRange = lv_label_create(lv_scr_act(), nullptr);
+  lv_obj_set_style_local_text_color(hourlyRange, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, Colors::lightGray);
+  lv_label_set_text_static(hourlyRange, "");
+  lv_obj_align(hourlyRange, nullptr, LV_ALIGN_IN_BOTTOM_MID, 0, -10);
+  lv_obj_set_auto_realign(hourlyRange, true);
+
+  ShowHourlyForecast(false);
+  pageIndicator.Create();
+
   taskRefresh = lv_task_create(RefreshTaskCallback, 1000, LV_TASK_PRIO_MID, this);
   Refresh();
 }
@@ -103,9 +127,10 @@ Weather::~Weather() {
 }
 
 void Weather::Refresh() {
-  currentWeather = weatherService.Current();
-  if (currentWeather.IsUpdated()) {
-    auto optCurrentWeather = currentWeather.Get();
+  weatherChangeCounter = weatherService.ChangeCounter();
+  const bool weatherUpdated = weatherChangeCounter.IsUpdated();
+  if (weatherUpdated) {
+    const auto& optCurrentWeather = weatherService.Current();
     if (optCurrentWeather) {
       int16_t temp = optCurrentWeather->temperature.Celsius();
       int16_t minTemp = optCurrentWeather->minTemperature.Celsius();
@@ -133,9 +158,8 @@ void Weather::Refresh() {
     }
   }
 
-  currentForecast = weatherService.GetForecast();
-  if (currentForecast.IsUpdated()) {
-    auto optCurrentForecast = currentForecast.Get();
+  if (weatherUpdated) {
+    const auto& optCurrentForecast = weatherService.GetForecast();
     if (optCurrentForecast) {
       std::tm localTime = *std::localtime(reinterpret_cast<const time_t*>(&optCurrentForecast->timestamp));
 
@@ -180,4 +204,74 @@ void Weather::Refresh() {
       }
     }
   }
+
+  if (weatherUpdated) {
+    RefreshHourlyForecast();
+  }
+}
+
+void Weather::RefreshHourlyForecast() {
+  const auto& optHourlyForecast = weatherService.GetHourlyForecast();
+  if (!optHourlyForecast) {
+    lv_label_set_text_static(hourlyTitle, "No hourly forecast");
+    lv_label_set_text_static(hourlyRange, "");
+    lv_chart_set_point_count(hourlyChart, 0);
+    lv_chart_refresh(hourlyChart);
+    return;
+  }
+
+  const bool imperial = settingsController.GetWeatherFormat() == Controllers::Settings::WeatherFormat::Imperial;
+  auto temperatureAt = [&](uint8_t hour) {
+    auto temp = optHourlyForecast->TemperatureAt(hour);
+    return imperial ? temp.Fahrenheit() : temp.Celsius();
+  };
+
+  int16_t minTemp = temperatureAt(0);
+  int16_t maxTemp = minTemp;
+  for (uint8_t i = 1; i < optHourlyForecast->nbHours; i++) {
+    minTemp = std::min(minTemp, temperatureAt(i));
+    maxTemp = std::max(maxTemp, temperatureAt(i));
+  }
+
+  // The chart shifts the points in, so the first hour ends up on the left
+  lv_chart_set_point_count(hourlyChart, optHourlyForecast->nbHours);
+  lv_chart_set_range(hourlyChart, minTemp - 1, maxTemp + 1);
+  for (uint8_t i = 0; i < optHourlyForecast->nbHours; i++) {
+    lv_chart_set_next(hourlyChart, hourlySeries, temperatureAt(i));
+  }
+  lv_chart_refresh(hourlyChart);
+
+  std::tm localTime = *std::localtime(reinterpret_cast<const time_t*>(&optHourlyForecast->timestamp));
+  lv_label_set_text_fmt(hourlyTitle, "%02d:00 +%dh", localTime.tm_hour, optHourlyForecast->nbHours);
+  lv_label_set_text_fmt(hourlyRange, "min %d° max %d°%c", minTemp, maxTemp, imperial ? 'F' : 'C');
+}
+
+void Weather::ShowHourlyForecast(bool show) {
+  lv_obj_set_hidden(icon, show);
+  lv_obj_set_hidden(condition, show);
+  lv_obj_set_hidden(temperature, show);
+  lv_obj_set_hidden(minTemperature, show);
+  lv_obj_set_hidden(maxTemperature, show);
+  lv_obj_set_hidden(forecast, show);
+  lv_obj_set_hidden(hourlyTitle, !show);
+  lv_obj_set_hidden(hourlyChart, !show);
+  lv_obj_set_hidden(hourlyRange, !show);
+}
+
+bool Weather::OnTouchEvent(Pinetime::Applications::TouchEvents event) {
+  switch (event) {
+    case TouchEvents::SwipeUp:
+      ShowHourlyForecast(true);
+      pageIndicator.SetPageIndicatorPosition(1);
+      return true;
+    case TouchEvents::SwipeDown:
+      if (lv_obj_get_hidden(forecast)) {
+        ShowHourlyForecast(false);
+        pageIndicator.SetPageIndicatorPosition(0);
+        return true;
+      }
+      return false;
+    default:
+      return false;
+  }
 }
@@ -6,6 +6,7 @@
 #include "components/ble/SimpleWeatherService.h"
 #include "displayapp/apps/Apps.h"
 #include "displayapp/Controllers.h"
+#include "displayapp/widgets/PageIndicator.h"
 #include "Symbols.h"
 #include "utility/DirtyValue.h"
 
@@ -25,12 +26,16 @@ namespace Pinetime {
 
         void Refresh() override;
 
+        bool OnTouchEvent(TouchEvents event) override;
+
       private:
+        void ShowHourlyForecast(bool show);
+        void RefreshHourlyForecast();
+
         Controllers::Settings& settingsController;
         Controllers::SimpleWeatherService& weatherService;
 
-        Utility::DirtyValue<std::optional<Controllers::SimpleWeatherService::CurrentWeather>> currentWeather {};
-        Utility::DirtyValue<std::optional<Controllers::SimpleWeatherService::Forecast>> currentForecast {};
+        Utility::DirtyValue<uint32_t> weatherChangeCounter {};
 
         lv_obj_t* icon;
         lv_obj_t* condition;
@@ -39,6 +44,13 @@ namespace Pinetime {
         lv_obj_t* maxTemperature;
         lv_obj_t* forecast;
 
+        // Second page : temperature of the next hours
+        lv_obj_t* hourlyChart;
+        lv_chart_series_t* hourlySeries;
+        lv_obj_t* hourlyTitle;
+        lv_obj_t* hourlyRange;
+        Widgets::PageIndicator pageIndicator = Widgets::PageIndicator(0, 2);
+
         lv_task_t* taskRefresh;
       };
     }
@@ -3,6 +3,7 @@
 #include <libraries/log/nrf_log.h>
 #include "drivers/TwiMaster.h"
 #include <drivers/Bma421_C/bma423.h>
+#include <algorithm>
 
 using namespace Pinetime::Drivers;
 
@@ -41,7 +42,9 @@ Bma421::Bma421(TwiMaster& twiMaster, uint8_t twiAddress) : twiMaster {twiMaster}
   bma.variant = BMA42X_VARIANT;
   bma.intf_ptr = this;
   bma.delay_us = user_delay;
-  bma.read_write_len = 16;
+  // Must divide the size of the config file (6144 bytes), and not exceed the size of the feature config (70 bytes) :
+  // bma423_write_config_file() rejects longer transfers
+  bma.read_write_len = 64;
 }
 
 void Bma421::Init() {
@@ -84,6 +87,7 @@ void Bma421::Init() {
   if (ret != BMA4_OK)
     return;
 
+  static_assert(samplingRate == 100);
   accel_conf.odr = BMA4_OUTPUT_DATA_RATE_100HZ;
   accel_conf.range = BMA4_ACCEL_RANGE_2G;
   accel_conf.bandwidth = BMA4_ACCEL_NORMAL_AVG4;
@@ -92,6 +96,42 @@ void Bma421::Init() {
   if (ret != BMA4_OK)
     return;
 
+  // Buffer the samples in the FIFO (headerless, 6 bytes per sample), and raise INT1 when the watermark is reached
+  ret = bma4_set_fifo_config(BMA4_FIFO_HEADER, BMA4_DISABLE, &bma);
+  if (ret != BMA4_OK)
+    return;
+
+  ret = bma4_set_fifo_config(BMA4_FIFO_ACCEL, BMA4_ENABLE, &bma);
+  if (ret != BMA4_OK)
+    return;
+
+  ret = bma4_set_fifo_wm(fifoWatermark * BMA4_FIFO_A_LENGTH, &bma);
+  if (ret != BMA4_OK)
+    return;
+
+  struct bma4_int_pin_config pinConfig;
+  pinConfig.edge_ctrl = BMA4_LEVEL_TRIGGER;
+  pinConfig.lvl = BMA4_ACTIVE_HIGH;
+  pinConfig.od = BMA4_PUSH_PULL;
+  pinConfig.output_en = BMA4_OUTPUT_ENABLE;
+  pinConfig.input_en = BMA4_INPUT_DISABLE;
+  ret = bma4_set_int_pin_config(&pinConfig, BMA4_INTR1_MAP, &bma);
+  if (ret != BMA4_OK)
+    return;
+
+  ret = bma4_map_interrupt(BMA4_INTR1_MAP, BMA4_FIFO_WM_INT, BMA4_ENABLE, &bma);
+  if (ret != BMA4_OK)
+    return;
+
+  // Triggers on slow movements too (raising the wrist), the gesture is then confirmed from the samples
+  struct bma423_any_no_mot_config anyMotion;
+  anyMotion.threshold = anyMotionThreshold;
+  anyMotion.duration = anyMotionDuration;
+  anyMotion.axes_en = BMA423_EN_ALL_AXIS;
+  ret = bma423_set_any_mot_config(&anyMotion, &bma);
+  if (ret != BMA4_OK)
+    return;
+
   isOk = true;
 }
 
@@ -108,26 +148,78 @@ void Bma421::Write(uint8_t registerAddress, const uint8_t* data, size_t size) {
   twiMaster.Write(deviceAddress, registerAddress, data, size);
 }
 
-Bma421::Values Bma421::Process() {
+size_t Bma421::NbSamples() {
   if (not isOk)
-    return {};
-  struct bma4_accel rawData;
-  struct bma4_accel data;
-  bma4_read_accel_xyz(&rawData, &bma);
-
-  // Scale the measured ADC counts to units of 'binary milli-g'
-  // where 1g = 1024 'binary milli-g' units.
-  // See https://github.com/InfiniTimeOrg/InfiniTime/pull/1950 for
-  // discussion of why we opted for scaling to 1024 rather than 1000.
-  data.x = 1024 * rawData.x / accelScaleFactors[accel_conf.range];
-  data.y = 1024 * rawData.y / accelScaleFactors[accel_conf.range];
-  data.z = 1024 * rawData.z / accelScaleFactors[accel_conf.range];
+    return 0;
+  uint16_t length = 0;
+  if (bma4_get_fifo_length(&length, &bma) != BMA4_OK)
+    return 0;
+  return length / BMA4_FIFO_A_LENGTH;
+}
 
+size_t Bma421::ReadSamples(Sample* samples, size_t maxSamples) {
+  if (not isOk)
+    return 0;
+
+  // The FIFO is read in a single burst, which must not split a frame. The caller must not request more samples than
+  // NbSamples(), the FIFO returns invalid frames when it is empty.
+  size_t nbSamples = std::min(maxSamples, maxSamplesPerRead);
+  Read(BMA4_FIFO_DATA_ADDR, fifoData, nbSamples * BMA4_FIFO_A_LENGTH);
+
+  // The headerless frames are decoded here : bma4_extract_accel() drops the rest of the burst after a frame starting
+  // with 0x80 0x00, which is also a valid sample (x = 8 counts). Only a frame made of this pattern was read past the end.
+  size_t nbRead = 0;
+  for (size_t i = 0; i < nbSamples; i++) {
+    const uint8_t* frame = &fifoData[i * BMA4_FIFO_A_LENGTH];
+    int16_t counts[3];
+    bool overRead = true;
+    for (size_t axis = 0; axis < 3; axis++) {
+      uint8_t lsb = frame[2 * axis];
+      uint8_t msb = frame[2 * axis + 1];
+      overRead = overRead && lsb == BMA4_FIFO_MSB_CONFIG_CHECK && msb == BMA4_FIFO_LSB_CONFIG_CHECK;
+      // Left-justified in 16 bits
+      counts[axis] = static_cast<int16_t>(static_cast<int16_t>((msb << 8) | lsb) / (1 << (16 - bma.resolution)));
+    }
+    if (overRead)
+      break;
+
+    // Scale the measured ADC counts to units of 'binary milli-g'
+    // where 1g = 1024 'binary milli-g' units.
+    // See https://github.com/InfiniTimeOrg/InfiniTime/pull/1950 for
+    // discussion of why we opted for scaling to 1024 rather than 1000.
+    int16_t x = 1024 * counts[0] / accelScaleFactors[accel_conf.range];
+    int16_t y = 1024 * counts[1] / accelScaleFactors[accel_conf.range];
+    int16_t z = 1024 * counts[2] / accelScaleFactors[accel_conf.range];
+
+    // X and Y axis are swapped because of the way the sensor is mounted in the PineTime
+    samples[nbRead++] = {y, x, z};
+  }
+  return nbRead;
+}
+
+void Bma421::ClearInterrupts() {
+  if (not isOk)
+    return;
+  // Reading INT_STATUS_0 (features) and INT_STATUS_1 (FIFO) clears them in latch mode
+  uint16_t status;
+  bma423_read_int_status(&status, &bma);
+}
+
+void Bma421::SelectInterrupt(Interrupts interrupt) {
+  if (not isOk)
+    return;
+  bool anyMotion = interrupt == Interrupts::AnyMotion;
+  bma423_map_interrupt(BMA4_INTR1_MAP, BMA4_FIFO_WM_INT, anyMotion ? BMA4_DISABLE : BMA4_ENABLE, &bma);
+  bma423_map_interrupt(BMA4_INTR1_MAP, BMA423_ANY_MOT_INT, anyMotion ? BMA4_ENABLE : BMA4_DISABLE, &bma);
+  ClearInterrupts();
+}
+
+uint32_t Bma421::NbSteps() {
+  if (not isOk)
+    return 0;
   uint32_t steps = 0;
   bma423_step_counter_output(&steps, &bma);
-
-  // X and Y axis are swapped because of the way the sensor is mounted in the PineTime
-  return {steps, data.y, data.x, data.z};
+  return steps;
 }
 
 bool Bma421::IsOk() const {
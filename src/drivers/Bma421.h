@@ -1,5 +1,6 @@
 #pragma once
 #include <drivers/Bma421_C/bma4_defs.h>
+#include <cstddef>
 
 namespace Pinetime {
   namespace Drivers {
@@ -8,14 +9,22 @@ namespace Pinetime {
     class Bma421 {
     public:
       enum class DeviceTypes : uint8_t { Unknown, BMA421, BMA425 };
+      // Interrupt routed to INT1 : the FIFO reached its watermark, or the sensor started moving
+      enum class Interrupts : uint8_t { FifoWatermark, AnyMotion };
 
-      struct Values {
-        uint32_t steps;
+      // Acceleration in units of 'binary milli-g' (1g = 1024)
+      struct Sample {
         int16_t x;
         int16_t y;
         int16_t z;
       };
 
+      static constexpr uint32_t samplingRate = 100; // Hz
+      // The FIFO watermark interrupt is raised on INT1 when this many samples are buffered
+      static constexpr uint16_t fifoWatermark = 25;
+      // Maximum number of samples read from the FIFO at once
+      static constexpr size_t maxSamplesPerRead = 16;
+
       Bma421(TwiMaster& twiMaster, uint8_t twiAddress);
       Bma421(const Bma421&) = delete;
       Bma421& operator=(const Bma421&) = delete;
@@ -26,7 +35,15 @@ namespace Pinetime {
       /// Init() method to allow the caller to uninit and then reinit the TWI device after the softreset.
       void SoftReset();
       void Init();
-      Values Process();
+      // Number of samples buffered in the FIFO
+      size_t NbSamples();
+      // Reads at most maxSamplesPerRead samples from the FIFO, the oldest first. Returns the number of samples read.
+      size_t ReadSamples(Sample* samples, size_t maxSamples);
+      // Clears the latched interrupts, so that INT1 can be raised again
+      void ClearInterrupts();
+      // The FIFO keeps recording the last samples when the watermark interrupt is disabled
+      void SelectInterrupt(Interrupts interrupt);
+      uint32_t NbSteps();
       void ResetStepCounter();
 
       void Read(uint8_t registerAddress, uint8_t* buffer, size_t size);
@@ -45,6 +62,10 @@ namespace Pinetime {
       bool isOk = false;
       bool isResetOk = false;
       DeviceTypes deviceType = DeviceTypes::Unknown;
+      // Slope between 2 samples at 50Hz, in 5.11g format (~39mg), during 2 samples (40ms)
+      static constexpr uint16_t anyMotionThreshold = 0x50;
+      static constexpr uint16_t anyMotionDuration = 2;
+      uint8_t fifoData[maxSamplesPerRead * BMA4_FIFO_A_LENGTH];
     };
   }
 }
\ No newline at end of file
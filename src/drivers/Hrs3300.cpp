@@ -16,7 +16,20 @@
 using namespace Pinetime::Drivers;
 
 namespace {
-  static constexpr uint8_t ledDriveCurrentValue = 0x2f;
+  // Current 12.5mA, 15-bit resolution, gain 1x, 50ms wait time between ADC conversion period
+  constexpr Hrs3300::Config defaultConfig {0, 15, 0, 5};
+
+  constexpr uint8_t enableHwtPos = 4;
+  constexpr uint8_t enablePdrive1Pos = 3;
+  // PON and low nibble 0xF.
+  // Note: Setting low nibble to 0x8 per the datasheet results in
+  // modulated LED driver output. Setting to 0xF results in clean,
+  // steady output during the ADC conversion period.
+  constexpr uint8_t pDriverValue = 0x2f;
+  constexpr uint8_t pDriverPdrive0Pos = 6;
+  constexpr uint8_t resolutionRegisterValue = 0x70;
+  constexpr uint8_t minResolution = 8;
+  constexpr uint8_t gainPos = 2;
 }
 
 /** Driver for the HRS3300 heart rate sensor.
@@ -33,39 +46,48 @@ void Hrs3300::Init() {
   Disable();
   vTaskDelay(100);
 
-  // HRS disabled, 50ms wait time between ADC conversion period, current 12.5mA
-  WriteRegister(static_cast<uint8_t>(Registers::Enable), 0x50);
-
-  // Current 12.5mA and low nibble 0xF.
-  // Note: Setting low nibble to 0x8 per the datasheet results in
-  // modulated LED driver output. Setting to 0xF results in clean,
-  // steady output during the ADC conversion period.
-  WriteRegister(static_cast<uint8_t>(Registers::PDriver), ledDriveCurrentValue);
-
-  // HRS and ALS both in 15-bit mode results in ~50ms LED drive period
-  // and presumably ~50ms ADC conversion period.
-  WriteRegister(static_cast<uint8_t>(Registers::Res), 0x77);
-
-  // Gain set to 1x
-  WriteRegister(static_cast<uint8_t>(Registers::Hgain), 0x00);
+  Configure(defaultConfig);
 }
 
 void Hrs3300::Enable() {
   NRF_LOG_INFO("ENABLE");
-  auto value = ReadRegister(static_cast<uint8_t>(Registers::Enable));
-  value |= 0x80;
-  WriteRegister(static_cast<uint8_t>(Registers::Enable), value);
-
-  WriteRegister(static_cast<uint8_t>(Registers::PDriver), ledDriveCurrentValue);
+  enabled = true;
+  WriteEnableRegister();
+  WritePDriverRegister();
 }
 
 void Hrs3300::Disable() {
   NRF_LOG_INFO("DISABLE");
-  auto value = ReadRegister(static_cast<uint8_t>(Registers::Enable));
-  value &= ~0x80;
+  enabled = false;
+  WriteEnableRegister();
+  WritePDriverRegister();
+}
+
+void Hrs3300::Configure(const Config& newConfig) {
+  config = newConfig;
+  // The LED drive current is split between ENABLE (PDRIVE[1]) and PDRIVER (PDRIVE[0])
+  WriteEnableRegister();
+  WritePDriverRegister();
+
+  // The resolution (config.resolution - 8 in the low nibble) applies to both HRS and ALS. 15 bits results in ~50ms
+  // LED drive period and presumably ~50ms ADC conversion period, each bit less halves it (14 bits : ~25ms).
+  WriteRegister(static_cast<uint8_t>(Registers::Res), resolutionRegisterValue | (config.resolution - minResolution));
+
+  WriteRegister(static_cast<uint8_t>(Registers::Hgain), config.gain << gainPos);
+}
+
+void Hrs3300::WriteEnableRegister() {
+  uint8_t value = (config.waitTime << enableHwtPos) | (((config.ledDriveCurrent >> 1) & 0x01) << enablePdrive1Pos);
+  if (enabled) {
+    value |= static_cast<uint8_t>(Registers::EnableHen);
+  }
   WriteRegister(static_cast<uint8_t>(Registers::Enable), value);
+}
 
-  WriteRegister(static_cast<uint8_t>(Registers::PDriver), 0);
+void Hrs3300::WritePDriverRegister() {
+  // The LED is switched off when the sensor is disabled
+  uint8_t value = enabled ? (pDriverValue | ((config.ledDriveCurrent & 0x01) << pDriverPdrive0Pos)) : 0;
+  WriteRegister(static_cast<uint8_t>(Registers::PDriver), value);
 }
 
 Hrs3300::PackedHrsAls Hrs3300::ReadHrsAls() {
@@ -26,6 +26,14 @@ namespace Pinetime {
         uint16_t als;
       };
 
+      // Settings of the measurement (see the datasheet for the values of the fields)
+      struct Config {
+        uint8_t ledDriveCurrent; // PDRIVE : 0 (12.5mA), 1 (20mA), 2 (30mA) or 3 (40mA)
+        uint8_t resolution;      // Resolution of the HRS ADC, in bits (8 to 16)
+        uint8_t gain;            // HGAIN : 0 (1x), 1 (2x), 2 (4x), 3 (8x) or 4 (64x)
+        uint8_t waitTime;        // HWT, wait time between the conversions : 3 (100ms), 4 (75ms), 5 (50ms)...
+      };
+
       Hrs3300(TwiMaster& twiMaster, uint8_t twiAddress);
       Hrs3300(const Hrs3300&) = delete;
       Hrs3300& operator=(const Hrs3300&) = delete;
@@ -35,11 +43,22 @@ namespace Pinetime {
       void Init();
       void Enable();
       void Disable();
+      // Can be called while the sensor is enabled, the new settings apply to the next conversion
+      void Configure(const Config& newConfig);
       PackedHrsAls ReadHrsAls();
 
+      const Config& Configuration() const {
+        return config;
+      }
+
     private:
       TwiMaster& twiMaster;
       uint8_t twiAddress;
+      Config config;
+      bool enabled = false;
+
+      void WriteEnableRegister();
+      void WritePDriverRegister();
 
       void WriteRegister(uint8_t reg, uint8_t data);
       uint8_t ReadRegister(uint8_t reg);
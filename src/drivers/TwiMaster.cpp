@@ -1,13 +1,12 @@
 #include "drivers/TwiMaster.h"
 #include <cstring>
 #include <hal/nrf_gpio.h>
+#include <nrf_assert.h>
 #include <nrfx_log.h>
+#include <task.h>
 
 using namespace Pinetime::Drivers;
 
-// TODO use shortcut to automatically send STOP when receive LastTX, for example
-// TODO use DMA/IRQ
-
 TwiMaster::TwiMaster(NRF_TWIM_Type* module, uint32_t frequency, uint8_t pinSda, uint8_t pinScl)
   : module {module}, frequency {frequency}, pinSda {pinSda}, pinScl {pinScl} {
 }
@@ -26,6 +25,9 @@ void TwiMaster::Init() {
   if (mutex == nullptr) {
     mutex = xSemaphoreCreateBinary();
   }
+  if (transactionDone == nullptr) {
+    transactionDone = xSemaphoreCreateBinary();
+  }
 
   ConfigurePins();
 
@@ -42,117 +44,164 @@ void TwiMaster::Init() {
   twiBaseAddress->EVENTS_RXSTARTED = 0;
   twiBaseAddress->EVENTS_SUSPENDED = 0;
   twiBaseAddress->EVENTS_TXSTARTED = 0;
+  twiBaseAddress->SHORTS = 0;
+  twiBaseAddress->INTENCLR = 0xFFFFFFFF;
 
-  twiBaseAddress->ENABLE = (TWIM_ENABLE_ENABLE_Enabled << TWIM_ENABLE_ENABLE_Pos);
+  // The peripheral is enabled when a transaction is started
+  twiBaseAddress->ENABLE = (TWIM_ENABLE_ENABLE_Disabled << TWIM_ENABLE_ENABLE_Pos);
+
+  NRFX_IRQ_PRIORITY_SET(SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn, 2);
+  NRFX_IRQ_ENABLE(SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn);
 
   xSemaphoreGive(mutex);
 }
 
 TwiMaster::ErrorCodes TwiMaster::Read(uint8_t deviceAddress, uint8_t registerAddress, uint8_t* data, size_t size) {
+  ASSERT(size <= maxReadSize);
   xSemaphoreTake(mutex, portMAX_DELAY);
-  Wakeup();
-  auto ret = Write(deviceAddress, &registerAddress, 1, false);
-  ret = Read(deviceAddress, data, size, true);
-  Sleep();
+  auto ret = Transfer({deviceAddress, registerAddress, true, data, nullptr, size, OnSynchronousTransactionDone, this});
   xSemaphoreGive(mutex);
   return ret;
 }
 
 TwiMaster::ErrorCodes TwiMaster::Write(uint8_t deviceAddress, uint8_t registerAddress, const uint8_t* data, size_t size) {
-  ASSERT(size <= maxDataSize);
+  ASSERT(size <= maxWriteSize);
   xSemaphoreTake(mutex, portMAX_DELAY);
-  Wakeup();
-  internalBuffer[0] = registerAddress;
-  std::memcpy(internalBuffer + 1, data, size);
-  auto ret = Write(deviceAddress, internalBuffer, size + 1, true);
-  Sleep();
+  auto ret = Transfer({deviceAddress, registerAddress, false, nullptr, data, size, OnSynchronousTransactionDone, this});
   xSemaphoreGive(mutex);
   return ret;
 }
 
-TwiMaster::ErrorCodes TwiMaster::Read(uint8_t deviceAddress, uint8_t* buffer, size_t size, bool stop) {
-  twiBaseAddress->ADDRESS = deviceAddress;
-  twiBaseAddress->TASKS_RESUME = 0x1UL;
-  twiBaseAddress->RXD.PTR = (uint32_t) buffer;
-  twiBaseAddress->RXD.MAXCNT = size;
-
-  twiBaseAddress->TASKS_STARTRX = 1;
+bool TwiMaster::ReadAsync(uint8_t deviceAddress, uint8_t registerAddress, uint8_t* buffer, size_t size, Callback callback, void* context) {
+  ASSERT(size <= maxReadSize);
+  return Enqueue({deviceAddress, registerAddress, true, buffer, nullptr, size, callback, context});
+}
 
-  while (!twiBaseAddress->EVENTS_RXSTARTED && !twiBaseAddress->EVENTS_ERROR)
-    ;
-  twiBaseAddress->EVENTS_RXSTARTED = 0x0UL;
+bool TwiMaster::WriteAsync(uint8_t deviceAddress,
+                           uint8_t registerAddress,
+                           const uint8_t* data,
+                           size_t size,
+                           Callback callback,
+                           void* context) {
+  ASSERT(size <= maxWriteSize);
+  return Enqueue({deviceAddress, registerAddress, false, nullptr, data, size, callback, context});
+}
 
-  txStartedCycleCount = DWT->CYCCNT;
-  uint32_t currentCycleCount;
-  while (!twiBaseAddress->EVENTS_LASTRX && !twiBaseAddress->EVENTS_ERROR) {
-    currentCycleCount = DWT->CYCCNT;
-    if ((currentCycleCount - txStartedCycleCount) > HwFreezedDelay) {
-      FixHwFreezed();
-      return ErrorCodes::TransactionFailed;
-    }
+TwiMaster::ErrorCodes TwiMaster::Transfer(const Transaction& transaction) {
+  // The queue can be full of asynchronous transactions
+  while (!Enqueue(transaction)) {
+    vTaskDelay(1);
   }
-  twiBaseAddress->EVENTS_LASTRX = 0x0UL;
 
-  if (stop || twiBaseAddress->EVENTS_ERROR) {
-    twiBaseAddress->TASKS_STOP = 0x1UL;
-    while (!twiBaseAddress->EVENTS_STOPPED)
-      ;
-    twiBaseAddress->EVENTS_STOPPED = 0x0UL;
-  } else {
-    twiBaseAddress->TASKS_SUSPEND = 0x1UL;
-    while (!twiBaseAddress->EVENTS_SUSPENDED)
-      ;
-    twiBaseAddress->EVENTS_SUSPENDED = 0x0UL;
+  // The task sleeps until the interrupt handler completes the transaction. The transactions queued before this one
+  // are executed first, any of them can freeze the peripheral.
+  while (xSemaphoreTake(transactionDone, HwFreezedDelay) != pdTRUE) {
+    RecoverIfFreezed();
   }
+  return synchronousResult;
+}
 
-  if (twiBaseAddress->EVENTS_ERROR) {
-    twiBaseAddress->EVENTS_ERROR = 0x0UL;
+void TwiMaster::OnSynchronousTransactionDone(ErrorCodes result, void* context, BaseType_t* higherPriorityTaskWoken) {
+  auto* twiMaster = static_cast<TwiMaster*>(context);
+  twiMaster->synchronousResult = result;
+  xSemaphoreGiveFromISR(twiMaster->transactionDone, higherPriorityTaskWoken);
+}
+
+bool TwiMaster::Enqueue(const Transaction& transaction) {
+  RecoverIfFreezed();
+
+  taskENTER_CRITICAL();
+  if (nbTransactions == maxPendingTransactions) {
+    taskEXIT_CRITICAL();
+    return false;
+  }
+  transactions[(firstTransaction + nbTransactions) % maxPendingTransactions] = transaction;
+  nbTransactions++;
+  if (nbTransactions == 1) {
+    StartTransaction();
   }
-  return ErrorCodes::NoError;
+  taskEXIT_CRITICAL();
+  return true;
 }
 
-TwiMaster::ErrorCodes TwiMaster::Write(uint8_t deviceAddress, const uint8_t* data, size_t size, bool stop) {
-  twiBaseAddress->ADDRESS = deviceAddress;
-  twiBaseAddress->TASKS_RESUME = 0x1UL;
-  twiBaseAddress->TXD.PTR = (uint32_t) data;
-  twiBaseAddress->TXD.MAXCNT = size;
+// Called in a critical section or from the interrupt handler
+void TwiMaster::StartTransaction() {
+  const auto& transaction = transactions[firstTransaction];
+
+  Wakeup();
+  twiBaseAddress->ADDRESS = transaction.deviceAddress;
+  twiBaseAddress->EVENTS_STOPPED = 0;
+  twiBaseAddress->EVENTS_ERROR = 0;
+  twiBaseAddress->ERRORSRC = twiBaseAddress->ERRORSRC;
+
+  internalBuffer[0] = transaction.registerAddress;
+  twiBaseAddress->TXD.PTR = reinterpret_cast<uintptr_t>(internalBuffer);
+  if (transaction.read) {
+    twiBaseAddress->TXD.MAXCNT = registerSize;
+    twiBaseAddress->RXD.PTR = reinterpret_cast<uintptr_t>(transaction.rxBuffer);
+    twiBaseAddress->RXD.MAXCNT = transaction.size;
+    // Repeated start after the register address, and stop after the last byte
+    twiBaseAddress->SHORTS = TWIM_SHORTS_LASTTX_STARTRX_Msk | TWIM_SHORTS_LASTRX_STOP_Msk;
+  } else {
+    // The register address and the data must be sent in the same transfer
+    std::memcpy(internalBuffer + registerSize, transaction.txData, transaction.size);
+    twiBaseAddress->TXD.MAXCNT = transaction.size + registerSize;
+    twiBaseAddress->SHORTS = TWIM_SHORTS_LASTTX_STOP_Msk;
+  }
 
+  transactionError = false;
+  transactionStartTime = xTaskGetTickCountFromISR();
+  twiBaseAddress->INTENSET = TWIM_INTENSET_STOPPED_Msk | TWIM_INTENSET_ERROR_Msk;
+  twiBaseAddress->TASKS_RESUME = 1;
   twiBaseAddress->TASKS_STARTTX = 1;
+}
 
-  while (!twiBaseAddress->EVENTS_TXSTARTED && !twiBaseAddress->EVENTS_ERROR)
-    ;
-  twiBaseAddress->EVENTS_TXSTARTED = 0x0UL;
-
-  txStartedCycleCount = DWT->CYCCNT;
-  uint32_t currentCycleCount;
-  while (!twiBaseAddress->EVENTS_LASTTX && !twiBaseAddress->EVENTS_ERROR) {
-    currentCycleCount = DWT->CYCCNT;
-    if ((currentCycleCount - txStartedCycleCount) > HwFreezedDelay) {
-      FixHwFreezed();
-      return ErrorCodes::TransactionFailed;
-    }
-  }
-  twiBaseAddress->EVENTS_LASTTX = 0x0UL;
+// Called in a critical section or from the interrupt handler
+void TwiMaster::CompleteTransaction(ErrorCodes result, BaseType_t* higherPriorityTaskWoken) {
+  auto transaction = transactions[firstTransaction];
+  firstTransaction = (firstTransaction + 1) % maxPendingTransactions;
+  nbTransactions--;
 
-  if (stop || twiBaseAddress->EVENTS_ERROR) {
-    twiBaseAddress->TASKS_STOP = 0x1UL;
-    while (!twiBaseAddress->EVENTS_STOPPED)
-      ;
-    twiBaseAddress->EVENTS_STOPPED = 0x0UL;
+  // Keep the bus busy before running the callback
+  if (nbTransactions > 0) {
+    StartTransaction();
   } else {
-    twiBaseAddress->TASKS_SUSPEND = 0x1UL;
-    while (!twiBaseAddress->EVENTS_SUSPENDED)
-      ;
-    twiBaseAddress->EVENTS_SUSPENDED = 0x0UL;
+    twiBaseAddress->INTENCLR = TWIM_INTENCLR_STOPPED_Msk | TWIM_INTENCLR_ERROR_Msk;
+    twiBaseAddress->SHORTS = 0;
+    Sleep();
+  }
+
+  if (transaction.callback != nullptr) {
+    transaction.callback(result, transaction.context, higherPriorityTaskWoken);
   }
+}
+
+void TwiMaster::OnInterrupt() {
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
 
   if (twiBaseAddress->EVENTS_ERROR) {
-    twiBaseAddress->EVENTS_ERROR = 0x0UL;
+    twiBaseAddress->EVENTS_ERROR = 0;
+    transactionError = true;
+    // The shortcuts do not apply after an error (NACK, overrun) : the STOP condition must be sent explicitly
+    twiBaseAddress->TASKS_RESUME = 1;
+    twiBaseAddress->TASKS_STOP = 1;
+  }
+
+  if (twiBaseAddress->EVENTS_STOPPED) {
+    twiBaseAddress->EVENTS_STOPPED = 0;
     uint32_t error = twiBaseAddress->ERRORSRC;
     twiBaseAddress->ERRORSRC = error;
+
+    const auto& transaction = transactions[firstTransaction];
+    bool complete = transaction.read ? (twiBaseAddress->RXD.AMOUNT == transaction.size)
+                                     : (twiBaseAddress->TXD.AMOUNT == transaction.size + registerSize);
+    bool failed = transactionError || error != 0 || !complete;
+    if (nbTransactions > 0) {
+      CompleteTransaction(failed ? ErrorCodes::TransactionFailed : ErrorCodes::NoError, &higherPriorityTaskWoken);
+    }
   }
 
-  return ErrorCodes::NoError;
+  portYIELD_FROM_ISR(higherPriorityTaskWoken);
 }
 
 void TwiMaster::Sleep() {
@@ -163,17 +212,38 @@ void TwiMaster::Wakeup() {
   twiBaseAddress->ENABLE = (TWIM_ENABLE_ENABLE_Enabled << TWIM_ENABLE_ENABLE_Pos);
 }
 
-/* Sometimes, the TWIM device just freeze and never set the event EVENTS_LASTTX.
- * This method disable and re-enable the peripheral so that it works again.
+bool TwiMaster::RecoverIfFreezed() {
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  bool freezed = false;
+
+  taskENTER_CRITICAL();
+  if (nbTransactions > 0 && (xTaskGetTickCount() - transactionStartTime) > HwFreezedDelay) {
+    FixHwFreezed(&higherPriorityTaskWoken);
+    freezed = true;
+  }
+  taskEXIT_CRITICAL();
+
+  if (freezed) {
+    NRF_LOG_INFO("I2C device frozen, reinitializing it!");
+  }
+  if (higherPriorityTaskWoken) {
+    taskYIELD();
+  }
+  return freezed;
+}
+
+/* Sometimes, the TWIM device just freeze and never set the event EVENTS_STOPPED.
+ * This method disable and re-enable the peripheral so that it works again, fails the
+ * transaction in progress and starts the next one.
  * This is just a workaround, and it would be better if we could find a way to prevent
  * this issue from happening.
  * */
-void TwiMaster::FixHwFreezed() {
-  NRF_LOG_INFO("I2C device frozen, reinitializing it!");
-
-  uint32_t twi_state = NRF_TWI1->ENABLE;
-
+void TwiMaster::FixHwFreezed(BaseType_t* higherPriorityTaskWoken) {
+  twiBaseAddress->INTENCLR = TWIM_INTENCLR_STOPPED_Msk | TWIM_INTENCLR_ERROR_Msk;
   Sleep();
+  twiBaseAddress->EVENTS_STOPPED = 0;
+  twiBaseAddress->EVENTS_ERROR = 0;
+  twiBaseAddress->ERRORSRC = twiBaseAddress->ERRORSRC;
 
-  twiBaseAddress->ENABLE = twi_state;
+  CompleteTransaction(ErrorCodes::TransactionFailed, higherPriorityTaskWoken);
 }
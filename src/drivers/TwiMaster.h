@@ -2,13 +2,31 @@
 #include <FreeRTOS.h>
 #include <semphr.h>
 #include <drivers/include/nrfx_twi.h> // NRF_TWIM_Type
+#include <array>
+#include <cstddef>
 #include <cstdint>
 
 namespace Pinetime {
   namespace Drivers {
+    /* Driver of the TWIM peripheral, shared by the touch panel, the motion sensor and the heart rate sensor.
+     *
+     * The transactions are executed by EasyDMA: the shortcuts of the peripheral chain the transmission of the register
+     * address, the reception of the data and the STOP condition, and the interrupt handler completes them. They are
+     * queued, so the synchronous API (Read/Write) blocks the calling task until its transaction is done, and the
+     * asynchronous API (ReadAsync/WriteAsync) calls a callback from the interrupt handler instead.
+     *
+     * The peripheral is enabled while the queue is not empty, and disabled when it is drained.
+     */
     class TwiMaster {
     public:
       enum class ErrorCodes { NoError, TransactionFailed };
+      // Called from the interrupt handler (or from the task that recovered a frozen peripheral) : only the FromISR API
+      // of FreeRTOS can be used, and higherPriorityTaskWoken must be passed to them.
+      using Callback = void (*)(ErrorCodes result, void* context, BaseType_t* higherPriorityTaskWoken);
+
+      // EasyDMA transfers are limited to 255 bytes on the nRF52832, including the register address for the writes
+      static constexpr size_t maxReadSize {255};
+      static constexpr size_t maxWriteSize {254};
 
       TwiMaster(NRF_TWIM_Type* module, uint32_t frequency, uint8_t pinSda, uint8_t pinScl);
 
@@ -16,26 +34,62 @@ namespace Pinetime {
       ErrorCodes Read(uint8_t deviceAddress, uint8_t registerAddress, uint8_t* buffer, size_t size);
       ErrorCodes Write(uint8_t deviceAddress, uint8_t registerAddress, const uint8_t* data, size_t size);
 
+      // Must be called from a task. The buffers must stay valid until the callback is called. Return false if the queue is full.
+      bool ReadAsync(uint8_t deviceAddress, uint8_t registerAddress, uint8_t* buffer, size_t size, Callback callback, void* context);
+      bool WriteAsync(uint8_t deviceAddress,
+                      uint8_t registerAddress,
+                      const uint8_t* data,
+                      size_t size,
+                      Callback callback,
+                      void* context);
+
       void Sleep();
       void Wakeup();
 
+      void OnInterrupt();
+
     private:
-      ErrorCodes Read(uint8_t deviceAddress, uint8_t* buffer, size_t size, bool stop);
-      ErrorCodes Write(uint8_t deviceAddress, const uint8_t* data, size_t size, bool stop);
-      void FixHwFreezed();
+      struct Transaction {
+        uint8_t deviceAddress;
+        uint8_t registerAddress;
+        bool read;
+        uint8_t* rxBuffer;
+        const uint8_t* txData;
+        size_t size;
+        Callback callback;
+        void* context;
+      };
+
+      ErrorCodes Transfer(const Transaction& transaction);
+      bool Enqueue(const Transaction& transaction);
+      void StartTransaction();
+      void CompleteTransaction(ErrorCodes result, BaseType_t* higherPriorityTaskWoken);
+      bool RecoverIfFreezed();
+      void FixHwFreezed(BaseType_t* higherPriorityTaskWoken);
       void ConfigurePins() const;
+      static void OnSynchronousTransactionDone(ErrorCodes result, void* context, BaseType_t* higherPriorityTaskWoken);
 
       NRF_TWIM_Type* twiBaseAddress;
       SemaphoreHandle_t mutex = nullptr;
+      SemaphoreHandle_t transactionDone = nullptr;
+      ErrorCodes synchronousResult = ErrorCodes::NoError;
       NRF_TWIM_Type* module;
       uint32_t frequency;
       uint8_t pinSda;
       uint8_t pinScl;
-      static constexpr uint8_t maxDataSize {16};
+
+      static constexpr size_t maxPendingTransactions {4};
+      std::array<Transaction, maxPendingTransactions> transactions;
+      // Accessed from the interrupt handler, or in a critical section
+      size_t firstTransaction = 0;
+      size_t nbTransactions = 0;
+      bool transactionError = false;
+      TickType_t transactionStartTime = 0;
+
       static constexpr uint8_t registerSize {1};
-      uint8_t internalBuffer[maxDataSize + registerSize];
-      uint32_t txStartedCycleCount = 0;
-      static constexpr uint32_t HwFreezedDelay {161000};
+      uint8_t internalBuffer[maxWriteSize + registerSize];
+      // Longer than the longest transaction (~7ms at 400kHz), clock stretching included
+      static constexpr TickType_t HwFreezedDelay {pdMS_TO_TICKS(20)};
     };
   }
 }
@@ -1,6 +1,8 @@
 #include "heartratetask/HeartRateTask.h"
 #include <drivers/Hrs3300.h>
 #include <components/heartrate/HeartRateController.h>
+#include <components/motion/MotionController.h>
+#include <algorithm>
 #include <limits>
 
 #include "utility/Math.h"
@@ -31,21 +33,21 @@ TickType_t HeartRateTask::CurrentTaskDelay() {
   auto backgroundPeriod = BackgroundMeasurementInterval();
   TickType_t currentTime = xTaskGetTickCount();
   auto CalculateSleepTicks = [&]() {
-    TickType_t elapsed = currentTime - measurementStartTime;
+    TickType_t elapsed = currentTime - samplingStartTime;
 
     // Target system tick is the elapsed sensor ticks multiplied by the sensor tick duration (i.e. the elapsed time)
     // multiplied by the system tick rate
     // Since the sensor tick duration is a whole number of milliseconds, we compute in milliseconds and then divide by 1000
     // To avoid the number of milliseconds overflowing a u32, we take a factor of 2 out of the divisor and dividend
-    // (1024 / 2) * 65536 * 100 = 3355443200 which is less than 2^32
+    // (1024 / 2) * 65536 * 125 = 4194304000 which is less than 2^32
 
     // Guard against future tick rate changes
     static_assert((configTICK_RATE_HZ / 2ULL) * (std::numeric_limits<decltype(count)>::max() + 1ULL) *
-                      static_cast<uint64_t>((Pinetime::Controllers::Ppg::deltaTms)) <
+                      static_cast<uint64_t>((Pinetime::Controllers::Ppg::longSamplePeriod)) <
                     std::numeric_limits<uint32_t>::max(),
                   "Overflow");
     TickType_t elapsedTarget = Utility::RoundedDiv(static_cast<uint32_t>(configTICK_RATE_HZ / 2) * (static_cast<uint32_t>(count) + 1U) *
-                                                     static_cast<uint32_t>((Pinetime::Controllers::Ppg::deltaTms)),
+                                                     static_cast<uint32_t>(sensorControl.SamplePeriod()),
                                                    static_cast<uint32_t>(1000 / 2));
 
     // On count overflow, reset both count and start time
@@ -54,7 +56,7 @@ TickType_t HeartRateTask::CurrentTaskDelay() {
     // So no need to check for tick count overflow
     if (count == std::numeric_limits<decltype(count)>::max()) {
       count = 0;
-      measurementStartTime = currentTime;
+      samplingStartTime = currentTime;
     }
     if (elapsedTarget > elapsed) {
       return elapsedTarget - elapsed;
@@ -86,13 +88,18 @@ TickType_t HeartRateTask::CurrentTaskDelay() {
 
 HeartRateTask::HeartRateTask(Drivers::Hrs3300& heartRateSensor,
                              Controllers::HeartRateController& controller,
+                             Controllers::MotionController& motionController,
                              Controllers::Settings& settings)
-  : heartRateSensor {heartRateSensor}, controller {controller}, settings {settings} {
+  : heartRateSensor {heartRateSensor}, controller {controller}, motionController {motionController}, settings {settings} {
 }
 
 void HeartRateTask::Start() {
   messageQueue = xQueueCreate(10, 1);
   controller.SetHeartRateTask(this);
+  // measurementStartTime is always initialised before use by StartMeasurement
+  // Need to initialise lastMeasurementTime so that the first background measurement happens at a reasonable time
+  lastMeasurementTime = xTaskGetTickCount();
+  valueCurrentlyShown = false;
 
   if (pdPASS != xTaskCreate(HeartRateTask::Process, "Heartrate", 500, this, 1, &taskHandle)) {
     APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
@@ -105,70 +112,69 @@ void HeartRateTask::Process(void* instance) {
 }
 
 void HeartRateTask::Work() {
-  // measurementStartTime is always initialised before use by StartMeasurement
-  // Need to initialise lastMeasurementTime so that the first background measurement happens at a reasonable time
-  lastMeasurementTime = xTaskGetTickCount();
-  valueCurrentlyShown = false;
-
   while (true) {
-    TickType_t delay = CurrentTaskDelay();
-    Messages msg;
-    States newState = state;
+    HandleNextEvent();
+  }
+}
 
-    if (xQueueReceive(messageQueue, &msg, delay) == pdTRUE) {
-      switch (msg) {
-        case Messages::GoToSleep:
-          // Ignore power state changes when disabled
-          if (state == States::Disabled) {
-            break;
-          }
-          // State is necessarily ForegroundMeasuring
-          // As previously screen was on and measurement is enabled
-          if (BackgroundMeasurementNeeded()) {
-            newState = States::BackgroundMeasuring;
-          } else {
-            newState = States::Waiting;
-          }
-          break;
-        case Messages::WakeUp:
-          // Ignore power state changes when disabled
-          if (state == States::Disabled) {
-            break;
-          }
-          newState = States::ForegroundMeasuring;
-          break;
-        case Messages::Enable:
-          // Can only be enabled when the screen is on
-          // If this constraint is somehow violated, the unexpected state
-          // will self-resolve at the next screen on event
-          newState = States::ForegroundMeasuring;
-          valueCurrentlyShown = false;
+void HeartRateTask::HandleNextEvent() {
+  TickType_t delay = CurrentTaskDelay();
+  Messages msg;
+  States newState = state;
+
+  if (xQueueReceive(messageQueue, &msg, delay) == pdTRUE) {
+    switch (msg) {
+      case Messages::GoToSleep:
+        // Ignore power state changes when disabled
+        if (state == States::Disabled) {
           break;
-        case Messages::Disable:
-          newState = States::Disabled;
+        }
+        // State is necessarily ForegroundMeasuring
+        // As previously screen was on and measurement is enabled
+        if (BackgroundMeasurementNeeded()) {
+          newState = States::BackgroundMeasuring;
+        } else {
+          newState = States::Waiting;
+        }
+        break;
+      case Messages::WakeUp:
+        // Ignore power state changes when disabled
+        if (state == States::Disabled) {
           break;
-      }
-    }
-    if (newState == States::Waiting && BackgroundMeasurementNeeded()) {
-      newState = States::BackgroundMeasuring;
-    } else if (newState == States::BackgroundMeasuring && !BackgroundMeasurementNeeded()) {
-      newState = States::Waiting;
+        }
+        newState = States::ForegroundMeasuring;
+        break;
+      case Messages::Enable:
+        // Can only be enabled when the screen is on
+        // If this constraint is somehow violated, the unexpected state
+        // will self-resolve at the next screen on event
+        newState = States::ForegroundMeasuring;
+        valueCurrentlyShown = false;
+        break;
+      case Messages::Disable:
+        newState = States::Disabled;
+        break;
     }
+  }
+  if (newState == States::Waiting && BackgroundMeasurementNeeded()) {
+    newState = States::BackgroundMeasuring;
+  } else if (newState == States::BackgroundMeasuring && !BackgroundMeasurementNeeded()) {
+    newState = States::Waiting;
+  }
 
-    // Apply state transition (switch sensor on/off)
-    if ((newState == States::ForegroundMeasuring || newState == States::BackgroundMeasuring) &&
-        (state == States::Waiting || state == States::Disabled)) {
-      StartMeasurement();
-    } else if ((newState == States::Waiting || newState == States::Disabled) &&
-               (state == States::ForegroundMeasuring || state == States::BackgroundMeasuring)) {
-      StopMeasurement();
-    }
-    state = newState;
+  // Apply state transition (switch sensor on/off)
+  if ((newState == States::ForegroundMeasuring || newState == States::BackgroundMeasuring) &&
+      (state == States::Waiting || state == States::Disabled)) {
+    StartMeasurement();
+  } else if ((newState == States::Waiting || newState == States::Disabled) &&
+             (state == States::ForegroundMeasuring || state == States::BackgroundMeasuring)) {
+    StopMeasurement();
+  }
+  state = newState;
 
-    if (state == States::ForegroundMeasuring || state == States::BackgroundMeasuring) {
-      HandleSensorData();
-      count++;
-    }
+  if (state == States::ForegroundMeasuring || state == States::BackgroundMeasuring) {
+    HandleSensorData();
+    count++;
   }
 }
 
@@ -179,24 +185,69 @@ void HeartRateTask::PushMessage(HeartRateTask::Messages msg) {
 }
 
 void HeartRateTask::StartMeasurement() {
+  sensorControl.Start();
+  heartRateSensor.Configure(sensorControl.SensorConfig());
   heartRateSensor.Enable();
+  ppg.SetSamplePeriod(sensorControl.SamplePeriod());
   ppg.Reset(true);
   vTaskDelay(100);
+  pendingSamples.Clear();
   measurementSucceeded = false;
   count = 0;
   measurementStartTime = xTaskGetTickCount();
+  samplingStartTime = measurementStartTime;
+}
+
+void HeartRateTask::ApplySensorSettings() {
+  heartRateSensor.Configure(sensorControl.SensorConfig());
+  ppg.SetSamplePeriod(sensorControl.SamplePeriod());
+  // The filters of the heart rate algorithm would see a step in the signal
+  ppg.Reset(true);
+  pendingSamples.Clear();
+  // The sample period may have changed. Since the count is incremented after this sample, the next one is measured
+  // 2 periods later, which leaves the sensor the time to make a conversion with the new settings.
+  count = 0;
+  samplingStartTime = xTaskGetTickCount();
 }
 
 void HeartRateTask::StopMeasurement() {
   heartRateSensor.Disable();
   ppg.Reset(true);
+  pendingSamples.Clear();
   vTaskDelay(100);
 }
 
 void HeartRateTask::HandleSensorData() {
   auto sensorData = heartRateSensor.ReadHrsAls();
-  int8_t ambient = ppg.Preprocess(sensorData.hrs, sensorData.als);
+  auto timestamp = static_cast<uint32_t>(static_cast<uint64_t>(xTaskGetTickCount()) * 1000 / configTICK_RATE_HZ);
+  const auto& sensorConfig = heartRateSensor.Configuration();
+  controller.UpdatePpgSample({sensorControl.SamplePeriod(), sensorConfig.ledDriveCurrent, sensorConfig.resolution, sensorConfig.gain},
+                             sensorData.hrs,
+                             sensorData.als,
+                             count == 0);
+  if (sensorControl.OnSample(sensorData.hrs, sensorData.als)) {
+    ApplySensorSettings();
+    return;
+  }
+
+  // The sample is processed once the samples of the accelerometer measured during the same period are read from the
+  // FIFO, or after PendingSamples::maxMotionDelay with the last acceleration known if the accelerometer is late
+  pendingSamples.Push(sensorData.hrs, sensorData.als, timestamp);
+  PendingSamples::Sample sample;
+  while (pendingSamples.Pop(timestamp, sensorControl.SamplePeriod(), sample)) {
+    // Changing the settings of the sensor drops the pending samples
+    ProcessSample(sample.hrs, sample.als, sample.acceleration);
+  }
+}
+
+void HeartRateTask::ProcessSample(uint16_t hrs,
+                                  uint16_t als,
+                                  const std::array<int16_t, Controllers::MotionArtifactFilter::nbAxes>& acceleration) {
+  int8_t ambient = ppg.Preprocess(hrs, als, acceleration);
   int bpm = ppg.HeartRate();
+  if (sensorControl.OnHeartRate(bpm)) {
+    ApplySensorSettings();
+  }
 
   // Ambient light detected
   if (ambient > 0) {
@@ -224,6 +275,15 @@ void HeartRateTask::HandleSensorData() {
   }
 
   if (bpm != 0) {
+    measurementSucceeded = true;
+    valueCurrentlyShown = true;
+    controller.Update(Controllers::HeartRateController::States::Running, bpm);
+    // In background mode, keep measuring until the readings are stable, or until the time limit.
+    // The first readings can be wrong, especially while the arm moves.
+    if (state == States::BackgroundMeasuring && ppg.Confidence() < 100 &&
+        xTaskGetTickCount() - measurementStartTime < backgroundMeasurementTimeLimit) {
+      return;
+    }
     // Maintain constant frequency acquisition in background mode
     // If the last measurement time is set to the start time, then the next measurement
     // will start exactly one background period after this one
@@ -233,9 +293,6 @@ void HeartRateTask::HandleSensorData() {
     } else {
       lastMeasurementTime = xTaskGetTickCount();
     }
-    measurementSucceeded = true;
-    valueCurrentlyShown = true;
-    controller.Update(Controllers::HeartRateController::States::Running, bpm);
     return;
   }
   // If been measuring for longer than the time limit, set the last measurement time
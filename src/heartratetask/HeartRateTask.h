@@ -1,10 +1,13 @@
 #pragma once
 #include <FreeRTOS.h>
+#include <array>
 #include <cstdint>
 #include <optional>
 #include <task.h>
 #include <queue.h>
 #include <components/heartrate/Ppg.h>
+#include <components/heartrate/PpgSensorControl.h>
+#include "heartratetask/PendingSamples.h"
 #include "components/settings/Settings.h"
 
 namespace Pinetime {
@@ -14,6 +17,7 @@ namespace Pinetime {
 
   namespace Controllers {
     class HeartRateController;
+    class MotionController;
   }
 
   namespace Applications {
@@ -23,17 +27,28 @@ namespace Pinetime {
 
       explicit HeartRateTask(Drivers::Hrs3300& heartRateSensor,
                              Controllers::HeartRateController& controller,
+                             Controllers::MotionController& motionController,
                              Controllers::Settings& settings);
       void Start();
       void Work();
+      // One iteration of Work() : waits for a message or for the time of the next sample, and handles it
+      void HandleNextEvent();
       void PushMessage(Messages msg);
 
+      // A measurement is running, in the foreground or in the background
+      bool IsMeasuring() const {
+        return state == States::ForegroundMeasuring || state == States::BackgroundMeasuring;
+      }
+
     private:
       enum class States : uint8_t { Disabled, Waiting, BackgroundMeasuring, ForegroundMeasuring };
+
       static void Process(void* instance);
       void HandleSensorData();
+      void ProcessSample(uint16_t hrs, uint16_t als, const std::array<int16_t, Controllers::MotionArtifactFilter::nbAxes>& acceleration);
       void StartMeasurement();
       void StopMeasurement();
+      void ApplySensorSettings();
 
       [[nodiscard]] bool BackgroundMeasurementNeeded() const;
       [[nodiscard]] std::optional<TickType_t> BackgroundMeasurementInterval() const;
@@ -47,10 +62,15 @@ namespace Pinetime {
       uint16_t count;
       Drivers::Hrs3300& heartRateSensor;
       Controllers::HeartRateController& controller;
+      Controllers::MotionController& motionController;
       Controllers::Settings& settings;
       Controllers::Ppg ppg;
+      Controllers::PpgSensorControl sensorControl;
       TickType_t lastMeasurementTime;
       TickType_t measurementStartTime;
+      // Time of the first sample with the current sample period
+      TickType_t samplingStartTime;
+      PendingSamples pendingSamples {motionController};
     };
 
   }
@@ -0,0 +1,34 @@
+#include "heartratetask/PendingSamples.h"
+#include <algorithm>
+#include "components/motion/MotionController.h"
+
+using namespace Pinetime::Applications;
+
+PendingSamples::PendingSamples(const Controllers::MotionController& motionController) : motionController {motionController} {
+}
+
+void PendingSamples::Push(uint16_t hrs, uint16_t als, uint32_t timestamp) {
+  if (nbSamples == entries.size()) {
+    std::copy(entries.begin() + 1, entries.end(), entries.begin());
+    nbSamples--;
+  }
+  entries[nbSamples++] = {hrs, als, timestamp};
+}
+
+bool PendingSamples::Pop(uint32_t now, uint32_t samplePeriod, Sample& sample) {
+  if (nbSamples == 0) {
+    return false;
+  }
+  const Entry& entry = entries[0];
+  if (!motionController.AccelerationAt(entry.timestamp, samplePeriod, sample.acceleration)) {
+    if (now - entry.timestamp < maxMotionDelay && nbSamples < entries.size()) {
+      return false;
+    }
+    sample.acceleration = {motionController.X(), motionController.Y(), motionController.Z()};
+  }
+  sample.hrs = entry.hrs;
+  sample.als = entry.als;
+  std::copy(entries.begin() + 1, entries.begin() + nbSamples, entries.begin());
+  nbSamples--;
+  return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "components/heartrate/MotionArtifactFilter.h"
+#include "components/heartrate/Ppg.h"
+
+namespace Pinetime {
+  namespace Controllers {
+    class MotionController;
+  }
+
+  namespace Applications {
+    // Samples of the PPG sensor waiting for the samples of the accelerometer measured at the same time. These are read
+    // from the FIFO of the accelerometer every 250 ms, so a PPG sample is usually released a bit after it was measured.
+    // If the accelerometer is late, it is released after maxMotionDelay with the last acceleration known.
+    class PendingSamples {
+    public:
+      struct Sample {
+        uint16_t hrs;
+        uint16_t als;
+        std::array<int16_t, Controllers::MotionArtifactFilter::nbAxes> acceleration;
+      };
+
+      static constexpr uint32_t maxMotionDelay = 500; // ms
+      static constexpr size_t capacity = maxMotionDelay / Controllers::Ppg::defaultSamplePeriod + 2;
+
+      explicit PendingSamples(const Controllers::MotionController& motionController);
+
+      void Clear() {
+        nbSamples = 0;
+      }
+
+      size_t Size() const {
+        return nbSamples;
+      }
+
+      // timestamp is the time of the sample, in ms since boot. Pop() must be called after each Push() : the oldest sample
+      // is released when full, and dropped if it was not.
+      void Push(uint16_t hrs, uint16_t als, uint32_t timestamp);
+      // Releases the oldest sample, with the mean acceleration during the sample period (ms) ending at its timestamp.
+      // Returns false if it must still wait for the accelerometer at now (ms since boot).
+      bool Pop(uint32_t now, uint32_t samplePeriod, Sample& sample);
+
+    private:
+      struct Entry {
+        uint16_t hrs;
+        uint16_t als;
+        uint32_t timestamp;
+      };
+
+      const Controllers::MotionController& motionController;
+      std::array<Entry, capacity> entries;
+      size_t nbSamples = 0;
+    };
+  }
+}
@@ -99,12 +99,12 @@ Pinetime::Controllers::Settings settingsController {fs};
 Pinetime::Controllers::MotorController motorController {};
 
 Pinetime::Controllers::HeartRateController heartRateController;
-Pinetime::Applications::HeartRateTask heartRateApp(heartRateSensor, heartRateController, settingsController);
+Pinetime::Controllers::MotionController motionController;
+Pinetime::Applications::HeartRateTask heartRateApp(heartRateSensor, heartRateController, motionController, settingsController);
 
-Pinetime::Controllers::DateTime dateTimeController {settingsController};
+Pinetime::Controllers::DateTime dateTimeController {settingsController, fs};
 Pinetime::Drivers::Watchdog watchdog;
-Pinetime::Controllers::NotificationManager notificationManager;
-Pinetime::Controllers::MotionController motionController;
+Pinetime::Controllers::NotificationManager notificationManager {fs};
 Pinetime::Controllers::StopWatchController stopWatchController;
 Pinetime::Controllers::AlarmController alarmController {dateTimeController, fs};
 Pinetime::Controllers::TouchHandler touchHandler;
@@ -176,6 +176,11 @@ void nrfx_gpiote_evt_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action
     return;
   }
 
+  if (pin == Pinetime::PinMap::Bma421Irq) {
+    systemTask.PushMessage(Pinetime::System::Messages::OnMotionEvent);
+    return;
+  }
+
   BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
   if (pin == Pinetime::PinMap::PowerPresent and action == NRF_GPIOTE_POLARITY_TOGGLE) {
@@ -212,6 +217,10 @@ void SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQHandler(void) {
   }
 }
 
+void SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQHandler(void) {
+  twiMaster.OnInterrupt();
+}
+
 static void (*radio_isr_addr)();
 static void (*rng_isr_addr)();
 static void (*rtc0_isr_addr)();
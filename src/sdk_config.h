@@ -4807,7 +4807,7 @@
 // <e> NRFX_TWIM_ENABLED - nrfx_twim - TWIM peripheral driver
 //==========================================================
 #ifndef NRFX_TWIM_ENABLED
-  #define NRFX_TWIM_ENABLED 1
+  #define NRFX_TWIM_ENABLED 0
 #endif
 // <q> NRFX_TWIM0_ENABLED  - Enable TWIM0 instance
 
@@ -4818,7 +4818,7 @@
 // <q> NRFX_TWIM1_ENABLED  - Enable TWIM1 instance
 
 #ifndef NRFX_TWIM1_ENABLED
-  #define NRFX_TWIM1_ENABLED 1
+  #define NRFX_TWIM1_ENABLED 0
 #endif
 
 // <o> NRFX_TWIM_DEFAULT_CONFIG_FREQUENCY  - Frequency
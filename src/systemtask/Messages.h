@@ -8,11 +8,14 @@ namespace Pinetime {
       GoToRunning,
       OnNewTime,
       OnNewNotification,
+      OnNotificationDismissed,
+      OnNewWeather,
       OnNewCall,
       BleConnected,
       BleFirmwareUpdateStarted,
       BleFirmwareUpdateFinished,
       OnTouchEvent,
+      OnMotionEvent,
       HandleButtonEvent,
       HandleButtonTimerEvent,
       OnDisplayTaskSleeping,
@@ -29,6 +32,8 @@ namespace Pinetime {
       BatteryPercentageUpdated,
       StartFileTransfer,
       StopFileTransfer,
+      StartActivitySync,
+      StopActivitySync,
       BleRadioEnableToggle
     };
   }
@@ -0,0 +1,56 @@
+#include "systemtask/MotionWake.h"
+
+using namespace Pinetime::System;
+
+MotionWake::MotionWake(Drivers::Bma421& motionSensor) : motionSensor {motionSensor} {
+}
+
+bool MotionWake::ShouldReadSamples(bool int1Level) const {
+  return !isArmed || int1Level;
+}
+
+void MotionWake::OnReadSamples(TickType_t now) {
+  if (isArmed) {
+    // Woken by the any-motion interrupt : the samples recorded by the FIFO before and after it are checked for a wake
+    // gesture until the confirmation delay expires
+    Disarm();
+    wakeTime = now;
+  }
+  lastRead = now;
+}
+
+MotionWake::Actions MotionWake::Update(TickType_t now, bool isSleeping, bool isMeasuringHeartRate, bool int1Level) {
+  if (isArmed) {
+    // The edge of the latched any-motion interrupt was missed
+    if (int1Level) {
+      return Actions::ReadSamples;
+    }
+    // The heart rate measurement cancels the motion artifacts with the samples of the FIFO
+    if (isMeasuringHeartRate) {
+      Disarm();
+      return Actions::ReadSamples;
+    }
+    return Actions::None;
+  }
+  if (isSleeping && now - wakeTime >= confirmationDelay && !isMeasuringHeartRate) {
+    return Actions::Arm;
+  }
+  if (now - lastRead >= fifoTimeout) {
+    // The FIFO interrupt was missed, or the FIFO is not available
+    return Actions::ReadSamples;
+  }
+  return Actions::None;
+}
+
+void MotionWake::Arm() {
+  motionSensor.SelectInterrupt(Drivers::Bma421::Interrupts::AnyMotion);
+  isArmed = true;
+}
+
+void MotionWake::Disarm() {
+  if (!isArmed) {
+    return;
+  }
+  motionSensor.SelectInterrupt(Drivers::Bma421::Interrupts::FifoWatermark);
+  isArmed = false;
+}
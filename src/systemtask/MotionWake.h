@@ -0,0 +1,43 @@
+#pragma once
+
+#include <FreeRTOS.h>
+#include "drivers/Bma421.h"
+
+namespace Pinetime {
+  namespace System {
+    // While sleeping, the motion sensor only interrupts when it starts moving (any-motion). The samples are then read
+    // from the FIFO again, to check for a wake gesture during confirmationDelay. The FIFO interrupt stays enabled while
+    // the heart rate is measured.
+    class MotionWake {
+    public:
+      // What SystemTask has to do at the periodic state update
+      enum class Actions : uint8_t { None, ReadSamples, Arm };
+
+      static constexpr TickType_t confirmationDelay = pdMS_TO_TICKS(2000);
+      // The FIFO of the motion sensor can store ~1.7s of samples
+      static constexpr TickType_t fifoTimeout = pdMS_TO_TICKS(1000);
+
+      explicit MotionWake(Drivers::Bma421& motionSensor);
+
+      bool IsArmed() const {
+        return isArmed;
+      }
+
+      // INT1 was raised. Returns false for a FIFO interrupt received just before the any-motion interrupt was selected.
+      bool ShouldReadSamples(bool int1Level) const;
+      // The FIFO is about to be read. If armed, the sensor moved : the FIFO interrupt is selected again.
+      void OnReadSamples(TickType_t now);
+      Actions Update(TickType_t now, bool isSleeping, bool isMeasuringHeartRate, bool int1Level);
+
+      // The pending samples must be read before
+      void Arm();
+      void Disarm();
+
+    private:
+      Drivers::Bma421& motionSensor;
+      bool isArmed = false;
+      TickType_t wakeTime = 0;
+      TickType_t lastRead = 0;
+    };
+  }
+}
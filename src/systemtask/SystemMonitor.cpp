@@ -1,4 +1,5 @@
-#include "systemtask/SystemTask.h"
+#include "systemtask/SystemMonitor.h"
+#include <algorithm>
 #if NRF_LOG_ENABLED
   // FreeRtosMonitor
   #include <FreeRTOS.h>
@@ -25,3 +26,38 @@ void Pinetime::System::SystemMonitor::Process() {
 void Pinetime::System::SystemMonitor::Process() {
 }
 #endif
+
+using namespace Pinetime::System;
+
+void SystemMonitor::RegisterQueue(Queues queue, QueueHandle_t handle) {
+  queues[static_cast<uint8_t>(queue)] = handle;
+}
+
+uint8_t SystemMonitor::QueueDepth(Queues queue) const {
+  QueueHandle_t handle = queues[static_cast<uint8_t>(queue)];
+  if (handle == nullptr) {
+    return 0;
+  }
+  return uxQueueMessagesWaiting(handle);
+}
+
+void SystemMonitor::OnFrameRendered(uint16_t durationMs) {
+  taskENTER_CRITICAL();
+  std::copy_backward(stats.frameTimes.begin(), stats.frameTimes.end() - 1, stats.frameTimes.end());
+  stats.frameTimes[0] = durationMs;
+  stats.nbFrames++;
+  taskEXIT_CRITICAL();
+}
+
+void SystemMonitor::SetLvglMemory(const LvglMemory& memory) {
+  taskENTER_CRITICAL();
+  stats.lvglMemory = memory;
+  taskEXIT_CRITICAL();
+}
+
+SystemMonitor::Stats SystemMonitor::GetStats() const {
+  taskENTER_CRITICAL();
+  Stats copy = stats;
+  taskEXIT_CRITICAL();
+  return copy;
+}
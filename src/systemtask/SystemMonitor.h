@@ -1,14 +1,47 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <FreeRTOS.h> // declares configUSE_TRACE_FACILITY
+#include <queue.h>
 #include <task.h>
 
 namespace Pinetime {
   namespace System {
+    // Logs the heap and stack usage when the logs are enabled, and collects the statistics reported by the telemetry
+    // service (queue depths, LVGL memory usage and frame times)
     class SystemMonitor {
     public:
+      enum class Queues : uint8_t { System, Display, Count };
+      static constexpr uint8_t NbFrameTimes = 8;
+
+      struct LvglMemory {
+        uint32_t totalSize;
+        uint32_t freeSize;
+        uint32_t maxUsed;
+        uint8_t fragmentation; // in percent
+      };
+
+      struct Stats {
+        LvglMemory lvglMemory;
+        uint32_t nbFrames;
+        std::array<uint16_t, NbFrameTimes> frameTimes; // in ms, most recent first, 0 if not rendered yet
+      };
+
       void Process();
-#if configUSE_TRACE_FACILITY == 1
+
+      void RegisterQueue(Queues queue, QueueHandle_t handle);
+      uint8_t QueueDepth(Queues queue) const;
+
+      // Called by the display task
+      void OnFrameRendered(uint16_t durationMs);
+      void SetLvglMemory(const LvglMemory& memory);
+
+      Stats GetStats() const;
+
     private:
+      std::array<QueueHandle_t, static_cast<uint8_t>(Queues::Count)> queues {};
+      Stats stats {};
+#if configUSE_TRACE_FACILITY == 1
       mutable TickType_t lastTick = 0;
 #endif
     };
@@ -17,6 +17,7 @@
 #include "main.h"
 #include "BootErrors.h"
 
+#include <algorithm>
 #include <memory>
 
 using namespace Pinetime::System;
@@ -74,6 +75,7 @@ SystemTask::SystemTask(Drivers::SpiMaster& spi,
     fs {fs},
     touchHandler {touchHandler},
     buttonHandler {buttonHandler},
+    activityHistory {fs},
     nimbleController(*this,
                      bleController,
                      dateTimeController,
@@ -82,11 +84,13 @@ SystemTask::SystemTask(Drivers::SpiMaster& spi,
                      spiNorFlash,
                      heartRateController,
                      motionController,
+                     activityHistory,
                      fs) {
 }
 
 void SystemTask::Start() {
   systemTasksMsgQueue = xQueueCreate(10, 1);
+  monitor.RegisterQueue(SystemMonitor::Queues::System, systemTasksMsgQueue);
   if (pdPASS != xTaskCreate(SystemTask::Process, "MAIN", 350, this, 1, &taskHandle)) {
     APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
   }
@@ -127,9 +131,12 @@ void SystemTask::Work() {
    */
   touchPanel.Init();
   dateTimeController.Register(this);
+  dateTimeController.LoadClockDrift();
   batteryController.Register(this);
   motionSensor.SoftReset();
   alarmController.Init(this);
+  notificationManager.Init();
+  activityHistory.Init();
 
   // Reset the TWI device because the motion sensor chip most probably crashed it...
   twiMaster.Sleep();
@@ -143,6 +150,7 @@ void SystemTask::Work() {
   displayApp.Register(&nimbleController.weather());
   displayApp.Register(&nimbleController.music());
   displayApp.Register(&nimbleController.navigation());
+  displayApp.Register(&activityHistory);
   displayApp.Start(bootError);
 
   heartRateSensor.Init();
@@ -177,17 +185,26 @@ void SystemTask::Work() {
   nrfx_gpiote_in_init(PinMap::PowerPresent, &pinConfig, nrfx_gpiote_evt_handler);
   nrfx_gpiote_in_event_enable(PinMap::PowerPresent, true);
 
+  // INT1 of the motion sensor : FIFO watermark or any-motion (push-pull, active high)
+  pinConfig.sense = NRF_GPIOTE_POLARITY_LOTOHI;
+  pinConfig.pull = NRF_GPIO_PIN_NOPULL;
+  nrfx_gpiote_in_init(PinMap::Bma421Irq, &pinConfig, nrfx_gpiote_evt_handler);
+  nrfx_gpiote_in_event_enable(PinMap::Bma421Irq, true);
+
   batteryController.MeasureVoltage();
 
   measureBatteryTimer = xTimerCreate("measureBattery", batteryMeasurementPeriod, pdTRUE, this, MeasureBatteryTimerCallback);
   xTimerStart(measureBatteryTimer, portMAX_DELAY);
 
-  constexpr TickType_t stateUpdatePeriod = pdMS_TO_TICKS(100);
-  // Stores when the state (motion, watchdog, time persistence etc) was last updated
+  // The motion is updated when the FIFO of the motion sensor reaches its watermark, the state is only updated
+  // periodically for the BLE discovery timer, the watchdog and the time persistence.
+  // The BLE discovery timer counts in periods of 100ms.
+  constexpr TickType_t bleDiscoveryStateUpdatePeriod = pdMS_TO_TICKS(100);
+  constexpr TickType_t idleStateUpdatePeriod = pdMS_TO_TICKS(1000);
+  TickType_t stateUpdatePeriod = bleDiscoveryStateUpdatePeriod;
+  // Stores when the state (watchdog, time persistence etc) was last updated
   // If there are many events being received by the message queue, this prevents
-  // having to update motion etc after every single event, which is bad
-  // for efficiency and for motion wake algorithms which expect motion readings
-  // to be 100ms apart
+  // having to update it after every single event, which is bad for efficiency
   TickType_t lastStateUpdate = xTaskGetTickCount() - stateUpdatePeriod; // Force immediate run
   TickType_t elapsed;
 
@@ -196,6 +213,7 @@ void SystemTask::Work() {
   while (true) {
     Messages msg;
 
+    stateUpdatePeriod = isBleDiscoveryTimerRunning ? bleDiscoveryStateUpdatePeriod : idleStateUpdatePeriod;
     elapsed = xTaskGetTickCount() - lastStateUpdate;
     TickType_t waitTime;
     if (elapsed >= stateUpdatePeriod) {
@@ -224,6 +242,7 @@ void SystemTask::Work() {
           }
           break;
         case Messages::OnNewNotification:
+          PersistNotifications();
           if (settingsController.GetNotificationStatus() == Pinetime::Controllers::Settings::Notification::On) {
             if (IsSleeping()) {
               GoToRunning();
@@ -231,6 +250,19 @@ void SystemTask::Work() {
             displayApp.PushMessage(Pinetime::Applications::Display::Messages::NewNotification);
           }
           break;
+        case Messages::OnNotificationDismissed:
+          PersistNotifications();
+          break;
+        case Messages::OnNewWeather:
+          // The weather is received in the background, the display is not woken up
+          if (!isActivitySyncing) {
+            WakeUpFlash();
+          }
+          nimbleController.weather().SaveToFile();
+          if (!isActivitySyncing) {
+            SleepFlash();
+          }
+          break;
         case Messages::SetOffAlarm:
           GoToRunning();
           displayApp.PushMessage(Pinetime::Applications::Display::Messages::AlarmTriggered);
@@ -262,6 +294,26 @@ void SystemTask::Work() {
           wakeLocksHeld--;
           // TODO add intent of fs access icon or something
           break;
+        case Messages::StartActivitySync:
+          // Only the SPI flash is woken up, the history is read in the background
+          if (!isActivitySyncing) {
+            WakeUpFlash();
+            isActivitySyncing = true;
+          }
+          nimbleController.activitySync().OnFlashAvailable();
+          break;
+        case Messages::StopActivitySync:
+          if (isActivitySyncing) {
+            isActivitySyncing = false;
+            SleepFlash();
+          }
+          break;
+        case Messages::OnMotionEvent:
+          // Ignore a FIFO interrupt received just before the any-motion interrupt was selected
+          if (motionWake.ShouldReadSamples(nrf_gpio_pin_read(PinMap::Bma421Irq) != 0)) {
+            UpdateMotion();
+          }
+          break;
         case Messages::OnTouchEvent:
           // Finish immediately if no new events
           if (!touchHandler.ProcessTouchInfo(touchPanel.GetTouchInfo())) {
@@ -310,14 +362,18 @@ void SystemTask::Work() {
           if (state != SystemTaskState::GoingToSleep) {
             break;
           }
-          if (BootloaderVersion::IsValid()) {
+          // Last chance to write to the SPI flash before it goes to sleep
+          dateTimeController.PersistClockDrift();
+          activityHistory.Flush();
+          // The SPI flash is kept awake until the end of the activity sync, StopActivitySync puts it to sleep
+          if (BootloaderVersion::IsValid() && !isActivitySyncing) {
             // First versions of the bootloader do not expose their version and cannot initialize the SPI NOR FLASH
             // if it's in sleep mode. Avoid bricked device by disabling sleep mode on these versions.
             spiNorFlash.Sleep();
           }
 
           // Must keep SPI awake when still updating the display for always on
-          if (msg == Messages::OnDisplayTaskSleeping) {
+          if (msg == Messages::OnDisplayTaskSleeping && !isActivitySyncing) {
             spi.Sleep();
           }
 
@@ -379,7 +435,18 @@ void SystemTask::Work() {
     }
     elapsed = xTaskGetTickCount() - lastStateUpdate;
     if (elapsed >= stateUpdatePeriod) {
-      UpdateMotion();
+      switch (motionWake.Update(xTaskGetTickCount(), IsSleeping(), heartRateApp.IsMeasuring(), nrf_gpio_pin_read(PinMap::Bma421Irq) != 0)) {
+        case MotionWake::Actions::ReadSamples:
+          UpdateMotion();
+          break;
+        case MotionWake::Actions::Arm:
+          // Process the samples recorded until now, the motion controller will only be updated again when the sensor moves
+          UpdateMotion();
+          motionWake.Arm();
+          break;
+        default:
+          break;
+      }
       if (isBleDiscoveryTimerRunning) {
         if (bleDiscoveryTimer == 0) {
           isBleDiscoveryTimerRunning = false;
@@ -391,6 +458,7 @@ void SystemTask::Work() {
         }
       }
       monitor.Process();
+      UpdateActivityHistory();
       NoInit_BackUpTime = dateTimeController.CurrentDateTime();
       if (nrf_gpio_pin_read(PinMap::Button) == 0) {
         watchdog.Reload();
@@ -405,9 +473,11 @@ void SystemTask::GoToRunning() {
   if (state == SystemTaskState::Running) {
     return;
   }
+  motionWake.Disarm();
   if (state == SystemTaskState::Sleeping || state == SystemTaskState::AODSleeping) {
     // SPI only switched off when entering Sleeping, not AOD or GoingToSleep
-    if (state == SystemTaskState::Sleeping) {
+    // The SPI bus and flash are already awake if the activity history is being synchronized
+    if (state == SystemTaskState::Sleeping && !isActivitySyncing) {
       spi.Wakeup();
     }
 
@@ -416,7 +486,9 @@ void SystemTask::GoToRunning() {
       touchPanel.Wakeup();
     }
 
-    spiNorFlash.Wakeup();
+    if (!isActivitySyncing) {
+      spiNorFlash.Wakeup();
+    }
   }
 
   displayApp.PushMessage(Pinetime::Applications::Display::Messages::GoToRunning);
@@ -450,11 +522,76 @@ void SystemTask::GoToSleep() {
 void SystemTask::UpdateMotion() {
   // Unconditionally update motion
   // Reading steps/motion characteristics must return up to date information even when not subscribed to notifications
+  TickType_t now = xTaskGetTickCount();
+  motionWake.OnReadSamples(now);
+
+  // The last sample of the FIFO was measured when its length is read
+  size_t nbSamples = motionSensor.NbSamples();
+  auto timestamp = static_cast<uint32_t>(static_cast<uint64_t>(now) * 1000 / configTICK_RATE_HZ);
+  while (nbSamples > 0) {
+    // The samples are read by blocks of MotionController::samplesPerUpdate, so that the wake gestures are checked after
+    // each update of the motion controller, like when the samples were polled
+    size_t nbRead = motionSensor.ReadSamples(motionSamples.data(), std::min(nbSamples, motionSamples.size()));
+    if (nbRead == 0) {
+      break;
+    }
+    nbSamples -= nbRead;
+    motionController.AddSamples(motionSamples.data(), nbRead, timestamp - nbSamples * 1000 / Drivers::Bma421::samplingRate);
+    CheckMotionGestures();
+  }
+  motionSensor.ClearInterrupts();
+
+  motionController.UpdateSteps(motionSensor.NbSteps());
+}
 
-  auto motionValues = motionSensor.Process();
+void SystemTask::UpdateActivityHistory() {
+  auto localTime = std::chrono::duration_cast<std::chrono::minutes>(dateTimeController.CurrentDateTime().time_since_epoch());
+  activityHistory.Update(localTime, motionController.NbSteps(), heartRateController.HeartRate(), heartRateController.NbReadings());
+  if (!activityHistory.IsFlushNeeded()) {
+    return;
+  }
 
-  motionController.Update(motionValues.x, motionValues.y, motionValues.z, motionValues.steps);
+  // About once per hour : the SPI flash is woken up if the system is sleeping (and not already awake for a sync)
+  if (!isActivitySyncing) {
+    WakeUpFlash();
+  }
+  activityHistory.Flush();
+  if (!isActivitySyncing) {
+    SleepFlash();
+  }
+}
+
+void SystemTask::PersistNotifications() {
+  // The notifications can be received while the system is sleeping, without waking the display
+  if (!isActivitySyncing) {
+    WakeUpFlash();
+  }
+  notificationManager.Persist();
+  if (!isActivitySyncing) {
+    SleepFlash();
+  }
+}
+
+void SystemTask::WakeUpFlash() {
+  // The SPI bus is only switched off in Sleeping, the SPI flash in Sleeping and AODSleeping
+  if (state == SystemTaskState::Sleeping) {
+    spi.Wakeup();
+  }
+  if ((state == SystemTaskState::Sleeping || state == SystemTaskState::AODSleeping) && BootloaderVersion::IsValid()) {
+    spiNorFlash.Wakeup();
+  }
+}
+
+void SystemTask::SleepFlash() {
+  if ((state == SystemTaskState::Sleeping || state == SystemTaskState::AODSleeping) && BootloaderVersion::IsValid()) {
+    spiNorFlash.Sleep();
+  }
+  if (state == SystemTaskState::Sleeping) {
+    spi.Sleep();
+  }
+}
 
+void SystemTask::CheckMotionGestures() {
   if (settingsController.GetNotificationStatus() != Controllers::Settings::Notification::Sleep) {
     if ((settingsController.isWakeUpModeOn(Pinetime::Controllers::Settings::WakeUpMode::RaiseWrist) &&
          motionController.ShouldRaiseWake()) ||
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <memory>
 
 #include <FreeRTOS.h>
@@ -13,10 +14,12 @@
 #include <components/motion/MotionController.h>
 
 #include "systemtask/SystemMonitor.h"
+#include "systemtask/MotionWake.h"
 #include "components/ble/NimbleController.h"
 #include "components/ble/NotificationManager.h"
 #include "components/stopwatch/StopWatchController.h"
 #include "components/alarm/AlarmController.h"
+#include "components/activity/ActivityHistory.h"
 #include "components/fs/FS.h"
 #include "touchhandler/TouchHandler.h"
 #include "buttonhandler/ButtonHandler.h"
@@ -87,6 +90,10 @@ namespace Pinetime {
         return nimbleController;
       };
 
+      SystemMonitor& Monitor() {
+        return monitor;
+      };
+
       Pinetime::Controllers::NotificationManager& GetNotificationManager() {
         return notificationManager;
       };
@@ -126,6 +133,7 @@ namespace Pinetime {
       Pinetime::Controllers::FS& fs;
       Pinetime::Controllers::TouchHandler& touchHandler;
       Pinetime::Controllers::ButtonHandler& buttonHandler;
+      Pinetime::Controllers::ActivityHistory activityHistory;
       Pinetime::Controllers::NimbleController nimbleController;
 
       static void Process(void* instance);
@@ -134,6 +142,8 @@ namespace Pinetime {
       uint8_t bleDiscoveryTimer = 0;
       TimerHandle_t measureBatteryTimer;
       uint8_t wakeLocksHeld = 0;
+      // The SPI flash is kept awake while the activity sync service reads the history
+      bool isActivitySyncing = false;
       SystemTaskState state = SystemTaskState::Running;
 
       void HandleButtonAction(Controllers::ButtonActions action);
@@ -142,6 +152,14 @@ namespace Pinetime {
       void GoToRunning();
       void GoToSleep();
       void UpdateMotion();
+      void CheckMotionGestures();
+      void UpdateActivityHistory();
+      void PersistNotifications();
+      // Wake up or put back to sleep the SPI flash when the system is sleeping, to access the filesystem in the background
+      void WakeUpFlash();
+      void SleepFlash();
+      MotionWake motionWake {motionSensor};
+      std::array<Drivers::Bma421::Sample, Controllers::MotionController::samplesPerUpdate> motionSamples;
       static constexpr TickType_t batteryMeasurementPeriod = pdMS_TO_TICKS(10 * 60 * 1000);
 
       SystemMonitor monitor;
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Utility {
+    // CRC-16/CCITT (polynomial 0x1021), as used by the DFU. Pass the previous result as 'crc' to compute the CRC of
+    // data split in several buffers.
+    inline uint16_t Crc16(const uint8_t* data, size_t size, uint16_t crc = 0xffff) {
+      for (size_t i = 0; i < size; i++) {
+        crc = static_cast<uint8_t>(crc >> 8) | (crc << 8);
+        crc ^= data[i];
+        crc ^= static_cast<uint8_t>(crc & 0xff) >> 4;
+        crc ^= (crc << 8) << 4;
+        crc ^= ((crc & 0xff) << 4) << 1;
+      }
+      return crc;
+    }
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+namespace Pinetime {
+  namespace Utility {
+    // Null-terminated string with a fixed capacity (in bytes), stored inline.
+    // Text that does not fit is truncated on a UTF-8 character boundary, optionally with an ellipsis ("...").
+    template <size_t Capacity>
+    class FixedString {
+    public:
+      static_assert(Capacity > 3, "Capacity is too small for the ellipsis");
+
+      // Returns true if the content changed
+      bool Assign(const char* text, size_t size, bool ellipsis = false);
+
+      bool Assign(const char* text) {
+        return Assign(text, std::strlen(text));
+      }
+
+      const char* Data() const {
+        return buffer;
+      }
+
+      size_t Size() const {
+        return size;
+      }
+
+      bool operator==(const char* other) const {
+        return std::strcmp(buffer, other) == 0;
+      }
+
+      bool operator!=(const char* other) const {
+        return !(*this == other);
+      }
+
+    private:
+      char buffer[Capacity + 1] = {};
+      size_t size = 0;
+    };
+
+    template <size_t Capacity>
+    bool FixedString<Capacity>::Assign(const char* text, size_t textSize, bool ellipsis) {
+      // Stop at the first null character, like a C string
+      const char* end = static_cast<const char*>(std::memchr(text, '\0', textSize));
+      if (end != nullptr) {
+        textSize = end - text;
+      }
+
+      size_t newSize = textSize;
+      bool truncated = textSize > Capacity;
+      if (truncated) {
+        newSize = ellipsis ? Capacity - 3 : Capacity;
+        // Do not cut in the middle of a multi-byte character: move back to the first byte of the sequence
+        while (newSize > 0 && (static_cast<unsigned char>(text[newSize]) & 0xc0) == 0x80) {
+          newSize--;
+        }
+      }
+
+      size_t totalSize = (truncated && ellipsis) ? newSize + 3 : newSize;
+      if (totalSize == size && std::memcmp(buffer, text, newSize) == 0 &&
+          (!(truncated && ellipsis) || std::memcmp(buffer + newSize, "...", 3) == 0)) {
+        return false;
+      }
+
+      std::memcpy(buffer, text, newSize);
+      if (truncated && ellipsis) {
+        std::memcpy(buffer + newSize, "...", 3);
+      }
+      buffer[totalSize] = '\0';
+      size = totalSize;
+      return true;
+    }
+  }
+}
@@ -0,0 +1,320 @@
+#include "components/activity/ActivityHistory.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "components/fs/FS.h"
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+using Minute = ActivityHistory::Minute;
+using Summary = ActivityHistory::Summary;
+
+namespace {
+  constexpr uint32_t minutesPerDay = ActivityHistory::minutesPerDay;
+  // Day 0 of the files and 236 of the ring of summaries
+  constexpr uint32_t firstDay = 20000;
+  constexpr const char* daysFileName = "/.system/activity/days.dat";
+  // Day file : header (12 bytes), then records : type (u8), size of the payload (u16), payload, CRC16 (u16)
+  constexpr size_t headerSize = 12;
+  constexpr uint8_t recordHour = 2;
+
+  std::string DayFileName(uint32_t day) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/.system/activity/day%02u.dat", static_cast<unsigned>(day % ActivityHistory::nbDetailedDays));
+    return name;
+  }
+
+  // The day file without its hour records, like after resets between the minutes and the summaries
+  std::vector<uint8_t> WithoutHours(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> result(data.begin(), data.begin() + headerSize);
+    for (size_t offset = headerSize; offset + 3 <= data.size();) {
+      size_t size = 3 + (data[offset + 1] | (data[offset + 2] << 8)) + 2;
+      if (data[offset] != recordHour) {
+        result.insert(result.end(), data.begin() + offset, data.begin() + offset + size);
+      }
+      offset += size;
+    }
+    return result;
+  }
+
+  bool operator==(const Summary& a, const Summary& b) {
+    return a.steps == b.steps && a.heartRateSum == b.heartRateSum && a.heartRateMinutes == b.heartRateMinutes &&
+           a.minHeartRate == b.minHeartRate && a.maxHeartRate == b.maxHeartRate;
+  }
+
+  // A day of activity : nothing at night, walks with some heart rate readings during the day
+  Minute Activity(uint32_t minute) {
+    uint32_t minuteOfDay = minute % minutesPerDay;
+    if (minuteOfDay < 7 * 60 || minuteOfDay >= 23 * 60) {
+      return {0, minuteOfDay % 10 == 0 ? static_cast<uint8_t>(50 + minuteOfDay % 7) : uint8_t {0}};
+    }
+    auto steps = static_cast<uint16_t>((minute * 37) % 130);
+    auto heartRate = static_cast<uint8_t>(minute % 3 == 0 ? 60 + (minute * 11) % 90 : 0);
+    return {steps, heartRate};
+  }
+
+  // The system task : Update() every minute with the step counter (reset at midnight) and the heart rate readings, and
+  // Flush() when needed. The minutes recorded are kept to compute the expected summaries.
+  struct Watch {
+    explicit Watch(FS& fs) : history {fs} {
+      history.Init();
+    }
+
+    void Record(uint32_t minute, Minute activity) {
+      if (minute != nextMinute) {
+        // After a gap, the minute in progress is closed without activity
+        if (nextMinute != 0) {
+          expected[nextMinute] = {};
+        }
+        Update(minute);
+      }
+      stepCounter += activity.steps;
+      if (activity.heartRate != 0) {
+        heartRate = activity.heartRate;
+        nbReadings++;
+      }
+      expected[minute] = activity;
+      nextMinute = minute + 1;
+      if (nextMinute % minutesPerDay == 0) {
+        // The steps of the last minute of the day are lost
+        stepCounter = 0;
+        expected[minute].steps = 0;
+      }
+      Update(nextMinute);
+    }
+
+    void Record(uint32_t first, uint32_t end) {
+      for (uint32_t minute = first; minute < end; minute++) {
+        Record(minute, Activity(minute));
+      }
+    }
+
+    void Update(uint32_t minute) {
+      history.Update(std::chrono::minutes {minute}, stepCounter, heartRate, nbReadings);
+      if (history.IsFlushNeeded()) {
+        history.Flush();
+      }
+    }
+
+    Summary Expected(uint32_t begin, uint32_t end) const {
+      Summary summary;
+      for (auto it = expected.lower_bound(begin); it != expected.end() && it->first < end; ++it) {
+        const auto& minute = it->second;
+        summary.steps += minute.steps;
+        if (minute.heartRate != 0) {
+          summary.minHeartRate = summary.heartRateMinutes == 0 ? minute.heartRate : std::min(summary.minHeartRate, minute.heartRate);
+          summary.maxHeartRate = std::max(summary.maxHeartRate, minute.heartRate);
+          summary.heartRateSum += minute.heartRate;
+          summary.heartRateMinutes++;
+        }
+      }
+      return summary;
+    }
+
+    Summary ExpectedDay(uint32_t day) const {
+      return Expected(day * minutesPerDay, (day + 1) * minutesPerDay);
+    }
+
+    Summary ExpectedHour(uint32_t day, uint32_t hour) const {
+      return Expected(day * minutesPerDay + hour * 60, day * minutesPerDay + (hour + 1) * 60);
+    }
+
+    // The hours and minutes of the day are the recorded ones
+    void CheckDay(uint32_t day) {
+      std::array<Summary, 24> hours;
+      history.Hours(day, hours);
+      for (uint32_t hour = 0; hour < 24; hour++) {
+        CHECK(hours[hour] == ExpectedHour(day, hour));
+      }
+      std::vector<Minute> minutes(minutesPerDay);
+      size_t count = history.Minutes(day, 0, minutes.data(), minutes.size());
+      size_t expectedCount = 0;
+      for (uint32_t minute = 0; minute < minutesPerDay; minute++) {
+        auto it = expected.find(day * minutesPerDay + minute);
+        Minute value = it != expected.end() ? it->second : Minute {};
+        expectedCount += it != expected.end() ? 1 : 0;
+        CHECK_EQUAL(minutes[minute].steps, value.steps);
+        CHECK_EQUAL(minutes[minute].heartRate, value.heartRate);
+      }
+      CHECK_EQUAL(count, expectedCount);
+    }
+
+    ActivityHistory history;
+    uint32_t nextMinute = 0;
+    uint32_t stepCounter = 0;
+    uint8_t heartRate = 0;
+    uint32_t nbReadings = 0;
+    std::map<uint32_t, Minute> expected;
+  };
+
+  // The minutes are summarized by hour and by day, the same once reloaded from the files
+  void TestRollUp() {
+    FS fs;
+    Watch watch {fs};
+    const uint32_t start = firstDay * minutesPerDay;
+    watch.Record(start, start + minutesPerDay + 90);
+    watch.history.Flush();
+
+    watch.CheckDay(firstDay);
+    watch.CheckDay(firstDay + 1);
+    std::array<Summary, 3> days;
+    CHECK_EQUAL(watch.history.Days(firstDay, days.data(), days.size()), 2);
+    CHECK(days[0] == watch.ExpectedDay(firstDay));
+    CHECK(days[1] == watch.ExpectedDay(firstDay + 1));
+    CHECK(days[2].IsEmpty());
+    CHECK(!days[0].IsEmpty());
+
+    Watch reloaded {fs};
+    reloaded.expected = watch.expected;
+    reloaded.CheckDay(firstDay);
+    reloaded.CheckDay(firstDay + 1);
+    CHECK_EQUAL(reloaded.history.Days(firstDay, days.data(), days.size()), 2);
+    CHECK(days[0] == watch.ExpectedDay(firstDay));
+    CHECK(days[1] == watch.ExpectedDay(firstDay + 1));
+    uint32_t begin;
+    uint32_t end;
+    reloaded.history.RecordedRange(begin, end);
+    CHECK_EQUAL(begin, (firstDay + 1 - (ActivityHistory::nbDetailedDays - 1)) * minutesPerDay);
+    CHECK_EQUAL(end, start + minutesPerDay + 90);
+  }
+
+  // Power loss before the summaries are written : Init() rebuilds the hours from the minutes, and the summary of the
+  // completed day. The last hour of the latest day is still in progress, and goes on with the next minutes.
+  void TestRecover() {
+    FS fs;
+    Watch watch {fs};
+    const uint32_t start = firstDay * minutesPerDay;
+    watch.Record(start, start + minutesPerDay + 90);
+    watch.history.Flush();
+
+    for (uint32_t day : {firstDay, firstDay + 1}) {
+      auto& data = fs.files.at(DayFileName(day));
+      auto withoutHours = WithoutHours(data);
+      CHECK(withoutHours.size() < data.size());
+      data = withoutHours;
+    }
+    fs.files.erase(daysFileName);
+
+    Watch recovered {fs};
+    recovered.expected = watch.expected;
+    recovered.CheckDay(firstDay);
+    recovered.CheckDay(firstDay + 1);
+    std::array<Summary, 2> days;
+    CHECK_EQUAL(recovered.history.Days(firstDay, days.data(), days.size()), 2);
+    CHECK(days[0] == watch.ExpectedDay(firstDay));
+    CHECK(days[1] == watch.ExpectedDay(firstDay + 1));
+
+    // Written once : the next boot does not rebuild them again
+    Watch rebooted {fs};
+    rebooted.expected = watch.expected;
+    rebooted.CheckDay(firstDay);
+    CHECK_EQUAL(rebooted.history.Days(firstDay, days.data(), 1), 1);
+    CHECK(days[0] == watch.ExpectedDay(firstDay));
+
+    recovered.Record(start + minutesPerDay + 90, start + minutesPerDay + 130);
+    recovered.history.Flush();
+    Watch last {fs};
+    last.expected = recovered.expected;
+    last.CheckDay(firstDay + 1);
+  }
+
+  // A reset while a record was written : the record is incomplete or its CRC is wrong. The minutes before it are kept,
+  // and the next records are written in its place.
+  void TestTornRecord() {
+    const uint32_t start = firstDay * minutesPerDay;
+    for (size_t cut : {0, 1, 3, 10}) {
+      FS fs;
+      Watch watch {fs};
+      watch.Record(start, start + 10 * 60 + 30);
+      watch.history.Flush();
+      auto& data = fs.files.at(DayFileName(firstDay));
+      if (cut == 0) {
+        data[data.size() - 4] ^= 0x01;
+      } else {
+        data.resize(data.size() - cut);
+      }
+      // The last record holds the minutes since 10:00
+      for (uint32_t minute = start + 10 * 60; minute < start + 10 * 60 + 30; minute++) {
+        watch.expected.erase(minute);
+      }
+
+      Watch recovered {fs};
+      recovered.expected = watch.expected;
+      recovered.CheckDay(firstDay);
+      uint32_t begin;
+      uint32_t end;
+      recovered.history.RecordedRange(begin, end);
+      CHECK_EQUAL(end, start + 10 * 60);
+
+      recovered.Record(start + 10 * 60 + 40, start + 11 * 60 + 5);
+      recovered.history.Flush();
+      Watch rebooted {fs};
+      rebooted.expected = recovered.expected;
+      rebooted.CheckDay(firstDay);
+      std::array<Summary, 1> days;
+      rebooted.history.Days(firstDay, days.data(), days.size());
+      CHECK(days[0] == recovered.ExpectedDay(firstDay));
+    }
+  }
+
+  // The files of the days are a ring of 32 days, the summaries of the days a ring of 366 slots
+  void TestWrap() {
+    FS fs;
+    Watch watch {fs};
+    // The summary of the last day is still in RAM
+    constexpr uint32_t nbDays = ActivityHistory::nbDays + 2;
+    for (uint32_t day = firstDay; day < firstDay + nbDays; day++) {
+      uint32_t noon = day * minutesPerDay + 12 * 60;
+      for (uint32_t minute = noon; minute < noon + 5; minute++) {
+        watch.Record(minute, {static_cast<uint16_t>(1 + day % 100), static_cast<uint8_t>(60 + day % 50)});
+      }
+    }
+    watch.history.Flush();
+    const uint32_t lastDay = firstDay + nbDays - 1;
+
+    size_t nbDayFiles = std::count_if(fs.files.begin(), fs.files.end(), [](const auto& file) {
+      return file.first != daysFileName && file.first.find("/.system/activity/day") == 0;
+    });
+    CHECK_EQUAL(nbDayFiles, ActivityHistory::nbDetailedDays);
+    CHECK_EQUAL(fs.files.at(daysFileName).size(), ActivityHistory::nbDays * 16);
+
+    // The oldest detailed day, and the one before, whose file was reused
+    watch.CheckDay(lastDay - (ActivityHistory::nbDetailedDays - 1));
+    std::array<Minute, 5> minutes;
+    CHECK_EQUAL(watch.history.Minutes(lastDay - ActivityHistory::nbDetailedDays, 12 * 60, minutes.data(), minutes.size()), 0);
+    std::array<Summary, 24> hours;
+    CHECK_EQUAL(watch.history.Hours(lastDay - ActivityHistory::nbDetailedDays, hours), 0);
+    uint32_t begin;
+    uint32_t end;
+    watch.history.RecordedRange(begin, end);
+    CHECK_EQUAL(begin, (lastDay - (ActivityHistory::nbDetailedDays - 1)) * minutesPerDay);
+    CHECK_EQUAL(end, lastDay * minutesPerDay + 12 * 60 + 5);
+
+    // The last 366 days, read across the end of the ring. The slot of the first day was reused.
+    std::vector<Summary> days(ActivityHistory::nbDays);
+    CHECK_EQUAL(watch.history.Days(firstDay + 1, days.data(), days.size()), ActivityHistory::nbDays);
+    for (uint32_t i = 0; i < days.size(); i++) {
+      CHECK(days[i] == watch.ExpectedDay(firstDay + 1 + i));
+    }
+    CHECK_EQUAL(watch.history.Days(firstDay, days.data(), 1), 0);
+
+    Watch reloaded {fs};
+    CHECK_EQUAL(reloaded.history.Days(firstDay + 1, days.data(), days.size()), ActivityHistory::nbDays);
+    for (uint32_t i = 0; i < days.size(); i++) {
+      CHECK(days[i] == watch.ExpectedDay(firstDay + 1 + i));
+    }
+  }
+}
+
+int main() {
+  TestRollUp();
+  TestRecover();
+  TestTornRecord();
+  TestWrap();
+  return Test::Result();
+}
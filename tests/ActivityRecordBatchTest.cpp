@@ -0,0 +1,228 @@
+#include "components/ble/ActivityRecordBatch.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+using Minute = ActivityHistory::Minute;
+
+namespace {
+  struct Decoded {
+    bool isEnd;
+    uint32_t firstMinute;
+    std::vector<Minute> minutes;
+  };
+
+  // Decodes a batch as described in doc/ActivitySyncService.md
+  Decoded Decode(const uint8_t* data, size_t size) {
+    size_t offset = 0;
+    auto next = [&]() -> uint8_t {
+      CHECK(offset < size);
+      return offset < size ? data[offset++] : 0;
+    };
+    auto varint = [&]() {
+      uint32_t value = 0;
+      for (int shift = 0;; shift += 7) {
+        uint8_t byte = next();
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+          return value;
+        }
+      }
+    };
+
+    Decoded decoded;
+    decoded.isEnd = (next() & ActivityRecordBatch::flagEnd) != 0;
+    uint16_t count = next();
+    count |= static_cast<uint16_t>(next() << 8);
+    decoded.firstMinute = 0;
+    for (int i = 0; i < 4; i++) {
+      decoded.firstMinute |= static_cast<uint32_t>(next()) << (8 * i);
+    }
+    uint8_t heartRate = 0;
+    while (decoded.minutes.size() < count && offset < size) {
+      uint32_t value = varint();
+      if (value == 0) {
+        decoded.minutes.insert(decoded.minutes.end(), varint() + 1, Minute {});
+        continue;
+      }
+      Minute minute {static_cast<uint16_t>(value >> 1), 0};
+      if ((value & 1) != 0) {
+        uint32_t delta = varint();
+        heartRate = static_cast<uint8_t>(heartRate + ((delta >> 1) ^ -(delta & 1)));
+        minute.heartRate = heartRate;
+      }
+      decoded.minutes.push_back(minute);
+    }
+    CHECK_EQUAL(decoded.minutes.size(), count);
+    CHECK_EQUAL(offset, size);
+    return decoded;
+  }
+
+  bool Equal(const std::vector<Minute>& a, const std::vector<Minute>& b) {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+      if (a[i].steps != b[i].steps || a[i].heartRate != b[i].heartRate) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // A day of minutes : nights without activity, walks, heart rate readings with large variations, and extreme values
+  std::vector<Minute> History() {
+    std::vector<Minute> minutes;
+    uint32_t state = 7;
+    auto random = [&state]() {
+      state = state * 1664525 + 1013904223;
+      return state >> 8;
+    };
+    for (uint32_t minute = 0; minute < 1440; minute++) {
+      Minute value {};
+      bool night = minute < 420 || minute > 1380;
+      if (!night && random() % 3 != 0) {
+        value.steps = static_cast<uint16_t>(random() % (minute % 97 == 0 ? 65536 : 150));
+      }
+      if (random() % 4 == 0) {
+        value.heartRate = static_cast<uint8_t>(minute % 50 == 0 ? 255 : 40 + random() % 150);
+      }
+      minutes.push_back(value);
+    }
+    return minutes;
+  }
+
+  struct Batch {
+    std::vector<uint8_t> data;
+    std::vector<Minute> minutes;
+    uint32_t firstMinute;
+    bool isEnd;
+  };
+
+  // Packs the minutes in batches of at most sizeLimit bytes, the way ActivitySyncService sends them
+  std::vector<Batch> Pack(const std::vector<Minute>& minutes, uint32_t firstMinute, size_t sizeLimit) {
+    std::vector<Batch> batches;
+    ActivityRecordBatch batch;
+    std::vector<Minute> batchMinutes;
+    auto send = [&](bool isEnd) {
+      batch.Finish(isEnd);
+      batches.push_back({std::vector<uint8_t>(batch.Data(), batch.Data() + batch.Size()), batchMinutes, batch.FirstMinute(), isEnd});
+      CHECK_EQUAL(batch.NextMinute(), batch.FirstMinute() + batchMinutes.size());
+      batchMinutes.clear();
+    };
+
+    batch.Start(firstMinute);
+    for (size_t i = 0; i < minutes.size(); i++) {
+      if (!batch.Append(minutes[i], sizeLimit)) {
+        send(false);
+        batch.Start(firstMinute + i);
+        CHECK(batch.Append(minutes[i], sizeLimit));
+      }
+      batchMinutes.push_back(minutes[i]);
+    }
+    send(true);
+    return batches;
+  }
+
+  void CheckRoundTrip(size_t sizeLimit) {
+    auto minutes = History();
+    constexpr uint32_t firstMinute = 28000000;
+    auto batches = Pack(minutes, firstMinute, sizeLimit);
+    CHECK(batches.size() > 1);
+
+    uint32_t expectedFirst = firstMinute;
+    std::vector<Minute> decoded;
+    for (size_t i = 0; i < batches.size(); i++) {
+      CHECK(batches[i].data.size() <= sizeLimit);
+      auto result = Decode(batches[i].data.data(), batches[i].data.size());
+      CHECK_EQUAL(result.firstMinute, expectedFirst);
+      CHECK_EQUAL(result.isEnd, i + 1 == batches.size());
+      expectedFirst += result.minutes.size();
+      decoded.insert(decoded.end(), result.minutes.begin(), result.minutes.end());
+    }
+    CHECK(Equal(decoded, minutes));
+  }
+
+  void TestRoundTrip() {
+    CheckRoundTrip(20);
+    CheckRoundTrip(ActivityRecordBatch::maxSize);
+  }
+
+  void TestRuns() {
+    ActivityRecordBatch batch;
+    batch.Start(100);
+    // Runs longer than 128 minutes take a 2 bytes varint
+    for (int i = 0; i < 300; i++) {
+      CHECK(batch.Append({}, ActivityRecordBatch::maxSize));
+    }
+    CHECK(batch.Append({12, 0}, ActivityRecordBatch::maxSize));
+    for (int i = 0; i < 5; i++) {
+      CHECK(batch.Append({}, ActivityRecordBatch::maxSize));
+    }
+    // The last run is written by Finish()
+    batch.Finish(false);
+    CHECK_EQUAL(batch.Size(), ActivityRecordBatch::headerSize + 3 + 1 + 2);
+    auto decoded = Decode(batch.Data(), batch.Size());
+    CHECK_EQUAL(decoded.minutes.size(), 306);
+    CHECK_EQUAL(decoded.minutes[300].steps, 12);
+    CHECK_EQUAL(batch.NextMinute(), 406);
+  }
+
+  void TestEmptyBatch() {
+    ActivityRecordBatch batch;
+    batch.Start(5000);
+    batch.Finish(true);
+    CHECK_EQUAL(batch.Size(), ActivityRecordBatch::headerSize);
+    auto decoded = Decode(batch.Data(), batch.Size());
+    CHECK(decoded.isEnd);
+    CHECK_EQUAL(decoded.firstMinute, 5000);
+    CHECK(decoded.minutes.empty());
+  }
+
+  void TestSizeLimit() {
+    ActivityRecordBatch batch;
+    // Not started
+    CHECK(!batch.Append({1, 0}, ActivityRecordBatch::maxSize));
+
+    // A minute that does not fit is not written, including the run before it
+    batch.Start(0);
+    CHECK(batch.Append({}, 10));
+    CHECK(!batch.Append({1000, 0}, 10));
+    CHECK(batch.Append({1, 0}, 10));
+    batch.Finish(false);
+    CHECK_EQUAL(batch.Size(), 10);
+    auto decoded = Decode(batch.Data(), batch.Size());
+    CHECK_EQUAL(decoded.minutes.size(), 2);
+    CHECK_EQUAL(decoded.minutes[1].steps, 1);
+  }
+
+  // Prints the batches of the round trip test and the minutes they contain, for tools/activity_sync_decode.py
+  void Dump() {
+    auto minutes = History();
+    for (const auto& batch : Pack(minutes, 28000000, 60)) {
+      for (uint8_t byte : batch.data) {
+        std::printf("%02x", byte);
+      }
+      std::printf(" %u %d", static_cast<unsigned>(batch.firstMinute), batch.isEnd ? 1 : 0);
+      for (const auto& minute : batch.minutes) {
+        std::printf(" %u:%u", minute.steps, minute.heartRate);
+      }
+      std::printf("\n");
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1 && std::strcmp(argv[1], "--dump") == 0) {
+    Dump();
+    return Test::Result();
+  }
+  TestRoundTrip();
+  TestRuns();
+  TestEmptyBatch();
+  TestSizeLimit();
+  return Test::Result();
+}
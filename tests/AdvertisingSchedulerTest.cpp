@@ -0,0 +1,227 @@
+#include "components/ble/AdvertisingScheduler.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+using Events = AdvertisingScheduler::Events;
+using Parameters = AdvertisingScheduler::Parameters;
+
+namespace {
+  // Charge of an advertising event on the 3 channels, estimated from the figures of the nRF52832 product specification
+  // (DC/DC enabled, 0dBm) : per channel, 140us of ramp-up at 5mA, the packet sent at 5.3mA (8us per byte) and 150us
+  // of reception at 5.4mA for the scan and connection requests, plus 300us of CPU at 3mA for the event.
+  constexpr double EventCharge(int payloadBytes) {
+    // Preamble, access address, header, advertiser address and CRC
+    constexpr int overheadBytes = 1 + 4 + 2 + 6 + 3;
+    double perChannel = 140e-6 * 5e-3 + (overheadBytes + payloadBytes) * 8e-6 * 5.3e-3 + 150e-6 * 5.4e-3;
+    return 3 * perChannel + 300e-6 * 3e-3;
+  }
+
+  // Flags (3), heart rate service UUID (4), DFU service UUID (18), TX power (3)
+  constexpr double fullPayloadCharge = EventCharge(28);
+  constexpr double flagsOnlyCharge = EventCharge(3);
+
+  // Average current while advertising with these parameters, in µA. The controller adds a random delay of 0 to 10ms
+  // to each interval.
+  double Current(uint16_t intervalMin, uint16_t intervalMax, bool fullPayload) {
+    double period = (intervalMin + intervalMax) / 2.0 * 0.625e-3 + 5e-3;
+    return (fullPayload ? fullPayloadCharge : flagsOnlyCharge) / period * 1e6;
+  }
+
+  // The policy before AdvertisingScheduler : 30s at 20ms after each event, then 1022.5ms, always the full payload.
+  // Advertising was restarted every 2s to count the fast periods.
+  class Baseline {
+  public:
+    void OnEvent(Events /*event*/) {
+      fastAdvCount = 0;
+    }
+
+    Parameters Next(bool /*hasBonds*/) {
+      if (fastAdvCount < 15) {
+        fastAdvCount++;
+        return {32, 47, 2000, true};
+      }
+      return {1636, 1651, 2000, true};
+    }
+
+  private:
+    uint8_t fastAdvCount = 0;
+  };
+
+  struct Period {
+    int64_t startMs;
+    Parameters parameters;
+  };
+
+  // Advertising without connection from 0 to endMs : the scheduler is notified of the events at the given times, which
+  // restart the advertising like NimbleController does. Returns the periods, and the average current in µA.
+  template <typename Scheduler>
+  double Simulate(Scheduler& scheduler,
+                  bool hasBonds,
+                  const std::vector<std::pair<int64_t, Events>>& events,
+                  int64_t endMs,
+                  std::vector<Period>* periods = nullptr) {
+    double charge = 0; // µA.ms
+    int64_t time = 0;
+    size_t nextEvent = 0;
+    while (time < endMs) {
+      while (nextEvent < events.size() && events[nextEvent].first <= time) {
+        scheduler.OnEvent(events[nextEvent].second);
+        nextEvent++;
+      }
+      auto parameters = scheduler.Next(hasBonds);
+      if (periods != nullptr) {
+        periods->push_back({time, parameters});
+      }
+      int64_t end = parameters.durationMs == 0 ? endMs : std::min(endMs, time + parameters.durationMs);
+      if (nextEvent < events.size()) {
+        end = std::min(end, events[nextEvent].first);
+      }
+      charge += Current(parameters.intervalMin, parameters.intervalMax, parameters.fullPayload) * static_cast<double>(end - time);
+      time = end;
+    }
+    return charge / static_cast<double>(endMs);
+  }
+
+  constexpr int64_t second = 1000;
+  constexpr int64_t minute = 60 * second;
+  constexpr int64_t hour = 60 * minute;
+
+  // Intervals and payloads after a disconnection
+  void TestSchedule() {
+    AdvertisingScheduler scheduler;
+    std::vector<Period> periods;
+    Simulate(scheduler, true, {{0, Events::Disconnected}}, hour, &periods);
+
+    // Burst, 3 steps of back-off, then the slow interval until the next event : one call to ble_gap_adv_start() each
+    CHECK_EQUAL(periods.size(), 5);
+    const std::vector<int64_t> starts {0, 30 * second, 40 * second, 60 * second, 100 * second};
+    const std::vector<uint16_t> intervals {32, 244, 488, 976, 1636};
+    bool expected = true;
+    for (size_t i = 0; i < periods.size() && i < starts.size(); i++) {
+      expected = expected && periods[i].startMs == starts[i] && periods[i].parameters.intervalMin == intervals[i] &&
+                 periods[i].parameters.intervalMax == intervals[i] + 15;
+      // The interval doubles, and each step lasts twice as long as the previous one
+      if (i >= 2 && i + 1 < periods.size()) {
+        expected = expected && periods[i].parameters.durationMs == 2 * periods[i - 1].parameters.durationMs;
+      }
+    }
+    CHECK(expected);
+    CHECK_EQUAL(periods.back().parameters.durationMs, 0);
+    // The services are only advertised during the burst
+    CHECK(periods[0].parameters.fullPayload);
+    bool reduced = true;
+    for (size_t i = 1; i < periods.size(); i++) {
+      reduced = reduced && !periods[i].parameters.fullPayload;
+    }
+    CHECK(reduced);
+
+    // Without bond : always the full payload
+    AdvertisingScheduler notBonded;
+    periods.clear();
+    Simulate(notBonded, false, {{0, Events::Start}}, hour, &periods);
+    bool full = true;
+    for (const auto& period : periods) {
+      full = full && period.parameters.fullPayload;
+    }
+    CHECK(full);
+    CHECK_EQUAL(periods.size(), 5);
+
+    // The last step is repeated if the advertising is restarted without event
+    AdvertisingScheduler slow;
+    for (int i = 0; i < 10; i++) {
+      slow.Next(true);
+    }
+    CHECK_EQUAL(slow.Next(true).intervalMin, 1636);
+  }
+
+  // A wake-up restarts a shorter burst, from any step of the back-off, then the whole back-off
+  void TestRestart() {
+    AdvertisingScheduler scheduler;
+    std::vector<Period> periods;
+    Simulate(scheduler, true, {{0, Events::Start}, {45 * second, Events::WakeUp}, {10 * minute, Events::WakeUp}}, hour, &periods);
+
+    const std::vector<int64_t> starts {0, 30 * second, 40 * second, 45 * second, 55 * second, 65 * second, 85 * second, 125 * second};
+    bool restarted = periods.size() == starts.size() + 5;
+    for (size_t i = 0; i < starts.size() && i < periods.size(); i++) {
+      restarted = restarted && periods[i].startMs == starts[i];
+    }
+    CHECK(restarted);
+    CHECK_EQUAL(periods[3].parameters.intervalMin, 32);
+    CHECK_EQUAL(periods[3].parameters.durationMs, 10 * second);
+    CHECK(periods[3].parameters.fullPayload);
+    CHECK_EQUAL(periods[4].parameters.intervalMin, 244);
+    CHECK_EQUAL(periods[8].startMs, 10 * minute);
+    CHECK_EQUAL(periods[8].parameters.durationMs, 10 * second);
+
+    // A lost connection : a longer burst
+    scheduler.OnEvent(Events::Disconnected);
+    CHECK_EQUAL(scheduler.Next(true).durationMs, 30 * second);
+  }
+
+  struct Scenario {
+    const char* name;
+    bool hasBonds;
+    std::vector<std::pair<int64_t, Events>> events;
+    int64_t durationMs;
+  };
+
+  std::vector<std::pair<int64_t, Events>> WakeUps(Events first, int64_t period, int64_t end) {
+    std::vector<std::pair<int64_t, Events>> events {{0, first}};
+    for (int64_t time = period; time < end; time += period) {
+      events.push_back({time, Events::WakeUp});
+    }
+    return events;
+  }
+
+  // Average current of the advertising compared with the previous policy
+  void TestCurrent() {
+    const std::vector<Scenario> scenarios {
+      {"Disconnected, 5 min", true, {{0, Events::Disconnected}}, 5 * minute},
+      {"Disconnected, 1 h", true, {{0, Events::Disconnected}}, hour},
+      {"Disconnected, 1 h, not bonded", false, {{0, Events::Disconnected}}, hour},
+      {"Disconnected, 1 h, wake-up every 10 min", true, WakeUps(Events::Disconnected, 10 * minute, hour), hour},
+      {"Disconnected, 8 h, wake-up every 30 min", true, WakeUps(Events::Disconnected, 30 * minute, 8 * hour), 8 * hour},
+      {"Not bonded, 1 h, wake-up every 10 min", false, WakeUps(Events::Start, 10 * minute, hour), hour},
+    };
+
+    std::printf("Event charge : %.1fuC (full payload), %.1fuC (flags only)\n", fullPayloadCharge * 1e6, flagsOnlyCharge * 1e6);
+    std::printf("%-42s %9s %9s\n", "Average advertising current (uA)", "Baseline", "Adaptive");
+    for (const auto& scenario : scenarios) {
+      Baseline baseline;
+      AdvertisingScheduler scheduler;
+      double before = Simulate(baseline, scenario.hasBonds, scenario.events, scenario.durationMs);
+      double after = Simulate(scheduler, scenario.hasBonds, scenario.events, scenario.durationMs);
+      std::printf("%-42s %9.1f %9.1f\n", scenario.name, before, after);
+      // Once a phone is bonded, or when the watch is woken up, the shorter wake-up bursts and the reduced payload
+      // compensate for the back-off
+      if (scenario.hasBonds && scenario.durationMs >= hour) {
+        CHECK(after < before);
+      }
+      // Without bond, the back-off costs more than the slow advertising it replaces, but at most 5% on an hour
+      if (!scenario.hasBonds) {
+        CHECK(after < before * 1.05);
+      }
+    }
+
+    // Cost of a back-off : the charge above the slow interval during the 70s of the 3 steps
+    const std::vector<std::pair<uint16_t, int64_t>> steps {{244, 10 * second}, {488, 20 * second}, {976, 40 * second}};
+    double backOff = 0;
+    for (auto [interval, durationMs] : steps) {
+      backOff += (Current(interval, interval + 15, false) - Current(1636, 1651, false)) * static_cast<double>(durationMs);
+    }
+    std::printf("Back-off : %.2fmC above the slow interval\n", backOff * 1e-6);
+    CHECK(backOff * 1e-6 < 1.2);
+  }
+}
+
+int main() {
+  TestSchedule();
+  TestRestart();
+  TestCurrent();
+  return Test::Result();
+}
@@ -0,0 +1,189 @@
+#include "drivers/Bma421.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "drivers/TwiMaster.h"
+#include "Bma421Model.h"
+#include "Check.h"
+
+using namespace Pinetime::Drivers;
+using Sample = Bma421::Sample;
+
+namespace {
+  constexpr uint8_t address = 0x18;
+
+  // The sensor on the bus of the watch, initialized like SystemTask does
+  struct Sensor {
+    Sensor() {
+      twim.devices[address] = &model;
+      twim.interruptHandler = [this]() {
+        twiMaster.OnInterrupt();
+      };
+      Fakes::whileBlocked = [this]() {
+        twim.Run();
+      };
+      twiMaster.Init();
+      bma.SoftReset();
+      bma.Init();
+    }
+
+    ~Sensor() {
+      Fakes::whileBlocked = nullptr;
+    }
+
+    // Reads all the samples in the FIFO, like SystemTask does on the watermark interrupt
+    std::vector<Sample> Drain() {
+      std::vector<Sample> samples;
+      std::array<Sample, Bma421::maxSamplesPerRead> buffer {};
+      for (size_t nbSamples = bma.NbSamples(); nbSamples > 0; nbSamples = bma.NbSamples()) {
+        size_t nbRead = bma.ReadSamples(buffer.data(), std::min(nbSamples, buffer.size()));
+        if (nbRead == 0) {
+          break;
+        }
+        samples.insert(samples.end(), buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(nbRead));
+      }
+      return samples;
+    }
+
+    Fakes::Twim twim;
+    Fakes::Bma421 model;
+    TwiMaster twiMaster {&twim.registers, TWIM_FREQUENCY_FREQUENCY_K400, 6, 7};
+    Bma421 bma {twiMaster, address};
+  };
+
+  struct Counts {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+  };
+
+  // Synthetic recording of a wrist at rest then walking, in counts (1g = 1024 in the 2g range) : x around 0, where the
+  // values 0x0080 (8 counts) look like the pattern of an empty FIFO, y and z sharing the gravity.
+  std::vector<Counts> Recording(size_t nbSamples) {
+    std::vector<Counts> samples;
+    uint32_t noise = 12345;
+    for (size_t i = 0; i < nbSamples; i++) {
+      noise = noise * 1103515245 + 12345;
+      auto jitter = static_cast<int16_t>((noise >> 16) % 9) - 4;
+      auto swing = static_cast<int16_t>(i < 50 ? 0 : ((i % 50) < 25 ? 120 : -120));
+      samples.push_back(
+        {static_cast<int16_t>(8 + jitter), static_cast<int16_t>(-310 + swing + jitter), static_cast<int16_t>(-975 - jitter)});
+    }
+    return samples;
+  }
+
+  void Push(Sensor& sensor, const std::vector<Counts>& samples) {
+    for (const auto& sample : samples) {
+      sensor.model.Push(sample.x, sample.y, sample.z);
+    }
+  }
+
+  // Scaled to milli-g in the 2g range, x and y swapped
+  bool Matches(const std::vector<Sample>& samples, const std::vector<Counts>& expected) {
+    if (samples.size() != expected.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < samples.size(); i++) {
+      if (samples[i].x != expected[i].y || samples[i].y != expected[i].x || samples[i].z != expected[i].z) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void TestInit() {
+    Sensor sensor;
+    CHECK(sensor.bma.IsOk());
+    CHECK(sensor.bma.DeviceType() == Bma421::DeviceTypes::BMA421);
+    CHECK_EQUAL(sensor.model.nbResets, 1);
+
+    // The config file is uploaded in chunks accepted by the Bosch library, each in a single transfer
+    size_t uploaded = 0;
+    bool chunksFit = true;
+    for (size_t size : sensor.model.featureWrites) {
+      chunksFit = chunksFit && size <= Fakes::Bma421::featureSize && size <= TwiMaster::maxWriteSize;
+      uploaded += size;
+    }
+    CHECK(chunksFit);
+    CHECK(uploaded >= Fakes::Bma421::configSize);
+    CHECK_EQUAL(sensor.model.registers[Fakes::Bma421::InitCtrl], 1);
+
+    // Headerless FIFO of the accelerometer, watermark on INT1, latched
+    CHECK_EQUAL(sensor.model.registers[Fakes::Bma421::FifoConfig1], Fakes::Bma421::fifoAccel);
+    CHECK_EQUAL(sensor.model.Watermark(), Bma421::fifoWatermark * 6);
+    CHECK_EQUAL(sensor.model.registers[Fakes::Bma421::IntMapData], Fakes::Bma421::fifoWatermark);
+    CHECK_EQUAL(sensor.model.registers[Fakes::Bma421::Int1Map], 0);
+    CHECK_EQUAL(sensor.model.registers[Fakes::Bma421::IntLatch], 1);
+    CHECK_EQUAL(sensor.model.registers[Fakes::Bma421::Int1IoCtrl], 0x0a);
+    CHECK_EQUAL(sensor.model.registers[Fakes::Bma421::AccRange], 0);
+
+    // Features : the step counter, and the any-motion detection (threshold, duration and axes)
+    const uint8_t* features = &sensor.model.memory[Fakes::Bma421::configSize];
+    CHECK_EQUAL(features[0x3b] & 0x10, 0x10);
+    CHECK_EQUAL(features[0] | (features[1] << 8), 0x50);
+    CHECK_EQUAL(features[2] | (features[3] << 8), 2 | (7 << 13));
+  }
+
+  // The samples are read in bursts of at most 16, in order, and none is mistaken for the end of the FIFO
+  void TestReadSamples() {
+    Sensor sensor;
+    auto recording = Recording(100);
+    Push(sensor, std::vector<Counts>(recording.begin(), recording.begin() + 24));
+    CHECK(!sensor.model.Int1());
+    Push(sensor, std::vector<Counts>(recording.begin() + 24, recording.end()));
+    CHECK(sensor.model.Int1());
+    CHECK_EQUAL(sensor.bma.NbSamples(), 100);
+
+    size_t nbTransfers = sensor.twim.transfers.size();
+    auto samples = sensor.Drain();
+    CHECK(Matches(samples, recording));
+    CHECK_EQUAL(sensor.model.FifoLength(), 0);
+    // 7 bursts, and the length read before each of them and at the end
+    CHECK_EQUAL(sensor.twim.transfers.size() - nbTransfers, 7 + 8);
+
+    // The latched interrupt is cleared once the FIFO is drained
+    CHECK(sensor.model.Int1());
+    sensor.bma.ClearInterrupts();
+    CHECK(!sensor.model.Int1());
+
+    // Reading more samples than the FIFO holds : the frames read past the end are dropped
+    Push(sensor, std::vector<Counts>(recording.begin(), recording.begin() + 3));
+    std::array<Sample, Bma421::maxSamplesPerRead> buffer {};
+    CHECK_EQUAL(sensor.bma.ReadSamples(buffer.data(), 5), 3);
+    CHECK(Matches({buffer.begin(), buffer.begin() + 3}, {recording.begin(), recording.begin() + 3}));
+
+    // At most maxSamplesPerRead at once
+    Push(sensor, recording);
+    CHECK_EQUAL(sensor.bma.ReadSamples(buffer.data(), 100), Bma421::maxSamplesPerRead);
+  }
+
+  // Headerless : no config frame after a change of configuration, no skip frame on overflow, only the last samples kept
+  void TestFrames() {
+    Sensor sensor;
+    auto recording = Recording(200);
+    Push(sensor, std::vector<Counts>(recording.begin(), recording.begin() + 10));
+    const uint8_t accelConfig = 0xa8;
+    sensor.bma.Write(Fakes::Bma421::AccConf, &accelConfig, 1);
+    Push(sensor, std::vector<Counts>(recording.begin() + 10, recording.end()));
+
+    constexpr size_t capacity = Fakes::Bma421::fifoSize / 6;
+    CHECK_EQUAL(sensor.bma.NbSamples(), capacity);
+    CHECK(Matches(sensor.Drain(), {recording.end() - capacity, recording.end()}));
+
+    // Not initialized : nothing is read
+    Fakes::Twim twim;
+    TwiMaster twiMaster {&twim.registers, TWIM_FREQUENCY_FREQUENCY_K400, 6, 7};
+    Bma421 uninitialized {twiMaster, address};
+    std::array<Sample, 1> buffer {};
+    CHECK_EQUAL(uninitialized.NbSamples(), 0);
+    CHECK_EQUAL(uninitialized.ReadSamples(buffer.data(), buffer.size()), 0);
+    CHECK(twim.transfers.empty());
+  }
+}
+
+int main() {
+  TestInit();
+  TestReadSamples();
+  TestFrames();
+  return Test::Result();
+}
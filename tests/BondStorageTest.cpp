@@ -0,0 +1,411 @@
+#include "components/ble/BondStorage.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+#include "components/fs/FS.h"
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr const char* fileName = "/.system/bonds.dat";
+  constexpr const char* legacyFileName = "/bond.dat";
+
+  // RAM store of NimBLE : the keys and the CCCDs of the bonded peers
+  struct Store {
+    std::vector<ble_store_value_sec> ourSecs;
+    std::vector<ble_store_value_sec> peerSecs;
+    std::vector<ble_store_value_cccd> cccds;
+  };
+
+  Store store;
+
+  int ReadSec(const std::vector<ble_store_value_sec>& secs, const ble_store_key_sec* key, ble_store_value_sec* value) {
+    for (const auto& sec : secs) {
+      if (ble_addr_cmp(&sec.peer_addr, &key->peer_addr) == 0) {
+        *value = sec;
+        return 0;
+      }
+    }
+    return BLE_HS_ENOENT;
+  }
+
+  int WriteSec(std::vector<ble_store_value_sec>& secs, const ble_store_value_sec* value) {
+    for (auto& sec : secs) {
+      if (ble_addr_cmp(&sec.peer_addr, &value->peer_addr) == 0) {
+        sec = *value;
+        return 0;
+      }
+    }
+    secs.push_back(*value);
+    return 0;
+  }
+}
+
+int ble_store_read_our_sec(const struct ble_store_key_sec* key_sec, struct ble_store_value_sec* value_sec) {
+  return ReadSec(store.ourSecs, key_sec, value_sec);
+}
+
+int ble_store_read_peer_sec(const struct ble_store_key_sec* key_sec, struct ble_store_value_sec* value_sec) {
+  return ReadSec(store.peerSecs, key_sec, value_sec);
+}
+
+int ble_store_write_our_sec(const struct ble_store_value_sec* value_sec) {
+  return WriteSec(store.ourSecs, value_sec);
+}
+
+int ble_store_write_peer_sec(const struct ble_store_value_sec* value_sec) {
+  return WriteSec(store.peerSecs, value_sec);
+}
+
+// The CCCDs of the peer are read by index
+int ble_store_read_cccd(const struct ble_store_key_cccd* key, struct ble_store_value_cccd* out_value) {
+  uint8_t index = 0;
+  for (const auto& cccd : store.cccds) {
+    if (ble_addr_cmp(&cccd.peer_addr, &key->peer_addr) == 0 && index++ == key->idx) {
+      *out_value = cccd;
+      return 0;
+    }
+  }
+  return BLE_HS_ENOENT;
+}
+
+int ble_store_write_cccd(const struct ble_store_value_cccd* value) {
+  for (auto& cccd : store.cccds) {
+    if (ble_addr_cmp(&cccd.peer_addr, &value->peer_addr) == 0 && cccd.chr_val_handle == value->chr_val_handle) {
+      cccd = *value;
+      return 0;
+    }
+  }
+  store.cccds.push_back(*value);
+  return 0;
+}
+
+namespace {
+  ble_addr_t Address(uint8_t id) {
+    return {BLE_ADDR_PUBLIC, {id, 0x22, 0x33, 0x44, 0x55, 0x66}};
+  }
+
+  ble_store_value_sec Sec(uint8_t id, uint8_t key) {
+    ble_store_value_sec sec;
+    std::memset(&sec, 0, sizeof(sec));
+    sec.peer_addr = Address(id);
+    sec.key_size = 16;
+    sec.ediv = static_cast<uint16_t>(id * 100 + key);
+    sec.rand_num = 0x0123456789abcdef + key;
+    std::memset(sec.ltk, key, sizeof(sec.ltk));
+    sec.ltk_present = 1;
+    std::memset(sec.irk, id, sizeof(sec.irk));
+    sec.irk_present = 1;
+    sec.authenticated = 1;
+    sec.sc = 1;
+    return sec;
+  }
+
+  ble_store_value_cccd Cccd(uint8_t id, uint16_t handle) {
+    ble_store_value_cccd cccd;
+    std::memset(&cccd, 0, sizeof(cccd));
+    cccd.peer_addr = Address(id);
+    cccd.chr_val_handle = handle;
+    cccd.flags = BLE_GATT_CHR_F_NOTIFY;
+    return cccd;
+  }
+
+  // Pairing with the peer : NimBLE writes the keys and the subscriptions in its store
+  void Pair(uint8_t id, uint8_t key, uint8_t nbCccds) {
+    auto ourSec = Sec(id, static_cast<uint8_t>(key + 1));
+    auto peerSec = Sec(id, key);
+    ble_store_write_our_sec(&ourSec);
+    ble_store_write_peer_sec(&peerSec);
+    for (uint8_t i = 0; i < nbCccds; i++) {
+      auto cccd = Cccd(id, static_cast<uint16_t>(10 + 2 * i));
+      ble_store_write_cccd(&cccd);
+    }
+  }
+
+  void PairAndStore(BondStorage& bonds, uint8_t id, uint8_t key, uint8_t nbCccds = 2) {
+    Pair(id, key, nbCccds);
+    auto address = Address(id);
+    bonds.Store(address);
+  }
+
+  bool SameSec(const ble_store_value_sec& a, const ble_store_value_sec& b) {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+  }
+
+  // The bond of the peer is in the NimBLE store, with the given key and CCCDs
+  bool IsRestored(uint8_t id, uint8_t key, uint8_t nbCccds = 2) {
+    ble_store_key_sec secKey;
+    std::memset(&secKey, 0, sizeof(secKey));
+    secKey.peer_addr = Address(id);
+    ble_store_value_sec ourSec;
+    ble_store_value_sec peerSec;
+    if (ble_store_read_our_sec(&secKey, &ourSec) != 0 || ble_store_read_peer_sec(&secKey, &peerSec) != 0) {
+      return false;
+    }
+    bool same = SameSec(ourSec, Sec(id, static_cast<uint8_t>(key + 1))) && SameSec(peerSec, Sec(id, key));
+
+    ble_store_key_cccd cccdKey;
+    std::memset(&cccdKey, 0, sizeof(cccdKey));
+    cccdKey.peer_addr = Address(id);
+    uint8_t nbRestored = 0;
+    ble_store_value_cccd cccd;
+    for (cccdKey.idx = 0; ble_store_read_cccd(&cccdKey, &cccd) == 0; cccdKey.idx++) {
+      same = same && cccd.chr_val_handle == 10 + 2 * nbRestored;
+      nbRestored++;
+    }
+    return same && nbRestored == nbCccds;
+  }
+
+  bool IsRestored(uint8_t id) {
+    ble_store_key_sec secKey;
+    std::memset(&secKey, 0, sizeof(secKey));
+    secKey.peer_addr = Address(id);
+    ble_store_value_sec sec;
+    return ble_store_read_peer_sec(&secKey, &sec) == 0;
+  }
+
+  // Reset of the watch : the NimBLE store is empty, the bonds are restored from the file
+  void Reboot(FS& fs, std::optional<BondStorage>& bonds) {
+    store = {};
+    bonds.emplace(fs);
+    bonds->Restore();
+  }
+
+  size_t SlotSize(const FS& fs) {
+    return fs.files.at(fileName).size() / BondStorage::MaxBonds;
+  }
+
+  void TestAddAndRestore() {
+    FS fs;
+    std::optional<BondStorage> bonds;
+    Reboot(fs, bonds);
+    CHECK(fs.files.count(fileName) == 0);
+
+    PairAndStore(*bonds, 1, 10);
+    PairAndStore(*bonds, 2, 20, BondStorage::MaxCccds);
+    auto address = Address(1);
+    CHECK(bonds->IsUpToDate(address));
+    address = Address(3);
+    CHECK(!bonds->IsUpToDate(address));
+    bonds->Store(address);
+    CHECK(!bonds->IsUpToDate(address));
+
+    Reboot(fs, bonds);
+    CHECK(IsRestored(1, 10));
+    CHECK(IsRestored(2, 20, BondStorage::MaxCccds));
+    CHECK(!IsRestored(3));
+    address = Address(2);
+    CHECK(bonds->IsUpToDate(address));
+  }
+
+  // A new subscription or new keys : the slot of the peer is written again
+  void TestReplace() {
+    FS fs;
+    std::optional<BondStorage> bonds;
+    Reboot(fs, bonds);
+    PairAndStore(*bonds, 1, 10);
+    PairAndStore(*bonds, 2, 20);
+    auto file = fs.files[fileName];
+
+    auto address = Address(1);
+    auto cccd = Cccd(1, 14);
+    ble_store_write_cccd(&cccd);
+    CHECK(!bonds->IsUpToDate(address));
+    bonds->Store(address);
+    CHECK(bonds->IsUpToDate(address));
+    // Only the slot of the peer changed
+    auto& updated = fs.files[fileName];
+    size_t slotSize = file.size() / 2;
+    CHECK_EQUAL(updated.size(), file.size());
+    CHECK(std::equal(file.begin() + slotSize, file.end(), updated.begin() + slotSize));
+    CHECK(!std::equal(file.begin(), file.begin() + slotSize, updated.begin()));
+
+    // Paired again, with other keys
+    store = {};
+    Pair(1, 11, 1);
+    CHECK(!bonds->IsUpToDate(address));
+    bonds->Store(address);
+    Reboot(fs, bonds);
+    CHECK(IsRestored(1, 11, 1));
+    CHECK(IsRestored(2, 20));
+  }
+
+  // The table is full : the bond stored first is replaced, even after a reset
+  void TestEvictOldest() {
+    FS fs;
+    std::optional<BondStorage> bonds;
+    Reboot(fs, bonds);
+    for (uint8_t id = 1; id <= BondStorage::MaxBonds; id++) {
+      PairAndStore(*bonds, id, static_cast<uint8_t>(10 * id));
+    }
+    const size_t fileSize = fs.files[fileName].size();
+
+    // Bond 1 is updated : bond 2 becomes the oldest one
+    auto cccd = Cccd(1, 14);
+    ble_store_write_cccd(&cccd);
+    auto address = Address(1);
+    bonds->Store(address);
+    Reboot(fs, bonds);
+
+    PairAndStore(*bonds, 9, 90);
+    CHECK_EQUAL(fs.files[fileName].size(), fileSize);
+    Reboot(fs, bonds);
+    CHECK(IsRestored(1, 10, 3));
+    CHECK(!IsRestored(2));
+    CHECK(IsRestored(3, 30));
+    CHECK(IsRestored(9, 90));
+
+    // Then bond 3
+    PairAndStore(*bonds, 8, 80);
+    Reboot(fs, bonds);
+    CHECK(!IsRestored(3));
+    CHECK(IsRestored(1, 10, 3));
+    CHECK(IsRestored(8, 80));
+    CHECK(IsRestored(9, 90));
+  }
+
+  // A corrupted slot is dropped alone, and reused for the next bond
+  void TestCorruptedSlot() {
+    FS fs;
+    std::optional<BondStorage> bonds;
+    Reboot(fs, bonds);
+    for (uint8_t id = 1; id <= BondStorage::MaxBonds; id++) {
+      PairAndStore(*bonds, id, static_cast<uint8_t>(10 * id));
+    }
+    const auto file = fs.files[fileName];
+    const size_t slotSize = SlotSize(fs);
+
+    // A bit flipped in the keys of bond 2
+    fs.files[fileName][slotSize + 20] ^= 0x04;
+    Reboot(fs, bonds);
+    CHECK(IsRestored(1, 10));
+    CHECK(!IsRestored(2));
+    CHECK(IsRestored(3, 30));
+
+    // Bond 2 was the oldest valid one : its slot is free and is used by the new bond, bond 1 is kept
+    PairAndStore(*bonds, 4, 40);
+    Reboot(fs, bonds);
+    CHECK(IsRestored(1, 10));
+    CHECK(IsRestored(3, 30));
+    CHECK(IsRestored(4, 40));
+
+    // Another version of the format, a CRC that does not match, a truncated file
+    for (size_t offset : {size_t {2}, size_t {0}}) {
+      fs.files[fileName] = file;
+      fs.files[fileName][offset] ^= 0x01;
+      Reboot(fs, bonds);
+      CHECK(!IsRestored(1));
+      CHECK(IsRestored(2, 20));
+    }
+    fs.files[fileName] = file;
+    fs.files[fileName].resize(file.size() - 1);
+    Reboot(fs, bonds);
+    CHECK(IsRestored(1, 10));
+    CHECK(IsRestored(2, 20));
+    CHECK(!IsRestored(3));
+  }
+
+  void TestRemove() {
+    FS fs;
+    std::optional<BondStorage> bonds;
+    Reboot(fs, bonds);
+    PairAndStore(*bonds, 1, 10);
+    PairAndStore(*bonds, 2, 20);
+    auto address = Address(1);
+    bonds->Remove(address);
+    CHECK(!bonds->IsUpToDate(address));
+    // Not in the table : ignored
+    address = Address(5);
+    bonds->Remove(address);
+
+    Reboot(fs, bonds);
+    CHECK(!IsRestored(1));
+    CHECK(IsRestored(2, 20));
+
+    // The free slot is used before the oldest bond is replaced
+    for (uint8_t id = 3; id <= BondStorage::MaxBonds + 1; id++) {
+      PairAndStore(*bonds, id, static_cast<uint8_t>(10 * id));
+    }
+    Reboot(fs, bonds);
+    CHECK(IsRestored(2, 20));
+    for (uint8_t id = 3; id <= BondStorage::MaxBonds + 1; id++) {
+      CHECK(IsRestored(id, static_cast<uint8_t>(10 * id)));
+    }
+  }
+
+  // The bond file of the previous versions : our keys, the keys of the peer, the number of CCCDs and the CCCDs
+  std::vector<uint8_t> LegacyFile(uint8_t id, uint8_t key, uint8_t nbCccds) {
+    std::vector<uint8_t> file;
+    auto append = [&file](const void* data, size_t size) {
+      file.insert(file.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+    };
+    union ble_store_value ourSec, peerSec;
+    std::memset(&ourSec, 0, sizeof(ourSec));
+    std::memset(&peerSec, 0, sizeof(peerSec));
+    ourSec.sec = Sec(id, static_cast<uint8_t>(key + 1));
+    peerSec.sec = Sec(id, key);
+    append(&ourSec, sizeof(ourSec));
+    append(&peerSec, sizeof(peerSec));
+    append(&nbCccds, 1);
+    for (uint8_t i = 0; i < nbCccds; i++) {
+      auto cccd = Cccd(id, static_cast<uint16_t>(10 + 2 * i));
+      append(&cccd, sizeof(cccd));
+    }
+    return file;
+  }
+
+  void TestLegacyMigration() {
+    FS fs;
+    fs.files[legacyFileName] = LegacyFile(7, 70, 3);
+    std::optional<BondStorage> bonds;
+    Reboot(fs, bonds);
+    CHECK(IsRestored(7, 70, 3));
+    CHECK(fs.files.count(legacyFileName) == 0);
+    CHECK(fs.files.count(fileName) == 1);
+    auto address = Address(7);
+    CHECK(bonds->IsUpToDate(address));
+
+    Reboot(fs, bonds);
+    CHECK(IsRestored(7, 70, 3));
+
+    // With a full table : the oldest bond is replaced by the legacy one
+    FS fullFs;
+    std::optional<BondStorage> full;
+    Reboot(fullFs, full);
+    for (uint8_t id = 1; id <= BondStorage::MaxBonds; id++) {
+      PairAndStore(*full, id, static_cast<uint8_t>(10 * id));
+    }
+    fullFs.files[legacyFileName] = LegacyFile(7, 70, 1);
+    Reboot(fullFs, full);
+    CHECK(IsRestored(7, 70, 1));
+    Reboot(fullFs, full);
+    CHECK(IsRestored(7, 70, 1));
+    CHECK(!IsRestored(1));
+    CHECK(IsRestored(2, 20));
+
+    // Truncated : no bond with null keys, the file is removed
+    for (size_t size : {size_t {10}, sizeof(ble_store_value) + 10, 2 * sizeof(ble_store_value)}) {
+      FS truncatedFs;
+      truncatedFs.files[legacyFileName] = LegacyFile(7, 70, 3);
+      truncatedFs.files[legacyFileName].resize(size);
+      std::optional<BondStorage> truncated;
+      Reboot(truncatedFs, truncated);
+      CHECK(store.ourSecs.empty() && store.peerSecs.empty() && store.cccds.empty());
+      CHECK(truncatedFs.files.count(legacyFileName) == 0);
+      CHECK(truncatedFs.files.count(fileName) == 0);
+    }
+  }
+}
+
+int main() {
+  TestAddAndRestore();
+  TestReplace();
+  TestEvictOldest();
+  TestCorruptedSlot();
+  TestRemove();
+  TestLegacyMigration();
+  return Test::Result();
+}
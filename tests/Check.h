@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdio>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+
+// Minimal assertions for the host tests. A failed check is reported and the test goes on, so that all the failures
+// are listed in one run. main() returns Test::Result().
+namespace Test {
+  inline int failures = 0;
+
+  inline bool Check(bool condition, const char* expression, const char* file, int line) {
+    if (!condition) {
+      failures++;
+      std::cerr << file << ":" << line << ": CHECK(" << expression << ") failed\n";
+    }
+    return condition;
+  }
+
+  template <typename T>
+  constexpr bool IsNumber = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+  // Integers are printed as numbers, including uint8_t and int8_t
+  template <typename T>
+  auto Printable(const T& value) {
+    if constexpr (std::is_enum_v<T>) {
+      return static_cast<long long>(value);
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+      return static_cast<long long>(value);
+    } else if constexpr (std::is_integral_v<T>) {
+      return static_cast<unsigned long long>(value);
+    } else {
+      return value;
+    }
+  }
+
+  template <typename A, typename B>
+  bool CheckEqual(const A& actual, const B& expected, const char* expression, const char* file, int line) {
+    bool equal;
+    if constexpr (IsNumber<A> && IsNumber<B>) {
+      equal = std::cmp_equal(actual, expected);
+    } else {
+      equal = (actual == expected);
+    }
+    if (!equal) {
+      failures++;
+      std::cerr << file << ":" << line << ": CHECK_EQUAL(" << expression << ") failed: " << Printable(actual)
+                << " != " << Printable(expected) << "\n";
+    }
+    return equal;
+  }
+
+  inline int Result() {
+    if (failures > 0) {
+      std::cerr << failures << " check(s) failed\n";
+      return 1;
+    }
+    return 0;
+  }
+}
+
+#define CHECK(condition) Test::Check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) Test::CheckEqual((actual), (expected), #actual ", " #expected, __FILE__, __LINE__)
@@ -0,0 +1,201 @@
+#include "components/datetime/ClockDrift.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "components/fs/FS.h"
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+using namespace std::chrono_literals;
+
+namespace {
+  constexpr const char* fileName = "/.system/clockdrift.dat";
+
+  // Emulates an RTC with a constant frequency error, synchronised against an exact reference
+  class Clock {
+  public:
+    explicit Clock(ClockDrift& drift, int64_t ppb) : drift {drift}, ppb {ppb} {
+    }
+
+    void Synchronise(std::chrono::nanoseconds elapsed) {
+      reference += elapsed;
+      raw += elapsed + std::chrono::nanoseconds(elapsed.count() / 1000 * ppb / 1000000);
+      drift.OnSynchronised(raw, reference);
+    }
+
+    void SetPpb(int64_t value) {
+      ppb = value;
+    }
+
+    // The reference jumps, without a change of the raw time
+    void JumpReference(std::chrono::nanoseconds offset) {
+      reference += offset;
+    }
+
+  private:
+    ClockDrift& drift;
+    int64_t ppb;
+    std::chrono::nanoseconds raw {5s};
+    std::chrono::nanoseconds reference {1700000000s};
+  };
+
+  bool Near(int32_t value, int32_t expected, int32_t tolerance = 1) {
+    return std::abs(value - expected) <= tolerance;
+  }
+
+  void TestMeasurement() {
+    FS fs;
+    ClockDrift drift(fs);
+    Clock clock(drift, 20000);
+
+    // The first synchronisation is the anchor, the span must be long enough before measuring
+    clock.Synchronise(0s);
+    CHECK_EQUAL(drift.Ppb(), 0);
+    clock.Synchronise(5h);
+    CHECK_EQUAL(drift.Ppb(), 0);
+    CHECK(!drift.IsDirty());
+
+    clock.Synchronise(7h);
+    CHECK(Near(drift.Ppb(), 20000));
+    CHECK(drift.IsDirty());
+
+    // Negative drift (slow RTC)
+    FS otherFs;
+    ClockDrift slowDrift(otherFs);
+    Clock slowClock(slowDrift, -35000);
+    slowClock.Synchronise(0s);
+    slowClock.Synchronise(12h);
+    CHECK(Near(slowDrift.Ppb(), -35000));
+  }
+
+  void TestReferenceJump() {
+    FS fs;
+    ClockDrift drift(fs);
+    Clock clock(drift, 10000);
+    clock.Synchronise(0s);
+    clock.Synchronise(12h);
+    CHECK(Near(drift.Ppb(), 10000));
+
+    // Time zone change : dropped, and the anchor is restarted
+    clock.JumpReference(1h);
+    clock.Synchronise(12h);
+    CHECK(Near(drift.Ppb(), 10000));
+
+    // The anchor was moved to the jump : the next measurement does not include it. There is no prior yet (less than
+    // maxSpan), so the estimate is the last measurement.
+    clock.SetPpb(12000);
+    clock.Synchronise(12h);
+    CHECK(Near(drift.Ppb(), 12000));
+
+    // Back in time : the anchor is restarted
+    clock.JumpReference(-24h);
+    clock.Synchronise(1h);
+    int32_t before = drift.Ppb();
+    clock.Synchronise(3h);
+    CHECK_EQUAL(drift.Ppb(), before);
+  }
+
+  void TestRestart() {
+    FS fs;
+    ClockDrift drift(fs);
+    Clock clock(drift, 10000);
+    clock.Synchronise(0s);
+    // The time was set manually : the next synchronisation is a new anchor
+    drift.Restart();
+    clock.JumpReference(10min);
+    clock.Synchronise(1h);
+    clock.Synchronise(12h);
+    CHECK(Near(drift.Ppb(), 10000));
+  }
+
+  void TestPrior() {
+    FS fs;
+    ClockDrift drift(fs);
+    Clock clock(drift, 20000);
+    clock.Synchronise(0s);
+    // After a week, the estimate becomes the prior, with the weight of a week
+    clock.Synchronise(7 * 24h);
+    CHECK(Near(drift.Ppb(), 20000));
+
+    // Another week at another drift : averaged with the same weight
+    clock.SetPpb(10000);
+    clock.Synchronise(7 * 24h);
+    CHECK(Near(drift.Ppb(), 15000));
+
+    // A short span has a much smaller weight than the prior
+    clock.SetPpb(0);
+    clock.Synchronise(6h);
+    CHECK(drift.Ppb() > 14900);
+  }
+
+  void TestSnapshot() {
+    FS fs;
+    ClockDrift drift(fs);
+    Clock clock(drift, 20000);
+    clock.Synchronise(0s);
+    clock.Synchronise(12h);
+    CHECK(drift.IsDirty());
+
+    auto snapshot = drift.TakeSnapshot();
+    CHECK_EQUAL(snapshot.ppb, drift.Ppb());
+    CHECK(drift.Write(snapshot));
+    drift.OnWritten(snapshot);
+    CHECK(!drift.IsDirty());
+
+    // Changed while the snapshot was written : still dirty
+    clock.SetPpb(25000);
+    clock.Synchronise(12h);
+    CHECK(drift.IsDirty());
+    snapshot = drift.TakeSnapshot();
+    clock.Synchronise(1h);
+    CHECK(drift.Write(snapshot));
+    drift.OnWritten(snapshot);
+    CHECK(drift.IsDirty());
+
+    // Small changes do not need to be written
+    drift.OnWritten(drift.TakeSnapshot());
+    CHECK(!drift.IsDirty());
+    clock.SetPpb(drift.Ppb() + 50);
+    clock.Synchronise(1h);
+    CHECK(!drift.IsDirty());
+  }
+
+  void TestPersistence() {
+    FS fs;
+    ClockDrift drift(fs);
+    Clock clock(drift, -42000);
+    clock.Synchronise(0s);
+    clock.Synchronise(12h);
+    CHECK(drift.Write(drift.TakeSnapshot()));
+    CHECK(fs.files.count(fileName) == 1);
+
+    ClockDrift loaded(fs);
+    loaded.Load();
+    CHECK_EQUAL(loaded.Ppb(), drift.Ppb());
+    CHECK(!loaded.IsDirty());
+
+    // Unknown version : discarded
+    fs.files[fileName][0] = 0xff;
+    ClockDrift invalid(fs);
+    invalid.Load();
+    CHECK_EQUAL(invalid.Ppb(), 0);
+
+    // Truncated file, no file
+    fs.files[fileName].resize(3);
+    invalid.Load();
+    CHECK_EQUAL(invalid.Ppb(), 0);
+    fs.files.clear();
+    invalid.Load();
+    CHECK_EQUAL(invalid.Ppb(), 0);
+  }
+}
+
+int main() {
+  TestMeasurement();
+  TestReferenceJump();
+  TestRestart();
+  TestPrior();
+  TestSnapshot();
+  TestPersistence();
+  return Test::Result();
+}
@@ -0,0 +1,223 @@
+#include "components/delta/DeltaDecoder.h"
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Check.h"
+
+using namespace Pinetime::Tools;
+
+namespace {
+  class Image : public DeltaDecoder::Delegate {
+  public:
+    explicit Image(std::vector<uint8_t> source) : source {std::move(source)} {
+    }
+
+    bool OnHeader(const DeltaDecoder::Header& header) override {
+      receivedHeader = header;
+      return acceptHeader;
+    }
+
+    void ReadSource(uint32_t offset, uint8_t* buffer, size_t size) override {
+      CHECK(offset + size <= source.size());
+      for (size_t i = 0; i < size; i++) {
+        buffer[i] = source[offset + i];
+      }
+    }
+
+    void WriteTarget(const uint8_t* data, size_t size) override {
+      target.insert(target.end(), data, data + size);
+    }
+
+    std::vector<uint8_t> source;
+    std::vector<uint8_t> target;
+    DeltaDecoder::Header receivedHeader {};
+    bool acceptHeader = true;
+  };
+
+  // Encodes the patches, see the description of the format in DeltaDecoder.h
+  class Patch {
+  public:
+    Patch(uint32_t sourceSize, uint16_t sourceCrc, uint32_t targetSize) {
+      data = {'I', 'T', 'D', '1'};
+      U32(sourceSize);
+      U16(sourceCrc);
+      U16(0);
+      U32(targetSize);
+    }
+
+    struct Fix {
+      uint32_t gap;
+      uint8_t delta;
+    };
+
+    Patch& Copy(int32_t offset, uint32_t length, std::vector<Fix> fixes = {}) {
+      data.push_back(0x01);
+      Varint((static_cast<uint32_t>(offset) << 1) ^ static_cast<uint32_t>(offset >> 31));
+      Varint(length);
+      Varint(fixes.size());
+      for (const auto& fix : fixes) {
+        Varint(fix.gap);
+        data.push_back(fix.delta);
+      }
+      return *this;
+    }
+
+    Patch& Insert(const std::vector<uint8_t>& bytes) {
+      data.push_back(0x02);
+      Varint(bytes.size());
+      data.insert(data.end(), bytes.begin(), bytes.end());
+      return *this;
+    }
+
+    void Varint(uint32_t value) {
+      while (value >= 0x80) {
+        data.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+      }
+      data.push_back(static_cast<uint8_t>(value));
+    }
+
+    std::vector<uint8_t> data;
+
+  private:
+    void U16(uint16_t value) {
+      data.push_back(static_cast<uint8_t>(value));
+      data.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    void U32(uint32_t value) {
+      U16(static_cast<uint16_t>(value));
+      U16(static_cast<uint16_t>(value >> 16));
+    }
+  };
+
+  std::vector<uint8_t> Source() {
+    std::vector<uint8_t> source(300);
+    for (size_t i = 0; i < source.size(); i++) {
+      source[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+    return source;
+  }
+
+  // Copy of [100, 250) with 2 fixes, insertion of 3 bytes, then copy of [10, 30) : the offset is relative to the end of
+  // the previous copy.
+  Patch SamplePatch() {
+    Patch patch(300, 0x1234, 173);
+    patch.Copy(100, 150, {{5, 1}, {200 - 100 - 6, 0xff}}).Insert({0xaa, 0xbb, 0xcc}).Copy(10 - 250, 20);
+    return patch;
+  }
+
+  std::vector<uint8_t> SampleTarget(const std::vector<uint8_t>& source) {
+    std::vector<uint8_t> target(source.begin() + 100, source.begin() + 250);
+    target[5] += 1;
+    target[100] += 0xff;
+    target.insert(target.end(), {0xaa, 0xbb, 0xcc});
+    target.insert(target.end(), source.begin() + 10, source.begin() + 30);
+    return target;
+  }
+
+  void TestApplyPatch() {
+    Image image(Source());
+    DeltaDecoder decoder(image);
+    auto patch = SamplePatch();
+
+    CHECK(decoder.Feed(patch.data.data(), patch.data.size()) == DeltaDecoder::Status::Done);
+    CHECK_EQUAL(image.receivedHeader.sourceSize, 300);
+    CHECK_EQUAL(image.receivedHeader.sourceCrc, 0x1234);
+    CHECK_EQUAL(image.receivedHeader.targetSize, 173);
+    CHECK_EQUAL(decoder.TargetSize(), 173);
+    CHECK_EQUAL(decoder.BytesWritten(), 173);
+    CHECK(image.target == SampleTarget(image.source));
+  }
+
+  // The result does not depend on how the patch is split in chunks
+  void TestApplyPatchByteByByte() {
+    Image image(Source());
+    DeltaDecoder decoder(image);
+    auto patch = SamplePatch();
+
+    for (size_t i = 0; i + 1 < patch.data.size(); i++) {
+      CHECK(decoder.Feed(&patch.data[i], 1) == DeltaDecoder::Status::NeedMoreData);
+    }
+    CHECK(decoder.Feed(&patch.data.back(), 1) == DeltaDecoder::Status::Done);
+    CHECK(image.target == SampleTarget(image.source));
+  }
+
+  void TestReset() {
+    Image image(Source());
+    DeltaDecoder decoder(image);
+    auto patch = SamplePatch();
+
+    CHECK(decoder.Feed(patch.data.data(), patch.data.size() / 2) == DeltaDecoder::Status::NeedMoreData);
+    decoder.Reset();
+    image.target.clear();
+    CHECK(decoder.Feed(patch.data.data(), patch.data.size()) == DeltaDecoder::Status::Done);
+    CHECK(image.target == SampleTarget(image.source));
+  }
+
+  // The image is owned and deleted through the delegate interface
+  DeltaDecoder::Status Apply(const Patch& patch, bool acceptHeader = true) {
+    auto image = std::make_unique<Image>(Source());
+    image->acceptHeader = acceptHeader;
+    std::unique_ptr<DeltaDecoder::Delegate> delegate = std::move(image);
+    DeltaDecoder decoder(*delegate);
+    return decoder.Feed(patch.data.data(), patch.data.size());
+  }
+
+  void TestInvalidHeader() {
+    auto patch = SamplePatch();
+    patch.data[3] = '2';
+    CHECK(Apply(patch) == DeltaDecoder::Status::Error);
+
+    CHECK(Apply(SamplePatch(), false) == DeltaDecoder::Status::Error);
+  }
+
+  void TestInvalidCommands() {
+    // Unknown opcode
+    Patch unknown(300, 0, 10);
+    unknown.data.push_back(0x03);
+    CHECK(Apply(unknown) == DeltaDecoder::Status::Error);
+
+    // Copy before the start and past the end of the source
+    CHECK(Apply(Patch(300, 0, 10).Copy(-1, 10)) == DeltaDecoder::Status::Error);
+    CHECK(Apply(Patch(300, 0, 10).Copy(295, 10)) == DeltaDecoder::Status::Error);
+
+    // More data than the size of the target
+    CHECK(Apply(Patch(300, 0, 10).Copy(0, 11)) == DeltaDecoder::Status::Error);
+    CHECK(Apply(Patch(300, 0, 2).Insert({1, 2, 3})) == DeltaDecoder::Status::Error);
+
+    // Fix outside of the copied range, more fixes than bytes
+    CHECK(Apply(Patch(300, 0, 10).Copy(0, 10, {{10, 1}})) == DeltaDecoder::Status::Error);
+    CHECK(Apply(Patch(300, 0, 1).Copy(0, 1, {{0, 1}, {0, 1}})) == DeltaDecoder::Status::Error);
+
+    // Varint longer than 5 bytes
+    Patch overlong(300, 0, 10);
+    overlong.data.push_back(0x02);
+    overlong.data.insert(overlong.data.end(), {0x80, 0x80, 0x80, 0x80, 0x80, 0x00});
+    CHECK(Apply(overlong) == DeltaDecoder::Status::Error);
+  }
+
+  void TestTrailingData() {
+    auto patch = SamplePatch();
+    patch.data.push_back(0x02);
+    CHECK(Apply(patch) == DeltaDecoder::Status::Error);
+  }
+
+  void TestIncompletePatch() {
+    auto patch = SamplePatch();
+    patch.data.pop_back();
+    CHECK(Apply(patch) == DeltaDecoder::Status::NeedMoreData);
+  }
+}
+
+int main() {
+  TestApplyPatch();
+  TestApplyPatchByteByByte();
+  TestReset();
+  TestInvalidHeader();
+  TestInvalidCommands();
+  TestTrailingData();
+  TestIncompletePatch();
+  return Test::Result();
+}
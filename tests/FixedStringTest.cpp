@@ -0,0 +1,75 @@
+#include "utility/FixedString.h"
+#include <cstring>
+#include "Check.h"
+
+using Pinetime::Utility::FixedString;
+
+namespace {
+  void TestAssign() {
+    FixedString<10> text;
+    CHECK_EQUAL(text.Size(), 0);
+    CHECK(text == "");
+
+    CHECK(text.Assign("Artist"));
+    CHECK(text == "Artist");
+    CHECK_EQUAL(text.Size(), 6);
+    CHECK_EQUAL(std::strlen(text.Data()), 6);
+
+    // Same content : not changed
+    CHECK(!text.Assign("Artist"));
+    CHECK(text.Assign("Album"));
+    CHECK(text != "Artist");
+    CHECK(text.Assign(""));
+    CHECK_EQUAL(text.Size(), 0);
+  }
+
+  void TestEmbeddedNull() {
+    FixedString<10> text;
+    const char data[] = {'a', 'b', '\0', 'c', 'd'};
+    CHECK(text.Assign(data, sizeof(data)));
+    CHECK(text == "ab");
+    CHECK_EQUAL(text.Size(), 2);
+  }
+
+  void TestTruncation() {
+    FixedString<10> text;
+    CHECK(text.Assign("0123456789abcdef"));
+    CHECK(text == "0123456789");
+    CHECK(!text.Assign("0123456789abcdef"));
+
+    // The same text with an ellipsis is a change
+    CHECK(text.Assign("0123456789abcdef", 16, true));
+    CHECK(text == "0123456...");
+    CHECK_EQUAL(text.Size(), 10);
+    CHECK(!text.Assign("0123456789abcdef", 16, true));
+
+    // Exactly the capacity : no ellipsis
+    CHECK(text.Assign("0123456789", 10, true));
+    CHECK(text == "0123456789");
+  }
+
+  void TestUtf8Boundary() {
+    FixedString<10> text;
+    // "aaaaaaaaa" followed by e acute (2 bytes) : the character does not fit, it is not cut
+    CHECK(text.Assign("aaaaaaaaa\xc3\xa9"));
+    CHECK(text == "aaaaaaaaa");
+
+    // 4-byte character across the limit of the ellipsis (7 bytes)
+    CHECK(text.Assign("aaaaa\xf0\x9f\x98\x80zzzz", 13, true));
+    CHECK(text == "aaaaa...");
+    CHECK_EQUAL(text.Size(), 8);
+
+    // Only multi-byte characters, none fits before the ellipsis
+    FixedString<4> small;
+    CHECK(small.Assign("\xc3\xa9\xc3\xa9\xc3\xa9", 6, true));
+    CHECK(small == "...");
+  }
+}
+
+int main() {
+  TestAssign();
+  TestEmbeddedNull();
+  TestTruncation();
+  TestUtf8Boundary();
+  return Test::Result();
+}
@@ -0,0 +1,493 @@
+#include "components/ble/GattCache.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+#include "components/ble/AlertNotificationClient.h"
+#include "components/ble/CurrentTimeClient.h"
+#include "components/ble/NotificationManager.h"
+#include "components/ble/ServiceChangedClient.h"
+#include "components/ble/ServiceDiscovery.h"
+#include "components/datetime/DateTimeController.h"
+#include "components/fs/FS.h"
+#include "systemtask/SystemTask.h"
+#include "Check.h"
+#include "MbufChain.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr uint16_t primaryService = 0x2800;
+  constexpr uint16_t characteristicDeclaration = 0x2803;
+  constexpr uint16_t clientConfiguration = 0x2902;
+  constexpr uint16_t gattService = 0x1801;
+  constexpr uint16_t serviceChanged = 0x2a05;
+  constexpr uint16_t currentTimeService = 0x1805;
+  constexpr uint16_t currentTime = 0x2a2b;
+  constexpr uint16_t alertNotificationService = 0x1811;
+  constexpr uint16_t newAlert = 0x2a46;
+
+  struct Characteristic {
+    uint16_t uuid;
+    bool hasClientConfiguration;
+  };
+
+  // GATT server of the phone, answering the procedures of ble_gattc like NimBLE does : the callbacks are called later,
+  // from Run(), once per attribute then with BLE_HS_EDONE, or once with the ATT error that ended the procedure.
+  class Peer {
+  public:
+    struct Attribute {
+      uint16_t handle;
+      uint16_t type;
+      uint16_t uuid; // of the service or of the characteristic for the declarations
+    };
+
+    void AddService(uint16_t uuid, const std::vector<Characteristic>& characteristics) {
+      attributes.push_back({NextHandle(), primaryService, uuid});
+      for (const auto& characteristic : characteristics) {
+        attributes.push_back({NextHandle(), characteristicDeclaration, characteristic.uuid});
+        attributes.push_back({NextHandle(), characteristic.uuid, 0});
+        if (characteristic.hasClientConfiguration) {
+          attributes.push_back({NextHandle(), clientConfiguration, 0});
+        }
+      }
+    }
+
+    // Handle of the attribute of the given type that follows the declaration of the service
+    uint16_t Handle(uint16_t service, uint16_t type) const {
+      bool inService = false;
+      for (const auto& attribute : attributes) {
+        if (attribute.type == primaryService) {
+          inService = attribute.uuid == service;
+        } else if (inService && attribute.type == type) {
+          return attribute.handle;
+        }
+      }
+      return 0;
+    }
+
+    uint16_t ServiceStart(uint16_t service) const {
+      for (const auto& attribute : attributes) {
+        if (attribute.type == primaryService && attribute.uuid == service) {
+          return attribute.handle;
+        }
+      }
+      return 0;
+    }
+
+    uint16_t ServiceEnd(uint16_t service) const {
+      uint16_t end = 0;
+      bool inService = false;
+      for (const auto& attribute : attributes) {
+        if (attribute.type == primaryService) {
+          inService = attribute.uuid == service;
+        } else if (inService) {
+          end = attribute.handle;
+        }
+      }
+      return end;
+    }
+
+    const Attribute* Find(uint16_t handle) const {
+      for (const auto& attribute : attributes) {
+        if (attribute.handle == handle) {
+          return &attribute;
+        }
+      }
+      return nullptr;
+    }
+
+    void Run() {
+      while (!pending.empty()) {
+        auto callback = std::move(pending.front());
+        pending.pop_front();
+        callback();
+      }
+    }
+
+    std::vector<Attribute> attributes;
+    std::deque<std::function<void()>> pending;
+
+    // Procedures started by the clients
+    std::map<uint16_t, int> serviceDiscoveries;
+    int nbReads = 0;
+    int nbReadsByUuid = 0;
+    std::map<uint16_t, std::vector<uint8_t>> subscriptions;
+
+    // Failures injected by the test
+    bool noMemoryForNextAttribute = false;
+    bool noMemoryForNextWrite = false;
+
+  private:
+    uint16_t NextHandle() const {
+      return attributes.empty() ? 1 : static_cast<uint16_t>(attributes.back().handle + 1);
+    }
+  };
+
+  Peer* peer = nullptr;
+
+  // Current time characteristic : 2024-03-10 12:34:56
+  const std::vector<uint8_t> currentTimeValue {0xe8, 0x07, 3, 10, 12, 34, 56, 7, 0, 0};
+
+  ble_uuid_any_t Uuid(uint16_t value) {
+    ble_uuid_any_t uuid {};
+    uuid.u16.u.type = BLE_UUID_TYPE_16;
+    uuid.u16.value = value;
+    return uuid;
+  }
+
+  uint16_t Uuid16(const ble_uuid_t* uuid) {
+    return reinterpret_cast<const ble_uuid16_t*>(uuid)->value;
+  }
+
+  ble_gatt_error Error(int status) {
+    return {static_cast<uint16_t>(status), 0};
+  }
+
+  int AttError(uint8_t error) {
+    return BLE_HS_ERR_ATT_BASE + error;
+  }
+}
+
+int ble_uuid_cmp(const ble_uuid_t* uuid1, const ble_uuid_t* uuid2) {
+  return static_cast<int>(Uuid16(uuid1)) - static_cast<int>(Uuid16(uuid2));
+}
+
+int ble_gattc_disc_svc_by_uuid(uint16_t conn_handle, const ble_uuid_t* uuid, ble_gatt_disc_svc_fn* cb, void* cb_arg) {
+  uint16_t serviceUuid = Uuid16(uuid);
+  peer->serviceDiscoveries[serviceUuid]++;
+  peer->pending.push_back([=]() {
+    for (const auto& attribute : peer->attributes) {
+      if (attribute.type == primaryService && attribute.uuid == serviceUuid) {
+        ble_gatt_svc service {attribute.handle, peer->ServiceEnd(serviceUuid), Uuid(serviceUuid)};
+        auto error = Error(0);
+        if (cb(conn_handle, &error, &service, cb_arg) != 0) {
+          return;
+        }
+      }
+    }
+    auto done = Error(BLE_HS_EDONE);
+    cb(conn_handle, &done, nullptr, cb_arg);
+  });
+  return 0;
+}
+
+int ble_gattc_disc_all_chrs(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle, ble_gatt_chr_fn* cb, void* cb_arg) {
+  peer->pending.push_back([=]() {
+    for (const auto& attribute : peer->attributes) {
+      if (attribute.type == characteristicDeclaration && attribute.handle >= start_handle && attribute.handle <= end_handle) {
+        ble_gatt_chr characteristic {attribute.handle, static_cast<uint16_t>(attribute.handle + 1), 0, Uuid(attribute.uuid)};
+        auto error = Error(0);
+        if (cb(conn_handle, &error, &characteristic, cb_arg) != 0) {
+          return;
+        }
+      }
+    }
+    auto done = Error(BLE_HS_EDONE);
+    cb(conn_handle, &done, nullptr, cb_arg);
+  });
+  return 0;
+}
+
+// Like the Find Information procedure, all the attributes that follow the value of the characteristic are reported
+int ble_gattc_disc_all_dscs(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle, ble_gatt_dsc_fn* cb, void* cb_arg) {
+  peer->pending.push_back([=]() {
+    for (const auto& attribute : peer->attributes) {
+      if (attribute.handle > start_handle && attribute.handle <= end_handle) {
+        ble_gatt_dsc descriptor {attribute.handle, Uuid(attribute.type)};
+        auto error = Error(0);
+        if (cb(conn_handle, &error, start_handle, &descriptor, cb_arg) != 0) {
+          return;
+        }
+      }
+    }
+    auto done = Error(BLE_HS_EDONE);
+    cb(conn_handle, &done, start_handle, nullptr, cb_arg);
+  });
+  return 0;
+}
+
+int ble_gattc_read(uint16_t conn_handle, uint16_t attr_handle, ble_gatt_attr_fn* cb, void* cb_arg) {
+  peer->nbReads++;
+  peer->pending.push_back([=]() {
+    const auto* attribute = peer->Find(attr_handle);
+    if (attribute == nullptr || attribute->type != currentTime) {
+      auto error = Error(AttError(BLE_ATT_ERR_INVALID_HANDLE));
+      cb(conn_handle, &error, nullptr, cb_arg);
+      return;
+    }
+    auto value = Test::MbufChain::Split(currentTimeValue);
+    ble_gatt_attr attr {attr_handle, 0, value.Head()};
+    auto error = Error(0);
+    cb(conn_handle, &error, &attr, cb_arg);
+  });
+  return 0;
+}
+
+int ble_gattc_read_by_uuid(uint16_t conn_handle,
+                           uint16_t start_handle,
+                           uint16_t end_handle,
+                           const ble_uuid_t* uuid,
+                           ble_gatt_attr_fn* cb,
+                           void* cb_arg) {
+  peer->nbReadsByUuid++;
+  uint16_t type = Uuid16(uuid);
+  peer->pending.push_back([=]() {
+    bool found = false;
+    for (const auto& attribute : peer->attributes) {
+      if (attribute.type == type && attribute.handle >= start_handle && attribute.handle <= end_handle) {
+        found = true;
+        // The mbuf of the value could not be allocated : the attribute is reported with BLE_HS_ENOMEM
+        bool noMemory = peer->noMemoryForNextAttribute;
+        peer->noMemoryForNextAttribute = false;
+        auto value = Test::MbufChain::Split(currentTimeValue);
+        ble_gatt_attr attr {attribute.handle, 0, noMemory ? nullptr : value.Head()};
+        auto error = Error(noMemory ? BLE_HS_ENOMEM : 0);
+        if (cb(conn_handle, &error, &attr, cb_arg) != 0) {
+          return;
+        }
+      }
+    }
+    auto last = Error(found ? BLE_HS_EDONE : AttError(BLE_ATT_ERR_ATTR_NOT_FOUND));
+    cb(conn_handle, &last, nullptr, cb_arg);
+  });
+  return 0;
+}
+
+int ble_gattc_write_flat(uint16_t conn_handle, uint16_t attr_handle, const void* data, uint16_t data_len, ble_gatt_attr_fn* cb, void* cb_arg) {
+  // The mbuf of the request could not be allocated : the procedure does not start
+  if (peer->noMemoryForNextWrite) {
+    peer->noMemoryForNextWrite = false;
+    return BLE_HS_ENOMEM;
+  }
+  std::vector<uint8_t> value(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + data_len);
+  peer->pending.push_back([=]() {
+    const auto* attribute = peer->Find(attr_handle);
+    bool valid = attribute != nullptr && attribute->type == clientConfiguration;
+    if (valid) {
+      peer->subscriptions[attr_handle] = value;
+    }
+    ble_gatt_attr attr {attr_handle, 0, nullptr};
+    auto error = Error(valid ? 0 : AttError(BLE_ATT_ERR_WRITE_NOT_PERMITTED));
+    cb(conn_handle, &error, &attr, cb_arg);
+  });
+  return 0;
+}
+
+namespace {
+  constexpr uint16_t connectionHandle = 1;
+
+  Peer Phone(uint16_t vendorCharacteristics = 0) {
+    Peer phone;
+    phone.AddService(gattService, {{serviceChanged, true}});
+    // Services added by an update of the phone, before the ones used by the watch
+    if (vendorCharacteristics > 0) {
+      phone.AddService(0xfee0, std::vector<Characteristic>(vendorCharacteristics, {0xfee1, false}));
+    }
+    phone.AddService(currentTimeService, {{currentTime, true}, {0x2a0f, false}});
+    phone.AddService(alertNotificationService, {{0x2a47, false}, {newAlert, true}, {0x2a48, false}, {0x2a45, true}, {0x2a44, false}});
+    return phone;
+  }
+
+  GattCache::Handles ExpectedHandles(const Peer& phone) {
+    GattCache::Handles handles;
+    handles.currentTimeStart = phone.ServiceStart(currentTimeService);
+    handles.currentTimeEnd = phone.ServiceEnd(currentTimeService);
+    handles.newAlert = phone.Handle(alertNotificationService, newAlert);
+    handles.newAlertDescriptor = static_cast<uint16_t>(handles.newAlert + 1);
+    handles.serviceChanged = phone.Handle(gattService, serviceChanged);
+    return handles;
+  }
+
+  ble_addr_t Address(uint8_t id) {
+    return {BLE_ADDR_PUBLIC, {id, 0x22, 0x33, 0x44, 0x55, 0x66}};
+  }
+
+  // The clients of the watch and the discovery, as in NimbleController
+  class Watch {
+  public:
+    Watch() {
+      gattCache.Init();
+    }
+
+    // Connects to the phone and runs the discovery until the end
+    void Connect(Peer& phone, const ble_addr_t* address) {
+      peer = &phone;
+      discovery.Reset();
+      discovery.StartDiscovery(connectionHandle, address);
+      phone.Run();
+    }
+
+    FS fs;
+    DateTime dateTime;
+    Pinetime::System::SystemTask systemTask;
+    NotificationManager notificationManager {fs};
+    ServiceChangedClient serviceChangedClient;
+    CurrentTimeClient currentTimeClient {dateTime};
+    AlertNotificationClient alertNotificationClient {systemTask, notificationManager};
+    GattCache gattCache {fs};
+    ServiceDiscovery discovery {{&serviceChangedClient, &currentTimeClient, &alertNotificationClient}, gattCache};
+  };
+
+  int NbServiceDiscoveries(const Peer& phone) {
+    int count = 0;
+    for (const auto& [uuid, discoveries] : phone.serviceDiscoveries) {
+      count += discoveries;
+    }
+    return count;
+  }
+
+  // Discovery of all the services : each of them once, the handles are stored in the cache
+  void TestMiss() {
+    Watch watch;
+    auto phone = Phone();
+    auto address = Address(1);
+    watch.Connect(phone, &address);
+
+    CHECK_EQUAL(phone.serviceDiscoveries[gattService], 1);
+    CHECK_EQUAL(phone.serviceDiscoveries[currentTimeService], 1);
+    CHECK_EQUAL(phone.serviceDiscoveries[alertNotificationService], 1);
+    CHECK_EQUAL(phone.nbReads, 1);
+    CHECK_EQUAL(phone.nbReadsByUuid, 0);
+    CHECK_EQUAL(watch.dateTime.nbSynchronisations, 1);
+    // Indications of Service Changed and notifications of new alerts
+    CHECK_EQUAL(phone.subscriptions.size(), 2);
+    CHECK(phone.subscriptions[phone.Handle(gattService, serviceChanged) + 1] == std::vector<uint8_t>({2, 0}));
+    CHECK(phone.subscriptions[phone.Handle(alertNotificationService, newAlert) + 1] == std::vector<uint8_t>({1, 0}));
+
+    CHECK(watch.gattCache.IsDirty());
+    const auto* handles = watch.gattCache.Find(address);
+    CHECK(handles != nullptr && *handles == ExpectedHandles(phone));
+
+    // Not bonded : nothing is cached
+    Watch other;
+    auto otherPhone = Phone();
+    other.Connect(otherPhone, nullptr);
+    CHECK_EQUAL(NbServiceDiscoveries(otherPhone), 3);
+    CHECK(!other.gattCache.IsDirty());
+    CHECK(other.gattCache.Find(address) == nullptr);
+  }
+
+  // Reconnection of a bonded phone : the time is read and the alerts subscribed without any discovery
+  void TestHit() {
+    Watch watch;
+    auto phone = Phone();
+    auto address = Address(1);
+    watch.Connect(phone, &address);
+    watch.gattCache.Persist();
+
+    Watch rebooted;
+    rebooted.fs = watch.fs;
+    rebooted.gattCache.Init();
+    auto reconnected = Phone();
+    rebooted.Connect(reconnected, &address);
+    CHECK_EQUAL(NbServiceDiscoveries(reconnected), 0);
+    CHECK_EQUAL(reconnected.nbReadsByUuid, 1);
+    CHECK_EQUAL(reconnected.nbReads, 0);
+    CHECK_EQUAL(rebooted.dateTime.nbSynchronisations, 1);
+    CHECK_EQUAL(reconnected.subscriptions.size(), 1);
+    // The same handles : the cache is not written again
+    CHECK(!rebooted.gattCache.IsDirty());
+
+    // The services changed during the connection : the entry is removed and the services discovered again
+    auto updated = Phone(3);
+    peer = &updated;
+    rebooted.discovery.OnServiceChanged(connectionHandle);
+    updated.Run();
+    CHECK_EQUAL(NbServiceDiscoveries(updated), 3);
+    const auto* handles = rebooted.gattCache.Find(address);
+    CHECK(handles != nullptr && *handles == ExpectedHandles(updated));
+  }
+
+  // The services moved without Service Changed being indicated : each client falls back to the discovery once
+  void TestStaleHandles() {
+    Watch watch;
+    auto address = Address(1);
+    auto phone = Phone();
+    watch.Connect(phone, &address);
+
+    auto moved = Phone(4);
+    CHECK(!(ExpectedHandles(moved) == ExpectedHandles(phone)));
+    watch.Connect(moved, &address);
+    CHECK_EQUAL(moved.serviceDiscoveries[gattService], 0);
+    CHECK_EQUAL(moved.serviceDiscoveries[currentTimeService], 1);
+    CHECK_EQUAL(moved.serviceDiscoveries[alertNotificationService], 1);
+    CHECK_EQUAL(watch.dateTime.nbSynchronisations, 2);
+    CHECK(moved.subscriptions.count(ExpectedHandles(moved).newAlertDescriptor) == 1);
+    // The stale descriptor was not subscribed
+    CHECK_EQUAL(moved.subscriptions.size(), 1);
+    const auto* handles = watch.gattCache.Find(address);
+    CHECK(handles != nullptr && handles->currentTimeStart == ExpectedHandles(moved).currentTimeStart);
+    CHECK(handles->newAlert == ExpectedHandles(moved).newAlert);
+  }
+
+  // A failure to allocate a buffer is reported by NimBLE before the end of the procedure : the discovery starts once
+  void TestFallbackOnce() {
+    Watch watch;
+    auto address = Address(1);
+    auto phone = Phone();
+    watch.Connect(phone, &address);
+
+    auto noMemoryRead = Phone();
+    noMemoryRead.noMemoryForNextAttribute = true;
+    watch.Connect(noMemoryRead, &address);
+    CHECK_EQUAL(noMemoryRead.nbReadsByUuid, 1);
+    CHECK_EQUAL(noMemoryRead.serviceDiscoveries[currentTimeService], 1);
+    CHECK_EQUAL(noMemoryRead.nbReads, 1);
+    CHECK_EQUAL(noMemoryRead.serviceDiscoveries[alertNotificationService], 0);
+    CHECK_EQUAL(watch.dateTime.nbSynchronisations, 2);
+
+    // The write request is not sent, and its callback never called
+    auto noMemoryWrite = Phone();
+    noMemoryWrite.noMemoryForNextWrite = true;
+    watch.Connect(noMemoryWrite, &address);
+    CHECK_EQUAL(noMemoryWrite.serviceDiscoveries[currentTimeService], 0);
+    CHECK_EQUAL(noMemoryWrite.serviceDiscoveries[alertNotificationService], 1);
+    CHECK_EQUAL(noMemoryWrite.subscriptions.size(), 1);
+    CHECK(watch.gattCache.Find(address) != nullptr);
+    CHECK(*watch.gattCache.Find(address) == ExpectedHandles(noMemoryWrite));
+  }
+
+  // 4 phones are kept, the one that did not connect for the longest time is evicted
+  void TestEviction() {
+    Watch watch;
+    auto connect = [&watch](uint8_t id) {
+      auto phone = Phone(id);
+      auto address = Address(id);
+      watch.Connect(phone, &address);
+      return NbServiceDiscoveries(phone);
+    };
+
+    for (uint8_t id = 1; id <= 4; id++) {
+      CHECK_EQUAL(connect(id), 3);
+    }
+    // Phone 1 is used again : phone 2 becomes the least recently used one
+    CHECK_EQUAL(connect(1), 0);
+    CHECK_EQUAL(connect(5), 3);
+    CHECK_EQUAL(connect(1), 0);
+    CHECK_EQUAL(connect(3), 0);
+    CHECK_EQUAL(connect(4), 0);
+    CHECK_EQUAL(connect(5), 0);
+    CHECK_EQUAL(connect(2), 3);
+    // The handles of each phone are stored in its own entry
+    auto address = Address(5);
+    const auto* handles = watch.gattCache.Find(address);
+    CHECK(handles != nullptr && *handles == ExpectedHandles(Phone(5)));
+
+    // The bond of phone 4 is deleted
+    address = Address(4);
+    watch.gattCache.Remove(address);
+    CHECK_EQUAL(connect(4), 3);
+    CHECK_EQUAL(connect(3), 0);
+  }
+}
+
+int main() {
+  TestMiss();
+  TestHit();
+  TestStaleHandles();
+  TestFallbackOnce();
+  TestEviction();
+  return Test::Result();
+}
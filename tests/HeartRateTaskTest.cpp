@@ -0,0 +1,250 @@
+#include "heartratetask/HeartRateTask.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "components/ble/HeartRateService.h"
+#include "components/heartrate/HeartRateController.h"
+#include "components/motion/MotionController.h"
+#include "components/settings/Settings.h"
+#include "drivers/Bma421.h"
+#include "drivers/Hrs3300.h"
+#include "drivers/TwiMaster.h"
+#include "Check.h"
+#include "Hrs3300Model.h"
+#include "PpgTraces.h"
+
+using namespace Pinetime::Applications;
+using namespace Pinetime::Controllers;
+using Pinetime::Drivers::Bma421;
+using Pinetime::Drivers::Hrs3300;
+using Pinetime::Drivers::TwiMaster;
+
+/* Runs HeartRateTask with the HRS3300 driver on a model of the sensor, which measures a synthetic recording of the wrist
+ * (see PpgTraces.h) at the time of each conversion. The recordings are generated every 25ms and the sensor takes the
+ * sample at its time, so that the sample period chosen by the task matters. The accelerometer is still, its FIFO is read
+ * every 250ms like the system task does.
+ */
+namespace {
+  constexpr uint8_t address = 0x44;
+  constexpr uint8_t traceSamplePeriod = 25; // ms
+  constexpr uint32_t fifoReadPeriod = 250;  // ms
+  constexpr uint32_t accelerometerPeriod = 1000 / Bma421::samplingRate;
+  constexpr uint16_t backgroundInterval = 60; // s
+  constexpr TickType_t backgroundTimeLimit = pdMS_TO_TICKS(30000);
+
+  struct Reading {
+    TickType_t time;
+    uint8_t heartRate;
+  };
+
+  struct Measurement {
+    TickType_t start;
+    TickType_t stop = 0;
+    std::vector<Reading> readings;
+  };
+
+  uint32_t Milliseconds(TickType_t ticks) {
+    return static_cast<uint32_t>(static_cast<uint64_t>(ticks) * 1000 / configTICK_RATE_HZ);
+  }
+
+  Traces::Trace Generate(Traces::Parameters parameters, uint32_t duration) {
+    parameters.samplePeriod = traceSamplePeriod;
+    parameters.length = duration / traceSamplePeriod;
+    return Traces::Generate(parameters);
+  }
+
+  struct Watch {
+    explicit Watch(Traces::Trace recording) : trace {std::move(recording)} {
+      Fakes::tickCount = 0;
+      twim.devices[address] = &sensor;
+      twim.interruptHandler = [this]() {
+        twiMaster.OnInterrupt();
+      };
+      Fakes::whileBlocked = [this]() {
+        twim.Run();
+      };
+      sensor.measure = [this]() {
+        return Measure();
+      };
+      twiMaster.Init();
+      heartRateSensor.Init();
+      controller.SetService(&service);
+      task.Start();
+    }
+
+    ~Watch() {
+      Fakes::whileBlocked = nullptr;
+    }
+
+    // The light at the time of the conversion, read by the task after the acceleration measured until then
+    Fakes::Hrs3300::Light Measure() {
+      uint32_t now = Milliseconds(Fakes::tickCount);
+      ReadFifo(now);
+      conversions.push_back(Fakes::tickCount);
+      const auto& sample = trace[std::min<size_t>(now / traceSamplePeriod, trace.size() - 1)];
+      return {static_cast<double>(sample.hrs), static_cast<double>(sample.als)};
+    }
+
+    void ReadFifo(uint32_t now) {
+      uint32_t readTime = now / fifoReadPeriod * fifoReadPeriod;
+      if (readTime == lastFifoRead) {
+        return;
+      }
+      std::vector<Bma421::Sample> samples;
+      for (uint32_t time = lastFifoRead + accelerometerPeriod; time <= readTime; time += accelerometerPeriod) {
+        samples.push_back({0, -310, -975});
+      }
+      // The FIFO keeps ~1.7s
+      size_t nbSamples = std::min<size_t>(samples.size(), 170);
+      motionController.AddSamples(samples.data() + samples.size() - nbSamples, nbSamples, readTime);
+      lastFifoRead = readTime;
+    }
+
+    // One event of the task, recording the measurements and the heart rates read
+    void Step() {
+      uint32_t nbReadings = controller.NbReadings();
+      task.HandleNextEvent();
+      if (task.IsMeasuring() && (measurements.empty() || measurements.back().stop != 0)) {
+        measurements.push_back({Fakes::tickCount});
+      } else if (!task.IsMeasuring() && !measurements.empty() && measurements.back().stop == 0) {
+        measurements.back().stop = Fakes::tickCount;
+      }
+      if (controller.NbReadings() != nbReadings) {
+        measurements.back().readings.push_back({Fakes::tickCount, controller.HeartRate()});
+      }
+    }
+
+    void Run(TickType_t duration) {
+      for (TickType_t end = Fakes::tickCount + duration; Fakes::tickCount < end;) {
+        Step();
+      }
+    }
+
+    // Until the given number of measurements are over
+    void RunMeasurements(size_t nbMeasurements) {
+      TickType_t end = Fakes::tickCount + pdMS_TO_TICKS(nbMeasurements * (backgroundInterval + 40) * 1000);
+      while (Fakes::tickCount < end && (measurements.size() < nbMeasurements || measurements.back().stop == 0)) {
+        Step();
+      }
+    }
+
+    // The heart rate of the recording at the given time
+    float HeartRate(TickType_t time) const {
+      return trace[std::min<size_t>(Milliseconds(time) / traceSamplePeriod, trace.size() - 1)].heartRate;
+    }
+
+    // The background measurements start with the screen off
+    void StartBackground() {
+      settings.SetHeartRateBackgroundMeasurementInterval(backgroundInterval);
+      controller.Enable();
+      task.PushMessage(HeartRateTask::Messages::GoToSleep);
+      task.HandleNextEvent();
+      task.HandleNextEvent();
+      CHECK(!task.IsMeasuring());
+      CHECK(!sensor.IsEnabled());
+    }
+
+    Traces::Trace trace;
+    uint32_t lastFifoRead = 0;
+    std::vector<TickType_t> conversions;
+    std::vector<Measurement> measurements;
+
+    Fakes::Twim twim;
+    Fakes::Hrs3300 sensor;
+    TwiMaster twiMaster {&twim.registers, TWIM_FREQUENCY_FREQUENCY_K400, 6, 7};
+    Hrs3300 heartRateSensor {twiMaster, address};
+    HeartRateService service;
+    HeartRateController controller;
+    MotionController motionController;
+    Settings settings;
+    HeartRateTask task {heartRateSensor, controller, motionController, settings};
+  };
+
+  // At rest, the background measurement goes on after the first reading, until the readings are stable (6 updates of
+  // the confidence), well before the time limit. The next one starts one interval after the start of this one.
+  void TestBackgroundUntilConfident() {
+    Watch watch {Generate(Traces::Recordings().front(), 200000)};
+    watch.StartBackground();
+    watch.RunMeasurements(3);
+
+    CHECK_EQUAL(watch.measurements.size(), 3);
+    for (const auto& measurement : watch.measurements) {
+      CHECK(measurement.stop != 0);
+      CHECK(measurement.stop - measurement.start < backgroundTimeLimit);
+      CHECK(measurement.readings.size() >= 6);
+      if (measurement.readings.empty()) {
+        continue;
+      }
+      // The readings are 500ms apart
+      CHECK(measurement.stop - measurement.readings.front().time >= pdMS_TO_TICKS(2500));
+      const auto& last = measurement.readings.back();
+      CHECK(std::abs(static_cast<float>(last.heartRate) - watch.HeartRate(last.time)) <= 3.0f);
+    }
+    for (size_t idx = 1; idx < watch.measurements.size(); idx++) {
+      TickType_t gap = watch.measurements[idx].start - watch.measurements[idx - 1].start;
+      CHECK(gap >= pdMS_TO_TICKS(backgroundInterval * 1000));
+      CHECK(gap <= pdMS_TO_TICKS(backgroundInterval * 1000 + 200));
+    }
+    CHECK(!watch.sensor.IsEnabled());
+  }
+
+  // A weak and noisy pulse gives readings, but never stable ones : the background measurement goes on until the time
+  // limit, then switches the sensor off
+  void TestBackgroundTimeLimit() {
+    Traces::Parameters noisy {.name = "noisy", .pulse = 8.0f, .noise = 10.0f, .seed = 2};
+    Watch watch {Generate(noisy, 100000)};
+    watch.StartBackground();
+    watch.RunMeasurements(1);
+
+    CHECK_EQUAL(watch.measurements.size(), 1);
+    const auto& measurement = watch.measurements.front();
+    CHECK(measurement.readings.size() >= 6);
+    CHECK(measurement.stop != 0);
+    CHECK(measurement.stop - measurement.start >= backgroundTimeLimit);
+    CHECK(measurement.stop - measurement.start <= backgroundTimeLimit + pdMS_TO_TICKS(1000));
+    CHECK(!watch.sensor.IsEnabled());
+  }
+
+  // A strong signal with little ambient light switches the sensor to 14 bits and a conversion every 125ms, and the
+  // heart rate is still found. When the pulse is lost, it goes back to 15 bits and 100ms.
+  void TestLowRate() {
+    Traces::Parameters bright {.name = "bright", .startHeartRate = 68.0f, .endHeartRate = 70.0f, .pulse = 40.0f, .noise = 3.0f,
+                               .level = 20000.0f, .drift = 150.0f, .seed = 8};
+    Watch watch {Generate(bright, 40000)};
+    watch.controller.Enable();
+    watch.Run(pdMS_TO_TICKS(30000));
+
+    CHECK(watch.sensor.IsEnabled());
+    CHECK_EQUAL(watch.sensor.LedDriveCurrent(), 0);
+    CHECK_EQUAL(watch.sensor.Gain(), 0);
+    CHECK_EQUAL(watch.sensor.Resolution(), 14);
+    CHECK_EQUAL(watch.sensor.WaitTime(), 3);
+    CHECK_EQUAL(watch.service.sensorConfigs.back().samplePeriod, 125);
+    for (size_t idx = watch.conversions.size() - 100; idx < watch.conversions.size(); idx++) {
+      TickType_t period = watch.conversions[idx] - watch.conversions[idx - 1];
+      CHECK(period >= pdMS_TO_TICKS(125) && period <= pdMS_TO_TICKS(125) + 1);
+    }
+    const auto& readings = watch.measurements.front().readings;
+    CHECK(readings.size() >= 10);
+    for (const auto& reading : readings) {
+      CHECK(std::abs(static_cast<float>(reading.heartRate) - watch.HeartRate(reading.time)) <= 3.0f);
+    }
+
+    bright.pulse = 0.0f;
+    watch.trace = Generate(bright, 80000);
+    watch.Run(pdMS_TO_TICKS(30000));
+    CHECK_EQUAL(watch.sensor.Resolution(), 15);
+    CHECK_EQUAL(watch.sensor.WaitTime(), 5);
+    CHECK_EQUAL(watch.service.sensorConfigs.back().samplePeriod, 100);
+    CHECK(watch.task.IsMeasuring());
+  }
+}
+
+int main() {
+  TestBackgroundUntilConfident();
+  TestBackgroundTimeLimit();
+  TestLowRate();
+  return Test::Result();
+}
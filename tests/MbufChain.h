@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <os/os_mbuf.h>
+
+namespace Test {
+  // Chain of mbufs pointing to the segments, like the ones received by the GATT handlers
+  class MbufChain {
+  public:
+    explicit MbufChain(std::vector<std::vector<uint8_t>> segments) : segments {std::move(segments)}, mbufs(this->segments.size()) {
+      for (size_t i = 0; i < mbufs.size(); i++) {
+        std::memset(&mbufs[i], 0, sizeof(os_mbuf));
+        mbufs[i].om_data = this->segments[i].data();
+        mbufs[i].om_len = static_cast<uint16_t>(this->segments[i].size());
+        SLIST_NEXT(&mbufs[i], om_next) = (i + 1 < mbufs.size()) ? &mbufs[i + 1] : nullptr;
+      }
+    }
+
+    // Splits the bytes in segments of the given sizes, the last one gets the rest
+    static MbufChain Split(const std::vector<uint8_t>& bytes, const std::vector<size_t>& sizes = {}) {
+      std::vector<std::vector<uint8_t>> segments;
+      size_t offset = 0;
+      for (size_t size : sizes) {
+        segments.emplace_back(bytes.begin() + offset, bytes.begin() + offset + size);
+        offset += size;
+      }
+      segments.emplace_back(bytes.begin() + offset, bytes.end());
+      return MbufChain(std::move(segments));
+    }
+
+    MbufChain(const MbufChain&) = delete;
+    MbufChain& operator=(const MbufChain&) = delete;
+    MbufChain(MbufChain&&) = default;
+
+    os_mbuf* Head() {
+      return mbufs.empty() ? nullptr : &mbufs.front();
+    }
+
+    const uint8_t* SegmentData(size_t index) const {
+      return segments[index].data();
+    }
+
+  private:
+    std::vector<std::vector<uint8_t>> segments;
+    std::vector<os_mbuf> mbufs;
+  };
+}
@@ -0,0 +1,151 @@
+#include "components/ble/MbufReader.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Check.h"
+#include "MbufChain.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  using Chain = Test::MbufChain;
+
+  std::vector<uint8_t> Bytes(size_t count) {
+    std::vector<uint8_t> bytes(count);
+    for (size_t i = 0; i < count; i++) {
+      bytes[i] = static_cast<uint8_t>(i + 1);
+    }
+    return bytes;
+  }
+
+  Chain Split(const std::vector<uint8_t>& bytes, const std::vector<size_t>& sizes) {
+    return Chain::Split(bytes, sizes);
+  }
+
+  void CheckIntegers(MbufReader& reader) {
+    CHECK_EQUAL(reader.Remaining(), 17);
+    CHECK_EQUAL(reader.ReadU8(), 0x01);
+    CHECK_EQUAL(reader.ReadU16(), 0x0302);
+    CHECK_EQUAL(reader.ReadI16(), 0x0504);
+    CHECK_EQUAL(reader.ReadU32(), 0x09080706);
+    CHECK_EQUAL(reader.ReadU64(), 0x11100f0e0d0c0b0aULL);
+    CHECK_EQUAL(reader.Remaining(), 0);
+    CHECK(reader.IsValid());
+  }
+
+  void TestIntegers() {
+    auto bytes = Bytes(17);
+    Chain single = Split(bytes, {});
+    MbufReader reader(single.Head());
+    CheckIntegers(reader);
+
+    // Every split in 2 or 3 segments, including empty ones
+    for (size_t first = 0; first <= bytes.size(); first++) {
+      for (size_t second = 0; first + second <= bytes.size(); second++) {
+        Chain chain = Split(bytes, {first, second});
+        MbufReader splitReader(chain.Head());
+        CheckIntegers(splitReader);
+      }
+    }
+
+    Chain negative = Split({0xfe, 0xff}, {});
+    MbufReader negativeReader(negative.Head());
+    CHECK_EQUAL(negativeReader.ReadI16(), -2);
+  }
+
+  void TestReadPastEnd() {
+    Chain chain = Split({0x01, 0x02, 0x03}, {1});
+    MbufReader reader(chain.Head());
+    CHECK_EQUAL(reader.ReadU16(), 0x0201);
+    CHECK(reader.IsValid());
+    // The missing bytes are read as zeros
+    CHECK_EQUAL(reader.ReadU32(), 0x03);
+    CHECK(!reader.IsValid());
+    CHECK_EQUAL(reader.Remaining(), 0);
+    CHECK_EQUAL(reader.ReadU8(), 0);
+
+    MbufReader skipReader(chain.Head());
+    skipReader.Skip(2);
+    CHECK(skipReader.IsValid());
+    CHECK_EQUAL(skipReader.ReadU8(), 0x03);
+    skipReader.Skip(1);
+    CHECK(!skipReader.IsValid());
+
+    MbufReader empty(nullptr);
+    CHECK_EQUAL(empty.Remaining(), 0);
+    CHECK_EQUAL(empty.ReadU16(), 0);
+    CHECK(!empty.IsValid());
+  }
+
+  void TestReadInPlace() {
+    auto bytes = Bytes(10);
+    Chain chain = Split(bytes, {6});
+    MbufReader reader(chain.Head());
+    uint8_t scratch[8] {};
+
+    // In a single mbuf : points into the mbuf
+    const uint8_t* data = reader.ReadInPlace(scratch, 4);
+    CHECK(data == chain.SegmentData(0));
+    // Across the mbufs : copied
+    data = reader.ReadInPlace(scratch, 4);
+    CHECK(data == scratch);
+    CHECK(std::memcmp(data, bytes.data() + 4, 4) == 0);
+    data = reader.ReadInPlace(scratch, 2);
+    CHECK(data == chain.SegmentData(1) + 2);
+    CHECK(reader.IsValid());
+
+    data = reader.ReadInPlace(scratch, 1);
+    CHECK(data == scratch);
+    CHECK_EQUAL(scratch[0], 0);
+    CHECK(!reader.IsValid());
+  }
+
+  void TestStrings() {
+    std::vector<uint8_t> bytes {'a', 'b', 'c', 'd', 'e', 0x42, 5, 'h', 'e', 'l', 'l', 'o', 0x43};
+    Chain chain = Split(bytes, {2, 7});
+
+    char text[4];
+    MbufReader reader(chain.Head());
+    // Truncated to the capacity, the rest of the field is skipped
+    reader.ReadString(text, sizeof(text), 5);
+    CHECK(std::strcmp(text, "abc") == 0);
+    CHECK_EQUAL(reader.ReadU8(), 0x42);
+    CHECK_EQUAL(reader.ReadLengthPrefixedString(text, sizeof(text)), 5);
+    CHECK(std::strcmp(text, "hel") == 0);
+    CHECK_EQUAL(reader.ReadU8(), 0x43);
+    CHECK(reader.IsValid());
+
+    char large[16];
+    MbufReader largeReader(chain.Head());
+    largeReader.ReadString(large, sizeof(large), 5);
+    CHECK(std::strcmp(large, "abcde") == 0);
+    largeReader.Skip(1);
+    CHECK_EQUAL(largeReader.ReadLengthPrefixedString(large, sizeof(large)), 5);
+    CHECK(std::strcmp(large, "hello") == 0);
+
+    // Field longer than the data
+    MbufReader truncatedReader(chain.Head());
+    truncatedReader.ReadString(large, sizeof(large), 15);
+    CHECK_EQUAL(std::strlen(large), bytes.size());
+    CHECK(!truncatedReader.IsValid());
+
+    // No room for the terminator : nothing is written, the field is skipped
+    char guard = 'x';
+    MbufReader emptyReader(chain.Head());
+    emptyReader.ReadString(&guard, 0, 5);
+    CHECK(guard == 'x');
+    CHECK_EQUAL(emptyReader.ReadU8(), 0x42);
+    CHECK_EQUAL(emptyReader.ReadLengthPrefixedString(&guard, 0), 5);
+    CHECK(guard == 'x');
+    CHECK_EQUAL(emptyReader.ReadU8(), 0x43);
+    CHECK(emptyReader.IsValid());
+  }
+}
+
+int main() {
+  TestIntegers();
+  TestReadPastEnd();
+  TestReadInPlace();
+  TestStrings();
+  return Test::Result();
+}
@@ -0,0 +1,169 @@
+#include "components/heartrate/MotionArtifactFilter.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "components/heartrate/Ppg.h"
+#include "Check.h"
+#include "PpgReference.h"
+#include "PpgTraces.h"
+
+using namespace Pinetime::Controllers;
+
+/* Replays the recordings of a swinging arm (synthetic, see PpgTraces.h) through the motion artifact filter. Each recording
+ * is generated twice with the same noise, with and without the artifact, so that what the filter leaves of the artifact
+ * is known exactly.
+ */
+namespace {
+  constexpr std::array<int16_t, MotionArtifactFilter::nbAxes> still {0, -310, -975};
+  // The weights converge during the first seconds
+  constexpr size_t convergence = 100;
+
+  // Power of the artifact in the band-pass filtered PPG signal, before and after the filter (Q8 squared)
+  struct Artifact {
+    double before = 0.0;
+    double after = 0.0;
+
+    double ReductionDb() const {
+      return 10.0 * std::log10(before / after);
+    }
+  };
+
+  // The samples go through the band-pass filter of Ppg first, in the fixed-point format of Ppg
+  Artifact Replay(const Traces::Parameters& parameters) {
+    auto trace = Traces::Generate(parameters);
+    auto withoutArtifact = parameters;
+    withoutArtifact.artifact = 0.0f;
+    auto clean = Traces::Generate(withoutArtifact);
+
+    // Q8, like the samples of Ppg
+    constexpr float scale = 256.0f;
+    Reference::BandPass filter;
+    Reference::BandPass cleanFilter;
+    std::array<Reference::BandPass, MotionArtifactFilter::nbAxes> accelerationFilters;
+    MotionArtifactFilter motionArtifactFilter;
+    Artifact artifact;
+    for (size_t n = 0; n < trace.size(); n++) {
+      float sample = filter.Filter(scale * static_cast<float>(trace[n].hrs - trace[0].hrs));
+      float reference = cleanFilter.Filter(scale * static_cast<float>(clean[n].hrs - clean[0].hrs));
+      std::array<int32_t, MotionArtifactFilter::nbAxes> acceleration;
+      for (size_t axis = 0; axis < MotionArtifactFilter::nbAxes; axis++) {
+        float value = scale * static_cast<float>(trace[n].acceleration[axis] - trace[0].acceleration[axis]);
+        acceleration[axis] = static_cast<int32_t>(std::lround(accelerationFilters[axis].Filter(value)));
+      }
+      int32_t filtered = motionArtifactFilter.Filter(static_cast<int32_t>(std::lround(sample)), acceleration);
+      if (n >= convergence) {
+        artifact.before += std::pow(sample - reference, 2.0f);
+        artifact.after += std::pow(static_cast<float>(filtered) - reference, 2.0f);
+      }
+    }
+    return artifact;
+  }
+
+  struct Readings {
+    int nbReadings = 0;
+    // Within 5 BPM of the heart rate of the recording
+    int nbCorrect = 0;
+    float error = 0.0f;
+  };
+
+  // Heart rate readings of Ppg, with the acceleration of the recording or with a still accelerometer (the filter has
+  // nothing to cancel with)
+  Readings HeartRates(const Traces::Trace& trace, bool useAcceleration) {
+    Ppg ppg;
+    Readings readings;
+    for (const auto& sample : trace) {
+      ppg.Preprocess(sample.hrs, sample.als, useAcceleration ? sample.acceleration : still);
+      int hr = ppg.HeartRate();
+      if (hr > 0) {
+        float error = std::abs(static_cast<float>(hr) - sample.heartRate);
+        readings.error += error;
+        readings.nbReadings++;
+        readings.nbCorrect += error <= 5.0f ? 1 : 0;
+      }
+    }
+    readings.error /= static_cast<float>(std::max(readings.nbReadings, 1));
+    return readings;
+  }
+
+  // The artifact is reduced by more than 8dB, and the heart rate is found instead of the cadence of the arm
+  void TestMotionRecordings(bool report) {
+    if (report) {
+      std::printf("%-12s %10s %10s %10s %10s %12s %12s %12s\n",
+                  "recording",
+                  "reduction",
+                  "readings",
+                  "correct",
+                  "error",
+                  "unfiltered",
+                  "correct",
+                  "error");
+    }
+    for (const auto& parameters : Traces::MotionRecordings()) {
+      auto artifact = Replay(parameters);
+      auto trace = Traces::Generate(parameters);
+      auto readings = HeartRates(trace, true);
+      auto unfiltered = HeartRates(trace, false);
+      if (report) {
+        std::printf("%-12s %8.1fdB %10d %10d %10.2f %12d %12d %12.2f\n",
+                    parameters.name.c_str(),
+                    artifact.ReductionDb(),
+                    readings.nbReadings,
+                    readings.nbCorrect,
+                    readings.error,
+                    unfiltered.nbReadings,
+                    unfiltered.nbCorrect,
+                    unfiltered.error);
+      }
+      CHECK(artifact.ReductionDb() > 8.0);
+      CHECK(readings.nbCorrect > readings.nbReadings * 9 / 10);
+      CHECK(readings.nbCorrect > unfiltered.nbCorrect);
+    }
+  }
+
+  // Without movement, the filter does not change the signal : the weights do not drift on the noise of the accelerometer
+  void TestStill(bool report) {
+    for (const auto& parameters : Traces::Recordings()) {
+      auto trace = Traces::Generate(parameters);
+      auto readings = HeartRates(trace, true);
+      auto unfiltered = HeartRates(trace, false);
+      if (report) {
+        std::printf("%-12s %10s %10d %10d %10.2f %12d %12d %12.2f\n",
+                    parameters.name.c_str(),
+                    "",
+                    readings.nbReadings,
+                    readings.nbCorrect,
+                    readings.error,
+                    unfiltered.nbReadings,
+                    unfiltered.nbCorrect,
+                    unfiltered.error);
+      }
+      CHECK(std::abs(readings.error - unfiltered.error) < 0.5f);
+      CHECK(std::abs(readings.nbCorrect - unfiltered.nbCorrect) <= unfiltered.nbCorrect / 20);
+    }
+  }
+
+  // An input proportional to the acceleration is cancelled, until the filter is reset
+  void TestReset() {
+    MotionArtifactFilter filter;
+    int32_t output = 0;
+    for (int n = 0; n < 200; n++) {
+      auto value = static_cast<int32_t>(20000 * std::sin(n * 0.6));
+      output = filter.Filter(value, {0, value / 2, value / 4});
+    }
+    CHECK(std::abs(output) < 1000);
+    filter.Reset();
+    CHECK_EQUAL(filter.Filter(20000, {0, 10000, 5000}), 20000);
+  }
+}
+
+// --report prints the reduction of the artifact and the heart rate errors on each recording
+int main(int argc, char** argv) {
+  bool report = argc > 1 && std::strcmp(argv[1], "--report") == 0;
+  TestMotionRecordings(report);
+  TestStill(report);
+  TestReset();
+  return Test::Result();
+}
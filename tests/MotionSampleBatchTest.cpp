@@ -0,0 +1,200 @@
+#include "components/ble/MotionSampleBatch.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  struct Sample {
+    uint32_t timestamp;
+    int16_t x;
+    int16_t y;
+    int16_t z;
+
+    bool operator==(const Sample& other) const = default;
+  };
+
+  struct Decoded {
+    bool deltaEncoded;
+    uint16_t sequence;
+    std::vector<Sample> samples;
+  };
+
+  class Reader {
+  public:
+    Reader(const uint8_t* data, size_t size) : data {data}, size {size} {
+    }
+
+    uint32_t Read(size_t bytes) {
+      uint32_t value = 0;
+      for (size_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint32_t>(Next()) << (8 * i);
+      }
+      return value;
+    }
+
+    uint32_t Varint() {
+      uint32_t value = 0;
+      for (int shift = 0;; shift += 7) {
+        uint8_t byte = Next();
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+          return value;
+        }
+      }
+    }
+
+    bool AtEnd() const {
+      return offset == size;
+    }
+
+  private:
+    uint8_t Next() {
+      CHECK(offset < size);
+      return offset < size ? data[offset++] : 0;
+    }
+
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+  };
+
+  // Decodes a batch as described in doc/MotionService.md
+  Decoded Decode(const MotionSampleBatch& batch) {
+    Reader reader(batch.Data(), batch.Size());
+    Decoded decoded;
+    auto flags = reader.Read(1);
+    decoded.deltaEncoded = (flags & MotionSampleBatch::flagDeltaEncoded) != 0;
+    auto count = reader.Read(1);
+    decoded.sequence = static_cast<uint16_t>(reader.Read(2));
+    uint32_t timestamp = reader.Read(4);
+    for (uint32_t i = 0; i < count; i++) {
+      timestamp += reader.Read(1);
+      Sample sample {timestamp, 0, 0, 0};
+      std::array<int16_t*, 3> values {&sample.x, &sample.y, &sample.z};
+      for (size_t axis = 0; axis < values.size(); axis++) {
+        if (decoded.deltaEncoded && i > 0) {
+          uint32_t zigzag = reader.Varint();
+          const auto& previous = decoded.samples.back();
+          int16_t previousValue = axis == 0 ? previous.x : (axis == 1 ? previous.y : previous.z);
+          auto delta = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+          *values[axis] = static_cast<int16_t>(previousValue + delta);
+        } else {
+          *values[axis] = static_cast<int16_t>(reader.Read(2));
+        }
+      }
+      decoded.samples.push_back(sample);
+    }
+    CHECK(reader.AtEnd());
+    return decoded;
+  }
+
+  // Deterministic samples, with small and extreme variations
+  std::vector<Sample> Samples(size_t count) {
+    std::vector<Sample> samples;
+    uint32_t state = 12345;
+    uint32_t timestamp = 1000;
+    for (size_t i = 0; i < count; i++) {
+      state = state * 1103515245 + 12345;
+      timestamp += 8 + (state >> 28);
+      auto x = static_cast<int16_t>(i % 17 == 0 ? INT16_MIN : static_cast<int16_t>(state >> 16) / 64);
+      auto y = static_cast<int16_t>(i % 17 == 1 ? INT16_MAX : static_cast<int16_t>(-1024 + (i % 5)));
+      auto z = static_cast<int16_t>(static_cast<int16_t>(state >> 8) / 4);
+      samples.push_back({timestamp, x, y, z});
+    }
+    return samples;
+  }
+
+  // Packs the samples in batches of at most sizeLimit bytes, and checks that they are decoded back
+  void CheckRoundTrip(bool deltaEncoded, size_t sizeLimit) {
+    auto samples = Samples(400);
+    MotionSampleBatch batch;
+    std::vector<Sample> decoded;
+    uint16_t expectedSequence = 0;
+
+    auto send = [&]() {
+      CHECK(batch.Size() <= sizeLimit);
+      auto result = Decode(batch);
+      CHECK_EQUAL(result.deltaEncoded, deltaEncoded);
+      CHECK_EQUAL(result.sequence, ++expectedSequence);
+      CHECK(!result.samples.empty());
+      CHECK_EQUAL(result.samples.front().timestamp, batch.FirstTimestamp());
+      decoded.insert(decoded.end(), result.samples.begin(), result.samples.end());
+    };
+
+    for (const auto& sample : samples) {
+      if (batch.IsEmpty()) {
+        batch.Start(deltaEncoded, sample.timestamp);
+      }
+      if (!batch.Append(sample.timestamp, sample.x, sample.y, sample.z, sizeLimit)) {
+        send();
+        batch.Start(deltaEncoded, sample.timestamp);
+        CHECK(batch.Append(sample.timestamp, sample.x, sample.y, sample.z, sizeLimit));
+      }
+    }
+    send();
+    CHECK(decoded == samples);
+  }
+
+  void TestRoundTrip() {
+    CheckRoundTrip(false, MotionSampleBatch::maxSize);
+    CheckRoundTrip(true, MotionSampleBatch::maxSize);
+    // Default MTU
+    CheckRoundTrip(false, 20);
+    CheckRoundTrip(true, 20);
+  }
+
+  void TestDeltaEncodingIsSmaller() {
+    MotionSampleBatch raw;
+    MotionSampleBatch delta;
+    raw.Start(false, 0);
+    delta.Start(true, 0);
+    for (uint32_t i = 0; i < 20; i++) {
+      auto x = static_cast<int16_t>(100 + i);
+      CHECK(raw.Append(i * 10, x, -200, 1024, MotionSampleBatch::maxSize));
+      CHECK(delta.Append(i * 10, x, -200, 1024, MotionSampleBatch::maxSize));
+    }
+    CHECK_EQUAL(raw.Size(), MotionSampleBatch::headerSize + 20 * 7);
+    // The first sample is stored as int16, then 1 byte per value
+    CHECK_EQUAL(delta.Size(), MotionSampleBatch::headerSize + 7 + 19 * 4);
+  }
+
+  void TestLimits() {
+    MotionSampleBatch batch;
+
+    // Not started
+    CHECK(!batch.Append(0, 0, 0, 0, MotionSampleBatch::maxSize));
+
+    // The time since the previous sample must fit in a byte
+    batch.Start(false, 1000);
+    CHECK(batch.Append(1000 + 255, 1, 2, 3, MotionSampleBatch::maxSize));
+    CHECK(!batch.Append(1000 + 255 + 256, 1, 2, 3, MotionSampleBatch::maxSize));
+
+    // The size limit is clamped to maxSize, and a sample that does not fit is not written
+    batch.Start(true, 0);
+    size_t count = 0;
+    while (batch.Append(count, 0, 0, 0, 1000)) {
+      count++;
+    }
+    CHECK(batch.Size() <= MotionSampleBatch::maxSize);
+    CHECK_EQUAL(Decode(batch).samples.size(), count);
+
+    // A sample without movement takes 4 bytes after the first one
+    batch.Start(true, 0);
+    count = 0;
+    while (batch.Append(0, 0, 0, 0, MotionSampleBatch::maxSize)) {
+      count++;
+    }
+    CHECK_EQUAL(count, 1 + (MotionSampleBatch::maxSize - MotionSampleBatch::headerSize - 7) / 4);
+    CHECK_EQUAL(Decode(batch).samples.size(), count);
+  }
+}
+
+int main() {
+  TestRoundTrip();
+  TestDeltaEncodingIsSmaller();
+  TestLimits();
+  return Test::Result();
+}
@@ -0,0 +1,239 @@
+#include "systemtask/MotionWake.h"
+#include <array>
+#include <cstdint>
+#include "drivers/Bma421.h"
+#include "drivers/TwiMaster.h"
+#include "Bma421Model.h"
+#include "Check.h"
+
+using namespace Pinetime::System;
+using Pinetime::Drivers::Bma421;
+using Pinetime::Drivers::TwiMaster;
+using Actions = MotionWake::Actions;
+
+namespace {
+  constexpr uint8_t address = 0x18;
+  constexpr TickType_t stateUpdatePeriod = pdMS_TO_TICKS(1000);
+
+  // The motion sensor, and the part of SystemTask that reads its samples, with the state of the system
+  struct System {
+    System() {
+      twim.devices[address] = &model;
+      twim.interruptHandler = [this]() {
+        twiMaster.OnInterrupt();
+      };
+      Fakes::whileBlocked = [this]() {
+        twim.Run();
+      };
+      twiMaster.Init();
+      bma.SoftReset();
+      bma.Init();
+    }
+
+    ~System() {
+      Fakes::whileBlocked = nullptr;
+    }
+
+    // SystemTask::UpdateMotion()
+    void ReadSamples() {
+      motionWake.OnReadSamples(now);
+      std::array<Bma421::Sample, Bma421::maxSamplesPerRead> samples {};
+      for (size_t nbSamples = bma.NbSamples(); nbSamples > 0; nbSamples = bma.NbSamples()) {
+        size_t nbRead = bma.ReadSamples(samples.data(), std::min(nbSamples, samples.size()));
+        if (nbRead == 0) {
+          break;
+        }
+      }
+      bma.ClearInterrupts();
+      nbReads++;
+    }
+
+    // The GPIOTE event of INT1, handled by SystemTask
+    void OnInterrupt() {
+      if (motionWake.ShouldReadSamples(model.Int1())) {
+        ReadSamples();
+      }
+    }
+
+    // The periodic state update of SystemTask
+    Actions Update() {
+      auto action = motionWake.Update(now, isSleeping, isMeasuringHeartRate, model.Int1());
+      if (action == Actions::ReadSamples) {
+        ReadSamples();
+      } else if (action == Actions::Arm) {
+        ReadSamples();
+        motionWake.Arm();
+      }
+      return action;
+    }
+
+    // Samples measured during the given time at 100Hz, with the state updates. INT1 is handled on its rising edge.
+    void Run(TickType_t duration, int16_t x = 0) {
+      for (TickType_t end = now + duration; static_cast<int32_t>(end - now) > 0;) {
+        now += pdMS_TO_TICKS(10);
+        bool level = model.Int1();
+        model.Push(x, -310, -975);
+        if (!level && model.Int1()) {
+          nbInterrupts++;
+          OnInterrupt();
+        }
+        if (now - lastStateUpdate >= stateUpdatePeriod) {
+          Update();
+          lastStateUpdate = now;
+        }
+      }
+    }
+
+    bool IsAnyMotionSelected() const {
+      return model.registers[Fakes::Bma421::Int1Map] == Fakes::Bma421::anyMotion &&
+             model.registers[Fakes::Bma421::IntMapData] == 0;
+    }
+
+    bool IsFifoSelected() const {
+      return model.registers[Fakes::Bma421::Int1Map] == 0 &&
+             model.registers[Fakes::Bma421::IntMapData] == Fakes::Bma421::fifoWatermark;
+    }
+
+    Fakes::Twim twim;
+    Fakes::Bma421 model;
+    TwiMaster twiMaster {&twim.registers, TWIM_FREQUENCY_FREQUENCY_K400, 6, 7};
+    Bma421 bma {twiMaster, address};
+    MotionWake motionWake {bma};
+
+    TickType_t now = 0;
+    TickType_t lastStateUpdate = 0;
+    bool isSleeping = false;
+    bool isMeasuringHeartRate = false;
+    int nbInterrupts = 0;
+    int nbReads = 0;
+  };
+
+  // Running : the FIFO interrupt reads the samples, never armed
+  void TestRunning() {
+    System system;
+    system.Run(pdMS_TO_TICKS(10000));
+    CHECK(!system.motionWake.IsArmed());
+    CHECK(system.IsFifoSelected());
+    // Every 250ms
+    CHECK_EQUAL(system.nbInterrupts, 40);
+    CHECK_EQUAL(system.nbReads, 40);
+    CHECK(system.model.FifoLength() < Bma421::fifoWatermark * 6);
+
+    // The FIFO interrupt is missed : the samples are read at the first state update 1s after the last read, before the
+    // FIFO is full
+    system.model.registers[Fakes::Bma421::IntMapData] = 0;
+    system.nbReads = 0;
+    system.Run(pdMS_TO_TICKS(10000));
+    CHECK(system.nbReads >= 9 && system.nbReads <= 10);
+    CHECK(system.model.FifoLength() < 170 * 6);
+  }
+
+  // Sleeping : armed at the next state update, the FIFO keeps recording without interrupt
+  void TestSleeping() {
+    System system;
+    system.Run(pdMS_TO_TICKS(5000));
+    system.isSleeping = true;
+    system.nbReads = 0;
+    system.nbInterrupts = 0;
+    system.Run(stateUpdatePeriod);
+    CHECK(system.motionWake.IsArmed());
+    CHECK(system.IsAnyMotionSelected());
+    // The samples recorded before were read when it was armed
+    CHECK_EQUAL(system.nbReads, 1);
+
+    system.Run(pdMS_TO_TICKS(60000));
+    CHECK_EQUAL(system.nbInterrupts, 0);
+    CHECK_EQUAL(system.nbReads, 1);
+    CHECK(system.motionWake.IsArmed());
+    // The last ~1.7s are kept
+    CHECK_EQUAL(system.model.FifoLength(), 170 * 6);
+
+    // A FIFO interrupt received just before the any-motion interrupt was selected is ignored
+    system.OnInterrupt();
+    CHECK_EQUAL(system.nbReads, 1);
+    CHECK(system.motionWake.IsArmed());
+  }
+
+  // The sensor moves : the FIFO is read, and read again on its interrupts until the confirmation delay expires
+  void TestAnyMotion() {
+    System system;
+    system.isSleeping = true;
+    system.Run(pdMS_TO_TICKS(3000));
+    CHECK(system.motionWake.IsArmed());
+
+    system.nbReads = 0;
+    system.model.Move();
+    CHECK(system.model.Int1());
+    system.OnInterrupt();
+    TickType_t woken = system.now;
+    CHECK(!system.motionWake.IsArmed());
+    CHECK(system.IsFifoSelected());
+    CHECK(!system.model.Int1());
+    CHECK_EQUAL(system.nbReads, 1);
+    CHECK_EQUAL(system.model.FifoLength(), 0);
+
+    // No wake gesture : armed again at the first state update after the confirmation delay
+    while (!system.motionWake.IsArmed() && system.now - woken < pdMS_TO_TICKS(5000)) {
+      system.Run(pdMS_TO_TICKS(10));
+    }
+    CHECK(system.now - woken >= MotionWake::confirmationDelay);
+    CHECK(system.now - woken < MotionWake::confirmationDelay + stateUpdatePeriod + pdMS_TO_TICKS(10));
+    // The samples during the confirmation were read on the FIFO interrupt
+    CHECK(system.nbReads >= 8);
+    CHECK(system.IsAnyMotionSelected());
+
+    // Woken up by a gesture : disarmed
+    system.isSleeping = false;
+    system.motionWake.Disarm();
+    CHECK(!system.motionWake.IsArmed());
+    CHECK(system.IsFifoSelected());
+    int nbTransfers = static_cast<int>(system.twim.transfers.size());
+    system.motionWake.Disarm();
+    CHECK_EQUAL(system.twim.transfers.size(), nbTransfers);
+  }
+
+  // The edge of the latched interrupt was missed : the samples are read at the next state update
+  void TestMissedEdge() {
+    System system;
+    system.isSleeping = true;
+    system.Run(pdMS_TO_TICKS(3000));
+    CHECK(system.motionWake.IsArmed());
+
+    system.nbReads = 0;
+    system.model.Move();
+    CHECK(system.motionWake.Update(system.now, true, false, system.model.Int1()) == Actions::ReadSamples);
+    system.ReadSamples();
+    CHECK(!system.motionWake.IsArmed());
+    CHECK(system.IsFifoSelected());
+  }
+
+  // The heart rate measurement needs the samples of the FIFO : disarmed, and not armed again until it stops
+  void TestHeartRate() {
+    System system;
+    system.isSleeping = true;
+    system.Run(pdMS_TO_TICKS(3000));
+    CHECK(system.motionWake.IsArmed());
+
+    system.isMeasuringHeartRate = true;
+    system.Run(stateUpdatePeriod);
+    CHECK(!system.motionWake.IsArmed());
+    CHECK(system.IsFifoSelected());
+    system.nbInterrupts = 0;
+    system.Run(pdMS_TO_TICKS(10000));
+    CHECK(!system.motionWake.IsArmed());
+    CHECK(system.nbInterrupts >= 40);
+
+    system.isMeasuringHeartRate = false;
+    system.Run(stateUpdatePeriod);
+    CHECK(system.motionWake.IsArmed());
+  }
+}
+
+int main() {
+  TestRunning();
+  TestSleeping();
+  TestAnyMotion();
+  TestMissedEdge();
+  TestHeartRate();
+  return Test::Result();
+}
@@ -0,0 +1,288 @@
+#include "components/ble/NotificationJournal.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "components/ble/NotificationManager.h"
+#include "components/fs/FS.h"
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+using Location = NotificationJournal::Location;
+
+namespace {
+  constexpr const char* file0 = "/.system/notifications0.dat";
+  constexpr const char* file1 = "/.system/notifications1.dat";
+
+  Location Append(NotificationJournal& journal, const std::string& text) {
+    return journal.Append(1, text.c_str(), text.size() + 1);
+  }
+
+  std::string Read(NotificationJournal& journal, Location location) {
+    uint8_t category;
+    const char* message;
+    size_t size;
+    if (!journal.Read(location, category, message, size)) {
+      return "-";
+    }
+    return std::string(message, size - 1);
+  }
+
+  // Messages from the newest to the oldest one
+  std::vector<std::string> Backward(NotificationJournal& journal) {
+    std::vector<std::string> messages;
+    for (auto location = journal.Previous(journal.End()); location.IsValid(); location = journal.Previous(location)) {
+      messages.push_back(Read(journal, location));
+    }
+    return messages;
+  }
+
+  // Messages from the oldest to the newest one
+  std::vector<std::string> Forward(NotificationJournal& journal) {
+    std::vector<std::string> messages;
+    auto location = journal.Previous(journal.End());
+    for (auto previous = location; previous.IsValid(); previous = journal.Previous(previous)) {
+      location = previous;
+    }
+    for (; location.IsValid(); location = journal.Next(location)) {
+      messages.push_back(Read(journal, location));
+    }
+    return messages;
+  }
+
+  std::vector<std::string> Messages(int first, int last) {
+    std::vector<std::string> messages;
+    for (int i = first; i <= last; i++) {
+      messages.push_back("N" + std::to_string(i));
+    }
+    return messages;
+  }
+
+  std::vector<std::string> Reversed(std::vector<std::string> messages) {
+    return {messages.rbegin(), messages.rend()};
+  }
+
+  void TestAppendAndRead() {
+    FS fs;
+    NotificationJournal journal(fs);
+    journal.Init();
+    CHECK(!journal.End().IsValid());
+    CHECK(!journal.Previous(journal.End()).IsValid());
+
+    for (int i = 0; i < 5; i++) {
+      CHECK(Append(journal, "N" + std::to_string(i)).IsValid());
+    }
+    CHECK_EQUAL(journal.NbNotifications(), 5);
+    CHECK(Backward(journal) == Reversed(Messages(0, 4)));
+    CHECK(Forward(journal) == Messages(0, 4));
+    CHECK(!journal.Next(journal.Previous(journal.End())).IsValid());
+
+    // Reloaded at boot
+    NotificationJournal loaded(fs);
+    loaded.Init();
+    CHECK_EQUAL(loaded.NbNotifications(), 5);
+    CHECK(loaded.End() == journal.End());
+    CHECK(Forward(loaded) == Messages(0, 4));
+  }
+
+  // A reset during the write of a record : the record is incomplete, the next one is written in its place
+  void TestTornRecord() {
+    for (size_t cut : {1, 3, 6}) {
+      FS fs;
+      NotificationJournal journal(fs);
+      journal.Init();
+      for (int i = 0; i < 5; i++) {
+        Append(journal, "N" + std::to_string(i));
+      }
+      auto& data = fs.files[file1];
+      data.resize(data.size() - cut);
+
+      NotificationJournal loaded(fs);
+      loaded.Init();
+      CHECK_EQUAL(loaded.NbNotifications(), 4);
+      CHECK(Forward(loaded) == Messages(0, 3));
+
+      Append(loaded, "N5");
+      NotificationJournal reloaded(fs);
+      reloaded.Init();
+      std::vector<std::string> expected = Messages(0, 3);
+      expected.push_back("N5");
+      CHECK(Forward(reloaded) == expected);
+      CHECK_EQUAL(reloaded.NbNotifications(), 5);
+    }
+
+    // Complete, but corrupted : same as a torn record
+    FS fs;
+    NotificationJournal journal(fs);
+    journal.Init();
+    for (int i = 0; i < 5; i++) {
+      Append(journal, "N" + std::to_string(i));
+    }
+    auto& data = fs.files[file1];
+    data[data.size() - 6] ^= 0x10;
+    NotificationJournal loaded(fs);
+    loaded.Init();
+    CHECK(Forward(loaded) == Messages(0, 3));
+    CHECK(Backward(loaded) == Reversed(Messages(0, 3)));
+  }
+
+  // A reset before the dismissal flag is committed : the notification stays in the journal
+  void TestInterruptedDismissal() {
+    FS fs;
+    NotificationJournal journal(fs);
+    journal.Init();
+    std::vector<Location> locations;
+    for (int i = 0; i < 5; i++) {
+      locations.push_back(Append(journal, "N" + std::to_string(i)));
+    }
+
+    fs.failWrites = true;
+    journal.Dismiss(locations[2]);
+    CHECK_EQUAL(journal.NbNotifications(), 5);
+    CHECK(Forward(journal) == Messages(0, 4));
+    // A failed append does not move the end of the journal
+    auto end = journal.End();
+    CHECK(!Append(journal, "lost").IsValid());
+    CHECK(journal.End() == end);
+    fs.failWrites = false;
+
+    NotificationJournal loaded(fs);
+    loaded.Init();
+    CHECK_EQUAL(loaded.NbNotifications(), 5);
+    CHECK(Forward(loaded) == Messages(0, 4));
+
+    // Committed : skipped by the walks, before and after a reset
+    loaded.Dismiss(locations[2]);
+    loaded.Dismiss(locations[4]);
+    loaded.Dismiss(locations[4]);
+    CHECK_EQUAL(loaded.NbNotifications(), 3);
+    std::vector<std::string> expected {"N0", "N1", "N3"};
+    CHECK(Forward(loaded) == expected);
+    CHECK(Backward(loaded) == Reversed(expected));
+    NotificationJournal reloaded(fs);
+    reloaded.Init();
+    CHECK_EQUAL(reloaded.NbNotifications(), 3);
+    CHECK(Forward(reloaded) == expected);
+  }
+
+  // The journal alternates between 2 files : the oldest notifications are dropped when a file is reused
+  void TestWrap() {
+    FS fs;
+    NotificationJournal journal(fs);
+    journal.Init();
+    const std::string padding(150, 'x');
+    int count = 0;
+    auto oldest = [&journal]() {
+      auto location = journal.Previous(journal.End());
+      for (auto previous = location; previous.IsValid(); previous = journal.Previous(previous)) {
+        location = previous;
+      }
+      return location;
+    };
+
+    // Until the 4th generation : the files were both reused
+    while (fs.files.count(file0) == 0 || journal.End().generation < 4) {
+      Append(journal, "N" + std::to_string(count++) + padding);
+    }
+    auto messages = Forward(journal);
+    CHECK_EQUAL(messages.size(), journal.NbNotifications());
+    // Between 1 and 2 files of notifications, the newest ones, in order
+    size_t perFile = (4096 - 12) / (3 + count / 10 + 150 + 8);
+    CHECK(messages.size() > perFile && messages.size() <= 2 * perFile + 1);
+    bool ordered = true;
+    for (size_t i = 0; i < messages.size(); i++) {
+      ordered = ordered && messages[i] == "N" + std::to_string(count - messages.size() + i) + padding;
+    }
+    CHECK(ordered);
+    CHECK(Backward(journal) == Reversed(messages));
+    CHECK_EQUAL(oldest().generation, 3);
+
+    NotificationJournal loaded(fs);
+    loaded.Init();
+    CHECK_EQUAL(loaded.NbNotifications(), messages.size());
+    CHECK(Forward(loaded) == messages);
+
+    // A lost file of the previous generation : only the current one is used
+    fs.files.erase(file1);
+    NotificationJournal partial(fs);
+    partial.Init();
+    auto current = Forward(partial);
+    CHECK(!current.empty() && current.size() < messages.size());
+    CHECK(current.back() == messages.back());
+  }
+
+  // Paging through the notifications that are only in the journal, as the notification screen does
+  void TestPaging() {
+    FS fs;
+    {
+      NotificationManager manager(fs);
+      manager.Init();
+      for (int i = 0; i < 100; i++) {
+        std::string message = "Title " + std::to_string(i) + '\0' + "Body of the notification";
+        manager.Push(NotificationManager::Categories::Sms, message.c_str(), message.size() + 1);
+        manager.Persist();
+      }
+    }
+
+    // At boot, the newest ones are loaded in RAM
+    NotificationManager manager(fs);
+    manager.Init();
+    size_t inRam = manager.NbNotifications();
+    CHECK_EQUAL(manager.NbStoredNotifications(), 100);
+
+    auto title = [&manager](Location location) {
+      std::string text;
+      manager.ReadStored(location, [&text](const NotificationManager::MessageView& message) {
+        text = message.Title();
+      });
+      return text;
+    };
+
+    fs.nbReads = 0;
+    fs.bytesRead = 0;
+    std::vector<Location> locations;
+    bool ordered = true;
+    for (auto notification = manager.GetPreviousStored(manager.OldestLocation()); notification.valid;
+         notification = manager.GetPreviousStored(notification.location)) {
+      ordered = ordered && title(notification.location) == "Title " + std::to_string(100 - inRam - 1 - locations.size());
+      locations.push_back(notification.location);
+    }
+    CHECK(ordered);
+    CHECK_EQUAL(locations.size(), 100 - inRam);
+    // The records are read by windows of the size of the cache
+    std::printf("Paging back through %u notifications : %u file reads, %u bytes\n",
+                static_cast<unsigned>(locations.size()),
+                static_cast<unsigned>(fs.nbReads),
+                static_cast<unsigned>(fs.bytesRead));
+    CHECK(fs.nbReads * 4 <= locations.size());
+
+    // And forward, up to the notifications in RAM
+    size_t index = locations.size() - 1;
+    bool forward = true;
+    for (auto notification = manager.GetNextStored(locations[index]); notification.valid;
+         notification = manager.GetNextStored(notification.location)) {
+      forward = forward && index > 0 && notification.location == locations[--index];
+    }
+    CHECK(forward);
+    CHECK_EQUAL(index, 0);
+
+    // A dismissed notification is skipped before it is written to the journal
+    manager.DismissStored(locations[1]);
+    CHECK(manager.GetPreviousStored(locations[0]).location == locations[2]);
+    CHECK(manager.GetNextStored(locations[2]).location == locations[0]);
+    CHECK_EQUAL(manager.NbStoredNotifications(), 99);
+    manager.Persist();
+    NotificationJournal journal(fs);
+    journal.Init();
+    CHECK_EQUAL(journal.NbNotifications(), 99);
+  }
+}
+
+int main() {
+  TestAppendAndRead();
+  TestTornRecord();
+  TestInterruptedDismissal();
+  TestWrap();
+  TestPaging();
+  return Test::Result();
+}
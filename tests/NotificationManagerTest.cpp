@@ -0,0 +1,275 @@
+#include "components/ble/NotificationManager.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include "components/fs/FS.h"
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+using Categories = NotificationManager::Categories;
+using Id = NotificationManager::Notification::Id;
+
+namespace {
+  // Pushes "title\0body", with its null terminator
+  void Push(NotificationManager& manager, const std::string& title, const std::string& body, Categories category = Categories::Sms) {
+    std::string message = title + '\0' + body;
+    manager.Push(category, message.c_str(), message.size() + 1);
+  }
+
+  // Title and body, "-" if the notification is not found
+  std::string Text(const NotificationManager& manager, Id id) {
+    std::string text = "-";
+    manager.Read(id, [&text](const NotificationManager::MessageView& message) {
+      text = std::string(message.Title() != nullptr ? message.Title() : "") + "|" + message.Message();
+    });
+    return text;
+  }
+
+  std::string Body(size_t size, char c) {
+    return std::string(size, c);
+  }
+
+  void TestPushAndRead() {
+    FS fs;
+    NotificationManager manager(fs);
+    manager.Init();
+    CHECK(manager.IsEmpty());
+    CHECK(!manager.GetLastNotification().valid);
+    CHECK(!manager.Read(0, [](const NotificationManager::MessageView&) {
+    }));
+
+    Push(manager, "Alice", "Hello", Categories::InstantMessage);
+    CHECK(manager.AreNewNotificationsAvailable());
+    CHECK(manager.ClearNewNotificationFlag());
+    CHECK(!manager.AreNewNotificationsAvailable());
+
+    auto notification = manager.GetLastNotification();
+    CHECK(notification.valid);
+    CHECK(notification.category == Categories::InstantMessage);
+    CHECK_EQUAL(Text(manager, notification.id), "Alice|Hello");
+
+    // The view points into the arena : no copy of the message
+    const char* first = nullptr;
+    const char* second = nullptr;
+    manager.Read(notification.id, [&first](const NotificationManager::MessageView& message) {
+      first = message.data;
+    });
+    manager.Read(notification.id, [&second](const NotificationManager::MessageView& message) {
+      second = message.data;
+    });
+    CHECK(first != nullptr && first == second);
+
+    // Without a title, and truncated to the maximum size
+    std::string noTitle = "Only a body";
+    manager.Push(Categories::SimpleAlert, noTitle.c_str(), noTitle.size() + 1);
+    CHECK_EQUAL(Text(manager, manager.GetLastNotification().id), "|Only a body");
+    Push(manager, "Long", Body(500, 'x'));
+    std::string expected = "Long|" + Body(NotificationManager::MessageSize - 6, 'x');
+    CHECK_EQUAL(Text(manager, manager.GetLastNotification().id), expected);
+    CHECK_EQUAL(manager.NbNotifications(), 3);
+  }
+
+  void TestNavigation() {
+    FS fs;
+    NotificationManager manager(fs);
+    for (int i = 0; i < 4; i++) {
+      Push(manager, "T" + std::to_string(i), "B");
+    }
+    auto oldest = manager.GetOldestNotification();
+    auto newest = manager.GetLastNotification();
+    CHECK_EQUAL(Text(manager, oldest.id), "T0|B");
+    CHECK_EQUAL(Text(manager, newest.id), "T3|B");
+    CHECK_EQUAL(manager.IndexOf(newest.id), 0);
+    CHECK_EQUAL(manager.IndexOf(oldest.id), 3);
+
+    auto next = manager.GetNext(oldest.id);
+    CHECK_EQUAL(Text(manager, next.id), "T1|B");
+    CHECK(!manager.GetNext(newest.id).valid);
+    CHECK(!manager.GetPrevious(oldest.id).valid);
+    CHECK_EQUAL(Text(manager, manager.GetPrevious(newest.id).id), "T2|B");
+    CHECK_EQUAL(manager.IndexOf(static_cast<Id>(newest.id + 1)), manager.NbNotifications());
+  }
+
+  void TestDismissal() {
+    FS fs;
+    NotificationManager manager(fs);
+    for (int i = 0; i < 5; i++) {
+      Push(manager, "T" + std::to_string(i), Body(50, 'a'));
+    }
+    Id first = manager.GetOldestNotification().id;
+
+    // In the middle : skipped by the navigation and the indexes
+    manager.Dismiss(static_cast<Id>(first + 2));
+    CHECK_EQUAL(manager.NbNotifications(), 4);
+    CHECK_EQUAL(Text(manager, static_cast<Id>(first + 2)), "-");
+    CHECK(!manager.Get(static_cast<Id>(first + 2)).valid);
+    CHECK_EQUAL(manager.GetNext(static_cast<Id>(first + 1)).id, first + 3);
+    CHECK_EQUAL(manager.GetPrevious(static_cast<Id>(first + 3)).id, first + 1);
+    CHECK_EQUAL(manager.IndexOf(static_cast<Id>(first + 1)), 2);
+    // Twice : ignored
+    manager.Dismiss(static_cast<Id>(first + 2));
+    CHECK_EQUAL(manager.NbNotifications(), 4);
+
+    // The oldest one, then the newest one
+    manager.Dismiss(first);
+    CHECK_EQUAL(manager.GetOldestNotification().id, first + 1);
+    manager.Dismiss(static_cast<Id>(first + 4));
+    CHECK_EQUAL(manager.GetLastNotification().id, first + 3);
+    CHECK_EQUAL(Text(manager, static_cast<Id>(first + 3)), "T3|" + Body(50, 'a'));
+
+    // The space of the newest one is reclaimed : the next notification is written at the same place
+    const char* dismissedPlace = nullptr;
+    manager.Read(static_cast<Id>(first + 3), [&dismissedPlace](const NotificationManager::MessageView& message) {
+      dismissedPlace = message.data + message.size;
+    });
+    Push(manager, "T5", "new");
+    const char* newPlace = nullptr;
+    manager.Read(manager.GetLastNotification().id, [&newPlace](const NotificationManager::MessageView& message) {
+      newPlace = message.data;
+    });
+    CHECK(newPlace == dismissedPlace);
+
+    // All of them
+    for (Id id = first; id != static_cast<Id>(first + 6); id++) {
+      manager.Dismiss(id);
+    }
+    CHECK(manager.IsEmpty());
+    CHECK(!manager.GetLastNotification().valid);
+    CHECK(!manager.GetOldestNotification().valid);
+    Push(manager, "After", "empty");
+    CHECK_EQUAL(Text(manager, manager.GetLastNotification().id), "After|empty");
+  }
+
+  void TestEviction() {
+    FS fs;
+    NotificationManager manager(fs);
+
+    // By size : 200 bytes records, 2 of them fit in the arena
+    Push(manager, "A", Body(196, 'a'));
+    Push(manager, "B", Body(196, 'b'));
+    Id a = manager.GetOldestNotification().id;
+    CHECK_EQUAL(manager.NbNotifications(), 2);
+    Push(manager, "C", Body(196, 'c'));
+    CHECK_EQUAL(manager.NbNotifications(), 2);
+    CHECK_EQUAL(Text(manager, a), "-");
+    CHECK_EQUAL(manager.GetOldestNotification().id, a + 1);
+    CHECK_EQUAL(Text(manager, static_cast<Id>(a + 2)), "C|" + Body(196, 'c'));
+
+    // By number of slots : small records
+    FS otherFs;
+    NotificationManager small(otherFs);
+    for (int i = 0; i < 40; i++) {
+      Push(small, std::to_string(i), "");
+    }
+    CHECK_EQUAL(small.NbNotifications(), 16);
+    CHECK_EQUAL(Text(small, small.GetOldestNotification().id), "24|");
+    CHECK_EQUAL(Text(small, small.GetLastNotification().id), "39|");
+
+    // A dismissed notification that is not the oldest one still takes a slot until the older ones are evicted
+    small.Dismiss(static_cast<Id>(small.GetOldestNotification().id + 1));
+    Push(small, "40", "");
+    CHECK_EQUAL(small.NbNotifications(), 15);
+    CHECK_EQUAL(Text(small, small.GetOldestNotification().id), "26|");
+  }
+
+  struct Expected {
+    Id id;
+    std::string text;
+  };
+
+  // Random pushes and dismissals, compared with a model : the notifications that are still in the arena are the newest
+  // ones that were not dismissed, with their content unchanged, whatever the position of the records in the arena.
+  void TestWrapAround() {
+    FS fs;
+    NotificationManager manager(fs);
+    std::deque<Expected> expected;
+    uint32_t state = 3;
+    auto random = [&state](uint32_t range) {
+      state = state * 1664525 + 1013904223;
+      return (state >> 8) % range;
+    };
+
+    size_t wraps = 0;
+    const char* previousPlace = nullptr;
+    bool consistent = true;
+    for (int step = 0; step < 3000; step++) {
+      if (!expected.empty() && random(4) == 0) {
+        size_t index = random(expected.size());
+        manager.Dismiss(expected[index].id);
+        expected.erase(expected.begin() + index);
+      } else {
+        std::string title = "N" + std::to_string(step);
+        std::string body = Body(random(120), static_cast<char>('a' + step % 26));
+        Push(manager, title, body);
+        auto newest = manager.GetLastNotification();
+        expected.push_back({newest.id, title + "|" + body});
+        const char* place = nullptr;
+        manager.Read(newest.id, [&place](const NotificationManager::MessageView& message) {
+          place = message.data;
+        });
+        if (previousPlace != nullptr && place < previousPlace) {
+          wraps++;
+        }
+        previousPlace = place;
+      }
+
+      // The evicted notifications are the oldest ones
+      while (expected.size() > manager.NbNotifications()) {
+        consistent = consistent && Text(manager, expected.front().id) == "-";
+        expected.pop_front();
+      }
+      consistent = consistent && expected.size() == manager.NbNotifications();
+      for (size_t i = 0; i < expected.size(); i++) {
+        consistent = consistent && Text(manager, expected[i].id) == expected[i].text;
+        consistent = consistent && manager.IndexOf(expected[i].id) == expected.size() - 1 - i;
+      }
+      if (!expected.empty()) {
+        consistent = consistent && manager.GetOldestNotification().id == expected.front().id;
+        consistent = consistent && manager.GetLastNotification().id == expected.back().id;
+      }
+    }
+    CHECK(consistent);
+    // The records wrapped around the end of the arena many times, and the ids around 255
+    CHECK(wraps > 100);
+  }
+
+  void TestPersistence() {
+    FS fs;
+    NotificationManager manager(fs);
+    manager.Init();
+    // Persisted by the system task after each notification
+    for (int i = 0; i < 20; i++) {
+      Push(manager, "T" + std::to_string(i), "B");
+      manager.Persist();
+    }
+
+    // The newest ones are loaded back, the older ones are read in place from the journal
+    NotificationManager loaded(fs);
+    loaded.Init();
+    CHECK_EQUAL(loaded.NbNotifications(), 16);
+    CHECK_EQUAL(Text(loaded, loaded.GetLastNotification().id), "T19|B");
+    CHECK_EQUAL(loaded.NbStoredNotifications(), 20);
+    auto stored = loaded.GetPreviousStored(loaded.OldestLocation());
+    CHECK(stored.valid);
+    std::string text;
+    CHECK(loaded.ReadStored(stored.location, [&text](const NotificationManager::MessageView& message) {
+      text = std::string(message.Title()) + "|" + message.Message();
+    }));
+    CHECK_EQUAL(text, "T3|B");
+
+    loaded.DismissStored(stored.location);
+    CHECK(!loaded.ReadStored(stored.location, [](const NotificationManager::MessageView&) {
+    }));
+    CHECK_EQUAL(loaded.NbStoredNotifications(), 19);
+  }
+}
+
+int main() {
+  TestPushAndRead();
+  TestNavigation();
+  TestDismissal();
+  TestEviction();
+  TestWrapAround();
+  TestPersistence();
+  return Test::Result();
+}
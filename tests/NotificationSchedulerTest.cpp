@@ -0,0 +1,317 @@
+#include "components/ble/NotificationScheduler.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_hs.h>
+#include <nimble/nimble_port.h>
+#undef max
+#undef min
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+using Characteristics = NotificationScheduler::Characteristics;
+
+namespace {
+  // FreeRTOS runs at 1024 ticks per second on the watch
+  constexpr ble_npl_time_t Ticks(uint32_t ms) {
+    return ms * 1024 / 1000;
+  }
+
+  struct Notification {
+    ble_npl_time_t time;
+    uint16_t connectionHandle;
+    uint16_t attributeHandle;
+    std::vector<uint8_t> value;
+  };
+
+  // Time, connection and callout of the host task. The callout is only fired by Advance(), like the event queue of the
+  // host task would run it.
+  struct Host {
+    ble_npl_time_t now = 0;
+    bool connected = false;
+    uint16_t connectionInterval = 0; // 1.25ms units
+    ble_npl_callout* callout = nullptr;
+    ble_npl_time_t expiry = 0;
+    int nbCriticalSections = 0;
+    std::vector<uint8_t> flat;
+    std::vector<Notification> notifications;
+  } host;
+
+  ble_npl_eventq eventQueue {};
+  os_mbuf mbuf {};
+
+  constexpr uint16_t connectionHandle = 3;
+  const std::array<uint16_t, 4> attributeHandles {0x10, 0x20, 0x30, 0x40};
+  // Minimum periods expected for each characteristic
+  const std::array<uint32_t, 4> minPeriods {1000, 1000, 100, 10000};
+
+  // Runs the callout each time it expires until the given time
+  void Advance(ble_npl_time_t until) {
+    while (host.callout != nullptr && host.callout->c_active && static_cast<int32_t>(host.expiry - until) <= 0) {
+      host.now = host.expiry;
+      host.callout->c_active = false;
+      host.callout->c_ev.ev_cb(&host.callout->c_ev);
+    }
+    host.now = until;
+  }
+
+  void Notify(NotificationScheduler& scheduler, Characteristics characteristic, uint8_t value) {
+    auto index = static_cast<size_t>(characteristic);
+    std::array<uint8_t, 2> bytes {value, static_cast<uint8_t>(index)};
+    scheduler.Notify(characteristic, attributeHandles[index], bytes.data(), bytes.size());
+  }
+
+  void Reset() {
+    host = {};
+    host.connected = true;
+    host.connectionInterval = 40; // 50ms
+  }
+
+  void Connect(NotificationScheduler& scheduler) {
+    scheduler.Init();
+    scheduler.OnConnected(connectionHandle);
+  }
+}
+
+extern "C" {
+void ble_npl_callout_init(struct ble_npl_callout* co, struct ble_npl_eventq* evq, ble_npl_event_fn* ev_cb, void* ev_arg) {
+  *co = {};
+  co->c_evq = evq;
+  co->c_ev.ev_cb = ev_cb;
+  co->c_ev.ev_arg = ev_arg;
+  host.callout = co;
+}
+
+ble_npl_error_t ble_npl_callout_reset(struct ble_npl_callout* co, ble_npl_time_t ticks) {
+  co->c_active = true;
+  host.expiry = host.now + ticks;
+  return BLE_NPL_OK;
+}
+
+void ble_npl_callout_stop(struct ble_npl_callout* co) {
+  co->c_active = false;
+}
+
+void* ble_npl_event_get_arg(struct ble_npl_event* ev) {
+  return ev->ev_arg;
+}
+
+ble_npl_time_t ble_npl_time_get() {
+  return host.now;
+}
+
+ble_npl_time_t ble_npl_time_ms_to_ticks32(uint32_t ms) {
+  return Ticks(ms);
+}
+
+uint32_t ble_npl_hw_enter_critical() {
+  host.nbCriticalSections++;
+  return 0;
+}
+
+void ble_npl_hw_exit_critical(uint32_t /*ctx*/) {
+  host.nbCriticalSections--;
+}
+
+struct ble_npl_eventq* nimble_port_get_dflt_eventq() {
+  return &eventQueue;
+}
+
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc* out_desc) {
+  if (!host.connected || handle != connectionHandle) {
+    return BLE_HS_ENOTCONN;
+  }
+  *out_desc = {};
+  out_desc->conn_handle = handle;
+  out_desc->conn_itvl = host.connectionInterval;
+  return 0;
+}
+
+struct os_mbuf* ble_hs_mbuf_from_flat(const void* buf, uint16_t len) {
+  auto bytes = static_cast<const uint8_t*>(buf);
+  host.flat.assign(bytes, bytes + len);
+  return &mbuf;
+}
+
+int ble_gattc_notify_custom(uint16_t conn_handle, uint16_t att_handle, struct os_mbuf* om) {
+  CHECK(om == &mbuf);
+  host.notifications.push_back({host.now, conn_handle, att_handle, host.flat});
+  return 0;
+}
+}
+
+namespace {
+  // The values are sent one connection interval after the first of them, only the last value of each characteristic
+  void TestCoalescing() {
+    Reset();
+    NotificationScheduler scheduler;
+    Connect(scheduler);
+
+    host.now = 100;
+    Notify(scheduler, Characteristics::HeartRate, 60);
+    Advance(110);
+    Notify(scheduler, Characteristics::HeartRate, 61);
+    Notify(scheduler, Characteristics::StepCount, 1);
+    Advance(120);
+    Notify(scheduler, Characteristics::HeartRate, 62);
+    Notify(scheduler, Characteristics::StepCount, 2);
+
+    const ble_npl_time_t flush = 100 + Ticks(50);
+    Advance(flush - 1);
+    CHECK(host.notifications.empty());
+    Advance(flush);
+    CHECK_EQUAL(host.notifications.size(), 2);
+    if (host.notifications.size() == 2) {
+      CHECK_EQUAL(host.notifications[0].time, flush);
+      CHECK_EQUAL(host.notifications[0].connectionHandle, connectionHandle);
+      CHECK_EQUAL(host.notifications[0].attributeHandle, attributeHandles[0]);
+      CHECK(host.notifications[0].value == std::vector<uint8_t>({62, 0}));
+      CHECK_EQUAL(host.notifications[1].time, flush);
+      CHECK_EQUAL(host.notifications[1].attributeHandle, attributeHandles[1]);
+      CHECK(host.notifications[1].value == std::vector<uint8_t>({2, 1}));
+    }
+    // Nothing else is planned
+    CHECK(!host.callout->c_active);
+    Advance(flush + Ticks(60000));
+    CHECK_EQUAL(host.notifications.size(), 2);
+    CHECK_EQUAL(host.nbCriticalSections, 0);
+  }
+
+  // A value is not sent before the minimum period of its characteristic has elapsed since the previous one
+  void TestMinPeriods() {
+    for (size_t index = 0; index < minPeriods.size(); index++) {
+      Reset();
+      NotificationScheduler scheduler;
+      Connect(scheduler);
+      auto characteristic = static_cast<Characteristics>(index);
+
+      Notify(scheduler, characteristic, 1);
+      Advance(Ticks(50));
+      CHECK_EQUAL(host.notifications.size(), 1);
+      const ble_npl_time_t due = Ticks(50) + Ticks(minPeriods[index]);
+
+      // Updated many times during the period, at a higher rate than the connection interval
+      for (uint8_t value = 2; value <= 10; value++) {
+        Advance(Ticks(50) + (due - Ticks(50)) * value / 11);
+        Notify(scheduler, characteristic, value);
+      }
+      Advance(due - 1);
+      CHECK_EQUAL(host.notifications.size(), 1);
+      Advance(due);
+      CHECK_EQUAL(host.notifications.size(), 2);
+      if (host.notifications.size() == 2) {
+        CHECK_EQUAL(host.notifications[1].time, due);
+        CHECK(host.notifications[1].value == std::vector<uint8_t>({10, static_cast<uint8_t>(index)}));
+      }
+
+      // After a long time without update, the next value only waits for the connection interval
+      Advance(due + Ticks(20000));
+      Notify(scheduler, characteristic, 11);
+      Advance(due + Ticks(20000) + Ticks(50));
+      CHECK_EQUAL(host.notifications.size(), 3);
+    }
+  }
+
+  // A rate-limited value does not delay the other characteristics, and does not wait for the interval when it is due
+  void TestMixedPeriods() {
+    Reset();
+    NotificationScheduler scheduler;
+    Connect(scheduler);
+
+    Notify(scheduler, Characteristics::BatteryLevel, 90);
+    Notify(scheduler, Characteristics::MotionValues, 1);
+    Advance(Ticks(50));
+    CHECK_EQUAL(host.notifications.size(), 2);
+
+    Notify(scheduler, Characteristics::BatteryLevel, 89);
+    Notify(scheduler, Characteristics::MotionValues, 2);
+    Advance(Ticks(50) + Ticks(100));
+    CHECK_EQUAL(host.notifications.size(), 3);
+    if (host.notifications.size() == 3) {
+      CHECK_EQUAL(host.notifications[2].attributeHandle, attributeHandles[2]);
+    }
+    Advance(Ticks(50) + Ticks(10000) - 1);
+    CHECK_EQUAL(host.notifications.size(), 3);
+    Advance(Ticks(50) + Ticks(10000));
+    CHECK_EQUAL(host.notifications.size(), 4);
+    if (host.notifications.size() == 4) {
+      CHECK_EQUAL(host.notifications[3].attributeHandle, attributeHandles[3]);
+      CHECK(host.notifications[3].value == std::vector<uint8_t>({89, 3}));
+    }
+  }
+
+  // The flush waits for the interval of the connection, or 30ms until it is known
+  void TestWindow() {
+    Reset();
+    host.connectionInterval = 24; // 30ms
+    host.connected = false;
+    NotificationScheduler scheduler;
+    Connect(scheduler);
+    host.connected = true;
+    host.connectionInterval = 400; // 500ms, negotiated later
+
+    Notify(scheduler, Characteristics::HeartRate, 60);
+    Advance(Ticks(30));
+    CHECK_EQUAL(host.notifications.size(), 1);
+
+    scheduler.OnConnectionUpdated(connectionHandle + 1);
+    Advance(Ticks(5000));
+    Notify(scheduler, Characteristics::HeartRate, 61);
+    Advance(Ticks(5000) + Ticks(30));
+    CHECK_EQUAL(host.notifications.size(), 2);
+
+    scheduler.OnConnectionUpdated(connectionHandle);
+    Advance(Ticks(10000));
+    Notify(scheduler, Characteristics::HeartRate, 62);
+    Advance(Ticks(10000) + Ticks(500) - 1);
+    CHECK_EQUAL(host.notifications.size(), 2);
+    Advance(Ticks(10000) + Ticks(500));
+    CHECK_EQUAL(host.notifications.size(), 3);
+  }
+
+  // Nothing is sent without connection, and the pending values are dropped on disconnection
+  void TestDisconnection() {
+    Reset();
+    NotificationScheduler scheduler;
+    scheduler.Init();
+    Notify(scheduler, Characteristics::HeartRate, 60);
+    CHECK(!host.callout->c_active);
+
+    scheduler.OnConnected(connectionHandle);
+    Notify(scheduler, Characteristics::HeartRate, 61);
+    Advance(Ticks(50));
+    Notify(scheduler, Characteristics::HeartRate, 62);
+    Notify(scheduler, Characteristics::StepCount, 1);
+    scheduler.OnDisconnected();
+    CHECK(!host.callout->c_active);
+    Advance(Ticks(60000));
+    CHECK_EQUAL(host.notifications.size(), 1);
+
+    // The period of the previous connection does not apply to the new one
+    scheduler.OnConnected(connectionHandle);
+    Notify(scheduler, Characteristics::HeartRate, 63);
+    Advance(Ticks(60000) + Ticks(50));
+    CHECK_EQUAL(host.notifications.size(), 2);
+    if (host.notifications.size() == 2) {
+      CHECK(host.notifications[1].value == std::vector<uint8_t>({63, 0}));
+    }
+
+    // Values larger than a notification slot are ignored
+    std::array<uint8_t, NotificationScheduler::MaxValueSize + 1> large {};
+    scheduler.Notify(Characteristics::MotionValues, attributeHandles[2], large.data(), large.size());
+    Advance(Ticks(70000));
+    CHECK_EQUAL(host.notifications.size(), 2);
+    CHECK_EQUAL(host.nbCriticalSections, 0);
+  }
+}
+
+int main() {
+  TestCoalescing();
+  TestMinPeriods();
+  TestMixedPeriods();
+  TestWindow();
+  TestDisconnection();
+  return Test::Result();
+}
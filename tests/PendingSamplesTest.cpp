@@ -0,0 +1,184 @@
+#include "heartratetask/PendingSamples.h"
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "components/motion/MotionController.h"
+#include "Check.h"
+
+using namespace Pinetime::Applications;
+using Pinetime::Controllers::MotionController;
+using Pinetime::Drivers::Bma421;
+
+namespace {
+  constexpr uint32_t fifoReadPeriod = 250; // ms
+  constexpr uint32_t accelerometerPeriod = 1000 / Bma421::samplingRate;
+
+  // The accelerometer measures x = its time in units of 10ms, so that the acceleration given with each PPG sample tells
+  // when it was measured. The system task reads its FIFO every 250ms, unless it is busy.
+  struct Sensors {
+    // The samples measured until now, read from the FIFO if the system task is not busy
+    void ReadFifo() {
+      if (now / fifoReadPeriod == lastFifoRead / fifoReadPeriod) {
+        return;
+      }
+      uint32_t readTime = now / fifoReadPeriod * fifoReadPeriod;
+      if (!isSystemTaskBusy) {
+        std::vector<Bma421::Sample> samples;
+        for (uint32_t time = lastFifoRead + accelerometerPeriod; time <= readTime; time += accelerometerPeriod) {
+          samples.push_back({static_cast<int16_t>(time / accelerometerPeriod), -310, -975});
+        }
+        motionController.AddSamples(samples.data(), samples.size(), readTime);
+      }
+      lastFifoRead = readTime;
+    }
+
+    struct Released {
+      uint16_t hrs;
+      uint32_t delay;
+      std::array<int16_t, 3> acceleration;
+    };
+
+    // HeartRateTask::HandleSensorData() : a PPG sample (hrs is its index) every sample period, then the pending
+    // samples are released
+    std::vector<Released> Run(uint32_t duration) {
+      std::vector<Released> released;
+      for (uint32_t end = now + duration; now < end;) {
+        now += samplePeriod;
+        ReadFifo();
+        pendingSamples.Push(nbSamples, 0, now);
+        timestamps.push_back(now);
+        nbSamples++;
+        PendingSamples::Sample sample;
+        while (pendingSamples.Pop(now, samplePeriod, sample)) {
+          released.push_back({sample.hrs, now - timestamps.at(sample.hrs), sample.acceleration});
+        }
+        maxSize = std::max(maxSize, pendingSamples.Size());
+      }
+      return released;
+    }
+
+    // The mean x of the accelerometer samples measured during the sample period ending at timestamp
+    int16_t ExpectedX(uint32_t timestamp) const {
+      int32_t last = static_cast<int32_t>(timestamp / accelerometerPeriod);
+      int32_t count = static_cast<int32_t>(samplePeriod / accelerometerPeriod);
+      return static_cast<int16_t>((2 * last - count + 1) / 2);
+    }
+
+    MotionController motionController;
+    PendingSamples pendingSamples {motionController};
+    uint32_t samplePeriod = 100;
+    // Not a multiple of the period of the FIFO reads
+    uint32_t now = 30;
+    uint32_t lastFifoRead = 0;
+    bool isSystemTaskBusy = false;
+    uint16_t nbSamples = 0;
+    std::vector<uint32_t> timestamps;
+    size_t maxSize = 0;
+  };
+
+  // Each sample waits for the FIFO read after it, and gets the acceleration measured during its own period
+  void TestAligned() {
+    for (uint32_t samplePeriod : {100, 125}) {
+      Sensors sensors;
+      sensors.samplePeriod = samplePeriod;
+      auto released = sensors.Run(10000);
+      CHECK(released.size() + 4 >= sensors.nbSamples);
+      for (size_t idx = 0; idx < released.size(); idx++) {
+        const auto& sample = released[idx];
+        // In order, none is dropped
+        CHECK_EQUAL(sample.hrs, idx);
+        CHECK(sample.delay <= fifoReadPeriod + samplePeriod);
+        CHECK_EQUAL(sample.acceleration[0], sensors.ExpectedX(sensors.timestamps[sample.hrs]));
+        CHECK_EQUAL(sample.acceleration[1], -310);
+        CHECK_EQUAL(sample.acceleration[2], -975);
+      }
+      CHECK(sensors.maxSize <= (fifoReadPeriod + samplePeriod) / samplePeriod + 1);
+    }
+  }
+
+  // The FIFO is not read for 2s : the samples are released 500ms after they were measured, with the last acceleration
+  // known, then aligned again once the FIFO is read
+  void TestLate() {
+    Sensors sensors;
+    sensors.Run(5000);
+    int16_t lastX = sensors.motionController.X();
+    uint16_t firstLate = sensors.nbSamples;
+    sensors.isSystemTaskBusy = true;
+    auto released = sensors.Run(2000);
+    CHECK(sensors.maxSize < PendingSamples::capacity);
+    bool late = false;
+    for (const auto& sample : released) {
+      if (sample.hrs < firstLate) {
+        continue;
+      }
+      late = true;
+      CHECK(sample.delay >= PendingSamples::maxMotionDelay);
+      CHECK(sample.delay < PendingSamples::maxMotionDelay + sensors.samplePeriod);
+      CHECK_EQUAL(sample.acceleration[0], lastX);
+    }
+    CHECK(late);
+
+    sensors.isSystemTaskBusy = false;
+    uint16_t next = released.back().hrs + 1;
+    released = sensors.Run(3000);
+    CHECK_EQUAL(released.front().hrs, next);
+    for (size_t idx = 1; idx < released.size(); idx++) {
+      CHECK_EQUAL(released[idx].hrs, released[idx - 1].hrs + 1);
+    }
+    // The samples measured while the system task was busy are dropped here (the FIFO keeps ~1.7s on the watch) : the PPG
+    // samples measured after the first read are aligned
+    const auto& sample = released.back();
+    CHECK(sample.delay <= fifoReadPeriod + sensors.samplePeriod);
+    CHECK_EQUAL(sample.acceleration[0], sensors.ExpectedX(sensors.timestamps[sample.hrs]));
+  }
+
+  // No sample was ever read from the accelerometer : the samples are released after 500ms with no acceleration, the
+  // queue never overflows
+  void TestNoAccelerometer() {
+    Sensors sensors;
+    sensors.isSystemTaskBusy = true;
+    auto released = sensors.Run(3000);
+    CHECK_EQUAL(released.size(), sensors.nbSamples - PendingSamples::maxMotionDelay / sensors.samplePeriod);
+    for (size_t idx = 0; idx < released.size(); idx++) {
+      CHECK_EQUAL(released[idx].hrs, idx);
+      CHECK_EQUAL(released[idx].delay, PendingSamples::maxMotionDelay);
+      CHECK(released[idx].acceleration == (std::array<int16_t, 3> {0, 0, 0}));
+    }
+    CHECK(sensors.maxSize < PendingSamples::capacity);
+  }
+
+  // Changing the settings of the sensor drops the pending samples. When full, the oldest sample is released whatever
+  // the accelerometer.
+  void TestClearAndFull() {
+    MotionController motionController;
+    PendingSamples pendingSamples {motionController};
+    PendingSamples::Sample sample;
+    pendingSamples.Push(1, 0, 1000);
+    pendingSamples.Push(2, 0, 1100);
+    CHECK(!pendingSamples.Pop(1100, 100, sample));
+    pendingSamples.Clear();
+    CHECK_EQUAL(pendingSamples.Size(), 0);
+    CHECK(!pendingSamples.Pop(5000, 100, sample));
+
+    for (uint16_t idx = 0; idx < PendingSamples::capacity; idx++) {
+      pendingSamples.Push(idx, 0, 1000);
+    }
+    CHECK(pendingSamples.Pop(1000, 100, sample));
+    CHECK_EQUAL(sample.hrs, 0);
+    CHECK(!pendingSamples.Pop(1000, 100, sample));
+    // Pushed without Pop() while full : the oldest sample is dropped
+    pendingSamples.Push(100, 0, 1100);
+    pendingSamples.Push(101, 0, 1100);
+    CHECK_EQUAL(pendingSamples.Size(), PendingSamples::capacity);
+    CHECK(pendingSamples.Pop(1100, 100, sample));
+    CHECK_EQUAL(sample.hrs, 2);
+  }
+}
+
+int main() {
+  TestAligned();
+  TestLate();
+  TestNoAccelerometer();
+  TestClearAndFull();
+  return Test::Result();
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "components/heartrate/Ppg.h"
+#include "components/heartrate/PpgSpectrum.h"
+#include "Check.h"
+#include "PpgReference.h"
+#include "PpgTraces.h"
+
+using namespace Pinetime::Controllers;
+
+/* Compares the fixed-point heart rate pipeline with the float one it replaced (PpgReference.h) on the synthetic
+ * recordings : RAM of the objects and of the FFT buffers, time of the FFT, of the peak search and of a whole update on the
+ * host. The host has a double precision FPU and 64 bits registers, so the times only give an order of magnitude of the
+ * ratio on the Cortex-M4F.
+ */
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  // Keeps the results alive, so that the optimiser does not remove the work
+  volatile uint32_t sink = 0;
+
+  double NanosecondsPer(Clock::duration duration, size_t count) {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / static_cast<double>(count);
+  }
+
+  // Windowed and filtered signals of the old pipeline, as the input of the FFTs
+  std::vector<Reference::Signal> Windows() {
+    std::vector<Reference::Signal> windows;
+    for (const auto& parameters : Traces::Recordings()) {
+      auto trace = Traces::Generate(parameters);
+      for (size_t first = 0; first + Reference::dataLength <= trace.size(); first += 5) {
+        Reference::Signal signal;
+        for (int idx = 0; idx < Reference::dataLength; idx++) {
+          signal[idx] = trace[first + idx].hrs;
+        }
+        Reference::Detrend(signal);
+        Reference::Filter30to240(signal);
+        for (int idx = 0; idx < Reference::dataLength; idx++) {
+          signal[idx] *= Reference::Hanning(idx);
+        }
+        windows.push_back(signal);
+      }
+    }
+    return windows;
+  }
+
+  void BenchmarkFft(const std::vector<Reference::Signal>& windows) {
+    constexpr int nbRuns = 20;
+    std::vector<std::array<int32_t, Ppg::dataLength>> fixedPointWindows;
+    for (const auto& window : windows) {
+      std::array<int32_t, Ppg::dataLength> signal;
+      for (int idx = 0; idx < Ppg::dataLength; idx++) {
+        signal[idx] = static_cast<int32_t>(window[idx] * 256.0f);
+      }
+      fixedPointWindows.push_back(signal);
+    }
+
+    auto start = Clock::now();
+    for (int run = 0; run < nbRuns; run++) {
+      for (auto real : windows) {
+        Reference::Signal imaginary {};
+        Reference::FloatFft::Magnitude(real, imaginary);
+        sink = sink + static_cast<uint32_t>(real[7]);
+      }
+    }
+    double floatTime = NanosecondsPer(Clock::now() - start, nbRuns * windows.size());
+
+    start = Clock::now();
+    for (int run = 0; run < nbRuns; run++) {
+      for (auto signal : fixedPointWindows) {
+        std::array<uint32_t, Ppg::spectrumLength> magnitude;
+        PpgSpectrum::RealFftMagnitude(signal, magnitude.data());
+        sink = sink + magnitude[7];
+      }
+    }
+    double fixedPointTime = NanosecondsPer(Clock::now() - start, nbRuns * fixedPointWindows.size());
+
+    std::printf("FFT and magnitude of 64 samples\n");
+    std::printf("  float (ArduinoFFT)   %8.0f ns   %4zu B of buffers (vReal, vImag)\n", floatTime, 2 * sizeof(Reference::Signal));
+    std::printf("  Q30 (RealFftMagnitude) %6.0f ns   %4zu B of buffers (signal, magnitude)\n",
+                fixedPointTime,
+                sizeof(std::array<int32_t, Ppg::dataLength>) + sizeof(std::array<uint32_t, Ppg::spectrumLength>));
+    CHECK(fixedPointTime > 0.0);
+  }
+
+  // Averaged spectra of the old pipeline, in Q4 for the new search
+  std::vector<Reference::Spectrum> Spectra() {
+    std::vector<Reference::Spectrum> spectra;
+    for (const auto& parameters : Traces::Recordings()) {
+      auto trace = Traces::Generate(parameters);
+      Reference::Ppg<> ppg;
+      for (size_t n = 0; n < trace.size(); n++) {
+        ppg.Preprocess(trace[n].hrs, trace[n].als);
+        if (ppg.HeartRate() != 0) {
+          spectra.push_back(ppg.LastSpectrum());
+        }
+      }
+    }
+    return spectra;
+  }
+
+  void BenchmarkPeakSearch(const std::vector<Reference::Spectrum>& spectra) {
+    constexpr int nbRuns = 5;
+    constexpr int start = 3;
+    constexpr int end = 26;
+    std::vector<std::array<uint32_t, Ppg::spectrumLength>> fixedPointSpectra;
+    std::vector<int64_t> thresholds;
+    for (const auto& spectrum : spectra) {
+      std::array<uint32_t, Ppg::spectrumLength> values;
+      for (int idx = 0; idx < Ppg::spectrumLength; idx++) {
+        values[idx] = static_cast<uint32_t>(spectrum[idx] * 16.0f);
+      }
+      fixedPointSpectra.push_back(values);
+      thresholds.push_back(static_cast<int64_t>(*std::max_element(values.begin() + start, values.begin() + end)) * 60 / 100);
+    }
+
+    auto begin = Clock::now();
+    for (int run = 0; run < nbRuns; run++) {
+      for (const auto& spectrum : spectra) {
+        float width = 0.0f;
+        float max = *std::max_element(spectrum.begin() + start, spectrum.begin() + end);
+        sink = sink + static_cast<uint32_t>(100 * Reference::PeakSearch(spectrum, 0.6f * max, width, start, end));
+      }
+    }
+    double stepwiseTime = NanosecondsPer(Clock::now() - begin, nbRuns * spectra.size());
+
+    begin = Clock::now();
+    for (int run = 0; run < nbRuns; run++) {
+      for (size_t idx = 0; idx < fixedPointSpectra.size(); idx++) {
+        int width = 0;
+        sink = sink + static_cast<uint32_t>(PpgSpectrum::PeakSearch(fixedPointSpectra[idx].data(), thresholds[idx], width, start, end));
+      }
+    }
+    double singlePassTime = NanosecondsPer(Clock::now() - begin, nbRuns * fixedPointSpectra.size());
+
+    std::printf("Peak search in the heart rate region (23 bins)\n");
+    std::printf("  stepwise (0.01 bin)  %8.0f ns\n", stepwiseTime);
+    std::printf("  single pass          %8.0f ns\n", singlePassTime);
+    CHECK(singlePassTime > 0.0);
+  }
+
+  // Preprocessing of all the samples of the recordings and readings (one every 5 samples), per reading. The recordings
+  // are generated outside of the measured time.
+  template <typename Pipeline, typename Feed>
+  double TimePerUpdate(Feed feed) {
+    constexpr int nbRuns = 5;
+    std::vector<Traces::Trace> traces;
+    for (const auto& parameters : Traces::Recordings()) {
+      traces.push_back(Traces::Generate(parameters));
+    }
+    size_t updates = 0;
+    Clock::duration elapsed {};
+    for (int run = 0; run < nbRuns; run++) {
+      for (const auto& trace : traces) {
+        Pipeline ppg;
+        auto start = Clock::now();
+        for (const auto& sample : trace) {
+          feed(ppg, sample);
+          sink = sink + static_cast<uint32_t>(ppg.HeartRate());
+        }
+        elapsed += Clock::now() - start;
+        updates += (trace.size() - Ppg::dataLength) / 5 + 1;
+      }
+    }
+    return NanosecondsPer(elapsed, updates);
+  }
+
+  void BenchmarkPipeline() {
+    double floatTime = TimePerUpdate<Reference::Ppg<Reference::FloatFft>>([](auto& ppg, const Traces::Sample& sample) {
+      ppg.Preprocess(sample.hrs, sample.als);
+    });
+    double fixedPointTime = TimePerUpdate<Ppg>([](auto& ppg, const Traces::Sample& sample) {
+      ppg.Preprocess(sample.hrs, sample.als, sample.acceleration);
+    });
+
+    // The fixed-point Ppg also holds the state of the motion artifact filter
+    std::printf("Reading (5 samples preprocessed and one analysis)\n");
+    std::printf("  float Ppg            %8.0f ns   %4zu B\n", floatTime, sizeof(Reference::Ppg<Reference::FloatFft>));
+    std::printf("  fixed-point Ppg      %8.0f ns   %4zu B, of which %zu B for the motion artifact filter\n",
+                fixedPointTime,
+                sizeof(Ppg),
+                sizeof(MotionArtifactFilter));
+    CHECK(fixedPointTime > 0.0);
+  }
+}
+
+int main() {
+  BenchmarkFft(Windows());
+  BenchmarkPeakSearch(Spectra());
+  BenchmarkPipeline();
+  return Test::Result();
+}
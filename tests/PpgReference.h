@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include "components/heartrate/Ppg.h"
+#include "components/heartrate/PpgSpectrum.h"
+
+/* The floating-point heart rate pipeline that Ppg replaced, used as the reference of its tests : the samples are
+ * detrended, differentiated and band-pass filtered in a batch, and the magnitude spectrum is computed by ArduinoFFT. The
+ * library is not in the tree anymore, its radix-2 FFT is reproduced here (twiddle factors by recurrence, sqrtf).
+ *
+ * The FFT and the peak search are template parameters, so that the fixed-point ones of PpgSpectrum can be evaluated
+ * alone.
+ */
+namespace Reference {
+  constexpr int dataLength = Pinetime::Controllers::Ppg::dataLength;
+  constexpr int spectrumLength = Pinetime::Controllers::Ppg::spectrumLength;
+  using Signal = std::array<float, dataLength>;
+  using Spectrum = std::array<float, spectrumLength>;
+
+  // ArduinoFFT::compute(FFTDirection::Forward) then complexToMagnitude() : the magnitude is stored in real
+  struct FloatFft {
+    static void Magnitude(Signal& real, Signal& imaginary) {
+      for (int i = 0, j = 0; i < dataLength - 1; i++) {
+        if (i < j) {
+          std::swap(real[i], real[j]);
+          std::swap(imaginary[i], imaginary[j]);
+        }
+        int k = dataLength >> 1;
+        while (k <= j) {
+          j -= k;
+          k >>= 1;
+        }
+        j += k;
+      }
+      float c1 = -1.0f;
+      float c2 = 0.0f;
+      int l2 = 1;
+      for (int l = 0; (1 << l) < dataLength; l++) {
+        int l1 = l2;
+        l2 <<= 1;
+        float u1 = 1.0f;
+        float u2 = 0.0f;
+        for (int j = 0; j < l1; j++) {
+          for (int i = j; i < dataLength; i += l2) {
+            int i1 = i + l1;
+            float t1 = u1 * real[i1] - u2 * imaginary[i1];
+            float t2 = u1 * imaginary[i1] + u2 * real[i1];
+            real[i1] = real[i] - t1;
+            imaginary[i1] = imaginary[i] - t2;
+            real[i] += t1;
+            imaginary[i] += t2;
+          }
+          float z = u1 * c1 - u2 * c2;
+          u2 = u1 * c2 + u2 * c1;
+          u1 = z;
+        }
+        c2 = -std::sqrt((1.0f - c1) / 2.0f);
+        c1 = std::sqrt((1.0f + c1) / 2.0f);
+      }
+      for (int i = 0; i < dataLength; i++) {
+        real[i] = std::sqrt(real[i] * real[i] + imaginary[i] * imaginary[i]);
+      }
+    }
+  };
+
+  // PpgSpectrum::RealFftMagnitude() with the scaling of Ppg : Q8 samples shifted below 2^23, magnitudes rounded to Q4
+  struct FixedPointFft {
+    static void Magnitude(Signal& real, Signal& /*imaginary*/) {
+      std::array<int32_t, dataLength> signal;
+      int32_t peak = 0;
+      for (int i = 0; i < dataLength; i++) {
+        signal[i] = static_cast<int32_t>(std::lround(real[i] * 256.0f));
+        peak = std::max(peak, std::abs(signal[i]));
+      }
+      int shift = 0;
+      while ((peak >> shift) >= (1 << 23)) {
+        shift++;
+      }
+      for (int32_t& value : signal) {
+        value >>= shift;
+      }
+      std::array<uint32_t, spectrumLength> magnitude;
+      Pinetime::Controllers::PpgSpectrum::RealFftMagnitude(signal, magnitude.data());
+      for (int i = 0; i < spectrumLength; i++) {
+        real[i] = std::round(std::ldexp(static_cast<float>(magnitude[i]), shift - 4)) / 16.0f;
+      }
+    }
+  };
+
+  // Old PeakSearch() : walks the linearly interpolated spectrum in steps of 0.01 bin, and returns the middle of the
+  // peak at threshold (bins)
+  inline float LinearInterpolation(const Spectrum& values, float x) {
+    if (x > static_cast<float>(spectrumLength - 1)) {
+      return values[spectrumLength - 1];
+    }
+    if (x <= 0.0f) {
+      return values[0];
+    }
+    int index = 0;
+    while (x > static_cast<float>(index) && index < spectrumLength - 1) {
+      index++;
+    }
+    float mu = x - static_cast<float>(index - 1);
+    return values[index - 1] * (1 - mu) + values[index] * mu;
+  }
+
+  inline float PeakSearch(const Spectrum& values, float threshold, float& width, float start, float end) {
+    int peaks = 0;
+    bool enabled = false;
+    float minBin = 0.0f;
+    float peakCenter = 0.0f;
+    float prevValue = LinearInterpolation(values, start - 0.01f);
+    float currValue = LinearInterpolation(values, start);
+    for (float idx = start; idx < end; idx += 0.01f) {
+      float nextValue = LinearInterpolation(values, idx + 0.01f);
+      if (currValue < threshold) {
+        enabled = true;
+      }
+      if (currValue >= threshold && enabled) {
+        if (prevValue < threshold) {
+          minBin = idx;
+        } else if (nextValue <= threshold) {
+          peaks++;
+          width = idx - minBin;
+          peakCenter = width / 2.0f + minBin;
+        }
+      }
+      prevValue = currValue;
+      currValue = nextValue;
+    }
+    if (peaks != 1) {
+      width = 0.0f;
+      peakCenter = 0.0f;
+    }
+    return peakCenter;
+  }
+
+  // The old PeakSearch() in the pipeline : middle of the peak at threshold
+  struct StepwiseSearch {
+    static float Peak(const Spectrum& spectrum, float threshold, float& width, int start, int end) {
+      return PeakSearch(spectrum, threshold, width, static_cast<float>(start), static_cast<float>(end));
+    }
+  };
+
+  // PpgSpectrum::PeakSearch() on the spectrum rounded to Q4, like in Ppg : vertex of the parabola through the highest bin
+  struct VertexSearch {
+    static float Peak(const Spectrum& spectrum, float threshold, float& width, int start, int end) {
+      std::array<uint32_t, spectrumLength> values;
+      for (int idx = 0; idx < spectrumLength; idx++) {
+        values[idx] = static_cast<uint32_t>(std::lround(spectrum[idx] * 16.0f));
+      }
+      int steps = 0;
+      int peak = Pinetime::Controllers::PpgSpectrum::PeakSearch(values.data(), static_cast<int64_t>(threshold * 16.0f), steps, start, end);
+      width = static_cast<float>(steps) / Pinetime::Controllers::Ppg::binSubdivisions;
+      return static_cast<float>(peak) / Pinetime::Controllers::Ppg::binSubdivisions;
+    }
+  };
+
+  // Old Filter30to240() : 4 low-pass then 4 high-pass exponential moving averages over the whole window
+  inline void Filter30to240(Signal& signal) {
+    float expAlpha = 0.816f;
+    for (int loop = 0; loop < 4; loop++) {
+      float expAvg = signal.front();
+      for (float& value : signal) {
+        expAvg = expAlpha * value + (1 - expAlpha) * expAvg;
+        value = expAvg;
+      }
+    }
+    expAlpha = 0.268f;
+    for (int loop = 0; loop < 4; loop++) {
+      float expAvg = signal.front();
+      for (float& value : signal) {
+        expAvg = expAlpha * value + (1 - expAlpha) * expAvg;
+        value -= expAvg;
+      }
+    }
+  }
+
+  // Old Detrend() : removes the line between the first and the last samples, then differentiates
+  inline void Detrend(Signal& signal) {
+    float offset = signal.front();
+    float slope = (signal.back() - offset) / static_cast<float>(dataLength - 1);
+    for (int idx = 0; idx < dataLength; idx++) {
+      signal[idx] -= slope * static_cast<float>(idx) + offset;
+    }
+    for (int idx = 0; idx < dataLength - 1; idx++) {
+      signal[idx] = signal[idx + 1] - signal[idx];
+    }
+  }
+
+  // The band-pass filter of the current Ppg at 10Hz, in float and sample by sample : 4 low-pass then 4 high-pass
+  // exponential moving averages, starting from 0
+  class BandPass {
+  public:
+    float Filter(float sample) {
+      constexpr float lowPassAlpha = 31213.0f / 32768.0f;
+      constexpr float highPassAlpha = 2861.0f / 32768.0f;
+      for (size_t stage = 0; stage < 4; stage++) {
+        state[stage] += lowPassAlpha * (sample - state[stage]);
+        sample = state[stage];
+      }
+      for (size_t stage = 4; stage < 8; stage++) {
+        state[stage] += highPassAlpha * (sample - state[stage]);
+        sample -= state[stage];
+      }
+      return sample;
+    }
+
+  private:
+    std::array<float, 8> state {};
+  };
+
+  // The Hanning window of the old Ppg (numpy.hanning(64)), a table like in the firmware
+  inline float Hanning(int idx) {
+    static const auto window = []() {
+      constexpr double pi = 3.14159265358979323846;
+      Signal coefficients;
+      for (int n = 0; n < dataLength; n++) {
+        coefficients[n] = static_cast<float>(0.5 - 0.5 * std::cos(2 * pi * n / (dataLength - 1)));
+      }
+      return coefficients;
+    }();
+    return window[idx];
+  }
+
+  // Old Ppg, at 10Hz, with the same buffers
+  template <typename Fft = FloatFft, typename Search = StepwiseSearch>
+  class Ppg {
+  public:
+    static constexpr float sampleFreq = 10.0f;
+    static constexpr float freqResolution = sampleFreq / dataLength;
+
+    Ppg() {
+      dataAverage.fill(0.0f);
+      spectrum.fill(0.0f);
+    }
+
+    int8_t Preprocess(uint16_t hrs, uint16_t als) {
+      if (dataIndex < dataLength) {
+        dataHRS[dataIndex++] = hrs;
+      }
+      alsValue = als;
+      return alsValue > alsThreshold ? 1 : 0;
+    }
+
+    int HeartRate() {
+      if (dataIndex < dataLength) {
+        return enoughData ? 0 : -2;
+      }
+      enoughData = true;
+      int hr = ProcessHeartRate(resetSpectralAvg);
+      resetSpectralAvg = false;
+      for (int idx = 0; idx < dataLength - overlapWindow; idx++) {
+        dataHRS[idx] = dataHRS[idx + overlapWindow];
+      }
+      dataIndex = dataLength - overlapWindow;
+      return hr;
+    }
+
+    // Averaged magnitude spectrum of the last update
+    const Spectrum& LastSpectrum() const {
+      return spectrum;
+    }
+
+  private:
+    static constexpr uint16_t overlapWindow = 5;
+    static constexpr uint16_t spectralAvgMax = 2;
+    static constexpr float peakDetectionThreshold = 0.6f;
+    static constexpr float maxPeakWidth = 2.5f;
+    static constexpr float signalToNoiseThreshold = 3.0f;
+    static constexpr uint16_t hrROIbegin = static_cast<uint16_t>((30.0f / 60.0f) / freqResolution + 0.5f);
+    static constexpr uint16_t hrROIend = static_cast<uint16_t>((240.0f / 60.0f) / freqResolution + 0.5f);
+    static constexpr float minHR = 40.0f / 60.0f;
+    static constexpr float maxHR = 230.0f / 60.0f;
+    static constexpr float dcThreshold = 0.5f;
+    static constexpr float alsFactor = 2.0f;
+
+    int ProcessHeartRate(bool init) {
+      std::copy(dataHRS.begin(), dataHRS.end(), vReal.begin());
+      Detrend(vReal);
+      Filter30to240(vReal);
+      vImag.fill(0.0f);
+      for (int idx = 0; idx < dataLength; idx++) {
+        vReal[idx] *= Hanning(idx);
+      }
+      Fft::Magnitude(vReal, vImag);
+
+      float count = static_cast<float>(init ? 0 : spectralAvgCount);
+      spectralAvgCount = init ? 0 : spectralAvgCount;
+      for (int idx = 0; idx < spectrumLength; idx++) {
+        spectrum[idx] = (spectrum[idx] * count + vReal[idx]) / (count + 1);
+      }
+      if (spectralAvgCount < spectralAvgMax) {
+        spectralAvgCount++;
+      }
+
+      peakLocation = 0.0f;
+      float peakWidth = 0.0f;
+      float max = 0.0f;
+      float mean = 0.0f;
+      for (int idx = hrROIbegin; idx < hrROIend; idx++) {
+        max = std::max(max, spectrum[idx]);
+        mean += spectrum[idx];
+      }
+      mean /= static_cast<float>(hrROIend - hrROIbegin);
+      if (max / mean > signalToNoiseThreshold && spectrum[0] < dcThreshold) {
+        peakLocation = Search::Peak(spectrum, peakDetectionThreshold * max, peakWidth, hrROIbegin, hrROIend);
+        peakLocation *= freqResolution;
+      }
+      if (peakWidth > maxPeakWidth || peakLocation < minHR || peakLocation > maxHR) {
+        peakLocation = 0.0f;
+      }
+      if (peakLocation == 0.0f) {
+        resetSpectralAvg = true;
+      }
+      alsThreshold = static_cast<uint16_t>(alsValue * alsFactor);
+      peakLocation = HeartRateAverage(peakLocation);
+      int rtn = -1;
+      if (peakLocation == 0.0f && lastPeakLocation > 0.0f) {
+        lastPeakLocation = 0.0f;
+      } else {
+        lastPeakLocation = peakLocation;
+        rtn = static_cast<int>((peakLocation * 60.0f) + 0.5f);
+      }
+      return rtn;
+    }
+
+    float HeartRateAverage(float hr) {
+      avgIndex = static_cast<uint16_t>((avgIndex + 1) % dataAverage.size());
+      dataAverage[avgIndex] = hr;
+      float avg = 0.0f;
+      float total = 0.0f;
+      for (float value : dataAverage) {
+        if (value > 0.0f) {
+          avg += value;
+          total++;
+        }
+      }
+      return total > 0 ? avg / total : 0.0f;
+    }
+
+    std::array<uint16_t, dataLength> dataHRS;
+    Signal vReal;
+    Signal vImag;
+    Spectrum spectrum;
+    std::array<float, 20> dataAverage;
+
+    uint16_t avgIndex = 0;
+    uint16_t spectralAvgCount = 0;
+    float lastPeakLocation = 0.0f;
+    uint16_t alsThreshold = UINT16_MAX;
+    uint16_t alsValue = 0;
+    uint16_t dataIndex = 0;
+    float peakLocation = 0.0f;
+    bool resetSpectralAvg = true;
+    bool enoughData = false;
+  };
+}
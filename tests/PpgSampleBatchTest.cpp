@@ -0,0 +1,87 @@
+#include "components/ble/PpgSampleBatch.h"
+#include <algorithm>
+#include <cstdint>
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr PpgSampleBatch::SensorConfig config {100, 0x2f, 0x60, 0x02};
+
+  uint32_t ReadLe(const uint8_t* data, size_t size) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < size; i++) {
+      value |= static_cast<uint32_t>(data[i]) << (8 * i);
+    }
+    return value;
+  }
+
+  void TestHeader() {
+    PpgSampleBatch batch;
+    batch.Start(config, 0x12345678, true);
+    CHECK(batch.IsEmpty());
+    CHECK_EQUAL(batch.Size(), PpgSampleBatch::headerSize);
+    CHECK(batch.Config() == config);
+
+    const uint8_t* data = batch.Data();
+    CHECK_EQUAL(data[0], PpgSampleBatch::flagNewMeasurement);
+    CHECK_EQUAL(data[1], config.samplePeriod);
+    CHECK_EQUAL(data[2], config.ledDriveCurrent);
+    CHECK_EQUAL(data[3], config.resolution);
+    CHECK_EQUAL(data[4], config.gain);
+    CHECK_EQUAL(data[5], 0);
+    CHECK_EQUAL(ReadLe(data + 6, 4), 0x12345678);
+
+    batch.Start(config, 0, false);
+    CHECK_EQUAL(batch.Data()[0], 0);
+  }
+
+  void TestSamples() {
+    PpgSampleBatch batch;
+    batch.Start(config, 42, false);
+    for (uint32_t i = 0; i < 10; i++) {
+      CHECK(batch.Append(static_cast<uint16_t>(i * 6000), static_cast<uint16_t>(65535 - i), PpgSampleBatch::maxSize));
+    }
+    CHECK_EQUAL(batch.Count(), 10);
+    CHECK_EQUAL(batch.Data()[5], 10);
+    CHECK_EQUAL(batch.Size(), PpgSampleBatch::headerSize + 10 * PpgSampleBatch::sampleSize);
+    for (uint32_t i = 0; i < 10; i++) {
+      const uint8_t* sample = batch.Data() + PpgSampleBatch::headerSize + i * PpgSampleBatch::sampleSize;
+      CHECK_EQUAL(ReadLe(sample, 2), i * 6000);
+      CHECK_EQUAL(ReadLe(sample + 2, 2), 65535 - i);
+    }
+
+    batch.Clear();
+    CHECK(batch.IsEmpty());
+    // Cleared, a new batch must be started first
+    CHECK(!batch.Append(0, 0, PpgSampleBatch::maxSize));
+  }
+
+  size_t Fill(PpgSampleBatch& batch, size_t sizeLimit) {
+    batch.Start(config, 0, false);
+    size_t count = 0;
+    while (batch.Append(1, 2, sizeLimit)) {
+      count++;
+    }
+    CHECK(batch.Size() <= std::min(sizeLimit, PpgSampleBatch::maxSize));
+    CHECK_EQUAL(batch.Count(), count);
+    return count;
+  }
+
+  void TestSizeLimit() {
+    PpgSampleBatch batch;
+    // Default MTU (20 bytes of payload)
+    CHECK_EQUAL(Fill(batch, 20), 2);
+    CHECK_EQUAL(Fill(batch, PpgSampleBatch::maxSize), (PpgSampleBatch::maxSize - PpgSampleBatch::headerSize) / PpgSampleBatch::sampleSize);
+    // Clamped to maxSize
+    CHECK_EQUAL(Fill(batch, 1000), (PpgSampleBatch::maxSize - PpgSampleBatch::headerSize) / PpgSampleBatch::sampleSize);
+    CHECK_EQUAL(Fill(batch, PpgSampleBatch::headerSize), 0);
+  }
+}
+
+int main() {
+  TestHeader();
+  TestSamples();
+  TestSizeLimit();
+  return Test::Result();
+}
@@ -0,0 +1,228 @@
+#include "components/heartrate/PpgSensorControl.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "components/heartrate/Ppg.h"
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+
+/* Drives PpgSensorControl with synthetic levels of the ADC : the light reflected by the skin and the ambient light are
+ * given relative to the full scale at the lowest exposure (12.5mA, 1x), and each sample is converted with the settings
+ * chosen by PpgSensorControl, like the HRS3300 would.
+ */
+namespace {
+  struct Exposure {
+    uint8_t ledDriveCurrent;
+    uint8_t gain;
+
+    bool operator==(const Exposure& other) const {
+      return ledDriveCurrent == other.ledDriveCurrent && gain == other.gain;
+    }
+  };
+
+  // The settling of an exposure : 2 samples discarded, then the mean of 4
+  constexpr int samplesPerExposure = 6;
+  constexpr int outOfRangeSamples = 5;
+  constexpr int maxSamplesWithoutHeartRate = 48;
+
+  struct Sensor {
+    Sensor() {
+      control.Start();
+    }
+
+    // ADC value of a light relative to the full scale, with the current resolution
+    uint16_t Convert(double light) const {
+      const auto& config = control.SensorConfig();
+      auto fullScale = static_cast<double>((1U << config.resolution) - 1);
+      return static_cast<uint16_t>(std::clamp(std::round(light * fullScale), 0.0, fullScale));
+    }
+
+    // Converted with the current settings. Returns true if they changed.
+    bool Sample(double reflected, double ambient) {
+      static constexpr double ledDriveCurrents[] {12.5, 20.0, 30.0, 40.0};
+      static constexpr double gains[] {1.0, 2.0, 4.0, 8.0, 64.0};
+      const auto& config = control.SensorConfig();
+      double hrs = reflected * ledDriveCurrents[config.ledDriveCurrent] / ledDriveCurrents[0] * gains[config.gain];
+      return control.OnSample(Convert(hrs), Convert(ambient));
+    }
+
+    // Samples until the settings change, at most maxSamples. Returns the number of samples.
+    int RunUntilChange(double reflected, double ambient, int maxSamples = 200) {
+      for (int n = 1; n <= maxSamples; n++) {
+        if (Sample(reflected, ambient)) {
+          return n;
+        }
+      }
+      return maxSamples;
+    }
+
+    // Heart rate values, one for each sample
+    bool HeartRate(int bpm, int nbValues) {
+      bool changed = false;
+      for (int n = 0; n < nbValues; n++) {
+        changed = control.OnHeartRate(bpm) || changed;
+      }
+      return changed;
+    }
+
+    Exposure CurrentExposure() const {
+      return {control.SensorConfig().ledDriveCurrent, control.SensorConfig().gain};
+    }
+
+    bool IsLowRate() const {
+      const auto& config = control.SensorConfig();
+      bool lowRate = config.resolution == 14 && config.waitTime == 3 && control.SamplePeriod() == Ppg::longSamplePeriod;
+      bool normalRate = config.resolution == 15 && config.waitTime == 5 && control.SamplePeriod() == Ppg::defaultSamplePeriod;
+      CHECK(lowRate != normalRate);
+      return lowRate;
+    }
+
+    PpgSensorControl control;
+  };
+
+  // A new measurement starts at the lowest exposure and the normal rate
+  void TestStart() {
+    Sensor sensor;
+    const auto& config = sensor.control.SensorConfig();
+    CHECK(sensor.CurrentExposure() == (Exposure {0, 0}));
+    CHECK_EQUAL(config.resolution, 15);
+    CHECK_EQUAL(config.waitTime, 5);
+    CHECK_EQUAL(sensor.control.SamplePeriod(), Ppg::defaultSamplePeriod);
+  }
+
+  // A weak level gets more LED current first, then more gain, one step per settling, until it is above 20% : 3% needs
+  // 40mA and 4x (38%)
+  void TestWeak() {
+    Sensor sensor;
+    const std::vector<Exposure> expected {{1, 0}, {2, 0}, {3, 0}, {3, 1}, {3, 2}};
+    for (const auto& exposure : expected) {
+      CHECK_EQUAL(sensor.RunUntilChange(0.03, 0.0), samplesPerExposure);
+      CHECK(sensor.CurrentExposure() == exposure);
+    }
+    // Measuring
+    CHECK_EQUAL(sensor.RunUntilChange(0.03, 0.0), 200);
+    CHECK(!sensor.IsLowRate());
+
+    // No pulse is found at the normal rate : nothing changes
+    CHECK(!sensor.HeartRate(0, 100));
+  }
+
+  // The watch moved : the level saturates for 5 samples while measuring, and the exposure goes down until it is below 80%
+  // again. 4 samples are not enough, the level of a single sample can jump with the pulse or the movements.
+  void TestSaturated() {
+    Sensor sensor;
+    while (!(sensor.CurrentExposure() == Exposure {3, 2})) {
+      sensor.RunUntilChange(0.03, 0.0);
+    }
+    sensor.RunUntilChange(0.03, 0.0, 50);
+
+    for (int n = 0; n < outOfRangeSamples - 1; n++) {
+      CHECK(!sensor.Sample(0.2, 0.0));
+    }
+    CHECK_EQUAL(sensor.RunUntilChange(0.03, 0.0, 50), 50);
+
+    // Settling again after the 5th sample, then 2.56 -> 1.28 -> 0.64
+    CHECK_EQUAL(sensor.RunUntilChange(0.2, 0.0), outOfRangeSamples + samplesPerExposure - 1);
+    CHECK(sensor.CurrentExposure() == (Exposure {3, 1}));
+    CHECK_EQUAL(sensor.RunUntilChange(0.2, 0.0), samplesPerExposure);
+    CHECK(sensor.CurrentExposure() == (Exposure {3, 0}));
+    CHECK_EQUAL(sensor.RunUntilChange(0.2, 0.0), 200);
+  }
+
+  // The level drops below 5% (the watch was taken off the skin) : the exposure goes up again
+  void TestLost() {
+    Sensor sensor;
+    CHECK_EQUAL(sensor.RunUntilChange(0.4, 0.0), 200);
+    CHECK(sensor.CurrentExposure() == (Exposure {0, 0}));
+    CHECK_EQUAL(sensor.RunUntilChange(0.01, 0.0), outOfRangeSamples + samplesPerExposure - 1);
+    CHECK(sensor.CurrentExposure() == (Exposure {1, 0}));
+  }
+
+  // Above 80% at the lowest exposure, there is nothing to lower : it measures at the lowest exposure
+  void TestTooBright() {
+    Sensor sensor;
+    CHECK_EQUAL(sensor.RunUntilChange(0.85, 0.5), 200);
+    CHECK(sensor.CurrentExposure() == (Exposure {0, 0}));
+    CHECK(!sensor.IsLowRate());
+  }
+
+  // A strong level at the lowest exposure with little ambient light switches to the low rate, at 14 bits and 125ms. The
+  // level relative to the full scale is the same at 14 bits, so it keeps measuring.
+  void TestLowRate() {
+    Sensor sensor;
+    CHECK_EQUAL(sensor.RunUntilChange(0.6, 0.05), samplesPerExposure);
+    CHECK(sensor.IsLowRate());
+    CHECK(sensor.CurrentExposure() == (Exposure {0, 0}));
+    CHECK_EQUAL(sensor.RunUntilChange(0.6, 0.05), 200);
+    CHECK(sensor.IsLowRate());
+  }
+
+  // Too much ambient light (more than 10% of the reflected light) or a level below 50% keeps the normal rate
+  void TestNormalRate() {
+    Sensor sensor;
+    CHECK_EQUAL(sensor.RunUntilChange(0.6, 0.07), 200);
+    CHECK(!sensor.IsLowRate());
+
+    Sensor weaker;
+    CHECK_EQUAL(weaker.RunUntilChange(0.45, 0.0), 200);
+    CHECK(!weaker.IsLowRate());
+  }
+
+  // Without a heart rate for 48 samples at the low rate (6s), it goes back to the normal rate for the rest of the
+  // measurement. A reading restarts the count, and -2 (the window is not full yet) does not count.
+  void TestNoHeartRateAtLowRate() {
+    Sensor sensor;
+    sensor.RunUntilChange(0.6, 0.0);
+    CHECK(sensor.IsLowRate());
+
+    CHECK(!sensor.HeartRate(-2, 100));
+    CHECK(!sensor.HeartRate(0, maxSamplesWithoutHeartRate - 1));
+    CHECK(!sensor.HeartRate(72, 1));
+    CHECK(!sensor.HeartRate(0, maxSamplesWithoutHeartRate - 2));
+    CHECK(!sensor.HeartRate(-1, 1));
+    CHECK(sensor.HeartRate(0, 1));
+    CHECK(!sensor.IsLowRate());
+
+    // Settling again (the watch moved) does not go back to the low rate
+    for (int n = 0; n < outOfRangeSamples; n++) {
+      sensor.Sample(0.001, 0.0);
+    }
+    CHECK_EQUAL(sensor.RunUntilChange(0.6, 0.0), 200);
+    CHECK(!sensor.IsLowRate());
+
+    // Until the next measurement
+    sensor.control.Start();
+    CHECK(!sensor.IsLowRate());
+    CHECK_EQUAL(sensor.RunUntilChange(0.6, 0.0), samplesPerExposure);
+    CHECK(sensor.IsLowRate());
+  }
+
+  // Start() goes back to the lowest exposure and to the normal rate, whatever the previous measurement ended with
+  void TestRestart() {
+    Sensor sensor;
+    while (!(sensor.CurrentExposure() == Exposure {3, 0})) {
+      sensor.RunUntilChange(0.05, 0.0);
+    }
+    sensor.control.Start();
+    CHECK(sensor.CurrentExposure() == (Exposure {0, 0}));
+    CHECK(!sensor.IsLowRate());
+    // The settling starts over, with its discarded samples
+    CHECK_EQUAL(sensor.RunUntilChange(0.05, 0.0), samplesPerExposure);
+    CHECK(sensor.CurrentExposure() == (Exposure {1, 0}));
+  }
+}
+
+int main() {
+  TestStart();
+  TestWeak();
+  TestSaturated();
+  TestLost();
+  TestTooBright();
+  TestLowRate();
+  TestNormalRate();
+  TestNoHeartRateAtLowRate();
+  TestRestart();
+  return Test::Result();
+}
@@ -0,0 +1,405 @@
+#include "components/heartrate/PpgSpectrum.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Check.h"
+#include "PpgReference.h"
+#include "PpgTraces.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  using Signal = std::array<int32_t, Ppg::dataLength>;
+  using Spectrum = std::array<uint32_t, Ppg::spectrumLength>;
+
+  const double pi = std::acos(-1.0);
+
+  // Reference : magnitude of the DFT in double precision
+  std::array<double, Ppg::spectrumLength> Dft(const Signal& signal) {
+    std::array<double, Ppg::spectrumLength> magnitude;
+    for (size_t k = 0; k < magnitude.size(); k++) {
+      double real = 0;
+      double imaginary = 0;
+      for (size_t n = 0; n < signal.size(); n++) {
+        double angle = 2 * pi * static_cast<double>(k * n) / Ppg::dataLength;
+        real += signal[n] * std::cos(angle);
+        imaginary -= signal[n] * std::sin(angle);
+      }
+      magnitude[k] = std::hypot(real, imaginary);
+    }
+    return magnitude;
+  }
+
+  Spectrum Fft(Signal signal) {
+    Spectrum magnitude;
+    PpgSpectrum::RealFftMagnitude(signal, magnitude.data());
+    return magnitude;
+  }
+
+  // The magnitudes are rounded to integers and the FFT rounds at each stage : a few LSB of error, plus a small relative
+  // error on large signals
+  bool Accurate(const Signal& signal) {
+    auto reference = Dft(signal);
+    auto magnitude = Fft(signal);
+    double peak = *std::max_element(reference.begin(), reference.end());
+    for (size_t k = 0; k < magnitude.size(); k++) {
+      if (std::abs(magnitude[k] - reference[k]) > 8 + peak * 1e-6) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void TestDc() {
+    Signal signal;
+    signal.fill(1000);
+    auto magnitude = Fft(signal);
+    CHECK_EQUAL(magnitude[0], 64 * 1000);
+    for (size_t k = 1; k < magnitude.size(); k++) {
+      CHECK(magnitude[k] <= 2);
+    }
+  }
+
+  void TestSinusoids() {
+    // A sinusoid of amplitude A in bin k gives a magnitude of A * 32 in this bin, including the highest one
+    for (size_t bin = 1; bin < Ppg::spectrumLength; bin++) {
+      Signal signal;
+      for (size_t n = 0; n < signal.size(); n++) {
+        signal[n] = static_cast<int32_t>(std::lround(100000 * std::cos(2 * pi * static_cast<double>(bin * n) / Ppg::dataLength + 0.3)));
+      }
+      auto magnitude = Fft(signal);
+      for (size_t k = 0; k < magnitude.size(); k++) {
+        if (k == bin) {
+          CHECK(std::abs(static_cast<double>(magnitude[k]) - 3200000) < 50);
+        } else {
+          CHECK(magnitude[k] < 50);
+        }
+      }
+    }
+  }
+
+  void TestRandomSignals() {
+    uint32_t state = 1;
+    auto next = [&state]() {
+      state = state * 1664525 + 1013904223;
+      return state;
+    };
+
+    // Full range (below 2^23 after NormaliseBlock), and small signals where the rounding matters more
+    for (int32_t amplitude : {(1 << 23) - 1, 1 << 16, 1 << 8}) {
+      bool accurate = true;
+      for (int i = 0; i < 200; i++) {
+        Signal signal;
+        for (auto& sample : signal) {
+          sample = static_cast<int32_t>(next() % (2 * static_cast<uint32_t>(amplitude) + 1)) - amplitude;
+        }
+        accurate = accurate && Accurate(signal);
+      }
+      CHECK(accurate);
+    }
+
+    // Extreme values : no overflow
+    Signal extreme;
+    for (size_t n = 0; n < extreme.size(); n++) {
+      extreme[n] = (n % 2 == 0) ? (1 << 23) - 1 : -(1 << 23) + 1;
+    }
+    CHECK(Accurate(extreme));
+    extreme.fill((1 << 23) - 1);
+    CHECK(Accurate(extreme));
+  }
+  Spectrum WithBins(size_t first, std::initializer_list<uint32_t> values) {
+    Spectrum spectrum {};
+    std::copy(values.begin(), values.end(), spectrum.begin() + first);
+    return spectrum;
+  }
+
+  void TestParabolicPeak() {
+    // Symmetric : on the bin
+    auto symmetric = WithBins(9, {60, 100, 60});
+    CHECK_EQUAL(PpgSpectrum::ParabolicPeak(symmetric.data(), 10), 10 * Ppg::binSubdivisions);
+
+    // Vertex of the parabola through (9, 60), (10, 100) and (11, 80) : 10 + 20 / 120
+    auto asymmetric = WithBins(9, {60, 100, 80});
+    CHECK_EQUAL(PpgSpectrum::ParabolicPeak(asymmetric.data(), 10), 1016);
+
+    // Sampled parabola with its vertex at 7.3
+    Spectrum parabola;
+    for (size_t k = 0; k < parabola.size(); k++) {
+      double offset = static_cast<double>(k) - 7.3;
+      parabola[k] = static_cast<uint32_t>(std::lround(std::max(0.0, 100000 - 1000 * offset * offset)));
+    }
+    CHECK(std::abs(PpgSpectrum::ParabolicPeak(parabola.data(), 7) - 730) <= 1);
+
+    // Flat : no curvature
+    auto flat = WithBins(4, {50, 50, 50});
+    CHECK_EQUAL(PpgSpectrum::ParabolicPeak(flat.data(), 5), 5 * Ppg::binSubdivisions);
+  }
+
+  void TestPeakSearch() {
+    int width = -1;
+
+    // Crosses 50 at 8.75 and 11.25
+    auto single = WithBins(8, {20, 60, 100, 60, 20});
+    CHECK_EQUAL(PpgSpectrum::PeakSearch(single.data(), 50, width, 2, 20), 10 * Ppg::binSubdivisions);
+    CHECK_EQUAL(width, 250);
+
+    // The highest bin is not the first one above the threshold, crosses 50 at 8.75 and 11.66
+    auto rising = WithBins(8, {20, 60, 70, 90, 30});
+    CHECK_EQUAL(PpgSpectrum::PeakSearch(rising.data(), 50, width, 2, 20), 1075);
+    CHECK_EQUAL(width, 1166 - 875);
+
+    // Two peaks : no result
+    auto twoPeaks = WithBins(4, {20, 80, 20, 0, 0, 0, 30, 90, 30});
+    CHECK_EQUAL(PpgSpectrum::PeakSearch(twoPeaks.data(), 50, width, 2, 20), 0);
+    CHECK_EQUAL(width, 0);
+    // One of them outside of the range
+    CHECK_EQUAL(PpgSpectrum::PeakSearch(twoPeaks.data(), 50, width, 2, 9), 5 * Ppg::binSubdivisions);
+    CHECK_EQUAL(width, 100);
+
+    // A bin equal to the threshold is not a peak
+    auto touching = WithBins(4, {20, 80, 20, 0, 0, 0, 30, 50, 30});
+    CHECK_EQUAL(PpgSpectrum::PeakSearch(touching.data(), 50, width, 2, 20), 5 * Ppg::binSubdivisions);
+    CHECK_EQUAL(width, 100);
+
+    // Peaks that are not entirely in the range are ignored
+    CHECK_EQUAL(PpgSpectrum::PeakSearch(single.data(), 50, width, 10, 20), 0);
+    CHECK_EQUAL(width, 0);
+    CHECK_EQUAL(PpgSpectrum::PeakSearch(single.data(), 50, width, 2, 10), 0);
+    CHECK_EQUAL(width, 0);
+
+    // Nothing above the threshold
+    CHECK_EQUAL(PpgSpectrum::PeakSearch(single.data(), 200, width, 2, 20), 0);
+    CHECK_EQUAL(width, 0);
+  }
+
+  // The old pipeline on a recording, with its float FFT and with the fixed-point one
+  struct Comparison {
+    int updates = 0;
+    // Updates where the old pipeline found the heart rate
+    int readings = 0;
+    // Updates where only one of them found the heart rate
+    int disagreements = 0;
+    int maxDifference = 0;
+    // Largest difference between the averaged spectra, relative to their maximum
+    float maxSpectrumError = 0.0f;
+    // Mean absolute error against the heart rate of the recording, over the valid readings
+    float floatError = 0.0f;
+    float fixedPointError = 0.0f;
+  };
+
+  Comparison Compare(const Traces::Trace& trace) {
+    Reference::Ppg<Reference::FloatFft> floatPpg;
+    Reference::Ppg<Reference::FixedPointFft> fixedPointPpg;
+    Comparison comparison;
+    int nbFixedPoint = 0;
+    for (size_t n = 0; n < trace.size(); n++) {
+      const auto& sample = trace[n];
+      floatPpg.Preprocess(sample.hrs, sample.als);
+      fixedPointPpg.Preprocess(sample.hrs, sample.als);
+      int reference = floatPpg.HeartRate();
+      int hr = fixedPointPpg.HeartRate();
+      // Updated when the window is full, then every 5 samples
+      if (n + 1 < Reference::dataLength || (n + 1 - Reference::dataLength) % 5 != 0) {
+        continue;
+      }
+      comparison.updates++;
+      const auto& referenceSpectrum = floatPpg.LastSpectrum();
+      const auto& spectrum = fixedPointPpg.LastSpectrum();
+      float peak = *std::max_element(referenceSpectrum.begin(), referenceSpectrum.end());
+      for (size_t k = 0; k < spectrum.size(); k++) {
+        comparison.maxSpectrumError = std::max(comparison.maxSpectrumError, std::abs(spectrum[k] - referenceSpectrum[k]) / peak);
+      }
+      if ((reference > 0) != (hr > 0)) {
+        comparison.disagreements++;
+      } else if (reference > 0) {
+        comparison.maxDifference = std::max(comparison.maxDifference, std::abs(hr - reference));
+      }
+      if (reference > 0) {
+        comparison.readings++;
+        comparison.floatError += std::abs(static_cast<float>(reference) - sample.heartRate);
+      }
+      if (hr > 0) {
+        comparison.fixedPointError += std::abs(static_cast<float>(hr) - sample.heartRate);
+        nbFixedPoint++;
+      }
+    }
+    comparison.floatError /= static_cast<float>(std::max(comparison.readings, 1));
+    comparison.fixedPointError /= static_cast<float>(std::max(nbFixedPoint, 1));
+    return comparison;
+  }
+
+  // The recordings are synthetic (see PpgTraces.h) : the fixed-point FFT gives the same readings as ArduinoFFT within
+  // 1 BPM, and the same decisions. Its spectra only differ by the rounding to Q4.
+  void TestRecordings(bool report) {
+    if (report) {
+      std::printf("%-12s %8s %9s %14s %10s %14s %10s %10s\n",
+                  "recording",
+                  "updates",
+                  "readings",
+                  "disagreements",
+                  "max diff",
+                  "spectrum err",
+                  "float err",
+                  "Q30 err");
+    }
+    for (const auto& parameters : Traces::Recordings()) {
+      auto comparison = Compare(Traces::Generate(parameters));
+      if (report) {
+        std::printf("%-12s %8d %9d %14d %10d %13.4f%% %10.2f %10.2f\n",
+                    parameters.name.c_str(),
+                    comparison.updates,
+                    comparison.readings,
+                    comparison.disagreements,
+                    comparison.maxDifference,
+                    100 * comparison.maxSpectrumError,
+                    comparison.floatError,
+                    comparison.fixedPointError);
+      }
+      CHECK(comparison.readings > comparison.updates / 2);
+      CHECK_EQUAL(comparison.disagreements, 0);
+      CHECK(comparison.maxDifference <= 1);
+      CHECK(comparison.maxSpectrumError < 0.005f);
+    }
+  }
+
+  // Averaged spectra of the old pipeline at each update, on all the recordings
+  std::vector<Reference::Spectrum> RecordedSpectra() {
+    std::vector<Reference::Spectrum> spectra;
+    auto recordings = Traces::Recordings();
+    auto motionRecordings = Traces::MotionRecordings();
+    recordings.insert(recordings.end(), motionRecordings.begin(), motionRecordings.end());
+    for (const auto& parameters : recordings) {
+      auto trace = Traces::Generate(parameters);
+      Reference::Ppg<> ppg;
+      for (size_t n = 0; n < trace.size(); n++) {
+        ppg.Preprocess(trace[n].hrs, trace[n].als);
+        ppg.HeartRate();
+        if (n + 1 >= Reference::dataLength && (n + 1 - Reference::dataLength) % 5 == 0) {
+          spectra.push_back(ppg.LastSpectrum());
+        }
+      }
+    }
+    return spectra;
+  }
+
+  // The single pass search takes the same decisions as the old stepwise one on the recorded spectra (synthetic, see
+  // PpgTraces.h), with the same widths within the 0.01 bin steps of the old one. Both get the spectrum in Q4 and the
+  // threshold of Ppg. It returns the vertex of the peak instead of the middle of its width at threshold.
+  void TestRecordedSpectra(bool report) {
+    constexpr int start = 3;
+    constexpr int end = 26;
+    constexpr float bpmPerBin = 10.0f / Reference::dataLength * 60.0f;
+    int nbSpectra = 0;
+    int nbAccepted = 0;
+    int nbDecisions = 0;
+    float maxWidthError = 0.0f;
+    float maxShift = 0.0f;
+    float meanShift = 0.0f;
+    for (auto spectrum : RecordedSpectra()) {
+      for (float& value : spectrum) {
+        value = std::round(value * 16.0f) / 16.0f;
+      }
+      auto max = static_cast<int64_t>(*std::max_element(spectrum.begin() + start, spectrum.begin() + end) * 16.0f);
+      float threshold = static_cast<float>(max * 60 / 100) / 16.0f;
+      float width = 0.0f;
+      float center = Reference::StepwiseSearch::Peak(spectrum, threshold, width, start, end);
+      float vertexWidth = 0.0f;
+      float vertex = Reference::VertexSearch::Peak(spectrum, threshold, vertexWidth, start, end);
+      bool accepted = center > 0.0f && width <= 2.5f;
+      bool vertexAccepted = vertex > 0.0f && vertexWidth <= 2.5f;
+      nbSpectra++;
+      if (accepted == vertexAccepted) {
+        nbDecisions++;
+      }
+      if (accepted && vertexAccepted) {
+        nbAccepted++;
+        maxWidthError = std::max(maxWidthError, std::abs(vertexWidth - width));
+        maxShift = std::max(maxShift, std::abs(vertex - center));
+        meanShift += std::abs(vertex - center);
+      }
+    }
+    meanShift /= static_cast<float>(std::max(nbAccepted, 1));
+    if (report) {
+      std::printf("%d spectra, %d accepted, %d same decisions, width error %.3f bins, vertex - center : max %.3f bins (%.2f BPM), "
+                  "mean %.3f bins (%.2f BPM)\n",
+                  nbSpectra,
+                  nbAccepted,
+                  nbDecisions,
+                  maxWidthError,
+                  maxShift,
+                  maxShift * bpmPerBin,
+                  meanShift,
+                  meanShift * bpmPerBin);
+    }
+    CHECK(nbAccepted > nbSpectra / 2);
+    CHECK_EQUAL(nbDecisions, nbSpectra);
+    CHECK(maxWidthError < 0.035f);
+    // Both are within the peak, the vertex is never more than a third of a bin from the middle
+    CHECK(maxShift < 0.35f);
+  }
+
+  // The old pipeline with the stepwise search and with the single pass one : the readings move by 1 BPM at most
+  void TestPeakSearchReadings(bool report) {
+    auto recordings = Traces::Recordings();
+    auto motionRecordings = Traces::MotionRecordings();
+    recordings.insert(recordings.end(), motionRecordings.begin(), motionRecordings.end());
+    if (report) {
+      std::printf("%-12s %9s %14s %10s %12s %12s\n", "recording", "readings", "disagreements", "max diff", "center err", "vertex err");
+    }
+    for (const auto& parameters : recordings) {
+      auto trace = Traces::Generate(parameters);
+      Reference::Ppg<Reference::FloatFft, Reference::StepwiseSearch> stepwise;
+      Reference::Ppg<Reference::FloatFft, Reference::VertexSearch> vertex;
+      int readings = 0;
+      int disagreements = 0;
+      int maxDifference = 0;
+      float centerError = 0.0f;
+      float vertexError = 0.0f;
+      for (const auto& sample : trace) {
+        stepwise.Preprocess(sample.hrs, sample.als);
+        vertex.Preprocess(sample.hrs, sample.als);
+        int reference = stepwise.HeartRate();
+        int hr = vertex.HeartRate();
+        if ((reference > 0) != (hr > 0)) {
+          disagreements++;
+        } else if (reference > 0) {
+          readings++;
+          maxDifference = std::max(maxDifference, std::abs(hr - reference));
+          centerError += std::abs(static_cast<float>(reference) - sample.heartRate);
+          vertexError += std::abs(static_cast<float>(hr) - sample.heartRate);
+        }
+      }
+      centerError /= static_cast<float>(std::max(readings, 1));
+      vertexError /= static_cast<float>(std::max(readings, 1));
+      if (report) {
+        std::printf("%-12s %9d %14d %10d %12.2f %12.2f\n",
+                    parameters.name.c_str(),
+                    readings,
+                    disagreements,
+                    maxDifference,
+                    centerError,
+                    vertexError);
+      }
+      CHECK_EQUAL(disagreements, 0);
+      CHECK(maxDifference <= 1);
+    }
+  }
+}
+
+// --report prints the comparisons with the old pipeline on each recording
+int main(int argc, char** argv) {
+  bool report = argc > 1 && std::strcmp(argv[1], "--report") == 0;
+  TestDc();
+  TestSinusoids();
+  TestRandomSignals();
+  TestParabolicPeak();
+  TestPeakSearch();
+  TestRecordings(report);
+  TestRecordedSpectra(report);
+  TestPeakSearchReadings(report);
+  return Test::Result();
+}
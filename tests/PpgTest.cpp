@@ -0,0 +1,220 @@
+#include "components/heartrate/Ppg.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "Check.h"
+#include "PpgReference.h"
+#include "PpgTraces.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr std::array<int16_t, MotionArtifactFilter::nbAxes> still {0, -310, -975};
+
+  // Updated when the window is full, then every 5 samples
+  bool IsUpdate(size_t index) {
+    return index + 1 >= Ppg::dataLength && (index + 1 - Ppg::dataLength) % 5 == 0;
+  }
+
+  // The band-pass filter of Ppg at 10Hz in a batch over the window, in float : from the level of the first sample, like
+  // the streaming filter at the start of an acquisition
+  Reference::Signal BatchFilter(Reference::Signal signal) {
+    Reference::BandPass filter;
+    float first = signal.front();
+    for (float& value : signal) {
+      value = filter.Filter(value - first);
+    }
+    return signal;
+  }
+
+  struct Comparison {
+    int updates = 0;
+    // Largest difference between the spectra in the heart rate region, relative to their peak
+    float maxSpectrumError = 0.0f;
+    int peakBinMismatches = 0;
+    // Updates where only the old pipeline found the heart rate, where only Ppg did (the old pipeline rejects the first
+    // windows, whose first difference starts with a step), and largest difference between the readings
+    int missed = 0;
+    int extra = 0;
+    int maxDifference = 0;
+    float error = 0.0f;
+    float referenceError = 0.0f;
+  };
+
+  // Ppg, filtering each sample, against the batch filter on each window (spectra), and against the old pipeline
+  // (readings). The spectra are averaged like in Ppg, which is never reset on these recordings.
+  Comparison Compare(const Traces::Trace& trace) {
+    constexpr int start = 3;
+    constexpr int end = 26;
+    Ppg ppg;
+    Reference::Ppg<> reference;
+    Reference::Spectrum average {};
+    int count = 0;
+    Comparison comparison;
+    int readings = 0;
+    int referenceReadings = 0;
+    for (size_t n = 0; n < trace.size(); n++) {
+      ppg.Preprocess(trace[n].hrs, trace[n].als, still);
+      reference.Preprocess(trace[n].hrs, trace[n].als);
+      int hr = ppg.HeartRate();
+      int referenceHr = reference.HeartRate();
+      if (!IsUpdate(n)) {
+        continue;
+      }
+      comparison.updates++;
+
+      Reference::Signal window;
+      for (int idx = 0; idx < Reference::dataLength; idx++) {
+        window[idx] = trace[n + 1 - Reference::dataLength + idx].hrs;
+      }
+      window = BatchFilter(window);
+      Reference::Signal imaginary {};
+      for (int idx = 0; idx < Reference::dataLength; idx++) {
+        window[idx] *= Reference::Hanning(idx);
+      }
+      Reference::FloatFft::Magnitude(window, imaginary);
+      for (int idx = 0; idx < Reference::spectrumLength; idx++) {
+        average[idx] = (average[idx] * static_cast<float>(count) + window[idx]) / static_cast<float>(count + 1);
+      }
+      count = std::min(count + 1, 2);
+
+      const auto& spectrum = ppg.Spectrum();
+      float peak = *std::max_element(average.begin() + start, average.begin() + end);
+      for (int idx = start; idx < end; idx++) {
+        float error = std::abs(static_cast<float>(spectrum[idx]) / 16.0f - average[idx]) / peak;
+        comparison.maxSpectrumError = std::max(comparison.maxSpectrumError, error);
+      }
+      if (std::max_element(spectrum.begin() + start, spectrum.begin() + end) - spectrum.begin() !=
+          std::max_element(average.begin() + start, average.begin() + end) - average.begin()) {
+        comparison.peakBinMismatches++;
+      }
+
+      if (hr <= 0 && referenceHr > 0) {
+        comparison.missed++;
+      } else if (hr > 0 && referenceHr <= 0) {
+        comparison.extra++;
+      } else if (hr > 0) {
+        comparison.maxDifference = std::max(comparison.maxDifference, std::abs(hr - referenceHr));
+      }
+      if (hr > 0) {
+        comparison.error += std::abs(static_cast<float>(hr) - trace[n].heartRate);
+        readings++;
+      }
+      if (referenceHr > 0) {
+        comparison.referenceError += std::abs(static_cast<float>(referenceHr) - trace[n].heartRate);
+        referenceReadings++;
+      }
+    }
+    comparison.error /= static_cast<float>(std::max(readings, 1));
+    comparison.referenceError /= static_cast<float>(std::max(referenceReadings, 1));
+    return comparison;
+  }
+
+  // On the recordings (synthetic, see PpgTraces.h), the streaming filter gives the spectra of the batch one, and the
+  // readings of the old pipeline within 1 BPM
+  void TestRecordings(bool report) {
+    if (report) {
+      std::printf("%-12s %8s %14s %12s %8s %8s %10s %12s %12s\n",
+                  "recording",
+                  "updates",
+                  "spectrum err",
+                  "peak moved",
+                  "missed",
+                  "extra",
+                  "max diff",
+                  "error",
+                  "old error");
+    }
+    for (const auto& parameters : Traces::Recordings()) {
+      auto comparison = Compare(Traces::Generate(parameters));
+      if (report) {
+        std::printf("%-12s %8d %13.2f%% %12d %8d %8d %10d %12.2f %12.2f\n",
+                    parameters.name.c_str(),
+                    comparison.updates,
+                    100 * comparison.maxSpectrumError,
+                    comparison.peakBinMismatches,
+                    comparison.missed,
+                    comparison.extra,
+                    comparison.maxDifference,
+                    comparison.error,
+                    comparison.referenceError);
+      }
+      CHECK(comparison.maxSpectrumError < 0.05f);
+      CHECK_EQUAL(comparison.peakBinMismatches, 0);
+      CHECK_EQUAL(comparison.missed, 0);
+      CHECK(comparison.maxDifference <= 1);
+      CHECK(comparison.error <= comparison.referenceError + 0.5f);
+    }
+  }
+
+  // Peak of the spectrum of a sinusoid of 100 counts at the middle of the given bin
+  uint32_t Response(uint8_t samplePeriod, int bin) {
+    const double pi = std::acos(-1.0);
+    Ppg ppg;
+    ppg.SetSamplePeriod(samplePeriod);
+    for (int n = 0; n < 400; n++) {
+      double value = 9000 + 100 * std::sin(2 * pi * bin * n / Ppg::dataLength);
+      ppg.Preprocess(static_cast<uint16_t>(std::lround(value)), 0, still);
+      ppg.HeartRate();
+    }
+    return ppg.Spectrum()[bin];
+  }
+
+  // The band-pass filter keeps the whole heart rate region, up to 4Hz (240 BPM), within 3dB
+  void TestBand() {
+    for (uint8_t samplePeriod : {Ppg::defaultSamplePeriod, Ppg::longSamplePeriod}) {
+      float resolution = 1000.0f / static_cast<float>(samplePeriod) / Ppg::dataLength;
+      int lowest = static_cast<int>(std::ceil(0.5f / resolution));
+      int highest = std::min(static_cast<int>(4.0f / resolution), Ppg::spectrumLength - 1);
+      uint32_t max = 0;
+      uint32_t min = UINT32_MAX;
+      for (int bin = lowest; bin <= highest; bin++) {
+        uint32_t response = Response(samplePeriod, bin);
+        max = std::max(max, response);
+        min = std::min(min, response);
+      }
+      CHECK(static_cast<float>(min) > 0.7f * static_cast<float>(max));
+      // The respiration and the drift are attenuated
+      CHECK(static_cast<float>(Response(samplePeriod, 1)) < 0.7f * static_cast<float>(min));
+    }
+  }
+
+  // A step of the level (the watch moved on the wrist) is not read as a heart rate while the filters settle : the readings
+  // are rejected, which restarts the confidence, and it comes back once the step is out of the window
+  void TestStep() {
+    constexpr size_t step = 400;
+    auto trace = Traces::Generate(Traces::Recordings().front());
+    Ppg ppg;
+    int nbRejected = 0;
+    uint8_t confidence = 0;
+    for (size_t n = 0; n < trace.size(); n++) {
+      uint16_t hrs = trace[n].hrs + (n >= step ? 400 : 0);
+      ppg.Preprocess(hrs, trace[n].als, still);
+      int hr = ppg.HeartRate();
+      if (n + 1 == step) {
+        CHECK_EQUAL(ppg.Confidence(), 100);
+      }
+      if (IsUpdate(n) && n >= step && n < step + Ppg::dataLength && ppg.Confidence() == 0) {
+        nbRejected++;
+      }
+      if (IsUpdate(n) && n >= step + 2 * Ppg::dataLength) {
+        CHECK(std::abs(static_cast<float>(hr) - trace[n].heartRate) <= 2.0f);
+      }
+      confidence = ppg.Confidence();
+    }
+    CHECK(nbRejected > 0);
+    CHECK_EQUAL(confidence, 100);
+  }
+}
+
+// --report prints the comparison with the batch filter and with the old pipeline on each recording
+int main(int argc, char** argv) {
+  bool report = argc > 1 && std::strcmp(argv[1], "--report") == 0;
+  TestRecordings(report);
+  TestBand();
+  TestStep();
+  return Test::Result();
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Synthetic recordings of the HRS3300 and of the accelerometer on a wrist, used instead of real recordings by the tests
+ * of the heart rate pipeline.
+ *
+ * The PPG signal is the sum of a DC level with a slow drift (pressure of the watch on the skin), the respiration (0.25Hz),
+ * the pulse (fundamental and 2 harmonics, for the shape of the systolic peak and of the dicrotic notch), white noise, and
+ * the artifact of the movements of the arm : the pressure changes with the acceleration, with a small delay and a second
+ * harmonic. The accelerometer sees the swing of the arm on y and z, plus gravity and its own noise. Everything is
+ * deterministic.
+ */
+namespace Traces {
+  struct Sample {
+    uint16_t hrs;
+    uint16_t als;
+    // 1024 = 1g
+    std::array<int16_t, 3> acceleration;
+    // Heart rate of the pulse at this sample (bpm)
+    float heartRate;
+  };
+
+  struct Parameters {
+    std::string name;
+    uint8_t samplePeriod = 100; // ms
+    size_t length = 900;
+    // Heart rate at the start and at the end, linear in between (bpm)
+    float startHeartRate = 70.0f;
+    float endHeartRate = 70.0f;
+    // Amplitudes (counts)
+    float pulse = 24.0f;
+    float respiration = 6.0f;
+    float noise = 1.5f;
+    float level = 9000.0f;
+    // Change of the DC level over the whole trace (counts)
+    float drift = 40.0f;
+    // Swing of the arm : frequency (Hz), acceleration (1024 = 1g) and artifact in the PPG signal (counts)
+    float swingFrequency = 0.0f;
+    float swing = 0.0f;
+    float artifact = 0.0f;
+    uint16_t als = 40;
+    uint32_t seed = 1;
+  };
+
+  using Trace = std::vector<Sample>;
+
+  // Gaussian noise from a linear congruential generator (Box-Muller)
+  class Noise {
+  public:
+    explicit Noise(uint32_t seed) : state {seed} {
+    }
+
+    float Next() {
+      float u1 = (static_cast<float>(NextInt() >> 8) + 1.0f) / 16777217.0f;
+      float u2 = static_cast<float>(NextInt() >> 8) / 16777216.0f;
+      return std::sqrt(-2.0f * std::log(u1)) * std::cos(2.0f * pi * u2);
+    }
+
+  private:
+    static constexpr float pi = 3.14159265f;
+
+    uint32_t NextInt() {
+      state = state * 1664525u + 1013904223u;
+      return state;
+    }
+
+    uint32_t state;
+  };
+
+  inline Trace Generate(const Parameters& parameters) {
+    constexpr float pi = 3.14159265f;
+    Noise noise {parameters.seed};
+    Trace trace;
+    float period = static_cast<float>(parameters.samplePeriod) / 1000.0f;
+    float duration = period * static_cast<float>(parameters.length);
+    float pulsePhase = 0.0f;
+    for (size_t n = 0; n < parameters.length; n++) {
+      float t = period * static_cast<float>(n);
+      float heartRate = parameters.startHeartRate + (parameters.endHeartRate - parameters.startHeartRate) * t / duration;
+      pulsePhase += 2.0f * pi * heartRate / 60.0f * period;
+      // More light is absorbed during the systole
+      float pulse = std::sin(pulsePhase) + 0.2f * std::sin(2.0f * pulsePhase - 0.8f) + 0.06f * std::sin(3.0f * pulsePhase - 1.6f);
+      float swingPhase = 2.0f * pi * parameters.swingFrequency * t;
+      float swing = std::sin(swingPhase);
+      float artifact = std::sin(swingPhase - 0.6f) + 0.3f * std::sin(2.0f * swingPhase - 1.0f);
+      float value = parameters.level + parameters.drift * t / duration + parameters.respiration * std::sin(2.0f * pi * 0.25f * t) -
+                    parameters.pulse * pulse + parameters.artifact * artifact + parameters.noise * noise.Next();
+
+      Sample sample;
+      sample.hrs = static_cast<uint16_t>(std::lround(value));
+      sample.als = parameters.als;
+      sample.acceleration = {static_cast<int16_t>(std::lround(8.0f * noise.Next())),
+                             static_cast<int16_t>(std::lround(-310.0f + parameters.swing * swing + 8.0f * noise.Next())),
+                             static_cast<int16_t>(std::lround(-975.0f + 0.4f * parameters.swing * swing + 8.0f * noise.Next()))};
+      sample.heartRate = heartRate;
+      trace.push_back(sample);
+    }
+    return trace;
+  }
+
+  // The recordings of a wrist at rest and during exercise, at 10Hz
+  inline std::vector<Parameters> Recordings() {
+    std::vector<Parameters> recordings;
+    recordings.push_back({.name = "rest", .startHeartRate = 62.0f, .endHeartRate = 64.0f});
+    recordings.push_back({.name = "bradycardia", .startHeartRate = 48.0f, .endHeartRate = 47.0f, .seed = 2});
+    recordings.push_back({.name = "recovery", .startHeartRate = 150.0f, .endHeartRate = 105.0f, .pulse = 18.0f, .seed = 3});
+    recordings.push_back({.name = "exercise", .startHeartRate = 110.0f, .endHeartRate = 160.0f, .pulse = 18.0f, .seed = 4});
+    recordings.push_back({.name = "fast", .startHeartRate = 185.0f, .endHeartRate = 190.0f, .pulse = 14.0f, .seed = 5});
+    recordings.push_back({.name = "weak", .startHeartRate = 75.0f, .endHeartRate = 75.0f, .pulse = 8.0f, .noise = 1.5f, .seed = 6});
+    recordings.push_back({.name = "drift", .startHeartRate = 80.0f, .endHeartRate = 82.0f, .drift = -600.0f, .seed = 7});
+    recordings.push_back({.name = "bright", .startHeartRate = 68.0f, .endHeartRate = 70.0f, .pulse = 40.0f, .noise = 3.0f,
+                          .level = 52000.0f, .drift = 150.0f, .seed = 8});
+    return recordings;
+  }
+
+  // The same arm swinging while walking and running : the artifact is stronger than the pulse
+  inline std::vector<Parameters> MotionRecordings() {
+    std::vector<Parameters> recordings;
+    recordings.push_back({.name = "walking", .startHeartRate = 100.0f, .endHeartRate = 108.0f, .pulse = 20.0f,
+                          .swingFrequency = 0.9f, .swing = 250.0f, .artifact = 40.0f, .seed = 11});
+    recordings.push_back({.name = "running", .startHeartRate = 150.0f, .endHeartRate = 158.0f, .pulse = 16.0f,
+                          .swingFrequency = 1.35f, .swing = 500.0f, .artifact = 50.0f, .seed = 12});
+    recordings.push_back({.name = "cycling", .startHeartRate = 125.0f, .endHeartRate = 125.0f, .pulse = 20.0f,
+                          .swingFrequency = 1.5f, .swing = 120.0f, .artifact = 30.0f, .seed = 13});
+    return recordings;
+  }
+}
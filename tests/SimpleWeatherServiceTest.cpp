@@ -0,0 +1,458 @@
+#include "components/ble/SimpleWeatherService.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "systemtask/SystemTask.h"
+#include "Check.h"
+#include "MbufChain.h"
+
+using namespace Pinetime::Controllers;
+using namespace std::chrono_literals;
+using Icons = SimpleWeatherService::Icons;
+
+// The service is registered in the GATT server by Init()
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def* /*defs*/) {
+  return 0;
+}
+
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def* /*svcs*/) {
+  return 0;
+}
+
+namespace {
+  constexpr const char* fileName = "/.system/weather.dat";
+  constexpr uint64_t timestamp = 1700000000; // 2023-11-14 22:13:20 UTC
+
+  // Encodes the messages described in doc/SimpleWeatherService.md
+  class Message {
+  public:
+    Message(uint8_t type, uint8_t version) : data {type, version} {
+    }
+
+    Message& U8(uint8_t value) {
+      data.push_back(value);
+      return *this;
+    }
+
+    Message& I16(int16_t value) {
+      data.push_back(static_cast<uint8_t>(value));
+      data.push_back(static_cast<uint8_t>(static_cast<uint16_t>(value) >> 8));
+      return *this;
+    }
+
+    Message& U64(uint64_t value) {
+      for (int i = 0; i < 8; i++) {
+        data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+      }
+      return *this;
+    }
+
+    Message& String(const std::string& text, size_t size) {
+      for (size_t i = 0; i < size; i++) {
+        data.push_back(i < text.size() ? static_cast<uint8_t>(text[i]) : 0);
+      }
+      return *this;
+    }
+
+    std::vector<uint8_t> data;
+  };
+
+  Message CurrentWeather(uint64_t time, int16_t temperature, const std::string& location, uint8_t version = 1) {
+    Message message(0, version);
+    message.U64(time).I16(temperature).I16(temperature - 500).I16(temperature + 500).String(location, 32).U8(2);
+    if (version == 1) {
+      message.I16(420).I16(1080);
+    }
+    return message;
+  }
+
+  Message Forecast(uint64_t time, uint8_t nbDays) {
+    Message message(1, 0);
+    message.U64(time).U8(nbDays);
+    for (uint8_t i = 0; i < nbDays; i++) {
+      message.I16(static_cast<int16_t>(-100 * i)).I16(static_cast<int16_t>(1000 + 100 * i)).U8(i);
+    }
+    return message;
+  }
+
+  // Temperature of the first hour, then the differences in 0.1°C
+  Message HourlyForecast(uint64_t time, int16_t first, const std::vector<int8_t>& deltas) {
+    Message message(2, 0);
+    message.U64(time).U8(static_cast<uint8_t>(deltas.size() + 1)).I16(first).U8(0);
+    for (size_t i = 0; i < deltas.size(); i++) {
+      message.U8(static_cast<uint8_t>(deltas[i])).U8(static_cast<uint8_t>(1 + i % 8));
+    }
+    return message;
+  }
+
+  class Service {
+  public:
+    Service() {
+      time.currentDateTime = std::chrono::system_clock::time_point {std::chrono::seconds {timestamp + 60}};
+    }
+
+    void Send(const std::vector<uint8_t>& data, const std::vector<size_t>& split = {}) {
+      auto chain = Test::MbufChain::Split(data, split);
+      ble_gatt_access_ctxt ctxt {};
+      ctxt.op = BLE_GATT_ACCESS_OP_WRITE_CHR;
+      ctxt.om = chain.Head();
+      CHECK_EQUAL(service.OnCommand(&ctxt), 0);
+    }
+
+    void Send(const Message& message) {
+      Send(message.data);
+    }
+
+    void SetTime(std::chrono::seconds time) {
+      this->time.currentDateTime = std::chrono::system_clock::time_point {time};
+    }
+
+    Pinetime::System::SystemTask systemTask;
+    DateTime time;
+    FS fs;
+    SimpleWeatherService service {systemTask, time, fs};
+  };
+
+  void TestCurrentWeather() {
+    Service weather;
+    weather.service.Init();
+    CHECK(!weather.service.Current());
+    uint32_t counter = weather.service.ChangeCounter();
+
+    weather.Send(CurrentWeather(timestamp, 1234, "Brussels").data, {5, 20});
+    auto current = weather.service.Current();
+    CHECK(current.has_value());
+    CHECK_EQUAL(current->timestamp, timestamp);
+    CHECK_EQUAL(current->temperature.PreciseCelsius(), 1234);
+    CHECK_EQUAL(current->temperature.Celsius(), 12);
+    CHECK_EQUAL(current->minTemperature.PreciseCelsius(), 734);
+    CHECK(std::strcmp(current->location.data(), "Brussels") == 0);
+    CHECK(current->iconId == Icons::Clouds);
+    CHECK_EQUAL(current->sunrise, 420);
+    CHECK_EQUAL(current->sunset, 1080);
+    CHECK_EQUAL(weather.service.ChangeCounter(), counter + 1);
+    CHECK_EQUAL(weather.systemTask.messages.size(), 1);
+
+    // The same data again : no change
+    weather.Send(CurrentWeather(timestamp, 1234, "Brussels"));
+    CHECK_EQUAL(weather.service.ChangeCounter(), counter + 1);
+    CHECK_EQUAL(weather.systemTask.messages.size(), 1);
+
+    // Version 0 : without sunrise and sunset. The location is truncated to 32 characters.
+    weather.Send(CurrentWeather(timestamp, -250, std::string(40, 'a'), 0));
+    current = weather.service.Current();
+    CHECK_EQUAL(current->temperature.PreciseCelsius(), -250);
+    CHECK_EQUAL(std::strlen(current->location.data()), 32);
+    CHECK_EQUAL(current->sunrise, -1);
+
+    // Inconsistent sunrise and sunset : ignored, the rest is kept
+    Message sunsetBeforeSunrise(0, 1);
+    sunsetBeforeSunrise.U64(timestamp).I16(100).I16(0).I16(200).String("Liege", 32).U8(0).I16(1000).I16(500);
+    weather.Send(sunsetBeforeSunrise);
+    current = weather.service.Current();
+    CHECK(std::strcmp(current->location.data(), "Liege") == 0);
+    CHECK_EQUAL(current->sunrise, -1);
+    CHECK_EQUAL(current->sunset, -1);
+
+    // Expired after 24h
+    counter = weather.service.ChangeCounter();
+    weather.SetTime(std::chrono::seconds {timestamp} + 24h);
+    CHECK_EQUAL(weather.service.ChangeCounter(), counter + 1);
+    CHECK(!weather.service.Current());
+  }
+
+  void TestForecast() {
+    Service weather;
+    weather.Send(Forecast(timestamp, 7));
+    auto forecast = weather.service.GetForecast();
+    CHECK(forecast.has_value());
+    // Up to 5 days
+    CHECK_EQUAL(forecast->nbDays, 5);
+    CHECK_EQUAL(forecast->days[4]->maxTemperature.PreciseCelsius(), 1400);
+
+    // The days that are over are dropped, at midnight UTC
+    uint32_t counter = weather.service.ChangeCounter();
+    weather.SetTime(std::chrono::floor<std::chrono::days>(std::chrono::seconds {timestamp}) + std::chrono::days {2} + 1h);
+    CHECK_EQUAL(weather.service.ChangeCounter(), counter + 1);
+    forecast = weather.service.GetForecast();
+    CHECK_EQUAL(forecast->nbDays, 3);
+    CHECK_EQUAL(forecast->days[0]->minTemperature.PreciseCelsius(), -200);
+    CHECK(!forecast->days[3].has_value());
+    CHECK_EQUAL(weather.service.ChangeCounter(), counter + 1);
+
+    weather.SetTime(std::chrono::seconds {timestamp} + std::chrono::days {5});
+    weather.service.ChangeCounter();
+    CHECK(!weather.service.GetForecast());
+  }
+
+  void TestHourlyForecast() {
+    Service weather;
+    // Deltas of temperature in 0.1°C
+    weather.Send(HourlyForecast(timestamp, 1500, {5, -12, 0, 127, -128}));
+    auto hourly = weather.service.GetHourlyForecast();
+    CHECK(hourly.has_value());
+    CHECK_EQUAL(hourly->timestamp, timestamp);
+    CHECK_EQUAL(hourly->nbHours, 6);
+    std::vector<int16_t> expected {1500, 1550, 1430, 1430, 2700, 1420};
+    for (uint8_t i = 0; i < hourly->nbHours; i++) {
+      CHECK_EQUAL(hourly->TemperatureAt(i).PreciseCelsius(), expected[i]);
+    }
+    CHECK(hourly->IconAt(0) == Icons::Sun);
+    CHECK(hourly->IconAt(1) == Icons::CloudsSun);
+
+    // The temperature saturates instead of wrapping around
+    weather.Send(HourlyForecast(timestamp, 32000, {127, 127, -128}));
+    hourly = weather.service.GetHourlyForecast();
+    CHECK_EQUAL(hourly->TemperatureAt(1).PreciseCelsius(), 32767);
+    CHECK_EQUAL(hourly->TemperatureAt(3).PreciseCelsius(), 32767 - 1280);
+
+    // At most 48 hours
+    weather.Send(HourlyForecast(timestamp, 0, std::vector<int8_t>(59, 1)));
+    hourly = weather.service.GetHourlyForecast();
+    CHECK_EQUAL(hourly->nbHours, SimpleWeatherService::MaxNbForecastHours);
+    CHECK_EQUAL(hourly->TemperatureAt(47).PreciseCelsius(), 470);
+
+    // Incomplete message, no hour : the previous forecast is kept
+    auto incomplete = HourlyForecast(timestamp + 3600, 100, {1, 2, 3});
+    incomplete.data.pop_back();
+    weather.Send(incomplete);
+    weather.Send(Message(2, 0).U64(timestamp).U8(0));
+    CHECK_EQUAL(weather.service.GetHourlyForecast()->nbHours, SimpleWeatherService::MaxNbForecastHours);
+    CHECK_EQUAL(weather.service.GetHourlyForecast()->timestamp, timestamp);
+    // Unknown version
+    weather.Send(Message(2, 1).U64(timestamp).U8(1).I16(0).U8(0));
+    CHECK_EQUAL(weather.service.GetHourlyForecast()->nbHours, SimpleWeatherService::MaxNbForecastHours);
+  }
+
+  void TestHourlyExpiry() {
+    Service weather;
+    std::vector<int8_t> deltas(47);
+    for (size_t i = 0; i < deltas.size(); i++) {
+      deltas[i] = static_cast<int8_t>(i % 2 == 0 ? 10 : -5);
+    }
+    weather.Send(HourlyForecast(timestamp, 0, deltas));
+    auto full = *weather.service.GetHourlyForecast();
+
+    // The hours that are over are dropped at the start of each hour, without moving the others
+    uint32_t counter = weather.service.ChangeCounter();
+    auto firstHour = std::chrono::floor<std::chrono::hours>(std::chrono::seconds {timestamp});
+    weather.SetTime(firstHour + 3h + 10min);
+    CHECK_EQUAL(weather.service.ChangeCounter(), counter + 1);
+    auto hourly = *weather.service.GetHourlyForecast();
+    CHECK_EQUAL(hourly.nbHours, 45);
+    CHECK_EQUAL(hourly.first, 3);
+    CHECK_EQUAL(hourly.timestamp, timestamp + 3 * 3600);
+    bool same = true;
+    for (uint8_t i = 0; i < hourly.nbHours; i++) {
+      same = same && hourly.TemperatureAt(i) == full.TemperatureAt(i + 3) && hourly.IconAt(i) == full.IconAt(i + 3);
+    }
+    CHECK(same);
+    CHECK_EQUAL(weather.service.ChangeCounter(), counter + 1);
+
+    // Expired with its last hour
+    weather.SetTime(firstHour + 48h);
+    weather.service.ChangeCounter();
+    CHECK(!weather.service.GetHourlyForecast());
+  }
+
+  // The ring wraps around : the first hour is not at the start of the array
+  void TestRingWrap() {
+    SimpleWeatherService::HourlyForecast hourly;
+    for (uint8_t i = 0; i < SimpleWeatherService::MaxNbForecastHours; i++) {
+      hourly.hours[i] = {static_cast<int16_t>(i), Icons::Sun};
+    }
+    hourly.nbHours = SimpleWeatherService::MaxNbForecastHours;
+    hourly.first = 40;
+    hourly.timestamp = timestamp;
+    CHECK_EQUAL(hourly.TemperatureAt(0).PreciseCelsius(), 40);
+    CHECK_EQUAL(hourly.TemperatureAt(7).PreciseCelsius(), 47);
+    CHECK_EQUAL(hourly.TemperatureAt(8).PreciseCelsius(), 0);
+    CHECK_EQUAL(hourly.TemperatureAt(47).PreciseCelsius(), 39);
+
+    hourly.DropHours(10);
+    CHECK_EQUAL(hourly.first, 2);
+    CHECK_EQUAL(hourly.nbHours, 38);
+    CHECK_EQUAL(hourly.timestamp, timestamp + 36000);
+    CHECK_EQUAL(hourly.TemperatureAt(0).PreciseCelsius(), 2);
+    CHECK_EQUAL(hourly.TemperatureAt(37).PreciseCelsius(), 39);
+  }
+
+  void TestPersistence() {
+    Service weather;
+    weather.Send(CurrentWeather(timestamp, 2150, "Namur"));
+    weather.Send(Forecast(timestamp, 3));
+    weather.Send(HourlyForecast(timestamp, -300, {10, 20, -30, 40, -50, 60}));
+    // The hourly ring is saved as it is, with the hours that are over dropped
+    weather.SetTime(std::chrono::seconds {timestamp} + 2h);
+    weather.service.ChangeCounter();
+    weather.service.SaveToFile();
+    CHECK(weather.fs.files.count(fileName) == 1);
+
+    Service restored;
+    restored.fs.files = weather.fs.files;
+    restored.fs.directories = weather.fs.directories;
+    restored.service.Init();
+    CHECK(restored.service.Current() == weather.service.Current());
+    CHECK(restored.service.GetForecast() == weather.service.GetForecast());
+    auto hourly = restored.service.GetHourlyForecast();
+    auto expected = weather.service.GetHourlyForecast();
+    CHECK(hourly.has_value());
+    CHECK_EQUAL(hourly->nbHours, expected->nbHours);
+    CHECK_EQUAL(hourly->timestamp, expected->timestamp);
+    bool same = true;
+    for (uint8_t i = 0; i < hourly->nbHours; i++) {
+      same = same && hourly->TemperatureAt(i) == expected->TemperatureAt(i) && hourly->IconAt(i) == expected->IconAt(i);
+    }
+    CHECK(same);
+
+    // Only the data that was received is saved
+    Service partial;
+    partial.Send(Forecast(timestamp, 2));
+    partial.service.SaveToFile();
+    Service partialRestored;
+    partialRestored.fs.files = partial.fs.files;
+    partialRestored.service.Init();
+    CHECK(!partialRestored.service.Current());
+    CHECK(partialRestored.service.GetForecast() == partial.service.GetForecast());
+    CHECK(!partialRestored.service.GetHourlyForecast());
+  }
+
+  void CheckNothingRestored(const std::vector<uint8_t>& file) {
+    Service restored;
+    restored.fs.files[fileName] = file;
+    restored.service.Init();
+    CHECK(!restored.service.Current());
+    CHECK(!restored.service.GetForecast());
+    CHECK(!restored.service.GetHourlyForecast());
+  }
+
+  void TestInvalidFile() {
+    Service weather;
+    weather.Send(CurrentWeather(timestamp, 2150, "Namur"));
+    weather.Send(HourlyForecast(timestamp, -300, {10, 20}));
+    weather.service.SaveToFile();
+    const auto file = weather.fs.files[fileName];
+
+    // No file, another version of the format, truncated file
+    CheckNothingRestored({});
+    Service noFile;
+    noFile.service.Init();
+    CHECK(!noFile.service.Current());
+    auto otherVersion = file;
+    otherVersion[0] = 1;
+    CheckNothingRestored(otherVersion);
+    for (size_t size : {size_t {1}, file.size() / 2, file.size() - 1}) {
+      CheckNothingRestored({file.begin(), file.begin() + size});
+    }
+
+    // Hourly forecast with an invalid size : only this part is dropped
+    Service weatherWithHours;
+    weatherWithHours.Send(CurrentWeather(timestamp, 2150, "Namur"));
+    weatherWithHours.Send(HourlyForecast(timestamp, -300, {10, 20}));
+    weatherWithHours.service.SaveToFile();
+    auto& saved = weatherWithHours.fs.files[fileName];
+    // nbHours follows the timestamp of the hourly forecast, which is the last 8-byte aligned field before the ring
+    auto hourly = *weatherWithHours.service.GetHourlyForecast();
+    bool patched = false;
+    for (size_t offset = 0; offset + 9 < saved.size() && !patched; offset++) {
+      uint64_t value;
+      std::memcpy(&value, &saved[offset], sizeof(value));
+      if (value == hourly.timestamp && saved[offset + 8] == hourly.nbHours && offset % 8 == 0 && offset > 48) {
+        saved[offset + 8] = SimpleWeatherService::MaxNbForecastHours + 1;
+        patched = true;
+      }
+    }
+    CHECK(patched);
+    Service restored;
+    restored.fs.files = weatherWithHours.fs.files;
+    restored.service.Init();
+    CHECK(restored.service.Current().has_value());
+    CHECK(!restored.service.GetHourlyForecast());
+  }
+
+  // Truncated and corrupted messages are rejected without changing the data, random messages do not break the invariants
+  void TestFuzz() {
+    const std::vector<Message> valid {CurrentWeather(timestamp, 1000, "Antwerp", 0),
+                                      CurrentWeather(timestamp, 1000, "Antwerp", 1),
+                                      Forecast(timestamp, 5),
+                                      HourlyForecast(timestamp, 1000, std::vector<int8_t>(47, -3))};
+
+    // Every truncation of a valid message
+    bool unchanged = true;
+    for (const auto& message : valid) {
+      for (size_t size = 0; size < message.data.size(); size++) {
+        Service weather;
+        auto counter = weather.service.ChangeCounter();
+        weather.Send({message.data.begin(), message.data.begin() + size});
+        unchanged = unchanged && weather.service.ChangeCounter() == counter && weather.systemTask.messages.empty();
+        unchanged = unchanged && !weather.service.Current() && !weather.service.GetForecast() && !weather.service.GetHourlyForecast();
+      }
+    }
+    CHECK(unchanged);
+
+    // Random mutations of the valid messages, and random bytes
+    uint32_t state = 11;
+    auto random = [&state](uint32_t range) {
+      state = state * 1664525 + 1013904223;
+      return (state >> 8) % range;
+    };
+    Service weather;
+    bool consistent = true;
+    for (int i = 0; i < 20000; i++) {
+      std::vector<uint8_t> data;
+      if (random(8) == 0) {
+        data.resize(random(300));
+        for (auto& byte : data) {
+          byte = static_cast<uint8_t>(random(256));
+        }
+      } else {
+        data = valid[random(valid.size())].data;
+        for (uint32_t flips = random(4); flips > 0; flips--) {
+          data[random(data.size())] = static_cast<uint8_t>(random(256));
+        }
+        if (random(2) == 0) {
+          data.resize(random(data.size() + 20), static_cast<uint8_t>(random(256)));
+        }
+      }
+      // Split in random segments
+      std::vector<size_t> split;
+      size_t remaining = data.size();
+      while (remaining > 0 && random(3) != 0) {
+        split.push_back(random(remaining + 1));
+        remaining -= split.back();
+      }
+      weather.Send(data, split);
+
+      auto current = weather.service.Current();
+      if (current) {
+        consistent = consistent && std::memchr(current->location.data(), '\0', current->location.size()) != nullptr;
+      }
+      auto forecast = weather.service.GetForecast();
+      if (forecast) {
+        consistent = consistent && forecast->nbDays <= SimpleWeatherService::MaxNbForecastDays;
+      }
+      auto hourly = weather.service.GetHourlyForecast();
+      if (hourly) {
+        consistent = consistent && hourly->nbHours > 0 && hourly->nbHours <= SimpleWeatherService::MaxNbForecastHours &&
+                     hourly->first == 0;
+      }
+    }
+    CHECK(consistent);
+    // Some of the mutated messages are valid
+    CHECK(weather.systemTask.messages.size() > 100);
+  }
+}
+
+int main() {
+  TestCurrentWeather();
+  TestForecast();
+  TestHourlyForecast();
+  TestHourlyExpiry();
+  TestRingWrap();
+  TestPersistence();
+  TestInvalidFile();
+  TestFuzz();
+  return Test::Result();
+}
@@ -0,0 +1,275 @@
+#include "components/ble/TelemetryService.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_hs.h>
+#include <nimble/nimble_port.h>
+#undef max
+#undef min
+#include "components/ble/NimbleController.h"
+#include "systemtask/SystemMonitor.h"
+#include "Check.h"
+
+using namespace Pinetime::Controllers;
+using Pinetime::System::SystemMonitor;
+
+int mallocFailedCount = 0;
+int stackOverflowCount = 0;
+
+namespace {
+  ble_npl_eventq eventQueue {};
+  os_mbuf mbuf {};
+  std::vector<uint16_t> valueHandles;
+  // Bytes appended to the mbuf of a read, or sent in a notification
+  std::vector<uint8_t> readValue;
+  std::vector<uint8_t> flat;
+  std::vector<std::vector<uint8_t>> notifications;
+}
+
+extern "C" {
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def* /*defs*/) {
+  return 0;
+}
+
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def* svcs) {
+  valueHandles.clear();
+  for (auto* characteristic = svcs[0].characteristics; characteristic->uuid != nullptr; characteristic++) {
+    *characteristic->val_handle = static_cast<uint16_t>(0x20 + 2 * valueHandles.size());
+    valueHandles.push_back(*characteristic->val_handle);
+  }
+  return 0;
+}
+
+void ble_npl_callout_init(struct ble_npl_callout* co, struct ble_npl_eventq* evq, ble_npl_event_fn* ev_cb, void* ev_arg) {
+  *co = {};
+  co->c_evq = evq;
+  co->c_ev.ev_cb = ev_cb;
+  co->c_ev.ev_arg = ev_arg;
+}
+
+ble_npl_error_t ble_npl_callout_reset(struct ble_npl_callout* co, ble_npl_time_t /*ticks*/) {
+  co->c_active = true;
+  return BLE_NPL_OK;
+}
+
+void ble_npl_callout_stop(struct ble_npl_callout* co) {
+  co->c_active = false;
+}
+
+void* ble_npl_event_get_arg(struct ble_npl_event* ev) {
+  return ev->ev_arg;
+}
+
+ble_npl_time_t ble_npl_time_ms_to_ticks32(uint32_t ms) {
+  return ms;
+}
+
+struct ble_npl_eventq* nimble_port_get_dflt_eventq() {
+  return &eventQueue;
+}
+
+int os_mbuf_append(struct os_mbuf* om, const void* data, uint16_t len) {
+  CHECK(om == &mbuf);
+  auto bytes = static_cast<const uint8_t*>(data);
+  readValue.insert(readValue.end(), bytes, bytes + len);
+  return 0;
+}
+
+// The notification period is not written by the tests
+int os_mbuf_copydata(const struct os_mbuf* /*m*/, int /*off*/, int /*len*/, void* /*dst*/) {
+  CHECK(false);
+  return -1;
+}
+
+struct os_mbuf* ble_hs_mbuf_from_flat(const void* buf, uint16_t len) {
+  auto bytes = static_cast<const uint8_t*>(buf);
+  flat.assign(bytes, bytes + len);
+  return &mbuf;
+}
+
+int ble_gattc_notify_custom(uint16_t /*conn_handle*/, uint16_t att_handle, struct os_mbuf* om) {
+  CHECK(om == &mbuf);
+  CHECK_EQUAL(att_handle, valueHandles[0]);
+  notifications.push_back(flat);
+  return 0;
+}
+}
+
+namespace {
+  // The tasks of the firmware, with the logger of the debug builds
+  const std::vector<TaskStatus_t> firmwareTasks {
+    {"IDLE", 102},
+    {"Tmr Svc", 58},
+    {"MAIN", 87},
+    {"displayapp", 212},
+    {"Heartrate", 161},
+    {"ble", 47},
+    {"LOGGER", 9},
+  };
+
+  struct Snapshot {
+    std::string name;
+    std::vector<uint8_t> bytes;
+  };
+
+  std::vector<uint8_t> Read(TelemetryService& service) {
+    readValue.clear();
+    ble_gatt_access_ctxt context {};
+    context.op = BLE_GATT_ACCESS_OP_READ_CHR;
+    context.om = &mbuf;
+    CHECK_EQUAL(service.OnTelemetryRequested(valueHandles[0], &context), 0);
+    return readValue;
+  }
+
+  uint16_t Get16(const std::vector<uint8_t>& bytes, size_t offset) {
+    return static_cast<uint16_t>(bytes[offset] | (bytes[offset + 1] << 8));
+  }
+
+  uint32_t Get32(const std::vector<uint8_t>& bytes, size_t offset) {
+    return Get16(bytes, offset) | (static_cast<uint32_t>(Get16(bytes, offset + 2)) << 16);
+  }
+
+  // Monitor with some activity : frames rendered, LVGL memory sampled and messages waiting
+  struct Firmware {
+    Firmware() {
+      Fakes::tasks = firmwareTasks;
+      Fakes::createdTasks.clear();
+      Fakes::tickCount = 3723 * configTICK_RATE_HZ + 100;
+      Fakes::freeHeapSize = 4312;
+      Fakes::minimumEverFreeHeapSize = 1096;
+      mallocFailedCount = 2;
+      stackOverflowCount = 70000; // saturated
+      monitor.RegisterQueue(SystemMonitor::Queues::System, &systemQueue);
+      monitor.RegisterQueue(SystemMonitor::Queues::Display, &displayQueue);
+      for (uint16_t duration : {31, 28, 45, 12, 33, 29, 30, 27, 26}) {
+        monitor.OnFrameRendered(duration);
+      }
+      monitor.SetLvglMemory({14336, 5120, 10240, 23});
+      service.Init();
+    }
+
+    QueueDefinition systemQueue {false, 3};
+    QueueDefinition displayQueue {false, 1};
+    SystemMonitor monitor;
+    NimbleController nimble;
+    TelemetryService service {nimble, monitor};
+  };
+
+  void TestHeader() {
+    Firmware firmware;
+    auto bytes = Read(firmware.service);
+    CHECK_EQUAL(bytes.size(), TelemetryService::headerSize + 7 * (TelemetryService::taskNameSize + 2));
+    if (bytes.size() < TelemetryService::headerSize) {
+      return;
+    }
+    CHECK_EQUAL(bytes[0], 2);
+    CHECK_EQUAL(Get32(bytes, 1), 3723);
+    CHECK_EQUAL(Get32(bytes, 5), 4312);
+    CHECK_EQUAL(Get32(bytes, 9), 1096);
+    CHECK_EQUAL(Get16(bytes, 13), 2);
+    CHECK_EQUAL(Get16(bytes, 15), UINT16_MAX);
+    CHECK_EQUAL(Get32(bytes, 17), 14336);
+    CHECK_EQUAL(Get32(bytes, 21), 5120);
+    CHECK_EQUAL(Get32(bytes, 25), 10240);
+    CHECK_EQUAL(bytes[29], 23);
+    CHECK_EQUAL(bytes[30], 3);
+    CHECK_EQUAL(bytes[31], 1);
+    CHECK_EQUAL(Get32(bytes, 32), 9);
+    // Most recent first, the oldest frame is dropped
+    CHECK_EQUAL(Get16(bytes, 36), 26);
+    CHECK_EQUAL(Get16(bytes, 50), 28);
+    CHECK_EQUAL(bytes[52], 7);
+    // The names are truncated to 4 bytes, or padded with zeros
+    CHECK(std::memcmp(&bytes[53], "IDLE", 4) == 0);
+    CHECK(std::memcmp(&bytes[59], "Tmr ", 4) == 0);
+    CHECK(std::memcmp(&bytes[83], "ble\0", 4) == 0);
+    CHECK_EQUAL(Get16(bytes, 57), 102);
+    CHECK_EQUAL(Get16(bytes, 93), 9);
+
+    // The notifications send the same snapshot
+    notifications.clear();
+    firmware.nimble.connectionHandle = 1;
+    firmware.service.SubscribeNotification(valueHandles[0]);
+    firmware.service.OnNotificationTimer();
+    CHECK_EQUAL(notifications.size(), 1);
+    CHECK(!notifications.empty() && notifications[0] == bytes);
+  }
+
+  std::vector<TaskStatus_t> Tasks(size_t count) {
+    std::vector<TaskStatus_t> tasks;
+    for (size_t i = 0; i < count; i++) {
+      tasks.push_back({"Task", static_cast<uint16_t>(100 + i)});
+    }
+    return tasks;
+  }
+
+  // More tasks than the snapshot can hold : uxTaskGetSystemState() would not list any of them
+  void TestTooManyTasks() {
+    Firmware firmware;
+    Fakes::tasks = Tasks(TelemetryService::maxTasks);
+    auto bytes = Read(firmware.service);
+    CHECK_EQUAL(bytes.size(), TelemetryService::maxSnapshotSize);
+    CHECK_EQUAL(bytes[TelemetryService::headerSize - 1], TelemetryService::maxTasks);
+    CHECK_EQUAL(Get16(bytes, bytes.size() - 2), 100 + TelemetryService::maxTasks - 1);
+
+    Fakes::tasks = Tasks(TelemetryService::maxTasks + 1);
+    bytes = Read(firmware.service);
+    CHECK_EQUAL(bytes.size(), TelemetryService::headerSize);
+    CHECK_EQUAL(bytes[TelemetryService::headerSize - 1], TelemetryService::incompleteTaskList);
+
+    // A task created while the snapshot is built
+    Fakes::tasks = Tasks(TelemetryService::maxTasks);
+    Fakes::createdTasks = Tasks(1);
+    bytes = Read(firmware.service);
+    CHECK_EQUAL(bytes.size(), TelemetryService::headerSize);
+    CHECK_EQUAL(bytes[TelemetryService::headerSize - 1], TelemetryService::incompleteTaskList);
+  }
+
+  std::vector<Snapshot> Snapshots() {
+    std::vector<Snapshot> snapshots;
+    {
+      Firmware firmware;
+      snapshots.push_back({"firmware", Read(firmware.service)});
+      Fakes::tasks = Tasks(TelemetryService::maxTasks);
+      snapshots.push_back({"full", Read(firmware.service)});
+      Fakes::tasks = Tasks(TelemetryService::maxTasks + 1);
+      snapshots.push_back({"incomplete", Read(firmware.service)});
+    }
+    {
+      // Just after boot : no frame rendered, LVGL memory not sampled yet
+      SystemMonitor monitor;
+      NimbleController nimble;
+      TelemetryService service {nimble, monitor};
+      service.Init();
+      Fakes::tasks = firmwareTasks;
+      Fakes::tickCount = 0;
+      snapshots.push_back({"boot", Read(service)});
+    }
+    return snapshots;
+  }
+
+  // One snapshot per line, for telemetry_decode_test.py : name, then the bytes in hexadecimal
+  void Dump() {
+    for (const auto& snapshot : Snapshots()) {
+      std::fprintf(stdout, "%s ", snapshot.name.c_str());
+      for (uint8_t byte : snapshot.bytes) {
+        std::fprintf(stdout, "%02x", byte);
+      }
+      std::fprintf(stdout, "\n");
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1 && std::strcmp(argv[1], "--dump") == 0) {
+    Dump();
+    return Test::Result();
+  }
+  TestHeader();
+  TestTooManyTasks();
+  return Test::Result();
+}
@@ -0,0 +1,239 @@
+#include "drivers/TwiMaster.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Check.h"
+#include "TwimModel.h"
+
+using namespace Pinetime::Drivers;
+using ErrorCodes = TwiMaster::ErrorCodes;
+
+namespace {
+  constexpr uint8_t deviceAddress = 0x18;
+  constexpr uint8_t otherDeviceAddress = 0x44;
+  constexpr uint8_t absentAddress = 0x15;
+
+  // The peripheral and the 2 devices on the bus, the interrupt handler is called by the model
+  struct Bus {
+    Bus() {
+      twim.devices[deviceAddress] = &device;
+      twim.devices[otherDeviceAddress] = &otherDevice;
+      twim.interruptHandler = [this]() {
+        twiMaster.OnInterrupt();
+      };
+      Fakes::whileBlocked = [this]() {
+        twim.Run();
+      };
+      Fakes::tickCount = 0;
+      twiMaster.Init();
+    }
+
+    ~Bus() {
+      Fakes::whileBlocked = nullptr;
+    }
+
+    // Nothing is left enabled once the queue is drained
+    bool IsIdle() const {
+      return !twim.IsEnabled() && twim.registers.INTEN == 0 && twim.registers.SHORTS == 0;
+    }
+
+    Fakes::Twim twim;
+    Fakes::RegisterFile device;
+    Fakes::RegisterFile otherDevice;
+    TwiMaster twiMaster {&twim.registers, TWIM_FREQUENCY_FREQUENCY_K400, 6, 7};
+  };
+
+  struct Completion {
+    int id;
+    ErrorCodes result;
+  };
+
+  // Records the callbacks of the asynchronous transactions
+  struct Recorder {
+    struct Context {
+      Recorder* recorder;
+      int id;
+    };
+
+    static void Callback(ErrorCodes result, void* context, BaseType_t* /*higherPriorityTaskWoken*/) {
+      auto* c = static_cast<Context*>(context);
+      c->recorder->completions.push_back({c->id, result});
+    }
+
+    Context* NewContext() {
+      contexts[nbContexts] = {this, static_cast<int>(nbContexts)};
+      return &contexts[nbContexts++];
+    }
+
+    TwiMaster::Callback callback = Callback;
+    std::vector<Completion> completions;
+    std::array<Context, 16> contexts;
+    size_t nbContexts = 0;
+  };
+
+  void TestReadWrite() {
+    Bus bus;
+    CHECK(bus.IsIdle());
+
+    const std::array<uint8_t, 3> data {0x17, 0x00, 0xa9};
+    CHECK(bus.twiMaster.Write(deviceAddress, 0x40, data.data(), data.size()) == ErrorCodes::NoError);
+    CHECK_EQUAL(bus.device.registers[0x40], 0x17);
+    CHECK_EQUAL(bus.device.registers[0x42], 0xa9);
+
+    std::array<uint8_t, 4> read {};
+    CHECK(bus.twiMaster.Read(deviceAddress, 0x3f, read.data(), read.size()) == ErrorCodes::NoError);
+    CHECK(read == (std::array<uint8_t, 4> {0x00, 0x17, 0x00, 0xa9}));
+    CHECK(bus.IsIdle());
+
+    // One interrupt per transaction : the shortcuts chain the register address, the data and the STOP condition
+    CHECK_EQUAL(bus.twim.nbInterrupts, 2);
+    CHECK_EQUAL(bus.twim.transfers.size(), 2);
+    CHECK_EQUAL(bus.twim.transfers[0].address, deviceAddress);
+    CHECK(!bus.twim.transfers[0].read);
+    CHECK(bus.twim.transfers[1].read);
+
+    // The longest transfers of EasyDMA
+    std::vector<uint8_t> config(TwiMaster::maxWriteSize);
+    for (size_t i = 0; i < config.size(); i++) {
+      config[i] = static_cast<uint8_t>(i * 7);
+    }
+    CHECK(bus.twiMaster.Write(otherDeviceAddress, 1, config.data(), config.size()) == ErrorCodes::NoError);
+    std::vector<uint8_t> readBack(TwiMaster::maxReadSize);
+    CHECK(bus.twiMaster.Read(otherDeviceAddress, 1, readBack.data(), readBack.size()) == ErrorCodes::NoError);
+    CHECK(std::equal(config.begin(), config.end(), readBack.begin()));
+    // The address wraps around after the last register
+    CHECK_EQUAL(readBack.back(), bus.otherDevice.registers[0]);
+    CHECK(bus.IsIdle());
+  }
+
+  // The asynchronous transactions are queued, executed in order, and their callbacks are called by the interrupt handler
+  void TestAsynchronous() {
+    Bus bus;
+    Recorder recorder;
+    std::array<std::array<uint8_t, 2>, 4> buffers {};
+    bus.device.registers[0x10] = 1;
+    bus.device.registers[0x20] = 2;
+    bus.otherDevice.registers[0x30] = 3;
+    const uint8_t value = 0x55;
+
+    CHECK(bus.twiMaster.ReadAsync(deviceAddress, 0x10, buffers[0].data(), 2, recorder.callback, recorder.NewContext()));
+    CHECK(bus.twim.IsEnabled());
+    CHECK(bus.twiMaster.ReadAsync(deviceAddress, 0x20, buffers[1].data(), 2, recorder.callback, recorder.NewContext()));
+    CHECK(bus.twiMaster.WriteAsync(otherDeviceAddress, 0x31, &value, 1, recorder.callback, recorder.NewContext()));
+    CHECK(bus.twiMaster.ReadAsync(otherDeviceAddress, 0x30, buffers[3].data(), 2, recorder.callback, recorder.NewContext()));
+    // The queue is full
+    CHECK(!bus.twiMaster.ReadAsync(deviceAddress, 0x10, buffers[2].data(), 2, recorder.callback, recorder.NewContext()));
+    CHECK(recorder.completions.empty());
+
+    bus.twim.Run();
+    CHECK_EQUAL(recorder.completions.size(), 4);
+    bool inOrder = true;
+    for (size_t i = 0; i < recorder.completions.size(); i++) {
+      inOrder = inOrder && recorder.completions[i].id == static_cast<int>(i) && recorder.completions[i].result == ErrorCodes::NoError;
+    }
+    CHECK(inOrder);
+    CHECK_EQUAL(buffers[0][0], 1);
+    CHECK_EQUAL(buffers[1][0], 2);
+    // The write was done before the last read
+    CHECK(buffers[3] == (std::array<uint8_t, 2> {3, 0x55}));
+    CHECK(bus.IsIdle());
+  }
+
+  // A synchronous transaction waits for the asynchronous ones queued before it, and for room in the queue
+  void TestSynchronousAfterAsynchronous() {
+    Bus bus;
+    Recorder recorder;
+    std::array<uint8_t, 1> buffer {};
+    for (int i = 0; i < 4; i++) {
+      CHECK(bus.twiMaster.ReadAsync(deviceAddress, 0, buffer.data(), 1, recorder.callback, recorder.NewContext()));
+    }
+
+    const uint8_t value = 9;
+    CHECK(bus.twiMaster.Write(deviceAddress, 0x7e, &value, 1) == ErrorCodes::NoError);
+    CHECK_EQUAL(recorder.completions.size(), 4);
+    CHECK_EQUAL(bus.twim.transfers.size(), 5);
+    CHECK(!bus.twim.transfers.empty() && !bus.twim.transfers.back().read);
+    CHECK(bus.IsIdle());
+  }
+
+  // A NACK fails the transaction, the STOP condition is sent and the next transactions are not affected
+  void TestErrors() {
+    Bus bus;
+    std::array<uint8_t, 2> buffer {};
+    CHECK(bus.twiMaster.Read(absentAddress, 0, buffer.data(), buffer.size()) == ErrorCodes::TransactionFailed);
+    CHECK_EQUAL(static_cast<uint32_t>(bus.twim.registers.ERRORSRC), 0);
+    CHECK(bus.IsIdle());
+    CHECK(bus.twiMaster.Read(deviceAddress, 0, buffer.data(), buffer.size()) == ErrorCodes::NoError);
+
+    bus.twim.nackData = true;
+    CHECK(bus.twiMaster.Write(deviceAddress, 0, buffer.data(), buffer.size()) == ErrorCodes::TransactionFailed);
+    bus.twim.nackData = false;
+    CHECK(bus.twiMaster.Write(deviceAddress, 0, buffer.data(), buffer.size()) == ErrorCodes::NoError);
+    CHECK(bus.IsIdle());
+
+    // An asynchronous transaction to an absent device does not fail the next ones
+    Recorder recorder;
+    CHECK(bus.twiMaster.ReadAsync(absentAddress, 0, buffer.data(), 1, recorder.callback, recorder.NewContext()));
+    CHECK(bus.twiMaster.ReadAsync(deviceAddress, 0, buffer.data(), 1, recorder.callback, recorder.NewContext()));
+    bus.twim.Run();
+    CHECK_EQUAL(recorder.completions.size(), 2);
+    if (recorder.completions.size() == 2) {
+      CHECK(recorder.completions[0].result == ErrorCodes::TransactionFailed);
+      CHECK(recorder.completions[1].result == ErrorCodes::NoError);
+    }
+    CHECK(bus.IsIdle());
+  }
+
+  // A frozen peripheral is reset after HwFreezedDelay : the transaction in progress fails, the next ones are executed
+  void TestFreeze() {
+    Bus bus;
+    std::array<uint8_t, 2> buffer {};
+    bus.twim.nbFreezes = 1;
+    CHECK(bus.twiMaster.Read(deviceAddress, 0, buffer.data(), buffer.size()) == ErrorCodes::TransactionFailed);
+    // Recovered after 20ms, checked every 20ms
+    CHECK(Fakes::tickCount > pdMS_TO_TICKS(20));
+    CHECK(Fakes::tickCount <= 2 * pdMS_TO_TICKS(20));
+    CHECK(bus.IsIdle());
+    CHECK(bus.twiMaster.Read(deviceAddress, 0, buffer.data(), buffer.size()) == ErrorCodes::NoError);
+
+    // Frozen while asynchronous transactions are queued : they go on once the peripheral is reset
+    Recorder recorder;
+    bus.twim.nbFreezes = 1;
+    CHECK(bus.twiMaster.ReadAsync(deviceAddress, 0, buffer.data(), 1, recorder.callback, recorder.NewContext()));
+    CHECK(bus.twiMaster.ReadAsync(deviceAddress, 1, buffer.data(), 1, recorder.callback, recorder.NewContext()));
+    bus.twim.Run();
+    CHECK(recorder.completions.empty());
+    CHECK(bus.twiMaster.Write(deviceAddress, 0, buffer.data(), 1) == ErrorCodes::NoError);
+    CHECK_EQUAL(recorder.completions.size(), 2);
+    if (recorder.completions.size() == 2) {
+      CHECK(recorder.completions[0].result == ErrorCodes::TransactionFailed);
+      CHECK(recorder.completions[1].result == ErrorCodes::NoError);
+    }
+    CHECK(bus.IsIdle());
+
+    // Recovered when a transaction is queued, without waiting for a synchronous one
+    bus.twim.nbFreezes = 1;
+    recorder.completions.clear();
+    CHECK(bus.twiMaster.ReadAsync(deviceAddress, 0, buffer.data(), 1, recorder.callback, recorder.NewContext()));
+    bus.twim.Run();
+    Fakes::tickCount += pdMS_TO_TICKS(30);
+    CHECK(bus.twiMaster.ReadAsync(deviceAddress, 0, buffer.data(), 1, recorder.callback, recorder.NewContext()));
+    bus.twim.Run();
+    CHECK_EQUAL(recorder.completions.size(), 2);
+    if (recorder.completions.size() == 2) {
+      CHECK(recorder.completions[0].result == ErrorCodes::TransactionFailed);
+      CHECK(recorder.completions[1].result == ErrorCodes::NoError);
+    }
+    CHECK(bus.IsIdle());
+  }
+}
+
+int main() {
+  TestReadWrite();
+  TestAsynchronous();
+  TestSynchronousAfterAsynchronous();
+  TestErrors();
+  TestFreeze();
+  return Test::Result();
+}
@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+
+# Decodes the batches encoded by ActivityRecordBatch with tools/activity_sync_decode.py, and compares the result with
+# the minutes that were encoded.
+# Usage : activity_sync_decode_test.py <path of ActivityRecordBatchTest>
+
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'tools'))
+import activity_sync_decode  # noqa: E402
+
+
+def main():
+    output = subprocess.run([sys.argv[1], '--dump'], check=True, capture_output=True, text=True).stdout
+    lines = output.splitlines()
+    if not lines:
+        sys.exit('no batches')
+
+    next_minute = None
+    for line in lines:
+        fields = line.split()
+        data = bytes.fromhex(fields[0])
+        expected_first = int(fields[1])
+        expected_end = fields[2] == '1'
+        expected = []
+        for index, minute in enumerate(fields[3:]):
+            steps, heart_rate = (int(value) for value in minute.split(':'))
+            expected.append((expected_first + index, steps, heart_rate))
+
+        first_minute, is_end, minutes = activity_sync_decode.decode(data)
+        if first_minute != expected_first or is_end != expected_end or minutes != expected:
+            sys.exit('mismatch in batch {} : first minute {}, end {}, {} minutes'.format(
+                fields[0], first_minute, is_end, len(minutes)))
+        if next_minute is not None and first_minute != next_minute:
+            sys.exit('gap before batch {}'.format(fields[0]))
+        next_minute = first_minute + len(minutes)
+
+    print('{} batches decoded'.format(len(lines)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "TwimModel.h"
+
+namespace Fakes {
+  /* BMA421 on the TWI bus : the registers used by the driver and the Bosch library, the upload of the config file, the
+   * feature config and the FIFO.
+   *
+   * The samples are pushed by the tests, in counts of the 12 bits ADC. They are appended to the FIFO when the
+   * accelerometer is enabled in FIFO_CONFIG_1 : after a header byte and followed by a config frame after each change of
+   * ACC_CONF or ACC_RANGE in header mode, as 6 bytes in headerless mode. When the FIFO is full, the oldest frames are
+   * dropped (stream mode, the overflow is only modelled in headerless mode). Reading past the end of the FIFO returns
+   * 0x80 0x00.
+   *
+   * The interrupts are latched : INT_STAT_0 and INT_STAT_1 are cleared when read.
+   */
+  class Bma421 : public TwiDevice {
+  public:
+    static constexpr uint8_t chipId = 0x11;
+    static constexpr size_t fifoSize = 1024;
+    static constexpr size_t configSize = 6144;
+    static constexpr size_t featureSize = 70;
+
+    enum Registers : uint8_t {
+      ChipId = 0x00,
+      IntStat0 = 0x1c,
+      IntStat1 = 0x1d,
+      StepCounter = 0x1e,
+      FifoLength0 = 0x24,
+      FifoLength1 = 0x25,
+      FifoData = 0x26,
+      InternalStatus = 0x2a,
+      AccConf = 0x40,
+      AccRange = 0x41,
+      FifoWatermark0 = 0x46,
+      FifoWatermark1 = 0x47,
+      FifoConfig0 = 0x48,
+      FifoConfig1 = 0x49,
+      Int1IoCtrl = 0x53,
+      IntLatch = 0x55,
+      Int1Map = 0x56,
+      IntMapData = 0x58,
+      InitCtrl = 0x59,
+      FeatureAddress0 = 0x5b,
+      FeatureAddress1 = 0x5c,
+      Features = 0x5e,
+      PowerConf = 0x7c,
+      PowerCtrl = 0x7d,
+      Command = 0x7e,
+    };
+
+    // INT_STAT_0 and INT1_MAP
+    static constexpr uint8_t anyMotion = 0x20;
+    // INT_STAT_1 and INT_MAP_DATA (INT1)
+    static constexpr uint8_t fifoWatermark = 0x02;
+    // FIFO_CONFIG_1
+    static constexpr uint8_t fifoHeader = 0x10;
+    static constexpr uint8_t fifoAccel = 0x40;
+
+    Bma421() {
+      Reset();
+    }
+
+    void Read(uint8_t registerAddress, uint8_t* data, size_t size) override {
+      for (size_t i = 0; i < size; i++) {
+        // The FIFO and the feature config are read through a single register
+        if (registerAddress == FifoData) {
+          data[i] = PopFifo();
+        } else if (registerAddress == Features) {
+          data[i] = memory[(FeatureAddress() + i) % memory.size()];
+        } else {
+          auto address = static_cast<uint8_t>(registerAddress + i);
+          data[i] = ReadRegister(address);
+        }
+      }
+      if (registerAddress <= IntStat0 && registerAddress + size > IntStat0) {
+        registers[IntStat0] = 0;
+      }
+      if (registerAddress <= IntStat1 && registerAddress + size > IntStat1) {
+        registers[IntStat1] = 0;
+      }
+    }
+
+    void Write(uint8_t registerAddress, const uint8_t* data, size_t size) override {
+      if (registerAddress == Features) {
+        for (size_t i = 0; i < size; i++) {
+          memory[(FeatureAddress() + i) % memory.size()] = data[i];
+        }
+        featureWrites.push_back(size);
+        return;
+      }
+      for (size_t i = 0; i < size; i++) {
+        WriteRegister(static_cast<uint8_t>(registerAddress + i), data[i]);
+      }
+    }
+
+    // Samples measured at 100Hz
+    void Push(int16_t x, int16_t y, int16_t z) {
+      if ((registers[FifoConfig1] & fifoAccel) == 0 || (registers[PowerCtrl] & 0x04) == 0) {
+        return;
+      }
+      bool header = (registers[FifoConfig1] & fifoHeader) != 0;
+      if (header) {
+        fifo.push_back(0x84);
+      } else {
+        while (fifo.size() + 6 > fifoSize) {
+          fifo.erase(fifo.begin(), fifo.begin() + 6);
+        }
+      }
+      for (int16_t value : {x, y, z}) {
+        // Left-justified
+        auto word = static_cast<uint16_t>(value * 16);
+        fifo.push_back(static_cast<uint8_t>(word));
+        fifo.push_back(static_cast<uint8_t>(word >> 8));
+      }
+      UpdateWatermark();
+    }
+
+    // The any-motion feature detected a movement
+    void Move() {
+      registers[IntStat0] |= anyMotion;
+    }
+
+    void SetSteps(uint32_t steps) {
+      for (size_t i = 0; i < 4; i++) {
+        registers[StepCounter + i] = static_cast<uint8_t>(steps >> (8 * i));
+      }
+    }
+
+    // Level of the INT1 pin, in latch mode
+    bool Int1() const {
+      return (registers[IntStat0] & registers[Int1Map]) != 0 || (registers[IntStat1] & registers[IntMapData] & 0x07) != 0;
+    }
+
+    size_t FifoLength() const {
+      return fifo.size();
+    }
+
+    uint16_t Watermark() const {
+      return static_cast<uint16_t>(registers[FifoWatermark0] | (registers[FifoWatermark1] << 8));
+    }
+
+    // The config file and, after the upload, the feature config (at configSize)
+    std::vector<uint8_t> memory;
+    // Size of the writes to the feature config and to the config file
+    std::vector<size_t> featureWrites;
+    uint8_t registers[256] {};
+    int nbResets = 0;
+
+  private:
+    void Reset() {
+      for (auto& value : registers) {
+        value = 0;
+      }
+      registers[ChipId] = chipId;
+      registers[AccConf] = 0xa8;
+      registers[AccRange] = 0x01;
+      registers[FifoWatermark1] = 0x02;
+      registers[FifoConfig1] = fifoHeader;
+      registers[InitCtrl] = 0x90;
+      registers[PowerConf] = 0x03;
+      memory.assign(configSize + featureSize + 2, 0);
+      fifo.clear();
+    }
+
+    uint8_t ReadRegister(uint8_t address) {
+      switch (address) {
+        case FifoLength0:
+          return static_cast<uint8_t>(fifo.size());
+        case FifoLength1:
+          return static_cast<uint8_t>(fifo.size() >> 8);
+        default:
+          return registers[address];
+      }
+    }
+
+    void WriteRegister(uint8_t address, uint8_t value) {
+      switch (address) {
+        case Command:
+          if (value == 0xb6) {
+            Reset();
+            nbResets++;
+          } else if (value == 0xb0) {
+            fifo.clear();
+          }
+          return;
+        case InitCtrl:
+          // The ASIC starts from the uploaded config file, then exposes the feature config
+          if (value == 0x01) {
+            registers[InternalStatus] = 0x01;
+            registers[FeatureAddress0] = static_cast<uint8_t>((configSize / 2) & 0x0f);
+            registers[FeatureAddress1] = static_cast<uint8_t>((configSize / 2) >> 4);
+          }
+          break;
+        case AccConf:
+        case AccRange:
+          if ((registers[FifoConfig1] & (fifoHeader | fifoAccel)) == (fifoHeader | fifoAccel)) {
+            fifo.push_back(0x48);
+            fifo.push_back(0x01);
+          }
+          break;
+        default:
+          break;
+      }
+      registers[address] = value;
+      UpdateWatermark();
+    }
+
+    uint8_t PopFifo() {
+      if (fifo.empty()) {
+        overRead = !overRead;
+        return overRead ? 0x80 : 0x00;
+      }
+      overRead = false;
+      uint8_t value = fifo.front();
+      fifo.pop_front();
+      return value;
+    }
+
+    // In bytes, from the word address of FEATURE_ADDRESS
+    size_t FeatureAddress() const {
+      return 2 * static_cast<size_t>((registers[FeatureAddress0] & 0x0f) | (registers[FeatureAddress1] << 4));
+    }
+
+    void UpdateWatermark() {
+      if (Watermark() != 0 && fifo.size() >= Watermark()) {
+        registers[IntStat1] |= fifoWatermark;
+      }
+    }
+
+    std::deque<uint8_t> fifo;
+    bool overRead = false;
+  };
+}
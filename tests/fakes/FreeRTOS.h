@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// The FreeRTOS types used in the headers of the components
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define configTICK_RATE_HZ 1024
+#define pdMS_TO_TICKS(ms)  static_cast<TickType_t>(static_cast<uint64_t>(ms) * configTICK_RATE_HZ / 1000)
+
+#define portMAX_DELAY static_cast<TickType_t>(0xffffffffUL)
+#define pdFALSE       0
+#define pdTRUE        1
+#define pdPASS        pdTRUE
+#define errQUEUE_FULL 0
+
+// From app_error.h, included by FreeRTOSConfig.h : the tests stop at the first error
+#define NRF_ERROR_NO_MEM 4
+#define APP_ERROR_HANDLER(error)                                                                                                           \
+  do {                                                                                                                                     \
+    std::fprintf(stderr, "%s:%d: error %d\n", __FILE__, __LINE__, static_cast<int>(error));                                                \
+    std::abort();                                                                                                                          \
+  } while (0)
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "TwimModel.h"
+
+namespace Fakes {
+  /* HRS3300 on the TWI bus : the settings written by the driver, and the data registers of a conversion.
+   *
+   * A conversion is made each time the data registers are read. The tests give the light reflected by the skin (HRS)
+   * and the ambient light (ALS), in counts of the ADC at 15 bits, with the lowest LED current and a gain of 1x. The HRS
+   * value is scaled by the LED current and the gain configured, both are scaled to the resolution, and they saturate at
+   * the full scale of the ADC. The LED is off while the sensor is disabled.
+   */
+  class Hrs3300 : public TwiDevice {
+  public:
+    enum Registers : uint8_t {
+      Enable = 0x01,
+      C1DataM = 0x08,
+      C0DataM = 0x09,
+      C0DataH = 0x0a,
+      PDriver = 0x0c,
+      C1DataH = 0x0d,
+      C1DataL = 0x0e,
+      C0DataL = 0x0f,
+      Res = 0x16,
+      Hgain = 0x17,
+    };
+
+    struct Light {
+      double hrs;
+      double als;
+    };
+
+    void Read(uint8_t registerAddress, uint8_t* data, size_t size) override {
+      if (registerAddress <= C0DataL && registerAddress + size > C1DataM) {
+        Convert();
+      }
+      for (size_t i = 0; i < size; i++) {
+        data[i] = registers[static_cast<uint8_t>(registerAddress + i)];
+      }
+    }
+
+    void Write(uint8_t registerAddress, const uint8_t* data, size_t size) override {
+      for (size_t i = 0; i < size; i++) {
+        registers[static_cast<uint8_t>(registerAddress + i)] = data[i];
+      }
+    }
+
+    bool IsEnabled() const {
+      return (registers[Enable] & 0x80) != 0;
+    }
+
+    // PDRIVE : 0 (12.5mA), 1 (20mA), 2 (30mA) or 3 (40mA)
+    uint8_t LedDriveCurrent() const {
+      return static_cast<uint8_t>((((registers[Enable] >> 3) & 0x01) << 1) | ((registers[PDriver] >> 6) & 0x01));
+    }
+
+    // Bits
+    uint8_t Resolution() const {
+      return static_cast<uint8_t>((registers[Res] & 0x0f) + 8);
+    }
+
+    // HGAIN : 0 (1x), 1 (2x), 2 (4x), 3 (8x) or 4 (64x)
+    uint8_t Gain() const {
+      return static_cast<uint8_t>((registers[Hgain] >> 2) & 0x07);
+    }
+
+    // HWT
+    uint8_t WaitTime() const {
+      return static_cast<uint8_t>((registers[Enable] >> 4) & 0x07);
+    }
+
+    // The light of the next conversion
+    std::function<Light()> measure;
+    int nbConversions = 0;
+    uint8_t registers[256] {};
+
+  private:
+    void Convert() {
+      static constexpr double ledDriveCurrents[] {12.5, 20.0, 30.0, 40.0};
+      static constexpr double gains[] {1.0, 2.0, 4.0, 8.0, 64.0, 64.0, 64.0, 64.0};
+      nbConversions++;
+      Light light = measure ? measure() : Light {0.0, 0.0};
+      bool ledOn = IsEnabled() && registers[PDriver] != 0;
+      double scale = std::ldexp(1.0, Resolution() - 15);
+      double hrs = ledOn ? light.hrs * ledDriveCurrents[LedDriveCurrent()] / ledDriveCurrents[0] * gains[Gain()] : 0.0;
+      auto fullScale = static_cast<double>((1U << std::min<uint8_t>(Resolution(), 16)) - 1);
+      auto hrsValue = static_cast<uint16_t>(std::clamp(std::round(hrs * scale), 0.0, fullScale));
+      auto alsValue = static_cast<uint32_t>(std::clamp(std::round(light.als * scale), 0.0, fullScale));
+
+      registers[C0DataM] = static_cast<uint8_t>(hrsValue >> 8);
+      registers[C0DataH] = static_cast<uint8_t>((hrsValue >> 4) & 0x0f);
+      registers[C0DataL] = static_cast<uint8_t>(hrsValue & 0x0f);
+      registers[C1DataH] = static_cast<uint8_t>((alsValue >> 11) & 0x3f);
+      registers[C1DataM] = static_cast<uint8_t>((alsValue >> 3) & 0xff);
+      registers[C1DataL] = static_cast<uint8_t>(alsValue & 0x07);
+    }
+  };
+}
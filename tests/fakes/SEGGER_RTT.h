@@ -0,0 +1,9 @@
+#pragma once
+
+// modlog.h redefines printf() after including this header : stdio must be declared before
+#include <cstdio>
+
+// The logs of NimBLE are compiled, but not printed
+inline int SEGGER_RTT_printf(unsigned /*bufferIndex*/, const char* /*format*/, ...) {
+  return 0;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+#include "drivers/include/nrfx_twi.h"
+
+namespace Fakes {
+  // Slave on the TWI bus : the first byte written is the register address, the following bytes are read from or written
+  // to the consecutive registers
+  class TwiDevice {
+  public:
+    virtual ~TwiDevice() = default;
+    virtual void Read(uint8_t registerAddress, uint8_t* data, size_t size) = 0;
+    virtual void Write(uint8_t registerAddress, const uint8_t* data, size_t size) = 0;
+  };
+
+  // 256 registers, the address is incremented after each byte
+  class RegisterFile : public TwiDevice {
+  public:
+    void Read(uint8_t registerAddress, uint8_t* data, size_t size) override {
+      for (size_t i = 0; i < size; i++) {
+        data[i] = registers[static_cast<uint8_t>(registerAddress + i)];
+      }
+    }
+
+    void Write(uint8_t registerAddress, const uint8_t* data, size_t size) override {
+      for (size_t i = 0; i < size; i++) {
+        registers[static_cast<uint8_t>(registerAddress + i)] = data[i];
+      }
+    }
+
+    uint8_t registers[256] {};
+  };
+
+  /* TWIM peripheral executing the transactions programmed in its registers, like the nRF52832 does.
+   *
+   * Run() executes the tasks triggered since the previous call, sets the events and calls the interrupt handler while
+   * an enabled event is pending. Only the shortcuts used by TwiMaster are supported : a transfer without them never
+   * ends, like a frozen peripheral. After an error (NACK), the peripheral waits for the STOP task.
+   */
+  class Twim {
+  public:
+    struct Transfer {
+      uint8_t address;
+      bool read;
+      std::vector<uint8_t> data; // written, or read, register address excluded
+    };
+
+    NRF_TWIM_Type registers {};
+    std::function<void()> interruptHandler;
+    std::map<uint8_t, TwiDevice*> devices;
+
+    // Failures injected in the next transfers
+    bool nackData = false;
+    // Number of transfers that freeze the peripheral : EVENTS_STOPPED is never set, until it is disabled
+    int nbFreezes = 0;
+
+    std::vector<Transfer> transfers;
+    int nbInterrupts = 0;
+
+    bool IsEnabled() const {
+      return registers.ENABLE == (TWIM_ENABLE_ENABLE_Enabled << TWIM_ENABLE_ENABLE_Pos);
+    }
+
+    void Run() {
+      do {
+        Execute();
+      } while (RaiseInterrupt());
+    }
+
+  private:
+    void Execute() {
+      registers.TASKS_RESUME = 0;
+      // Disabling the peripheral resets it
+      if (registers.ENABLE.nbDisables != nbDisables) {
+        nbDisables = registers.ENABLE.nbDisables;
+        frozen = false;
+        waitingForStop = false;
+      }
+      if (!IsEnabled()) {
+        registers.TASKS_STARTTX = 0;
+        registers.TASKS_STOP = 0;
+        return;
+      }
+
+      if (registers.TASKS_STOP != 0) {
+        registers.TASKS_STOP = 0;
+        if (waitingForStop) {
+          waitingForStop = false;
+          registers.EVENTS_STOPPED = 1;
+        }
+      }
+
+      if (registers.TASKS_STARTTX == 0) {
+        return;
+      }
+      registers.TASKS_STARTTX = 0;
+      registers.TXD.AMOUNT = 0;
+      registers.RXD.AMOUNT = 0;
+      if (frozen) {
+        return;
+      }
+      if (nbFreezes > 0) {
+        nbFreezes--;
+        frozen = true;
+        return;
+      }
+
+      auto device = devices.find(static_cast<uint8_t>(registers.ADDRESS));
+      if (device == devices.end()) {
+        Fail(TWIM_ERRORSRC_ANACK_Msk);
+        return;
+      }
+
+      const auto* tx = reinterpret_cast<const uint8_t*>(registers.TXD.PTR);
+      size_t txSize = registers.TXD.MAXCNT;
+      if (txSize == 0) {
+        frozen = true;
+        return;
+      }
+      uint8_t registerAddress = tx[0];
+      if (registers.SHORTS == (TWIM_SHORTS_LASTTX_STARTRX_Msk | TWIM_SHORTS_LASTRX_STOP_Msk) && txSize == 1) {
+        auto* rx = reinterpret_cast<uint8_t*>(registers.RXD.PTR);
+        device->second->Read(registerAddress, rx, registers.RXD.MAXCNT);
+        registers.TXD.AMOUNT = 1;
+        registers.RXD.AMOUNT = registers.RXD.MAXCNT;
+        transfers.push_back({static_cast<uint8_t>(registers.ADDRESS), true, {rx, rx + registers.RXD.MAXCNT}});
+        registers.EVENTS_STOPPED = 1;
+      } else if (registers.SHORTS == TWIM_SHORTS_LASTTX_STOP_Msk) {
+        if (nackData) {
+          // The register address is acknowledged, not the first data byte
+          registers.TXD.AMOUNT = 2;
+          Fail(TWIM_ERRORSRC_DNACK_Msk);
+          return;
+        }
+        device->second->Write(registerAddress, tx + 1, txSize - 1);
+        registers.TXD.AMOUNT = txSize;
+        transfers.push_back({static_cast<uint8_t>(registers.ADDRESS), false, {tx + 1, tx + txSize}});
+        registers.EVENTS_STOPPED = 1;
+      } else {
+        frozen = true;
+      }
+    }
+
+    void Fail(uint32_t source) {
+      registers.ERRORSRC.Set(source);
+      registers.EVENTS_ERROR = 1;
+      waitingForStop = true;
+    }
+
+    bool RaiseInterrupt() {
+      bool pending = (registers.EVENTS_STOPPED != 0 && (registers.INTEN & TWIM_INTENSET_STOPPED_Msk) != 0) ||
+                     (registers.EVENTS_ERROR != 0 && (registers.INTEN & TWIM_INTENSET_ERROR_Msk) != 0);
+      if (!pending || !interruptHandler) {
+        return false;
+      }
+      nbInterrupts++;
+      interruptHandler();
+      return true;
+    }
+
+    bool frozen = false;
+    bool waitingForStop = false;
+    uint32_t nbDisables = 0;
+  };
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "components/ble/PpgSampleBatch.h"
+
+namespace Pinetime {
+  namespace Controllers {
+    // Records the values notified to the companion app
+    class HeartRateService {
+    public:
+      void OnNewHeartRateValue(uint8_t heartRateValue) {
+        heartRates.push_back(heartRateValue);
+      }
+
+      void OnNewPpgSample(const PpgSampleBatch::SensorConfig& config, uint16_t /*hrs*/, uint16_t /*als*/, bool /*newMeasurement*/) {
+        sensorConfigs.push_back(config);
+      }
+
+      std::vector<uint8_t> heartRates;
+      std::vector<PpgSampleBatch::SensorConfig> sensorConfigs;
+    };
+  }
+}
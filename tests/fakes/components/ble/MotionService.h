@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Controllers {
+    // The notifications of the motion service are not sent by the tests
+    class MotionService {
+    public:
+      void OnNewStepCountValue(uint32_t /*stepCount*/) {
+      }
+
+      void OnNewMotionValues(int16_t /*x*/, int16_t /*y*/, int16_t /*z*/) {
+      }
+
+      void OnNewMotionSample(uint32_t /*timestamp*/, int16_t /*x*/, int16_t /*y*/, int16_t /*z*/) {
+      }
+    };
+  }
+}
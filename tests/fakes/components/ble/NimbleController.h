@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_hs.h>
+#undef max
+#undef min
+
+namespace Pinetime {
+  namespace Controllers {
+    // The connection used by the GATT services to send their notifications
+    class NimbleController {
+    public:
+      uint16_t connHandle() {
+        return connectionHandle;
+      }
+
+      uint16_t connectionHandle = BLE_HS_CONN_HANDLE_NONE;
+    };
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Controllers {
+    // UTC time set by the test, the synchronisations by the companion app are counted
+    class DateTime {
+    public:
+      void SynchroniseTime(uint16_t /*year*/,
+                           uint8_t /*month*/,
+                           uint8_t /*day*/,
+                           uint8_t /*hour*/,
+                           uint8_t /*minute*/,
+                           uint8_t /*second*/,
+                           uint8_t /*fractions256*/) {
+        nbSynchronisations++;
+      }
+
+      std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds> CurrentDateTime() {
+        return currentDateTime;
+      }
+
+      std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds> currentDateTime;
+      int nbSynchronisations = 0;
+    };
+  }
+}
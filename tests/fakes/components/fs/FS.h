@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <littlefs/lfs.h>
+
+namespace Pinetime {
+  namespace Controllers {
+    // Filesystem in RAM with the interface of the FS controller. The data is written to the file immediately, the
+    // directories are only checked by DirOpen().
+    class FS {
+    public:
+      int FileOpen(lfs_file_t* file_p, const char* fileName, const int flags) {
+        auto it = files.find(fileName);
+        if (it == files.end()) {
+          if ((flags & LFS_O_CREAT) == 0) {
+            return LFS_ERR_NOENT;
+          }
+          it = files.emplace(fileName, std::vector<uint8_t> {}).first;
+        }
+        if ((flags & LFS_O_TRUNC) != 0) {
+          it->second.clear();
+        }
+        file_p->handle = nextHandle++;
+        openFiles[file_p->handle] = {it->first, 0, flags};
+        return LFS_ERR_OK;
+      }
+
+      int FileClose(lfs_file_t* file_p) {
+        return openFiles.erase(file_p->handle) == 1 ? LFS_ERR_OK : LFS_ERR_BADF;
+      }
+
+      int FileRead(lfs_file_t* file_p, uint8_t* buff, uint32_t size) {
+        auto& file = openFiles.at(file_p->handle);
+        const auto& data = files.at(file.name);
+        size_t count = file.position < data.size() ? std::min<size_t>(size, data.size() - file.position) : 0;
+        if (count > 0) {
+          std::memcpy(buff, data.data() + file.position, count);
+        }
+        file.position += count;
+        nbReads++;
+        bytesRead += count;
+        return static_cast<int>(count);
+      }
+
+      int FileWrite(lfs_file_t* file_p, const uint8_t* buff, uint32_t size) {
+        if (failWrites) {
+          return LFS_ERR_IO;
+        }
+        auto& file = openFiles.at(file_p->handle);
+        auto& data = files.at(file.name);
+        if ((file.flags & LFS_O_APPEND) != 0) {
+          file.position = data.size();
+        }
+        data.resize(std::max(data.size(), file.position + size));
+        std::memcpy(data.data() + file.position, buff, size);
+        file.position += size;
+        return static_cast<int>(size);
+      }
+
+      int FileSeek(lfs_file_t* file_p, uint32_t pos) {
+        openFiles.at(file_p->handle).position = pos;
+        return static_cast<int>(pos);
+      }
+
+      int FileDelete(const char* fileName) {
+        return files.erase(fileName) == 1 ? LFS_ERR_OK : LFS_ERR_NOENT;
+      }
+
+      int DirOpen(const char* path, lfs_dir_t* /*lfs_dir*/) {
+        return directories.count(path) == 1 ? LFS_ERR_OK : LFS_ERR_NOENT;
+      }
+
+      int DirClose(lfs_dir_t* /*lfs_dir*/) {
+        return LFS_ERR_OK;
+      }
+
+      int DirCreate(const char* path) {
+        return directories.insert(path).second ? LFS_ERR_OK : LFS_ERR_EXIST;
+      }
+
+      int Stat(const char* path, lfs_info* info) {
+        auto it = files.find(path);
+        if (it == files.end()) {
+          return LFS_ERR_NOENT;
+        }
+        info->type = LFS_TYPE_REG;
+        info->size = static_cast<lfs_size_t>(it->second.size());
+        return LFS_ERR_OK;
+      }
+
+      std::map<std::string, std::vector<uint8_t>> files;
+      std::set<std::string> directories {"/"};
+      // The writes fail (flash error, or reset before the file is closed)
+      bool failWrites = false;
+      // Number of calls to FileRead(), and bytes read
+      size_t nbReads = 0;
+      size_t bytesRead = 0;
+
+    private:
+      struct OpenFile {
+        std::string name;
+        size_t position;
+        int flags;
+      };
+
+      std::map<int, OpenFile> openFiles;
+      int nextHandle = 1;
+    };
+  }
+}
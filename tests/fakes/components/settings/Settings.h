@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+namespace Pinetime {
+  namespace Controllers {
+    // The settings used by the components under test, kept in RAM
+    class Settings {
+    public:
+      std::optional<uint16_t> GetHeartRateBackgroundMeasurementInterval() const {
+        if (heartRateBackgroundPeriod == std::numeric_limits<uint16_t>::max()) {
+          return std::nullopt;
+        }
+        return heartRateBackgroundPeriod;
+      }
+
+      void SetHeartRateBackgroundMeasurementInterval(std::optional<uint16_t> newIntervalInSeconds) {
+        heartRateBackgroundPeriod = newIntervalInSeconds.value_or(std::numeric_limits<uint16_t>::max());
+      }
+
+    private:
+      uint16_t heartRateBackgroundPeriod = std::numeric_limits<uint16_t>::max();
+    };
+  }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+
+// Registers of the TWIM peripheral used by TwiMaster, simulated by Fakes::Twim (TwimModel.h). The pointers of EasyDMA
+// are as wide as the pointers of the host.
+namespace Fakes {
+  // Writing 1 to a bit sets or clears the bit of the target register (INTENSET, INTENCLR), reading returns the target
+  class MaskRegister {
+  public:
+    MaskRegister(uint32_t& target, bool set) : target {target}, set {set} {
+    }
+
+    MaskRegister(const MaskRegister&) = delete;
+
+    MaskRegister& operator=(uint32_t value) {
+      target = set ? (target | value) : (target & ~value);
+      return *this;
+    }
+
+    MaskRegister& operator=(const MaskRegister& other) {
+      return *this = static_cast<uint32_t>(other);
+    }
+
+    operator uint32_t() const {
+      return target;
+    }
+
+  private:
+    uint32_t& target;
+    bool set;
+  };
+
+  // The bits are set by the peripheral, and cleared by writing 1 (ERRORSRC)
+  class ClearOnWriteRegister {
+  public:
+    ClearOnWriteRegister() = default;
+    ClearOnWriteRegister(const ClearOnWriteRegister&) = delete;
+
+    ClearOnWriteRegister& operator=(uint32_t written) {
+      value &= ~written;
+      return *this;
+    }
+
+    ClearOnWriteRegister& operator=(const ClearOnWriteRegister& other) {
+      return *this = static_cast<uint32_t>(other);
+    }
+
+    operator uint32_t() const {
+      return value;
+    }
+
+    void Set(uint32_t bits) {
+      value |= bits;
+    }
+
+  private:
+    uint32_t value = 0;
+  };
+
+  // Counts the writes, so that the model knows when the peripheral was disabled
+  class EnableRegister {
+  public:
+    EnableRegister() = default;
+    EnableRegister(const EnableRegister&) = delete;
+    EnableRegister& operator=(const EnableRegister&) = delete;
+
+    EnableRegister& operator=(uint32_t written) {
+      value = written;
+      if (written == 0) {
+        nbDisables++;
+      }
+      return *this;
+    }
+
+    operator uint32_t() const {
+      return value;
+    }
+
+    uint32_t nbDisables = 0;
+
+  private:
+    uint32_t value = 0;
+  };
+}
+
+struct TWIM_PSEL_Type {
+  uint32_t SCL;
+  uint32_t SDA;
+};
+
+struct TWIM_DMA_Type {
+  uintptr_t PTR;
+  uint32_t MAXCNT;
+  uint32_t AMOUNT;
+  uint32_t LIST;
+};
+
+struct NRF_TWIM_Type {
+  uint32_t TASKS_STARTRX;
+  uint32_t TASKS_STARTTX;
+  uint32_t TASKS_STOP;
+  uint32_t TASKS_SUSPEND;
+  uint32_t TASKS_RESUME;
+  uint32_t EVENTS_STOPPED;
+  uint32_t EVENTS_ERROR;
+  uint32_t EVENTS_SUSPENDED;
+  uint32_t EVENTS_RXSTARTED;
+  uint32_t EVENTS_TXSTARTED;
+  uint32_t EVENTS_LASTRX;
+  uint32_t EVENTS_LASTTX;
+  uint32_t SHORTS;
+  uint32_t INTEN = 0;
+  Fakes::MaskRegister INTENSET {INTEN, true};
+  Fakes::MaskRegister INTENCLR {INTEN, false};
+  Fakes::ClearOnWriteRegister ERRORSRC;
+  Fakes::EnableRegister ENABLE;
+  TWIM_PSEL_Type PSEL;
+  uint32_t FREQUENCY;
+  TWIM_DMA_Type RXD;
+  TWIM_DMA_Type TXD;
+  uint32_t ADDRESS;
+};
+
+#define TWIM_SHORTS_LASTTX_STARTRX_Msk (1UL << 7)
+#define TWIM_SHORTS_LASTTX_SUSPEND_Msk (1UL << 8)
+#define TWIM_SHORTS_LASTTX_STOP_Msk    (1UL << 9)
+#define TWIM_SHORTS_LASTRX_STARTTX_Msk (1UL << 10)
+#define TWIM_SHORTS_LASTRX_STOP_Msk    (1UL << 12)
+
+#define TWIM_INTENSET_STOPPED_Msk (1UL << 1)
+#define TWIM_INTENSET_ERROR_Msk   (1UL << 9)
+#define TWIM_INTENCLR_STOPPED_Msk (1UL << 1)
+#define TWIM_INTENCLR_ERROR_Msk   (1UL << 9)
+
+#define TWIM_ERRORSRC_OVERRUN_Msk (1UL << 0)
+#define TWIM_ERRORSRC_ANACK_Msk   (1UL << 1)
+#define TWIM_ERRORSRC_DNACK_Msk   (1UL << 2)
+
+#define TWIM_ENABLE_ENABLE_Pos      0
+#define TWIM_ENABLE_ENABLE_Disabled 0
+#define TWIM_ENABLE_ENABLE_Enabled  6
+
+#define TWIM_FREQUENCY_FREQUENCY_K400 0x06400000UL
+
+#define SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn 4
+#define NRFX_IRQ_PRIORITY_SET(irq, priority)
+#define NRFX_IRQ_ENABLE(irq)
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// The configuration of the pins is recorded, their level can be set by the tests
+struct NRF_GPIO_Type {
+  uint32_t PIN_CNF[32];
+};
+
+namespace Fakes {
+  inline NRF_GPIO_Type gpio {};
+  inline uint32_t pinLevels = 0;
+}
+
+#define NRF_GPIO (&Fakes::gpio)
+
+#define GPIO_PIN_CNF_DIR_Pos            0
+#define GPIO_PIN_CNF_DIR_Input          0
+#define GPIO_PIN_CNF_INPUT_Pos          1
+#define GPIO_PIN_CNF_INPUT_Connect      0
+#define GPIO_PIN_CNF_PULL_Pos           2
+#define GPIO_PIN_CNF_PULL_Disabled      0
+#define GPIO_PIN_CNF_DRIVE_Pos          8
+#define GPIO_PIN_CNF_DRIVE_S0D1         6
+#define GPIO_PIN_CNF_SENSE_Pos          16
+#define GPIO_PIN_CNF_SENSE_Disabled     0
+
+inline uint32_t nrf_gpio_pin_read(uint32_t pin) {
+  return (Fakes::pinLevels >> pin) & 1;
+}
+
+typedef enum {
+  NRF_GPIO_PIN_NOPULL = 0,
+  NRF_GPIO_PIN_PULLDOWN = 1,
+  NRF_GPIO_PIN_PULLUP = 3,
+} nrf_gpio_pin_pull_t;
+
+inline void nrf_gpio_cfg_input(uint32_t pin, nrf_gpio_pin_pull_t pull) {
+  NRF_GPIO->PIN_CNF[pin] = (GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos) | (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos) |
+                           (static_cast<uint32_t>(pull) << GPIO_PIN_CNF_PULL_Pos);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// The drivers wait for the sensors, which are simulated without delay
+inline void nrf_delay_us(uint32_t /*us*/) {
+}
+
+inline void nrf_delay_ms(uint32_t /*ms*/) {
+}
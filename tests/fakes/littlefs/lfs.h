@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+// The types, flags and error codes of littlefs used by the components, the files are stored by the fake FS
+typedef uint32_t lfs_size_t;
+typedef int32_t lfs_ssize_t;
+typedef uint32_t lfs_block_t;
+typedef uint32_t lfs_off_t;
+
+enum lfs_error {
+  LFS_ERR_OK = 0,
+  LFS_ERR_IO = -5,
+  LFS_ERR_CORRUPT = -84,
+  LFS_ERR_NOENT = -2,
+  LFS_ERR_EXIST = -17,
+  LFS_ERR_NOTDIR = -20,
+  LFS_ERR_ISDIR = -21,
+  LFS_ERR_NOTEMPTY = -39,
+  LFS_ERR_BADF = -9,
+  LFS_ERR_FBIG = -27,
+  LFS_ERR_INVAL = -22,
+  LFS_ERR_NOSPC = -28,
+  LFS_ERR_NOMEM = -12,
+};
+
+enum lfs_type {
+  LFS_TYPE_REG = 0x001,
+  LFS_TYPE_DIR = 0x002,
+};
+
+enum lfs_open_flags {
+  LFS_O_RDONLY = 1,
+  LFS_O_WRONLY = 2,
+  LFS_O_RDWR = 3,
+  LFS_O_CREAT = 0x0100,
+  LFS_O_EXCL = 0x0200,
+  LFS_O_TRUNC = 0x0400,
+  LFS_O_APPEND = 0x0800,
+};
+
+struct lfs_info {
+  uint8_t type;
+  lfs_size_t size;
+  char name[256];
+};
+
+typedef struct lfs_file {
+  int handle;
+} lfs_file_t;
+
+typedef struct lfs_dir {
+  int handle;
+} lfs_dir_t;
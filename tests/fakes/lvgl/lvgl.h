@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// The colors used by the components (RGB565), the rendering is not compiled in the tests
+struct lv_color_t {
+  uint16_t full;
+};
+
+struct lv_theme_t;
+
+#define LV_COLOR_MAKE(r, g, b)                                                                                                    \
+  lv_color_t {                                                                                                                     \
+    static_cast<uint16_t>((((r) >> 3) << 11) | (((g) >> 2) << 5) | ((b) >> 3))                                                     \
+  }
+#define LV_COLOR_WHITE LV_COLOR_MAKE(0xff, 0xff, 0xff)
+#define LV_COLOR_BLACK LV_COLOR_MAKE(0x00, 0x00, 0x00)
+#define LV_COLOR_RED   LV_COLOR_MAKE(0xff, 0x00, 0x00)
+#define LV_COLOR_CYAN  LV_COLOR_MAKE(0x00, 0xff, 0xff)
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#define LV_TRIGO_SIN_MAX 32767
+
+// Sine of an angle in degrees, computed instead of read from the table of LVGL
+inline int16_t _lv_trigo_sin(int16_t angle) {
+  constexpr double pi = 3.14159265358979323846;
+  return static_cast<int16_t>(std::lround(LV_TRIGO_SIN_MAX * std::sin(angle * pi / 180)));
+}
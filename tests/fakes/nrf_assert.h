@@ -0,0 +1,5 @@
+#pragma once
+
+#include <cassert>
+
+#define ASSERT(expression) assert(expression)
@@ -0,0 +1,4 @@
+#pragma once
+
+// Included without its directory by some drivers, like in the SDK
+#include "hal/nrf_gpio.h"
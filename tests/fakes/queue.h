@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include "FreeRTOS.h"
+#include "task.h"
+
+// Queues and semaphores share their definition, like in FreeRTOS
+struct QueueDefinition {
+  bool taken;
+  UBaseType_t nbMessages;
+  // Queues of messages : the messages not received yet
+  UBaseType_t length = 0;
+  size_t itemSize = 0;
+  std::deque<std::vector<uint8_t>> messages {};
+};
+
+typedef struct QueueDefinition* QueueHandle_t;
+
+namespace Fakes {
+  // The queues are never deleted by the firmware, they live until the end of the test
+  inline std::deque<QueueDefinition> queues;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return queue->nbMessages;
+}
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return &Fakes::queues.emplace_back(QueueDefinition {false, 0, length, itemSize});
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t /*ticksToWait*/) {
+  if (queue->messages.size() >= queue->length) {
+    return errQUEUE_FULL;
+  }
+  const auto* bytes = static_cast<const uint8_t*>(item);
+  queue->messages.emplace_back(bytes, bytes + queue->itemSize);
+  queue->nbMessages++;
+  return pdPASS;
+}
+
+inline BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken) {
+  BaseType_t sent = xQueueSend(queue, item, 0);
+  if (sent == pdPASS && higherPriorityTaskWoken != nullptr) {
+    *higherPriorityTaskWoken = pdTRUE;
+  }
+  return sent;
+}
+
+// The tests run in a single task : like xSemaphoreTake(), waiting on an empty queue runs Fakes::whileBlocked, then the
+// wait times out and advances the time. Waiting forever aborts the test.
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+  if (queue->messages.empty() && ticksToWait != 0 && Fakes::whileBlocked) {
+    Fakes::whileBlocked();
+  }
+  if (queue->messages.empty()) {
+    if (ticksToWait == portMAX_DELAY) {
+      std::fprintf(stderr, "xQueueReceive() would block forever\n");
+      std::abort();
+    }
+    Fakes::tickCount += ticksToWait;
+    return pdFALSE;
+  }
+  std::memcpy(buffer, queue->messages.front().data(), queue->itemSize);
+  queue->messages.pop_front();
+  queue->nbMessages--;
+  return pdTRUE;
+}
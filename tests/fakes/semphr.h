@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+// The tests run in a single task : taking a semaphore that is already taken would block forever, it aborts the test
+// instead (a callback called under a lock that takes it again, for example). A task that waits for a semaphore first
+// runs Fakes::whileBlocked (task.h), and a wait that times out advances the time.
+typedef struct QueueDefinition* SemaphoreHandle_t;
+
+namespace Fakes {
+  // The semaphores are never deleted by the firmware, they live until the end of the test
+  inline std::deque<QueueDefinition> semaphores;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return &Fakes::semaphores.emplace_back(QueueDefinition {false});
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return &Fakes::semaphores.emplace_back(QueueDefinition {true});
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+  if (semaphore->taken && ticksToWait != 0 && Fakes::whileBlocked) {
+    Fakes::whileBlocked();
+  }
+  if (semaphore->taken) {
+    if (ticksToWait == portMAX_DELAY) {
+      std::fprintf(stderr, "xSemaphoreTake() would block forever\n");
+      std::abort();
+    }
+    Fakes::tickCount += ticksToWait;
+    return pdFALSE;
+  }
+  semaphore->taken = true;
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  if (!semaphore->taken) {
+    return pdFALSE;
+  }
+  semaphore->taken = false;
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken) {
+  BaseType_t given = xSemaphoreGive(semaphore);
+  if (given == pdTRUE && higherPriorityTaskWoken != nullptr) {
+    *higherPriorityTaskWoken = pdTRUE;
+  }
+  return given;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include "systemtask/Messages.h"
+
+namespace Pinetime {
+  namespace System {
+    // Records the messages pushed by the components
+    class SystemTask {
+    public:
+      void PushMessage(Messages message) {
+        messages.push_back(message);
+      }
+
+      std::vector<Messages> messages;
+    };
+  }
+}
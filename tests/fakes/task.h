@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "FreeRTOS.h"
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// The fields of the task status used by the firmware
+typedef struct xTASK_STATUS {
+  const char* pcTaskName;
+  uint16_t usStackHighWaterMark;
+} TaskStatus_t;
+
+namespace Fakes {
+  inline std::vector<TaskStatus_t> tasks;
+  // Created between uxTaskGetNumberOfTasks() and the next call to uxTaskGetSystemState()
+  inline std::vector<TaskStatus_t> createdTasks;
+  inline TickType_t tickCount = 0;
+  inline size_t freeHeapSize = 0;
+  inline size_t minimumEverFreeHeapSize = 0;
+  // Runs what happens while the task is blocked (the interrupt handlers)
+  inline std::function<void()> whileBlocked;
+}
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+#define taskYIELD()
+#define portYIELD_FROM_ISR(higherPriorityTaskWoken) static_cast<void>(higherPriorityTaskWoken)
+
+// The task is not run : the tests call the steps of its loop themselves
+inline BaseType_t xTaskCreate(TaskFunction_t /*function*/,
+                              const char* /*name*/,
+                              uint16_t /*stackDepth*/,
+                              void* /*parameters*/,
+                              UBaseType_t /*priority*/,
+                              TaskHandle_t* handle) {
+  if (handle != nullptr) {
+    *handle = nullptr;
+  }
+  return pdPASS;
+}
+
+inline TickType_t xTaskGetTickCount() {
+  return Fakes::tickCount;
+}
+
+inline TickType_t xTaskGetTickCountFromISR() {
+  return Fakes::tickCount;
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+  if (Fakes::whileBlocked) {
+    Fakes::whileBlocked();
+  }
+  Fakes::tickCount += ticks;
+}
+
+inline UBaseType_t uxTaskGetNumberOfTasks() {
+  UBaseType_t count = Fakes::tasks.size();
+  Fakes::tasks.insert(Fakes::tasks.end(), Fakes::createdTasks.begin(), Fakes::createdTasks.end());
+  Fakes::createdTasks.clear();
+  return count;
+}
+
+// Like FreeRTOS, nothing is written if the array is too small
+inline UBaseType_t uxTaskGetSystemState(TaskStatus_t* taskStatusArray, UBaseType_t arraySize, uint32_t* totalRunTime) {
+  if (totalRunTime != nullptr) {
+    *totalRunTime = 0;
+  }
+  if (Fakes::tasks.size() > arraySize) {
+    return 0;
+  }
+  for (size_t i = 0; i < Fakes::tasks.size(); i++) {
+    taskStatusArray[i] = Fakes::tasks[i];
+  }
+  return Fakes::tasks.size();
+}
+
+inline size_t xPortGetFreeHeapSize() {
+  return Fakes::freeHeapSize;
+}
+
+inline size_t xPortGetMinimumEverFreeHeapSize() {
+  return Fakes::minimumEverFreeHeapSize;
+}
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+
+# Decodes the snapshots built by TelemetryService with tools/telemetry_decode.py, and compares the result with the
+# state of the firmware set up by TelemetryServiceTest.
+# Usage : telemetry_decode_test.py <path of TelemetryServiceTest>
+
+import io
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'tools'))
+import telemetry_decode  # noqa: E402
+
+FIRMWARE_TASKS = [('IDLE', 102), ('Tmr ', 58), ('MAIN', 87), ('disp', 212), ('Hear', 161), ('ble', 47), ('LOGG', 9)]
+HEADER = {
+    'uptime': 3723,
+    'free_heap': 4312,
+    'min_free_heap': 1096,
+    'malloc_failed': 2,
+    'stack_overflows': 65535,
+    'lvgl_total': 14336,
+    'lvgl_free': 5120,
+    'lvgl_max_used': 10240,
+    'lvgl_fragmentation': 23,
+    'system_queue': 3,
+    'display_queue': 1,
+    'frames': 9,
+    'frame_times': [26, 27, 30, 29, 33, 12, 45, 28],
+}
+EXPECTED = {
+    'firmware': dict(HEADER, tasks=FIRMWARE_TASKS, incomplete=False),
+    'full': dict(HEADER, tasks=[('Task', 100 + i) for i in range(16)], incomplete=False),
+    'incomplete': dict(HEADER, tasks=[], incomplete=True),
+    'boot': dict(HEADER, uptime=0, lvgl_total=0, lvgl_free=0, lvgl_max_used=0, lvgl_fragmentation=0, system_queue=0,
+                 display_queue=0, frames=0, frame_times=[], tasks=FIRMWARE_TASKS, incomplete=False),
+}
+
+
+def main():
+    output = subprocess.run([sys.argv[1], '--dump'], check=True, capture_output=True, text=True).stdout
+    lines = output.splitlines()
+    if sorted(line.split()[0] for line in lines) != sorted(EXPECTED):
+        sys.exit('unexpected snapshots : {}'.format(output))
+
+    for line in lines:
+        name, data = line.split()
+        snapshot = telemetry_decode.decode(bytes.fromhex(data))
+        if snapshot != EXPECTED[name]:
+            sys.exit('mismatch in snapshot {} : {}'.format(name, snapshot))
+
+        text = io.StringIO()
+        telemetry_decode.print_snapshot(snapshot, text)
+        if ('incomplete' in text.getvalue()) != snapshot['incomplete']:
+            sys.exit('the incomplete list of snapshot {} is not reported'.format(name))
+
+        # Notifications are truncated to the MTU
+        if snapshot['tasks']:
+            truncated = telemetry_decode.decode(bytes.fromhex(data)[:-3])
+            if truncated['tasks'] != snapshot['tasks'][:-1] or not truncated.get('truncated'):
+                sys.exit('truncated snapshot {} not decoded'.format(name))
+
+    print('{} snapshots decoded'.format(len(lines)))
+
+
+if __name__ == '__main__':
+    main()
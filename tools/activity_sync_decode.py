@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+
+# Decode the batches of records notified by the activity sync service.
+# See doc/ActivitySyncService.md for the description of the format.
+
+import argparse
+import datetime
+import struct
+import sys
+
+HEADER = struct.Struct('<BHI')
+FLAG_END = 0x01
+
+
+def read_varint(data, offset):
+    value = 0
+    shift = 0
+    while True:
+        if offset >= len(data) or shift > 28:
+            raise ValueError('truncated varint at offset {}'.format(offset))
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7f) << shift
+        if byte & 0x80 == 0:
+            return value, offset
+        shift += 7
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def decode(data):
+    """Returns (first minute, is end, list of (minute, steps, heart rate or 0))."""
+    if len(data) < HEADER.size:
+        raise ValueError('batch too short ({} bytes)'.format(len(data)))
+    flags, count, first_minute = HEADER.unpack_from(data)
+    offset = HEADER.size
+    minutes = []
+    heart_rate = 0
+    while len(minutes) < count:
+        value, offset = read_varint(data, offset)
+        if value == 0:
+            run, offset = read_varint(data, offset)
+            for _ in range(run + 1):
+                minutes.append((first_minute + len(minutes), 0, 0))
+            continue
+        steps = value >> 1
+        reading = 0
+        if value & 1:
+            delta, offset = read_varint(data, offset)
+            heart_rate += unzigzag(delta)
+            reading = heart_rate
+        minutes.append((first_minute + len(minutes), steps, reading))
+    if len(minutes) != count or offset != len(data):
+        raise ValueError('inconsistent batch ({} minutes, {} bytes left)'.format(len(minutes) - count, len(data) - offset))
+    return first_minute, (flags & FLAG_END) != 0, minutes
+
+
+def format_minute(minute):
+    # The minutes are counted in local time, displayed as if they were UTC
+    return datetime.datetime.fromtimestamp(minute * 60, datetime.timezone.utc).strftime('%Y-%m-%d %H:%M')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode the record batches of the activity sync service of InfiniTime.')
+    parser.add_argument('batches', nargs='*',
+                        help='batches as hexadecimal strings (bytes can be separated by colons or dashes), '
+                             'read from stdin (one per line) if not specified')
+    parser.add_argument('-a', '--all', action='store_true', help='also print the minutes without activity')
+    args = parser.parse_args()
+
+    lines = args.batches if args.batches else sys.stdin.read().splitlines()
+    next_minute = None
+    for line in lines:
+        text = line.strip()
+        for separator in ' :-\t':
+            text = text.replace(separator, '')
+        if not text:
+            continue
+        if text.lower().startswith('0x'):
+            text = text[2:]
+        try:
+            first_minute, is_end, minutes = decode(bytes.fromhex(text))
+        except ValueError as e:
+            sys.exit('error: {}'.format(e))
+
+        if next_minute is not None and first_minute != next_minute:
+            print('# gap : {} minutes not available'.format(first_minute - next_minute))
+        for minute, steps, heart_rate in minutes:
+            if args.all or steps or heart_rate:
+                print('{}  {:5} steps  {}'.format(format_minute(minute), steps, '{} bpm'.format(heart_rate) if heart_rate else '-'))
+        next_minute = first_minute + len(minutes)
+        print('# cursor to acknowledge : {}{}'.format(next_minute, ' (end)' if is_end else ''))
+
+
+if __name__ == '__main__':
+    main()
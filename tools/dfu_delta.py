@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+
+# Generate and apply delta patches for InfiniTime firmware upgrades.
+# See doc/ble.md ("Delta firmware upgrades") for the description of the format.
+
+import argparse
+import struct
+import sys
+
+MAGIC = b'ITD1'
+OP_COPY = 0x01
+OP_INSERT = 0x02
+SEED_SIZE = 8
+MAX_CANDIDATES = 16
+MIN_SCORE = 12
+
+
+def crc16(data):
+    """Same CRC16 as DfuService::DfuImage::ComputeCrc()."""
+    crc = 0xffff
+    for b in data:
+        crc = ((crc >> 8) | (crc << 8)) & 0xffff
+        crc ^= b
+        crc ^= (crc & 0xff) >> 4
+        crc ^= (crc << 12) & 0xffff
+        crc ^= ((crc & 0xff) << 5) & 0xffff
+    return crc
+
+
+def write_varint(out, value):
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def extend(source, target, s, t):
+    """Length of the approximate match at (s, t) maximizing 2 * matches - length, and its score."""
+    best_len = 0
+    best_score = 0
+    score = 0
+    limit = min(len(source) - s, len(target) - t)
+    for i in range(limit):
+        score += 1 if source[s + i] == target[t + i] else -1
+        if score > best_score:
+            best_score = score
+            best_len = i + 1
+        elif score < best_score - 32:
+            break
+    return best_len, best_score
+
+
+def diff(source, target):
+    index = {}
+    for i in range(len(source) - SEED_SIZE + 1):
+        positions = index.setdefault(source[i:i + SEED_SIZE], [])
+        if len(positions) < MAX_CANDIDATES:
+            positions.append(i)
+
+    patch = bytearray(MAGIC)
+    patch += struct.pack('<IHHI', len(source), crc16(source), 0, len(target))
+
+    literal = bytearray()
+    cursor = 0
+    t = 0
+    last_source_end = 0
+    last_target_end = 0
+
+    def flush_literal():
+        if literal:
+            patch.append(OP_INSERT)
+            write_varint(patch, len(literal))
+            patch.extend(literal)
+            literal.clear()
+
+    while t < len(target):
+        candidates = list(index.get(bytes(target[t:t + SEED_SIZE]), []))
+        # Code that did not change but moved keeps the same relative position to the previous match
+        follow = last_source_end + (t - last_target_end)
+        if 0 <= follow < len(source):
+            candidates.append(follow)
+
+        best = None
+        for s in candidates:
+            length, score = extend(source, target, s, t)
+            if best is None or score > best[2]:
+                best = (s, length, score)
+
+        if best is None or best[2] < MIN_SCORE:
+            literal.append(target[t])
+            t += 1
+            continue
+
+        flush_literal()
+        s, length, _ = best
+        fixes = [i for i in range(length) if source[s + i] != target[t + i]]
+        patch.append(OP_COPY)
+        write_varint(patch, zigzag(s - cursor))
+        write_varint(patch, length)
+        write_varint(patch, len(fixes))
+        previous = 0
+        for i in fixes:
+            write_varint(patch, i - previous)
+            patch.append((target[t + i] - source[s + i]) & 0xff)
+            previous = i + 1
+        cursor = s + length
+        t += length
+        last_source_end = cursor
+        last_target_end = t
+
+    flush_literal()
+    return patch
+
+
+def apply(source, patch):
+    if patch[:4] != MAGIC:
+        raise ValueError('invalid magic')
+    source_size, source_crc, _, target_size = struct.unpack('<IHHI', patch[4:16])
+    if source_size != len(source) or source_crc != crc16(source):
+        raise ValueError('the patch was not generated from this source image')
+
+    target = bytearray()
+    cursor = 0
+    pos = 16
+    while len(target) < target_size:
+        opcode = patch[pos]
+        pos += 1
+        if opcode == OP_COPY:
+            offset, pos = read_varint(patch, pos)
+            length, pos = read_varint(patch, pos)
+            nb_fixes, pos = read_varint(patch, pos)
+            cursor += unzigzag(offset)
+            chunk = bytearray(source[cursor:cursor + length])
+            i = 0
+            for _ in range(nb_fixes):
+                gap, pos = read_varint(patch, pos)
+                i += gap
+                chunk[i] = (chunk[i] + patch[pos]) & 0xff
+                pos += 1
+                i += 1
+            target += chunk
+            cursor += length
+        elif opcode == OP_INSERT:
+            length, pos = read_varint(patch, pos)
+            target += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError('invalid opcode 0x%02x at offset %d' % (opcode, pos - 1))
+
+    if len(target) != target_size or pos != len(patch):
+        raise ValueError('invalid patch length')
+    return target
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate and apply InfiniTime delta firmware patches.')
+    sub = parser.add_subparsers(dest='command', required=True)
+    d = sub.add_parser('diff', help='generate a patch from the old and the new firmware (.bin)')
+    d.add_argument('source')
+    d.add_argument('target')
+    d.add_argument('patch')
+    a = sub.add_parser('apply', help='apply a patch (to check it)')
+    a.add_argument('source')
+    a.add_argument('patch')
+    a.add_argument('target')
+    args = parser.parse_args()
+
+    if args.command == 'diff':
+        with open(args.source, 'rb') as f:
+            source = f.read()
+        with open(args.target, 'rb') as f:
+            target = f.read()
+        patch = diff(source, target)
+        if apply(source, patch) != target:
+            sys.exit('internal error: the generated patch does not rebuild the target')
+        with open(args.patch, 'wb') as f:
+            f.write(patch)
+        print('%s: %d bytes (%.1f%% of %d bytes), target CRC16 0x%04x' %
+              (args.patch, len(patch), 100.0 * len(patch) / len(target), len(target), crc16(target)))
+    else:
+        with open(args.source, 'rb') as f:
+            source = f.read()
+        with open(args.patch, 'rb') as f:
+            patch = f.read()
+        with open(args.target, 'wb') as f:
+            f.write(apply(source, patch))
+
+
+if __name__ == '__main__':
+    main()
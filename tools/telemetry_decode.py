@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+
+# Decode the snapshot of the telemetry service.
+# See doc/TelemetryService.md for the description of the format.
+
+import argparse
+import struct
+import sys
+
+VERSIONS = (1, 2)
+INCOMPLETE_TASK_LIST = 0x80
+HEADER = struct.Struct('<BIIIHHIIIBBBI8HB')
+TASK = struct.Struct('<4sH')
+
+
+def decode(data):
+    if len(data) < HEADER.size:
+        raise ValueError('snapshot too short ({} bytes)'.format(len(data)))
+    fields = HEADER.unpack_from(data)
+    if fields[0] not in VERSIONS:
+        raise ValueError('unsupported version {}'.format(fields[0]))
+
+    snapshot = {
+        'uptime': fields[1],
+        'free_heap': fields[2],
+        'min_free_heap': fields[3],
+        'malloc_failed': fields[4],
+        'stack_overflows': fields[5],
+        'lvgl_total': fields[6],
+        'lvgl_free': fields[7],
+        'lvgl_max_used': fields[8],
+        'lvgl_fragmentation': fields[9],
+        'system_queue': fields[10],
+        'display_queue': fields[11],
+        'frames': fields[12],
+        'frame_times': [t for t in fields[13:21] if t != 0],
+        'tasks': [],
+        'incomplete': False,
+    }
+
+    nb_tasks = fields[21]
+    if fields[0] >= 2:
+        snapshot['incomplete'] = (nb_tasks & INCOMPLETE_TASK_LIST) != 0
+        nb_tasks &= ~INCOMPLETE_TASK_LIST
+    # Notifications are truncated to the MTU, only keep the complete tasks
+    offset = HEADER.size
+    for _ in range(nb_tasks):
+        if offset + TASK.size > len(data):
+            snapshot['truncated'] = True
+            break
+        name, high_water_mark = TASK.unpack_from(data, offset)
+        snapshot['tasks'].append((name.rstrip(b'\0').decode('ascii', 'replace'), high_water_mark))
+        offset += TASK.size
+    return snapshot
+
+
+def print_snapshot(s, out):
+    out.write('Uptime            : {} s\n'.format(s['uptime']))
+    out.write('Heap              : {} B free, {} B min free\n'.format(s['free_heap'], s['min_free_heap']))
+    out.write('Alloc errors      : {}, stack overflows : {}\n'.format(s['malloc_failed'], s['stack_overflows']))
+    if s['lvgl_total']:
+        used = s['lvgl_total'] - s['lvgl_free']
+        out.write('LVGL memory       : {}/{} B used, {} B max used, {}% fragmentation\n'.format(
+            used, s['lvgl_total'], s['lvgl_max_used'], s['lvgl_fragmentation']))
+    else:
+        out.write('LVGL memory       : not sampled yet\n')
+    out.write('Queues            : system {}, display {}\n'.format(s['system_queue'], s['display_queue']))
+    out.write('Frames            : {}\n'.format(s['frames']))
+    if s['frame_times']:
+        times = s['frame_times']
+        out.write('Frame times       : {} ms (avg {:.1f} ms, max {} ms)\n'.format(
+            ' '.join(str(t) for t in times), sum(times) / len(times), max(times)))
+    out.write('Stack high-water marks :\n')
+    for name, words in s['tasks']:
+        out.write('  {:<4} {:>5} words ({} B)\n'.format(name, words, words * 4))
+    if s['incomplete']:
+        out.write('  (incomplete, more tasks are running than the snapshot can hold)\n')
+    if s.get('truncated'):
+        out.write('  (truncated, read the characteristic to get all the tasks)\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode a telemetry snapshot of InfiniTime.')
+    parser.add_argument('snapshot', nargs='?',
+                        help='snapshot as an hexadecimal string (bytes can be separated by spaces, colons or dashes)')
+    parser.add_argument('-f', '--file', help='read the raw snapshot from a binary file')
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+    else:
+        text = args.snapshot if args.snapshot is not None else sys.stdin.read()
+        for separator in ' :-\n\r\t':
+            text = text.replace(separator, '')
+        if text.lower().startswith('0x'):
+            text = text[2:]
+        data = bytes.fromhex(text)
+
+    try:
+        snapshot = decode(data)
+    except ValueError as e:
+        sys.exit('error: {}'.format(e))
+    print_snapshot(snapshot, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()